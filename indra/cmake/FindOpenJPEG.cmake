@@ -9,15 +9,28 @@
 # also defined, but not for general use are
 #  OPENJPEG_LIBRARY, where to find the OpenJPEG library.
 
-FIND_PATH(OPENJPEG_INCLUDE_DIR openjpeg.h
-/usr/local/include/openjpeg
-/usr/local/include
-/usr/include/openjpeg
-/usr/include/openjpeg-1.5
-/usr/include
-)
-
-SET(OPENJPEG_NAMES ${OPENJPEG_NAMES} openjpeg)
+IF (LIBOPENJPEG2)
+  FIND_PATH(OPENJPEG_INCLUDE_DIR openjpeg.h
+  /usr/local/include/openjpeg-2.5
+  /usr/local/include/openjpeg-2.4
+  /usr/local/include/openjpeg-2.3
+  /usr/include/openjpeg-2.5
+  /usr/include/openjpeg-2.4
+  /usr/include/openjpeg-2.3
+  )
+
+  SET(OPENJPEG_NAMES ${OPENJPEG_NAMES} openjp2)
+ELSE (LIBOPENJPEG2)
+  FIND_PATH(OPENJPEG_INCLUDE_DIR openjpeg.h
+  /usr/local/include/openjpeg
+  /usr/local/include
+  /usr/include/openjpeg
+  /usr/include/openjpeg-1.5
+  /usr/include
+  )
+
+  SET(OPENJPEG_NAMES ${OPENJPEG_NAMES} openjpeg)
+ENDIF (LIBOPENJPEG2)
 FIND_LIBRARY(OPENJPEG_LIBRARY
   NAMES ${OPENJPEG_NAMES}
   PATHS /usr/lib /usr/local/lib
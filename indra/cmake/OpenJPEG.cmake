@@ -9,14 +9,17 @@ if (USESYSTEMLIBS)
 else (USESYSTEMLIBS)
   use_prebuilt_binary(openjpeg)
   
-  if(WINDOWS)
+  if (LIBOPENJPEG2)
+    # OpenJPEG 2.x names its library openjp2 everywhere
+    set(OPENJPEG_LIBRARIES openjp2)
+  elseif(WINDOWS)
     # Windows has differently named release and debug openjpeg(d) libs.
     set(OPENJPEG_LIBRARIES 
         debug openjpegd
         optimized openjpeg)
-  else(WINDOWS)
+  else()
     set(OPENJPEG_LIBRARIES openjpeg)
-  endif(WINDOWS)
+  endif(LIBOPENJPEG2)
   
     set(OPENJPEG_INCLUDE_DIR ${LIBS_PREBUILT_DIR}/include/openjpeg)
 endif (USESYSTEMLIBS)
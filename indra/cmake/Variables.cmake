@@ -47,6 +47,9 @@ endif (${CMAKE_SYSTEM_NAME} MATCHES "Linux" OR ${CMAKE_SYSTEM_NAME} MATCHES "Dar
 # Mallocs
 set(DISABLE_TCMALLOC OFF CACHE BOOL "Disable linkage of TCMalloc. (64bit builds automatically disable TCMalloc)")
 set(DISABLE_FATAL_WARNINGS TRUE CACHE BOOL "Set this to FALSE to enable fatal warnings.")
+# Image codecs
+option(LIBOPENJPEG2 "Decode JPEG2000 with OpenJPEG 2.x, which can decode regions and resume between slices" OFF)
+
 # Audio Engines
 option(FMODSTUDIO "Build with support for the FMOD Studio audio engine" OFF)
 
@@ -154,8 +154,10 @@ public:
 	virtual void requestStopMotion( LLMotion* motion );
 	
 	// periodic update function, steps the motion controller
+	// when deferred, the controller's evaluateMotions() and finishMotions()
+	// must be called before the joints are used
 	enum e_update_t { NORMAL_UPDATE, HIDDEN_UPDATE, FORCE_UPDATE };
-	void updateMotions(e_update_t update_type);
+	void updateMotions(e_update_t update_type, bool deferred = false);
 
 	LLAnimPauseRequest requestPause();
 	BOOL areAnimationsPaused() const { return mMotionController.isPaused(); }
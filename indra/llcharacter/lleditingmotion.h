@@ -101,6 +101,8 @@ public:
 	// must return FALSE when the motion is completed.
 	BOOL onUpdate(F32 time, U8* joint_mask) override;
 
+	BOOL canUpdateOffThread() override { return TRUE; }
+
 	// called when a motion is deactivated
 	void onDeactivate() override;
 
@@ -37,8 +37,8 @@
 #include "llcallstack.h"
 #include <boost/algorithm/string.hpp>
 
-S32 LLJoint::sNumUpdates = 0;
-S32 LLJoint::sNumTouches = 0;
+thread_local S32 LLJoint::sNumUpdates = 0;
+thread_local S32 LLJoint::sNumTouches = 0;
 
 template <class T>
 constexpr bool attachment_map_iter_compare_key(const T& a, const T& b)
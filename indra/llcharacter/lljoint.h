@@ -129,9 +129,9 @@ public:
 	typedef std::list<LLJoint*> child_list_t;
 	child_list_t mChildren;
 
-	// debug statics
-	static S32		sNumTouches;
-	static S32		sNumUpdates;
+	// debug statics, per thread as skeletons can be animated on workers
+	static thread_local S32	sNumTouches;
+	static thread_local S32	sNumUpdates;
     typedef std::set<std::string> debug_joint_name_t;
     static debug_joint_name_t s_debugJointNames;
     static void setDebugJointNames(const debug_joint_name_t& names);
@@ -91,283 +91,232 @@ LLKeyframeMotion::JointMotionList::~JointMotionList()
 //Singu: add parameter 'silent'.
 U32 LLKeyframeMotion::JointMotionList::dumpDiagInfo(bool silent) const
 {
-	S32	total_size = sizeof(JointMotionList);
-
-	for (U32 i = 0; i < getNumJointMotions(); i++)
+	if (!silent)
 	{
-		LLKeyframeMotion::JointMotion const* joint_motion_p = mJointMotionArray[i];
-
-		if (!silent)
+		for (U32 i = 0; i < getNumJointMotions(); i++)
 		{
+			LLKeyframeMotion::JointMotion const* joint_motion_p = mJointMotionArray[i];
+
 			LL_INFOS() << "\tJoint " << joint_motion_p->mJointName << LL_ENDL;
-		}
-		if (joint_motion_p->mUsage & LLJointState::SCALE)
-		{
-			if (!silent)
+			if (joint_motion_p->mUsage & LLJointState::ROT)
 			{
-				LL_INFOS() << "\t" << joint_motion_p->mScaleCurve.mNumKeys << " scale keys at "
-				<< joint_motion_p->mScaleCurve.mNumKeys * sizeof(ScaleKey) << " bytes" << LL_ENDL;
+				LL_INFOS() << "\t" << joint_motion_p->mRotationCurve.getNumKeys() << " rotation keys at "
+				<< joint_motion_p->mRotationCurve.getMemoryUsage() << " bytes" << LL_ENDL;
 			}
-			total_size += joint_motion_p->mScaleCurve.mNumKeys * sizeof(ScaleKey);
-		}
-		if (joint_motion_p->mUsage & LLJointState::ROT)
-		{
-			if (!silent)
+			if (joint_motion_p->mUsage & LLJointState::POS)
 			{
-				LL_INFOS() << "\t" << joint_motion_p->mRotationCurve.mNumKeys << " rotation keys at "
-				<< joint_motion_p->mRotationCurve.mNumKeys * sizeof(RotationKey) << " bytes" << LL_ENDL;
+				LL_INFOS() << "\t" << joint_motion_p->mPositionCurve.getNumKeys() << " position keys at "
+				<< joint_motion_p->mPositionCurve.getMemoryUsage() << " bytes" << LL_ENDL;
 			}
-			total_size += joint_motion_p->mRotationCurve.mNumKeys * sizeof(RotationKey);
-		}
-		if (joint_motion_p->mUsage & LLJointState::POS)
-		{
-			if (!silent)
-			{
-				LL_INFOS() << "\t" << joint_motion_p->mPositionCurve.mNumKeys << " position keys at "
-				<< joint_motion_p->mPositionCurve.mNumKeys * sizeof(PositionKey) << " bytes" << LL_ENDL;
-			}
-			total_size += joint_motion_p->mPositionCurve.mNumKeys * sizeof(PositionKey);
 		}
+		LL_INFOS() << "\t" << mConstraints.size() << " constraints" << LL_ENDL;
 	}
-	//Singu: Also add memory used by the constraints.
-	S32 constraints_size = mConstraints.size() * sizeof(constraint_list_t::value_type);
-	total_size += constraints_size;
+
+	U32 total_size = getMemoryUsage();
 	if (!silent)
 	{
-		LL_INFOS() << "\t" << mConstraints.size() << " constraints at " << constraints_size << " bytes" << LL_ENDL;
 		LL_INFOS() << "Size: " << total_size << " bytes" << LL_ENDL;
 	}
 
 	return total_size;
 }
 
+U32 LLKeyframeMotion::JointMotionList::getMemoryUsage() const
+{
+	U32 total_size = sizeof(JointMotionList) + mEmoteName.capacity();
+	total_size += mJointMotionArray.capacity() * sizeof(JointMotion*);
+	for (U32 i = 0; i < getNumJointMotions(); i++)
+	{
+		const JointMotion* joint_motion_p = mJointMotionArray[i];
+		total_size += sizeof(JointMotion) + joint_motion_p->mJointName.capacity();
+		total_size += joint_motion_p->mRotationCurve.getMemoryUsage();
+		total_size += joint_motion_p->mPositionCurve.getMemoryUsage();
+	}
+	for (constraint_list_t::const_iterator iter = mConstraints.begin(); iter != mConstraints.end(); ++iter)
+	{
+		total_size += sizeof(JointConstraintSharedData) + ((*iter)->mChainLength + 1) * sizeof(S32);
+	}
+	return total_size;
+}
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 // ****Curve classes
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 
+static inline F32 key_time(U16 time, F32 duration)
+{
+	return U16_to_F32(time, 0.f, duration);
+}
+
+static inline U16 quantize_time(F32 time, F32 duration)
+{
+	return duration > 0.f ? F32_to_U16_ROUND(time, 0.f, duration) : 0;
+}
 
 //-----------------------------------------------------------------------------
-// ScaleCurve::ScaleCurve()
+// KeyframeCurve::getMemoryUsage()
 //-----------------------------------------------------------------------------
-LLKeyframeMotion::ScaleCurve::ScaleCurve()
+U32 LLKeyframeMotion::KeyframeCurve::getMemoryUsage() const
 {
-	mInterpolationType = LLKeyframeMotion::IT_LINEAR;
-	mNumKeys = 0;
+	return (U32)(mKeys.capacity() * sizeof(Key) + mIndex.capacity() * sizeof(U32));
 }
 
 //-----------------------------------------------------------------------------
-// ScaleCurve::~ScaleCurve()
+// KeyframeCurve::addKey()
 //-----------------------------------------------------------------------------
-LLKeyframeMotion::ScaleCurve::~ScaleCurve() 
+void LLKeyframeMotion::KeyframeCurve::addKey(U16 time, U16 x, U16 y, U16 z)
 {
-	mKeys.clear();
-	mNumKeys = 0;
+	Key key = { time, { x, y, z } };
+	mKeys.push_back(key);
 }
 
 //-----------------------------------------------------------------------------
-// getValue()
+// KeyframeCurve::finish()
 //-----------------------------------------------------------------------------
-LLVector3 LLKeyframeMotion::ScaleCurve::getValue(F32 time, F32 duration)
+void LLKeyframeMotion::KeyframeCurve::finish()
 {
-	LLVector3 value;
-
-	if (mKeys.empty())
+	std::stable_sort(mKeys.begin(), mKeys.end(),
+					 [](const Key& a, const Key& b) { return a.mTime < b.mTime; });
+	size_t num_keys = 0;
+	for (size_t i = 0; i < mKeys.size(); ++i)
 	{
-		value.clearVec();
-		return value;
+		if (num_keys && mKeys[num_keys - 1].mTime == mKeys[i].mTime)
+		{
+			mKeys[num_keys - 1] = mKeys[i];
+		}
+		else
+		{
+			mKeys[num_keys++] = mKeys[i];
+		}
 	}
-	
-	key_map_t::iterator right = mKeys.lower_bound(time);
-	if (right == mKeys.end())
+	mKeys.resize(num_keys);
+	mKeys.shrink_to_fit();
+
+	U32 num_slices = 1;
+	mIndexShift = 16;
+	while (num_slices < num_keys && mIndexShift > 0)
 	{
-		// Past last key
-		--right;
-		value = right->second.mScale;
+		num_slices <<= 1;
+		--mIndexShift;
 	}
-	else if (right == mKeys.begin() || right->first == time)
+	mIndex.assign(num_slices, 0);
+	U32 key = 0;
+	for (U32 slice = 0; slice < num_slices; ++slice)
 	{
-		// Before first key or exactly on a key
-		value = right->second.mScale;
-	}
-	else
-	{
-		// Between two keys
-		key_map_t::iterator left = right; --left;
-		F32 index_before = left->first;
-		F32 index_after = right->first;
-		ScaleKey& scale_before = left->second;
-		ScaleKey& scale_after = right->second;
-		if (right == mKeys.end())
+		while (key < num_keys && mKeys[key].mTime < (slice << mIndexShift))
 		{
-			scale_after = mLoopInKey;
-			index_after = duration;
+			++key;
 		}
-
-		F32 u = (time - index_before) / (index_after - index_before);
-		value = interp(u, scale_before, scale_after);
+		mIndex[slice] = key;
 	}
-	return value;
 }
 
 //-----------------------------------------------------------------------------
-// interp()
+// KeyframeCurve::findKeys()
 //-----------------------------------------------------------------------------
-LLVector3 LLKeyframeMotion::ScaleCurve::interp(F32 u, ScaleKey& before, ScaleKey& after)
+void LLKeyframeMotion::KeyframeCurve::findKeys(F32 time, F32 duration, S32& before, S32& after, F32& u) const
 {
-	switch (mInterpolationType)
-	{
-	case IT_STEP:
-		return before.mScale;
+	const S32 num_keys = (S32)mKeys.size();
 
-	default:
-	case IT_LINEAR:
-	case IT_SPLINE:
-		return lerp(before.mScale, after.mScale, u);
+	// First key at or after time, starting from its slice
+	F32 slice_time = duration > 0.f ? llclamp(time / duration, 0.f, 1.f) * U16MAX : 0.f;
+	S32 right = (S32)mIndex[(U32)slice_time >> mIndexShift];
+	while (right > 0 && key_time(mKeys[right - 1].mTime, duration) >= time)
+	{
+		--right;
 	}
-}
-
-//-----------------------------------------------------------------------------
-// RotationCurve::RotationCurve()
-//-----------------------------------------------------------------------------
-LLKeyframeMotion::RotationCurve::RotationCurve()
-{
-	mInterpolationType = LLKeyframeMotion::IT_LINEAR;
-	mNumKeys = 0;
-}
-
-//-----------------------------------------------------------------------------
-// RotationCurve::~RotationCurve()
-//-----------------------------------------------------------------------------
-LLKeyframeMotion::RotationCurve::~RotationCurve()
-{
-	mKeys.clear();
-	mNumKeys = 0;
-}
-
-//-----------------------------------------------------------------------------
-// RotationCurve::getValue()
-//-----------------------------------------------------------------------------
-LLQuaternion LLKeyframeMotion::RotationCurve::getValue(F32 time, F32 duration)
-{
-	LLQuaternion value;
-
-	if (mKeys.empty())
+	while (right < num_keys && key_time(mKeys[right].mTime, duration) < time)
 	{
-		value = LLQuaternion::DEFAULT;
-		return value;
+		++right;
 	}
-	
-	key_map_t::iterator right = mKeys.lower_bound(time);
-	if (right == mKeys.end())
+
+	u = 0.f;
+	if (right == num_keys)
 	{
 		// Past last key
-		--right;
-		value = right->second.mRotation;
+		before = after = num_keys - 1;
 	}
-	else if (right == mKeys.begin() || right->first == time)
+	else if (right == 0 || key_time(mKeys[right].mTime, duration) == time)
 	{
 		// Before first key or exactly on a key
-		value = right->second.mRotation;
+		before = after = right;
 	}
 	else
 	{
 		// Between two keys
-		key_map_t::iterator left = right; --left;
-		F32 index_before = left->first;
-		F32 index_after = right->first;
-		RotationKey& rot_before = left->second;
-		RotationKey& rot_after = right->second;
-		if (right == mKeys.end())
-		{
-			rot_after = mLoopInKey;
-			index_after = duration;
-		}
-
-		F32 u = (time - index_before) / (index_after - index_before);
-		value = interp(u, rot_before, rot_after);
+		before = right - 1;
+		after = right;
+		F32 index_before = key_time(mKeys[before].mTime, duration);
+		F32 index_after = key_time(mKeys[after].mTime, duration);
+		u = (time - index_before) / (index_after - index_before);
 	}
-	return value;
 }
 
 //-----------------------------------------------------------------------------
-// interp()
+// RotationCurve::getRotation()
 //-----------------------------------------------------------------------------
-LLQuaternion LLKeyframeMotion::RotationCurve::interp(F32 u, RotationKey& before, RotationKey& after)
+// static
+LLQuaternion LLKeyframeMotion::RotationCurve::getRotation(const Key& key)
 {
-	switch (mInterpolationType)
-	{
-	case IT_STEP:
-		return before.mRotation;
-
-	default:
-	case IT_LINEAR:
-	case IT_SPLINE:
-		return nlerp(u, before.mRotation, after.mRotation);
-	}
+	LLVector3 rot_vec;
+	rot_vec.mV[VX] = U16_to_F32(key.mValue[VX], -1.f, 1.f);
+	rot_vec.mV[VY] = U16_to_F32(key.mValue[VY], -1.f, 1.f);
+	rot_vec.mV[VZ] = U16_to_F32(key.mValue[VZ], -1.f, 1.f);
+	LLQuaternion rotation;
+	rotation.unpackFromVector3(rot_vec);
+	return rotation;
 }
 
-
 //-----------------------------------------------------------------------------
-// PositionCurve::PositionCurve()
+// RotationCurve::getValue()
 //-----------------------------------------------------------------------------
-LLKeyframeMotion::PositionCurve::PositionCurve()
+LLQuaternion LLKeyframeMotion::RotationCurve::getValue(F32 time, F32 duration) const
 {
-	mInterpolationType = LLKeyframeMotion::IT_LINEAR;
-	mNumKeys = 0;
+	if (mKeys.empty())
+	{
+		return LLQuaternion::DEFAULT;
+	}
+
+	S32 before, after;
+	F32 u;
+	findKeys(time, duration, before, after, u);
+	if (before == after)
+	{
+		return getRotation(mKeys[before]);
+	}
+	return nlerp(u, getRotation(mKeys[before]), getRotation(mKeys[after]));
 }
 
 //-----------------------------------------------------------------------------
-// PositionCurve::~PositionCurve()
+// PositionCurve::getPosition()
 //-----------------------------------------------------------------------------
-LLKeyframeMotion::PositionCurve::~PositionCurve()
+// static
+LLVector3 LLKeyframeMotion::PositionCurve::getPosition(const Key& key)
 {
-	mKeys.clear();
-	mNumKeys = 0;
+	return LLVector3(U16_to_F32(key.mValue[VX], -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET),
+					 U16_to_F32(key.mValue[VY], -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET),
+					 U16_to_F32(key.mValue[VZ], -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET));
 }
 
 //-----------------------------------------------------------------------------
 // PositionCurve::getValue()
 //-----------------------------------------------------------------------------
-LLVector3 LLKeyframeMotion::PositionCurve::getValue(F32 time, F32 duration)
+LLVector3 LLKeyframeMotion::PositionCurve::getValue(F32 time, F32 duration) const
 {
-	LLVector3 value;
-
 	if (mKeys.empty())
 	{
-		value.clearVec();
-		return value;
-	}
-	
-	key_map_t::iterator right = mKeys.lower_bound(time);
-	if (right == mKeys.end())
-	{
-		// Past last key
-		--right;
-		value = right->second.mPosition;
+		return LLVector3::zero;
 	}
-	else if (right == mKeys.begin() || right->first == time)
-	{
-		// Before first key or exactly on a key
-		value = right->second.mPosition;
-	}
-	else
-	{
-		// Between two keys
-		key_map_t::iterator left = right; --left;
-		F32 index_before = left->first;
-		F32 index_after = right->first;
-		PositionKey& pos_before = left->second;
-		PositionKey& pos_after = right->second;
-		if (right == mKeys.end())
-		{
-			pos_after = mLoopInKey;
-			index_after = duration;
-		}
 
-		F32 u = (time - index_before) / (index_after - index_before);
-		value = interp(u, pos_before, pos_after);
+	S32 before, after;
+	F32 u;
+	findKeys(time, duration, before, after, u);
+	LLVector3 value = getPosition(mKeys[before]);
+	if (before != after)
+	{
+		value = lerp(value, getPosition(mKeys[after]), u);
 	}
 
 	llassert(value.isFinite());
@@ -375,22 +324,6 @@ LLVector3 LLKeyframeMotion::PositionCurve::getValue(F32 time, F32 duration)
 	return value;
 }
 
-//-----------------------------------------------------------------------------
-// interp()
-//-----------------------------------------------------------------------------
-LLVector3 LLKeyframeMotion::PositionCurve::interp(F32 u, PositionKey& before, PositionKey& after)
-{
-	switch (mInterpolationType)
-	{
-	case IT_STEP:
-		return before.mPosition;
-	default:
-	case IT_LINEAR:
-	case IT_SPLINE:
-		return lerp(before.mPosition, after.mPosition, u);
-	}
-}
-
 
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
@@ -401,7 +334,7 @@ LLVector3 LLKeyframeMotion::PositionCurve::interp(F32 u, PositionKey& before, Po
 //-----------------------------------------------------------------------------
 // JointMotion::update()
 //-----------------------------------------------------------------------------
-void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time, F32 duration)
+void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time, F32 duration) const
 {
 	// this value being 0 is the cause of https://jira.lindenlab.com/browse/SL-22678 but I haven't 
 	// managed to get a stack to see how it got here. Testing for 0 here will stop the crash.
@@ -412,18 +345,10 @@ void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time,
 
 	U32 usage = joint_state->getUsage();
 
-	//-------------------------------------------------------------------------
-	// update scale component of joint state
-	//-------------------------------------------------------------------------
-	if ((usage & LLJointState::SCALE) && mScaleCurve.mNumKeys)
-	{
-		joint_state->setScale( mScaleCurve.getValue( time, duration ) );
-	}
-
 	//-------------------------------------------------------------------------
 	// update rotation component of joint state
 	//-------------------------------------------------------------------------
-	if ((usage & LLJointState::ROT) && mRotationCurve.mNumKeys)
+	if ((usage & LLJointState::ROT) && mRotationCurve.getNumKeys())
 	{
 		joint_state->setRotation( mRotationCurve.getValue( time, duration ) );
 	}
@@ -431,7 +356,7 @@ void LLKeyframeMotion::JointMotion::update(LLJointState* joint_state, F32 time,
 	//-------------------------------------------------------------------------
 	// update position component of joint state
 	//-------------------------------------------------------------------------
-	if ((usage & LLJointState::POS) && mPositionCurve.mNumKeys)
+	if ((usage & LLJointState::POS) && mPositionCurve.getNumKeys())
 	{
 		joint_state->setPosition( mPositionCurve.getValue( time, duration ) );
 	}
@@ -557,31 +482,7 @@ LLMotion::LLMotionInitStatus LLKeyframeMotion::onInitialize(LLCharacter *charact
 	if(joint_motion_list)
 	{
 		// motion already existed in cache, so grab it
-		mJointMotionList = joint_motion_list;
-
-		mJointStates.reserve(mJointMotionList->getNumJointMotions());
-		
-		// don't forget to allocate joint states
-		// set up joint states to point to character joints
-		for(U32 i = 0; i < mJointMotionList->getNumJointMotions(); i++)
-		{
-			JointMotion* joint_motion = mJointMotionList->getJointMotion(i);
-			if (LLJoint *joint = mCharacter->getJoint(joint_motion->mJointName))
-			{
-				LLPointer<LLJointState> joint_state = new LLJointState;
-				mJointStates.push_back(joint_state);
-				joint_state->setJoint(joint);
-				joint_state->setUsage(joint_motion->mUsage);
-				joint_state->setPriority(joint_motion->mPriority);
-			}
-			else
-			{
-				// add dummy joint state with no associated joint
-				mJointStates.push_back(new LLJointState);
-			}
-		}
-		mAssetStatus = ASSET_LOADED;
-		setupPose();
+		setJointMotionList(joint_motion_list);
 		return STATUS_SUCCESS;
 	}
 
@@ -655,6 +556,39 @@ LLMotion::LLMotionInitStatus LLKeyframeMotion::onInitialize(LLCharacter *charact
 	return STATUS_SUCCESS;
 }
 
+//-----------------------------------------------------------------------------
+// setJointMotionList()
+//-----------------------------------------------------------------------------
+void LLKeyframeMotion::setJointMotionList(JointMotionList* joint_motion_list)
+{
+	mJointMotionList = joint_motion_list;
+
+	mJointStates.clear();
+	mJointStates.reserve(mJointMotionList->getNumJointMotions());
+
+	// don't forget to allocate joint states
+	// set up joint states to point to character joints
+	for(U32 i = 0; i < mJointMotionList->getNumJointMotions(); i++)
+	{
+		JointMotion* joint_motion = mJointMotionList->getJointMotion(i);
+		if (LLJoint *joint = mCharacter->getJoint(joint_motion->mJointName))
+		{
+			LLPointer<LLJointState> joint_state = new LLJointState;
+			mJointStates.push_back(joint_state);
+			joint_state->setJoint(joint);
+			joint_state->setUsage(joint_motion->mUsage);
+			joint_state->setPriority(joint_motion->mPriority);
+		}
+		else
+		{
+			// add dummy joint state with no associated joint
+			mJointStates.push_back(new LLJointState);
+		}
+	}
+	mAssetStatus = ASSET_LOADED;
+	setupPose();
+}
+
 //-----------------------------------------------------------------------------
 // setupPose()
 //-----------------------------------------------------------------------------
@@ -838,6 +772,23 @@ void LLKeyframeMotion::onDeactivate()
 	}
 }
 
+//-----------------------------------------------------------------------------
+// LLKeyframeMotion::canUpdateOffThread()
+//-----------------------------------------------------------------------------
+BOOL LLKeyframeMotion::canUpdateOffThread()
+{
+	for (constraint_list_t::iterator iter = mConstraints.begin();
+		 iter != mConstraints.end(); ++iter)
+	{
+		JointConstraintSharedData* shared_data = (*iter)->mSharedData;
+		if (shared_data && shared_data->mConstraintTargetType == CONSTRAINT_TARGET_TYPE_GROUND)
+		{
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
 //-----------------------------------------------------------------------------
 // setStopTime()
 //-----------------------------------------------------------------------------
@@ -1554,15 +1505,15 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 		//---------------------------------------------------------------------
 		// scan rotation curve header
 		//---------------------------------------------------------------------
-		if (!dp.unpackS32(joint_motion->mRotationCurve.mNumKeys, "num_rot_keys") || joint_motion->mRotationCurve.mNumKeys < 0)
+		S32 num_rot_keys;
+		if (!dp.unpackS32(num_rot_keys, "num_rot_keys") || num_rot_keys < 0)
 		{
 			LL_WARNS() << "can't read number of rotation keys" << LL_ENDL;
 			delete mJointMotionList;
 			return FALSE;
 		}
 
-		joint_motion->mRotationCurve.mInterpolationType = IT_LINEAR;
-		if (joint_motion->mRotationCurve.mNumKeys != 0)
+		if (num_rot_keys != 0)
 		{
 			joint_state->setUsage(joint_state->getUsage() | LLJointState::ROT );
 		}
@@ -1572,7 +1523,7 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 		//---------------------------------------------------------------------
 		RotationCurve *rCurve = &joint_motion->mRotationCurve;
 
-		for (S32 k = 0; k < joint_motion->mRotationCurve.mNumKeys; k++)
+		for (S32 k = 0; k < num_rot_keys; k++)
 		{
 			F32 time;
 			U16 time_short;
@@ -1587,6 +1538,7 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 					return FALSE;
 				}
 
+				time_short = quantize_time(time, mJointMotionList->mDuration);
 			}
 			else
 			{
@@ -1607,8 +1559,6 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 				}
 			}
 			
-			RotationKey rot_key;
-			rot_key.mTime = time;
 			LLVector3 rot_angles;
 			U16 x, y, z;
 
@@ -1628,7 +1578,19 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 				}
 
 				LLQuaternion::Order ro = StringToOrder("ZYX");
-				rot_key.mRotation = mayaQ(rot_angles.mV[VX], rot_angles.mV[VY], rot_angles.mV[VZ], ro);
+				LLQuaternion rotation = mayaQ(rot_angles.mV[VX], rot_angles.mV[VY], rot_angles.mV[VZ], ro);
+				if( !(rotation.isFinite()) )
+				{
+					LL_WARNS() << "non-finite angle in rotation key (" << k << ")" << LL_ENDL;
+					delete mJointMotionList;
+					return FALSE;
+				}
+
+				// kept quantized like the current format
+				LLVector3 rot_vec = rotation.packToVector3();
+				x = F32_to_U16_ROUND(rot_vec.mV[VX], -1.f, 1.f);
+				y = F32_to_U16_ROUND(rot_vec.mV[VY], -1.f, 1.f);
+				z = F32_to_U16_ROUND(rot_vec.mV[VZ], -1.f, 1.f);
 			}
 			else
 			{
@@ -1650,42 +1612,24 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 					delete mJointMotionList;
 					return FALSE;
 				}
-
-				LLVector3 rot_vec;
-				rot_vec.mV[VX] = U16_to_F32(x, -1.f, 1.f);
-				rot_vec.mV[VY] = U16_to_F32(y, -1.f, 1.f);
-				rot_vec.mV[VZ] = U16_to_F32(z, -1.f, 1.f);
-				if (!rot_vec.isFinite())
-				{
-					LL_WARNS() << "non-finite angle in rotation key (" << k << ")" << LL_ENDL;
-					delete mJointMotionList;
-					return FALSE;
-				}
-				rot_key.mRotation.unpackFromVector3(rot_vec);
 			}
 
-			if( !(rot_key.mRotation.isFinite()) )
-			{
-				LL_WARNS() << "non-finite angle in rotation key (" << k << ")" << LL_ENDL;
-				delete mJointMotionList;
-				return FALSE;
-			}
-
-			rCurve->mKeys[time] = rot_key;
+			rCurve->addKey(time_short, x, y, z);
 		}
+		rCurve->finish();
 
 		//---------------------------------------------------------------------
 		// scan position curve header
 		//---------------------------------------------------------------------
-		if (!dp.unpackS32(joint_motion->mPositionCurve.mNumKeys, "num_pos_keys") || joint_motion->mPositionCurve.mNumKeys < 0)
+		S32 num_pos_keys;
+		if (!dp.unpackS32(num_pos_keys, "num_pos_keys") || num_pos_keys < 0)
 		{
 			LL_WARNS() << "can't read number of position keys" << LL_ENDL;
 			delete mJointMotionList;
 			return FALSE;
 		}
 
-		joint_motion->mPositionCurve.mInterpolationType = IT_LINEAR;
-		if (joint_motion->mPositionCurve.mNumKeys != 0)
+		if (num_pos_keys != 0)
 		{
 			joint_state->setUsage(joint_state->getUsage() | LLJointState::POS );
 		}
@@ -1695,20 +1639,22 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 		//---------------------------------------------------------------------
 		PositionCurve *pCurve = &joint_motion->mPositionCurve;
 		BOOL is_pelvis = joint_motion->mJointName == "mPelvis";
-		for (S32 k = 0; k < joint_motion->mPositionCurve.mNumKeys; k++)
+		for (S32 k = 0; k < num_pos_keys; k++)
 		{
 			U16 time_short;
-			PositionKey pos_key;
+			U16 x, y, z;
 
 			if (old_version)
 			{
-				if (!dp.unpackF32(pos_key.mTime, "time") ||
-				    !llfinite(pos_key.mTime))
+				F32 time;
+				if (!dp.unpackF32(time, "time") ||
+				    !llfinite(time))
 				{
 					LL_WARNS() << "can't read time in position key (" << k << ")" << LL_ENDL;
 					delete mJointMotionList;
 					return FALSE;
 				}
+				time_short = quantize_time(time, mJointMotionList->mDuration);
 			}
 			else
 			{
@@ -1718,29 +1664,31 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 					delete mJointMotionList;
 					return FALSE;
 				}
-
-				pos_key.mTime = U16_to_F32(time_short, 0.f, mJointMotionList->mDuration);
 			}
 
 			if (old_version)
 			{
-				if (!dp.unpackVector3(pos_key.mPosition, "pos"))
+				LLVector3 position;
+				if (!dp.unpackVector3(position, "pos"))
 				{
 					LL_WARNS() << "can't read pos in position key (" << k << ")" << LL_ENDL;
 					delete mJointMotionList;
 					return FALSE;
 				}
-                
-                //MAINT-6162
-                pos_key.mPosition.mV[VX] = llclamp( pos_key.mPosition.mV[VX], -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET);
-                pos_key.mPosition.mV[VY] = llclamp( pos_key.mPosition.mV[VY], -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET);
-                pos_key.mPosition.mV[VZ] = llclamp( pos_key.mPosition.mV[VZ], -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET);
-                
+				if( !(position.isFinite()) )
+				{
+					LL_WARNS() << "non-finite position in key (" << k << ")" << LL_ENDL;
+					delete mJointMotionList;
+					return FALSE;
+				}
+
+				//MAINT-6162, the clamp comes with the quantization
+				x = F32_to_U16_ROUND(position.mV[VX], -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET);
+				y = F32_to_U16_ROUND(position.mV[VY], -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET);
+				z = F32_to_U16_ROUND(position.mV[VZ], -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET);
 			}
 			else
 			{
-				U16 x, y, z;
-
 				if (!dp.unpackU16(x, "pos_x"))
 				{
 					LL_WARNS() << "can't read pos_x in position key (" << k << ")" << LL_ENDL;
@@ -1759,26 +1707,16 @@ BOOL LLKeyframeMotion::deserialize(LLDataPacker& dp)
 					delete mJointMotionList;
 					return FALSE;
 				}
-
-				pos_key.mPosition.mV[VX] = U16_to_F32(x, -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET);
-				pos_key.mPosition.mV[VY] = U16_to_F32(y, -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET);
-				pos_key.mPosition.mV[VZ] = U16_to_F32(z, -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET);
 			}
-			
-			if( !(pos_key.mPosition.isFinite()) )
-			{
-				LL_WARNS() << "non-finite position in key (" << k << ")" << LL_ENDL;
-				delete mJointMotionList;
-				return FALSE;
-			}
-			
-			pCurve->mKeys[pos_key.mTime] = pos_key;
+
+			pCurve->addKey(time_short, x, y, z);
 
 			if (is_pelvis)
 			{
-				mJointMotionList->mPelvisBBox.addPoint(pos_key.mPosition);
+				mJointMotionList->mPelvisBBox.addPoint(PositionCurve::getPosition(pCurve->getKey(pCurve->getNumKeys() - 1)));
 			}
 		}
+		pCurve->finish();
 
 		joint_motion->mUsage = joint_state->getUsage();
 	}
@@ -2057,48 +1995,31 @@ BOOL LLKeyframeMotion::serialize(LLDataPacker& dp) const
 		JointMotion* joint_motionp = mJointMotionList->getJointMotion(i);
 		success &= dp.packString(joint_motionp->mJointName, "joint_name");
 		success &= dp.packS32(joint_motionp->mPriority, "joint_priority");
-		success &= dp.packS32(joint_motionp->mRotationCurve.mNumKeys, "num_rot_keys");
+		success &= dp.packS32(joint_motionp->mRotationCurve.getNumKeys(), "num_rot_keys");
 
 		LL_DEBUGS("BVH") << "Joint " << joint_motionp->mJointName << LL_ENDL;
-		for (RotationCurve::key_map_t::iterator iter = joint_motionp->mRotationCurve.mKeys.begin();
-			 iter != joint_motionp->mRotationCurve.mKeys.end(); ++iter)
+		// keys are kept as they are packed
+		for (S32 k = 0; k < joint_motionp->mRotationCurve.getNumKeys(); ++k)
 		{
-			RotationKey& rot_key = iter->second;
-			U16 time_short = F32_to_U16(rot_key.mTime, 0.f, mJointMotionList->mDuration);
-			success &= dp.packU16(time_short, "time");
+			const KeyframeCurve::Key& rot_key = joint_motionp->mRotationCurve.getKey(k);
+			success &= dp.packU16(rot_key.mTime, "time");
+			success &= dp.packU16(rot_key.mValue[VX], "rot_angle_x");
+			success &= dp.packU16(rot_key.mValue[VY], "rot_angle_y");
+			success &= dp.packU16(rot_key.mValue[VZ], "rot_angle_z");
 
-			LLVector3 rot_angles = rot_key.mRotation.packToVector3();
-			
-			U16 x, y, z;
-			rot_angles.quantize16(-1.f, 1.f, -1.f, 1.f);
-			x = F32_to_U16(rot_angles.mV[VX], -1.f, 1.f);
-			y = F32_to_U16(rot_angles.mV[VY], -1.f, 1.f);
-			z = F32_to_U16(rot_angles.mV[VZ], -1.f, 1.f);
-			success &= dp.packU16(x, "rot_angle_x");
-			success &= dp.packU16(y, "rot_angle_y");
-			success &= dp.packU16(z, "rot_angle_z");
-
-			LL_DEBUGS("BVH") << "  rot: t " << rot_key.mTime << " angles " << rot_angles.mV[VX] <<","<< rot_angles.mV[VY] <<","<< rot_angles.mV[VZ] << LL_ENDL;
+			LL_DEBUGS("BVH") << "  rot: t " << key_time(rot_key.mTime, mJointMotionList->mDuration) << " rot " << RotationCurve::getRotation(rot_key) << LL_ENDL;
 		}
 
-		success &= dp.packS32(joint_motionp->mPositionCurve.mNumKeys, "num_pos_keys");
-		for (PositionCurve::key_map_t::iterator iter = joint_motionp->mPositionCurve.mKeys.begin();
-			 iter != joint_motionp->mPositionCurve.mKeys.end(); ++iter)
+		success &= dp.packS32(joint_motionp->mPositionCurve.getNumKeys(), "num_pos_keys");
+		for (S32 k = 0; k < joint_motionp->mPositionCurve.getNumKeys(); ++k)
 		{
-			PositionKey& pos_key = iter->second;
-			U16 time_short = F32_to_U16(pos_key.mTime, 0.f, mJointMotionList->mDuration);
-			success &= dp.packU16(time_short, "time");
+			const KeyframeCurve::Key& pos_key = joint_motionp->mPositionCurve.getKey(k);
+			success &= dp.packU16(pos_key.mTime, "time");
+			success &= dp.packU16(pos_key.mValue[VX], "pos_x");
+			success &= dp.packU16(pos_key.mValue[VY], "pos_y");
+			success &= dp.packU16(pos_key.mValue[VZ], "pos_z");
 
-			U16 x, y, z;
-			pos_key.mPosition.quantize16(-LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET, -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET);
-			x = F32_to_U16(pos_key.mPosition.mV[VX], -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET);
-			y = F32_to_U16(pos_key.mPosition.mV[VY], -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET);
-			z = F32_to_U16(pos_key.mPosition.mV[VZ], -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET);
-			success &= dp.packU16(x, "pos_x");
-			success &= dp.packU16(y, "pos_y");
-			success &= dp.packU16(z, "pos_z");
-
-			LL_DEBUGS("BVH") << "  pos: t " << pos_key.mTime << " pos " << pos_key.mPosition.mV[VX] <<","<< pos_key.mPosition.mV[VY] <<","<< pos_key.mPosition.mV[VZ] << LL_ENDL;
+			LL_DEBUGS("BVH") << "  pos: t " << key_time(pos_key.mTime, mJointMotionList->mDuration) << " pos " << PositionCurve::getPosition(pos_key) << LL_ENDL;
 		}
 	}	
 
@@ -2306,24 +2227,6 @@ void LLKeyframeMotion::setLoopIn(F32 in_point)
 	if (mJointMotionList)
 	{
 		mJointMotionList->mLoopInPoint = in_point; 
-		
-		// set up loop keys
-		for (U32 i = 0; i < mJointMotionList->getNumJointMotions(); i++)
-		{
-			JointMotion* joint_motion = mJointMotionList->getJointMotion(i);
-			
-			PositionCurve* pos_curve = &joint_motion->mPositionCurve;
-			RotationCurve* rot_curve = &joint_motion->mRotationCurve;
-			ScaleCurve* scale_curve = &joint_motion->mScaleCurve;
-			
-			pos_curve->mLoopInKey.mTime = mJointMotionList->mLoopInPoint;
-			rot_curve->mLoopInKey.mTime = mJointMotionList->mLoopInPoint;
-			scale_curve->mLoopInKey.mTime = mJointMotionList->mLoopInPoint;
-
-			pos_curve->mLoopInKey.mPosition = pos_curve->getValue(mJointMotionList->mLoopInPoint, mJointMotionList->mDuration);
-			rot_curve->mLoopInKey.mRotation = rot_curve->getValue(mJointMotionList->mLoopInPoint, mJointMotionList->mDuration);
-			scale_curve->mLoopInKey.mScale = scale_curve->getValue(mJointMotionList->mLoopInPoint, mJointMotionList->mDuration);
-		}
 	}
 }
 
@@ -2335,24 +2238,6 @@ void LLKeyframeMotion::setLoopOut(F32 out_point)
 	if (mJointMotionList)
 	{
 		mJointMotionList->mLoopOutPoint = out_point; 
-		
-		// set up loop keys
-		for (U32 i = 0; i < mJointMotionList->getNumJointMotions(); i++)
-		{
-			JointMotion* joint_motion = mJointMotionList->getJointMotion(i);
-			
-			PositionCurve* pos_curve = &joint_motion->mPositionCurve;
-			RotationCurve* rot_curve = &joint_motion->mRotationCurve;
-			ScaleCurve* scale_curve = &joint_motion->mScaleCurve;
-			
-			pos_curve->mLoopOutKey.mTime = mJointMotionList->mLoopOutPoint;
-			rot_curve->mLoopOutKey.mTime = mJointMotionList->mLoopOutPoint;
-			scale_curve->mLoopOutKey.mTime = mJointMotionList->mLoopOutPoint;
-
-			pos_curve->mLoopOutKey.mPosition = pos_curve->getValue(mJointMotionList->mLoopOutPoint, mJointMotionList->mDuration);
-			rot_curve->mLoopOutKey.mRotation = rot_curve->getValue(mJointMotionList->mLoopOutPoint, mJointMotionList->mDuration);
-			scale_curve->mLoopOutKey.mScale = scale_curve->getValue(mJointMotionList->mLoopOutPoint, mJointMotionList->mDuration);
-		}
 	}
 }
 
@@ -2394,6 +2279,12 @@ void LLKeyframeMotion::onLoadComplete(LLVFS *vfs,
 				// asset already loaded
 				return;
 			}
+			if (JointMotionList* joint_motion_list = LLKeyframeDataCache::getKeyframeData(asset_uuid))
+			{
+				// another character's request decoded it meanwhile
+				motionp->setJointMotionList(joint_motion_list);
+				return;
+			}
 			LLVFile file(vfs, asset_uuid, type, LLVFile::READ);
 			S32 size = file.getSize();
 			
@@ -2491,6 +2382,20 @@ void LLKeyframeDataCache::addKeyframeData(const LLUUID& id, LLKeyframeMotion::Jo
 	sKeyframeDataMap[id] = joint_motion_listp;
 }
 
+//--------------------------------------------------------------------
+// LLKeyframeDataCache::getMemoryUsage()
+//--------------------------------------------------------------------
+U32 LLKeyframeDataCache::getMemoryUsage()
+{
+	U32 total_size = 0;
+	for (keyframe_data_map_t::const_iterator map_it = sKeyframeDataMap.begin();
+		 map_it != sKeyframeDataMap.end(); ++map_it)
+	{
+		total_size += map_it->second->getMemoryUsage();
+	}
+	return total_size;
+}
+
 //--------------------------------------------------------------------
 // LLKeyframeDataCache::removeKeyframeData()
 //--------------------------------------------------------------------
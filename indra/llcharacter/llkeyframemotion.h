@@ -37,6 +37,7 @@
 #include "lljointstate.h"
 #include "llmotion.h"
 #include "llquaternion.h"
+#include "lluuidhashmap.h"
 #include "v3dmath.h"
 #include "v3math.h"
 #include "llbvhconsts.h"
@@ -142,6 +143,9 @@ public:
 	// called when a motion is deactivated
 	void onDeactivate() override;
 
+	// not with ground constraints, they look for the ground among objects
+	BOOL canUpdateOffThread() override;
+
 	void setStopTime(F32 time) override;
 
 	static void setVFS(LLVFS* vfs) { sVFS = vfs; }
@@ -159,7 +163,8 @@ public:
     void	dumpToFile(const std::string& name);
 
 
-	// setters for modifying a keyframe animation
+	// setters for modifying a keyframe animation, they change the data
+	// cached for every instance of it so are only for uploads
 	void setLoop(BOOL loop);
 
 	F32 getLoopIn() {
@@ -274,102 +279,61 @@ protected:
 public:
 	enum AssetStatus { ASSET_LOADED, ASSET_FETCHED, ASSET_NEEDS_FETCH, ASSET_FETCH_FAILED, ASSET_UNDEFINED };
 
-	enum InterpolationType { IT_STEP, IT_LINEAR, IT_SPLINE };
-
 	//-------------------------------------------------------------------------
-	// ScaleKey
+	// KeyframeCurve
+	// Keys stay quantized as they are in the asset, sorted by time.  mIndex
+	// holds the first key of each of a power of two number of slices of the
+	// quantized time range, about one per key, so the keys around any time
+	// are a step or two from its slice.
 	//-------------------------------------------------------------------------
-	class ScaleKey
+	class KeyframeCurve
 	{
 	public:
-		ScaleKey() { mTime = 0.0f; }
-		ScaleKey(F32 time, const LLVector3 &scale) : mTime(time), mScale(scale) {}
-
-		F32			mTime;
-		LLVector3	mScale;
-	};
-
-	//-------------------------------------------------------------------------
-	// RotationKey
-	//-------------------------------------------------------------------------
-	class RotationKey
-	{
-	public:
-		RotationKey() { mTime = 0.0f; }
-		RotationKey(F32 time, const LLQuaternion &rotation) : mTime(time), mRotation(rotation) {}
-
-		F32				mTime;
-		LLQuaternion	mRotation;
-	};
-
-	//-------------------------------------------------------------------------
-	// PositionKey
-	//-------------------------------------------------------------------------
-	class PositionKey
-	{
-	public:
-		PositionKey() { mTime = 0.0f; }
-		PositionKey(F32 time, const LLVector3 &position) : mTime(time), mPosition(position) {}
-
-		F32			mTime;
-		LLVector3	mPosition;
-	};
-
-	//-------------------------------------------------------------------------
-	// ScaleCurve
-	//-------------------------------------------------------------------------
-	class ScaleCurve
-	{
-	public:
-		ScaleCurve();
-		~ScaleCurve();
-		LLVector3 getValue(F32 time, F32 duration);
-		LLVector3 interp(F32 u, ScaleKey& before, ScaleKey& after);
-
-		InterpolationType	mInterpolationType;
-		S32					mNumKeys;
-		typedef std::map<F32, ScaleKey> key_map_t;
-		key_map_t 			mKeys;
-		ScaleKey			mLoopInKey;
-		ScaleKey			mLoopOutKey;
+		struct Key
+		{
+			U16		mTime;
+			U16		mValue[3];
+		};
+
+		KeyframeCurve() : mIndexShift(16) {}
+
+		S32 getNumKeys() const { return (S32)mKeys.size(); }
+		const Key& getKey(S32 index) const { return mKeys[index]; }
+		U32 getMemoryUsage() const;
+
+		void addKey(U16 time, U16 x, U16 y, U16 z);
+		// Sorts the keys, the last of several at the same time wins, and
+		// builds the index.  The curve doesn't change after this.
+		void finish();
+
+	protected:
+		// The keys either side of time and how far it is between them, the
+		// same key on a key, before the first or past the last
+		void findKeys(F32 time, F32 duration, S32& before, S32& after, F32& u) const;
+
+		std::vector<Key>	mKeys;
+		std::vector<U32>	mIndex;
+		U32					mIndexShift;
 	};
 
 	//-------------------------------------------------------------------------
 	// RotationCurve
 	//-------------------------------------------------------------------------
-	class RotationCurve
+	class RotationCurve : public KeyframeCurve
 	{
 	public:
-		RotationCurve();
-		~RotationCurve();
-		LLQuaternion getValue(F32 time, F32 duration);
-		LLQuaternion interp(F32 u, RotationKey& before, RotationKey& after);
-
-		InterpolationType	mInterpolationType;
-		S32					mNumKeys;
-		typedef std::map<F32, RotationKey> key_map_t;
-		key_map_t		mKeys;
-		RotationKey		mLoopInKey;
-		RotationKey		mLoopOutKey;
+		LLQuaternion getValue(F32 time, F32 duration) const;
+		static LLQuaternion getRotation(const Key& key);
 	};
 
 	//-------------------------------------------------------------------------
 	// PositionCurve
 	//-------------------------------------------------------------------------
-	class PositionCurve
+	class PositionCurve : public KeyframeCurve
 	{
 	public:
-		PositionCurve();
-		~PositionCurve();
-		LLVector3 getValue(F32 time, F32 duration);
-		LLVector3 interp(F32 u, PositionKey& before, PositionKey& after);
-
-		InterpolationType	mInterpolationType;
-		S32					mNumKeys;
-		typedef std::map<F32, PositionKey> key_map_t;
-		key_map_t		mKeys;
-		PositionKey		mLoopInKey;
-		PositionKey		mLoopOutKey;
+		LLVector3 getValue(F32 time, F32 duration) const;
+		static LLVector3 getPosition(const Key& key);
 	};
 
 	//-------------------------------------------------------------------------
@@ -380,12 +344,11 @@ public:
 	public:
 		PositionCurve	mPositionCurve;
 		RotationCurve	mRotationCurve;
-		ScaleCurve		mScaleCurve;
 		std::string		mJointName;
 		U32				mUsage;
 		LLJoint::JointPriority	mPriority;
 
-		void update(LLJointState* joint_state, F32 time, F32 duration);
+		void update(LLJointState* joint_state, F32 time, F32 duration) const;
 	};
 	
 	//-------------------------------------------------------------------------
@@ -415,12 +378,16 @@ public:
 		JointMotionList();
 		~JointMotionList();
 		U32 dumpDiagInfo(bool silent = false) const;
+		U32 getMemoryUsage() const;
 		JointMotion* getJointMotion(U32 index) const { llassert(index < mJointMotionArray.size()); return mJointMotionArray[index]; }
 		U32 getNumJointMotions() const { return mJointMotionArray.size(); }
 	};
 
 
 protected:
+	// Uses data already decoded for this animation
+	void	setJointMotionList(JointMotionList* joint_motion_list);
+
 	static LLVFS*				sVFS;
 
 	//-------------------------------------------------------------------------
@@ -445,7 +412,7 @@ public:
 	LLKeyframeDataCache(){};
 	~LLKeyframeDataCache();
 
-	typedef std::map<LLUUID, class LLKeyframeMotion::JointMotionList*> keyframe_data_map_t; 
+	typedef LLUUIDHashMap<LLKeyframeMotion::JointMotionList*> keyframe_data_map_t;
 	static keyframe_data_map_t sKeyframeDataMap;
 
 	static void addKeyframeData(const LLUUID& id, LLKeyframeMotion::JointMotionList*);
@@ -453,6 +420,9 @@ public:
 
 	static void removeKeyframeData(const LLUUID& id);
 
+	// Bytes held by the cached animations
+	static U32 getMemoryUsage();
+
 	//print out diagnostic info
 	static void dumpDiagInfo(int quiet = 0);	// singu: added param 'quiet'.
 	static void clear();
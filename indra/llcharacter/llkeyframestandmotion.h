@@ -65,6 +65,9 @@ public:
 	void	onDeactivate() override;
 	BOOL onUpdate(F32 time, U8* joint_mask) override;
 
+	// looks for the ground under the feet
+	BOOL canUpdateOffThread() override { return FALSE; }
+
 public:
 	//-------------------------------------------------------------------------
 	// Member Data
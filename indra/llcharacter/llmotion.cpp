@@ -176,4 +176,9 @@ BOOL LLMotion::canDeprecate()
 	return TRUE;
 }
 
+BOOL LLMotion::canUpdateOffThread()
+{
+	return FALSE;
+}
+
 // End
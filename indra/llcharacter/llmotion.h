@@ -151,6 +151,11 @@ public:
 	// requires this
 	virtual BOOL canDeprecate();
 
+	// can onUpdate() run on a worker thread, alongside other characters?
+	// only if it touches nothing but this motion, its character's joints
+	// and animation data, and the world read only without ray casts
+	virtual BOOL canUpdateOffThread();
+
 	// optional callback routine called when animation deactivated.
 	void	setDeactivateCallback( void (*cb)(void *), void* userdata );
 
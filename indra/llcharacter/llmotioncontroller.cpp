@@ -147,6 +147,8 @@ LLMotionController::LLMotionController()
 	  mTimeStep(0.f),
 	  mTimeStepCount(0),
 	  mLastInterp(0.f),
+	  mDeferredBlend(NO_BLEND),
+	  mDeferring(false),
 	  mLastCountAfterPurge(0)
 {
 }
@@ -175,6 +177,8 @@ void LLMotionController::incMotionCounts(S32& num_motions, S32& num_loading_moti
 //-----------------------------------------------------------------------------
 void LLMotionController::deleteAllMotions()
 {
+	mDeferredUpdates.clear();
+	mDeferredBlend = NO_BLEND;
 	mLoadingMotions.clear();
 	mLoadedMotions.clear();
 	mActiveMotions.clear();
@@ -341,6 +345,7 @@ void LLMotionController::removeMotionInstance(LLMotion* motionp)
 		llassert(findMotion(motionp->getID()) != motionp);
 		if (motionp->isActive())
 			motionp->deactivate();
+		removeDeferredUpdate(motionp);
 		mLoadingMotions.erase(motionp);
 		mLoadedMotions.erase(motionp);
 		mActiveMotions.remove(motionp);
@@ -556,6 +561,40 @@ void LLMotionController::updateIdleActiveMotions()
 	}
 }
 
+//-----------------------------------------------------------------------------
+// runMotion()
+// calls onUpdate(), or leaves it for evaluateMotions() if it can wait
+//-----------------------------------------------------------------------------
+BOOL LLMotionController::runMotion(LLMotion* motionp, F32 time, U8* joint_mask)
+{
+	if (mDeferring && motionp->canUpdateOffThread())
+	{
+		DeferredUpdate update = { motionp, time, TRUE };
+		mDeferredUpdates.push_back(update);
+		return TRUE;
+	}
+	return motionp->onUpdate(time, joint_mask);
+}
+
+//-----------------------------------------------------------------------------
+// removeDeferredUpdate()
+//-----------------------------------------------------------------------------
+void LLMotionController::removeDeferredUpdate(LLMotion* motionp)
+{
+	for (std::vector<DeferredUpdate>::iterator iter = mDeferredUpdates.begin();
+		 iter != mDeferredUpdates.end(); )
+	{
+		if (iter->mMotion == motionp)
+		{
+			iter = mDeferredUpdates.erase(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+}
+
 //-----------------------------------------------------------------------------
 // updateMotionsByType()
 //-----------------------------------------------------------------------------
@@ -663,7 +702,7 @@ void LLMotionController::updateMotionsByType(LLMotion::LLMotionBlendType anim_ty
 				// if not, let's stop it this time through and deactivate it the next
 
 				posep->setWeight(motionp->getFadeWeight());
-				motionp->onUpdate(motionp->getStopTime() - motionp->mActivationTimestamp, last_joint_signature);
+				runMotion(motionp, motionp->getStopTime() - motionp->mActivationTimestamp, last_joint_signature);
 			}
 			else
 			{
@@ -695,7 +734,7 @@ void LLMotionController::updateMotionsByType(LLMotion::LLMotionBlendType anim_ty
 			}
 
 			// perform motion update
-			update_result = motionp->onUpdate(mAnimTime - motionp->mActivationTimestamp, last_joint_signature);
+			update_result = runMotion(motionp, mAnimTime - motionp->mActivationTimestamp, last_joint_signature);
 		}
 
 		//**********************
@@ -720,7 +759,7 @@ void LLMotionController::updateMotionsByType(LLMotion::LLMotionBlendType anim_ty
 			// perform motion update
 			{
 				LL_RECORD_BLOCK_TIME(FTM_MOTION_ON_UPDATE);
-				update_result = motionp->onUpdate(mAnimTime - motionp->mActivationTimestamp, last_joint_signature);
+				update_result = runMotion(motionp, mAnimTime - motionp->mActivationTimestamp, last_joint_signature);
 			}
 		}
 
@@ -743,12 +782,12 @@ void LLMotionController::updateMotionsByType(LLMotion::LLMotionBlendType anim_ty
 				posep->setWeight(motionp->getFadeWeight() * motionp->mResidualWeight + (1.f - motionp->mResidualWeight) * cubic_step((mAnimTime - motionp->mActivationTimestamp) / motionp->getEaseInDuration()));
 			}
 			// perform motion update
-			update_result = motionp->onUpdate(mAnimTime - motionp->mActivationTimestamp, last_joint_signature);
+			update_result = runMotion(motionp, mAnimTime - motionp->mActivationTimestamp, last_joint_signature);
 		}
 		else
 		{
 			posep->setWeight(0.f);
-			update_result = motionp->onUpdate(0.f, last_joint_signature);
+			update_result = runMotion(motionp, 0.f, last_joint_signature);
 		}
 		
 		// allow motions to deactivate themselves 
@@ -820,10 +859,14 @@ void LLMotionController::updateLoadingMotions()
 //-----------------------------------------------------------------------------
 // updateMotion()
 //-----------------------------------------------------------------------------
-void LLMotionController::updateMotions(bool force_update)
+void LLMotionController::updateMotions(bool force_update, bool deferred)
 {
 	BOOL use_quantum = (mTimeStep != 0.f);
 
+	// Drop whatever an earlier deferred update never got to
+	mDeferredUpdates.clear();
+	mDeferredBlend = NO_BLEND;
+
 	// Always update mPrevTimerElapsed
 	F32 cur_time = mTimer.getElapsedTimeF32();
 	F32 delta_time = cur_time - mPrevTimerElapsed;
@@ -889,6 +932,8 @@ void LLMotionController::updateMotions(bool force_update)
 	}
 	else
 	{
+		mDeferring = deferred;
+
 		// update additive motions
 		updateAdditiveMotions();
 				
@@ -896,8 +941,14 @@ void LLMotionController::updateMotions(bool force_update)
 		
 		// update all regular motions
 		updateRegularMotions();
+
+		mDeferring = false;
 		
-		if (use_quantum)
+		if (deferred)
+		{
+			mDeferredBlend = use_quantum ? BLEND_AND_CACHE : BLEND_AND_APPLY;
+		}
+		else if (use_quantum)
 		{
 			mPoseBlender.blendAndCache(TRUE);
 		}
@@ -911,6 +962,50 @@ void LLMotionController::updateMotions(bool force_update)
 //	LL_INFOS() << "Motion controller time " << motionTimer.getElapsedTimeF32() << LL_ENDL;
 }
 
+//-----------------------------------------------------------------------------
+// evaluateMotions()
+//-----------------------------------------------------------------------------
+void LLMotionController::evaluateMotions()
+{
+	for (std::vector<DeferredUpdate>::iterator iter = mDeferredUpdates.begin();
+		 iter != mDeferredUpdates.end(); ++iter)
+	{
+		iter->mResult = iter->mMotion->onUpdate(iter->mTime, mJointSignature[1]);
+	}
+
+	if (mDeferredBlend == BLEND_AND_CACHE)
+	{
+		mPoseBlender.blendAndCache(TRUE);
+	}
+	else if (mDeferredBlend == BLEND_AND_APPLY)
+	{
+		mPoseBlender.blendAndApply();
+	}
+	mDeferredBlend = NO_BLEND;
+}
+
+//-----------------------------------------------------------------------------
+// finishMotions()
+//-----------------------------------------------------------------------------
+void LLMotionController::finishMotions()
+{
+	// Take the list first, stopping a motion can remove it
+	std::vector<DeferredUpdate> updates;
+	updates.swap(mDeferredUpdates);
+
+	for (std::vector<DeferredUpdate>::iterator iter = updates.begin();
+		 iter != updates.end(); ++iter)
+	{
+		LLMotion* motionp = iter->mMotion;
+		// allow motions to deactivate themselves, as in updateMotionsByType()
+		if (!iter->mResult && (!motionp->isStopped() || motionp->getStopTime() > mAnimTime))
+		{
+			mCharacter->requestStopMotion( motionp );
+			stopMotionInstance(motionp, FALSE);
+		}
+	}
+}
+
 //-----------------------------------------------------------------------------
 // updateMotionsMinimal()
 // minimal update (e.g. while hidden)
@@ -999,6 +1094,7 @@ BOOL LLMotionController::activateMotionInstance(LLMotion *motion, F32 time)
 BOOL LLMotionController::deactivateMotionInstance(LLMotion *motion)
 {
 	motion->deactivate();
+	removeDeferredUpdate(motion);
 
 	motion_set_t::iterator found_it = mDeprecatedMotions.find(motion);
 	if (found_it != mDeprecatedMotions.end())
@@ -126,7 +126,16 @@ public:
 	// invokes the update handlers for each active motion
 	// activates sequenced motions
 	// deactivates terminated motions`
-	void updateMotions(bool force_update = false);
+	// when deferred, the motions that can update off thread and the pose
+	// blend are left for evaluateMotions() and finishMotions()
+	void updateMotions(bool force_update = false, bool deferred = false);
+
+	// runs the deferred part of updateMotions(), possibly on a worker
+	// thread; characters can be evaluated in parallel, one thread each
+	void evaluateMotions();
+
+	// back on the main thread, stops the deferred motions that ended
+	void finishMotions();
 
 	// minimal update (e.g. while hidden)
 	void updateMotionsMinimal();
@@ -179,6 +188,8 @@ protected:
 	void updateAdditiveMotions();
 	void resetJointSignatures();
 	void updateMotionsByType(LLMotion::LLMotionBlendType motion_type);
+	BOOL runMotion(LLMotion* motionp, F32 time, U8* joint_mask);
+	void removeDeferredUpdate(LLMotion* motionp);
 	void updateIdleMotion(LLMotion* motionp);
 	void updateIdleActiveMotions();
 	void purgeExcessMotions();
@@ -220,6 +231,23 @@ protected:
 	F32					mLastInterp;
 
 	U8					mJointSignature[2][LL_CHARACTER_MAX_ANIMATED_JOINTS];
+
+	// Left by a deferred updateMotions()
+	struct DeferredUpdate
+	{
+		LLMotion*	mMotion;
+		F32			mTime;
+		BOOL		mResult;
+	};
+	enum EDeferredBlend
+	{
+		NO_BLEND,
+		BLEND_AND_CACHE,
+		BLEND_AND_APPLY
+	};
+	std::vector<DeferredUpdate> mDeferredUpdates;
+	EDeferredBlend		mDeferredBlend;
+	bool				mDeferring;
 private:
 	U32					mLastCountAfterPurge; //for logging and debugging purposes
 };
@@ -141,6 +141,12 @@
 //
 // I fixed updateCachedPointers() to correct all of the above pointers and removed
 // another FrameState pointer that was unnecessary.
+//
+// sCurTimerData is thread local.  On the main thread the stack bottoms out at
+// mAppTimer and everything above works as described.  Other threads start with
+// an empty CurTimerData, whose NULL mFrameState keeps their LLFastTimer objects
+// away from the FrameState objects altogether; their stacks only feed the trace
+// (see startTrace()), which records the timers of every thread.
 
 #include "linden_common.h"
 
@@ -153,11 +159,13 @@
 #include "llsdserialize.h"
 #include "llunits.h"
 #include "llsd.h"
+#include "llfile.h"
 //#include "lltracerecording.h"
 //#include "lltracethreadrecorder.h"
 #include "lltraceaccumulators.h"
 #include "namedtimerfactory.h"
 
+#include <algorithm>
 #include <boost/bind.hpp>
 
 
@@ -183,7 +191,8 @@ S32 LLFastTimer::sLastFrameIndex = -1;
 U64 LLFastTimer::sLastFrameTime = LLFastTimer::getCPUClockCount64();
 bool LLFastTimer::sPauseHistory = 0;
 bool LLFastTimer::sResetHistory = 0;
-LLFastTimer::CurTimerData LLFastTimer::sCurTimerData;
+thread_local LLFastTimer::CurTimerData LLFastTimer::sCurTimerData;
+std::atomic<bool> LLFastTimer::sTraceEnabled(false);
 bool LLFastTimer::sLog = false;
 std::string LLFastTimer::sLogName = "";
 bool LLFastTimer::sMetricLog = false;
@@ -310,7 +319,8 @@ void LLFastTimer::updateCachedPointers()
 	CurTimerData* cur_timer_data = &LLFastTimer::sCurTimerData;
 	// If the the following condition holds then cur_timer_data->mCurTimer == mAppTimer and
 	// we can stop since mAppTimer->mFrameState is allocated with new and does not invalidate.
-	while(cur_timer_data->mFrameState != &root_frame_state)
+	// Another thread's stack holds no FrameState pointers.
+	while(cur_timer_data->mFrameState && cur_timer_data->mFrameState != &root_frame_state)
 	{
 		cur_timer_data->mFrameState = cur_timer_data->mCurTimer->mFrameState = &cur_timer_data->mNamedTimer->getFrameState();
 		cur_timer_data = &cur_timer_data->mCurTimer->mLastTimerData;
@@ -868,12 +878,339 @@ LLFastTimer::LLFastTimer(LLFastTimer::FrameState* state)
 	LLFastTimer::sCurTimerData.mNamedTimer = mFrameState->mTimer;
 	LLFastTimer::sCurTimerData.mFrameState = mFrameState;
 	LLFastTimer::sCurTimerData.mChildTime = 0;
+	mTraceStartTime = 0;
 	// This is the root FastTimer (mAppTimer), mark it as such by having
 	// mLastTimerData be equal to sCurTimerData (which is a rather arbitrary
 	// and not very logical way to do that --Aleric).
 	mLastTimerData = LLFastTimer::sCurTimerData;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// Trace
+//
+
+namespace
+{
+	struct TraceEvent
+	{
+		const LLFastTimer::NamedTimer*	mTimer;
+		U64								mStartTime;
+		U64								mEndTime;
+	};
+
+	// Events of one thread.  Only that thread adds to the ring and only the
+	// main thread takes out of it, so neither side needs a lock.
+	class TraceBuffer
+	{
+	public:
+		static const U32 SIZE = 16384;	// power of two
+
+		TraceBuffer(U32 id, const std::string& name)
+		:	mID(id),
+			mName(name),
+			mDropped(0),
+			mEvents(new TraceEvent[SIZE]),
+			mHead(0),
+			mTail(0)
+		{
+		}
+
+		~TraceBuffer()
+		{
+			delete[] mEvents;
+		}
+
+		void push(const TraceEvent& event)
+		{
+			U32 head = mHead.load(std::memory_order_relaxed);
+			if (head - mTail.load(std::memory_order_acquire) >= SIZE)
+			{
+				// Losing events beats stalling the thread being watched
+				mDropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			mEvents[head & (SIZE - 1)] = event;
+			mHead.store(head + 1, std::memory_order_release);
+		}
+
+		// Main thread, or the owning thread once it is done pushing; with
+		// get_trace_mutex() held either way
+		void collect()
+		{
+			U32 tail = mTail.load(std::memory_order_relaxed);
+			const U32 head = mHead.load(std::memory_order_acquire);
+			for ( ; tail != head; ++tail)
+			{
+				mCollected.push_back(mEvents[tail & (SIZE - 1)]);
+			}
+			mTail.store(tail, std::memory_order_release);
+		}
+
+		// Main thread only
+		void discard()
+		{
+			mTail.store(mHead.load(std::memory_order_acquire), std::memory_order_release);
+			mCollected.clear();
+			mDropped.store(0, std::memory_order_relaxed);
+		}
+
+		// Called with get_trace_mutex() held by the owning thread as it
+		// exits: keeps what it recorded and frees the ring, which nothing
+		// pushes to any more
+		void retire()
+		{
+			collect();
+			delete[] mEvents;
+			mEvents = NULL;
+		}
+
+		bool isRetired() const				{ return mEvents == NULL; }
+
+		const U32				mID;
+		std::string				mName;			// guarded by get_trace_mutex()
+		std::vector<TraceEvent>	mCollected;		// guarded by get_trace_mutex()
+		std::atomic<U32>		mDropped;
+
+	private:
+		TraceEvent*				mEvents;
+		alignas(64) std::atomic<U32> mHead;
+		alignas(64) std::atomic<U32> mTail;
+	};
+
+	// Never destroyed, threads may still be timing things during shutdown
+	LLMutex* get_trace_mutex()
+	{
+		static LLMutex* sMutex = new LLMutex();
+		return sMutex;
+	}
+
+	std::vector<TraceBuffer*>& get_trace_buffers()
+	{
+		static std::vector<TraceBuffer*>* sBuffers = new std::vector<TraceBuffer*>;
+		return *sBuffers;
+	}
+
+	// Hands the buffer of a thread back when the thread exits, so threads
+	// that come and go don't each leave a ring behind.  A retired buffer
+	// with events for the running trace stays until the trace is written.
+	struct ThreadTraceBuffer
+	{
+		TraceBuffer* mBuffer = NULL;
+
+		~ThreadTraceBuffer()
+		{
+			if (!mBuffer)
+			{
+				return;
+			}
+			LLMutexLock lock(get_trace_mutex());
+			mBuffer->retire();
+			if (!LLFastTimer::isTracing() || (mBuffer->mCollected.empty() && !mBuffer->mDropped.load(std::memory_order_relaxed)))
+			{
+				std::vector<TraceBuffer*>& buffers = get_trace_buffers();
+				buffers.erase(std::find(buffers.begin(), buffers.end(), mBuffer));
+				delete mBuffer;
+			}
+			mBuffer = NULL;
+		}
+	};
+
+	// Called with get_trace_mutex() held
+	void delete_retired_trace_buffers()
+	{
+		std::vector<TraceBuffer*>& buffers = get_trace_buffers();
+		std::vector<TraceBuffer*>::iterator it = buffers.begin();
+		while (it != buffers.end())
+		{
+			if ((*it)->isRetired())
+			{
+				delete *it;
+				it = buffers.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	thread_local ThreadTraceBuffer sThreadTraceBuffer;
+	U32 sNextTraceThreadID = 1;		// guarded by get_trace_mutex()
+	thread_local std::string sThreadName;
+
+	U64 sTraceStartTime = 0;
+
+	// getCPUClockCount64() counts per second
+	F64 trace_clock_frequency()
+	{
+#if USE_RDTSC
+		return LLProcessorInfo().getCPUFrequency() * 1000000.0;
+#else
+		return 1000000.0;	// get_clock_count() is in microseconds
+#endif
+	}
+
+	void write_json_string(std::ostream& os, const std::string& str)
+	{
+		os << '"';
+		for (std::string::const_iterator it = str.begin(); it != str.end(); ++it)
+		{
+			const unsigned char c = *it;
+			if (c == '"' || c == '\\')
+			{
+				os << '\\' << c;
+			}
+			else if (c < 0x20)
+			{
+				os << llformat("\\u%04x", c);
+			}
+			else
+			{
+				os << c;
+			}
+		}
+		os << '"';
+	}
+}
+
+//static
+void LLFastTimer::pushTraceEvent(const NamedTimer* timer, U64 start_time)
+{
+	TraceEvent event;
+	event.mTimer = timer;
+	event.mStartTime = start_time;
+	event.mEndTime = getCPUClockCount64();
+
+	TraceBuffer*& buffer = sThreadTraceBuffer.mBuffer;
+	if (!buffer)
+	{
+		LLMutexLock lock(get_trace_mutex());
+		const U32 id = sNextTraceThreadID++;
+		buffer = new TraceBuffer(id, sThreadName.empty() ? llformat("Thread %u", id) : sThreadName);
+		get_trace_buffers().push_back(buffer);
+	}
+	buffer->push(event);
+}
+
+//static
+void LLFastTimer::setThreadName(const std::string& name)
+{
+	sThreadName = name;
+	if (sThreadTraceBuffer.mBuffer)
+	{
+		LLMutexLock lock(get_trace_mutex());
+		sThreadTraceBuffer.mBuffer->mName = name;
+	}
+}
+
+//static
+void LLFastTimer::startTrace()
+{
+	if (isTracing())
+	{
+		return;
+	}
+	if (sThreadName.empty())
+	{
+		setThreadName("Main");
+	}
+
+	{
+		LLMutexLock lock(get_trace_mutex());
+		delete_retired_trace_buffers();
+		std::vector<TraceBuffer*>& buffers = get_trace_buffers();
+		for (std::vector<TraceBuffer*>::iterator it = buffers.begin(); it != buffers.end(); ++it)
+		{
+			(*it)->discard();
+		}
+	}
+	sTraceStartTime = getCPUClockCount64();
+	sTraceEnabled.store(true, std::memory_order_relaxed);
+	LL_INFOS() << "Fast timer trace started" << LL_ENDL;
+}
+
+//static
+void LLFastTimer::collectTrace()
+{
+	if (!isTracing())
+	{
+		return;
+	}
+	LLMutexLock lock(get_trace_mutex());
+	std::vector<TraceBuffer*>& buffers = get_trace_buffers();
+	for (std::vector<TraceBuffer*>::iterator it = buffers.begin(); it != buffers.end(); ++it)
+	{
+		(*it)->collect();
+	}
+}
+
+//static
+bool LLFastTimer::stopTrace(const std::string& filename)
+{
+	if (!isTracing())
+	{
+		return false;
+	}
+	collectTrace();
+	sTraceEnabled.store(false, std::memory_order_relaxed);
+
+	llofstream os(filename.c_str());
+	if (!os.is_open())
+	{
+		LL_WARNS() << "Unable to write fast timer trace to " << filename << LL_ENDL;
+		return false;
+	}
+
+	// Chrome's trace event format, which Perfetto reads as well; times in
+	// microseconds from the start of the trace
+	const F64 to_usec = 1000000.0 / trace_clock_frequency();
+	U32 event_count = 0;
+	U32 dropped = 0;
+	os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	os << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"viewer\"}}";
+
+	LLMutexLock lock(get_trace_mutex());
+	std::vector<TraceBuffer*>& buffers = get_trace_buffers();
+	for (std::vector<TraceBuffer*>::iterator it = buffers.begin(); it != buffers.end(); ++it)
+	{
+		TraceBuffer* buffer = *it;
+		os << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->mID << ",\"args\":{\"name\":";
+		write_json_string(os, buffer->mName);
+		os << "}}";
+
+		for (std::vector<TraceEvent>::const_iterator ev = buffer->mCollected.begin(); ev != buffer->mCollected.end(); ++ev)
+		{
+			// Events begun before the trace started are cut short
+			const U64 start_time = llmax(ev->mStartTime, sTraceStartTime);
+			if (ev->mEndTime < start_time)
+			{
+				continue;
+			}
+			os << ",\n{\"name\":";
+			write_json_string(os, ev->mTimer ? ev->mTimer->getName() : std::string("unknown"));
+			os << llformat(",\"cat\":\"fasttimer\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+						   buffer->mID,
+						   (F64)(start_time - sTraceStartTime) * to_usec,
+						   (F64)(ev->mEndTime - start_time) * to_usec);
+		}
+		event_count += (U32)buffer->mCollected.size();
+		dropped += buffer->mDropped.load(std::memory_order_relaxed);
+		buffer->discard();
+	}
+	os << "\n]}\n";
+	os.close();
+
+	const size_t thread_count = buffers.size();
+	delete_retired_trace_buffers();
+	LL_INFOS() << "Wrote " << event_count << " fast timer events from " << thread_count
+			   << " threads to " << filename << LL_ENDL;
+	if (dropped)
+	{
+		LL_WARNS() << dropped << " fast timer events were dropped, collectTrace() wasn't called often enough" << LL_ENDL;
+	}
+	return true;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // Important note: These implementations must be FAST!
@@ -29,10 +29,10 @@
 
 #define FAST_TIMER_ON 1
 #define TIME_FAST_TIMERS 0
-#define DEBUG_FAST_TIMER_THREADS 1
 
 class LLMutex;
 
+#include <atomic>
 #include <queue>
 #include "llinstancetracker.h"
 #include "llsd.h"
@@ -159,35 +159,43 @@ public:
 	LLFastTimer(LLFastTimer::FrameState* state);
 
 	LL_FORCE_INLINE LLFastTimer(LLFastTimer::DeclareTimer& timer)
-	:	mFrameState(timer.mFrameState)
 	{
 #if TIME_FAST_TIMERS
 		U64 timer_start = getCPUClockCount64();
 #endif
 #if FAST_TIMER_ON
-		LLFastTimer::FrameState* frame_state = mFrameState;
-		mStartTime = getCPUClockCount32();
-
-		frame_state->mActiveCount++;
-		frame_state->mCalls++;
-		// keep current parent as long as it is active when we are
-		frame_state->mMoveUpTree |= (frame_state->mParent->mActiveCount == 0);
-
 		LLFastTimer::CurTimerData* cur_timer_data = &LLFastTimer::sCurTimerData;
 		mLastTimerData = *cur_timer_data;
 		cur_timer_data->mCurTimer = this;
 		cur_timer_data->mNamedTimer = &timer.mTimer;
-		cur_timer_data->mFrameState = frame_state;
 		cur_timer_data->mChildTime = 0;
+
+		// Only the main thread's stack sits on the app timer's frame state,
+		// other threads keep a stack of their own for the trace and leave
+		// the frame states alone
+		if (mLastTimerData.mFrameState)
+		{
+			LLFastTimer::FrameState* frame_state = timer.mFrameState;
+			mFrameState = frame_state;
+			mStartTime = getCPUClockCount32();
+
+			frame_state->mActiveCount++;
+			frame_state->mCalls++;
+			// keep current parent as long as it is active when we are
+			frame_state->mMoveUpTree |= (frame_state->mParent->mActiveCount == 0);
+
+			cur_timer_data->mFrameState = frame_state;
+		}
+		else
+		{
+			mFrameState = NULL;
+		}
+
+		mTraceStartTime = sTraceEnabled.load(std::memory_order_relaxed) ? getCPUClockCount64() : 0;
 #endif
 #if TIME_FAST_TIMERS
 		U64 timer_end = getCPUClockCount64();
 		sTimerCycles += timer_end - timer_start;
-#endif
-#if DEBUG_FAST_TIMER_THREADS
-#if !LL_RELEASE
-		assert_main_thread();
-#endif
 #endif
 	}
 
@@ -197,18 +205,26 @@ public:
 		U64 timer_start = getCPUClockCount64();
 #endif
 #if FAST_TIMER_ON
+		if (mTraceStartTime)
+		{
+			pushTraceEvent(LLFastTimer::sCurTimerData.mNamedTimer, mTraceStartTime);
+		}
+
 		LLFastTimer::FrameState* frame_state = mFrameState;
-		U32 total_time = getCPUClockCount32() - mStartTime;
+		if (frame_state)
+		{
+			U32 total_time = getCPUClockCount32() - mStartTime;
 
-		frame_state->mSelfTimeCounter += total_time - LLFastTimer::sCurTimerData.mChildTime;
-		frame_state->mActiveCount--;
+			frame_state->mSelfTimeCounter += total_time - LLFastTimer::sCurTimerData.mChildTime;
+			frame_state->mActiveCount--;
 
-		// store last caller to bootstrap tree creation
-		// do this in the destructor in case of recursion to get topmost caller
-		frame_state->mLastCaller = mLastTimerData.mNamedTimer;
+			// store last caller to bootstrap tree creation
+			// do this in the destructor in case of recursion to get topmost caller
+			frame_state->mLastCaller = mLastTimerData.mNamedTimer;
 
-		// we are only tracking self time, so subtract our total time delta from parents
-		mLastTimerData.mChildTime += total_time;
+			// we are only tracking self time, so subtract our total time delta from parents
+			mLastTimerData.mChildTime += total_time;
+		}
 
 		LLFastTimer::sCurTimerData = mLastTimerData;
 #endif
@@ -252,6 +268,18 @@ public:
 	static void writeLog(std::ostream& os);
 	static const NamedTimer* getTimerByName(const std::string& name);
 
+	// Trace of every timer on every thread, for chrome://tracing or
+	// ui.perfetto.dev.  Each thread fills a buffer of its own without
+	// locking; collectTrace() empties them into the trace from the main
+	// thread and must be called often enough, once a frame, that they
+	// don't overflow.
+	static void startTrace();
+	static bool stopTrace(const std::string& filename);	// writes the trace event JSON
+	static bool isTracing() { return sTraceEnabled.load(std::memory_order_relaxed); }
+	static void collectTrace();
+	// Name the calling thread gets in traces
+	static void setThreadName(const std::string& name);
+
 	struct CurTimerData
 	{
 		LLFastTimer*	mCurTimer;
@@ -259,13 +287,17 @@ public:
 		FrameState*		mFrameState;
 		U32				mChildTime;
 	};
-	static CurTimerData		sCurTimerData;
+	// Top of the calling thread's timer stack
+	static thread_local CurTimerData sCurTimerData;
 	static std::string sClockType;
 
 private:
 	static U32 getCPUClockCount32();
 	static U64 getCPUClockCount64();
 
+	static void pushTraceEvent(const NamedTimer* timer, U64 start_time);
+
+	static std::atomic<bool> sTraceEnabled;
 	static S32				sCurFrameIndex;
 	static S32				sLastFrameIndex;
 	static U64				sLastFrameTime;
@@ -274,6 +306,7 @@ private:
 	U32							mStartTime;
 	LLFastTimer::FrameState*	mFrameState;
 	LLFastTimer::CurTimerData	mLastTimerData;
+	U64							mTraceStartTime;	// 0 when not tracing
 
 };
 
@@ -0,0 +1,196 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/**
+ * @file lljobpool.cpp
+ * @brief Threads sharing out a range of work with the calling thread
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "lljobpool.h"
+
+#include "llthread.h"
+
+#include <boost/thread/thread.hpp>
+
+LLJobPool* LLJobPool::sInstance = nullptr;
+
+class LLJobPool::Worker : public LLThread
+{
+public:
+	Worker(LLJobPool* pool, const std::string& name)
+	:	LLThread(name),
+		mPool(pool)
+	{
+	}
+
+protected:
+	bool runCondition() override
+	{
+		// mDataLock must be locked here
+		return mPool->mHasWork != 0;
+	}
+
+	void run() override
+	{
+		while (true)
+		{
+			// blocks until a job is posted
+			checkPause();
+
+			if (isQuitting())
+			{
+				break;
+			}
+
+			mPool->work();
+		}
+	}
+
+private:
+	LLJobPool* mPool;
+};
+
+LLJobPool::LLJobPool(const std::string& name, U32 helpers)
+:	mBusy(0),
+	mJob(nullptr),
+	mHasWork(0)
+{
+	for (U32 i = 0; i < helpers; ++i)
+	{
+		mWorkers.emplace_back(new Worker(this, llformat("%s %u", name.c_str(), i)));
+		mWorkers.back()->start();
+	}
+}
+
+LLJobPool::~LLJobPool()
+{
+	for (auto& worker : mWorkers)
+	{
+		worker->shutdown();
+	}
+	mWorkers.clear();
+}
+
+void LLJobPool::run(S32 count, S32 grain, const range_func_t& func)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+	grain = llmax(grain, 1);
+	if (mWorkers.empty() || count <= grain || mBusy.exchange(1))
+	{
+		func(0, count);
+		return;
+	}
+
+	Job job = { &func, count, grain, 0, 0 };
+	mJobCondition.lock();
+	mJob = &job;
+	mHasWork = 1;
+	mJobCondition.unlock();
+
+	for (auto& worker : mWorkers)
+	{
+		worker->wake();
+	}
+	work();
+
+	// Helpers may still be busy with the last ranges
+	mJobCondition.lock();
+	while (job.mDone < job.mCount)
+	{
+		mJobCondition.wait();
+	}
+	mJob = nullptr;
+	mJobCondition.unlock();
+
+	mBusy = 0;
+}
+
+void LLJobPool::work()
+{
+	while (true)
+	{
+		mJobCondition.lock();
+		Job* job = mJob;
+		if (!job || job->mNext >= job->mCount)
+		{
+			mJobCondition.unlock();
+			return;
+		}
+		S32 first = job->mNext;
+		S32 last = llmin(first + job->mGrain, job->mCount);
+		job->mNext = last;
+		if (last == job->mCount)
+		{
+			mHasWork = 0;
+		}
+		mJobCondition.unlock();
+
+		(*job->mFunc)(first, last);
+
+		mJobCondition.lock();
+		job->mDone += last - first;
+		if (job->mDone == job->mCount)
+		{
+			mJobCondition.signal();
+		}
+		mJobCondition.unlock();
+	}
+}
+
+//static
+void LLJobPool::initClass(U32 threads)
+{
+	if (!threads)
+	{
+		threads = llclamp((S32)boost::thread::hardware_concurrency() / 2, 1, 4);
+	}
+	delete sInstance;
+	sInstance = threads > 1 ? new LLJobPool("job", threads - 1) : nullptr;
+
+	LL_INFOS() << "Job pool: " << threads << " thread(s)" << LL_ENDL;
+}
+
+//static
+void LLJobPool::cleanupClass()
+{
+	delete sInstance;
+	sInstance = nullptr;
+}
+
+//static
+void LLJobPool::parallelFor(S32 count, S32 grain, const range_func_t& func)
+{
+	if (sInstance)
+	{
+		sInstance->run(count, grain, func);
+	}
+	else if (count > 0)
+	{
+		func(0, count);
+	}
+}
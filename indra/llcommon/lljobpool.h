@@ -0,0 +1,96 @@
+/**
+ * @file lljobpool.h
+ * @brief Threads sharing out a range of work with the calling thread
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLJOBPOOL_H
+#define LL_LLJOBPOOL_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "llatomic.h"
+#include "llmutex.h"
+
+/**
+ * A fork/join pool for work the caller needs done before it carries on,
+ * such as a frame's worth of skinning.  run() hands out consecutive
+ * ranges of [0, count) to the helper threads and works through them
+ * itself as well, so it returns as soon as the last range is done.
+ *
+ * One job runs at a time; a run() while the pool is busy, including one
+ * made from inside a job, does its whole range on the calling thread.
+ *
+ * The process wide pool is set up with initClass(); parallelFor() uses it
+ * when there is one and falls back on the calling thread otherwise.
+ */
+class LL_COMMON_API LLJobPool
+{
+public:
+	typedef std::function<void(S32 first, S32 last)> range_func_t;
+
+	// helpers is the number of threads started besides the caller
+	LLJobPool(const std::string& name, U32 helpers);
+	~LLJobPool();
+
+	// Threads taking part in a job, including the caller
+	U32 getThreadCount() const	{ return (U32)mWorkers.size() + 1; }
+
+	// Calls func on ranges of at most grain items until [0, count) is done
+	void run(S32 count, S32 grain, const range_func_t& func);
+
+	// threads counts the caller, 0 picks half the cores (max 4)
+	static void initClass(U32 threads = 0);
+	static void cleanupClass();
+	static LLJobPool* getInstance()	{ return sInstance; }
+
+	// run() on the process wide pool; on the calling thread without one
+	static void parallelFor(S32 count, S32 grain, const range_func_t& func);
+
+private:
+	struct Job
+	{
+		const range_func_t* mFunc;
+		S32 mCount;
+		S32 mGrain;
+		S32 mNext;
+		S32 mDone;
+	};
+
+	class Worker;
+
+	// Takes ranges off the current job until there are none left
+	void work();
+
+	std::vector<std::unique_ptr<Worker> > mWorkers;
+	LLAtomicU32 mBusy;			// set while a run() has the pool
+	LLCondition mJobCondition;	// guards mJob, signalled when the last range is done
+	Job* mJob;
+	LLAtomicU32 mHasWork;
+
+	static LLJobPool* sInstance;
+};
+
+#endif // LL_LLJOBPOOL_H
@@ -0,0 +1,225 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/** 
+ * @file llmappedfile.cpp
+ * @brief Memory mapped file wrapper.
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#if LL_WINDOWS
+#include "llwin32headerslean.h"
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "linden_common.h"
+#include "llmappedfile.h"
+#include "llstring.h"
+#include "llerror.h"
+
+LLMappedFile::LLMappedFile()
+:	mData(nullptr),
+	mSize(0),
+	mWritable(false),
+#if LL_WINDOWS
+	mFileHandle(INVALID_HANDLE_VALUE),
+	mMappingHandle(nullptr)
+#else
+	mFD(-1)
+#endif
+{
+}
+
+LLMappedFile::~LLMappedFile()
+{
+	close();
+}
+
+bool LLMappedFile::open(const std::string& filename, bool writable, S64 min_size)
+{
+	close();
+
+	mFilename = filename;
+	mWritable = writable;
+
+#if LL_WINDOWS
+	llutf16string utf16filename = utf8str_to_utf16str(filename);
+	DWORD access = writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ;
+	DWORD creation = writable ? OPEN_ALWAYS : OPEN_EXISTING;
+	HANDLE file = CreateFileW((LPCWSTR)utf16filename.c_str(), access,
+							  FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+							  nullptr, creation, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		LL_WARNS() << "Unable to open " << filename << " for mapping, error: " << GetLastError() << LL_ENDL;
+		return false;
+	}
+	mFileHandle = file;
+#else
+	int fd = ::open(filename.c_str(), writable ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+	if (fd < 0)
+	{
+		LL_WARNS() << "Unable to open " << filename << " for mapping, errno: " << errno << LL_ENDL;
+		return false;
+	}
+	mFD = fd;
+#endif
+
+	if (!map(min_size))
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void LLMappedFile::close()
+{
+	unmap();
+#if LL_WINDOWS
+	if (mFileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle((HANDLE)mFileHandle);
+		mFileHandle = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (mFD >= 0)
+	{
+		::close(mFD);
+		mFD = -1;
+	}
+#endif
+	mWritable = false;
+}
+
+bool LLMappedFile::resize(S64 size)
+{
+	if (!mWritable)
+	{
+		return false;
+	}
+	unmap();
+	return map(size);
+}
+
+bool LLMappedFile::flush(bool async)
+{
+	if (!mData || !mWritable)
+	{
+		return false;
+	}
+#if LL_WINDOWS
+	if (!FlushViewOfFile(mData, 0))
+	{
+		return false;
+	}
+	return async || FlushFileBuffers((HANDLE)mFileHandle);
+#else
+	return msync(mData, (size_t)mSize, async ? MS_ASYNC : MS_SYNC) == 0;
+#endif
+}
+
+// Maps the opened file, growing it to min_size first when writable.
+bool LLMappedFile::map(S64 min_size)
+{
+#if LL_WINDOWS
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx((HANDLE)mFileHandle, &file_size))
+	{
+		return false;
+	}
+	S64 size = llmax((S64)file_size.QuadPart, mWritable ? min_size : 0);
+	if (size <= 0)
+	{
+		return false;
+	}
+	// CreateFileMapping() extends the file when the mapping is larger
+	HANDLE mapping = CreateFileMappingW((HANDLE)mFileHandle, nullptr,
+										mWritable ? PAGE_READWRITE : PAGE_READONLY,
+										(DWORD)(size >> 32), (DWORD)(size & 0xFFFFFFFF), nullptr);
+	if (!mapping)
+	{
+		LL_WARNS() << "Unable to map " << mFilename << ", error: " << GetLastError() << LL_ENDL;
+		return false;
+	}
+	void* data = MapViewOfFile(mapping, mWritable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, (SIZE_T)size);
+	if (!data)
+	{
+		LL_WARNS() << "Unable to map a view of " << mFilename << ", error: " << GetLastError() << LL_ENDL;
+		CloseHandle(mapping);
+		return false;
+	}
+	mMappingHandle = mapping;
+#else
+	struct stat file_stat;
+	if (fstat(mFD, &file_stat) != 0)
+	{
+		return false;
+	}
+	S64 size = llmax((S64)file_stat.st_size, mWritable ? min_size : 0);
+	if (size <= 0)
+	{
+		return false;
+	}
+	if (size > (S64)file_stat.st_size && ftruncate(mFD, (off_t)size) != 0)
+	{
+		LL_WARNS() << "Unable to extend " << mFilename << " to " << size << " bytes, errno: " << errno << LL_ENDL;
+		return false;
+	}
+	void* data = mmap(nullptr, (size_t)size, mWritable ? (PROT_READ | PROT_WRITE) : PROT_READ,
+					  MAP_SHARED, mFD, 0);
+	if (data == MAP_FAILED)
+	{
+		LL_WARNS() << "Unable to map " << mFilename << ", errno: " << errno << LL_ENDL;
+		return false;
+	}
+#endif
+	mData = (U8*)data;
+	mSize = size;
+	return true;
+}
+
+void LLMappedFile::unmap()
+{
+	if (mData)
+	{
+#if LL_WINDOWS
+		UnmapViewOfFile(mData);
+#else
+		munmap(mData, (size_t)mSize);
+#endif
+		mData = nullptr;
+	}
+#if LL_WINDOWS
+	if (mMappingHandle)
+	{
+		CloseHandle((HANDLE)mMappingHandle);
+		mMappingHandle = nullptr;
+	}
+#endif
+	mSize = 0;
+}
@@ -0,0 +1,85 @@
+/** 
+ * @file llmappedfile.h
+ * @brief Memory mapped file wrapper.
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMAPPEDFILE_H
+#define LL_LLMAPPEDFILE_H
+
+#include <string>
+
+/**
+ * Maps a whole file into the address space of the process.
+ *
+ * Writable mappings are shared with the file: stores through getData()
+ * end up on disk without any explicit write call, flush() only forces
+ * the kernel to schedule the write-back. The mapping size is fixed once
+ * open() returns; use resize() (which invalidates every pointer into the
+ * old mapping) to grow it.
+ */
+class LL_COMMON_API LLMappedFile
+{
+public:
+	LLMappedFile();
+	~LLMappedFile();
+
+	// Maps filename. When writable, the file is created if missing and
+	// extended with zeros to at least min_size bytes.
+	bool open(const std::string& filename, bool writable, S64 min_size = 0);
+	void close();
+
+	// Remaps the file with a new size. Writable mappings only.
+	bool resize(S64 size);
+
+	// Schedules (or waits for, when async is false) the write-back of dirty pages.
+	bool flush(bool async = true);
+
+	bool isOpen() const				{ return mData != nullptr; }
+	bool isWritable() const			{ return mWritable; }
+	U8* getData() const				{ return mData; }
+	S64 getSize() const				{ return mSize; }
+	const std::string& getFilename() const	{ return mFilename; }
+
+private:
+	// No copy constructor or copy assignment
+	LLMappedFile(const LLMappedFile&);
+	LLMappedFile& operator=(const LLMappedFile&);
+
+	bool map(S64 min_size);
+	void unmap();
+
+private:
+	std::string	mFilename;
+	U8*			mData;
+	S64			mSize;
+	bool		mWritable;
+#if LL_WINDOWS
+	void*		mFileHandle;
+	void*		mMappingHandle;
+#else
+	int			mFD;
+#endif
+};
+
+#endif // LL_LLMAPPEDFILE_H
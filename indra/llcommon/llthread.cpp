@@ -33,6 +33,7 @@
 
 #include "lltimer.h"
 #include "lltrace.h"
+#include "llfasttimer.h"
 //#include "lltracethreadrecorder.h"
 #include "llexception.h"
 
@@ -106,6 +107,7 @@ void LLThread::runWrapper()
 #ifdef LL_WINDOWS
 	set_thread_name(-1, mName.c_str());
 #endif
+	LLFastTimer::setThreadName(mName);
 
 	// for now, hard code all LLThreads to report to single master thread recorder, which is known to be running on main thread
 	//mRecorder = std::make_unique<LLTrace::ThreadRecorder>(*LLTrace::get_master_thread_recorder());
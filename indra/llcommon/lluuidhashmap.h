@@ -0,0 +1,261 @@
+/**
+ * @file lluuidhashmap.h
+ * @brief Open addressing hash map keyed on LLUUID
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLUUIDHASHMAP_H
+#define LL_LLUUIDHASHMAP_H
+
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "lluuid.h"
+
+/**
+ * LLUUIDHashMap keeps its entries packed in a std::vector and finds them
+ * through a linear probing table of entry indices.  Lookups touch the
+ * table and the one entry they want rather than a chain of tree nodes,
+ * and walking the whole map is walking an array.
+ *
+ * It reads like the std::map it replaces (find(), count(), operator[],
+ * erase(), iterators onto std::pair<LLUUID, T>) but differs where that
+ * costs:
+ * - iteration is in no particular order;
+ * - erasing moves the last entry into the gap, and inserting may grow
+ *   the vector, so both invalidate iterators and references.  Use the
+ *   iterator erase() returns to carry on a loop that erases;
+ * - the key of an entry must not be changed through an iterator.
+ *
+ * UUIDs are random enough that the hash is a fold of their two halves.
+ */
+template <typename T>
+class LLUUIDHashMap
+{
+public:
+	typedef LLUUID key_type;
+	typedef T mapped_type;
+	typedef std::pair<LLUUID, T> value_type;
+	typedef std::vector<value_type> entry_vector_t;
+	typedef typename entry_vector_t::iterator iterator;
+	typedef typename entry_vector_t::const_iterator const_iterator;
+	typedef size_t size_type;
+
+	LLUUIDHashMap()
+	:	mMask(0)
+	{
+	}
+
+	iterator begin()					{ return mEntries.begin(); }
+	iterator end()						{ return mEntries.end(); }
+	const_iterator begin() const		{ return mEntries.begin(); }
+	const_iterator end() const			{ return mEntries.end(); }
+
+	bool empty() const					{ return mEntries.empty(); }
+	size_type size() const				{ return mEntries.size(); }
+
+	void clear()
+	{
+		mEntries.clear();
+		mSlots.clear();
+		mMask = 0;
+	}
+
+	// Room for count entries without rehashing
+	void reserve(size_type count)
+	{
+		mEntries.reserve(count);
+		if (count * 2 > mSlots.size())
+		{
+			rehash(count * 2);
+		}
+	}
+
+	void swap(LLUUIDHashMap& other)
+	{
+		mEntries.swap(other.mEntries);
+		mSlots.swap(other.mSlots);
+		std::swap(mMask, other.mMask);
+	}
+
+	iterator find(const LLUUID& key)
+	{
+		size_t slot = findSlot(key);
+		return mSlots.empty() || !mSlots[slot] ? end() : mEntries.begin() + (mSlots[slot] - 1);
+	}
+
+	const_iterator find(const LLUUID& key) const
+	{
+		size_t slot = findSlot(key);
+		return mSlots.empty() || !mSlots[slot] ? end() : mEntries.begin() + (mSlots[slot] - 1);
+	}
+
+	size_type count(const LLUUID& key) const
+	{
+		return find(key) == end() ? 0 : 1;
+	}
+
+	std::pair<iterator, bool> insert(const value_type& value)
+	{
+		reserveOneMore();
+		size_t slot = findSlot(value.first);
+		if (mSlots[slot])
+		{
+			return std::make_pair(mEntries.begin() + (mSlots[slot] - 1), false);
+		}
+		mEntries.push_back(value);
+		mSlots[slot] = (U32)mEntries.size();
+		return std::make_pair(mEntries.end() - 1, true);
+	}
+
+	T& operator[](const LLUUID& key)
+	{
+		reserveOneMore();
+		size_t slot = findSlot(key);
+		if (!mSlots[slot])
+		{
+			mEntries.push_back(value_type(key, T()));
+			mSlots[slot] = (U32)mEntries.size();
+		}
+		return mEntries[mSlots[slot] - 1].second;
+	}
+
+	size_type erase(const LLUUID& key)
+	{
+		if (mSlots.empty())
+		{
+			return 0;
+		}
+		size_t slot = findSlot(key);
+		if (!mSlots[slot])
+		{
+			return 0;
+		}
+		eraseSlot(slot);
+		return 1;
+	}
+
+	// Returns where to carry on iterating: the same position, which now
+	// holds what was the last entry.
+	iterator erase(iterator it)
+	{
+		size_t index = it - mEntries.begin();
+		eraseSlot(findSlot(it->first));
+		return mEntries.begin() + index;
+	}
+
+private:
+	static size_t hashOf(const LLUUID& key)
+	{
+		U64 halves[2];
+		memcpy(halves, key.mData, sizeof(halves));
+		return (size_t)(((halves[0] ^ halves[1]) * 0x9E3779B97F4A7C15ULL) >> 32);
+	}
+
+	// Slot holding key, or the empty slot where it would go.  Only valid
+	// with a non-empty table.
+	size_t findSlot(const LLUUID& key) const
+	{
+		if (mSlots.empty())
+		{
+			return 0;
+		}
+		size_t slot = hashOf(key) & mMask;
+		while (mSlots[slot] && mEntries[mSlots[slot] - 1].first != key)
+		{
+			slot = (slot + 1) & mMask;
+		}
+		return slot;
+	}
+
+	void reserveOneMore()
+	{
+		// Kept at most half full, a slot is only four bytes
+		if ((mEntries.size() + 1) * 2 > mSlots.size())
+		{
+			rehash(mSlots.size() * 2);
+		}
+	}
+
+	void rehash(size_t min_slots)
+	{
+		size_t slots = 16;
+		while (slots < min_slots)
+		{
+			slots *= 2;
+		}
+		mSlots.assign(slots, 0);
+		mMask = slots - 1;
+		for (size_t i = 0; i < mEntries.size(); ++i)
+		{
+			size_t slot = hashOf(mEntries[i].first) & mMask;
+			while (mSlots[slot])
+			{
+				slot = (slot + 1) & mMask;
+			}
+			mSlots[slot] = (U32)(i + 1);
+		}
+	}
+
+	void eraseSlot(size_t slot)
+	{
+		size_t index = mSlots[slot] - 1;
+
+		// Pull later entries of the probe run back over the hole so that
+		// lookups never need tombstones
+		size_t hole = slot;
+		size_t next = slot;
+		while (true)
+		{
+			next = (next + 1) & mMask;
+			if (!mSlots[next])
+			{
+				break;
+			}
+			size_t home = hashOf(mEntries[mSlots[next] - 1].first) & mMask;
+			if (((next - home) & mMask) >= ((next - hole) & mMask))
+			{
+				mSlots[hole] = mSlots[next];
+				hole = next;
+			}
+		}
+		mSlots[hole] = 0;
+
+		// Fill the gap in the entries with the last one
+		size_t last = mEntries.size() - 1;
+		if (index != last)
+		{
+			mSlots[findSlot(mEntries[last].first)] = (U32)(index + 1);
+			mEntries[index] = std::move(mEntries[last]);
+		}
+		mEntries.pop_back();
+	}
+
+private:
+	entry_vector_t mEntries;
+	std::vector<U32> mSlots;	// index in mEntries + 1, 0 when free
+	size_t mMask;
+};
+
+#endif // LL_LLUUIDHASHMAP_H
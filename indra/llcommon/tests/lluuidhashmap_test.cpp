@@ -0,0 +1,253 @@
+/**
+ * @file lluuidhashmap_test.cpp
+ * @brief Lookups, erases with the backward shift, growth and iteration of LLUUIDHashMap
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include <map>
+#include <vector>
+// Class to test
+#include "../lluuidhashmap.h"
+// For llformat
+#include "../llformat.h"
+// Tut header
+#include "../test/lltut.h"
+
+namespace tut
+{
+	struct uuidhashmap_test
+	{
+		typedef LLUUIDHashMap<S32> map_t;
+
+		// The hash is a fold of the two halves, so keys whose halves xor to
+		// the same value all start probing from the same slot
+		static LLUUID makeID(U64 first, U64 second)
+		{
+			LLUUID id;
+			memcpy(id.mData, &first, sizeof(first));
+			memcpy(id.mData + sizeof(first), &second, sizeof(second));
+			return id;
+		}
+
+		static LLUUID collidingID(U64 i)
+		{
+			return makeID(i, i ^ 0x5555aaaa1234ULL);
+		}
+
+		// Spread out keys
+		static LLUUID spreadID(U64 i)
+		{
+			return makeID(i * 0x9E3779B97F4A7C15ULL + 1, (i + 7) * 0xC2B2AE3D27D4EB4FULL);
+		}
+
+		static void ensureMatches(const std::string& msg, const map_t& map, const std::map<LLUUID, S32>& expected)
+		{
+			ensure_equals(msg + " size", map.size(), expected.size());
+			for (std::map<LLUUID, S32>::const_iterator iter = expected.begin(); iter != expected.end(); ++iter)
+			{
+				map_t::const_iterator found = map.find(iter->first);
+				ensure(msg + " found", found != map.end());
+				ensure_equals(msg + " value", found->second, iter->second);
+			}
+
+			// Every entry is visited once, whatever the order
+			std::map<LLUUID, S32> visited;
+			for (map_t::const_iterator iter = map.begin(); iter != map.end(); ++iter)
+			{
+				ensure(msg + " visited once", visited.insert(*iter).second);
+			}
+			ensure(msg + " iteration", visited == expected);
+		}
+	};
+
+	typedef test_group<uuidhashmap_test> uuidhashmap_t;
+	typedef uuidhashmap_t::object uuidhashmap_object_t;
+	tut::uuidhashmap_t tut_uuidhashmap("LLUUIDHashMap");
+
+	// insert, operator[], find, count and erase by key
+	template<> template<>
+	void uuidhashmap_object_t::test<1>()
+	{
+		map_t map;
+		ensure("starts empty", map.empty());
+		ensure("find on empty", map.find(spreadID(1)) == map.end());
+		ensure_equals("erase on empty", map.erase(spreadID(1)), (size_t)0);
+
+		std::pair<map_t::iterator, bool> result = map.insert(map_t::value_type(spreadID(1), 10));
+		ensure("inserted", result.second);
+		ensure_equals("inserted value", result.first->second, 10);
+		result = map.insert(map_t::value_type(spreadID(1), 20));
+		ensure("not inserted twice", !result.second);
+		ensure_equals("kept the first value", result.first->second, 10);
+
+		map[spreadID(2)] = 30;
+		map[spreadID(2)] += 1;
+		ensure_equals("default constructed", map[spreadID(3)], 0);
+		ensure_equals("size", map.size(), (size_t)3);
+		ensure_equals("count present", map.count(spreadID(2)), (size_t)1);
+		ensure_equals("count missing", map.count(spreadID(4)), (size_t)0);
+		ensure_equals("operator[] value", map.find(spreadID(2))->second, 31);
+
+		ensure_equals("erased", map.erase(spreadID(1)), (size_t)1);
+		ensure_equals("erased once", map.erase(spreadID(1)), (size_t)0);
+		ensure("gone", map.find(spreadID(1)) == map.end());
+		ensure_equals("others stay", map.find(spreadID(2))->second, 31);
+		ensure_equals("size after erase", map.size(), (size_t)2);
+
+		map.clear();
+		ensure("cleared", map.empty());
+		ensure("find after clear", map.find(spreadID(2)) == map.end());
+		map[spreadID(2)] = 5;
+		ensure_equals("usable after clear", map.find(spreadID(2))->second, 5);
+	}
+
+	// Erasing from the middle of a probe run has to pull the rest of the
+	// run back over the hole
+	template<> template<>
+	void uuidhashmap_object_t::test<2>()
+	{
+		map_t map;
+		std::map<LLUUID, S32> expected;
+		for (U64 i = 0; i < 6; ++i)
+		{
+			map[collidingID(i)] = (S32)i;
+			expected[collidingID(i)] = (S32)i;
+		}
+		// and some keys of their own in between
+		for (U64 i = 0; i < 4; ++i)
+		{
+			map[spreadID(i)] = 100 + (S32)i;
+			expected[spreadID(i)] = 100 + (S32)i;
+		}
+		ensureMatches("filled", map, expected);
+
+		// Head, middle and tail of the chain
+		const U64 order[] = { 0, 3, 5 };
+		for (U64 i : order)
+		{
+			ensure_equals(llformat("erased %llu", (unsigned long long)i), map.erase(collidingID(i)), (size_t)1);
+			expected.erase(collidingID(i));
+			ensure(llformat("%llu gone", (unsigned long long)i), map.find(collidingID(i)) == map.end());
+			ensureMatches(llformat("after erasing %llu", (unsigned long long)i), map, expected);
+		}
+
+		// Back into the holes the shift left
+		map[collidingID(3)] = 33;
+		expected[collidingID(3)] = 33;
+		map[collidingID(6)] = 6;
+		expected[collidingID(6)] = 6;
+		ensureMatches("refilled", map, expected);
+
+		const U64 rest[] = { 6, 1, 4, 3, 2 };
+		for (U64 i : rest)
+		{
+			map.erase(collidingID(i));
+			expected.erase(collidingID(i));
+			ensureMatches(llformat("after erasing %llu again", (unsigned long long)i), map, expected);
+		}
+		ensure_equals("own keys left", map.size(), (size_t)4);
+	}
+
+	// Growing rehashes everything into the bigger table
+	template<> template<>
+	void uuidhashmap_object_t::test<3>()
+	{
+		map_t map;
+		std::map<LLUUID, S32> expected;
+		for (U64 i = 0; i < 5000; ++i)
+		{
+			// every fifth key collides with the others
+			LLUUID id = i % 5 ? spreadID(i) : collidingID(i);
+			map[id] = (S32)i;
+			expected[id] = (S32)i;
+			if ((i & (i + 1)) == 0)
+			{
+				ensureMatches(llformat("at %llu", (unsigned long long)i), map, expected);
+			}
+		}
+		ensureMatches("grown", map, expected);
+
+		// reserve() rehashes up front and keeps what is there
+		map_t reserved;
+		reserved[spreadID(1)] = 1;
+		reserved.reserve(3000);
+		ensure_equals("kept through reserve", reserved.find(spreadID(1))->second, 1);
+		for (U64 i = 2; i < 3000; ++i)
+		{
+			reserved[spreadID(i)] = (S32)i;
+		}
+		ensure_equals("reserved size", reserved.size(), (size_t)2999);
+		ensure_equals("reserved lookup", reserved.find(spreadID(2999))->second, 2999);
+
+		map_t other;
+		other.swap(map);
+		ensure("swapped out", map.empty());
+		ensureMatches("swapped in", other, expected);
+	}
+
+	// erase(iterator) moves the last entry into the gap, and the returned
+	// iterator carries the loop on from there
+	template<> template<>
+	void uuidhashmap_object_t::test<4>()
+	{
+		map_t map;
+		std::map<LLUUID, S32> expected;
+		for (U64 i = 0; i < 1000; ++i)
+		{
+			LLUUID id = i % 3 ? spreadID(i) : collidingID(i);
+			map[id] = (S32)i;
+			expected[id] = (S32)i;
+		}
+
+		for (map_t::iterator iter = map.begin(); iter != map.end(); )
+		{
+			if (iter->second % 4 == 0)
+			{
+				expected.erase(iter->first);
+				iter = map.erase(iter);
+			}
+			else
+			{
+				++iter;
+			}
+		}
+		ensureMatches("after erasing in a loop", map, expected);
+
+		// Values changed through an iterator stick
+		for (map_t::iterator iter = map.begin(); iter != map.end(); ++iter)
+		{
+			iter->second *= 2;
+			expected[iter->first] *= 2;
+		}
+		ensureMatches("after updating", map, expected);
+
+		// Erasing all of it, last entry first, leaves nothing to visit
+		while (!map.empty())
+		{
+			map.erase(map.end() - 1);
+		}
+		ensure("nothing to iterate", map.begin() == map.end());
+		ensure("nothing left", map.find(collidingID(3)) == map.end());
+	}
+}
@@ -153,6 +153,11 @@ const int HTTP_CONNECTION_LIMIT_MAX = 256;
 const long HTTP_PIPELINING_DEFAULT = 0L;
 const long HTTP_PIPELINING_MAX = 20L;
 
+// HTTP/2 streams per connection limits.  Servers commonly
+// advertise 100 concurrent streams.
+const long HTTP_HTTP2_STREAMS_DEFAULT = 0L;
+const long HTTP_HTTP2_STREAMS_MAX = 100L;
+
 // Miscellaneous defaults
 const bool HTTP_USE_RETRY_AFTER_DEFAULT = true;
 const long HTTP_THROTTLE_RATE_DEFAULT = 0L;
@@ -160,12 +165,27 @@ const long HTTP_THROTTLE_RATE_DEFAULT = 0L;
 // Tuning parameters
 
 // Time worker thread sleeps after a pass through the
-// request, ready and active queues.
+// request, ready and active queues when it has no way of
+// being woken early (libcurl without a wakeup descriptor
+// on Windows).
 const int HTTP_SERVICE_LOOP_SLEEP_NORMAL_MS = 2;
 
+// Longest time worker thread waits on the transport's
+// sockets before another pass through the queues.  Waits
+// normally end far sooner, on socket activity, a new
+// request or a retry or throttle deadline.  This bounds
+// the cost of anything libcurl doesn't report a descriptor
+// for.
+const long HTTP_SERVICE_LOOP_WAIT_MAX_MS = 100L;
+
 // Block allocation size (a tuning parameter) is found
 // in bufferarray.h.
 
+// Largest Content-Length a response body is allocated as a
+// single extent for up front.  Bigger bodies are collected
+// in ordinary blocks as they arrive.
+const size_t HTTP_REPLY_RESERVE_MAX = 16 * 1024 * 1024;
+
 }  // end namespace LLCore
 
 #endif	// _LLCORE_HTTP_INTERNAL_H_
@@ -30,10 +30,26 @@
 
 #include "httpheaders.h"
 #include "bufferarray.h"
+#include "httpstats.h"
 #include "_httpoprequest.h"
 #include "_httppolicy.h"
 
 #include "llhttpconstants.h"
+#include "lltimer.h"
+
+#if ! LL_WINDOWS
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// curl_multi_poll() and curl_multi_wakeup() arrived in libcurl 7.68.
+// Before that we wait with curl_multi_wait() and bring our own wakeup
+// pipe, which Windows can't poll on.
+#if LIBCURL_VERSION_NUM >= 0x074400
+#define LLCORE_HTTP_MULTI_WAKEUP 1
+#else
+#define LLCORE_HTTP_MULTI_WAKEUP 0
+#endif
 
 namespace
 {
@@ -53,6 +69,27 @@ void check_curl_multi_setopt(CURLM* handle, CURLMoption option, ARG argument)
 
 static const char * const LOG_CORE("CoreHttp");
 
+// Append the descriptors set in @fds to a curl_multi_wait() list
+void add_wait_fds(fd_set & fds, int max_fd, short events, std::vector<curl_waitfd> & wait_fds)
+{
+#if LL_WINDOWS
+	for (u_int i(0); i < fds.fd_count; ++i)
+	{
+		curl_waitfd wait_fd = { fds.fd_array[i], events, 0 };
+		wait_fds.push_back(wait_fd);
+	}
+#else
+	for (int fd(0); fd <= max_fd; ++fd)
+	{
+		if (FD_ISSET(fd, &fds))
+		{
+			curl_waitfd wait_fd = { fd, events, 0 };
+			wait_fds.push_back(wait_fd);
+		}
+	}
+#endif
+}
+
 } // end anonymous namespace
 
 
@@ -66,14 +103,59 @@ HttpLibcurl::HttpLibcurl(HttpService * service)
 	  mPolicyCount(0),
 	  mMultiHandles(nullptr),
 	  mActiveHandles(nullptr),
-	  mDirtyPolicy(nullptr)
-{}
+	  mDirtyPolicy(nullptr),
+	  mWaitHandle(nullptr)
+{
+	mWakeupFds[0] = mWakeupFds[1] = -1;
+
+	// Never gets an easy handle, only used to wait on everyone
+	// else's sockets
+	mWaitHandle = curl_multi_init();
+	if (! mWaitHandle)
+	{
+		LL_WARNS(LOG_CORE) << "Failed to allocate wait handle in libcurl, falling back to polling."
+						   << LL_ENDL;
+	}
+
+#if ! LLCORE_HTTP_MULTI_WAKEUP && ! LL_WINDOWS
+	if (0 == pipe(mWakeupFds))
+	{
+		for (int i(0); i < 2; ++i)
+		{
+			fcntl(mWakeupFds[i], F_SETFL, fcntl(mWakeupFds[i], F_GETFL) | O_NONBLOCK);
+			fcntl(mWakeupFds[i], F_SETFD, FD_CLOEXEC);
+		}
+	}
+	else
+	{
+		LL_WARNS(LOG_CORE) << "Failed to create wakeup pipe, falling back to polling."
+						   << LL_ENDL;
+		mWakeupFds[0] = mWakeupFds[1] = -1;
+	}
+#endif
+}
 
 
 HttpLibcurl::~HttpLibcurl()
 {
 	shutdown();
 
+	if (mWaitHandle)
+	{
+		curl_multi_cleanup(mWaitHandle);
+		mWaitHandle = nullptr;
+	}
+#if ! LL_WINDOWS
+	for (int i(0); i < 2; ++i)
+	{
+		if (mWakeupFds[i] >= 0)
+		{
+			close(mWakeupFds[i]);
+			mWakeupFds[i] = -1;
+		}
+	}
+#endif
+
 	mService = nullptr;
 }
 
@@ -87,6 +169,7 @@ void HttpLibcurl::shutdown()
 
 		cancelRequest(op);
 	}
+	mConnections.clear();
 
 	if (mMultiHandles)
 	{
@@ -207,12 +290,122 @@ HttpService::ELoopSpeed HttpLibcurl::processTransport()
 
 	if (! mActiveOps.empty())
 	{
-		ret = HttpService::NORMAL;
+		trackConnections();
+
+		// Transfers in flight, their sockets will tell us when
+		// to come back.
+		ret = (std::min)(ret, HttpService::ACTIVITY_WAIT);
 	}
 	return ret;
 }
 
 
+void HttpLibcurl::waitForActivity(long max_wait_ms)
+{
+	long wait_ms(max_wait_ms);
+
+	// One wait over the sockets of every policy class.  Each class
+	// has its own multi handle so we collect their descriptors and
+	// wait on a separate, empty handle.
+	mWaitFds.clear();
+	for (int policy_class(0); policy_class < mPolicyCount; ++policy_class)
+	{
+		if (! mMultiHandles[policy_class] || ! mActiveHandles[policy_class])
+		{
+			continue;
+		}
+
+		long timeout_ms(-1L);
+		curl_multi_timeout(mMultiHandles[policy_class], &timeout_ms);
+		if (timeout_ms >= 0L)
+		{
+			wait_ms = (std::min)(wait_ms, timeout_ms);
+		}
+
+		fd_set read_fds, write_fds, exc_fds;
+		FD_ZERO(&read_fds);
+		FD_ZERO(&write_fds);
+		FD_ZERO(&exc_fds);
+		int max_fd(-1);
+		if (CURLM_OK == curl_multi_fdset(mMultiHandles[policy_class], &read_fds, &write_fds, &exc_fds, &max_fd))
+		{
+			add_wait_fds(read_fds, max_fd, CURL_WAIT_POLLIN, mWaitFds);
+			add_wait_fds(write_fds, max_fd, CURL_WAIT_POLLOUT, mWaitFds);
+			add_wait_fds(exc_fds, max_fd, CURL_WAIT_POLLPRI, mWaitFds);
+		}
+		if (max_fd < 0)
+		{
+			// Busy without a socket to show for it (name resolution,
+			// say), look again shortly.
+			wait_ms = (std::min)(wait_ms, long(HTTP_SERVICE_LOOP_SLEEP_NORMAL_MS));
+		}
+	}
+
+	if (wait_ms <= 0L)
+	{
+		return;
+	}
+	if (! mWaitHandle)
+	{
+		ms_sleep(U32((std::min)(wait_ms, long(HTTP_SERVICE_LOOP_SLEEP_NORMAL_MS))));
+		return;
+	}
+
+#if LLCORE_HTTP_MULTI_WAKEUP
+	curl_multi_poll(mWaitHandle, mWaitFds.empty() ? nullptr : &mWaitFds[0],
+					unsigned(mWaitFds.size()), int(wait_ms), nullptr);
+#else
+	if (mWakeupFds[0] >= 0)
+	{
+		curl_waitfd wakeup_fd = { mWakeupFds[0], CURL_WAIT_POLLIN, 0 };
+		mWaitFds.push_back(wakeup_fd);
+	}
+	else
+	{
+		// Nothing would cut the wait short for a new request
+		wait_ms = (std::min)(wait_ms, long(HTTP_SERVICE_LOOP_SLEEP_NORMAL_MS));
+	}
+
+	if (mWaitFds.empty())
+	{
+		ms_sleep(U32(wait_ms));
+		return;
+	}
+	curl_multi_wait(mWaitHandle, &mWaitFds[0], unsigned(mWaitFds.size()), int(wait_ms), nullptr);
+
+#if ! LL_WINDOWS
+	if (mWakeupFds[0] >= 0)
+	{
+		// Drain so the next wait blocks again
+		char buffer[64];
+		while (read(mWakeupFds[0], buffer, sizeof(buffer)) > 0)
+			;
+	}
+#endif
+#endif
+}
+
+
+void HttpLibcurl::wakeup()
+{
+#if LLCORE_HTTP_MULTI_WAKEUP
+	if (mWaitHandle)
+	{
+		curl_multi_wakeup(mWaitHandle);
+	}
+#elif ! LL_WINDOWS
+	if (mWakeupFds[1] >= 0)
+	{
+		// A full pipe already holds a pending wakeup, so a short
+		// write is harmless.
+		const char byte(0);
+		ssize_t written(write(mWakeupFds[1], &byte, 1));
+		(void) written;
+	}
+#endif
+}
+
+
 // Caller has provided us with a ref count on op.
 void HttpLibcurl::addOp(const HttpOpRequest::ptr_t &op)
 {
@@ -287,6 +480,8 @@ void HttpLibcurl::cancelRequest(const HttpOpRequest::ptr_t &op)
 	// Deactivate request
 	op->mCurlActive = false;
 
+	releaseConnection(op.get(), false);
+
 	// Detach from multi and recycle handle
 	curl_multi_remove_handle(mMultiHandles[op->mReqPolicy], op->mCurlHandle);
 	mHandleCache.freeHandle(op->mCurlHandle);
@@ -400,6 +595,20 @@ bool HttpLibcurl::completeRequest(CURLM * multi_handle, CURL * handle, CURLcode
         }
 	}
 
+	if (handle)
+	{
+		// Requests that finish within a single pass are never seen
+		// by trackConnections(), pick them up here.
+		bool http2(false);
+		attachConnection(op.get());
+#if LIBCURL_VERSION_NUM >= 0x073200
+		long http_version(0L);
+		http2 = (CURLE_OK == curl_easy_getinfo(handle, CURLINFO_HTTP_VERSION, &http_version)
+				 && CURL_HTTP_VERSION_2_0 == http_version);
+#endif
+		releaseConnection(op.get(), http2);
+	}
+
     if (multi_handle && handle)
     {
         // Detach from multi and recycle handle
@@ -431,6 +640,72 @@ bool HttpLibcurl::completeRequest(CURLM * multi_handle, CURL * handle, CURLcode
 }
 
 
+void HttpLibcurl::trackConnections()
+{
+	for (active_set_t::iterator it(mActiveOps.begin()); mActiveOps.end() != it; ++it)
+	{
+		attachConnection(it->get());
+	}
+}
+
+
+void HttpLibcurl::attachConnection(HttpOpRequest * op)
+{
+	if (! op->mCurlConnection.empty() || ! op->mCurlHandle)
+	{
+		return;
+	}
+
+	// Local address is only meaningful once the request has been
+	// handed to a connection and is about to go out on it.
+	double pretransfer(0.0);
+	long port(0L);
+	char * ip(nullptr);
+	if (CURLE_OK != curl_easy_getinfo(op->mCurlHandle, CURLINFO_PRETRANSFER_TIME, &pretransfer)
+		|| pretransfer <= 0.0
+		|| CURLE_OK != curl_easy_getinfo(op->mCurlHandle, CURLINFO_LOCAL_PORT, &port)
+		|| port <= 0L
+		|| CURLE_OK != curl_easy_getinfo(op->mCurlHandle, CURLINFO_LOCAL_IP, &ip)
+		|| ! ip)
+	{
+		return;
+	}
+
+	op->mCurlConnection = ip;
+	op->mCurlConnection += ':';
+	op->mCurlConnection += std::to_string(port);
+
+	ConnectionStreams & conn(mConnections[op->mCurlConnection]);
+	++conn.mActive;
+	++conn.mStreams;
+	conn.mPeak = (std::max)(conn.mPeak, conn.mActive);
+}
+
+
+void HttpLibcurl::releaseConnection(HttpOpRequest * op, bool http2)
+{
+	if (op->mCurlConnection.empty())
+	{
+		return;
+	}
+
+	connection_map_t::iterator it(mConnections.find(op->mCurlConnection));
+	op->mCurlConnection.clear();
+	if (mConnections.end() == it)
+	{
+		return;
+	}
+
+	ConnectionStreams & conn(it->second);
+	conn.mHttp2 = conn.mHttp2 || http2;
+	if (--conn.mActive <= 0)
+	{
+		HTTPStats::instance().recordConnection(conn.mStreams, conn.mPeak, conn.mHttp2);
+		mConnections.erase(it);
+	}
+}
+
+
 int HttpLibcurl::getActiveCount() const
 {
 	return mActiveOps.size();
@@ -477,7 +752,29 @@ void HttpLibcurl::policyUpdated(int policy_class)
 		policy.stallPolicy(policy_class, false);
 		mDirtyPolicy[policy_class] = false;
 
-		if (options.mPipelining > 1)
+		if (options.mHttp2Streams > 0)
+		{
+			// Multiplex HTTP/2 streams, a handful of connections
+			// per host carry everything
+			check_curl_multi_setopt(multi_handle,
+									 CURLMOPT_PIPELINING,
+									 CURLPIPE_MULTIPLEX);
+			check_curl_multi_setopt(multi_handle,
+									 CURLMOPT_MAX_HOST_CONNECTIONS,
+									 long(options.mPerHostConnectionLimit));
+			check_curl_multi_setopt(multi_handle,
+									 CURLMOPT_MAX_TOTAL_CONNECTIONS,
+									 long(options.mConnectionLimit));
+#if LIBCURL_VERSION_NUM >= 0x074300
+			// Older libraries take the server's limit, ours is then
+			// only enforced in aggregate through the policy layer's
+			// in-flight limit.
+			check_curl_multi_setopt(multi_handle,
+									 CURLMOPT_MAX_CONCURRENT_STREAMS,
+									 long(options.mHttp2Streams));
+#endif
+		}
+		else if (options.mPipelining > 1)
 		{
 			// We'll try to do pipelining on this multihandle
 			check_curl_multi_setopt(multi_handle,
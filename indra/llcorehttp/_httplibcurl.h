@@ -32,7 +32,9 @@
 #include <curl/curl.h>
 #include <curl/multi.h>
 
+#include <map>
 #include <set>
+#include <vector>
 
 #include "httprequest.h"
 #include "_httpservice.h"
@@ -77,6 +79,21 @@ public:
 	/// Threading:  called by worker thread.
 	HttpService::ELoopSpeed processTransport();
 
+	/// Block until a socket of an active request is ready, a
+	/// wakeup() arrives, libcurl wants attention for a timeout
+	/// or @max_wait_ms passes, whichever comes first.  This is
+	/// what the worker does between passes instead of sleeping
+	/// so responses are picked up as soon as they arrive.
+	///
+	/// Threading:  called by worker thread.
+	void waitForActivity(long max_wait_ms);
+
+	/// Cut short a waitForActivity() in progress, or the next
+	/// one if none is.  Cheap and non-blocking.
+	///
+	/// Threading:  callable by any thread.
+	void wakeup();
+
 	/// Add request to the active list.  Caller is expected to have
 	/// provided us with a reference count on the op to hold the
 	/// request.  (No additional references will be added.)
@@ -151,6 +168,16 @@ protected:
 	/// Invoked to cancel an active request, mainly during shutdown
 	/// and destroy.
     void cancelRequest(const opReqPtr_t &op);
+
+	/// Attach active requests that have reached their connection
+	/// to that connection's stream counts.  Cheap enough to run
+	/// every pass; requests already attached are skipped.
+	void trackConnections();
+	void attachConnection(HttpOpRequest * op);
+
+	/// Detach a finished request from its connection, reporting
+	/// the connection to HTTPStats once it has nothing in flight.
+	void releaseConnection(HttpOpRequest * op, bool http2);
 	
 protected:
     typedef std::set<opReqPtr_t> active_set_t;
@@ -207,6 +234,18 @@ protected:
 		handle_cache_t		mCache;					// Cache of old handles
 	}; // end class HandleCache
 	
+	/// Requests carried by one connection (keyed by local address)
+	/// since it last went idle.  With HTTP/2 multiplexing, mPeak
+	/// is the concurrent stream count actually achieved.
+	struct ConnectionStreams
+	{
+		int				mActive;
+		int				mPeak;
+		unsigned int	mStreams;
+		bool			mHttp2;
+	};
+	typedef std::map<std::string, ConnectionStreams> connection_map_t;
+
 protected:
 	HttpService *		mService;			// Simple reference, not owner
 	HandleCache			mHandleCache;		// Handle allocator, owner
@@ -215,6 +254,10 @@ protected:
 	CURLM **			mMultiHandles;		// One handle per policy class
 	int *				mActiveHandles;		// Active count per policy class
 	bool *				mDirtyPolicy;		// Dirty policy update waiting for stall (per pc)
+	CURLM *				mWaitHandle;		// Empty multi handle waitForActivity() waits on
+	int					mWakeupFds[2];		// Wakeup pipe when libcurl has no curl_multi_wakeup()
+	std::vector<curl_waitfd> mWaitFds;		// Scratch for waitForActivity()
+	connection_map_t	mConnections;		// Stream counts of busy connections
 	
 }; // end class HttpLibcurl
 
@@ -712,7 +712,18 @@ HttpStatus HttpOpRequest::prepareRequest(HttpService * service)
 	{
 		xfer_timeout = timeout;
 	}
-	if (cpolicy.mPipelining > 1L)
+	if (cpolicy.mHttp2Streams > 0L)
+	{
+		// Wait for a connection that can take another stream rather
+		// than opening a new one.  Streams make progress independently
+		// so unlike pipelining the transfer timeout needs no padding.
+		check_curl_easy_setopt(mCurlHandle, CURLOPT_PIPEWAIT, 1L);
+		check_curl_easy_setopt(mCurlHandle, CURLOPT_HTTP_VERSION,
+							   long(cpolicy.mHttp2PriorKnowledge
+									? CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE
+									: CURL_HTTP_VERSION_2TLS));
+	}
+	else if (cpolicy.mPipelining > 1L)
 	{
 		// Pipelining affects both connection and transfer timeout values.
 		// Requests that are added to a pipeling immediately have completed
@@ -788,6 +799,22 @@ size_t HttpOpRequest::writeCallback(void * data, size_t size, size_t nmemb, void
 	if (! op->mReplyBody)
 	{
 		op->mReplyBody = new BufferArray();
+
+		// Headers are in by the first write.  With a length to go
+		// on, take the body in one extent that consumers can use
+		// in place rather than copying it out of blocks.
+#if LIBCURL_VERSION_NUM >= 0x073700
+		curl_off_t content_length(-1);
+		if (CURLE_OK == curl_easy_getinfo(op->mCurlHandle, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &content_length)
+#else
+		double content_length(-1.0);
+		if (CURLE_OK == curl_easy_getinfo(op->mCurlHandle, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &content_length)
+#endif
+			&& content_length > 0
+			&& content_length <= HTTP_REPLY_RESERVE_MAX)
+		{
+			op->mReplyBody->reserve(size_t(content_length));
+		}
 	}
 	const size_t req_size(size * nmemb);
 	const size_t write_size(op->mReplyBody->append(static_cast<char *>(data), req_size));
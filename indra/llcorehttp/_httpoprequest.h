@@ -217,6 +217,7 @@ public:
 	size_t				mCurlBodyPos;
 	char *				mCurlTemp;				// Scratch buffer for header processing
 	size_t				mCurlTempLen;
+	std::string			mCurlConnection;		// Local address of the connection carrying us
 	
 	// Result data
 	HttpStatus			mStatus;
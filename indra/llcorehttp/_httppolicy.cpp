@@ -77,7 +77,8 @@ public:
 
 
 HttpPolicy::HttpPolicy(HttpService * service)
-	: mService(service)
+	: mService(service),
+	  mNextDeadline(0)
 {
 	// Create default class
 	mClasses.push_back(new ClassState());
@@ -218,6 +219,8 @@ HttpService::ELoopSpeed HttpPolicy::processReadyQueue()
 	const HttpTime now(totalTime());
 	HttpService::ELoopSpeed result(HttpService::REQUEST_SLEEP);
 	HttpLibcurl & transport(mService->getTransport());
+
+	mNextDeadline = 0;
 	
 	for (int policy_class(0); policy_class < mClasses.size(); ++policy_class)
 	{
@@ -230,8 +233,9 @@ HttpService::ELoopSpeed HttpPolicy::processReadyQueue()
 			// Stalling but don't sleep.  Need to complete operations
 			// and get back to servicing queues.  Do this test before
 			// the retryq/readyq test or you'll get stalls until you
-			// click a setting or an asset request comes in.
-			result = HttpService::NORMAL;
+			// click a setting or an asset request comes in.  The
+			// completions wake the worker.
+			result = HttpService::ACTIVITY_WAIT;
 			continue;
 		}
 		if (retryq.empty() && readyq.empty())
@@ -245,15 +249,21 @@ HttpService::ELoopSpeed HttpPolicy::processReadyQueue()
 		if (throttle_current && state.mThrottleLeft <= 0)
 		{
 			// Throttled condition, don't serve this class but don't sleep hard.
-			result = HttpService::NORMAL;
+			result = HttpService::ACTIVITY_WAIT;
+			updateDeadline(state.mThrottleEnd, now);
 			continue;
 		}
 
 		int active(transport.getActiveCountInClass(policy_class));
-		int active_limit(state.mOptions.mPipelining > 1L
-						 ? (state.mOptions.mPerHostConnectionLimit
-							* state.mOptions.mPipelining)
-						 : state.mOptions.mConnectionLimit);
+		int active_limit(state.mOptions.mConnectionLimit);
+		if (state.mOptions.mHttp2Streams > 0L)
+		{
+			active_limit = state.mOptions.mPerHostConnectionLimit * state.mOptions.mHttp2Streams;
+		}
+		else if (state.mOptions.mPipelining > 1L)
+		{
+			active_limit = state.mOptions.mPerHostConnectionLimit * state.mOptions.mPipelining;
+		}
 		int needed(active_limit - active);		// Expect negatives here
 
 		if (needed > 0)
@@ -324,8 +334,18 @@ HttpService::ELoopSpeed HttpPolicy::processReadyQueue()
 		
 		if (! readyq.empty() || ! retryq.empty())
 		{
-			// If anything is ready, continue looping...
-			result = HttpService::NORMAL;
+			// If anything is ready, continue looping.  What's left is
+			// waiting on a free connection, which a completion signals,
+			// or on the clock.
+			result = HttpService::ACTIVITY_WAIT;
+			if (! retryq.empty())
+			{
+				updateDeadline(retryq.top()->mPolicyRetryAt, now);
+			}
+			if (throttle_enabled && state.mThrottleLeft <= 0)
+			{
+				updateDeadline(state.mThrottleEnd, now);
+			}
 		}
 	} // end foreach policy_class
 
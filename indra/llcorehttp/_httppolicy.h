@@ -89,6 +89,17 @@ public:
 	/// Threading:  called by worker thread
 	HttpService::ELoopSpeed processReadyQueue();
 
+	/// Earliest time at which a request held back by the last
+	/// processReadyQueue() call, either waiting out a retry
+	/// interval or a throttle window, may be issued.  Zero when
+	/// nothing is waiting on a clock.
+	///
+	/// Threading:  called by worker thread
+	HttpTime getNextDeadline() const
+		{
+			return mNextDeadline;
+		}
+
 	/// Add request to a ready queue.  Caller is expected to have
 	/// provided us with a reference count to hold the request.  (No
 	/// additional references will be added.)
@@ -169,12 +180,24 @@ public:
 	bool stallPolicy(HttpRequest::policy_t policy_class, bool stall);
 	
 protected:
+	/// Pull mNextDeadline in to @when if it is earlier and still
+	/// in the future.  Anything already due is waiting on a free
+	/// connection instead and a completion will signal that.
+	void updateDeadline(HttpTime when, HttpTime now)
+		{
+			if (when > now && (! mNextDeadline || when < mNextDeadline))
+			{
+				mNextDeadline = when;
+			}
+		}
+
 	struct ClassState;
 	typedef std::vector<ClassState *>	class_list_t;
 	
 	HttpPolicyGlobal					mGlobalOptions;
 	class_list_t						mClasses;
 	HttpService *						mService;				// Naked pointer, not refcounted, not owner
+	HttpTime							mNextDeadline;
 };  // end class HttpPolicy
 
 }  // end namespace LLCore
@@ -39,7 +39,9 @@ HttpPolicyClass::HttpPolicyClass()
 	: mConnectionLimit(HTTP_CONNECTION_LIMIT_DEFAULT),
 	  mPerHostConnectionLimit(HTTP_CONNECTION_LIMIT_DEFAULT),
 	  mPipelining(HTTP_PIPELINING_DEFAULT),
-	  mThrottleRate(HTTP_THROTTLE_RATE_DEFAULT)
+	  mThrottleRate(HTTP_THROTTLE_RATE_DEFAULT),
+	  mHttp2Streams(HTTP_HTTP2_STREAMS_DEFAULT),
+	  mHttp2PriorKnowledge(0L)
 {}
 
 
@@ -55,6 +57,8 @@ HttpPolicyClass & HttpPolicyClass::operator=(const HttpPolicyClass & other)
 		mPerHostConnectionLimit = other.mPerHostConnectionLimit;
 		mPipelining = other.mPipelining;
 		mThrottleRate = other.mThrottleRate;
+		mHttp2Streams = other.mHttp2Streams;
+		mHttp2PriorKnowledge = other.mHttp2PriorKnowledge;
 	}
 	return *this;
 }
@@ -64,7 +68,9 @@ HttpPolicyClass::HttpPolicyClass(const HttpPolicyClass & other)
 	: mConnectionLimit(other.mConnectionLimit),
 	  mPerHostConnectionLimit(other.mPerHostConnectionLimit),
 	  mPipelining(other.mPipelining),
-	  mThrottleRate(other.mThrottleRate)
+	  mThrottleRate(other.mThrottleRate),
+	  mHttp2Streams(other.mHttp2Streams),
+	  mHttp2PriorKnowledge(other.mHttp2PriorKnowledge)
 {}
 
 
@@ -88,6 +94,14 @@ HttpStatus HttpPolicyClass::set(HttpRequest::EPolicyOption opt, long value)
 		mThrottleRate = llclamp(value, 0L, 1000000L);
 		break;
 
+	case HttpRequest::PO_HTTP2_STREAMS:
+		mHttp2Streams = llclamp(value, 0L, HTTP_HTTP2_STREAMS_MAX);
+		break;
+
+	case HttpRequest::PO_HTTP2_PRIOR_KNOWLEDGE:
+		mHttp2PriorKnowledge = value ? 1L : 0L;
+		break;
+
 	default:
 		return HttpStatus(HttpStatus::LLCORE, HE_INVALID_ARG);
 	}
@@ -116,6 +130,14 @@ HttpStatus HttpPolicyClass::get(HttpRequest::EPolicyOption opt, long * value) co
 		*value = mThrottleRate;
 		break;
 
+	case HttpRequest::PO_HTTP2_STREAMS:
+		*value = mHttp2Streams;
+		break;
+
+	case HttpRequest::PO_HTTP2_PRIOR_KNOWLEDGE:
+		*value = mHttp2PriorKnowledge;
+		break;
+
 	default:
 		return HttpStatus(HttpStatus::LLCORE, HE_INVALID_ARG);
 	}
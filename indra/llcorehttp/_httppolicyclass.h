@@ -64,6 +64,8 @@ public:
 	long						mPerHostConnectionLimit;
 	long						mPipelining;
 	long						mThrottleRate;
+	long						mHttp2Streams;
+	long						mHttp2PriorKnowledge;
 };  // end class HttpPolicyClass
 
 }  // end namespace LLCore
@@ -85,6 +85,10 @@ HttpStatus HttpRequestQueue::addOp(const HttpRequestQueue::opPtr_t &op, bool log
 		}
 		wake = mQueue.empty();
 		mQueue.push_back(op);
+		if (wake && mWakeup)
+		{
+			mWakeup();
+		}
 	}
 	if (wake)
 	{
@@ -153,8 +157,20 @@ void HttpRequestQueue::stopQueue()
 
 		mQueueStopped = true;
 		wakeAll();
+		if (mWakeup)
+		{
+			mWakeup();
+		}
 	}
 }
 
 
+void HttpRequestQueue::setWakeupFunction(const wakeup_fn_t & wakeup)
+{
+	HttpScopedLock lock(mQueueMutex);
+
+	mWakeup = wakeup;
+}
+
+
 } // end namespace LLCore
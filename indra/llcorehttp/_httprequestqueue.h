@@ -28,6 +28,7 @@
 #define	_LLCORE_HTTP_REQUEST_QUEUE_H_
 
 
+#include <functional>
 #include <vector>
 
 #include "httpcommon.h"
@@ -74,6 +75,7 @@ public:
 	
 public:
     typedef std::vector<opPtr_t> OpContainer;
+	typedef std::function<void()> wakeup_fn_t;
 
 	/// Insert an object at the back of the request queue.
 	///
@@ -125,6 +127,18 @@ public:
 	///
 	/// Threading:  callable by any thread.
 	void stopQueue();
+
+	/// Install a function to be invoked whenever the queue goes
+	/// from empty to non-empty or is stopped.  This
+	/// lets a consumer that blocks on something other than the
+	/// queue's condition variable (the service thread waiting on
+	/// sockets) notice new requests at once.  The function is
+	/// invoked with the queue lock held and so must be quick and
+	/// must not call back into the queue.  Pass an empty function
+	/// to remove it.
+	///
+	/// Threading:  callable by any thread.
+	void setWakeupFunction(const wakeup_fn_t & wakeup);
 	
 protected:
 	static HttpRequestQueue *			sInstance;
@@ -134,6 +148,7 @@ protected:
 	LLCoreInt::HttpMutex				mQueueMutex;
 	LLCoreInt::HttpConditionVariable	mQueueCV;
 	bool								mQueueStopped;
+	wakeup_fn_t							mWakeup;
 	
 }; // end class HttpRequestQueue
 
@@ -62,7 +62,9 @@ const HttpService::OptionDescriptor HttpService::sOptionDesc[] =
 	{	true,		true,		true,		false,		false	},		// PO_TRACE
 	{	true,		true,		false,		true,		false	},		// PO_ENABLE_PIPELINING
 	{	true,		true,		false,		true,		false	},		// PO_THROTTLE_RATE
-	{   false,		false,		true,		false,		true	}		// PO_SSL_VERIFY_CALLBACK
+	{   false,		false,		true,		false,		true	},		// PO_SSL_VERIFY_CALLBACK
+	{	true,		true,		false,		true,		false	},		// PO_HTTP2_STREAMS
+	{	true,		true,		false,		true,		false	}		// PO_HTTP2_PRIOR_KNOWLEDGE
 };
 HttpService * HttpService::sInstance(nullptr);
 volatile HttpService::EState HttpService::sState(NOT_INITIALIZED);
@@ -122,6 +124,7 @@ HttpService::~HttpService()
 	
 	if (mRequestQueue)
 	{
+		mRequestQueue->setWakeupFunction(HttpRequestQueue::wakeup_fn_t());
 		mRequestQueue->release();
 		mRequestQueue = nullptr;
 	}
@@ -150,6 +153,9 @@ void HttpService::init(HttpRequestQueue * queue)
 	sInstance->mRequestQueue = queue;
 	sInstance->mPolicy = new HttpPolicy(sInstance);
 	sInstance->mTransport = new HttpLibcurl(sInstance);
+
+	// New requests interrupt the worker's wait on its sockets
+	queue->setWakeupFunction(std::bind(&HttpLibcurl::wakeup, sInstance->mTransport));
 	sState = INITIALIZED;
 }
 
@@ -299,9 +305,10 @@ void HttpService::shutdown()
 
 // Working thread loop-forever method.  Gives time to
 // each of the request queue, policy layer and transport
-// layer pieces and then either sleeps for a small time
-// or waits for a request to come in.  Repeats until
-// requested to stop.
+// layer pieces and then either waits for the transport's
+// sockets, a new request or a policy deadline or, when
+// there's nothing in flight, for a request to come in.
+// Repeats until requested to stop.
 void HttpService::threadRun(LLCoreInt::HttpThread * thread)
 {
 	boost::this_thread::disable_interruption di;
@@ -321,10 +328,17 @@ void HttpService::threadRun(LLCoreInt::HttpThread * thread)
 		    new_loop = mTransport->processTransport();
 		    loop = (std::min)(loop, new_loop);
 		
-		    // Determine whether to spin, sleep briefly or sleep for next request
-		    if (REQUEST_SLEEP != loop)
+		    // Determine whether to spin, wait for activity or sleep for next request
+		    if (ACTIVITY_WAIT == loop)
 		    {
-			    ms_sleep(HTTP_SERVICE_LOOP_SLEEP_NORMAL_MS);
+			    long wait_ms(HTTP_SERVICE_LOOP_WAIT_MAX_MS);
+			    const HttpTime deadline(mPolicy->getNextDeadline());
+			    if (deadline)
+			    {
+				    const HttpTime now(totalTime());
+				    wait_ms = deadline <= now ? 0L : (std::min)(wait_ms, long((deadline - now + 999) / 1000));
+			    }
+			    mTransport->waitForActivity(wait_ms);
 		    }
         }
         catch (const LLContinueError&)
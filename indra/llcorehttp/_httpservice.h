@@ -105,6 +105,7 @@ public:
 	enum ELoopSpeed
 	{
 		NORMAL,					///< continuous polling of request, ready, active queues
+		ACTIVITY_WAIT,			///< can wait for socket activity, a new request or a policy deadline
 		REQUEST_SLEEP			///< can sleep indefinitely waiting for request queue write
 	};
 
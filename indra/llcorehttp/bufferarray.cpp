@@ -31,10 +31,10 @@
 #include "llmemory.h"
 
 
-// BufferArray is a list of chunks, each a BufferArray::Block, of contiguous
-// data presented as a single array.  Chunks are at least BufferArray::BLOCK_ALLOC_SIZE
-// in length and can be larger.  Any chunk may be partially filled or even
-// empty.
+// BufferArray is a list of chunks, each a BufferArray::MemoryBlock, of contiguous
+// data presented as a single array.  Chunks are normally BufferArray::BLOCK_ALLOC_SIZE
+// in length but reserve() and appendBufferAlloc() make them to measure.  Any
+// chunk may be partially filled or even empty.
 //
 // The BufferArray itself is sharable as a RefCounted entity.  As shared
 // reads don't work with the concept of a current position/seek value,
@@ -48,75 +48,54 @@ namespace LLCore
 
 
 // ==================================
-// BufferArray::Block Declaration
+// BufferArray::MemoryBlock Declaration
 // ==================================
-template <std::size_t _size>
+
+// One extent of storage.  Data occupy the first mUsed bytes of the
+// mAlloced available.  Storage is 16-byte aligned so that a whole
+// extent can be handed off to image code (see detachContiguous()).
+// Blocks move cheaply so growing the container doesn't copy data.
 struct BufferArray::MemoryBlock
 {
-	typedef char			value_type;
-	typedef char*			pointer;
-	typedef const char*		const_pointer;
-	typedef char*			iterator;
-	typedef const char*		const_iterator;
-	typedef char&			reference;
-	typedef const char&		const_reference;
-	typedef std::size_t		size_type;
-	typedef std::ptrdiff_t	difference_type;
-	//typedef std::reverse_iterator<iterator> reverse_iterator;
-	//typedef std::reverse_iterator<const_iterator> const_reverse_interator;
-
-	MemoryBlock() = default;
-	~MemoryBlock() = default;
-
-	MemoryBlock(const_pointer data, size_type length) {
-		if (length > _size) {
-			throw std::out_of_range("initialized with a length past container size");
-		}
-
-		memcpy(&(_data[0]), data, length);
-		_pos = length;
+	explicit MemoryBlock(size_t len)
+		: mData(static_cast<char *>(ll_aligned_malloc_16(len ? len : 1))),
+		  mUsed(0),
+		  mAlloced(mData ? len : 0)
+	{}
+
+	MemoryBlock(MemoryBlock && other) noexcept
+		: mData(other.mData),
+		  mUsed(other.mUsed),
+		  mAlloced(other.mAlloced)
+	{
+		other.mData = nullptr;
+		other.mUsed = other.mAlloced = 0;
 	}
 
-	MemoryBlock(const MemoryBlock<_size> &&other) noexcept {
-		memcpy(&(_data[0]), &(other._data[0]), other._pos);
-		_pos = other._pos;
+	MemoryBlock & operator=(MemoryBlock && other) noexcept
+	{
+		std::swap(mData, other.mData);
+		std::swap(mUsed, other.mUsed);
+		std::swap(mAlloced, other.mAlloced);
+		return *this;
 	}
 
-	MemoryBlock(const MemoryBlock<_size> &) = delete;
-	MemoryBlock<_size>& operator=(const MemoryBlock<_size> &) = delete;
-
-	void append(const_pointer data, size_type length) {
-		if (_pos + length > _size) {
-			throw std::out_of_range("append would go past array");
+	~MemoryBlock()
+	{
+		if (mData)
+		{
+			ll_aligned_free_16(mData);
 		}
-
-		memcpy(&(_data[_pos]), data, length);
-		_pos += length;
 	}
 
-	iterator begin() { return iterator(std::addressof(_data[0])); }
-	const_iterator begin() const { return const_iterator(std::addressof(_data[0])); }
-
-	pointer end() { return iterator(std::addressof(_data[_size])); }
-	const_iterator end() const { return const_iterator(std::addressof(_data[_size])); }
+	MemoryBlock(const MemoryBlock &) = delete;
+	MemoryBlock & operator=(const MemoryBlock &) = delete;
 
-	iterator data_end() { return iterator(std::addressof(_data[_pos])); }
-	const_iterator data_end() const { return const_iterator(std::addressof(_data[_pos])); }
+	size_t space_available() const { return mAlloced - mUsed; }
 
-	reference operator[](size_type n) { return _data[n]; }
-	const_reference operator[](size_type n) const { return _data[n]; }
-
-	pointer data() { return std::addressof(_data[0]); }
-	const_pointer data() const { return std::addressof(_data[0]); }
-
-	size_type size() const { return _size; }
-
-	size_type pos() { return _pos; }
-
-	bool space_available() { return _pos < _size; }
-private:
-	char _data[_size ? _size : 1];
-	size_t _pos;
+	char *	mData;
+	size_t	mUsed;
+	size_t	mAlloced;
 };
 
 
@@ -136,6 +115,38 @@ BufferArray::~BufferArray()
 }
 
 
+BufferArray::block_t * BufferArray::addBlock(size_t len)
+{
+	try
+	{
+		if (mBlocks.size() >= mBlocks.capacity())
+		{
+			mBlocks.reserve(mBlocks.size() + 5);
+		}
+		mBlocks.emplace_back(len);
+	}
+	catch (const std::bad_alloc&)
+	{
+		LLMemory::logMemoryInfo(TRUE);
+
+		//output possible call stacks to log file.
+		LLError::LLCallStacks::print();
+
+		LL_WARNS() << "Bad memory allocation in thrown by mBlock.reserve!" << LL_ENDL;
+		return nullptr;
+	}
+
+	block_t & block(mBlocks.back());
+	if (! block.mData)
+	{
+		LL_WARNS() << "Unable to allocate " << len << " byte BufferArray block" << LL_ENDL;
+		mBlocks.pop_back();
+		return nullptr;
+	}
+	return &block;
+}
+
+
 size_t BufferArray::append(const void * src, size_t len)
 {
 	size_t result = 0;
@@ -147,9 +158,10 @@ size_t BufferArray::append(const void * src, size_t len)
 		block_t& last = mBlocks.back();
 		if (last.space_available())
 		{
-			const size_t copy_len = std::min(len, (last.size() - last.pos()));
+			const size_t copy_len = std::min(len, last.space_available());
 
-			last.append(c_src, copy_len);
+			memcpy(last.mData + last.mUsed, c_src, copy_len);
+			last.mUsed += copy_len;
 			mLen += copy_len;
 			result += copy_len;
 
@@ -160,27 +172,16 @@ size_t BufferArray::append(const void * src, size_t len)
 
 	while (len > 0)
 	{
-		const size_t copy_len((std::min)(len, BLOCK_ALLOC_SIZE));
-
-        try
-        {
-			if (mBlocks.size() >= mBlocks.capacity())
-			{
-				mBlocks.reserve(mBlocks.size() + 5);
-			}
-        }
-        catch (const std::bad_alloc&)
-        {
-            LLMemory::logMemoryInfo(TRUE);
-
-            //output possible call stacks to log file.
-            LLError::LLCallStacks::print();
-
-            LL_WARNS() << "Bad memory allocation in thrown by mBlock.reserve!" << LL_ENDL;
-            break;
-        }
+		const size_t copy_len((std::min)(len, size_t(BLOCK_ALLOC_SIZE)));
+
+		block_t * block(addBlock(BLOCK_ALLOC_SIZE));
+		if (! block)
+		{
+			break;
+		}
 		
-		mBlocks.emplace_back(c_src, copy_len);
+		memcpy(block->mData, c_src, copy_len);
+		block->mUsed = copy_len;
 		mLen += copy_len;
 		result += copy_len;
 
@@ -192,6 +193,55 @@ size_t BufferArray::append(const void * src, size_t len)
 }
 
 
+void * BufferArray::appendBufferAlloc(size_t len)
+{
+	// Leave the usual room behind it so later appends
+	// can continue in the same block.
+	block_t * block(addBlock((std::max)(len, size_t(BLOCK_ALLOC_SIZE))));
+	if (! block)
+	{
+		return nullptr;
+	}
+	block->mUsed = len;
+	mLen += len;
+	return block->mData;
+}
+
+
+bool BufferArray::reserve(size_t len)
+{
+	if (! mBlocks.empty() && mBlocks.back().space_available() >= len
+		&& mBlocks.back().mUsed == mLen)
+	{
+		// Everything is already in one extent with room to spare
+		return true;
+	}
+
+	// Consolidate what's here (normally nothing) into the new extent
+	block_t extent(mLen + len);
+	if (! extent.mData)
+	{
+		LL_WARNS() << "Unable to reserve " << (mLen + len) << " byte BufferArray extent" << LL_ENDL;
+		return false;
+	}
+	extent.mUsed = read(0, extent.mData, mLen);
+
+	try
+	{
+		container_t blocks;
+		blocks.reserve(5);
+		blocks.emplace_back(std::move(extent));
+		mBlocks.swap(blocks);
+	}
+	catch (const std::bad_alloc&)
+	{
+		LL_WARNS() << "Bad memory allocation reserving BufferArray extent" << LL_ENDL;
+		return false;
+	}
+	return true;
+}
+
+
 size_t BufferArray::read(size_t pos, void * dst, size_t len)
 {
 	char *c_dst = static_cast<char *>(dst);
@@ -204,14 +254,14 @@ size_t BufferArray::read(size_t pos, void * dst, size_t len)
 	size_t result = 0, offset = 0;
 	const int block_limit(mBlocks.size());
 
-	for (int i = findBlock(pos, &offset); len && i < block_limit; ++i)
+	for (int i = findBlock(pos, &offset); i >= 0 && len && i < block_limit; ++i)
 	{
-		block_t& block = mBlocks[i];
+		const block_t& block = mBlocks[i];
 
-		size_t block_limit_offset = block.pos() - offset;
+		size_t block_limit_offset = block.mUsed - offset;
 		size_t block_len(std::min(block_limit_offset, len));
 
-		memcpy(c_dst, &block[offset], block_len);
+		memcpy(c_dst, block.mData + offset, block_len);
 		result += block_len;
 
 		c_dst += block_len;
@@ -231,16 +281,16 @@ size_t BufferArray::write(size_t pos, const void * src, size_t len)
 		return 0;
 	
 	size_t result = 0, offset = 0;
-	const size_t block_limit = mBlocks.size();
+	const int block_limit(mBlocks.size());
 
-	for (int i = findBlock(pos, &offset); len && i < block_limit; ++i)
+	// Overwrite whatever existing data the range covers
+	for (int i = findBlock(pos, &offset); i >= 0 && len && i < block_limit; ++i)
 	{
 		block_t& block = mBlocks[i];
-		size_t block_limit_offset = block.pos() - offset;
+		size_t block_limit_offset = block.mUsed - offset;
 		size_t block_len = std::min(block_limit_offset, len);
 
-		block.append(c_src, block_len);
-		mLen += block_len;
+		memcpy(block.mData + offset, c_src, block_len);
 		result += block_len;
 
 		c_src += block_len;
@@ -258,33 +308,88 @@ size_t BufferArray::write(size_t pos, const void * src, size_t len)
 
 	return result;
 }
+
+
+const char * BufferArray::getSegment(size_t pos, size_t * seg_len) const
+{
+	size_t offset(0);
+	const int block(findBlock(pos, &offset));
+	if (block < 0)
+	{
+		*seg_len = 0;
+		return nullptr;
+	}
+
+	const block_t & b(mBlocks[block]);
+	*seg_len = b.mUsed - offset;
+	return b.mData + offset;
+}
+
+
+char * BufferArray::getContiguous(size_t pos, size_t len)
+{
+	if (pos + len > mLen)
+		return nullptr;
+
+	size_t offset(0);
+	const int block(findBlock(pos, &offset));
+	if (block < 0 || mBlocks[block].mUsed - offset < len)
+		return nullptr;
+
+	return mBlocks[block].mData + offset;
+}
+
+
+char * BufferArray::detachContiguous()
+{
+	if (! mLen)
+		return nullptr;
+
+	size_t offset(0);
+	const int block(findBlock(0, &offset));
+	if (block < 0 || mBlocks[block].mUsed != mLen)
+		return nullptr;
+
+	char * data(mBlocks[block].mData);
+	mBlocks[block].mData = nullptr;
+	mBlocks.clear();
+	mLen = 0;
+	return data;
+}
 		
 
-int BufferArray::findBlock(size_t pos, size_t * ret_offset)
+int BufferArray::findBlock(size_t pos, size_t * ret_offset) const
 {
 	*ret_offset = 0;
 	if (pos >= mLen)
 		return -1;
 
-	const int block_n = pos / BLOCK_ALLOC_SIZE;
-	if (block_n < mBlocks.size())
+	// Blocks vary in size, walk them.  There are few in the
+	// common case and only one after reserve().
+	const int block_limit(mBlocks.size());
+	for (int i(0); i < block_limit; ++i)
 	{
-		*ret_offset = pos % BLOCK_ALLOC_SIZE;
-		return block_n;
+		const size_t used(mBlocks[i].mUsed);
+		if (pos < used)
+		{
+			*ret_offset = pos;
+			return i;
+		}
+		pos -= used;
 	}
 
 	return -1;
 }
 
 
-bool BufferArray::getBlockStartEnd(int block, const char ** start, const char ** end)
+bool BufferArray::getBlockStartEnd(int block, const char ** start, const char ** end) const
 {
 	if (block < 0 || block >= mBlocks.size())
 		return false;
 
 	const block_t& b(mBlocks[block]);
-	*start = b.begin();
-	*end = b.data_end();
+	*start = b.mData;
+	*end = b.mData + b.mUsed;
 	return true;
 }
 	
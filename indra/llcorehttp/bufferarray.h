@@ -59,6 +59,12 @@ class BufferArrayStreamBuf;
 /// write and append operations and beyond which the current position
 /// cannot be set.
 ///
+/// Consumers that can work on discontiguous data should walk the
+/// extents with getSegment() instead of read()ing into a buffer of
+/// their own.  When the final size is known up front, reserve() puts
+/// everything in a single extent which getContiguous() can then hand
+/// out directly and detachContiguous() can give away outright.
+///
 /// Threading:  not thread-safe
 ///
 /// Allocation:  Refcounted, heap only.  Caller of the constructor
@@ -94,12 +100,53 @@ public:
 	/// @return			Count of bytes copied to BufferArray
 	size_t append(const void * src, size_t len);
 
+	/// Appends a new, uninitialized extent of the given size to
+	/// the BufferArray and returns it for the caller to fill in.
+	/// Zero-length requests get a valid, distinct pointer.
+	///
+	/// @return			Pointer to the new extent or NULL on
+	///					allocation failure.
+	void * appendBufferAlloc(size_t len);
+
+	/// Makes room for @len bytes more than are currently held
+	/// in a single extent so that following append()s and
+	/// write()s up to that total land contiguously.  Typically
+	/// used with a response's Content-Length.  Data beyond the
+	/// reservation still go in ordinary blocks.
+	///
+	/// @return			True if the space was reserved.
+	bool reserve(size_t len);
+
 	/// Current count of bytes in BufferArray instance.
 	size_t size() const
 		{
 			return mLen;
 		}
 
+	/// Scatter/gather access without copying.  Returns the
+	/// extent holding the byte at 'pos' and sets '*seg_len'
+	/// to the count of bytes from there to the end of the
+	/// extent.  Advance 'pos' by that count for the next one.
+	///
+	/// @return			Pointer into the instance's storage
+	///					or NULL if 'pos' is at or past the end.
+	///					Valid until the next modifying call.
+	const char * getSegment(size_t pos, size_t * seg_len) const;
+
+	/// Returns the 'len' bytes at 'pos' in place if they are
+	/// held contiguously, NULL if they aren't (or aren't all
+	/// there), in which case read() is the fallback.
+	char * getContiguous(size_t pos, size_t len);
+
+	/// When the whole content is held in one extent, gives that
+	/// extent to the caller and leaves the instance empty.
+	/// Storage comes from ll_aligned_malloc_16() and must be
+	/// released with ll_aligned_free_16().
+	///
+	/// @return			Data of size() bytes or NULL, with
+	///					nothing changed, when scattered or empty.
+	char * detachContiguous();
+
 	/// Copies data from the given position in the instance
 	/// to the caller's buffer.  Will return a short count of
 	/// bytes copied if the 'len' extends beyond the data.
@@ -112,17 +159,20 @@ public:
 	size_t write(size_t pos, const void * src, size_t len);
 	
 protected:
-	int findBlock(size_t pos, size_t * ret_offset);
+	int findBlock(size_t pos, size_t * ret_offset) const;
 
-	bool getBlockStartEnd(int block, const char ** start, const char ** end);
+	bool getBlockStartEnd(int block, const char ** start, const char ** end) const;
 	
 protected:
-	template <std::size_t>
 	struct MemoryBlock;
 
-	typedef MemoryBlock<BLOCK_ALLOC_SIZE> block_t;
+	typedef MemoryBlock block_t;
 	typedef std::vector<block_t> container_t;
 
+	/// Appends an empty block able to hold 'len' bytes.
+	/// NULL on allocation failure.
+	block_t * addBlock(size_t len);
+
 	container_t			mBlocks;
 	size_t				mLen;
 
@@ -233,6 +233,30 @@ public:
 		/// Global only
 		PO_SSL_VERIFY_CALLBACK,
 
+		/// If non-zero, requests in the class ask for HTTP/2 and
+		/// are multiplexed as concurrent streams over a few
+		/// connections instead of each taking a connection of its
+		/// own.  Value is the maximum number of streams per
+		/// connection so the in-flight request limit becomes
+		/// PO_PER_HOST_CONNECTION_LIMIT times this value, much as
+		/// with PO_PIPELINING_DEPTH which it takes the place of.
+		/// HTTPS servers negotiate the protocol and may still answer
+		/// in HTTP/1.1, plain http:// requests stay on HTTP/1.1
+		/// unless PO_HTTP2_PRIOR_KNOWLEDGE is also set.  Zero, the
+		/// default, leaves the class on HTTP/1.1.
+		///
+		/// Per-class only
+		PO_HTTP2_STREAMS,
+
+		/// Long value that if non-zero makes plain http:// requests
+		/// in a PO_HTTP2_STREAMS class speak HTTP/2 from the first
+		/// byte (h2c with prior knowledge).  Servers that don't will
+		/// fail every request so this is only for those known to
+		/// support it, such as the unit test server.
+		///
+		/// Per-class only
+		PO_HTTP2_PRIOR_KNOWLEDGE,
+
 		PO_LAST  // Always at end
 	};
 
@@ -45,6 +45,9 @@ void HTTPStats::resetStats()
     mDataDown.reset();
     mDataUp.reset();
     mRequests = 0;
+    mConnectionStreams.reset();
+    mConnectionPeakStreams.reset();
+    mHttp2Connections = 0;
 }
 
 
@@ -61,6 +64,14 @@ void HTTPStats::recordResultCode(S32 code)
 
 }
 
+void HTTPStats::recordConnection(U32 streams, U32 peak_streams, bool http2)
+{
+    mConnectionStreams.push(streams);
+    mConnectionPeakStreams.push(peak_streams);
+    if (http2)
+        ++mHttp2Connections;
+}
+
 namespace
 {
     std::string byte_count_converter(F32 bytes)
@@ -93,6 +104,9 @@ void HTTPStats::dumpStats()
     out << "Data Sent: " << byte_count_converter(mDataUp.getSum()) << "   (" << mDataUp.getSum() << ")" << std::endl;
     out << "Data Recv: " << byte_count_converter(mDataDown.getSum()) << "   (" << mDataDown.getSum() << ")" << std::endl;
     out << "Total requests: " << mRequests << "(request objects created)" << std::endl;
+    out << "Connections: " << mConnectionStreams.getCount() << " busy periods, " << mHttp2Connections << " on HTTP/2" << std::endl;
+    out << "Requests per connection: mean " << mConnectionStreams.getMean() << " max " << mConnectionStreams.getMaxValue() << std::endl;
+    out << "Concurrent requests per connection: mean " << mConnectionPeakStreams.getMean() << " max " << mConnectionPeakStreams.getMaxValue() << std::endl;
     out << std::endl;
     out << "Result Codes:" << std::endl << "--- -----" << std::endl;
 
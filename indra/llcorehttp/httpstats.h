@@ -59,6 +59,10 @@ namespace LLCore
 
         void    recordResultCode(S32 code);
 
+        /// A connection went idle after carrying @streams requests,
+        /// at most @peak_streams of them at once.
+        void    recordConnection(U32 streams, U32 peak_streams, bool http2);
+
         void    dumpStats();
     private:
         StatsAccumulator mDataDown;
@@ -66,6 +70,10 @@ namespace LLCore
 
         S32              mRequests;
 
+        StatsAccumulator mConnectionStreams;
+        StatsAccumulator mConnectionPeakStreams;
+        S32              mHttp2Connections;
+
         std::map<S32, S32> mResutCodes;
     };
 
@@ -29,6 +29,9 @@
 #include "bufferarray.h"
 
 #include <iostream>
+#include <vector>
+
+#include "llmemory.h"
 
 #include "test_allocator.h"
 
@@ -426,6 +429,109 @@ void BufferArrayTestObjectType::test<8>()
 	ensure("All memory released", mMemTotal == GetMemTotal());
 }
 
+template <> template <>
+void BufferArrayTestObjectType::test<9>()
+{
+	set_test_name("BufferArray segment walk");
+
+	// record the total amount of dynamically allocated memory
+	mMemTotal = GetMemTotal();
+
+	// create a new ref counted object with an implicit reference
+	BufferArray * ba = new BufferArray();
+
+	// Enough to need several blocks
+	std::vector<char> src(3 * BufferArray::BLOCK_ALLOC_SIZE + 17);
+	for (size_t i(0); i < src.size(); ++i)
+	{
+		src[i] = char(i * 7);
+	}
+	size_t len = ba->append(&src[0], src.size());
+	ensure("Append length correct", src.size() == len);
+
+	// Walk from an unaligned start and compare in place
+	size_t pos(5), seg_len(0), segments(0);
+	bool same(true);
+	while (const char * seg = ba->getSegment(pos, &seg_len))
+	{
+		ensure("Segment not empty", seg_len > 0);
+		same = same && 0 == memcmp(seg, &src[pos], seg_len);
+		pos += seg_len;
+		++segments;
+	}
+	ensure("Walk reaches the end", src.size() == pos);
+	ensure("Walk sees the data", same);
+	ensure("Walk crosses blocks", segments > 1);
+	ensure("No segment past the end", NULL == ba->getSegment(src.size(), &seg_len) && 0 == seg_len);
+
+	// Scattered data isn't contiguous
+	ensure("Spanning range not contiguous", NULL == ba->getContiguous(0, src.size()));
+	ensure("Scattered data not detachable", NULL == ba->detachContiguous());
+	char * block_data(ba->getContiguous(1, 10));
+	ensure("Range within a block contiguous", NULL != block_data && 0 == memcmp(block_data, &src[1], 10));
+
+	// release the implicit reference, causing the object to be released
+	ba->release();
+
+	// make sure we didn't leak any memory
+	ensure("All memory released", mMemTotal == GetMemTotal());
+}
+
+template <> template <>
+void BufferArrayTestObjectType::test<10>()
+{
+	set_test_name("BufferArray reserved single extent");
+
+	// record the total amount of dynamically allocated memory
+	mMemTotal = GetMemTotal();
+
+	// create a new ref counted object with an implicit reference
+	BufferArray * ba = new BufferArray();
+
+	char str1[] = "abcdefghij";
+	size_t str1_len(strlen(str1));
+	std::vector<char> src(2 * BufferArray::BLOCK_ALLOC_SIZE, 'q');
+
+	// Data already present move into the extent
+	ba->append(str1, str1_len);
+	ensure("Reserve succeeds", ba->reserve(src.size()));
+	ensure("Reserve keeps size", str1_len == ba->size());
+
+	// Appends up to the reservation stay contiguous
+	size_t len = ba->append(&src[0], src.size());
+	ensure("Append length correct", src.size() == len);
+	const char * all(ba->getContiguous(0, ba->size()));
+	ensure("Reserved data contiguous", NULL != all);
+	ensure("Reserved content correct", 0 == memcmp(all, str1, str1_len));
+	ensure("Reserved content correct.2", 0 == memcmp(all + str1_len, &src[0], src.size()));
+	ensure("Range past the end not contiguous", NULL == ba->getContiguous(1, ba->size()));
+
+	// Whole extent can be taken away
+	size_t total(ba->size());
+	char * data(ba->detachContiguous());
+	ensure("Detach succeeds", NULL != data);
+	ensure("Detached data correct", 0 == memcmp(data, str1, str1_len) && 'q' == data[total - 1]);
+	ensure("Detach empties array", 0 == ba->size());
+	ll_aligned_free_16(data);
+
+	// And the array is still usable.  Overflowing a
+	// reservation spills into another block.
+	ensure("Second reserve succeeds", ba->reserve(4));
+	len = ba->append(str1, str1_len);
+	ensure("Append after detach", str1_len == len && str1_len == ba->size());
+	ensure("Overflow not contiguous", NULL == ba->getContiguous(0, ba->size()));
+	ensure("Reserved part contiguous", NULL != ba->getContiguous(0, 4));
+	char buffer[32];
+	len = ba->read(0, buffer, sizeof(buffer));
+	ensure("Overflow content correct", str1_len == len && 0 == memcmp(buffer, str1, str1_len));
+
+	// release the implicit reference, causing the object to be released
+	ba->release();
+
+	// make sure we didn't leak any memory
+	ensure("All memory released", mMemTotal == GetMemTotal());
+}
+
 }  // end namespace tut
 
 
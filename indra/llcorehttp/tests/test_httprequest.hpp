@@ -37,6 +37,7 @@
 
 #include <curl/curl.h>
 #include <boost/regex.hpp>
+#include <set>
 #include <sstream>
 
 #include "test_allocator.h"
@@ -3222,6 +3223,179 @@ void HttpRequestTestObjectType::test<23>()
 }
 
 
+// Handler that also notes which server connection each response
+// came over and the most streams the server saw on it at once.
+class TestHandlerH2 : public TestHandler2
+{
+public:
+	TestHandlerH2(HttpRequestTestData * state, const std::string & name)
+		: TestHandler2(state, name),
+		  mPeakStreams(0)
+		{}
+
+	virtual void onCompleted(HttpHandle handle, HttpResponse * response)
+		{
+			TestHandler2::onCompleted(handle, response);
+
+			HttpHeaders::ptr_t header(response ? response->getHeaders() : HttpHeaders::ptr_t());
+			ensure("Headers returned from HTTP/2 peer", header != NULL);
+			const std::string * connection(header->find("x-ll-connection"));
+			const std::string * peak(header->find("x-ll-peak-streams"));
+			ensure("Connection header returned", connection != NULL);
+			ensure("Peak streams header returned", peak != NULL);
+			mConnections.insert(*connection);
+			mPeakStreams = (std::max)(mPeakStreams, atoi(peak->c_str()));
+		}
+
+	std::set<std::string> mConnections;
+	int mPeakStreams;
+};
+
+template <> template <>
+void HttpRequestTestObjectType::test<24>()
+{
+	ScopedCurlInit ready;
+
+	set_test_name("HttpRequest GETs multiplexed over one HTTP/2 connection");
+
+	const char * h2_port(getenv("LL_TEST_H2_PORT"));
+	if (! h2_port)
+	{
+		skip("No HTTP/2 peer, LL_TEST_H2_PORT not set");
+	}
+	const curl_version_info_data * curl_info(curl_version_info(CURLVERSION_NOW));
+	if (! (curl_info->features & CURL_VERSION_HTTP2))
+	{
+		skip("libcurl built without HTTP/2");
+	}
+	if (curl_info->version_num >= 0x075800 && curl_info->version_num <= 0x075801)
+	{
+		// These fail every transfer after the first on a reused
+		// prior-knowledge connection, whatever the server.
+		skip("libcurl 7.88.0-7.88.1 can't reuse prior-knowledge HTTP/2 connections");
+	}
+
+	// Handler can be stack-allocated *if* there are no dangling
+	// references to it after completion of this method.
+	// Create before memory record as the string copy will bump numbers.
+	TestHandlerH2 handler(this, "handler");
+	LLCore::HttpHandler::ptr_t handlerp(&handler, NoOpDeletor);
+	std::string url_base(std::string("http://127.0.0.1:") + h2_port + "/");
+
+	// record the total amount of dynamically allocated memory
+	mMemTotal = GetMemTotal();
+	mHandlerCalls = 0;
+
+	HttpRequest * req = NULL;
+	HttpOptions::ptr_t opts;
+
+	try
+	{
+		// Get singletons created
+		HttpRequest::createService();
+
+		// One connection to the host, up to four streams on it.
+		// Static options must be set before the thread starts.
+		const long stream_limit(4);
+		HttpRequest::policy_t policy_class(HttpRequest::createPolicyClass());
+		ensure("Policy class created", policy_class != HttpRequest::INVALID_POLICY_ID);
+		HttpRequest::setStaticPolicyOption(HttpRequest::PO_CONNECTION_LIMIT, policy_class, 1, NULL);
+		HttpRequest::setStaticPolicyOption(HttpRequest::PO_PER_HOST_CONNECTION_LIMIT, policy_class, 1, NULL);
+		HttpRequest::setStaticPolicyOption(HttpRequest::PO_HTTP2_STREAMS, policy_class, stream_limit, NULL);
+		HttpRequest::setStaticPolicyOption(HttpRequest::PO_HTTP2_PRIOR_KNOWLEDGE, policy_class, 1, NULL);
+
+		// Start threading early so that thread memory is invariant
+		// over the test.
+		HttpRequest::startThread();
+
+		// create a new ref counted object with an implicit reference
+		req = new HttpRequest();
+		ensure("Memory allocated on construction", mMemTotal < GetMemTotal());
+
+		opts = HttpOptions::ptr_t(new HttpOptions());
+		opts->setWantHeaders(true);
+
+		// Issue twice as many GETs as there are streams.  The peer
+		// holds each response long enough for the rest to pile up.
+		mStatus = HttpStatus(200);
+		const int url_limit(8);
+		for (int i(0); i < url_limit; ++i)
+		{
+			std::ostringstream url;
+			url << url_base << i;
+			HttpHandle handle = req->requestGet(policy_class,
+												0U,
+												url.str(),
+												opts,
+												HttpHeaders::ptr_t(),
+												handlerp);
+
+			std::ostringstream testtag;
+			testtag << "Valid handle returned for HTTP/2 request #" << i;
+			ensure(testtag.str(), handle != LLCORE_HTTP_HANDLE_INVALID);
+		}
+
+		// Run the notification pump.
+		int count(0);
+		int limit(LOOP_COUNT_LONG);
+		while (count++ < limit && mHandlerCalls < url_limit)
+		{
+			req->update(0);
+			usleep(LOOP_SLEEP_INTERVAL);
+		}
+		ensure("Requests executed in reasonable time", count < limit);
+		ensure("One handler invocation for each request", mHandlerCalls == url_limit);
+		ensure("All requests carried by one connection", handler.mConnections.size() == 1);
+		ensure("Requests multiplexed on the connection", handler.mPeakStreams > 1);
+		ensure("Stream limit respected", handler.mPeakStreams <= stream_limit);
+
+		// Okay, request a shutdown of the servicing thread
+		mStatus = HttpStatus();
+		mHandlerCalls = 0;
+		HttpHandle handle = req->requestStopThread(handlerp);
+		ensure("Valid handle returned for second request", handle != LLCORE_HTTP_HANDLE_INVALID);
+
+		// Run the notification pump again
+		count = 0;
+		limit = LOOP_COUNT_LONG;
+		while (count++ < limit && mHandlerCalls < 1)
+		{
+			req->update(1000000);
+			usleep(LOOP_SLEEP_INTERVAL);
+		}
+		ensure("Second request executed in reasonable time", count < limit);
+		ensure("Second handler invocation", mHandlerCalls == 1);
+
+		// See that we actually shutdown the thread
+		count = 0;
+		limit = LOOP_COUNT_SHORT;
+		while (count++ < limit && ! HttpService::isStopped())
+		{
+			usleep(LOOP_SLEEP_INTERVAL);
+		}
+		ensure("Thread actually stopped running", HttpService::isStopped());
+
+		// release options
+		opts.reset();
+
+		// release the request object
+		delete req;
+		req = NULL;
+
+		// Shut down service
+		HttpRequest::destroyService();
+	}
+	catch (...)
+	{
+		stop_thread(req);
+		opts.reset();
+		delete req;
+		HttpRequest::destroyService();
+		throw;
+	}
+}
+
+
 }  // end namespace tut
 
 namespace
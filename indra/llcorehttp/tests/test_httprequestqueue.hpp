@@ -182,6 +182,53 @@ void HttpRequestqueueTestObjectType::test<4>()
 	ensure("All memory returned", mMemTotal == GetMemTotal());
 }
 
+template <> template <>
+void HttpRequestqueueTestObjectType::test<5>()
+{
+	set_test_name("HttpRequestQueue wakeup function");
+
+	// record the total amount of dynamically allocated memory
+	mMemTotal = GetMemTotal();
+
+	HttpRequestQueue::init();
+	HttpRequestQueue * rq = HttpRequestQueue::instanceOf();
+
+	int wakeups(0);
+	rq->setWakeupFunction([&wakeups]() { ++wakeups; });
+
+	{
+		HttpOperation::ptr_t op(new HttpOpNull());
+		rq->addOp(op);
+		ensure("Wakeup when the queue fills", 1 == wakeups);
+
+		op.reset(new HttpOpNull());
+		rq->addOp(op);
+		ensure("No wakeup while it isn't empty", 1 == wakeups);
+
+		HttpRequestQueue::OpContainer ops;
+		rq->fetchAll(false, ops);
+		ensure("Both came out", 2 == ops.size());
+
+		op.reset(new HttpOpNull());
+		rq->addOp(op);
+		ensure("Wakeup once it has been emptied", 2 == wakeups);
+
+		rq->stopQueue();
+		ensure("Wakeup on stop", 3 == wakeups);
+
+		rq->setWakeupFunction(HttpRequestQueue::wakeup_fn_t());
+		ops.clear();
+		rq->fetchAll(false, ops);
+		ops.clear();
+		op.reset();
+	}
+
+	HttpRequestQueue::term();
+
+	// Should be clean
+	ensure("All memory returned", mMemTotal == GetMemTotal());
+}
+
 }  // end namespace tut
 
 
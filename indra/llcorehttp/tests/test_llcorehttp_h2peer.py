@@ -0,0 +1,180 @@
+#!/usr/bin/env python
+"""\
+@file   test_llcorehttp_h2peer.py
+@brief  Minimal cleartext HTTP/2 (prior knowledge) server used by the
+        llcorehttp integration tests to check stream multiplexing.
+
+$LicenseInfo:firstyear=2020&license=viewerlgpl$
+Second Life Viewer Source Code
+Copyright (C) 2010, Linden Research, Inc.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation;
+version 2.1 of the License only.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+$/LicenseInfo$
+"""
+
+import select
+import socket
+import struct
+import threading
+import time
+try:
+    import SocketServer as socketserver
+except ImportError:
+    import socketserver
+
+# Only as much of RFC 7540 as libcurl needs to run GETs over a single
+# prior-knowledge connection.  Request header blocks are never decoded
+# (every request gets the same answer) and responses use only static
+# table and literal HPACK representations, so no header compression
+# state is kept on either side.
+#
+# Every response carries:
+# - 'X-LL-Connection'    Serial number of the connection it came on
+# - 'X-LL-Peak-Streams'  Most streams waiting on that connection at once
+#                        so far
+# Responses are held for HOLD_SECONDS so that a client which multiplexes
+# will have several streams open together.
+
+PREFACE = b"PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+HOLD_SECONDS = 0.05
+
+FRAME_DATA = 0x0
+FRAME_HEADERS = 0x1
+FRAME_RST_STREAM = 0x3
+FRAME_SETTINGS = 0x4
+FRAME_PING = 0x6
+FRAME_GOAWAY = 0x7
+FRAME_CONTINUATION = 0x9
+
+FLAG_ACK = 0x1
+FLAG_END_STREAM = 0x1
+FLAG_END_HEADERS = 0x4
+
+SETTINGS_MAX_CONCURRENT_STREAMS = 0x3
+
+
+def frame(ftype, flags, stream, payload=b""):
+    length = len(payload)
+    return struct.pack(">BHBBL", length >> 16, length & 0xffff,
+                       ftype, flags, stream & 0x7fffffff) + payload
+
+
+def literal_header(name, value):
+    # Literal Header Field without Indexing -- New Name, no Huffman
+    name = name.encode("ascii")
+    value = value.encode("ascii")
+    return (struct.pack("BB", 0x00, len(name)) + name
+            + struct.pack("B", len(value)) + value)
+
+
+class H2RequestHandler(socketserver.BaseRequestHandler):
+    def setup(self):
+        # Responses go out a frame pair at a time, don't let Nagle
+        # hold them back waiting on the client's delayed ACKs
+        self.request.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.buffer = b""
+        self.connection = self.server.next_connection()
+        self.pending = {}               # stream id -> time due
+        self.peak = 0
+        self.continuing = None          # stream waiting on CONTINUATION
+
+    def handle(self):
+        sock = self.request
+        if self.read_exact(len(PREFACE)) != PREFACE:
+            return
+        sock.sendall(frame(FRAME_SETTINGS, 0, 0,
+                           struct.pack(">HL", SETTINGS_MAX_CONCURRENT_STREAMS, 100)))
+        while True:
+            timeout = None
+            if self.pending:
+                timeout = max(0.0, min(self.pending.values()) - time.time())
+            # Frames may already be buffered behind the last one read
+            readable = self.buffer or select.select([sock], [], [], timeout)[0]
+            if readable:
+                header = self.read_exact(9)
+                if header is None:
+                    return
+                hi, lo, ftype, flags, stream = struct.unpack(">BHBBL", header)
+                payload = self.read_exact((hi << 16) | lo)
+                if payload is None or not self.dispatch(ftype, flags, stream & 0x7fffffff, payload):
+                    return
+            self.respond_due()
+
+    def dispatch(self, ftype, flags, stream, payload):
+        if ftype in (FRAME_HEADERS, FRAME_CONTINUATION):
+            if flags & FLAG_END_HEADERS:
+                self.continuing = None
+                self.pending[stream] = time.time() + HOLD_SECONDS
+                self.peak = max(self.peak, len(self.pending))
+            else:
+                self.continuing = stream
+        elif ftype == FRAME_SETTINGS:
+            if not flags & FLAG_ACK:
+                self.request.sendall(frame(FRAME_SETTINGS, FLAG_ACK, 0))
+        elif ftype == FRAME_PING:
+            if not flags & FLAG_ACK:
+                self.request.sendall(frame(FRAME_PING, FLAG_ACK, 0, payload))
+        elif ftype == FRAME_RST_STREAM:
+            self.pending.pop(stream, None)
+        elif ftype == FRAME_GOAWAY:
+            return False
+        # DATA, PRIORITY, WINDOW_UPDATE and the rest need no answer
+        return True
+
+    def respond_due(self):
+        now = time.time()
+        for stream, due in sorted(self.pending.items()):
+            if due > now:
+                continue
+            del self.pending[stream]
+            body = ("stream %d\n" % stream).encode("ascii")
+            block = (b"\x88"            # :status 200, static table index 8
+                     + literal_header("content-type", "text/plain")
+                     + literal_header("content-length", str(len(body)))
+                     + literal_header("x-ll-connection", str(self.connection))
+                     + literal_header("x-ll-peak-streams", str(self.peak)))
+            self.request.sendall(frame(FRAME_HEADERS, FLAG_END_HEADERS, stream, block)
+                                 + frame(FRAME_DATA, FLAG_END_STREAM, stream, body))
+
+    def read_exact(self, count):
+        while len(self.buffer) < count:
+            data = self.request.recv(65536)
+            if not data:
+                return None
+            self.buffer += data
+        data, self.buffer = self.buffer[:count], self.buffer[count:]
+        return data
+
+
+class H2Server(socketserver.ThreadingTCPServer):
+    # Same reasoning as Server in test_llcorehttp_peer.py
+    allow_reuse_address = False
+    daemon_threads = True
+
+    def __init__(self, address):
+        socketserver.ThreadingTCPServer.__init__(self, address, H2RequestHandler)
+        self.lock = threading.Lock()
+        self.connections = 0
+
+    def next_connection(self):
+        with self.lock:
+            self.connections += 1
+            return self.connections
+
+    def handle_error(self, request, client_address):
+        # Clients hanging up mid-frame are expected, stay quiet
+        pass
@@ -34,6 +34,7 @@ import sys
 import time
 import select
 import getopt
+import threading
 try:
     from cStringIO import StringIO
 except ImportError:
@@ -48,6 +49,7 @@ sys.path.append(os.path.join(os.path.dirname(__file__), os.pardir, os.pardir,
                              "llmessage", "tests"))
 
 from testrunner import freeport, run, debug, VERBOSE
+from test_llcorehttp_h2peer import H2Server
 
 class TestHTTPRequestHandler(BaseHTTPRequestHandler):
     """This subclass of BaseHTTPRequestHandler is to receive and echo
@@ -315,6 +317,17 @@ if __name__ == "__main__":
     # performed in TUT code rather than our own.
     os.environ["LL_TEST_PORT"] = str(httpd.server_port)
     debug("$LL_TEST_PORT = %s", httpd.server_port)
+
+    # Cleartext HTTP/2 peer for the multiplexing tests, same arrangement.
+    if not sys.platform.startswith("win"):
+        h2d = H2Server(('127.0.0.1', 0))
+    else:
+        h2d, h2port = freeport(xrange(8020, 8040), lambda port: H2Server(('127.0.0.1', port)))
+    h2thread = threading.Thread(target=h2d.serve_forever, name="h2d")
+    h2thread.setDaemon(True)
+    h2thread.start()
+    os.environ["LL_TEST_H2_PORT"] = str(h2d.server_address[1])
+    debug("$LL_TEST_H2_PORT = %s", h2d.server_address[1])
     if do_valgrind:
         args = ["valgrind", "--log-file=./valgrind.log"] + args
         path_search = True
@@ -0,0 +1,236 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/**
+ * @file llimage_bench.cpp
+ * @brief Times the image scaling, compositing and mip kernels
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "llcommon.h"
+#include "llimage.h"
+#include "llimagekernels.h"
+#include "lljobpool.h"
+#include "lltimer.h"
+
+// Each operation runs on the scalar single threaded kernels first, which is
+// what the viewer used before they were vectorized, then on the best path
+// with one thread and with the whole pool.  Results are compared against the
+// scalar output so a speedup never hides a wrong answer.
+
+namespace
+{
+	struct Config
+	{
+		LLImageKernels::EPath mPath;
+		U32 mThreads;
+	};
+
+	struct Operation
+	{
+		const char* mName;
+		S32 mComponents;
+		// Runs the operation once on an image of size x size, returns the output
+		LLPointer<LLImageRaw> (*mRun)(LLImageRaw* src, S32 size);
+	};
+
+	LLPointer<LLImageRaw> run_mip(LLImageRaw* src, S32 size)
+	{
+		LLPointer<LLImageRaw> dst = new LLImageRaw(size / 2, size / 2, src->getComponents());
+		LLImageBase::generateMip(src->getData(), dst->getData(), size / 2, size / 2, src->getComponents());
+		return dst;
+	}
+
+	LLPointer<LLImageRaw> run_scale_down(LLImageRaw* src, S32 size)
+	{
+		return src->scaled(size * 3 / 4, size * 3 / 4);
+	}
+
+	LLPointer<LLImageRaw> run_scale_up(LLImageRaw* src, S32 size)
+	{
+		return src->scaled(size * 5 / 4, size * 5 / 4);
+	}
+
+	LLPointer<LLImageRaw> run_composite(LLImageRaw* src, S32 size)
+	{
+		LLPointer<LLImageRaw> dst = new LLImageRaw(size / 2, size / 2, 3);
+		memset(dst->getData(), 0x80, dst->getDataSize());
+		dst->compositeScaled4onto3(src);
+		return dst;
+	}
+
+	const Operation OPERATIONS[] =
+	{
+		{ "mip rgba", 4, run_mip },
+		{ "mip rgb", 3, run_mip },
+		{ "mip alpha", 1, run_mip },
+		{ "scale down rgba", 4, run_scale_down },
+		{ "scale up rgb", 3, run_scale_up },
+		{ "composite 4onto3", 4, run_composite },
+	};
+
+	LLPointer<LLImageRaw> make_source(S32 size, S32 components)
+	{
+		LLPointer<LLImageRaw> image = new LLImageRaw(size, size, components);
+		U8* data = image->getData();
+		U32 seed = 0x12345678;
+		for (S32 i = 0; i < image->getDataSize(); ++i)
+		{
+			seed = seed * 1664525 + 1013904223;
+			data[i] = (U8)(seed >> 24);
+		}
+		return image;
+	}
+
+	// Largest difference between two images, -1 if they don't even have the same size
+	S32 max_difference(LLImageRaw* a, LLImageRaw* b)
+	{
+		if (!a || !b || a->getDataSize() != b->getDataSize())
+		{
+			return -1;
+		}
+		S32 diff = 0;
+		for (S32 i = 0; i < a->getDataSize(); ++i)
+		{
+			diff = llmax(diff, abs((S32)a->getData()[i] - (S32)b->getData()[i]));
+		}
+		return diff;
+	}
+
+	void usage(std::ostream& out)
+	{
+		out << "\n"
+			"usage:\tllimage_bench [-i iterations] [-t threads] [size ...]\n"
+			"\n"
+			"Times mip generation, scaling and compositing on square images of\n"
+			"each size (default 512 1024 2048 4096), with the scalar kernels on\n"
+			"one thread against the best kernels on one thread and on the pool.\n"
+			"\n"
+			"Options:\n"
+			"\n"
+			" -i <count>    Iterations per measurement (default 10)\n"
+			" -t <count>    Pool size, including the calling thread (default: auto)\n"
+			<< std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	S32 iterations = 10;
+	U32 threads = 0;
+	std::vector<S32> sizes;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg(argv[i]);
+		if ((arg == "-i" || arg == "-t") && i + 1 < argc)
+		{
+			S32 value = atoi(argv[++i]);
+			if (value <= 0)
+			{
+				usage(std::cerr);
+				return 1;
+			}
+			if (arg == "-i")
+			{
+				iterations = value;
+			}
+			else
+			{
+				threads = (U32)value;
+			}
+		}
+		else if (arg[0] != '-' && atoi(arg.c_str()) >= 8)
+		{
+			sizes.push_back(atoi(arg.c_str()) & ~7);
+		}
+		else
+		{
+			usage(std::cerr);
+			return 1;
+		}
+	}
+	if (sizes.empty())
+	{
+		sizes = { 512, 1024, 2048, 4096 };
+	}
+
+	LLCommon::initClass();
+	LLImage::initClass();
+	LLJobPool::initClass(threads);
+
+	LLImageKernels::EPath best = LLImageKernels::getPath();
+	U32 pool = LLImageKernels::getThreadCount();
+	std::vector<Config> configs;
+	configs.push_back({ LLImageKernels::PATH_SCALAR, 1 });
+	configs.push_back({ best, 1 });
+	if (pool > 1)
+	{
+		configs.push_back({ best, pool });
+	}
+
+	printf("%-18s %6s %-8s %7s %10s %8s %6s\n", "operation", "size", "path", "threads", "ms/iter", "speedup", "diff");
+	for (const Operation& op : OPERATIONS)
+	{
+		for (S32 size : sizes)
+		{
+			LLPointer<LLImageRaw> src = make_source(size, op.mComponents);
+			LLPointer<LLImageRaw> reference;
+			F64 reference_ms = 0.0;
+
+			for (const Config& config : configs)
+			{
+				LLJobPool::initClass(config.mThreads);
+				LLImageKernels::setPath(config.mPath);
+
+				LLPointer<LLImageRaw> result = op.mRun(src, size);	// warm up
+				LLTimer timer;
+				for (S32 i = 0; i < iterations; ++i)
+				{
+					result = op.mRun(src, size);
+				}
+				F64 ms = timer.getElapsedTimeF64() * 1000.0 / iterations;
+
+				if (reference.isNull())
+				{
+					reference = result;
+					reference_ms = ms;
+				}
+				printf("%-18s %6d %-8s %7u %10.3f %7.2fx %6d\n",
+					   op.mName, size, LLImageKernels::getPathName(config.mPath), config.mThreads,
+					   ms, reference_ms / ms, max_difference(reference, result));
+			}
+		}
+	}
+
+	LLJobPool::cleanupClass();
+	LLImage::cleanupClass();
+	LLCommon::cleanupClass();
+	return 0;
+}
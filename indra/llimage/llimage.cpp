@@ -40,6 +40,7 @@
 #include "llimagejpeg.h"
 #include "llimagepng.h"
 #include "llimagedxt.h"
+#include "llimagekernels.h"
 #include "llmemory.h"
 
 #include <boost/preprocessor.hpp>
@@ -221,16 +222,16 @@ private:
 };
 
 
+// Scales destination rows [y_begin, y_end), each row only depends on info and src
 template<U8 ch>
 inline void bilinear_scale(
-	const U8 *src, U32 srcW, U32 srcH, U32 srcStride
-	, U8 *dst, U32 dstW, U32 dstH, U32 dstStride
+	const scale_info<ch>& info, U32 srcStride
+	, U8 *dst, U32 dstW, U32 dstStride
+	, U32 y_begin, U32 y_end
 	)
 {
 	typedef scale_info<ch> scale_info_t;
 
-	scale_info_t info(src, srcW, srcH, dstW, dstH, srcStride);
-
 	const U8 *sptr;
 	U8 *dptr;
 	U32 x, y;
@@ -241,7 +242,7 @@ inline void bilinear_scale(
 
 	if(3 == info.xup_yup)
 	{ //scale x/y - up
-		for(y = 0; y < dstH; ++y)
+		for(y = y_begin; y < y_end; ++y)
 		{
 			dptr = dst + (y * dstStride);
 			sptr = info.ystrides[y];
@@ -330,7 +331,7 @@ inline void bilinear_scale(
 		S32 Cy, j;
 		S32 yap;
 
-		for(y = 0; y < dstH; y++)
+		for(y = y_begin; y < y_end; y++)
 		{
 			Cy = info.yapoints[y] >> 16;
 			yap = info.yapoints[y] & 0xffff;
@@ -397,7 +398,7 @@ inline void bilinear_scale(
 		S32 Cx, j;
 		S32 xap;
 
-		for(y = 0; y < dstH; y++)
+		for(y = y_begin; y < y_end; y++)
 		{
 			dptr = dst + (y * dstStride);
 
@@ -464,7 +465,7 @@ inline void bilinear_scale(
 		S32 Cx, Cy, i, j;
 		S32 xap, yap;
 
-		for(y = 0; y < dstH; y++)
+		for(y = y_begin; y < y_end; y++)
 		{
 			Cy = info.yapoints[y] >> 16;
 			yap = info.yapoints[y] & 0xffff;
@@ -558,6 +559,20 @@ inline void bilinear_scale(
 	} //else
 }
 
+template<U8 ch>
+inline void bilinear_scale(
+	const U8 *src, U32 srcW, U32 srcH, U32 srcStride
+	, U8 *dst, U32 dstW, U32 dstH, U32 dstStride
+	)
+{
+	const scale_info<ch> info(src, srcW, srcH, dstW, dstH, srcStride);
+
+	LLImageKernels::forEachBand(dstH, dstStride, [&](S32 first, S32 last)
+	{
+		bilinear_scale<ch>(info, srcStride, dst, dstW, dstStride, first, last);
+	});
+}
+
 //wrapper
 static void bilinear_scale(const U8 *src, U32 srcW, U32 srcH, U32 srcCh, U32 srcStride, U8 *dst, U32 dstW, U32 dstH, U32 dstCh, U32 dstStride)
 {
@@ -597,6 +612,7 @@ void LLImage::initClass(bool use_new_byte_range, S32 minimal_reverse_byte_range_
 	sUseNewByteRange = use_new_byte_range;
     sMinimalReverseByteRangePercent = minimal_reverse_byte_range_percent;
 	sMutex = new LLMutex();
+	LLImageKernels::initClass();
 }
 
 //static
@@ -1182,8 +1198,6 @@ void LLImageRaw::composite( LLImageRaw* src )
 // Src and dst can be any size.  Src has 4 components.  Dst has 3 components.
 void LLImageRaw::compositeScaled4onto3(LLImageRaw* src)
 {
-	LL_INFOS() << "compositeScaled4onto3" << LL_ENDL;
-
 	LLImageRaw* dst = this;  // Just for clarity.
 
 	llassert( (4 == src->getComponents()) && (3 == dst->getComponents()) );
@@ -1194,17 +1208,31 @@ void LLImageRaw::compositeScaled4onto3(LLImageRaw* src)
 	{
 	std::vector<U8> temp_buffer(temp_data_size);
 
+	U8* temp = &temp_buffer[0];
+	const U8* src_data = src->getData();
+	U8* dst_data = dst->getData();
+	const S32 src_width = src->getWidth();
+	const S32 src_height = src->getHeight();
+	const S32 dst_width = dst->getWidth();
+	const S32 dst_height = dst->getHeight();
+
 	// Vertical: scale but no composite
-	for( S32 col = 0; col < src->getWidth(); col++ )
+	LLImageKernels::forEachBand(src_width, dst_height * 4, [=](S32 first, S32 last)
 	{
-		copyLineScaled( src->getData() + (src->getComponents() * col), &temp_buffer[0] + (src->getComponents() * col), src->getHeight(), dst->getHeight(), src->getWidth(), src->getWidth() );
-	}
+		for( S32 col = first; col < last; col++ )
+		{
+			LLImageKernels::scaleLine( src_data + (4 * col), temp + (4 * col), src_height, dst_height, src_width, src_width, 4 );
+		}
+	});
 
 	// Horizontal: scale and composite
-	for( S32 row = 0; row < dst->getHeight(); row++ )
+	LLImageKernels::forEachBand(dst_height, dst_width * 3, [=](S32 first, S32 last)
 	{
-		compositeRowScaled4onto3( &temp_buffer[0] + (src->getComponents() * src->getWidth() * row), dst->getData() + (dst->getComponents() * dst->getWidth() * row), src->getWidth(), dst->getWidth() );
-	}
+		for( S32 row = first; row < last; row++ )
+		{
+			LLImageKernels::compositeLine4onto3( temp + (4 * src_width * row), dst_data + (3 * dst_width * row), src_width, dst_width );
+		}
+	});
 	}
 	catch(std::bad_alloc)
 	{
@@ -1634,214 +1662,6 @@ LLPointer<LLImageRaw> LLImageRaw::scaled(S32 new_width, S32 new_height)
     return result;
 }
 
-void LLImageRaw::copyLineScaled( U8* in, U8* out, S32 in_pixel_len, S32 out_pixel_len, S32 in_pixel_step, S32 out_pixel_step )
-{
-	const S32 components = getComponents();
-	llassert( components >= 1 && components <= 4 );
-
-	const F32 ratio = F32(in_pixel_len) / out_pixel_len; // ratio of old to new
-	const F32 norm_factor = 1.f / ratio;
-
-	S32 goff = components >= 2 ? 1 : 0;
-	S32 boff = components >= 3 ? 2 : 0;
-	// This loop is awful.
-	for( S32 x = 0; x < out_pixel_len; x++ )
-	{
-		// Sample input pixels in range from sample0 to sample1.
-		// Avoid floating point accumulation error... don't just add ratio each time.  JC
-		const F32 sample0 = x * ratio;
-		const F32 sample1 = (x+1) * ratio;
-		const S32 index0 = llfloor(sample0);			// left integer (floor)
-		const S32 index1 = llfloor(sample1);			// right integer (floor)
-		const F32 fract0 = 1.f - (sample0 - F32(index0));	// spill over on left
-		const F32 fract1 = sample1 - F32(index1);			// spill-over on right
-
-		if( index0 == index1 )
-		{
-			// Interval is embedded in one input pixel
-			S32 t0 = x * out_pixel_step * components;
-			S32 t1 = index0 * in_pixel_step * components;
-			U8* outp = out + t0;
-			U8* inp = in + t1;
-			for (S32 i = 0; i < components; ++i)
-			{
-				*outp = *inp;
-				++outp;
-				++inp;
-			}
-		}
-		else
-		{
-			// Left straddle
-			S32 t1 = index0 * in_pixel_step * components;
-			F32 r = in[t1 + 0] * fract0;
-			F32 g = in[t1 + goff] * fract0;
-			F32 b = in[t1 + boff] * fract0;
-			F32 a = 0;
-			if( components == 4)
-			{
-				a = in[t1 + 3] * fract0;
-			}
-		
-			// Central interval
-			if (components < 4)
-			{
-				for( S32 u = index0 + 1; u < index1; u++ )
-				{
-					S32 t2 = u * in_pixel_step * components;
-					r += in[t2 + 0];
-					g += in[t2 + goff];
-					b += in[t2 + boff];
-				}
-			}
-			else
-			{
-				for( S32 u = index0 + 1; u < index1; u++ )
-				{
-					S32 t2 = u * in_pixel_step * components;
-					r += in[t2 + 0];
-					g += in[t2 + 1];
-					b += in[t2 + 2];
-					a += in[t2 + 3];
-				}
-			}
-
-			// right straddle
-			// Watch out for reading off of end of input array.
-			if( fract1 && index1 < in_pixel_len )
-			{
-				S32 t3 = index1 * in_pixel_step * components;
-				if (components < 4)
-				{
-					U8 in0 = in[t3 + 0];
-					U8 in1 = in[t3 + goff];
-					U8 in2 = in[t3 + boff];
-					r += in0 * fract1;
-					g += in1 * fract1;
-					b += in2 * fract1;
-				}
-				else
-				{
-					U8 in0 = in[t3 + 0];
-					U8 in1 = in[t3 + 1];
-					U8 in2 = in[t3 + 2];
-					U8 in3 = in[t3 + 3];
-					r += in0 * fract1;
-					g += in1 * fract1;
-					b += in2 * fract1;
-					a += in3 * fract1;
-				}
-			}
-
-			U8 arr[] = {
-				U8(ll_pos_round(r * norm_factor)),
-				U8(ll_pos_round(g * norm_factor)),
-				U8(ll_pos_round(b * norm_factor)),
-				U8(ll_pos_round(a * norm_factor))
-			};  // skip conditional
-
-			S32 t4 = x * out_pixel_step * components;
-			memcpy(out + t4, arr, sizeof(U8) * components);
-		}
-	}
-}
-
-void LLImageRaw::compositeRowScaled4onto3( U8* in, U8* out, S32 in_pixel_len, S32 out_pixel_len )
-{
-	llassert( getComponents() == 3 );
-
-	const S32 IN_COMPONENTS = 4;
-	const S32 OUT_COMPONENTS = 3;
-
-	const F32 ratio = F32(in_pixel_len) / out_pixel_len; // ratio of old to new
-	const F32 norm_factor = 1.f / ratio;
-
-	for( S32 x = 0; x < out_pixel_len; x++ )
-	{
-		// Sample input pixels in range from sample0 to sample1.
-		// Avoid floating point accumulation error... don't just add ratio each time.  JC
-		const F32 sample0 = x * ratio;
-		const F32 sample1 = (x+1) * ratio;
-		const S32 index0 = S32(sample0);			// left integer (floor)
-		const S32 index1 = S32(sample1);			// right integer (floor)
-		const F32 fract0 = 1.f - (sample0 - F32(index0));	// spill over on left
-		const F32 fract1 = sample1 - F32(index1);			// spill-over on right
-
-		U8 in_scaled_r;
-		U8 in_scaled_g;
-		U8 in_scaled_b;
-		U8 in_scaled_a;
-
-		if( index0 == index1 )
-		{
-			// Interval is embedded in one input pixel
-			S32 t1 = index0 * IN_COMPONENTS;
-			in_scaled_r = in[t1 + 0];
-			in_scaled_g = in[t1 + 0];
-			in_scaled_b = in[t1 + 0];
-			in_scaled_a = in[t1 + 0];
-		}
-		else
-		{
-			// Left straddle
-			S32 t1 = index0 * IN_COMPONENTS;
-			F32 r = in[t1 + 0] * fract0;
-			F32 g = in[t1 + 1] * fract0;
-			F32 b = in[t1 + 2] * fract0;
-			F32 a = in[t1 + 3] * fract0;
-		
-			// Central interval
-			for( S32 u = index0 + 1; u < index1; u++ )
-			{
-				S32 t2 = u * IN_COMPONENTS;
-				r += in[t2 + 0];
-				g += in[t2 + 1];
-				b += in[t2 + 2];
-				a += in[t2 + 3];
-			}
-
-			// right straddle
-			// Watch out for reading off of end of input array.
-			if( fract1 && index1 < in_pixel_len )
-			{
-				S32 t3 = index1 * IN_COMPONENTS;
-				r += in[t3 + 0] * fract1;
-				g += in[t3 + 1] * fract1;
-				b += in[t3 + 2] * fract1;
-				a += in[t3 + 3] * fract1;
-			}
-
-			r *= norm_factor;
-			g *= norm_factor;
-			b *= norm_factor;
-			a *= norm_factor;
-
-			in_scaled_r = U8(ll_pos_round(r));
-			in_scaled_g = U8(ll_pos_round(g));
-			in_scaled_b = U8(ll_pos_round(b));
-			in_scaled_a = U8(ll_pos_round(a));
-		}
-
-		if( in_scaled_a )
-		{
-			if( 255 == in_scaled_a )
-			{
-				out[0] = in_scaled_r;
-				out[1] = in_scaled_g;
-				out[2] = in_scaled_b;
-			}
-			else
-			{
-				U8 transparency = 255 - in_scaled_a;
-				out[0] = fastFractionalMult( out[0], transparency ) + fastFractionalMult( in_scaled_r, in_scaled_a );
-				out[1] = fastFractionalMult( out[1], transparency ) + fastFractionalMult( in_scaled_g, in_scaled_a );
-				out[2] = fastFractionalMult( out[2], transparency ) + fastFractionalMult( in_scaled_b, in_scaled_a );
-			}
-		}
-		out += OUT_COMPONENTS;
-	}
-}
-
 bool LLImageRaw::validateSrcAndDst(const std::string& func, LLImageRaw* src, LLImageRaw* dst)
 {
 	if (!src || !dst || src->isBufferInvalid() || dst->isBufferInvalid())
@@ -2309,27 +2129,6 @@ S8 LLImageFormatted::getCodec() const
 
 //============================================================================
 
-static void avg4_colors4(const U8* a, const U8* b, const U8* c, const U8* d, U8* dst)
-{
-	dst[0] = (U8)(((U32)(a[0]) + b[0] + c[0] + d[0])>>2);
-	dst[1] = (U8)(((U32)(a[1]) + b[1] + c[1] + d[1])>>2);
-	dst[2] = (U8)(((U32)(a[2]) + b[2] + c[2] + d[2])>>2);
-	dst[3] = (U8)(((U32)(a[3]) + b[3] + c[3] + d[3])>>2);
-}
-
-static void avg4_colors3(const U8* a, const U8* b, const U8* c, const U8* d, U8* dst)
-{
-	dst[0] = (U8)(((U32)(a[0]) + b[0] + c[0] + d[0])>>2);
-	dst[1] = (U8)(((U32)(a[1]) + b[1] + c[1] + d[1])>>2);
-	dst[2] = (U8)(((U32)(a[2]) + b[2] + c[2] + d[2])>>2);
-}
-
-static void avg4_colors2(const U8* a, const U8* b, const U8* c, const U8* d, U8* dst)
-{
-	dst[0] = (U8)(((U32)(a[0]) + b[0] + c[0] + d[0])>>2);
-	dst[1] = (U8)(((U32)(a[1]) + b[1] + c[1] + d[1])>>2);
-}
-
 void LLImageBase::setDataAndSize(U8 *data, S32 size)
 { 
 	ll_assert_aligned(data, 16);
@@ -2342,35 +2141,7 @@ void LLImageBase::setDataAndSize(U8 *data, S32 size)
 //static
 void LLImageBase::generateMip(const U8* indata, U8* mipdata, S32 width, S32 height, S32 nchannels)
 {
-	llassert(width > 0 && height > 0);
-	U8* data = mipdata;
-	S32 in_width = width*2;
-	for (S32 h=0; h<height; h++)
-	{
-		for (S32 w=0; w<width; w++)
-		{
-			switch(nchannels)
-			{
-			  case 4:
-				avg4_colors4(indata, indata+4, indata+4*in_width, indata+4*in_width+4, data);
-				break;
-			  case 3:
-				avg4_colors3(indata, indata+3, indata+3*in_width, indata+3*in_width+3, data);
-				break;
-			  case 2:
-				avg4_colors2(indata, indata+2, indata+2*in_width, indata+2*in_width+2, data);
-				break;
-			  case 1:
-				*(U8*)data = (U8)(((U32)(indata[0]) + indata[1] + indata[in_width] + indata[in_width+1])>>2);
-				break;
-			  default:
-				LL_ERRS() << "generateMmip called with bad num channels" << LL_ENDL;
-			}
-			indata += nchannels*2;
-			data += nchannels;
-		}
-		indata += nchannels*in_width; // skip odd lines
-	}
+	LLImageKernels::generateMip(indata, mipdata, width, height, nchannels);
 }
 
 
@@ -0,0 +1,680 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/**
+ * @file llimagekernels.cpp
+ * @brief Pixel loops behind image scaling, compositing and mip generation
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llimagekernels.h"
+
+#include "lljobpool.h"
+#include "llmath.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LL_IMAGE_SIMD 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#if LL_WINDOWS
+#include <intrin.h>
+#endif
+#else
+#define LL_IMAGE_SIMD 0
+#endif
+
+// AVX2 kernels are built into every binary and only called when the CPU has it
+#if LL_IMAGE_SIMD && (defined(__GNUC__) || defined(__clang__))
+#define LL_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define LL_TARGET_AVX2
+#endif
+
+// Below this many output bytes a band split costs more than it saves
+const S32 MIN_PARALLEL_BYTES = 256 * 1024;
+// Bands per thread, so a slow thread doesn't hold everybody up
+const S32 BANDS_PER_THREAD = 4;
+
+LLImageKernels::EPath LLImageKernels::sPath = LLImageKernels::PATH_SCALAR;
+
+//----------------------------------------------------------------------------
+// CPU features
+//----------------------------------------------------------------------------
+
+namespace
+{
+	bool cpu_has_avx2()
+	{
+#if !LL_IMAGE_SIMD
+		return false;
+#elif LL_WINDOWS
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+		{
+			return false;
+		}
+		__cpuid(info, 1);
+		const int OSXSAVE = 1 << 27;
+		const int AVX = 1 << 28;
+		if ((info[2] & (OSXSAVE | AVX)) != (OSXSAVE | AVX))
+		{
+			return false;
+		}
+		// the OS has to save the YMM registers too
+		if ((_xgetbv(0) & 6) != 6)
+		{
+			return false;
+		}
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+}
+
+//----------------------------------------------------------------------------
+// Scalar kernels
+//----------------------------------------------------------------------------
+
+// Calculates (U8)(255*(a/255.f)*(b/255.f) + 0.5f).  Thanks, Jim Blinn!
+inline U8 fast_fractional_mult(U8 a, U8 b)
+{
+	U32 i = a * b + 128;
+	return U8((i + (i>>8)) >> 8);
+}
+
+inline void blend_pixel_4onto3(U8* out, U8 r, U8 g, U8 b, U8 a)
+{
+	if (a)
+	{
+		if (255 == a)
+		{
+			out[0] = r;
+			out[1] = g;
+			out[2] = b;
+		}
+		else
+		{
+			U8 transparency = 255 - a;
+			out[0] = fast_fractional_mult(out[0], transparency) + fast_fractional_mult(r, a);
+			out[1] = fast_fractional_mult(out[1], transparency) + fast_fractional_mult(g, a);
+			out[2] = fast_fractional_mult(out[2], transparency) + fast_fractional_mult(b, a);
+		}
+	}
+}
+
+static void mip_row_scalar(const U8* row0, const U8* row1, U8* out, S32 first, S32 width, S32 nchannels)
+{
+	for (S32 w = first; w < width; ++w)
+	{
+		const U8* a = row0 + w * 2 * nchannels;
+		const U8* b = row1 + w * 2 * nchannels;
+		U8* dst = out + w * nchannels;
+		for (S32 c = 0; c < nchannels; ++c)
+		{
+			dst[c] = (U8)(((U32)(a[c]) + a[c + nchannels] + b[c] + b[c + nchannels]) >> 2);
+		}
+	}
+}
+
+static void scale_line_scalar(const U8* in, U8* out, S32 in_pixel_len, S32 out_pixel_len, S32 in_pixel_step, S32 out_pixel_step, S32 components)
+{
+	const F32 ratio = F32(in_pixel_len) / out_pixel_len; // ratio of old to new
+	const F32 norm_factor = 1.f / ratio;
+
+	S32 goff = components >= 2 ? 1 : 0;
+	S32 boff = components >= 3 ? 2 : 0;
+	// This loop is awful.
+	for( S32 x = 0; x < out_pixel_len; x++ )
+	{
+		// Sample input pixels in range from sample0 to sample1.
+		// Avoid floating point accumulation error... don't just add ratio each time.  JC
+		const F32 sample0 = x * ratio;
+		const F32 sample1 = (x+1) * ratio;
+		const S32 index0 = llfloor(sample0);			// left integer (floor)
+		const S32 index1 = llfloor(sample1);			// right integer (floor)
+		const F32 fract0 = 1.f - (sample0 - F32(index0));	// spill over on left
+		const F32 fract1 = sample1 - F32(index1);			// spill-over on right
+
+		if( index0 == index1 )
+		{
+			// Interval is embedded in one input pixel
+			memcpy(out + x * out_pixel_step * components, in + index0 * in_pixel_step * components, components);
+		}
+		else
+		{
+			// Left straddle
+			S32 t1 = index0 * in_pixel_step * components;
+			F32 r = in[t1 + 0] * fract0;
+			F32 g = in[t1 + goff] * fract0;
+			F32 b = in[t1 + boff] * fract0;
+			F32 a = 0;
+			if( components == 4)
+			{
+				a = in[t1 + 3] * fract0;
+			}
+
+			// Central interval
+			if (components < 4)
+			{
+				for( S32 u = index0 + 1; u < index1; u++ )
+				{
+					S32 t2 = u * in_pixel_step * components;
+					r += in[t2 + 0];
+					g += in[t2 + goff];
+					b += in[t2 + boff];
+				}
+			}
+			else
+			{
+				for( S32 u = index0 + 1; u < index1; u++ )
+				{
+					S32 t2 = u * in_pixel_step * components;
+					r += in[t2 + 0];
+					g += in[t2 + 1];
+					b += in[t2 + 2];
+					a += in[t2 + 3];
+				}
+			}
+
+			// right straddle
+			// Watch out for reading off of end of input array.
+			if( fract1 && index1 < in_pixel_len )
+			{
+				S32 t3 = index1 * in_pixel_step * components;
+				r += in[t3 + 0] * fract1;
+				g += in[t3 + goff] * fract1;
+				b += in[t3 + boff] * fract1;
+				if (components == 4)
+				{
+					a += in[t3 + 3] * fract1;
+				}
+			}
+
+			U8 arr[] = {
+				U8(ll_pos_round(r * norm_factor)),
+				U8(ll_pos_round(g * norm_factor)),
+				U8(ll_pos_round(b * norm_factor)),
+				U8(ll_pos_round(a * norm_factor))
+			};  // skip conditional
+
+			memcpy(out + x * out_pixel_step * components, arr, components);
+		}
+	}
+}
+
+static void composite_line_scalar(const U8* in, U8* out, S32 in_pixel_len, S32 out_pixel_len)
+{
+	const S32 IN_COMPONENTS = 4;
+	const S32 OUT_COMPONENTS = 3;
+
+	const F32 ratio = F32(in_pixel_len) / out_pixel_len; // ratio of old to new
+	const F32 norm_factor = 1.f / ratio;
+
+	for( S32 x = 0; x < out_pixel_len; x++ )
+	{
+		// Sample input pixels in range from sample0 to sample1.
+		// Avoid floating point accumulation error... don't just add ratio each time.  JC
+		const F32 sample0 = x * ratio;
+		const F32 sample1 = (x+1) * ratio;
+		const S32 index0 = S32(sample0);			// left integer (floor)
+		const S32 index1 = S32(sample1);			// right integer (floor)
+		const F32 fract0 = 1.f - (sample0 - F32(index0));	// spill over on left
+		const F32 fract1 = sample1 - F32(index1);			// spill-over on right
+
+		if( index0 == index1 )
+		{
+			// Interval is embedded in one input pixel
+			const U8* pix = in + index0 * IN_COMPONENTS;
+			blend_pixel_4onto3(out, pix[0], pix[1], pix[2], pix[3]);
+		}
+		else
+		{
+			// Left straddle
+			S32 t1 = index0 * IN_COMPONENTS;
+			F32 r = in[t1 + 0] * fract0;
+			F32 g = in[t1 + 1] * fract0;
+			F32 b = in[t1 + 2] * fract0;
+			F32 a = in[t1 + 3] * fract0;
+
+			// Central interval
+			for( S32 u = index0 + 1; u < index1; u++ )
+			{
+				S32 t2 = u * IN_COMPONENTS;
+				r += in[t2 + 0];
+				g += in[t2 + 1];
+				b += in[t2 + 2];
+				a += in[t2 + 3];
+			}
+
+			// right straddle
+			// Watch out for reading off of end of input array.
+			if( fract1 && index1 < in_pixel_len )
+			{
+				S32 t3 = index1 * IN_COMPONENTS;
+				r += in[t3 + 0] * fract1;
+				g += in[t3 + 1] * fract1;
+				b += in[t3 + 2] * fract1;
+				a += in[t3 + 3] * fract1;
+			}
+
+			blend_pixel_4onto3(out,
+							   U8(ll_pos_round(r * norm_factor)),
+							   U8(ll_pos_round(g * norm_factor)),
+							   U8(ll_pos_round(b * norm_factor)),
+							   U8(ll_pos_round(a * norm_factor)));
+		}
+		out += OUT_COMPONENTS;
+	}
+}
+
+//----------------------------------------------------------------------------
+// SSE2 kernels
+//----------------------------------------------------------------------------
+
+#if LL_IMAGE_SIMD
+
+// Returns the first pixel left for the scalar loop
+static S32 mip_row_sse2(const U8* row0, const U8* row1, U8* out, S32 first, S32 width, S32 nchannels)
+{
+	const __m128i zero = _mm_setzero_si128();
+	S32 w = first;
+	switch (nchannels)
+	{
+	case 1:
+		{
+			const __m128i low_bytes = _mm_set1_epi16(0x00ff);
+			for (; w + 8 <= width; w += 8)
+			{
+				__m128i a = _mm_loadu_si128((const __m128i*)(row0 + w * 2));
+				__m128i b = _mm_loadu_si128((const __m128i*)(row1 + w * 2));
+				__m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a, low_bytes), _mm_srli_epi16(a, 8)),
+											_mm_add_epi16(_mm_and_si128(b, low_bytes), _mm_srli_epi16(b, 8)));
+				sum = _mm_srli_epi16(sum, 2);
+				_mm_storel_epi64((__m128i*)(out + w), _mm_packus_epi16(sum, sum));
+			}
+		}
+		break;
+	case 2:
+		for (; w + 4 <= width; w += 4)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i*)(row0 + w * 4));
+			__m128i b = _mm_loadu_si128((const __m128i*)(row1 + w * 4));
+			__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+			__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+			// add each even pixel to its neighbour, the sums land in dwords 0 and 2
+			lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 4));
+			hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 4));
+			lo = _mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 3, 2, 0));
+			hi = _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 3, 2, 0));
+			__m128i sum = _mm_srli_epi16(_mm_unpacklo_epi64(lo, hi), 2);
+			_mm_storel_epi64((__m128i*)(out + w * 2), _mm_packus_epi16(sum, sum));
+		}
+		break;
+	case 3:
+		{
+			const __m128i low_pixel = _mm_setr_epi16(-1, -1, -1, 0, 0, 0, 0, 0);
+			// Two pixels out of 12 bytes per row, loaded as two 8 byte halves.
+			// The loads and the store each run 2 bytes past the pair, so
+			// stop one pixel short of the end.
+			for (; w + 3 <= width; w += 2)
+			{
+				const U8* p0 = row0 + w * 6;
+				const U8* p1 = row1 + w * 6;
+				__m128i a = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)p0), _mm_loadl_epi64((const __m128i*)(p0 + 6)));
+				__m128i b = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)p1), _mm_loadl_epi64((const __m128i*)(p1 + 6)));
+				__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+				__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+				lo = _mm_and_si128(_mm_add_epi16(lo, _mm_srli_si128(lo, 6)), low_pixel);
+				hi = _mm_and_si128(_mm_add_epi16(hi, _mm_srli_si128(hi, 6)), low_pixel);
+				__m128i sum = _mm_srli_epi16(_mm_or_si128(lo, _mm_slli_si128(hi, 6)), 2);
+				_mm_storel_epi64((__m128i*)(out + w * 3), _mm_packus_epi16(sum, sum));
+			}
+		}
+		break;
+	case 4:
+		for (; w + 4 <= width; w += 4)
+		{
+			__m128i sums[2];
+			for (S32 half = 0; half < 2; ++half)
+			{
+				__m128i a = _mm_loadu_si128((const __m128i*)(row0 + w * 8 + half * 16));
+				__m128i b = _mm_loadu_si128((const __m128i*)(row1 + w * 8 + half * 16));
+				__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+				__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+				lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+				hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+				sums[half] = _mm_srli_epi16(_mm_unpacklo_epi64(lo, hi), 2);
+			}
+			_mm_storeu_si128((__m128i*)(out + w * 4), _mm_packus_epi16(sums[0], sums[1]));
+		}
+		break;
+	default:
+		break;
+	}
+	return w;
+}
+
+// Loads the first components bytes of a pixel as floats
+inline __m128 load_pixel_ps(const U8* pix, S32 components)
+{
+	S32 bits;
+	if (components == 4)
+	{
+		memcpy(&bits, pix, sizeof(bits));
+	}
+	else
+	{
+		bits = pix[0];
+		if (components > 1) bits |= pix[1] << 8;
+		if (components > 2) bits |= pix[2] << 16;
+	}
+	const __m128i zero = _mm_setzero_si128();
+	__m128i v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bits), zero), zero);
+	return _mm_cvtepi32_ps(v);
+}
+
+// Same rounding as ll_pos_round(), packed back into 4 bytes
+inline S32 round_pixel_ps(__m128 v)
+{
+	__m128i i = _mm_cvttps_epi32(_mm_add_ps(v, _mm_set1_ps(.5f)));
+	i = _mm_packs_epi32(i, i);
+	return _mm_cvtsi128_si32(_mm_packus_epi16(i, i));
+}
+
+// Sums the input pixels under output pixel x, weighted by coverage and normalized
+inline __m128 sample_span_ps(const U8* in, S32 x, F32 ratio, __m128 norm, S32 in_pixel_len, S32 in_stride, S32 components, S32& index0, S32& index1)
+{
+	const F32 sample0 = x * ratio;
+	const F32 sample1 = (x+1) * ratio;
+	index0 = llfloor(sample0);
+	index1 = llfloor(sample1);
+	if (index0 == index1)
+	{
+		return _mm_setzero_ps();
+	}
+	const F32 fract0 = 1.f - (sample0 - F32(index0));
+	const F32 fract1 = sample1 - F32(index1);
+
+	__m128 sum = _mm_mul_ps(load_pixel_ps(in + index0 * in_stride, components), _mm_set1_ps(fract0));
+	for (S32 u = index0 + 1; u < index1; ++u)
+	{
+		sum = _mm_add_ps(sum, load_pixel_ps(in + u * in_stride, components));
+	}
+	if (fract1 && index1 < in_pixel_len)
+	{
+		sum = _mm_add_ps(sum, _mm_mul_ps(load_pixel_ps(in + index1 * in_stride, components), _mm_set1_ps(fract1)));
+	}
+	return _mm_mul_ps(sum, norm);
+}
+
+static void scale_line_sse2(const U8* in, U8* out, S32 in_pixel_len, S32 out_pixel_len, S32 in_pixel_step, S32 out_pixel_step, S32 components)
+{
+	const F32 ratio = F32(in_pixel_len) / out_pixel_len;
+	const __m128 norm = _mm_set1_ps(1.f / ratio);
+	const S32 in_stride = in_pixel_step * components;
+	const S32 out_stride = out_pixel_step * components;
+
+	for (S32 x = 0; x < out_pixel_len; ++x)
+	{
+		S32 index0, index1;
+		__m128 sum = sample_span_ps(in, x, ratio, norm, in_pixel_len, in_stride, components, index0, index1);
+		if (index0 == index1)
+		{
+			memcpy(out + x * out_stride, in + index0 * in_stride, components);
+		}
+		else
+		{
+			S32 bits = round_pixel_ps(sum);
+			memcpy(out + x * out_stride, &bits, components);
+		}
+	}
+}
+
+static void composite_line_sse2(const U8* in, U8* out, S32 in_pixel_len, S32 out_pixel_len)
+{
+	const F32 ratio = F32(in_pixel_len) / out_pixel_len;
+	const __m128 norm = _mm_set1_ps(1.f / ratio);
+
+	for (S32 x = 0; x < out_pixel_len; ++x, out += 3)
+	{
+		S32 index0, index1;
+		__m128 sum = sample_span_ps(in, x, ratio, norm, in_pixel_len, 4, 4, index0, index1);
+		U8 pix[4];
+		if (index0 == index1)
+		{
+			memcpy(pix, in + index0 * 4, 4);
+		}
+		else
+		{
+			S32 bits = round_pixel_ps(sum);
+			memcpy(pix, &bits, 4);
+		}
+		blend_pixel_4onto3(out, pix[0], pix[1], pix[2], pix[3]);
+	}
+}
+
+//----------------------------------------------------------------------------
+// AVX2 kernels
+//----------------------------------------------------------------------------
+
+// Only the 1 and 4 channel mips, the others go on to the SSE2 loop
+LL_TARGET_AVX2 static S32 mip_row_avx2(const U8* row0, const U8* row1, U8* out, S32 first, S32 width, S32 nchannels)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	S32 w = first;
+	if (nchannels == 1)
+	{
+		const __m256i low_bytes = _mm256_set1_epi16(0x00ff);
+		for (; w + 16 <= width; w += 16)
+		{
+			__m256i a = _mm256_loadu_si256((const __m256i*)(row0 + w * 2));
+			__m256i b = _mm256_loadu_si256((const __m256i*)(row1 + w * 2));
+			__m256i sum = _mm256_add_epi16(_mm256_add_epi16(_mm256_and_si256(a, low_bytes), _mm256_srli_epi16(a, 8)),
+										   _mm256_add_epi16(_mm256_and_si256(b, low_bytes), _mm256_srli_epi16(b, 8)));
+			sum = _mm256_srli_epi16(sum, 2);
+			// packing works per 128 bit lane, pull the two low quadwords together
+			__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(sum, sum), _MM_SHUFFLE(3, 1, 2, 0));
+			_mm_storeu_si128((__m128i*)(out + w), _mm256_castsi256_si128(packed));
+		}
+	}
+	else if (nchannels == 4)
+	{
+		for (; w + 8 <= width; w += 8)
+		{
+			__m256i sums[2];
+			for (S32 half = 0; half < 2; ++half)
+			{
+				__m256i a = _mm256_loadu_si256((const __m256i*)(row0 + w * 8 + half * 32));
+				__m256i b = _mm256_loadu_si256((const __m256i*)(row1 + w * 8 + half * 32));
+				__m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero));
+				__m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero));
+				lo = _mm256_add_epi16(lo, _mm256_srli_si256(lo, 8));
+				hi = _mm256_add_epi16(hi, _mm256_srli_si256(hi, 8));
+				sums[half] = _mm256_srli_epi16(_mm256_unpacklo_epi64(lo, hi), 2);
+			}
+			__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(sums[0], sums[1]), _MM_SHUFFLE(3, 1, 2, 0));
+			_mm256_storeu_si256((__m256i*)(out + w * 4), packed);
+		}
+	}
+	return w;
+}
+
+#endif // LL_IMAGE_SIMD
+
+//----------------------------------------------------------------------------
+// LLImageKernels
+//----------------------------------------------------------------------------
+
+//static
+void LLImageKernels::initClass()
+{
+	sPath = PATH_SCALAR;
+	for (S32 path = PATH_COUNT - 1; path > PATH_SCALAR; --path)
+	{
+		if (isSupported((EPath)path))
+		{
+			sPath = (EPath)path;
+			break;
+		}
+	}
+
+	LL_INFOS() << "Image kernels: " << getPathName(sPath) << LL_ENDL;
+}
+
+//static
+bool LLImageKernels::isSupported(EPath path)
+{
+	switch (path)
+	{
+	case PATH_SCALAR:
+		return true;
+#if LL_IMAGE_SIMD
+	case PATH_SSE2:
+		return true;
+	case PATH_AVX2:
+		{
+			static const bool has_avx2 = cpu_has_avx2();
+			return has_avx2;
+		}
+#endif
+	default:
+		return false;
+	}
+}
+
+//static
+bool LLImageKernels::setPath(EPath path)
+{
+	if (!isSupported(path))
+	{
+		return false;
+	}
+	sPath = path;
+	return true;
+}
+
+//static
+const char* LLImageKernels::getPathName(EPath path)
+{
+	static const char* names[PATH_COUNT] = { "scalar", "SSE2", "AVX2" };
+	return path < PATH_COUNT ? names[path] : "unknown";
+}
+
+//static
+U32 LLImageKernels::getThreadCount()
+{
+	LLJobPool* pool = LLJobPool::getInstance();
+	return pool ? pool->getThreadCount() : 1;
+}
+
+//static
+void LLImageKernels::forEachBand(S32 rows, S32 row_bytes, const band_func_t& func)
+{
+	if (rows <= 0)
+	{
+		return;
+	}
+	U32 threads = getThreadCount();
+	if (threads < 2 || rows < 2 || (S64)rows * row_bytes < MIN_PARALLEL_BYTES)
+	{
+		func(0, rows);
+		return;
+	}
+
+	S32 bands = (S32)threads * BANDS_PER_THREAD;
+	S32 band_rows = llmax((rows + bands - 1) / bands, 1);
+	LLJobPool::parallelFor(rows, band_rows, func);
+}
+
+//static
+void LLImageKernels::generateMip(const U8* indata, U8* mipdata, S32 width, S32 height, S32 nchannels)
+{
+	llassert(width > 0 && height > 0);
+	if (nchannels < 1 || nchannels > 4)
+	{
+		LL_ERRS() << "generateMmip called with bad num channels" << LL_ENDL;
+	}
+
+	forEachBand(height, width * nchannels, [=](S32 first, S32 last)
+	{
+		generateMipRows(indata, mipdata, width, first, last, nchannels);
+	});
+}
+
+//static
+void LLImageKernels::generateMipRows(const U8* indata, U8* mipdata, S32 width, S32 first_row, S32 last_row, S32 nchannels)
+{
+	const S32 in_row_bytes = width * 2 * nchannels;
+	const EPath path = sPath;
+	for (S32 h = first_row; h < last_row; ++h)
+	{
+		const U8* row0 = indata + h * 2 * in_row_bytes;
+		const U8* row1 = row0 + in_row_bytes;	// odd input lines are folded into even ones
+		U8* out = mipdata + h * width * nchannels;
+
+		S32 w = 0;
+#if LL_IMAGE_SIMD
+		if (path >= PATH_AVX2)
+		{
+			w = mip_row_avx2(row0, row1, out, w, width, nchannels);
+		}
+		if (path >= PATH_SSE2)
+		{
+			w = mip_row_sse2(row0, row1, out, w, width, nchannels);
+		}
+#endif
+		mip_row_scalar(row0, row1, out, w, width, nchannels);
+	}
+}
+
+//static
+void LLImageKernels::scaleLine(const U8* in, U8* out, S32 in_pixel_len, S32 out_pixel_len,
+							   S32 in_pixel_step, S32 out_pixel_step, S32 components)
+{
+	llassert(components >= 1 && components <= 4);
+#if LL_IMAGE_SIMD
+	if (sPath >= PATH_SSE2)
+	{
+		scale_line_sse2(in, out, in_pixel_len, out_pixel_len, in_pixel_step, out_pixel_step, components);
+		return;
+	}
+#endif
+	scale_line_scalar(in, out, in_pixel_len, out_pixel_len, in_pixel_step, out_pixel_step, components);
+}
+
+//static
+void LLImageKernels::compositeLine4onto3(const U8* in, U8* out, S32 in_pixel_len, S32 out_pixel_len)
+{
+#if LL_IMAGE_SIMD
+	if (sPath >= PATH_SSE2)
+	{
+		composite_line_sse2(in, out, in_pixel_len, out_pixel_len);
+		return;
+	}
+#endif
+	composite_line_scalar(in, out, in_pixel_len, out_pixel_len);
+}
@@ -0,0 +1,84 @@
+/**
+ * @file llimagekernels.h
+ * @brief Pixel loops behind image scaling, compositing and mip generation
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLIMAGEKERNELS_H
+#define LL_LLIMAGEKERNELS_H
+
+#include <functional>
+
+// Every kernel has a scalar version and, on x86, SSE2 (and for mips AVX2)
+// versions picked at startup from what the CPU supports.  The vector
+// versions write the same bytes as the scalar ones, except for the float
+// resampling kernels where rounding may differ by one.
+//
+// Large images are cut into bands of rows that are run on the process wide
+// LLJobPool, with the calling thread taking bands too.  When the pool is
+// busy or there is none the bands run inline.
+class LLImageKernels
+{
+public:
+	enum EPath
+	{
+		PATH_SCALAR = 0,
+		PATH_SSE2,
+		PATH_AVX2,
+		PATH_COUNT
+	};
+
+	// Picks the fastest path the CPU supports
+	static void initClass();
+
+	static bool isSupported(EPath path);
+	static EPath getPath()							{ return sPath; }
+	// Forces a path for tests and benchmarks, false if the CPU can't run it
+	static bool setPath(EPath path);
+	static const char* getPathName(EPath path);
+	// Threads working on a large image, including the caller
+	static U32 getThreadCount();
+
+	// Runs func(first, last) over [0, rows) in bands, in parallel when
+	// rows * row_bytes is worth spreading over the job pool
+	typedef std::function<void(S32, S32)> band_func_t;
+	static void forEachBand(S32 rows, S32 row_bytes, const band_func_t& func);
+
+	// 2x2 box filter, indata is (2 * width) x (2 * height)
+	static void generateMip(const U8* indata, U8* mipdata, S32 width, S32 height, S32 nchannels);
+
+	// Area-weighted resampling of one line of pixels, the steps are in pixels
+	static void scaleLine(const U8* in, U8* out, S32 in_pixel_len, S32 out_pixel_len,
+						  S32 in_pixel_step, S32 out_pixel_step, S32 components);
+
+	// Resamples a line of 4 component pixels and blends it over a line of
+	// 3 component pixels
+	static void compositeLine4onto3(const U8* in, U8* out, S32 in_pixel_len, S32 out_pixel_len);
+
+private:
+	static void generateMipRows(const U8* indata, U8* mipdata, S32 width, S32 first_row, S32 last_row, S32 nchannels);
+
+	static EPath sPath;
+};
+
+#endif // LL_LLIMAGEKERNELS_H
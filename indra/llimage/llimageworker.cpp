@@ -30,22 +30,123 @@
 
 #include "llimageworker.h"
 #include "llimagedxt.h"
+#include "lltimer.h"
+
+// Stats slot of the decode thread running on this OS thread, if any
+static thread_local LLImageDecodeThread::WorkerStats* sCurrentWorkerStats = nullptr;
+
+//----------------------------------------------------------------------------
+
+LLImageDecodeThread::WorkerStats::WorkerStats()
+	: mRequests(0),
+	  mSlices(0),
+	  mDecodeTime(0),
+	  mQueueDepth(0),
+	  mMaxQueueDepth(0)
+{
+}
 
 //----------------------------------------------------------------------------
 
 // MAIN THREAD
-LLImageDecodeThread::LLImageDecodeThread(bool threaded)
+LLImageDecodeThread::LLImageDecodeThread(bool threaded, U32 pool_size)
 	: LLQueuedThread("imagedecode", threaded)
 {
 	mCreationMutex = new LLMutex();
+
+	// Everything below the pool is only ever touched by this thread when not threaded
+	if (!threaded || pool_size < 1)
+	{
+		pool_size = 1;
+	}
+	for (U32 i = 0; i < pool_size; ++i)
+	{
+		mWorkerStats.push_back(std::unique_ptr<WorkerStats>(new WorkerStats));
+	}
+	for (U32 i = 1; i < pool_size; ++i)
+	{
+		mPool.push_back(std::unique_ptr<PoolWorker>(new PoolWorker(this, i)));
+		mPool.back()->start();
+	}
+	if (pool_size > 1)
+	{
+		LL_INFOS() << "Image decode pool started with " << pool_size << " threads" << LL_ENDL;
+	}
 }
 
 //virtual 
 LLImageDecodeThread::~LLImageDecodeThread()
 {
+	// ~LLQueuedThread() only runs the base shutdown(), stop the helpers first
+	shutdownPool();
 	delete mCreationMutex ;
 }
 
+// MAIN THREAD
+// virtual
+void LLImageDecodeThread::shutdown()
+{
+	shutdownPool();
+	LLQueuedThread::shutdown();
+}
+
+// MAIN THREAD
+void LLImageDecodeThread::shutdownPool()
+{
+	for (auto& worker : mPool)
+	{
+		worker->shutdown();
+	}
+	mPool.clear();
+}
+
+// MAIN THREAD
+void LLImageDecodeThread::wakePool()
+{
+	for (auto& worker : mPool)
+	{
+		worker->wake();
+	}
+}
+
+// Called on the decode thread owning the slot, right before it dequeues a request
+void LLImageDecodeThread::noteDequeue(U32 worker)
+{
+	WorkerStats& stats = *mWorkerStats[worker];
+	U32 depth = (U32)getPending();
+	stats.mQueueDepth = depth;
+	if (depth > stats.mMaxQueueDepth)
+	{
+		stats.mMaxQueueDepth = depth;
+	}
+}
+
+// virtual
+void LLImageDecodeThread::startThread()
+{
+	sCurrentWorkerStats = mWorkerStats[0].get();
+}
+
+// virtual
+void LLImageDecodeThread::threadedUpdate()
+{
+	noteDequeue(0);
+}
+
+void LLImageDecodeThread::logStats() const
+{
+	for (U32 i = 0; i < getPoolSize(); ++i)
+	{
+		const WorkerStats& stats = *mWorkerStats[i];
+		U32 requests = stats.mRequests;
+		F64 decode_ms = (F64)stats.mDecodeTime / 1000.0;
+		LL_INFOS() << llformat("Image decode worker %u: %u requests, %u slices, %.1f ms decoding (%.2f ms/request), queue depth %u (max %u)",
+							   i, requests, (U32)stats.mSlices, decode_ms,
+							   requests ? decode_ms / requests : 0.0,
+							   (U32)stats.mQueueDepth, (U32)stats.mMaxQueueDepth) << LL_ENDL;
+	}
+}
+
 // MAIN THREAD
 // virtual
 S32 LLImageDecodeThread::update(F32 max_time_ms)
@@ -66,7 +167,15 @@ S32 LLImageDecodeThread::update(F32 max_time_ms)
 		}
 	}
 	mCreationList.clear();
+	if (!mThreaded)
+	{
+		noteDequeue(0);
+	}
 	S32 res = LLQueuedThread::update(max_time_ms);
+	if (res > 0 && !isPaused())
+	{
+		wakePool();
+	}
 	return res;
 }
 
@@ -94,6 +203,45 @@ LLImageDecodeThread::Responder::~Responder()
 
 //----------------------------------------------------------------------------
 
+LLImageDecodeThread::PoolWorker::PoolWorker(LLImageDecodeThread* parent, U32 index)
+	: LLThread(llformat("imagedecode %u", index)),
+	  mParent(parent),
+	  mIndex(index)
+{
+}
+
+// virtual
+bool LLImageDecodeThread::PoolWorker::runCondition()
+{
+	// mDataLock must be locked here
+	return !mParent->isPaused() && mParent->getPending() > 0;
+}
+
+// virtual
+void LLImageDecodeThread::PoolWorker::run()
+{
+	sCurrentWorkerStats = mParent->mWorkerStats[mIndex].get();
+	while (true)
+	{
+		// blocks until there is work in the shared queue and the decoder is not paused
+		checkPause();
+
+		if (isQuitting())
+		{
+			break;
+		}
+
+		mParent->noteDequeue(mIndex);
+		if (mParent->processNextRequest() == 0)
+		{
+			ms_sleep(1);
+		}
+	}
+	LL_INFOS() << "Image decode worker " << mIndex << " EXITING." << LL_ENDL;
+}
+
+//----------------------------------------------------------------------------
+
 LLImageDecodeThread::ImageRequest::ImageRequest(handle_t handle, LLImageFormatted* image, 
 												U32 priority, S32 discard, BOOL needs_aux,
 												LLImageDecodeThread::Responder* responder)
@@ -119,6 +267,28 @@ LLImageDecodeThread::ImageRequest::~ImageRequest()
 
 // Returns true when done, whether or not decode was successful.
 bool LLImageDecodeThread::ImageRequest::processRequest()
+{
+	WorkerStats* stats = sCurrentWorkerStats;
+	U64 start_time = 0;
+	if (stats)
+	{
+		start_time = LLTimer::getTotalTime();
+	}
+	bool done = decode();
+	if (stats)
+	{
+		U64 end_time = LLTimer::getTotalTime();
+		stats->mDecodeTime += end_time - start_time;
+		++stats->mSlices;
+		if (done)
+		{
+			++stats->mRequests;
+		}
+	}
+	return done;
+}
+
+bool LLImageDecodeThread::ImageRequest::decode()
 {
 	const F32 decode_time_slice = .1f;
 	bool done = true;
@@ -30,7 +30,16 @@
 #include "llimage.h"
 #include "llpointer.h"
 #include "llworkerthread.h"
+#include "llatomic.h"
 
+#include <memory>
+#include <vector>
+
+// Decodes formatted images into LLImageRaw.
+// Requests share a single priority queue; besides the LLQueuedThread itself,
+// (pool_size - 1) helper threads pull from that queue so that several images
+// can be decoded at once. Responders are still called exactly once per request,
+// from whichever decode thread finished it.
 class LLImageDecodeThread : public LLQueuedThread
 {
 public:
@@ -59,6 +68,9 @@ public:
 		bool tut_isOK();
 		
 	private:
+		bool decode();
+
+
 		// input
 		LLPointer<LLImageFormatted> mFormattedImage;
 		S32 mDiscardLevel;
@@ -71,19 +83,65 @@ public:
 		LLPointer<LLImageDecodeThread::Responder> mResponder;
 	};
 	
+	// Per worker counters. Only the owning worker writes them.
+	struct WorkerStats
+	{
+		WorkerStats();
+
+		LLAtomicU32 mRequests;			// requests completed
+		LLAtomicU32 mSlices;			// calls to processRequest()
+		LLAtomic32<U64> mDecodeTime;	// microseconds spent in processRequest()
+		LLAtomicU32 mQueueDepth;		// pending requests when this worker last dequeued
+		LLAtomicU32 mMaxQueueDepth;
+	};
+
 public:
-	LLImageDecodeThread(bool threaded = true);
+	LLImageDecodeThread(bool threaded = true, U32 pool_size = 1);
 	virtual ~LLImageDecodeThread();
 
+	void shutdown() override;
+
 	handle_t decodeImage(LLImageFormatted* image,
 						 U32 priority, S32 discard, BOOL needs_aux,
 						 Responder* responder);
 	S32 update(F32 max_time_ms) override;
 
+	// Number of threads decoding from the shared queue (1 when not threaded)
+	U32 getPoolSize() const { return (U32)mWorkerStats.size(); }
+	const WorkerStats& getWorkerStats(U32 worker) const { return *mWorkerStats[worker]; }
+	void logStats() const;
+
 	// Used by unit tests to check the consistency of the thread instance
 	S32 tut_size();
-	
+
+protected:
+	void startThread() override;
+	void threadedUpdate() override;
+
 private:
+	// Helper thread feeding off the LLImageDecodeThread request queue
+	class PoolWorker : public LLThread
+	{
+	public:
+		PoolWorker(LLImageDecodeThread* parent, U32 index);
+
+	protected:
+		bool runCondition() override;
+		void run() override;
+
+	private:
+		LLImageDecodeThread* mParent;
+		U32 mIndex;
+	};
+
+	void shutdownPool();
+	void wakePool();
+	void noteDequeue(U32 worker);
+
+	std::vector<std::unique_ptr<WorkerStats> > mWorkerStats;	// [0] is this thread
+	std::vector<std::unique_ptr<PoolWorker> > mPool;
+
+
 	struct creation_info
 	{
 		LLPointer<LLImageFormatted> image;
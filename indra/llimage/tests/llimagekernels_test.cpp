@@ -0,0 +1,190 @@
+/**
+ * @file llimagekernels_test.cpp
+ * @brief Checks the vector and threaded image kernels against the scalar ones
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "../llcommon/linden_common.h"
+#include <vector>
+// Class to test
+#include "../llimagekernels.h"
+#include "../llcommon/lljobpool.h"
+// For llformat
+#include "../llcommon/llformat.h"
+// Tut header
+#include "../test/lltut.h"
+
+namespace tut
+{
+	struct imagekernels_test
+	{
+		imagekernels_test()
+		{
+			LLImageKernels::initClass();
+			LLJobPool::initClass(4);
+		}
+		~imagekernels_test()
+		{
+			LLJobPool::cleanupClass();
+		}
+
+		static std::vector<U8> noise(size_t size, U32 seed)
+		{
+			std::vector<U8> data(size);
+			for (size_t i = 0; i < size; ++i)
+			{
+				seed = seed * 1664525 + 1013904223;
+				data[i] = (U8)(seed >> 24);
+			}
+			return data;
+		}
+
+		static S32 maxDifference(const std::vector<U8>& a, const std::vector<U8>& b)
+		{
+			S32 diff = 0;
+			for (size_t i = 0; i < a.size(); ++i)
+			{
+				diff = llmax(diff, abs((S32)a[i] - (S32)b[i]));
+			}
+			return diff;
+		}
+	};
+
+	typedef test_group<imagekernels_test> imagekernels_t;
+	typedef imagekernels_t::object imagekernels_object_t;
+	tut::imagekernels_t tut_imagekernels("LLImageKernels");
+
+	// Every path writes exactly the scalar mips, for all channel counts and
+	// widths that don't fill a whole vector
+	template<> template<>
+	void imagekernels_object_t::test<1>()
+	{
+		const S32 widths[] = { 1, 3, 7, 16, 33, 250 };
+		for (S32 path = LLImageKernels::PATH_SCALAR + 1; path < LLImageKernels::PATH_COUNT; ++path)
+		{
+			if (!LLImageKernels::isSupported((LLImageKernels::EPath)path))
+			{
+				continue;
+			}
+			for (S32 nchannels = 1; nchannels <= 4; ++nchannels)
+			{
+				for (S32 width : widths)
+				{
+					S32 height = 5;
+					std::vector<U8> in = noise(width * 2 * height * 2 * nchannels, width * nchannels);
+					std::vector<U8> expected(width * height * nchannels);
+					std::vector<U8> actual(expected.size());
+
+					LLImageKernels::setPath(LLImageKernels::PATH_SCALAR);
+					LLImageKernels::generateMip(&in[0], &expected[0], width, height, nchannels);
+					LLImageKernels::setPath((LLImageKernels::EPath)path);
+					LLImageKernels::generateMip(&in[0], &actual[0], width, height, nchannels);
+
+					ensure(llformat("%s mip, %d channels, width %d", LLImageKernels::getPathName((LLImageKernels::EPath)path), nchannels, width),
+						   expected == actual);
+				}
+			}
+		}
+	}
+
+	// Resampling a line up and down stays within rounding of the scalar result
+	template<> template<>
+	void imagekernels_object_t::test<2>()
+	{
+		const S32 lengths[][2] = { { 64, 48 }, { 48, 64 }, { 17, 5 }, { 5, 17 }, { 100, 100 } };
+		for (S32 path = LLImageKernels::PATH_SCALAR + 1; path < LLImageKernels::PATH_COUNT; ++path)
+		{
+			if (!LLImageKernels::isSupported((LLImageKernels::EPath)path))
+			{
+				continue;
+			}
+			for (S32 components = 1; components <= 4; ++components)
+			{
+				for (const S32* len : lengths)
+				{
+					std::vector<U8> in = noise(len[0] * components, len[0] + components);
+					std::vector<U8> expected(len[1] * components);
+					std::vector<U8> actual(expected.size());
+
+					LLImageKernels::setPath(LLImageKernels::PATH_SCALAR);
+					LLImageKernels::scaleLine(&in[0], &expected[0], len[0], len[1], 1, 1, components);
+					LLImageKernels::setPath((LLImageKernels::EPath)path);
+					LLImageKernels::scaleLine(&in[0], &actual[0], len[0], len[1], 1, 1, components);
+
+					ensure(llformat("scale %d -> %d, %d components", len[0], len[1], components),
+						   maxDifference(expected, actual) <= 1);
+				}
+			}
+		}
+	}
+
+	// Same for compositing, including the straight copy when lengths match
+	template<> template<>
+	void imagekernels_object_t::test<3>()
+	{
+		const S32 lengths[][2] = { { 64, 48 }, { 48, 64 }, { 9, 3 }, { 100, 100 } };
+		for (S32 path = LLImageKernels::PATH_SCALAR + 1; path < LLImageKernels::PATH_COUNT; ++path)
+		{
+			if (!LLImageKernels::isSupported((LLImageKernels::EPath)path))
+			{
+				continue;
+			}
+			for (const S32* len : lengths)
+			{
+				std::vector<U8> in = noise(len[0] * 4, len[0]);
+				std::vector<U8> background = noise(len[1] * 3, len[1] + 1);
+				std::vector<U8> expected = background;
+				std::vector<U8> actual = background;
+
+				LLImageKernels::setPath(LLImageKernels::PATH_SCALAR);
+				LLImageKernels::compositeLine4onto3(&in[0], &expected[0], len[0], len[1]);
+				LLImageKernels::setPath((LLImageKernels::EPath)path);
+				LLImageKernels::compositeLine4onto3(&in[0], &actual[0], len[0], len[1]);
+
+				ensure(llformat("composite %d -> %d", len[0], len[1]), maxDifference(expected, actual) <= 1);
+			}
+		}
+	}
+
+	// A job big enough for the pool hands out every row exactly once
+	template<> template<>
+	void imagekernels_object_t::test<4>()
+	{
+		const S32 rows = 4099;
+		// Bands never share a row, so plain counters are enough
+		std::vector<U32> visits(rows, 0);
+
+		LLImageKernels::forEachBand(rows, 4096 * 4, [&visits](S32 first, S32 last)
+		{
+			for (S32 row = first; row < last; ++row)
+			{
+				visits[row]++;
+			}
+		});
+
+		for (S32 row = 0; row < rows; ++row)
+		{
+			ensure_equals(llformat("visits of row %d", row), visits[row], 1U);
+		}
+	}
+}
@@ -247,6 +247,47 @@ namespace tut
 		ensure("LLImageDecodeThread: threaded work unit not processed", done == true);
 	}
 
+	template<> template<>
+	void imagedecodethread_object_t::test<3>()
+	{
+		// Test a *threaded* instance with a pool of decode threads sharing the queue
+		const U32 POOL_SIZE = 4;
+		const S32 REQUEST_COUNT = 16;
+		mThread = new LLImageDecodeThread(true, POOL_SIZE);
+		ensure_equals("LLImageDecodeThread: pool size incorrect", mThread->getPoolSize(), POOL_SIZE);
+		// Insert several things in the queue
+		bool done[REQUEST_COUNT];
+		for (S32 i = 0; i < REQUEST_COUNT; ++i)
+		{
+			mThread->decodeImage(NULL, LLQueuedThread::PRIORITY_NORMAL, 0, FALSE, new responder_test(&done[i]));
+		}
+		mThread->update(1);
+		// Wait till every work order has been handled by one of the pool threads
+		const U32 INCREMENT_TIME = 500;				// 500 milliseconds
+		const U32 MAX_TIME = 20 * INCREMENT_TIME;	// Do the loop 20 times max, i.e. wait 10 seconds but no more
+		U32 total_time = 0;
+		S32 completed = 0;
+		while (total_time < MAX_TIME)
+		{
+			completed = std::count(done, done + REQUEST_COUNT, true);
+			if (completed == REQUEST_COUNT)
+			{
+				break;
+			}
+			ms_sleep(INCREMENT_TIME);
+			total_time += INCREMENT_TIME;
+			mThread->update(1);
+		}
+		// Verifies that every responder has been called exactly once and accounted for
+		ensure_equals("LLImageDecodeThread: pooled work units not processed", completed, REQUEST_COUNT);
+		U32 requests = 0;
+		for (U32 i = 0; i < mThread->getPoolSize(); ++i)
+		{
+			requests += mThread->getWorkerStats(i).mRequests;
+		}
+		ensure_equals("LLImageDecodeThread: pool stats incorrect", requests, (U32)REQUEST_COUNT);
+	}
+
 	// ---------------------------------------------------------------------------------------
 	// Test the LLImageDecodeThread::ImageRequest interface
 	// ---------------------------------------------------------------------------------------
@@ -29,6 +29,10 @@
 
 #include "llimagej2c.h"
 
+#if LL_OPENJPEG2
+#include <memory>
+#endif
+
 class LLImageJ2COJ : public LLImageJ2CImpl
 {	
 public:
@@ -42,6 +46,19 @@ protected:
 	bool initDecode(LLImageJ2C &base, LLImageRaw &raw_image, int discard_level = -1, int* region = nullptr) override;
 	bool initEncode(LLImageJ2C &base, LLImageRaw &raw_image, int blocks_size = -1, int precincts_size = -1, int levels = 0) override;
 	std::string getEngineInfo() const override;
+
+#if LL_OPENJPEG2
+private:
+	// Decoder kept alive between time slices of the same decode
+	struct DecodeState;
+	bool startDecode(LLImageJ2C &base, LLImageRaw &raw_image, S32 first_channel, S32 max_channel_count);
+	void resetDecode();
+
+	std::unique_ptr<DecodeState> mDecodeState;
+	// Area set by initDecode(), full resolution codestream coordinates
+	bool mHasRegion;
+	S32 mRegion[4];
+#endif
 };
 
 #endif
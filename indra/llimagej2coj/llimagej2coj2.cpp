@@ -0,0 +1,852 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/**
+ * @file llimagej2coj2.cpp
+ * @brief This is an implementation of JPEG2000 encode/decode using OpenJPEG 2.x.
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "llimagej2coj.h"
+
+#include "openjpeg.h"
+
+#include "lltimer.h"
+
+#include <vector>
+
+// Factory function: see declaration in llimagej2c.cpp
+LLImageJ2CImpl* fallbackCreateLLImageJ2CImpl()
+{
+	return new LLImageJ2COJ();
+}
+
+std::string LLImageJ2COJ::getEngineInfo() const
+{
+	return std::string("OpenJPEG: " OPJ_PACKAGE_VERSION ", Runtime: ")
+		+ opj_version();
+}
+
+// Return string from message, eliminating final \n if present
+static std::string chomp(const char* msg)
+{
+	// stomp trailing \n
+	std::string message = msg;
+	if (!message.empty())
+	{
+		size_t last = message.size() - 1;
+		if (message[last] == '\n')
+		{
+			message.resize( last );
+		}
+	}
+	return message;
+}
+
+static void error_callback(const char* msg, void*)
+{
+	LL_DEBUGS() << "LLImageJ2COJ: " << chomp(msg) << LL_ENDL;
+}
+
+static void warning_callback(const char* msg, void*)
+{
+	LL_DEBUGS() << "LLImageJ2COJ: " << chomp(msg) << LL_ENDL;
+}
+
+static void info_callback(const char* msg, void*)
+{
+	LL_DEBUGS() << "LLImageJ2COJ: " << chomp(msg) << LL_ENDL;
+}
+
+// Divide a by 2 to the power of b and round upwards
+static S32 ceildivpow2(S32 a, S32 b)
+{
+	return (a + (1 << b) - 1) >> b;
+}
+
+static opj_codec_t* create_codec(bool decompress)
+{
+	opj_codec_t* codec = decompress ? opj_create_decompress(OPJ_CODEC_J2K) : opj_create_compress(OPJ_CODEC_J2K);
+	if (codec)
+	{
+		opj_set_error_handler(codec, error_callback, nullptr);
+		opj_set_warning_handler(codec, warning_callback, nullptr);
+		opj_set_info_handler(codec, info_callback, nullptr);
+	}
+	return codec;
+}
+
+//
+// Memory streams.  OpenJPEG 2 only reads through callbacks, these serve the
+// codestream straight out of the LLImageJ2C buffer without copying it.
+//
+
+struct LLJ2CStreamBuffer
+{
+	const U8* mData;
+	OPJ_SIZE_T mSize;
+	OPJ_SIZE_T mOffset;
+	std::vector<U8>* mOutput;		// encoding only
+};
+
+static OPJ_SIZE_T stream_read(void* buffer, OPJ_SIZE_T bytes, void* user_data)
+{
+	LLJ2CStreamBuffer* stream = (LLJ2CStreamBuffer*)user_data;
+	if (stream->mOffset >= stream->mSize)
+	{
+		return (OPJ_SIZE_T)-1;
+	}
+	bytes = llmin(bytes, stream->mSize - stream->mOffset);
+	memcpy(buffer, stream->mData + stream->mOffset, bytes);
+	stream->mOffset += bytes;
+	return bytes;
+}
+
+static OPJ_SIZE_T stream_write(void* buffer, OPJ_SIZE_T bytes, void* user_data)
+{
+	LLJ2CStreamBuffer* stream = (LLJ2CStreamBuffer*)user_data;
+	std::vector<U8>& output = *stream->mOutput;
+	if (stream->mOffset + bytes > output.size())
+	{
+		output.resize(stream->mOffset + bytes);
+	}
+	memcpy(&output[stream->mOffset], buffer, bytes);
+	stream->mOffset += bytes;
+	stream->mSize = output.size();
+	return bytes;
+}
+
+static OPJ_OFF_T stream_skip(OPJ_OFF_T bytes, void* user_data)
+{
+	LLJ2CStreamBuffer* stream = (LLJ2CStreamBuffer*)user_data;
+	OPJ_OFF_T offset = llclamp((OPJ_OFF_T)stream->mOffset + bytes, (OPJ_OFF_T)0, (OPJ_OFF_T)stream->mSize);
+	bytes = offset - (OPJ_OFF_T)stream->mOffset;
+	stream->mOffset = (OPJ_SIZE_T)offset;
+	return bytes;
+}
+
+static OPJ_BOOL stream_seek(OPJ_OFF_T offset, void* user_data)
+{
+	LLJ2CStreamBuffer* stream = (LLJ2CStreamBuffer*)user_data;
+	if (offset < 0 || (OPJ_SIZE_T)offset > stream->mSize)
+	{
+		return OPJ_FALSE;
+	}
+	stream->mOffset = (OPJ_SIZE_T)offset;
+	return OPJ_TRUE;
+}
+
+static opj_stream_t* create_stream(LLJ2CStreamBuffer* buffer, bool input)
+{
+	opj_stream_t* stream = opj_stream_create(OPJ_J2K_STREAM_CHUNK_SIZE, input ? OPJ_TRUE : OPJ_FALSE);
+	if (stream)
+	{
+		opj_stream_set_user_data(stream, buffer, nullptr);
+		if (input)
+		{
+			opj_stream_set_user_data_length(stream, buffer->mSize);
+			opj_stream_set_read_function(stream, stream_read);
+		}
+		else
+		{
+			opj_stream_set_write_function(stream, stream_write);
+		}
+		opj_stream_set_skip_function(stream, stream_skip);
+		opj_stream_set_seek_function(stream, stream_seek);
+	}
+	return stream;
+}
+
+//
+// Decode state
+//
+
+// A decode is started on the first slice and then runs one tile per step
+// until the slice's time is up, picking up where it left off on the next
+// slice.  It is thrown away when the request changes, e.g. because the
+// fetcher appended data and a finer discard level is wanted.
+struct LLImageJ2COJ::DecodeState
+{
+	DecodeState()
+		: mCodec(nullptr), mStream(nullptr), mImage(nullptr),
+		  mDataSize(0), mDiscard(0), mFirstChannel(0), mMaxChannels(0),
+		  mHeaderComps(0), mChannels(0), mX0(0), mY0(0), mWidth(0), mHeight(0), mNextTile(0)
+	{
+		memset(&mBuffer, 0, sizeof(mBuffer));
+	}
+
+	~DecodeState()
+	{
+		if (mImage)
+		{
+			opj_image_destroy(mImage);
+		}
+		if (mStream)
+		{
+			opj_stream_destroy(mStream);
+		}
+		if (mCodec)
+		{
+			opj_destroy_codec(mCodec);
+		}
+	}
+
+	bool matches(LLImageJ2C& base, S32 first_channel, S32 max_channel_count) const
+	{
+		return mBuffer.mData == base.getData() && mDataSize == base.getDataSize()
+			&& mDiscard == base.getRawDiscardLevel()
+			&& mFirstChannel == first_channel && mMaxChannels == max_channel_count;
+	}
+
+	// The component of mImage holding output channel dest, or null if the
+	// decoder didn't produce it.  When the decoded components are restricted,
+	// OpenJPEG shrinks mImage->comps down to just those on decode.
+	const opj_image_comp_t* getComponent(S32 dest) const
+	{
+		S32 index = (S32)mImage->numcomps == mHeaderComps ? mFirstChannel + dest : dest;
+		return index < (S32)mImage->numcomps ? &mImage->comps[index] : nullptr;
+	}
+
+	opj_codec_t* mCodec;
+	opj_stream_t* mStream;
+	opj_image_t* mImage;
+	LLJ2CStreamBuffer mBuffer;
+
+	// What was asked for
+	S32 mDataSize;
+	S32 mDiscard;
+	S32 mFirstChannel;
+	S32 mMaxChannels;
+
+	// Components in the codestream
+	S32 mHeaderComps;
+
+	// Output area, in pixels at the decoded resolution
+	S32 mChannels;
+	S32 mX0;
+	S32 mY0;
+	S32 mWidth;
+	S32 mHeight;
+
+	// Tiles still to decode, empty when the whole area is decoded at once
+	std::vector<U32> mTiles;
+	size_t mNextTile;
+};
+
+// Copies what a component decoded over the output area, flipping it since
+// raw images are stored bottom up
+static bool copy_component(const opj_image_comp_t& comp, U8* rawp, S32 dest, S32 channels,
+						   S32 x0, S32 y0, S32 width, S32 height)
+{
+	if (!comp.data)
+	{
+		// Some rare OpenJPEG versions have this bug.
+		LL_DEBUGS("Texture") << "ERROR -> decodeImpl: failed to decode image! (NULL comp data - OpenJPEG bug)" << LL_ENDL;
+		return false;
+	}
+
+	S32 first_x = llmax((S32)comp.x0, x0);
+	S32 last_x = llmin((S32)(comp.x0 + comp.w), x0 + width);
+	S32 first_y = llmax((S32)comp.y0, y0);
+	S32 last_y = llmin((S32)(comp.y0 + comp.h), y0 + height);
+	for (S32 y = first_y; y < last_y; ++y)
+	{
+		const OPJ_INT32* src = comp.data + (y - comp.y0) * comp.w + (first_x - comp.x0);
+		U8* dst = rawp + ((height - 1 - (y - y0)) * width + (first_x - x0)) * channels + dest;
+		for (S32 x = first_x; x < last_x; ++x)
+		{
+			*dst = (U8)*src++;
+			dst += channels;
+		}
+	}
+	return true;
+}
+
+LLImageJ2COJ::LLImageJ2COJ()
+	: LLImageJ2CImpl(),
+	  mHasRegion(false)
+{
+	memset(mRegion, 0, sizeof(mRegion));
+}
+
+
+LLImageJ2COJ::~LLImageJ2COJ()
+{
+}
+
+bool LLImageJ2COJ::initDecode(LLImageJ2C &base, LLImageRaw &raw_image, int discard_level, int* region)
+{
+	// Takes effect on the next decode.  region is left, top, right, bottom
+	// in full resolution pixels, from the top left corner of the codestream.
+	resetDecode();
+	if (discard_level >= 0)
+	{
+		base.setDiscardLevel(discard_level);
+	}
+	mHasRegion = region != nullptr;
+	if (region)
+	{
+		memcpy(mRegion, region, sizeof(mRegion));
+	}
+	return true;
+}
+
+bool LLImageJ2COJ::initEncode(LLImageJ2C &base, LLImageRaw &raw_image, int blocks_size, int precincts_size, int levels)
+{
+	// No specific implementation for this method in the OpenJpeg case
+	return false;
+}
+
+void LLImageJ2COJ::resetDecode()
+{
+	mDecodeState.reset();
+}
+
+bool LLImageJ2COJ::startDecode(LLImageJ2C &base, LLImageRaw &raw_image, S32 first_channel, S32 max_channel_count)
+{
+	std::unique_ptr<DecodeState> state(new DecodeState);
+	state->mBuffer.mData = base.getData();
+	state->mBuffer.mSize = base.getDataSize();
+	state->mDataSize = base.getDataSize();
+	state->mDiscard = base.getRawDiscardLevel();
+	state->mFirstChannel = first_channel;
+	state->mMaxChannels = max_channel_count;
+
+	opj_dparameters_t parameters;	/* decompression parameters */
+	opj_set_default_decoder_parameters(&parameters);
+
+	state->mCodec = create_codec(true);
+	state->mStream = create_stream(&state->mBuffer, true);
+	if (!state->mCodec || !state->mStream
+		|| !opj_setup_decoder(state->mCodec, &parameters)
+		|| !opj_read_header(state->mStream, state->mCodec, &state->mImage)
+		|| !state->mImage || !state->mImage->numcomps)
+	{
+		LL_DEBUGS("Texture") << "ERROR -> decodeImpl: failed to read codestream header!" << LL_ENDL;
+		return false;
+	}
+
+	opj_image_t* image = state->mImage;
+	if ((S32)image->numcomps <= first_channel)
+	{
+		LL_WARNS() << "trying to decode more channels than are present in image: numcomps: " << image->numcomps << " first_channel: " << first_channel << LL_ENDL;
+		return false;
+	}
+	state->mHeaderComps = image->numcomps;
+	state->mChannels = llmin((S32)image->numcomps - first_channel, max_channel_count);
+
+	if (!opj_set_decoded_resolution_factor(state->mCodec, state->mDiscard))
+	{
+		return false;
+	}
+
+	// Skip the components nobody asked for, e.g. everything but alpha when
+	// decoding the aux channel.  The color transform needs the first three
+	// together, so only ranges that keep them whole or leave them out.
+	S32 last_channel = first_channel + state->mChannels;
+	if (state->mChannels < (S32)image->numcomps
+		&& (first_channel >= 3 || (first_channel == 0 && last_channel >= 3)))
+	{
+		std::vector<OPJ_UINT32> components;
+		for (S32 comp = first_channel; comp < last_channel; ++comp)
+		{
+			components.push_back(comp);
+		}
+		if (!opj_set_decoded_components(state->mCodec, components.size(), &components[0], OPJ_FALSE))
+		{
+			return false;
+		}
+	}
+
+	// Area to decode on the reference grid
+	S32 area_x0 = image->x0;
+	S32 area_y0 = image->y0;
+	S32 area_x1 = image->x1;
+	S32 area_y1 = image->y1;
+	if (mHasRegion)
+	{
+		area_x0 = llclamp(mRegion[0] + (S32)image->x0, (S32)image->x0, (S32)image->x1);
+		area_y0 = llclamp(mRegion[1] + (S32)image->y0, (S32)image->y0, (S32)image->y1);
+		area_x1 = llclamp(mRegion[2] + (S32)image->x0, area_x0, (S32)image->x1);
+		area_y1 = llclamp(mRegion[3] + (S32)image->y0, area_y0, (S32)image->y1);
+		if (area_x0 == area_x1 || area_y0 == area_y1)
+		{
+			LL_WARNS() << "Empty decode region " << mRegion[0] << "," << mRegion[1] << " - " << mRegion[2] << "," << mRegion[3] << LL_ENDL;
+			return false;
+		}
+	}
+
+	// Components all share the grid in the textures we make, the output is
+	// sized after the first one as in the old decoder
+	S32 dx = image->comps[0].dx;
+	S32 dy = image->comps[0].dy;
+	state->mX0 = ceildivpow2((area_x0 + dx - 1) / dx, state->mDiscard);
+	state->mY0 = ceildivpow2((area_y0 + dy - 1) / dy, state->mDiscard);
+	state->mWidth = ceildivpow2((area_x1 + dx - 1) / dx, state->mDiscard) - state->mX0;
+	state->mHeight = ceildivpow2((area_y1 + dy - 1) / dy, state->mDiscard) - state->mY0;
+
+	opj_codestream_info_v2_t* info = opj_get_cstr_info(state->mCodec);
+	if (info && info->tw * info->th > 1)
+	{
+		// Several tiles: decode the ones that touch the area one at a time
+		for (U32 ty = 0; ty < info->th; ++ty)
+		{
+			for (U32 tx = 0; tx < info->tw; ++tx)
+			{
+				S32 tile_x0 = info->tx0 + tx * info->tdx;
+				S32 tile_y0 = info->ty0 + ty * info->tdy;
+				if (tile_x0 < area_x1 && tile_x0 + (S32)info->tdx > area_x0
+					&& tile_y0 < area_y1 && tile_y0 + (S32)info->tdy > area_y0)
+				{
+					state->mTiles.push_back(ty * info->tw + tx);
+				}
+			}
+		}
+	}
+	else if (mHasRegion)
+	{
+		// One tile: let the decoder skip the code-blocks outside the area
+		if (!opj_set_decode_area(state->mCodec, image, area_x0, area_y0, area_x1, area_y1))
+		{
+			opj_destroy_cstr_info(&info);
+			return false;
+		}
+	}
+	opj_destroy_cstr_info(&info);
+
+	raw_image.resize(state->mWidth, state->mHeight, state->mChannels);
+	if (!raw_image.getData())
+	{
+		base.setLastError("Memory error");
+		return false;
+	}
+	if (!state->mTiles.empty())
+	{
+		// Tiles may not cover every pixel at coarse resolutions
+		memset(raw_image.getData(), 0, raw_image.getDataSize());
+	}
+
+	mDecodeState = std::move(state);
+	return true;
+}
+
+bool LLImageJ2COJ::decodeImpl(LLImageJ2C &base, LLImageRaw &raw_image, F32 decode_time, S32 first_channel, S32 max_channel_count)
+{
+	LLTimer decode_timer;
+
+	if (mDecodeState && !mDecodeState->matches(base, first_channel, max_channel_count))
+	{
+		resetDecode();
+	}
+
+	if (!mDecodeState)
+	{
+		/* Extract metadata */
+		/* ---------------- */
+		U8* c_data = base.getData();
+		size_t c_size =  base.getDataSize();
+		size_t position = 0;
+
+		while (position < 1024 && position < (c_size - 7)) // the comment field should be in the first 1024 bytes.
+		{
+			if (c_data[position] == 0xff && c_data[position + 1] == 0x64)
+			{
+				U8 high_byte = c_data[position + 2];
+				U8 low_byte = c_data[position + 3];
+				S32 c_length = (high_byte * 256) + low_byte; // This size also counts the markers, 00 01 and itself
+				if (c_length > 200) // sanity check
+				{
+					// While comments can be very long, anything longer then 200 is suspect.
+					break;
+				}
+
+				if (position + 2 + c_length > c_size)
+				{
+					// comment extends past end of data, corruption, or all data not retrived yet.
+					break;
+				}
+
+				// if the comment block does not end at the end of data, check to see if the next
+				// block starts with 0xFF
+				if (position + 2 + c_length < c_size && c_data[position + 2 + c_length] != 0xff)
+				{
+					// invalied comment block
+					break;
+				}
+
+				// extract the comment minus the markers, 00 01
+				raw_image.mComment.assign((char*)c_data + position + 6, c_length - 4);
+				break;
+			}
+			++position;
+		}
+
+		if(base.getRawDiscardLevel() == 0 && *(U16*)(base.getData() + base.getDataSize() - 2) != 0xD9FF)
+		{
+			bool failed = true;
+			for(S32 i = base.getDataSize()-1; i > 42; --i)
+			{
+				if(base.getData()[i] != 0x00)
+				{
+					failed = *(U16*)(base.getData()+i-1) != 0xD9FF;
+					break;
+				}
+			}
+			if(failed)
+			{
+				base.decodeFailed();
+				return true;
+			}
+		}
+
+		if (!startDecode(base, raw_image, first_channel, max_channel_count))
+		{
+			resetDecode();
+			base.decodeFailed();
+			return true; // done
+		}
+	}
+
+	DecodeState& state = *mDecodeState;
+	U8* rawp = raw_image.getData();
+	if (!rawp || raw_image.getWidth() != state.mWidth || raw_image.getHeight() != state.mHeight
+		|| raw_image.getComponents() != state.mChannels)
+	{
+		// Somebody touched the image between slices
+		resetDecode();
+		base.decodeFailed();
+		return true;
+	}
+
+	bool done = false;
+	bool failed = false;
+	if (state.mTiles.empty())
+	{
+		failed = !opj_decode(state.mCodec, state.mStream, state.mImage)
+			|| !opj_end_decompress(state.mCodec, state.mStream);
+		done = true;
+	}
+	else
+	{
+		while (state.mNextTile < state.mTiles.size())
+		{
+			if (!opj_get_decoded_tile(state.mCodec, state.mStream, state.mImage, state.mTiles[state.mNextTile]))
+			{
+				failed = true;
+				break;
+			}
+			++state.mNextTile;
+			if (state.mNextTile < state.mTiles.size())
+			{
+				// The tile is copied out right away, the next one reuses the image
+				for (S32 dest = 0; dest < state.mChannels; ++dest)
+				{
+					const opj_image_comp_t* comp = state.getComponent(dest);
+					if (!comp || !copy_component(*comp, rawp, dest, state.mChannels,
+												 state.mX0, state.mY0, state.mWidth, state.mHeight))
+					{
+						failed = true;
+						break;
+					}
+				}
+				if (failed || (decode_time > 0.f && decode_timer.getElapsedTimeF32() > decode_time))
+				{
+					break;
+				}
+			}
+		}
+		done = failed || state.mNextTile == state.mTiles.size();
+	}
+
+	if (!done)
+	{
+		return false; // resume on the next slice
+	}
+
+	if (!failed)
+	{
+		// sometimes we get bad data out of the cache - check to see if the decode succeeded
+		for (S32 dest = 0; dest < state.mChannels; ++dest)
+		{
+			const opj_image_comp_t* comp = state.getComponent(dest);
+			if (!comp || (S32)comp->factor != state.mDiscard)
+			{
+				// if we didn't get the discard level we're expecting, fail
+				failed = true;
+				break;
+			}
+		}
+	}
+
+	// Whole area or last tile
+	for (S32 dest = 0; !failed && dest < state.mChannels; ++dest)
+	{
+		failed = !copy_component(*state.getComponent(dest), rawp, dest, state.mChannels,
+								 state.mX0, state.mY0, state.mWidth, state.mHeight);
+	}
+
+	if (failed)
+	{
+		LL_DEBUGS("Texture") << "ERROR -> decodeImpl: failed to decode image!" << LL_ENDL;
+		base.decodeFailed();
+	}
+	resetDecode();
+	return true; // done
+}
+
+
+bool LLImageJ2COJ::encodeImpl(LLImageJ2C &base, const LLImageRaw &raw_image, const char* comment_text, F32 encode_time, bool reversible)
+{
+	const S32 MAX_COMPS = 5;
+	opj_cparameters_t parameters;	/* compression parameters */
+
+	/* set encoding parameters to default values */
+	opj_set_default_encoder_parameters(&parameters);
+	parameters.cod_format = 0;
+	parameters.cp_disto_alloc = 1;
+
+	if (reversible)
+	{
+		parameters.tcp_numlayers = 1;
+		parameters.tcp_rates[0] = 0.0f;
+	}
+	else
+	{
+		parameters.tcp_numlayers = 5;
+		parameters.tcp_rates[0] = 1920.0f;
+		parameters.tcp_rates[1] = 480.0f;
+		parameters.tcp_rates[2] = 120.0f;
+		parameters.tcp_rates[3] = 30.0f;
+		parameters.tcp_rates[4] = 10.0f;
+		parameters.irreversible = 1;
+		if (raw_image.getComponents() >= 3)
+		{
+			parameters.tcp_mct = 1;
+		}
+	}
+
+	if (!comment_text)
+	{
+		parameters.cp_comment = (char *) "";
+	}
+	else
+	{
+		// Awful hacky cast, too lazy to copy right now.
+		parameters.cp_comment = (char *) comment_text;
+	}
+
+	//
+	// Fill in the source image from our raw image
+	//
+	OPJ_COLOR_SPACE color_space = OPJ_CLRSPC_SRGB;
+	opj_image_cmptparm_t cmptparm[MAX_COMPS];
+	S32 numcomps = llmin((S32)raw_image.getComponents(), MAX_COMPS);
+	S32 width = raw_image.getWidth();
+	S32 height = raw_image.getHeight();
+
+	memset(&cmptparm[0], 0, MAX_COMPS * sizeof(opj_image_cmptparm_t));
+	for(S32 c = 0; c < numcomps; c++) {
+		cmptparm[c].prec = 8;
+		cmptparm[c].bpp = 8;
+		cmptparm[c].sgnd = 0;
+		cmptparm[c].dx = parameters.subsampling_dx;
+		cmptparm[c].dy = parameters.subsampling_dy;
+		cmptparm[c].w = width;
+		cmptparm[c].h = height;
+	}
+
+	/* create the image */
+	opj_image_t* image = opj_image_create(numcomps, &cmptparm[0], color_space);
+	if (!image)
+	{
+		LL_DEBUGS("Texture") << "Failed to create image to encode." << LL_ENDL;
+		return false;
+	}
+
+	image->x1 = width;
+	image->y1 = height;
+
+	S32 i = 0;
+	const U8 *src_datap = raw_image.getData();
+	for (S32 y = height - 1; y >= 0; y--)
+	{
+		for (S32 x = 0; x < width; x++)
+		{
+			const U8 *pixel = src_datap + (y*width + x) * numcomps;
+			for (S32 c = 0; c < numcomps; c++)
+			{
+				image->comps[c].data[i] = *pixel;
+				pixel++;
+			}
+			i++;
+		}
+	}
+
+	/* encode the destination image */
+	/* ---------------------------- */
+
+	std::vector<U8> codestream;
+	LLJ2CStreamBuffer buffer = { nullptr, 0, 0, &codestream };
+	opj_codec_t* codec = create_codec(false);
+	opj_stream_t* stream = create_stream(&buffer, false);
+
+	bool success = codec && stream
+		&& opj_setup_encoder(codec, &parameters, image)
+		&& opj_start_compress(codec, image, stream)
+		&& opj_encode(codec, stream)
+		&& opj_end_compress(codec, stream);
+
+	if (stream)
+	{
+		opj_stream_destroy(stream);
+	}
+	if (codec)
+	{
+		opj_destroy_codec(codec);
+	}
+	opj_image_destroy(image);
+
+	if (!success || codestream.empty())
+	{
+		LL_DEBUGS("Texture") << "Failed to encode image." << LL_ENDL;
+		return false;
+	}
+
+	base.copyData(&codestream[0], codestream.size());
+	base.updateData(); // set width, height
+	return true;
+}
+
+inline S32 extractLong4( U8 const *aBuffer, int nOffset )
+{
+	S32 ret = aBuffer[ nOffset ] << 24;
+	ret += aBuffer[ nOffset + 1 ] << 16;
+	ret += aBuffer[ nOffset + 2 ] << 8;
+	ret += aBuffer[ nOffset + 3 ];
+	return ret;
+}
+
+inline S32 extractShort2( U8 const *aBuffer, int nOffset )
+{
+	S32 ret = aBuffer[ nOffset ] << 8;
+	ret += aBuffer[ nOffset + 1 ];
+
+	return ret;
+}
+
+inline bool isSOC( U8 const *aBuffer )
+{
+	return aBuffer[ 0 ] == 0xFF && aBuffer[ 1 ] == 0x4F;
+}
+
+inline bool isSIZ( U8 const *aBuffer )
+{
+	return aBuffer[ 0 ] == 0xFF && aBuffer[ 1 ] == 0x51;
+}
+
+static bool getMetadataFast( LLImageJ2C &aImage, S32 &aW, S32 &aH, S32 &aComps )
+{
+	const int J2K_HDR_LEN( 42 );
+	const int J2K_HDR_X1( 8 );
+	const int J2K_HDR_Y1( 12 );
+	const int J2K_HDR_X0( 16 );
+	const int J2K_HDR_Y0( 20 );
+	const int J2K_HDR_NUMCOMPS( 40 );
+
+	if( aImage.getDataSize() < J2K_HDR_LEN )
+		return false;
+
+	U8 const* pBuffer = aImage.getData();
+
+	if( !isSOC( pBuffer ) || !isSIZ( pBuffer+2 ) )
+		return false;
+
+	S32 x1 = extractLong4( pBuffer, J2K_HDR_X1 );
+	S32 y1 = extractLong4( pBuffer, J2K_HDR_Y1 );
+	S32 x0 = extractLong4( pBuffer, J2K_HDR_X0 );
+	S32 y0 = extractLong4( pBuffer, J2K_HDR_Y0 );
+	S32 numComps = extractShort2( pBuffer, J2K_HDR_NUMCOMPS );
+
+	aComps = numComps;
+	aW = x1 - x0;
+	aH = y1 - y0;
+
+	return true;
+}
+
+bool LLImageJ2COJ::getMetadata(LLImageJ2C &base)
+{
+	// Update the raw discard level
+	base.updateRawDiscardLevel();
+
+	S32 width(0);
+	S32 height(0);
+	S32 img_components(0);
+
+	if ( getMetadataFast( base, width, height, img_components ) )
+	{
+		base.setSize(width, height, img_components);
+		return true;
+	}
+
+	// Do it the slow way, only the main header is read
+	opj_dparameters_t parameters;	/* decompression parameters */
+	opj_set_default_decoder_parameters(&parameters);
+
+	LLJ2CStreamBuffer buffer = { base.getData(), (OPJ_SIZE_T)base.getDataSize(), 0, nullptr };
+	opj_codec_t* codec = create_codec(true);
+	opj_stream_t* stream = create_stream(&buffer, true);
+	opj_image_t* image = nullptr;
+
+	bool success = codec && stream
+		&& opj_setup_decoder(codec, &parameters)
+		&& opj_read_header(stream, codec, &image);
+
+	if (stream)
+	{
+		opj_stream_destroy(stream);
+	}
+	if (codec)
+	{
+		opj_destroy_codec(codec);
+	}
+
+	if(!success || !image)
+	{
+		LL_WARNS() << "ERROR -> getMetadata: failed to decode image!" << LL_ENDL;
+		if (image)
+		{
+			opj_image_destroy(image);
+		}
+		return false;
+	}
+
+	img_components = image->numcomps;
+	width = image->x1 - image->x0;
+	height = image->y1 - image->y0;
+	base.setSize(width, height, img_components);
+
+	/* free image data structure */
+	opj_image_destroy(image);
+	return true;
+}
@@ -0,0 +1,144 @@
+/**
+ * @file llimagej2coj_test.cpp
+ * @brief Round trips images through the OpenJPEG codec, one channel range at a time
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "../llcommon/linden_common.h"
+// Class to test
+#include "../llimagej2coj.h"
+#include "../llimage/llimage.h"
+#include "../llimage/llimagej2c.h"
+// Tut header
+#include "../test/lltut.h"
+
+namespace tut
+{
+	struct imagej2coj_test
+	{
+		imagej2coj_test()
+		{
+			LLImage::initClass();
+		}
+		~imagej2coj_test()
+		{
+			LLImage::cleanupClass();
+		}
+
+		// Every channel gets its own pattern so a decode of the wrong
+		// component shows up
+		static LLPointer<LLImageRaw> makeImage(S32 width, S32 height, S32 components)
+		{
+			LLPointer<LLImageRaw> raw = new LLImageRaw(width, height, components);
+			U8* data = raw->getData();
+			for (S32 y = 0; y < height; ++y)
+			{
+				for (S32 x = 0; x < width; ++x)
+				{
+					for (S32 c = 0; c < components; ++c)
+					{
+						*data++ = (U8)(x * (c + 1) + y * (7 - c) + c * 40);
+					}
+				}
+			}
+			return raw;
+		}
+
+		static LLPointer<LLImageJ2C> encode(const LLImageRaw* raw)
+		{
+			LLPointer<LLImageJ2C> j2c = new LLImageJ2C;
+			j2c->setReversible(true);
+			ensure("encoded", j2c->encode(raw, 0.f));
+			// Decode at full resolution
+			j2c->setDiscardLevel(0);
+			return j2c;
+		}
+
+		static void ensureChannels(const std::string& msg, const LLImageRaw* source, const LLImageRaw* decoded, S32 first_channel)
+		{
+			ensure_equals(msg + " width", decoded->getWidth(), source->getWidth());
+			ensure_equals(msg + " height", decoded->getHeight(), source->getHeight());
+			S32 channels = decoded->getComponents();
+			S32 pixels = source->getWidth() * source->getHeight();
+			for (S32 i = 0; i < pixels; ++i)
+			{
+				for (S32 c = 0; c < channels; ++c)
+				{
+					U8 expected = source->getData()[i * source->getComponents() + first_channel + c];
+					U8 actual = decoded->getData()[i * channels + c];
+					if (expected != actual)
+					{
+						ensure_equals(msg + llformat(" pixel %d channel %d", i, c), (S32)actual, (S32)expected);
+					}
+				}
+			}
+		}
+	};
+
+	typedef test_group<imagej2coj_test> imagej2coj_t;
+	typedef imagej2coj_t::object imagej2coj_object_t;
+	tut::imagej2coj_t tut_imagej2coj("LLImageJ2COJ");
+
+	// The aux channel of a five component texture decodes on its own, as
+	// the decode thread asks for it
+	template<> template<>
+	void imagej2coj_object_t::test<1>()
+	{
+		LLPointer<LLImageRaw> source = makeImage(64, 48, 5);
+		LLPointer<LLImageJ2C> j2c = encode(source);
+
+		LLPointer<LLImageRaw> aux = new LLImageRaw;
+		ensure("aux decode done", j2c->decodeChannels(aux, 0.f, 4, 4));
+		ensure("aux decoded", aux->getData() != nullptr);
+		ensure_equals("aux components", (S32)aux->getComponents(), 1);
+		ensureChannels("aux", source, aux, 4);
+	}
+
+	// Color alone out of the same texture, the components past the first
+	// four are skipped
+	template<> template<>
+	void imagej2coj_object_t::test<2>()
+	{
+		LLPointer<LLImageRaw> source = makeImage(64, 48, 5);
+		LLPointer<LLImageJ2C> j2c = encode(source);
+
+		LLPointer<LLImageRaw> color = new LLImageRaw;
+		ensure("color decode done", j2c->decodeChannels(color, 0.f, 0, 4));
+		ensure("color decoded", color->getData() != nullptr);
+		ensure_equals("color components", (S32)color->getComponents(), 4);
+		ensureChannels("color", source, color, 0);
+	}
+
+	// Asking for a component past the last one fails instead of reading
+	// past the component array
+	template<> template<>
+	void imagej2coj_object_t::test<3>()
+	{
+		LLPointer<LLImageRaw> source = makeImage(32, 32, 4);
+		LLPointer<LLImageJ2C> j2c = encode(source);
+
+		LLPointer<LLImageRaw> aux = new LLImageRaw;
+		ensure("aux decode done", j2c->decodeChannels(aux, 0.f, 4, 4));
+		ensure("nothing decoded", aux->getData() == nullptr);
+	}
+}
@@ -0,0 +1,486 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/**
+ * @file llmessage_bench.cpp
+ * @brief Times decoding and reading ObjectUpdate messages
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "llcommon.h"
+#include "llfile.h"
+#include "llhost.h"
+#include "llmessagetemplate.h"
+#include "llmessagetemplateparser.h"
+#include "lltemplatemessagebuilder.h"
+#include "lltemplatemessagereader.h"
+#include "lltimer.h"
+#include "message.h"
+#include "message_prehash.h"
+
+// Every packet is decoded and then every variable of every block is read
+// back by name, which is what a message handler does.  "legacy" is the
+// decoder the viewer had before templates got perfect hashed lookups and
+// a flat layout: a heap allocated LLMsgBlkData per block instance and an
+// LLMsgVarData copy per variable, found by linear search on every read.
+// It's kept here, as it was, to measure against.  Both must read the same
+// bytes or the run fails.
+
+namespace
+{
+	typedef std::vector<U8> packet_t;
+
+	// Old LLTemplateMessageReader::decodeData() without the dispatch
+	LLMsgData* legacy_decode(const LLMessageTemplate* msg_template, const U8* buffer, S32 size)
+	{
+		S32 decode_pos = LL_PACKET_ID_SIZE + (S32)msg_template->mFrequency + buffer[PHL_OFFSET];
+		LLMsgData* data = new LLMsgData(msg_template->mName);
+
+		for (LLMessageTemplate::message_block_map_t::const_iterator iter = msg_template->mMemberBlocks.begin();
+			 iter != msg_template->mMemberBlocks.end(); ++iter)
+		{
+			const LLMessageBlock* mbci = iter->second;
+			U8 repeat_number = 1;
+			if (mbci->mType == MBT_MULTIPLE)
+			{
+				repeat_number = mbci->mNumber;
+			}
+			else if (mbci->mType == MBT_VARIABLE)
+			{
+				repeat_number = decode_pos < size ? buffer[decode_pos++] : 0;
+			}
+
+			for (S32 i = 0; i < repeat_number; ++i)
+			{
+				LLMsgBlkData* block_data = new LLMsgBlkData(mbci->mName, repeat_number);
+				block_data->mName = mbci->mName + i;
+				data->addBlock(block_data);
+
+				for (LLMessageBlock::message_variable_map_t::const_iterator var_iter = mbci->mMemberVariables.begin();
+					 var_iter != mbci->mMemberVariables.end(); ++var_iter)
+				{
+					const LLMessageVariable& mvci = *var_iter->second;
+					block_data->addVariable(mvci.getName(), mvci.getType());
+					if (mvci.getType() == MVT_VARIABLE)
+					{
+						U32 tsize = 0;
+						if (decode_pos + mvci.getSize() <= size)
+						{
+							for (S32 byte = mvci.getSize() - 1; byte >= 0; --byte)
+							{
+								// little endian on the wire
+								tsize = (tsize << 8) | buffer[decode_pos + byte];
+							}
+						}
+						decode_pos += mvci.getSize();
+						tsize = llmin(tsize, (U32)llmax(size - decode_pos, 0));
+						block_data->addData(mvci.getName(), &buffer[decode_pos], tsize, mvci.getType());
+						decode_pos += tsize;
+					}
+					else
+					{
+						if (decode_pos + mvci.getSize() > size)
+						{
+							std::vector<U8> zeros(mvci.getSize(), 0);
+							block_data->addData(mvci.getName(), zeros.data(), mvci.getSize(), mvci.getType());
+						}
+						else
+						{
+							block_data->addData(mvci.getName(), &buffer[decode_pos], mvci.getSize(), mvci.getType());
+						}
+						decode_pos += mvci.getSize();
+					}
+				}
+			}
+		}
+		return data;
+	}
+
+	// Old LLTemplateMessageReader::getData() and getSize(), returns the
+	// variable's size or -1 if it isn't there
+	S32 legacy_read(LLMsgData* data, const char* blockname, S32 blocknum, const char* varname,
+					U8* datap, S32 max_size)
+	{
+		LLMsgData::msg_blk_data_map_t::const_iterator iter = data->mMemberBlocks.find((char*)blockname + blocknum);
+		if (iter == data->mMemberBlocks.end())
+		{
+			return -1;
+		}
+		LLMsgBlkData::msg_var_data_map_t& var_data_map = iter->second->mMemberVarData;
+		if (var_data_map.find((char*)varname) == var_data_map.end())
+		{
+			return -1;
+		}
+		LLMsgVarData& vardata = var_data_map[(char*)varname];
+		memcpy(datap, vardata.getData(), llmin(vardata.getSize(), max_size));
+		return vardata.getSize();
+	}
+
+	S32 legacy_count(LLMsgData* data, const char* blockname)
+	{
+		LLMsgData::msg_blk_data_map_t::const_iterator iter = data->mMemberBlocks.find((char*)blockname);
+		return iter == data->mMemberBlocks.end() ? 0 : iter->second->mBlockNumber;
+	}
+
+	void hash_bytes(U32& hash, const U8* data, S32 size)
+	{
+		for (S32 i = 0; i < size; ++i)
+		{
+			hash = (hash ^ data[i]) * 16777619U;
+		}
+	}
+
+	U32 run_legacy(LLTemplateMessageReader& reader, const std::vector<packet_t>& packets)
+	{
+		U32 hash = 2166136261U;
+		U8 value[MAX_BUFFER_SIZE];
+		for (const packet_t& packet : packets)
+		{
+			LLMessageTemplate* msg_template = nullptr;
+			if (!reader.decodeTemplate(packet.data(), (S32)packet.size(), &msg_template, TRUE))
+			{
+				continue;
+			}
+			LLMsgData* data = legacy_decode(msg_template, packet.data(), (S32)packet.size());
+			for (LLMessageTemplate::message_block_map_t::const_iterator iter = msg_template->mMemberBlocks.begin();
+				 iter != msg_template->mMemberBlocks.end(); ++iter)
+			{
+				const LLMessageBlock* block = iter->second;
+				S32 count = legacy_count(data, block->mName);
+				for (S32 i = 0; i < count; ++i)
+				{
+					for (LLMessageBlock::message_variable_map_t::const_iterator var_iter = block->mMemberVariables.begin();
+						 var_iter != block->mMemberVariables.end(); ++var_iter)
+					{
+						S32 size = legacy_read(data, block->mName, i, var_iter->first, value, MAX_BUFFER_SIZE);
+						hash_bytes(hash, value, size);
+					}
+				}
+			}
+			delete data;
+		}
+		return hash;
+	}
+
+	U32 run_reader(LLTemplateMessageReader& reader, const std::vector<packet_t>& packets)
+	{
+		U32 hash = 2166136261U;
+		U8 value[MAX_BUFFER_SIZE];
+		const LLHost host;
+		for (const packet_t& packet : packets)
+		{
+			if (!reader.validateMessage(packet.data(), (S32)packet.size(), host, true, TRUE)
+				|| !reader.buildData(packet.data(), host, TRUE))
+			{
+				reader.clearMessage();
+				continue;
+			}
+			const LLMessageTemplate* msg_template = reader.getTemplate();
+			for (LLMessageTemplate::message_block_map_t::const_iterator iter = msg_template->mMemberBlocks.begin();
+				 iter != msg_template->mMemberBlocks.end(); ++iter)
+			{
+				const LLMessageBlock* block = iter->second;
+				S32 count = reader.getNumberOfBlocks(block->mName);
+				for (S32 i = 0; i < count; ++i)
+				{
+					for (LLMessageBlock::message_variable_map_t::const_iterator var_iter = block->mMemberVariables.begin();
+						 var_iter != block->mMemberVariables.end(); ++var_iter)
+					{
+						S32 size = reader.getSize(block->mName, i, var_iter->first);
+						reader.getData(block->mName, var_iter->first, value, 0, i, MAX_BUFFER_SIZE);
+						hash_bytes(hash, value, size);
+					}
+				}
+			}
+			reader.clearMessage();
+		}
+		return hash;
+	}
+
+	// Packets shaped like a busy region's: a few objects each, the
+	// variable length fields anywhere from empty to a good size
+	void make_packets(LLTemplateMessageBuilder& builder, const LLMessageTemplate* msg_template,
+					  S32 count, std::vector<packet_t>& packets)
+	{
+		U32 seed = 0x12345678;
+		U8 random[MAX_BUFFER_SIZE];
+		U8 buffer[MAX_BUFFER_SIZE];
+		for (S32 p = 0; p < count; ++p)
+		{
+			builder.newMessage(msg_template->mName);
+			for (LLMessageTemplate::message_block_map_t::const_iterator iter = msg_template->mMemberBlocks.begin();
+				 iter != msg_template->mMemberBlocks.end(); ++iter)
+			{
+				const LLMessageBlock* block = iter->second;
+				S32 repeat = block->mType == MBT_VARIABLE ? 1 + p % 3 : (block->mType == MBT_MULTIPLE ? block->mNumber : 1);
+				for (S32 i = 0; i < repeat; ++i)
+				{
+					builder.nextBlock(block->mName);
+					for (LLMessageBlock::message_variable_map_t::const_iterator var_iter = block->mMemberVariables.begin();
+						 var_iter != block->mMemberVariables.end(); ++var_iter)
+					{
+						const LLMessageVariable& var = *var_iter->second;
+						seed = seed * 1664525 + 1013904223;
+						S32 size = var.getType() != MVT_VARIABLE ? var.getSize() : (S32)(seed >> 16) % (var.getSize() == 1 ? 24 : 96);
+						for (S32 b = 0; b < size; ++b)
+						{
+							seed = seed * 1664525 + 1013904223;
+							random[b] = (U8)(seed >> 24);
+						}
+						builder.addBinaryData(var_iter->first, random, size);
+					}
+				}
+			}
+			U32 size = builder.buildMessage(buffer, MAX_BUFFER_SIZE, 0);
+			packets.push_back(packet_t(buffer, buffer + size));
+			builder.clearMessage();
+		}
+	}
+
+	// Capture format: each datagram as it came off the socket, after a
+	// little endian U16 byte count.  Appended acks are dropped and zero
+	// coding expanded, only messages named name are kept.
+	bool load_packets(const std::string& filename, LLTemplateMessageReader& reader,
+					  const char* name, std::vector<packet_t>& packets)
+	{
+		llifstream file(filename.c_str(), std::ios::binary);
+		if (!file.is_open())
+		{
+			std::cerr << "Unable to open " << filename << std::endl;
+			return false;
+		}
+
+		U8 raw[MAX_BUFFER_SIZE];
+		U8 expanded[MAX_BUFFER_SIZE];
+		U8 length[2];
+		while (file.read((char*)length, 2))
+		{
+			S32 size = length[0] | (length[1] << 8);
+			if (size > MAX_BUFFER_SIZE || !file.read((char*)raw, size))
+			{
+				std::cerr << filename << " is truncated or not a capture" << std::endl;
+				return false;
+			}
+			if (size < LL_MINIMUM_VALID_PACKET_SIZE)
+			{
+				continue;
+			}
+
+			if (raw[0] & LL_ACK_FLAG)
+			{
+				S32 acks = raw[--size];
+				size -= acks * sizeof(TPACKETID);
+				if (size < LL_MINIMUM_VALID_PACKET_SIZE)
+				{
+					continue;
+				}
+			}
+			const U8* buffer = raw;
+			if (raw[0] & LL_ZERO_CODE_FLAG)
+			{
+				S32 overflows = 0;
+				size = LLMessageSystem::zeroCodeExpandBuffer(raw, size, expanded, overflows);
+				buffer = expanded;
+			}
+
+			LLMessageTemplate* msg_template = nullptr;
+			if (reader.decodeTemplate(buffer, size, &msg_template, TRUE) && msg_template->mName == name)
+			{
+				packets.push_back(packet_t(buffer, buffer + size));
+			}
+		}
+		return true;
+	}
+
+	void usage(std::ostream& out)
+	{
+		out << "\n"
+			"usage:\tllmessage_bench [-i iterations] [-n packets] [-c capture] message_template.msg\n"
+			"\n"
+			"Decodes ObjectUpdate packets and reads back every variable by name\n"
+			"with the legacy decoder and with LLTemplateMessageReader, checking\n"
+			"that both read the same data.\n"
+			"\n"
+			"Options:\n"
+			"\n"
+			" -i <count>    Passes over the packets (default 20)\n"
+			" -n <count>    Packets to synthesize when there's no capture (default 10000)\n"
+			" -c <file>     Recorded datagrams, each after a little endian U16 size\n"
+			<< std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	S32 iterations = 20;
+	S32 count = 10000;
+	std::string capture;
+	std::string template_file;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg(argv[i]);
+		if ((arg == "-i" || arg == "-n") && i + 1 < argc)
+		{
+			S32 value = atoi(argv[++i]);
+			if (value <= 0)
+			{
+				usage(std::cerr);
+				return 1;
+			}
+			if (arg == "-i")
+			{
+				iterations = value;
+			}
+			else
+			{
+				count = value;
+			}
+		}
+		else if (arg == "-c" && i + 1 < argc)
+		{
+			capture = argv[++i];
+		}
+		else if (arg[0] != '-' && template_file.empty())
+		{
+			template_file = arg;
+		}
+		else
+		{
+			usage(std::cerr);
+			return 1;
+		}
+	}
+	if (template_file.empty())
+	{
+		usage(std::cerr);
+		return 1;
+	}
+
+	LLCommon::initClass();
+
+	std::string template_body;
+	if (!_read_file_into_string(template_body, template_file))
+	{
+		std::cerr << "Unable to read " << template_file << std::endl;
+		return 1;
+	}
+	LLTemplateTokenizer tokens(template_body);
+	LLTemplateParser parsed(tokens);
+	LLTemplateMessageBuilder::message_template_name_map_t names;
+	LLTemplateMessageReader::message_template_number_map_t numbers;
+	for (LLTemplateParser::message_iterator iter = parsed.getMessagesBegin();
+		 iter != parsed.getMessagesEnd(); ++iter)
+	{
+		names[(*iter)->mName] = *iter;
+		numbers[(*iter)->mMessageNumber] = *iter;
+	}
+	const LLMessageTemplate* object_update = get_ptr_in_map(names, _PREHASH_ObjectUpdate);
+	if (!object_update)
+	{
+		std::cerr << template_file << " has no ObjectUpdate" << std::endl;
+		return 1;
+	}
+
+	LLTemplateMessageReader reader(numbers);
+	std::vector<packet_t> packets;
+	if (!capture.empty())
+	{
+		if (!load_packets(capture, reader, _PREHASH_ObjectUpdate, packets))
+		{
+			return 1;
+		}
+	}
+	else
+	{
+		LLTemplateMessageBuilder builder(names);
+		make_packets(builder, object_update, count, packets);
+	}
+	if (packets.empty())
+	{
+		std::cerr << "No ObjectUpdate packets" << std::endl;
+		return 1;
+	}
+
+	S32 bytes = 0;
+	for (const packet_t& packet : packets)
+	{
+		bytes += (S32)packet.size();
+	}
+	printf("%d packets, %d bytes average\n", (S32)packets.size(), bytes / (S32)packets.size());
+
+	struct Run
+	{
+		const char* mName;
+		U32 (*mRun)(LLTemplateMessageReader& reader, const std::vector<packet_t>& packets);
+	};
+	const Run runs[] =
+	{
+		{ "legacy", run_legacy },
+		{ "reader", run_reader },
+	};
+
+	printf("%-8s %12s %12s %8s %10s\n", "decoder", "ms/pass", "ns/packet", "speedup", "hash");
+	F64 reference_ms = 0.0;
+	U32 reference_hash = 0;
+	bool matched = true;
+	for (const Run& run : runs)
+	{
+		U32 hash = run.mRun(reader, packets);	// warm up
+		LLTimer timer;
+		for (S32 i = 0; i < iterations; ++i)
+		{
+			hash = run.mRun(reader, packets);
+		}
+		F64 ms = timer.getElapsedTimeF64() * 1000.0 / iterations;
+
+		if (reference_ms == 0.0)
+		{
+			reference_ms = ms;
+			reference_hash = hash;
+		}
+		matched = matched && hash == reference_hash;
+		printf("%-8s %12.3f %12.1f %7.2fx %10x\n",
+			   run.mName, ms, ms * 1000000.0 / packets.size(), reference_ms / ms, hash);
+	}
+
+	for (LLTemplateParser::message_iterator iter = parsed.getMessagesBegin();
+		 iter != parsed.getMessagesEnd(); ++iter)
+	{
+		delete *iter;
+	}
+	LLCommon::cleanupClass();
+
+	if (!matched)
+	{
+		std::cerr << "Decoders disagree" << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -519,37 +519,19 @@ LLSD HttpCoroRawHandler::handleSuccess(LLCore::HttpResponse * response, LLCore::
 
     size_t size = body->size();
 
-    LLCore::BufferArrayStream bas(body);
-
-#if 1
-    // This is the slower implementation.  It is safe vis-a-vi the const_cast<> and modification
-    // of a LLSD managed array but contains an extra (potentially large) copy.
-    // 
-    // *TODO: https://jira.secondlife.com/browse/MAINT-5221
-    
-    LLSD::Binary data;
-    data.reserve(size);
-    bas >> std::noskipws;
-    data.assign(std::istream_iterator<U8>(bas), std::istream_iterator<U8>());
+    // Copy straight out of the body's extents rather than a
+    // byte at a time through a stream.  LLSD still takes a copy
+    // of its own.
+    LLSD::Binary data(size);
+    size_t pos(0), seg_len(0);
+    while (const char * seg = body->getSegment(pos, &seg_len))
+    {
+        memcpy(&data[pos], seg, seg_len);
+        pos += seg_len;
+    }
 
     result[HttpCoroutineAdapter::HTTP_RESULTS_RAW] = data;
 
-#else
-    // This is disabled because it's dangerous.  See the other case for an 
-    // alternate implementation.
-    // We create a new LLSD::Binary object and assign it to the result map.
-    // The LLSD has created it's own copy so we retrieve it asBinary and const cast 
-    // the reference so that we can modify it.
-    // *TODO: This is potentially dangerous... but I am trying to avoid a potentially 
-    // large copy.
-    result[HttpCoroutineAdapter::HTTP_RESULTS_RAW] = LLSD::Binary();
-    LLSD::Binary &data = const_cast<LLSD::Binary &>( result[HttpCoroutineAdapter::HTTP_RESULTS_RAW].asBinary() );
-
-    data.reserve(size);
-    bas >> std::noskipws;
-    data.assign(std::istream_iterator<U8>(bas), std::istream_iterator<U8>());
-#endif
-
     return result;
 }
 
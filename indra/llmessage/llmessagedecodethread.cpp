@@ -0,0 +1,210 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/**
+ * @file llmessagedecodethread.cpp
+ * @brief Receives and decodes template messages off the main thread
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llmessagedecodethread.h"
+
+#include "llmessagetemplate.h"
+#include "llpacketring.h"
+#include "lltimer.h"
+
+// How long to wait on an empty socket before looking at isQuitting()
+// again.  Also bounds the delay on packets held back by the simulated
+// bandwidth throttle, which doesn't wake the socket.
+static const F32 POLL_TIMEOUT_SECONDS = 0.01f;
+
+LLDecodedPacket::LLDecodedPacket()
+{
+	reset();
+}
+
+LLDecodedPacket::~LLDecodedPacket()
+{
+}
+
+void LLDecodedPacket::reset()
+{
+	mSender.invalidate();
+	mReceivingIF.invalidate();
+	mTrueSize = 0;
+	mSize = 0;
+	mCompressedSize = 0;
+	mExpandOverflows = 0;
+	mTemplate = nullptr;
+	mData.clear();
+}
+
+LLMessageDecodeThread::LLMessageDecodeThread(S32 socket, LLPacketRing& packet_ring,
+											 LLTemplateMessageReader::message_template_number_map_t& message_numbers)
+	: LLThread("Message decode"),
+	  mSocket(socket),
+	  mPacketRing(packet_ring),
+	  mReader(message_numbers),
+	  mAllocated(0)
+{
+	apr_socket_t* apr_socket = nullptr;
+	apr_os_sock_put(&apr_socket, (apr_os_sock_t*)&mSocket, mAPRPoolp);
+
+	mPollFD.p = mAPRPoolp;
+	mPollFD.desc_type = APR_POLL_SOCKET;
+	mPollFD.reqevents = APR_POLLIN;
+	mPollFD.rtnevents = 0;
+	mPollFD.desc.s = apr_socket;
+	mPollFD.client_data = nullptr;
+}
+
+LLMessageDecodeThread::~LLMessageDecodeThread()
+{
+	shutdown();
+
+	LLDecodedPacket* packetp = nullptr;
+	while (mDecoded.pop(packetp))
+	{
+		delete packetp;
+	}
+	while (mFree.pop(packetp))
+	{
+		delete packetp;
+	}
+}
+
+// MAIN THREAD
+LLDecodedPacket* LLMessageDecodeThread::popPacket()
+{
+	LLDecodedPacket* packetp = nullptr;
+	mDecoded.pop(packetp);
+	return packetp;
+}
+
+// MAIN THREAD
+void LLMessageDecodeThread::releasePacket(LLDecodedPacket* packetp)
+{
+	packetp->reset();
+	// Never more packets around than the queue holds
+	mFree.push(packetp);
+}
+
+// virtual
+void LLMessageDecodeThread::run()
+{
+	LLDecodedPacket* packetp = nullptr;
+	while (!isQuitting())
+	{
+		if (!packetp)
+		{
+			packetp = allocatePacket();
+			if (!packetp)
+			{
+				// Main thread is behind, let the socket buffer take the slack
+				ms_sleep(1);
+				continue;
+			}
+		}
+
+		if (!receivePacket(packetp))
+		{
+			waitForPacket();
+			continue;
+		}
+
+		decodePacket(packetp);
+		mDecoded.push(packetp);
+		packetp = nullptr;
+	}
+	delete packetp;
+	LL_INFOS("Messaging") << "Message decode thread exiting" << LL_ENDL;
+}
+
+LLDecodedPacket* LLMessageDecodeThread::allocatePacket()
+{
+	LLDecodedPacket* packetp = nullptr;
+	if (!mFree.pop(packetp) && mAllocated < MAX_PACKETS)
+	{
+		packetp = new LLDecodedPacket;
+		++mAllocated;
+	}
+	return packetp;
+}
+
+bool LLMessageDecodeThread::receivePacket(LLDecodedPacket* packetp)
+{
+	packetp->mTrueSize = mPacketRing.receivePacket(mSocket, (char *)packetp->mTrueBuffer);
+	if (!packetp->mTrueSize)
+	{
+		return false;
+	}
+	packetp->mSender = mPacketRing.getLastSender();
+	packetp->mReceivingIF = mPacketRing.getLastReceivingInterface();
+	return true;
+}
+
+void LLMessageDecodeThread::decodePacket(LLDecodedPacket* packetp)
+{
+	// Anything wrong at this level is left for checkMessages() to report,
+	// it goes through the same checks on the main thread.
+	S32 size = packetp->mTrueSize;
+	if (size < (S32)LL_MINIMUM_VALID_PACKET_SIZE)
+	{
+		return;
+	}
+
+	const U8* buffer = packetp->mTrueBuffer;
+	if (buffer[0] & LL_ACK_FLAG)
+	{
+		S32 acks = buffer[--size];
+		if (size < (S32)(acks * sizeof(TPACKETID) + LL_MINIMUM_VALID_PACKET_SIZE))
+		{
+			return;
+		}
+		size -= acks * sizeof(TPACKETID);
+	}
+
+	if (buffer[0] & LL_ZERO_CODE_FLAG)
+	{
+		packetp->mCompressedSize = size;
+		size = LLMessageSystem::zeroCodeExpandBuffer(buffer, size, packetp->mExpandedBuffer,
+													 packetp->mExpandOverflows);
+		buffer = packetp->mExpandedBuffer;
+	}
+	packetp->mSize = size;
+
+	packetp->mTemplate = mReader.predecode(buffer, size, packetp->mSender, packetp->mData);
+}
+
+void LLMessageDecodeThread::waitForPacket()
+{
+	S32 num_socks = 0;
+	apr_status_t status = apr_poll(&mPollFD, 1, &num_socks, (U64)(POLL_TIMEOUT_SECONDS * 1000000.f));
+	if (status != APR_SUCCESS && status != APR_TIMEUP && !APR_STATUS_IS_EINTR(status))
+	{
+		ll_apr_warn_status(status);
+		// Don't spin on a socket that keeps failing
+		ms_sleep(1);
+	}
+}
@@ -0,0 +1,116 @@
+/**
+ * @file llmessagedecodethread.h
+ * @brief Receives and decodes template messages off the main thread
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMESSAGEDECODETHREAD_H
+#define LL_LLMESSAGEDECODETHREAD_H
+
+#include <boost/lockfree/spsc_queue.hpp>
+
+#include "llapr.h"
+#include "llhost.h"
+#include "llthread.h"
+#include "lltemplatemessagereader.h"
+#include "message.h"
+
+class LLMessageTemplate;
+class LLPacketRing;
+
+// One datagram as received, along with everything the decode thread
+// could work out about it without touching circuit state.
+class LLDecodedPacket
+{
+public:
+	LLDecodedPacket();
+	~LLDecodedPacket();
+
+	void reset();
+
+	LLHost		mSender;
+	LLHost		mReceivingIF;
+
+	S32			mTrueSize;			// As received, appended acks and all
+	U8			mTrueBuffer[MAX_BUFFER_SIZE];
+
+	// Filled in when mTrueSize is at least LL_MINIMUM_VALID_PACKET_SIZE
+	// and the appended ack count is sane
+	S32			mSize;				// Without acks, after zero code expansion
+	S32			mCompressedSize;	// Before expansion, 0 if not zero coded
+	S32			mExpandOverflows;	// See LLMessageSystem::zeroCodeExpandBuffer()
+	U8			mExpandedBuffer[MAX_BUFFER_SIZE];
+	LLMessageTemplate* mTemplate;	// NULL if the message isn't registered
+	LLMsgReadData mData;			// Invalid if the body didn't decode
+};
+
+// Pulls datagrams off the message system's socket, strips the appended
+// acks, expands zero coding and decodes the message against its template,
+// then hands the result to the main thread through a lock free queue.
+// What's left for LLMessageSystem::checkMessages() is circuit bookkeeping
+// and calling the handler.
+//
+// Circuits aren't thread safe, so acks are still collected and sent by
+// the main thread; they cost a few map lookups a packet.
+//
+// Threading: the LLPacketRing receive side belongs to this thread while
+// it runs.  popPacket() and releasePacket() are main thread only.
+class LLMessageDecodeThread : public LLThread
+{
+public:
+	// Decoded packets waiting for the main thread, past this the rest are
+	// left in the socket buffer until it catches up
+	static const S32 MAX_PACKETS = 256;
+
+	LLMessageDecodeThread(S32 socket, LLPacketRing& packet_ring,
+						  LLTemplateMessageReader::message_template_number_map_t& message_numbers);
+	~LLMessageDecodeThread();
+
+	// MAIN THREAD
+	// Next packet in the order received, NULL if there's none waiting.
+	// Give it back with releasePacket() once done with it.
+	LLDecodedPacket* popPacket();
+	void releasePacket(LLDecodedPacket* packetp);
+
+protected:
+	void run() override;
+
+private:
+	LLDecodedPacket* allocatePacket();
+	bool receivePacket(LLDecodedPacket* packetp);
+	void decodePacket(LLDecodedPacket* packetp);
+	void waitForPacket();
+
+	typedef boost::lockfree::spsc_queue<LLDecodedPacket*, boost::lockfree::capacity<MAX_PACKETS> > packet_queue_t;
+
+	S32 mSocket;
+	LLPacketRing& mPacketRing;
+	LLTemplateMessageReader mReader;
+	apr_pollfd_t mPollFD;
+
+	packet_queue_t mDecoded;		// To the main thread
+	packet_queue_t mFree;			// Back from the main thread
+	S32 mAllocated;					// Decode thread only
+};
+
+#endif // LL_LLMESSAGEDECODETHREAD_H
@@ -32,6 +32,8 @@
 
 #include "message.h"
 
+#include <algorithm>
+
 U32 sMsgDataAllocSize = 0;
 U32 sMsgdataAllocCount = 0;
 
@@ -74,6 +76,193 @@ void LLMsgData::addDataFast(char *blockname, char *varname, const void *data, S3
 	}
 }
 
+// LLMessageNameHash functions
+
+LLMessageNameHash::LLMessageNameHash()
+{
+	build(std::vector<const char*>());
+}
+
+void LLMessageNameHash::build(const std::vector<const char*>& names)
+{
+	// Roughly two names a bucket and a quarter of the slots spare.  Bits
+	// are kept at one or more so the shifts below stay under 64.
+	const U32 count = (U32)names.size();
+	U32 bucket_bits = 1;
+	while ((1U << bucket_bits) < (count + 1) / 2)
+	{
+		++bucket_bits;
+	}
+	U32 slot_bits = 1;
+	while ((1U << slot_bits) < count + count / 4)
+	{
+		++slot_bits;
+	}
+
+	// Fixed sequence of odd multipliers, the names are at the same
+	// addresses on every run so the tables come out the same too
+	U64 seed = 0x9e3779b97f4a7c15ULL;
+	for (S32 attempt = 0; ; ++attempt)
+	{
+		if (attempt && !(attempt % 16))
+		{
+			// Give the slots more room every so often
+			++slot_bits;
+			if (slot_bits > 20)
+			{
+				LL_ERRS() << "No perfect hash for " << count << " names, are some repeated?" << LL_ENDL;
+			}
+		}
+
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		mMultiplier = seed | 1;
+		mBucketShift = 64 - bucket_bits;
+		mSlotShift = mBucketShift - slot_bits;
+		mSlotMask = (1U << slot_bits) - 1;
+
+		const Slot empty = { nullptr, -1 };
+		mSlots.assign(mSlotMask + 1, empty);
+		mDisplacements.assign((size_t)1 << bucket_bits, 0);
+
+		// Place the fullest buckets first, while there's the most room
+		std::vector<std::vector<U32> > buckets((size_t)1 << bucket_bits);
+		for (U32 i = 0; i < count; ++i)
+		{
+			buckets[(size_t)(((U64)(uintptr_t)names[i] * mMultiplier) >> mBucketShift)].push_back(i);
+		}
+		std::vector<U32> order(buckets.size());
+		for (U32 i = 0; i < order.size(); ++i)
+		{
+			order[i] = i;
+		}
+		std::stable_sort(order.begin(), order.end(),
+						 [&buckets](U32 a, U32 b) { return buckets[a].size() > buckets[b].size(); });
+
+		bool placed_all = true;
+		for (U32 bucket : order)
+		{
+			const std::vector<U32>& members = buckets[bucket];
+			if (members.empty())
+			{
+				break;
+			}
+
+			bool placed = false;
+			for (U32 displacement = 0; displacement <= mSlotMask && !placed; ++displacement)
+			{
+				placed = true;
+				for (size_t i = 0; i < members.size() && placed; ++i)
+				{
+					const U64 hash = (U64)(uintptr_t)names[members[i]] * mMultiplier;
+					const U32 slot = ((U32)(hash >> mSlotShift) & mSlotMask) ^ displacement;
+					if (mSlots[slot].mName)
+					{
+						placed = false;
+					}
+					else
+					{
+						// Claim it for now so bucket mates can't land on it
+						mSlots[slot].mName = names[members[i]];
+						mSlots[slot].mIndex = (S32)members[i];
+					}
+				}
+
+				if (placed)
+				{
+					mDisplacements[bucket] = displacement;
+				}
+				else
+				{
+					// Let go of whatever this try claimed
+					for (size_t i = 0; i < members.size(); ++i)
+					{
+						const U64 hash = (U64)(uintptr_t)names[members[i]] * mMultiplier;
+						const U32 slot = ((U32)(hash >> mSlotShift) & mSlotMask) ^ displacement;
+						if (mSlots[slot].mIndex == (S32)members[i] && mSlots[slot].mName == names[members[i]])
+						{
+							mSlots[slot] = empty;
+						}
+					}
+				}
+			}
+
+			if (!placed)
+			{
+				placed_all = false;
+				break;
+			}
+		}
+
+		if (placed_all)
+		{
+			return;
+		}
+	}
+}
+
+// LLMsgReadData functions
+
+LLMsgReadData::LLMsgReadData()
+	: mTemplate(nullptr),
+	  mOverrunPos(-1),
+	  mOverrunWanted(0)
+{
+}
+
+void LLMsgReadData::clear()
+{
+	mTemplate = nullptr;
+	mBuffer.clear();
+	mVars.clear();
+	mBlocks.clear();
+	mOverrunPos = -1;
+	mOverrunWanted = 0;
+}
+
+void LLMsgReadData::swap(LLMsgReadData& other)
+{
+	std::swap(mTemplate, other.mTemplate);
+	mBuffer.swap(other.mBuffer);
+	mVars.swap(other.mVars);
+	mBlocks.swap(other.mBlocks);
+	std::swap(mOverrunPos, other.mOverrunPos);
+	std::swap(mOverrunWanted, other.mOverrunWanted);
+}
+
+void LLMsgReadData::copyTo(LLMsgData& data) const
+{
+	if (!mTemplate)
+	{
+		return;
+	}
+
+	// Same shape decoding used to produce: block instance i is named
+	// mName + i and every instance carries the repeat count
+	S32 block_index = 0;
+	for (LLMessageTemplate::message_block_map_t::const_iterator iter = mTemplate->mMemberBlocks.begin();
+		 iter != mTemplate->mMemberBlocks.end(); ++iter, ++block_index)
+	{
+		const LLMessageBlock* template_block = iter->second;
+		const Block& block = mBlocks[block_index];
+		for (S32 instance = 0; instance < block.mCount; ++instance)
+		{
+			LLMsgBlkData* block_data = new LLMsgBlkData(template_block->mName, block.mCount);
+			block_data->mName = template_block->mName + instance;
+			data.addBlock(block_data);
+
+			S32 var_index = 0;
+			for (LLMessageBlock::message_variable_map_t::const_iterator var_iter = template_block->mMemberVariables.begin();
+				 var_iter != template_block->mMemberVariables.end(); ++var_iter, ++var_index)
+			{
+				const LLMessageVariable& template_var = *var_iter->second;
+				const Var& var = getVar(block, instance, var_index);
+				block_data->addVariable(template_var.getName(), var.mType);
+				block_data->addData(template_var.getName(), getData(var), var.mSize, var.mType);
+			}
+		}
+	}
+}
+
 // LLMessageVariable functions and friends
 
 std::ostream& operator<<(std::ostream& s, LLMessageVariable &msg)
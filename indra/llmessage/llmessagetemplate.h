@@ -136,6 +136,42 @@ public:
 	S32									mTotalSize;
 };
 
+// Finds interned names (see LLMessageStringTable) by pointer, for the
+// block and variable lookups behind every get*Fast() call.  build()
+// searches for a hash and per-bucket displacements that give every name
+// a slot of its own, so find() is a multiply, two table reads and a
+// single compare whatever the number of names.
+class LLMessageNameHash
+{
+public:
+	LLMessageNameHash();
+
+	// names[i] will be found as i
+	void build(const std::vector<const char*>& names);
+
+	// -1 if name isn't one of them
+	S32 find(const char* name) const
+	{
+		const U64 hash = (U64)(uintptr_t)name * mMultiplier;
+		const U32 slot = ((U32)(hash >> mSlotShift) & mSlotMask) ^ mDisplacements[(size_t)(hash >> mBucketShift)];
+		return mSlots[slot].mName == name ? mSlots[slot].mIndex : -1;
+	}
+
+private:
+	struct Slot
+	{
+		const char*	mName;
+		S32			mIndex;
+	};
+
+	std::vector<Slot>	mSlots;
+	std::vector<U32>	mDisplacements;		// one per bucket
+	U64					mMultiplier;
+	U32					mBucketShift;
+	U32					mSlotShift;
+	U32					mSlotMask;
+};
+
 // LLMessage* classes store the template of messages
 class LLMessageVariable
 {
@@ -207,6 +243,20 @@ public:
 		{
 			mTotalSize = -1;
 		}
+
+		std::vector<const char*> names;
+		for (message_variable_map_t::const_iterator iter = mMemberVariables.begin();
+			 iter != mMemberVariables.end(); ++iter)
+		{
+			names.push_back(iter->first);
+		}
+		mVariableHash.build(names);
+	}
+
+	// Index of a variable in mMemberVariables, -1 if it isn't there
+	S32 findVariable(const char* name) const
+	{
+		return mVariableHash.find(name);
 	}
 
 	EMsgVariableType getVariableType(char *name)
@@ -233,6 +283,9 @@ public:
 	EMsgBlockType							mType;
 	S32										mNumber;
 	S32										mTotalSize;
+
+private:
+	LLMessageNameHash						mVariableHash;
 };
 
 
@@ -316,6 +369,20 @@ public:
 		{
 			mTotalSize = -1;
 		}
+
+		std::vector<const char*> names;
+		for (message_block_map_t::const_iterator iter = mMemberBlocks.begin();
+			 iter != mMemberBlocks.end(); ++iter)
+		{
+			names.push_back(iter->first);
+		}
+		mBlockHash.build(names);
+	}
+
+	// Index of a block in mMemberBlocks, -1 if it isn't there
+	S32 findBlock(const char* name) const
+	{
+		return mBlockHash.find(name);
 	}
 
 	LLMessageBlock *getBlock(char *name)
@@ -418,6 +485,57 @@ private:
 	// message handler function (this is set by each application)
 	typedef std::vector<std::function<void(LLMessageSystem *msgsystem)>> callback_list_t;
 	callback_list_t mMessageCallbacks;
+
+	LLMessageNameHash mBlockHash;
+};
+
+// A received message laid out flat against its template.  The body is
+// kept as it came off the wire and each variable of each block instance
+// is an offset into it, found by index rather than by name:
+//   mVars[mBlocks[block].mFirst + instance * mBlocks[block].mStride + variable]
+// where block and variable are the positions LLMessageTemplate::findBlock()
+// and LLMessageBlock::findVariable() give.  Nothing is allocated per
+// variable, and the vectors keep their capacity from one message to the
+// next.
+class LLMsgReadData
+{
+public:
+	struct Var
+	{
+		S32					mOffset;	// into mBuffer, wire byte order
+		S32					mSize;
+		EMsgVariableType	mType;
+	};
+
+	struct Block
+	{
+		S32		mFirst;		// first of its entries in mVars
+		S32		mCount;		// instances received
+		S32		mStride;	// variables per instance
+	};
+
+	LLMsgReadData();
+
+	void clear();
+	void swap(LLMsgReadData& other);
+	bool isValid() const					{ return mTemplate != nullptr; }
+
+	const Var& getVar(const Block& block, S32 instance, S32 variable) const
+	{
+		return mVars[block.mFirst + instance * block.mStride + variable];
+	}
+	const U8* getData(const Var& var) const	{ return mBuffer.data() + var.mOffset; }
+
+	// Rebuilds the message in the structures the builders copy from
+	void copyTo(LLMsgData& data) const;
+
+	const LLMessageTemplate*	mTemplate;
+	std::vector<U8>				mBuffer;
+	std::vector<Var>			mVars;
+	std::vector<Block>			mBlocks;	// one per template block, in template order
+
+	S32							mOverrunPos;	// where decoding first ran off the end, -1 if it didn't
+	S32							mOverrunWanted;
 };
 
 #endif // LL_LLMESSAGETEMPLATE_H
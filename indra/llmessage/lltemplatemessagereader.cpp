@@ -44,7 +44,6 @@ LLTemplateMessageReader::LLTemplateMessageReader(message_template_number_map_t&
 												 number_template_map) :
 	mReceiveSize(0),
 	mCurrentRMessageTemplate(nullptr),
-	mCurrentRMessageData(nullptr),
 	mMessageNumbers(number_template_map)
 {
 }
@@ -52,8 +51,6 @@ LLTemplateMessageReader::LLTemplateMessageReader(message_template_number_map_t&
 //virtual 
 LLTemplateMessageReader::~LLTemplateMessageReader()
 {
-	delete mCurrentRMessageData;
-	mCurrentRMessageData = nullptr;
 }
 
 //virtual
@@ -61,8 +58,7 @@ void LLTemplateMessageReader::clearMessage()
 {
 	mReceiveSize = -1;
 	mCurrentRMessageTemplate = nullptr;
-	delete mCurrentRMessageData;
-	mCurrentRMessageData = nullptr;
+	mCurrentRMessageData.clear();
 }
 
 void LLTemplateMessageReader::getData(const char *blockname, const char *varname, void *datap, S32 size, S32 blocknum, S32 max_size)
@@ -74,82 +70,61 @@ void LLTemplateMessageReader::getData(const char *blockname, const char *varname
 		return;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mCurrentRMessageData.isValid())
 	{
 		LL_ERRS() << "Invalid mCurrentMessageData in getData!" << LL_ENDL;
 		return;
 	}
 
-	char *bnamep = (char *)blockname + blocknum; // this works because it's just a hash.  The bnamep is never derefference
-	char *vnamep = (char *)varname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	const LLMessageTemplate* msg_template = mCurrentRMessageData.mTemplate;
+	const S32 block_index = msg_template->findBlock(blockname);
+	const LLMsgReadData::Block* block = block_index < 0 ? nullptr : &mCurrentRMessageData.mBlocks[block_index];
+	if (!block || blocknum < 0 || blocknum >= block->mCount)
 	{
 		LL_ERRS() << "Block " << blockname << " #" << blocknum
-			<< " not in message " << mCurrentRMessageData->mName << LL_ENDL;
+			<< " not in message " << msg_template->mName << LL_ENDL;
 		return;
 	}
 
-	LLMsgBlkData *msg_block_data = iter->second;
-	LLMsgBlkData::msg_var_data_map_t &var_data_map = msg_block_data->mMemberVarData;
-
-	if (var_data_map.find(vnamep) == var_data_map.end())
+	const S32 var_index = (msg_template->mMemberBlocks.begin() + block_index)->second->findVariable(varname);
+	if (var_index < 0)
 	{
-		LL_ERRS() << "Variable "<< vnamep << " not in message "
-			<< mCurrentRMessageData->mName<< " block " << bnamep << LL_ENDL;
+		LL_ERRS() << "Variable "<< varname << " not in message "
+			<< msg_template->mName << " block " << blockname << LL_ENDL;
 		return;
 	}
 
-	LLMsgVarData& vardata = msg_block_data->mMemberVarData[vnamep];
+	const LLMsgReadData::Var& vardata = mCurrentRMessageData.getVar(*block, blocknum, var_index);
 
-	if (size && size != vardata.getSize())
+	if (size && size != vardata.mSize)
 	{
-		LL_ERRS() << "Msg " << mCurrentRMessageData->mName 
-			<< " variable " << vnamep
-			<< " is size " << vardata.getSize()
+		LL_ERRS() << "Msg " << msg_template->mName 
+			<< " variable " << varname
+			<< " is size " << vardata.mSize
 			<< " but copying into buffer of size " << size
 			<< LL_ENDL;
 		return;
 	}
 
-
-	const S32 vardata_size = vardata.getSize();
+	// Still in wire order, fix it up on the way out the way
+	// LLMsgVarData::addData() used to on the way in
+	const S32 vardata_size = vardata.mSize;
 	if( max_size >= vardata_size )
 	{   
-		switch( vardata_size )
-		{ 
-		case 0:
-			// This is here to prevent a memcpy from a null value which is undefined behavior.
-			break;
-		case 1:
-			*((U8*)datap) = *((U8*)vardata.getData());
-			break;
-		case 2:
-			*((U16*)datap) = *((U16*)vardata.getData());
-			break;
-		case 4:
-			*((U32*)datap) = *((U32*)vardata.getData());
-			break;
-		case 8:
-			((U32*)datap)[0] = ((U32*)vardata.getData())[0];
-			((U32*)datap)[1] = ((U32*)vardata.getData())[1];
-			break;
-		default:
-			memcpy(datap, vardata.getData(), vardata_size);
-			break;
+		if (vardata_size)
+		{
+			htonmemcpy(datap, mCurrentRMessageData.getData(vardata), vardata.mType, vardata_size);
 		}
 	}
 	else
 	{
-		LL_WARNS() << "Msg " << mCurrentRMessageData->mName 
-			<< " variable " << vnamep
-			<< " is size " << vardata.getSize()
+		LL_WARNS() << "Msg " << msg_template->mName 
+			<< " variable " << varname
+			<< " is size " << vardata_size
 			<< " but truncated to max size of " << max_size
 			<< LL_ENDL;
 
-		memcpy(datap, vardata.getData(), max_size);
+		memcpy(datap, mCurrentRMessageData.getData(vardata), max_size);
 	}
 }
 
@@ -162,22 +137,19 @@ S32 LLTemplateMessageReader::getNumberOfBlocks(const char *blockname)
 		return -1;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mCurrentRMessageData.isValid())
 	{
 		LL_ERRS() << "Invalid mCurrentRMessageData in getData!" << LL_ENDL;
 		return -1;
 	}
 
-	char *bnamep = (char *)blockname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	const S32 block_index = mCurrentRMessageData.mTemplate->findBlock(blockname);
+	if (block_index < 0)
 	{
 		return 0;
 	}
 
-	return (iter->second)->mBlockNumber;
+	return mCurrentRMessageData.mBlocks[block_index].mCount;
 }
 
 S32 LLTemplateMessageReader::getSize(const char *blockname, const char *varname)
@@ -189,43 +161,38 @@ S32 LLTemplateMessageReader::getSize(const char *blockname, const char *varname)
 		return LL_MESSAGE_ERROR;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mCurrentRMessageData.isValid())
 	{	// This is a serious error - crash
 		LL_ERRS() << "Invalid mCurrentRMessageData in getData!" << LL_ENDL;
 		return LL_MESSAGE_ERROR;
 	}
 
-	char *bnamep = (char *)blockname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	const LLMessageTemplate* msg_template = mCurrentRMessageData.mTemplate;
+	const S32 block_index = msg_template->findBlock(blockname);
+	if (block_index < 0 || !mCurrentRMessageData.mBlocks[block_index].mCount)
 	{	// don't crash
-		LL_INFOS() << "Block " << bnamep << " not in message "
-			<< mCurrentRMessageData->mName << LL_ENDL;
+		LL_INFOS() << "Block " << blockname << " not in message "
+			<< msg_template->mName << LL_ENDL;
 		return LL_BLOCK_NOT_IN_MESSAGE;
 	}
 
-	char *vnamep = (char *)varname; 
-
-	LLMsgBlkData* msg_data = iter->second;
-	LLMsgVarData& vardata = msg_data->mMemberVarData[vnamep];
-	
-	if (!vardata.getName())
+	const LLMessageBlock* template_block = (msg_template->mMemberBlocks.begin() + block_index)->second;
+	const S32 var_index = template_block->findVariable(varname);
+	if (var_index < 0)
 	{	// don't crash
 		LL_INFOS() << "Variable " << varname << " not in message "
-			<< mCurrentRMessageData->mName << " block " << bnamep << LL_ENDL;
+			<< msg_template->mName << " block " << blockname << LL_ENDL;
 		return LL_VARIABLE_NOT_IN_BLOCK;
 	}
 
-	if (mCurrentRMessageTemplate->mMemberBlocks[bnamep]->mType != MBT_SINGLE)
+	if (template_block->mType != MBT_SINGLE)
 	{	// This is a serious error - crash
-		LL_ERRS() << "Block " << bnamep << " isn't type MBT_SINGLE,"
+		LL_ERRS() << "Block " << blockname << " isn't type MBT_SINGLE,"
 			" use getSize with blocknum argument!" << LL_ENDL;
 		return LL_MESSAGE_ERROR;
 	}
 
-	return vardata.getSize();
+	return mCurrentRMessageData.getVar(mCurrentRMessageData.mBlocks[block_index], 0, var_index).mSize;
 }
 
 S32 LLTemplateMessageReader::getSize(const char *blockname, S32 blocknum, const char *varname)
@@ -237,35 +204,30 @@ S32 LLTemplateMessageReader::getSize(const char *blockname, S32 blocknum, const
 		return LL_MESSAGE_ERROR;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mCurrentRMessageData.isValid())
 	{	// This is a serious error - crash
 		LL_ERRS() << "Invalid mCurrentRMessageData in getData!" << LL_ENDL;
 		return LL_MESSAGE_ERROR;
 	}
 
-	char *bnamep = (char *)blockname + blocknum; 
-	char *vnamep = (char *)varname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	const LLMessageTemplate* msg_template = mCurrentRMessageData.mTemplate;
+	const S32 block_index = msg_template->findBlock(blockname);
+	if (block_index < 0 || blocknum < 0 || blocknum >= mCurrentRMessageData.mBlocks[block_index].mCount)
 	{	// don't crash
-		LL_INFOS() << "Block " << bnamep << " not in message " 
-			<< mCurrentRMessageData->mName << LL_ENDL;
+		LL_INFOS() << "Block " << blockname << " #" << blocknum << " not in message " 
+			<< msg_template->mName << LL_ENDL;
 		return LL_BLOCK_NOT_IN_MESSAGE;
 	}
 
-	LLMsgBlkData* msg_data = iter->second;
-	LLMsgVarData& vardata = msg_data->mMemberVarData[vnamep];
-	
-	if (!vardata.getName())
+	const S32 var_index = (msg_template->mMemberBlocks.begin() + block_index)->second->findVariable(varname);
+	if (var_index < 0)
 	{	// don't crash
-		LL_INFOS() << "Variable " << vnamep << " not in message "
-			<<  mCurrentRMessageData->mName << " block " << bnamep << LL_ENDL;
+		LL_INFOS() << "Variable " << varname << " not in message "
+			<<  msg_template->mName << " block " << blockname << LL_ENDL;
 		return LL_VARIABLE_NOT_IN_BLOCK;
 	}
 
-	return vardata.getSize();
+	return mCurrentRMessageData.getVar(mCurrentRMessageData.mBlocks[block_index], blocknum, var_index).mSize;
 }
 
 void LLTemplateMessageReader::getBinaryData(const char *blockname, 
@@ -540,20 +502,39 @@ static LLTrace::BlockTimerStatHandle FTM_PROCESS_MESSAGES("Process Messages");
 
 // decode a given message
 BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender, BOOL custom)
+{
+	if (!buildData(buffer, sender, custom))
+	{
+		return FALSE;
+	}
+	if (!custom)
+	{
+		dispatchData(sender);
+	}
+	return TRUE;
+}
+
+// build mCurrentRMessageData from the message body
+BOOL LLTemplateMessageReader::buildData(const U8* buffer, const LLHost& sender, BOOL custom)
 {
 	llassert( mReceiveSize >= 0 );
 	llassert( mCurrentRMessageTemplate);
-	llassert( !mCurrentRMessageData );
-	delete mCurrentRMessageData; // just to make sure
+	llassert( !mCurrentRMessageData.isValid() );
+	LLMsgReadData& data = mCurrentRMessageData;
+	data.clear(); // just to make sure
 
 	// The offset tells us how may bytes to skip after the end of the
 	// message name.
 	U8 offset = buffer[PHL_OFFSET];
 	S32 decode_pos = LL_PACKET_ID_SIZE + (S32)(mCurrentRMessageTemplate->mFrequency) + offset;
 
-	// create base working data set
-	mCurrentRMessageData = new LLMsgData(mCurrentRMessageTemplate->mName);
-	
+	// Variables point into a copy of the packet, so it only needs to
+	// outlive this call.  Anything read past the end gets zeros appended.
+	data.mTemplate = mCurrentRMessageTemplate;
+	data.mBuffer.assign(buffer, buffer + mReceiveSize);
+	data.mBlocks.reserve(mCurrentRMessageTemplate->mMemberBlocks.size());
+	S32 instances = 0;
+
 	// loop through the template building the data structure as we go
 	LLMessageTemplate::message_block_map_t::const_iterator iter;
 	for(iter = mCurrentRMessageTemplate->mMemberBlocks.begin();
@@ -599,29 +580,20 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender,
 		{
 			if (!custom)
 			LL_ERRS() << "Unknown block type" << LL_ENDL;
+			data.clear();
 			return FALSE;
 		}
 
-		LLMsgBlkData* cur_data_block = nullptr;
+		LLMsgReadData::Block block;
+		block.mFirst = (S32)data.mVars.size();
+		block.mCount = repeat_number;
+		block.mStride = (S32)mbci->mMemberVariables.size();
+		data.mBlocks.push_back(block);
+		instances += repeat_number;
 
 		// now loop through the block
 		for (i = 0; i < repeat_number; i++)
 		{
-			if (i)
-			{
-				// build new name to prevent collisions
-				// TODO: This should really change to a vector
-				cur_data_block = new LLMsgBlkData(mbci->mName, repeat_number);
-				cur_data_block->mName = mbci->mName + i;
-			}
-			else
-			{
-				cur_data_block = new LLMsgBlkData(mbci->mName, repeat_number);
-			}
-
-			// add the block to the message
-			mCurrentRMessageData->addBlock(cur_data_block);
-
 			// now read the variables
 			for (LLMessageBlock::message_variable_map_t::const_iterator iter = 
 					 mbci->mMemberVariables.begin();
@@ -629,9 +601,8 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender,
 			{
 				const LLMessageVariable& mvci = *iter->second;
 
-				// ok, build out the variables
-				// add variable block
-				cur_data_block->addVariable(mvci.getName(), mvci.getType());
+				LLMsgReadData::Var var;
+				var.mType = mvci.getType();
 
 				// what type of variable?
 				if (mvci.getType() == MVT_VARIABLE)
@@ -644,6 +615,7 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender,
 
 					if ((decode_pos + data_size) > mReceiveSize)
 					{
+						noteRanOffEndOfPacket(decode_pos, data_size);
 						if (!custom)
 						logRanOffEndOfPacket(sender, decode_pos, data_size);
 
@@ -672,95 +644,114 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender,
 					}
 					decode_pos += data_size;
 
-					cur_data_block->addData(mvci.getName(), &buffer[decode_pos], tsize, mvci.getType());
+					if (tsize > (U32)llmax(mReceiveSize - decode_pos, 0))
+					{
+						// Length runs past the end of the packet, don't go
+						// reading whatever follows it in the buffer
+						noteRanOffEndOfPacket(decode_pos, tsize);
+						if (!custom)
+						logRanOffEndOfPacket(sender, decode_pos, tsize);
+						tsize = 0;
+					}
+
+					var.mOffset = tsize ? decode_pos : 0;
+					var.mSize = tsize;
 					decode_pos += tsize;
 				}
 				else
 				{
 					// fixed!
-					// so, copy data pointer and set data size to fixed size
+					// so, point at the data and set data size to fixed size
+					var.mSize = mvci.getSize();
 					if ((decode_pos + mvci.getSize()) > mReceiveSize)
 					{
+						noteRanOffEndOfPacket(decode_pos, mvci.getSize());
 						if (!custom)
 						logRanOffEndOfPacket(sender, decode_pos, mvci.getSize());
 
 						// default to 0s.
-						U32 size = mvci.getSize();
-						std::vector<U8> data(size, 0);
-						cur_data_block->addData(mvci.getName(), &(data[0]), 
-												size, mvci.getType());
+						var.mOffset = (S32)data.mBuffer.size();
+						data.mBuffer.resize(data.mBuffer.size() + var.mSize, 0);
 					}
 					else
 					{
-						cur_data_block->addData(mvci.getName(), 
-												&buffer[decode_pos], 
-												mvci.getSize(), 
-												mvci.getType());
+						var.mOffset = decode_pos;
 					}
 					decode_pos += mvci.getSize();
 				}
+				data.mVars.push_back(var);
 			}
 		}
 	}
 
-	if (mCurrentRMessageData->mMemberBlocks.empty()
-		&& !mCurrentRMessageTemplate->mMemberBlocks.empty())
+	if (!instances && !mCurrentRMessageTemplate->mMemberBlocks.empty())
 	{
 		LL_DEBUGS() << "Empty message '" << mCurrentRMessageTemplate->mName << "' (no blocks)" << LL_ENDL;
+		data.clear();
 		return FALSE;
 	}
+	return TRUE;
+}
 
-	if (!custom)
+// hand the decoded message to its handler
+void LLTemplateMessageReader::dispatchData(const LLHost& sender)
+{
+	static LLTimer decode_timer;
+
+	if(LLMessageReader::getTimeDecodes() || gMessageSystem->getTimingCallback())
 	{
-		static LLTimer decode_timer;
+		decode_timer.reset();
+	}
 
-		if(LLMessageReader::getTimeDecodes() || gMessageSystem->getTimingCallback())
+	{
+		LL_RECORD_BLOCK_TIME(FTM_PROCESS_MESSAGES);
+		if( !mCurrentRMessageTemplate->callHandlerFunc(gMessageSystem) )
 		{
-			decode_timer.reset();
+			LL_WARNS() << "Message from " << sender << " with no handler function received: " << mCurrentRMessageTemplate->mName << LL_ENDL;
 		}
+	}
+
+	if(LLMessageReader::getTimeDecodes() || gMessageSystem->getTimingCallback())
+	{
+		F32 decode_time = decode_timer.getElapsedTimeF32();
 
+		if (gMessageSystem->getTimingCallback())
 		{
-			LL_RECORD_BLOCK_TIME(FTM_PROCESS_MESSAGES);
-			if( !mCurrentRMessageTemplate->callHandlerFunc(gMessageSystem) )
-			{
-				LL_WARNS() << "Message from " << sender << " with no handler function received: " << mCurrentRMessageTemplate->mName << LL_ENDL;
-			}
+			(gMessageSystem->getTimingCallback())(mCurrentRMessageTemplate->mName,
+							decode_time,
+							gMessageSystem->getTimingCallbackData());
 		}
 
-		if(LLMessageReader::getTimeDecodes() || gMessageSystem->getTimingCallback())
+		if (LLMessageReader::getTimeDecodes())
 		{
-			F32 decode_time = decode_timer.getElapsedTimeF32();
+			mCurrentRMessageTemplate->mDecodeTimeThisFrame += decode_time;
 
-			if (gMessageSystem->getTimingCallback())
-			{
-				(gMessageSystem->getTimingCallback())(mCurrentRMessageTemplate->mName,
-								decode_time,
-								gMessageSystem->getTimingCallbackData());
-			}
+			mCurrentRMessageTemplate->mTotalDecoded++;
+			mCurrentRMessageTemplate->mTotalDecodeTime += decode_time;
 
-			if (LLMessageReader::getTimeDecodes())
+			if( mCurrentRMessageTemplate->mMaxDecodeTimePerMsg < decode_time )
 			{
-				mCurrentRMessageTemplate->mDecodeTimeThisFrame += decode_time;
-
-				mCurrentRMessageTemplate->mTotalDecoded++;
-				mCurrentRMessageTemplate->mTotalDecodeTime += decode_time;
-
-				if( mCurrentRMessageTemplate->mMaxDecodeTimePerMsg < decode_time )
-				{
-					mCurrentRMessageTemplate->mMaxDecodeTimePerMsg = decode_time;
-				}
+				mCurrentRMessageTemplate->mMaxDecodeTimePerMsg = decode_time;
+			}
 
 
-				if(decode_time > LLMessageReader::getTimeDecodesSpamThreshold())
-				{
-					LL_DEBUGS() << "--------- Message " << mCurrentRMessageTemplate->mName << " decode took " << decode_time << " seconds. (" <<
-						mCurrentRMessageTemplate->mMaxDecodeTimePerMsg << " max, " <<
-						(mCurrentRMessageTemplate->mTotalDecodeTime / mCurrentRMessageTemplate->mTotalDecoded) << " avg)" << LL_ENDL;
-				}
+			if(decode_time > LLMessageReader::getTimeDecodesSpamThreshold())
+			{
+				LL_DEBUGS() << "--------- Message " << mCurrentRMessageTemplate->mName << " decode took " << decode_time << " seconds. (" <<
+					mCurrentRMessageTemplate->mMaxDecodeTimePerMsg << " max, " <<
+					(mCurrentRMessageTemplate->mTotalDecodeTime / mCurrentRMessageTemplate->mTotalDecoded) << " avg)" << LL_ENDL;
 			}
 		}
 	}
-	return TRUE;
+}
+
+void LLTemplateMessageReader::noteRanOffEndOfPacket(const S32 where, const S32 wanted)
+{
+	if (mCurrentRMessageData.mOverrunPos < 0)
+	{
+		mCurrentRMessageData.mOverrunPos = where;
+		mCurrentRMessageData.mOverrunWanted = wanted;
+	}
 }
 
 BOOL LLTemplateMessageReader::validateMessage(const U8* buffer, 
@@ -771,7 +762,23 @@ BOOL LLTemplateMessageReader::validateMessage(const U8* buffer,
 {
 	mReceiveSize = buffer_size;
 	BOOL valid = decodeTemplate(buffer, buffer_size, &mCurrentRMessageTemplate, custom );
-	if(valid && !custom)
+	return valid && validateTemplate(sender, trusted, custom);
+}
+
+BOOL LLTemplateMessageReader::validateDecoded(LLMessageTemplate* msg_template,
+											  S32 buffer_size,
+											  const LLHost& sender,
+											  bool trusted)
+{
+	mReceiveSize = buffer_size;
+	mCurrentRMessageTemplate = msg_template;
+	return msg_template && validateTemplate(sender, trusted, FALSE);
+}
+
+BOOL LLTemplateMessageReader::validateTemplate(const LLHost& sender, bool trusted, BOOL custom)
+{
+	BOOL valid = TRUE;
+	if(!custom)
 	{
 		mCurrentRMessageTemplate->mReceiveCount++;
 		//LL_DEBUGS() << "MessageRecvd:"
@@ -806,6 +813,46 @@ BOOL LLTemplateMessageReader::readMessage(const U8* buffer,
 	return decodeData(buffer, sender);
 }
 
+BOOL LLTemplateMessageReader::readDecoded(LLMsgReadData& data, const LLHost& sender)
+{
+	llassert( !mCurrentRMessageData.isValid() );
+	mCurrentRMessageData.swap(data);
+	data.clear();
+	if (!mCurrentRMessageData.isValid())
+	{
+		return FALSE;
+	}
+
+	if (mCurrentRMessageData.mOverrunPos >= 0)
+	{
+		logRanOffEndOfPacket(sender, mCurrentRMessageData.mOverrunPos, mCurrentRMessageData.mOverrunWanted);
+	}
+	dispatchData(sender);
+	return TRUE;
+}
+
+LLMessageTemplate* LLTemplateMessageReader::predecode(const U8* buffer, S32 buffer_size,
+													   const LLHost& sender, LLMsgReadData& data)
+{
+	clearMessage();
+	data.clear();
+
+	mReceiveSize = buffer_size;
+	if (!decodeTemplate(buffer, buffer_size, &mCurrentRMessageTemplate))
+	{
+		return nullptr;
+	}
+
+	LLMessageTemplate* msg_template = mCurrentRMessageTemplate;
+	// custom keeps this from logging through gMessageSystem
+	if (buildData(buffer, sender, TRUE))
+	{
+		mCurrentRMessageData.swap(data);
+	}
+	clearMessage();
+	return msg_template;
+}
+
 //virtual 
 const char* LLTemplateMessageReader::getMessageName() const
 {
@@ -840,7 +887,9 @@ void LLTemplateMessageReader::copyToBuilder(LLMessageBuilder& builder) const
     {
         return;
     }
-	builder.copyFromMessageData(*mCurrentRMessageData);
+	LLMsgData data(mCurrentRMessageTemplate->mName);
+	mCurrentRMessageData.copyTo(data);
+	builder.copyFromMessageData(data);
 }
 
 LLMessageTemplate* LLTemplateMessageReader::getTemplate()
@@ -28,9 +28,7 @@
 #define LL_LLTEMPLATEMESSAGEREADER_H
 
 #include "llmessagereader.h"
-
-class LLMessageTemplate;
-class LLMsgData;
+#include "llmessagetemplate.h"
 
 class LLTemplateMessageReader : public LLMessageReader
 {
@@ -100,11 +98,28 @@ public:
 						 const LLHost& sender, bool trusted = false, BOOL custom = FALSE);
 	BOOL readMessage(const U8* buffer, const LLHost& sender);
 
+	// Counterparts of validateMessage() and readMessage() for messages
+	// decoded ahead of time by predecode().  readDecoded() swaps data in,
+	// leaving the previous message's storage behind in it for reuse.
+	BOOL validateDecoded(LLMessageTemplate* msg_template, S32 buffer_size,
+						 const LLHost& sender, bool trusted = false);
+	BOOL readDecoded(LLMsgReadData& data, const LLHost& sender);
+
+	// Looks up the template and decodes the body of a message without
+	// dispatching it or touching any message system state, so it may be
+	// called off the main thread on a reader of its own.  Returns NULL if
+	// the message isn't registered.  data is left invalid if the body
+	// couldn't be decoded.
+	LLMessageTemplate* predecode(const U8* buffer, S32 buffer_size, const LLHost& sender,
+								 LLMsgReadData& data);
+
 	bool isTrusted() const;
 	bool isBanned(bool trusted_source) const;
 	bool isUdpBanned() const;
 
 	BOOL decodeData(const U8* buffer, const LLHost& sender, BOOL custom = FALSE);
+	BOOL buildData(const U8* buffer, const LLHost& sender, BOOL custom = FALSE);
+	void dispatchData(const LLHost& sender);
 	LLMessageTemplate* getTemplate();
 
 //private:
@@ -115,11 +130,14 @@ public:
 	BOOL decodeTemplate(const U8* buffer, S32 buffer_size,  // inputs
 						LLMessageTemplate** msg_template, BOOL custom = FALSE);	// outputs
 
+	BOOL validateTemplate(const LLHost& sender, bool trusted, BOOL custom);
+
 	void logRanOffEndOfPacket( const LLHost& host, const S32 where, const S32 wanted );
+	void noteRanOffEndOfPacket(const S32 where, const S32 wanted);
 
 	S32	mReceiveSize;
 	LLMessageTemplate* mCurrentRMessageTemplate;
-	LLMsgData* mCurrentRMessageData;
+	LLMsgReadData mCurrentRMessageData;
 	message_template_number_map_t& mMessageNumbers;
 };
 
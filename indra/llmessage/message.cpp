@@ -53,6 +53,7 @@
 #include "llmd5.h"
 #include "llmessagebuilder.h"
 #include "llmessageconfig.h"
+#include "llmessagedecodethread.h"
 #include "lltemplatemessagedispatcher.h"
 #include "llpumpio.h"
 #include "lltemplatemessagebuilder.h"
@@ -153,6 +154,7 @@ void LLMessageSystem::init()
 	mbError = FALSE;
 	mErrorCode = 0;
 	mSendReliable = FALSE;
+	mDecodeThread = nullptr;
 
 	mUnackedListDepth = 0;
 	mUnackedListSize = 0;
@@ -319,6 +321,9 @@ void LLMessageSystem::loadTemplateFile(const std::string& filename, bool failure
 
 LLMessageSystem::~LLMessageSystem()
 {
+	// Uses the templates and the socket
+	stopDecodeThread();
+
 	mMessageTemplates.clear(); // don't delete templates.
 	for_each(mMessageNumbers.begin(), mMessageNumbers.end(), DeletePairedPointer());
 	mMessageNumbers.clear();
@@ -380,6 +385,37 @@ BOOL LLMessageSystem::poll(F32 seconds)
 	}
 }
 
+void LLMessageSystem::startDecodeThread()
+{
+	if (mDecodeThread || mbError)
+	{
+		return;
+	}
+	mDecodeThread = new LLMessageDecodeThread(mSocket, mPacketRing, mMessageNumbers);
+	mDecodeThread->start();
+	LL_INFOS("Messaging") << "Receiving and decoding messages on a thread of their own" << LL_ENDL;
+}
+
+void LLMessageSystem::stopDecodeThread()
+{
+	// Whatever it had decoded goes with it, as if lost on the wire
+	delete mDecodeThread;
+	mDecodeThread = nullptr;
+}
+
+void LLMessageSystem::releaseDecodedPacket(LLDecodedPacket* packetp)
+{
+	if (mDecodeThread)
+	{
+		mDecodeThread->releasePacket(packetp);
+	}
+	else
+	{
+		// A handler stopped the thread under us
+		delete packetp;
+	}
+}
+
 bool LLMessageSystem::isTrustedSender(const LLHost& host) const
 {
 	LLCircuitData* cdp = mCircuitInfo.findCircuit(host);
@@ -500,8 +536,14 @@ BOOL LLMessageSystem::checkMessages( S64 frame_count, bool faked_message, U8 fak
 	// loop until either no packets or a valid packet
 	// i.e., burn through packets from unregistered circuits
 	S32 receive_size = 0;
+	LLDecodedPacket* packetp = nullptr;		// set when it came from mDecodeThread
 	do
 	{
+		if (packetp)
+		{
+			releaseDecodedPacket(packetp);
+			packetp = nullptr;
+		}
 		clearReceiveState();
 		
 		BOOL recv_reliable = FALSE;
@@ -511,7 +553,20 @@ BOOL LLMessageSystem::checkMessages( S64 frame_count, bool faked_message, U8 fak
 
 		U8* buffer = mTrueReceiveBuffer;
 
-		if(!faked_message)
+		if(!faked_message && mDecodeThread)
+		{
+			packetp = mDecodeThread->popPacket();
+			mTrueReceiveSize = 0;
+			if (packetp)
+			{
+				buffer = packetp->mTrueBuffer;
+				mTrueReceiveSize = packetp->mTrueSize;
+				mLastSender = packetp->mSender;
+				mLastReceivingIF = packetp->mReceivingIF;
+			}
+			receive_size = mTrueReceiveSize;
+		}
+		else if(!faked_message)
 		{
 		
 			mTrueReceiveSize = mPacketRing.receivePacket(mSocket, (char *)mTrueReceiveBuffer);
@@ -576,7 +631,29 @@ BOOL LLMessageSystem::checkMessages( S64 frame_count, bool faked_message, U8 fak
 			}
 
 			// process the message as normal
-			mIncomingCompressedSize = zeroCodeExpand(&buffer, &receive_size);
+			if (packetp)
+			{
+				// Already expanded, just keep the books like zeroCodeExpand()
+				mTotalBytesIn += receive_size;
+				mIncomingCompressedSize = packetp->mCompressedSize;
+				if (mIncomingCompressedSize)
+				{
+					mCompressedPacketsIn++;
+					mCompressedBytesIn += receive_size;
+					mUncompressedBytesIn += packetp->mSize;
+					buffer = packetp->mExpandedBuffer;
+					if (packetp->mExpandOverflows)
+					{
+						LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size" << LL_ENDL;
+						callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
+					}
+				}
+				receive_size = packetp->mSize;
+			}
+			else
+			{
+				mIncomingCompressedSize = zeroCodeExpand(&buffer, &receive_size);
+			}
 			U32 cur_rec_pkt_id = 0U;
 			memcpy(&cur_rec_pkt_id, buffer + PHL_PACKET_ID, sizeof(cur_rec_pkt_id));
 			mCurrentRecvPacketID = ntohl(cur_rec_pkt_id);
@@ -662,11 +739,22 @@ BOOL LLMessageSystem::checkMessages( S64 frame_count, bool faked_message, U8 fak
 			// But we don't want to acknowledge UseCircuitCode until the circuit is
 			// available, which is why the acknowledgement test is done above.  JC
 			bool trusted = cdp && cdp->getTrusted();
-			valid_packet = mTemplateMessageReader->validateMessage(
-				buffer,
-				receive_size,
-				host,
-				trusted);
+			if (packetp)
+			{
+				valid_packet = mTemplateMessageReader->validateDecoded(
+					packetp->mTemplate,
+					receive_size,
+					host,
+					trusted);
+			}
+			else
+			{
+				valid_packet = mTemplateMessageReader->validateMessage(
+					buffer,
+					receive_size,
+					host,
+					trusted);
+			}
 			if (!valid_packet)
 			{
 				clearReceiveState();
@@ -701,7 +789,14 @@ BOOL LLMessageSystem::checkMessages( S64 frame_count, bool faked_message, U8 fak
 			if( valid_packet )
 			{
 				logValidMsg(cdp, host, recv_reliable, recv_resent, (BOOL)(acks>0) );
-				valid_packet = mTemplateMessageReader->readMessage(buffer, host);
+				if (packetp)
+				{
+					valid_packet = mTemplateMessageReader->readDecoded(packetp->mData, host);
+				}
+				else
+				{
+					valid_packet = mTemplateMessageReader->readMessage(buffer, host);
+				}
 			}
 
 			// It's possible that the circuit went away, because ANY message can disable the circuit
@@ -740,6 +835,11 @@ BOOL LLMessageSystem::checkMessages( S64 frame_count, bool faked_message, U8 fak
 		}
 	} while (!valid_packet && receive_size > 0);
 
+	if (packetp)
+	{
+		releaseDecodedPacket(packetp);
+	}
+
 	F64Seconds mt_sec = getMessageTimeSeconds();
 	// Check to see if we need to print debug info
 	if ((mt_sec - mCircuitPrintTime) > mCircuitPrintFreq)
@@ -791,6 +891,10 @@ void LLMessageSystem::processAcks(F32 collect_time)
 		// Check the status of circuits
 		mCircuitInfo.updateWatchDogTimers(this);
 
+		// Resends and acks for every circuit go out together, let the
+		// socket layer hand them to the kernel in as few calls as it can
+		begin_send_batch();
+
 		//resend any necessary packets
 		mCircuitInfo.resendUnackedPackets(mUnackedListDepth, mUnackedListSize);
 
@@ -807,6 +911,8 @@ void LLMessageSystem::processAcks(F32 collect_time)
 			mDenyTrustedCircuitSet.clear();
 		}
 
+		flush_send_batch();
+
 		if (mMaxMessageCounts >= 0)
 		{
 			if (mNumMessageCounts >= mMaxMessageCounts)
@@ -2893,10 +2999,27 @@ S32 LLMessageSystem::zeroCodeExpand(U8** data, S32* data_size)
 	
 	*data[0] &= (~LL_ZERO_CODE_FLAG);
 
-	S32 count = (*data_size);  
+	S32 overflows = 0;
+	*data_size = zeroCodeExpandBuffer(*data, in_size, mEncodedRecvBuffer, overflows);
+	*data = mEncodedRecvBuffer;
+	mUncompressedBytesIn += *data_size;
+
+	if (overflows)
+	{
+		LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size" << LL_ENDL;
+		callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
+	}
+
+	return(in_size);
+}
+
+// static
+S32 LLMessageSystem::zeroCodeExpandBuffer(const U8* in, S32 in_size, U8* out, S32& overflows)
+{
+	S32 count = in_size;  
 	
-	U8 *inptr = (U8 *)*data;
-	U8 *outptr = (U8 *)mEncodedRecvBuffer;
+	const U8 *inptr = in;
+	U8 *outptr = out;
 
 // skip the packet id field
 
@@ -2905,6 +3028,7 @@ S32 LLMessageSystem::zeroCodeExpand(U8** data, S32* data_size)
 		count--;
 		*outptr++ = *inptr++;
 	}
+	out[0] &= (~LL_ZERO_CODE_FLAG);
 
 // reconstruct encoded packet, keeping track of net size gain
 
@@ -2913,11 +3037,10 @@ S32 LLMessageSystem::zeroCodeExpand(U8** data, S32* data_size)
 
 	while (count--)
 	{
-		if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-1]))
+		if (outptr > (&out[MAX_BUFFER_SIZE-1]))
 		{
-			LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 1" << LL_ENDL;
-			callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-			outptr = mEncodedRecvBuffer;					
+			overflows++;
+			outptr = out;					
 			break;
 		}
 		if (!((*outptr++ = *inptr++)))
@@ -2925,11 +3048,10 @@ S32 LLMessageSystem::zeroCodeExpand(U8** data, S32* data_size)
 			while (((count--)) && (!(*inptr)))
 			{
 				*outptr++ = *inptr++;
-  				if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-256]))
+  				if (outptr > (&out[MAX_BUFFER_SIZE-256]))
   				{
-  					LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 2" << LL_ENDL;
-					callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-					outptr = mEncodedRecvBuffer;
+					overflows++;
+					outptr = out;
 					count = -1;
 					break;
   				}
@@ -2944,11 +3066,10 @@ S32 LLMessageSystem::zeroCodeExpand(U8** data, S32* data_size)
 
 			else
 			{
-  				if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-(*inptr)]))
+  				if (outptr > (&out[MAX_BUFFER_SIZE-(*inptr)]))
 				{
-  					LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 3" << LL_ENDL;
-					callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-					outptr = mEncodedRecvBuffer;					
+					overflows++;
+					outptr = out;					
 				}
 				memset(outptr,0,(*inptr) - 1);
 				outptr += ((*inptr) - 1);
@@ -2957,11 +3078,7 @@ S32 LLMessageSystem::zeroCodeExpand(U8** data, S32* data_size)
 		}		
 	}
 	
-	*data = mEncodedRecvBuffer;
-	*data_size = (S32)(outptr - mEncodedRecvBuffer);
-	mUncompressedBytesIn += *data_size;
-
-	return(in_size);
+	return (S32)(outptr - out);
 }
 
 
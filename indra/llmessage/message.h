@@ -179,6 +179,8 @@ class LLMsgBlkData;
 class LLMessageTemplate;
 
 class LLMessagePollInfo;
+class LLMessageDecodeThread;
+class LLDecodedPacket;
 class LLMessageBuilder;
 class LLTemplateMessageBuilder;
 class LLSDMessageBuilder;
@@ -332,6 +334,14 @@ public:
 	bool addCircuitCode(U32 code, const LLUUID& session_id);
 
 	BOOL	poll(F32 seconds); // Number of seconds that we want to block waiting for data, returns if data was received
+
+	// While running, a thread of its own receives and decodes incoming
+	// packets and checkMessages() picks them up from there.  poll() no
+	// longer means anything then.
+	void	startDecodeThread();
+	void	stopDecodeThread();
+	bool	isDecodeThreadRunning() const		{ return mDecodeThread != nullptr; }
+
 	BOOL	checkMessages( S64 frame_count = 0, bool faked_message = false, U8 fake_buffer[MAX_BUFFER_SIZE] = nullptr, LLHost fake_host = LLHost(), S32 fake_size = 0 );
 	void	processAcks(F32 collect_time = 0.f);
 
@@ -453,6 +463,11 @@ public:
 
 	S32     zeroCode(U8 **data, S32 *data_size);
 	S32		zeroCodeExpand(U8 **data, S32 *data_size);
+	// Expands a zero coded packet of in_size bytes into out, which must
+	// hold MAX_BUFFER_SIZE.  Touches nothing else, so it's safe off the
+	// main thread.  Returns the expanded size; overflows counts the times
+	// the output would have run past the end.
+	static S32 zeroCodeExpandBuffer(const U8* in, S32 in_size, U8* out, S32& overflows);
 	S32		zeroCodeAdjustCurrentSendTotal();
 
 	// Uses ping-based retry
@@ -762,6 +777,7 @@ private:
 	void		logTrustedMsgFromUntrustedCircuit( const LLHost& sender );
 	void		logValidMsg(LLCircuitData *cdp, const LLHost& sender, BOOL recv_reliable, BOOL recv_resent, BOOL recv_acks );
 	void		logRanOffEndOfPacket( const LLHost& sender );
+	void		releaseDecodedPacket(LLDecodedPacket* packetp);
 
 	struct LLMessageCountInfo
 	{
@@ -771,6 +787,7 @@ private:
 	};
 
 	LLMessagePollInfo						*mPollInfop;
+	LLMessageDecodeThread					*mDecodeThread;
 
 	U8	mEncodedRecvBuffer[MAX_BUFFER_SIZE];
 	U8	mTrueReceiveBuffer[MAX_BUFFER_SIZE];
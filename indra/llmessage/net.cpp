@@ -176,6 +176,19 @@ U32 ip_string_to_u32(const char* ip_string)
 }
 
 
+#if !LL_LINUX
+// No batched sends here, send_packet() always goes straight out
+void begin_send_batch()
+{
+}
+
+S32 flush_send_batch()
+{
+	return 0;
+}
+#endif
+
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // Windows Versions
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -516,8 +529,16 @@ S32 start_net(S32& socket_out, int& nPort)
 	return 0;
 }
 
+#if LL_LINUX
+static void reset_receive_batch();
+#endif
+
 void end_net(S32& socket_out)
 {
+#if LL_LINUX
+	// Read-ahead datagrams belong to the socket going away
+	reset_receive_batch();
+#endif
 	if (socket_out >= 0)
 	{
 		close(socket_out);
@@ -567,6 +588,76 @@ static int recvfrom_destip( int socket, void *buf, int len, struct sockaddr *fro
 
 	return size;
 }
+
+// Busy regions deliver hundreds of datagrams a frame and the viewer
+// drains them one receive_packet() at a time.  Rather than a system
+// call each, recvmmsg() reads ahead up to RECEIVE_BATCH_SIZE of them
+// into a ring of buffers and the following calls are served from
+// there until it's empty.
+const int RECEIVE_BATCH_SIZE = 32;
+
+static char sReceiveBuffers[RECEIVE_BATCH_SIZE][NET_BUFFER_SIZE];
+static struct sockaddr_in sReceiveFrom[RECEIVE_BATCH_SIZE];
+static U32 sReceiveDstIP[RECEIVE_BATCH_SIZE];
+static int sReceiveSize[RECEIVE_BATCH_SIZE];
+static int sReceiveCount = 0;				// Datagrams in the ring
+static int sReceiveNext = 0;				// Next one to hand out
+static int sReceiveSocket = -1;
+static bool sReceiveBatched = true;			// Off if the kernel lacks recvmmsg()
+
+static void reset_receive_batch()
+{
+	sReceiveCount = sReceiveNext = 0;
+	sReceiveSocket = -1;
+}
+
+// Fills the ring, returns the count of datagrams read or -1 on error
+static int recvmmsg_destip(int socket)
+{
+	static struct mmsghdr msgs[RECEIVE_BATCH_SIZE];
+	static struct iovec iovs[RECEIVE_BATCH_SIZE];
+	static char cmsgs[RECEIVE_BATCH_SIZE][CMSG_SPACE(sizeof(struct in_pktinfo))];
+
+	for (int i = 0; i < RECEIVE_BATCH_SIZE; ++i)
+	{
+		iovs[i].iov_base = sReceiveBuffers[i];
+		iovs[i].iov_len = NET_BUFFER_SIZE;
+
+		struct msghdr &msg = msgs[i].msg_hdr;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name = &sReceiveFrom[i];
+		msg.msg_namelen = sizeof(sReceiveFrom[i]);
+		msg.msg_iov = &iovs[i];
+		msg.msg_iovlen = 1;
+		msg.msg_control = cmsgs[i];
+		msg.msg_controllen = sizeof(cmsgs[i]);
+		msgs[i].msg_len = 0;
+	}
+
+	int count = recvmmsg(socket, msgs, RECEIVE_BATCH_SIZE, 0, NULL);
+	if (count <= 0)
+	{
+		return count;
+	}
+
+	for (int i = 0; i < count; ++i)
+	{
+		sReceiveSize[i] = msgs[i].msg_len;
+		sReceiveDstIP[i] = INVALID_HOST_IP_ADDRESS;
+
+		struct msghdr &msg = msgs[i].msg_hdr;
+		for (struct cmsghdr *cmsgptr = CMSG_FIRSTHDR(&msg); cmsgptr != NULL; cmsgptr = CMSG_NXTHDR(&msg, cmsgptr))
+		{
+			if (cmsgptr->cmsg_level == SOL_IP && cmsgptr->cmsg_type == IP_PKTINFO)
+			{
+				// Specified rather than routed address, see recvfrom_destip()
+				in_pktinfo *pktinfo = (in_pktinfo *)CMSG_DATA(cmsgptr);
+				sReceiveDstIP[i] = pktinfo->ipi_spec_dst.s_addr;
+			}
+		}
+	}
+	return count;
+}
 #endif
 
 int receive_packet(int hSocket, char * receiveBuffer)
@@ -581,6 +672,33 @@ int receive_packet(int hSocket, char * receiveBuffer)
 	gsnReceivingIFAddr = INVALID_HOST_IP_ADDRESS;
 
 #if LL_LINUX
+	if (sReceiveBatched)
+	{
+		if (sReceiveNext >= sReceiveCount || sReceiveSocket != hSocket)
+		{
+			reset_receive_batch();
+			nRet = recvmmsg_destip(hSocket);
+			if (nRet == -1 && errno == ENOSYS)
+			{
+				LL_INFOS() << "recvmmsg() not available, receiving one datagram at a time" << LL_ENDL;
+				sReceiveBatched = false;
+				return receive_packet(hSocket, receiveBuffer);
+			}
+			if (nRet <= 0)
+			{
+				return 0;
+			}
+			sReceiveCount = nRet;
+			sReceiveSocket = hSocket;
+		}
+
+		const int slot = sReceiveNext++;
+		nRet = sReceiveSize[slot];
+		memcpy(receiveBuffer, sReceiveBuffers[slot], nRet);		/* Flawfinder: ignore */
+		stSrcAddr = sReceiveFrom[slot];
+		gsnReceivingIFAddr = sReceiveDstIP[slot];
+		return nRet;
+	}
 	nRet = recvfrom_destip(hSocket, receiveBuffer, NET_BUFFER_SIZE, (struct sockaddr*)&stSrcAddr, &addr_size, &gsnReceivingIFAddr);
 #else	
 	int recv_flags = 0;
@@ -599,19 +717,138 @@ int receive_packet(int hSocket, char * receiveBuffer)
 	return nRet;
 }
 
+static BOOL send_one_packet(int hSocket, const char * sendBuffer, int size, const struct sockaddr_in &to);
+
+#if LL_LINUX
+// Sends queued by send_packet() while batching, written out by
+// flush_send_batch() with sendmmsg().  Resends and acks for every
+// circuit come out of LLMessageSystem::processAcks() together, which
+// is where this pays.  Datagrams are rarely bigger than the MTU; ones
+// that are go out on their own.
+const int SEND_BATCH_SIZE = 64;
+const int SEND_BATCH_BUFFER_SIZE = 2 * ETHERNET_MTU_BYTES;
+
+static char sSendBuffers[SEND_BATCH_SIZE][SEND_BATCH_BUFFER_SIZE];
+static struct sockaddr_in sSendTo[SEND_BATCH_SIZE];
+static int sSendSize[SEND_BATCH_SIZE];
+static int sSendCount = 0;
+static int sSendSocket = -1;
+static bool sSendBatching = false;
+static bool sSendBatched = true;			// Off if the kernel lacks sendmmsg()
+
+void begin_send_batch()
+{
+	sSendBatching = sSendBatched;
+}
+
+S32 flush_send_batch()
+{
+	sSendBatching = false;
+	if (!sSendCount)
+	{
+		return 0;
+	}
+
+	static struct mmsghdr msgs[SEND_BATCH_SIZE];
+	static struct iovec iovs[SEND_BATCH_SIZE];
+	for (int i = 0; i < sSendCount; ++i)
+	{
+		iovs[i].iov_base = sSendBuffers[i];
+		iovs[i].iov_len = sSendSize[i];
+
+		struct msghdr &msg = msgs[i].msg_hdr;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name = &sSendTo[i];
+		msg.msg_namelen = sizeof(sSendTo[i]);
+		msg.msg_iov = &iovs[i];
+		msg.msg_iovlen = 1;
+		msgs[i].msg_len = 0;
+	}
+
+	// Same retry policy as send_packet(), applied to whichever
+	// datagram the kernel stopped at.
+	int sent = 0;
+	S32 send_attempts = 0;
+	while (sent < sSendCount)
+	{
+		int ret = sendmmsg(sSendSocket, msgs + sent, sSendCount - sent, 0);
+		if (ret > 0)
+		{
+			sent += ret;
+			send_attempts = 0;
+			continue;
+		}
+
+		if (errno == ENOSYS)
+		{
+			LL_INFOS() << "sendmmsg() not available, sending one datagram at a time" << LL_ENDL;
+			sSendBatched = false;
+			for (; sent < sSendCount; ++sent)
+			{
+				send_one_packet(sSendSocket, sSendBuffers[sent], sSendSize[sent], sSendTo[sent]);
+			}
+			break;
+		}
+
+		if ((errno == EAGAIN || errno == ECONNREFUSED) && ++send_attempts < 3)
+		{
+			LL_INFOS() << "sendmmsg() reported " << (errno == EAGAIN ? "buffer full" : "connection refused")
+					   << ", resending (attempt " << send_attempts << ")" << LL_ENDL;
+			LL_INFOS() << inet_ntoa(sSendTo[sent].sin_addr) << ":" << ntohs(sSendTo[sent].sin_port) << LL_ENDL;
+			continue;
+		}
+
+		// Give up on this one and carry on with the rest
+		LL_INFOS() << "sendmmsg() failed: " << errno << ", " << strerror(errno) << LL_ENDL;
+		LL_INFOS() << inet_ntoa(sSendTo[sent].sin_addr) << ":" << ntohs(sSendTo[sent].sin_port) << LL_ENDL;
+		++sent;
+		send_attempts = 0;
+	}
+
+	const S32 count = sSendCount;
+	sSendCount = 0;
+	sSendSocket = -1;
+	return count;
+}
+#endif
+
 BOOL send_packet(int hSocket, const char * sendBuffer, int size, U32 recipient, int nPort)
+{
+	stDstAddr.sin_addr.s_addr = recipient;
+	stDstAddr.sin_port = htons(nPort);
+
+#if LL_LINUX
+	if (sSendBatching && size <= SEND_BATCH_BUFFER_SIZE)
+	{
+		if (sSendCount == SEND_BATCH_SIZE || (sSendCount && sSendSocket != hSocket))
+		{
+			// Write out what's queued and keep batching
+			flush_send_batch();
+			sSendBatching = true;
+		}
+		memcpy(sSendBuffers[sSendCount], sendBuffer, size);		/* Flawfinder: ignore */
+		sSendTo[sSendCount] = stDstAddr;
+		sSendSize[sSendCount] = size;
+		sSendSocket = hSocket;
+		++sSendCount;
+		return TRUE;
+	}
+#endif
+
+	return send_one_packet(hSocket, sendBuffer, size, stDstAddr);
+}
+
+static BOOL send_one_packet(int hSocket, const char * sendBuffer, int size, const struct sockaddr_in &to)
 {
 	int		ret;
 	BOOL	success;
 	BOOL	resend;
 	S32		send_attempts = 0;
-
-	stDstAddr.sin_addr.s_addr = recipient;
-	stDstAddr.sin_port = htons(nPort);
+	const int nPort = ntohs(to.sin_port);
 
 	do
 	{
-		ret = sendto(hSocket, sendBuffer, size, 0,	(struct sockaddr*)&stDstAddr, sizeof(stDstAddr));
+		ret = sendto(hSocket, sendBuffer, size, 0,	(const struct sockaddr*)&to, sizeof(to));
 		send_attempts++;
 
 		if (ret >= 0)
@@ -629,21 +866,21 @@ BOOL send_packet(int hSocket, const char * sendBuffer, int size, U32 recipient,
 			{
 				// say nothing, just repeat send
 				LL_INFOS() << "sendto() reported buffer full, resending (attempt " << send_attempts << ")" << LL_ENDL;
-				LL_INFOS() << inet_ntoa(stDstAddr.sin_addr) << ":" << nPort << LL_ENDL;
+				LL_INFOS() << inet_ntoa(to.sin_addr) << ":" << nPort << LL_ENDL;
 				resend = TRUE;
 			}
 			else if (errno == ECONNREFUSED)
 			{
 				// response to ICMP connection refused message on earlier send
 				LL_INFOS() << "sendto() reported connection refused, resending (attempt " << send_attempts << ")" << LL_ENDL;
-				LL_INFOS() << inet_ntoa(stDstAddr.sin_addr) << ":" << nPort << LL_ENDL;
+				LL_INFOS() << inet_ntoa(to.sin_addr) << ":" << nPort << LL_ENDL;
 				resend = TRUE;
 			}
 			else
 			{
 				// some other error
 				LL_INFOS() << "sendto() failed: " << errno << ", " << strerror(errno) << LL_ENDL;
-				LL_INFOS() << inet_ntoa(stDstAddr.sin_addr) << ":" << nPort << LL_ENDL;
+				LL_INFOS() << inet_ntoa(to.sin_addr) << ":" << nPort << LL_ENDL;
 				resend = FALSE;
 			}
 		}
@@ -45,6 +45,13 @@ S32		receive_packet(int hSocket, char * receiveBuffer);
 
 BOOL	send_packet(int hSocket, const char *sendBuffer, int size, U32 recipient, int nPort);	// Returns TRUE on success.
 
+// Between these, send_packet() queues datagrams and reports success, and
+// flush_send_batch() puts them all on the wire with as few system calls
+// as the platform allows (sendmmsg() on Linux, otherwise no batching).
+// Returns the count of datagrams sent.
+void	begin_send_batch();
+S32		flush_send_batch();
+
 //void	get_sender(char * tmp);
 LLHost	get_sender();
 U32		get_sender_port();
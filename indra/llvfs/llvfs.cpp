@@ -46,6 +46,7 @@
 #include "llapr.h"
 #include "llstl.h"
 #include "lltimer.h"
+#include "llvfslogstore.h"
     
 const S32 FILE_BLOCK_MASK = 0x000003FF;	 // 1024-byte blocks
 const S32 VFS_CLEANUP_SIZE = 5242880;  // how much space we free up in a single stroke
@@ -240,7 +241,8 @@ const S32 LLVFSFileBlock::SERIAL_SIZE = 34;
      
 
 LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename, const BOOL read_only, const U32 presize, const BOOL remove_after_crash)
-:	mDataFP(nullptr),
+:	mLogStore(nullptr),
+	mDataFP(nullptr),
 	mIndexFP(nullptr),
     mRemoveAfterCrash(remove_after_crash)
 {
@@ -567,6 +569,31 @@ LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename
 
 	mValid = VFSVALID_OK;
 }
+
+LLVFS::LLVFS(const std::string& store_dirname, const U32 max_size)
+:	mLogStore(nullptr),
+	mDataFP(nullptr),
+	mIndexFP(nullptr),
+	mReadOnly(FALSE),
+	mValid(VFSVALID_OK),
+	mRemoveAfterCrash(FALSE)
+{
+	mDataMutex = new LLMutex();
+	for (S32 i = 0; i < VFSLOCK_COUNT; i++)
+	{
+		mLockCounts[i] = 0;
+	}
+	mDataFilename = store_dirname;
+
+	LL_INFOS("VFS") << "Attempting to open VFS log store " << store_dirname << LL_ENDL;
+
+	mLogStore = new LLVFSLogStore(store_dirname, max_size);
+	if (!mLogStore->open())
+	{
+		LL_WARNS("VFS") << "Couldn't open VFS log store " << store_dirname << LL_ENDL;
+		mValid = VFSVALID_BAD_CANNOT_CREATE;
+	}
+}
     
 LLVFS::~LLVFS()
 {
@@ -574,6 +601,9 @@ LLVFS::~LLVFS()
 	{
 		LL_ERRS("VFS") << "LLVFS destroyed with mutex locked" << LL_ENDL;
 	}
+
+	delete mLogStore;
+	mLogStore = nullptr;
 	
 	unlockAndClose(mIndexFP);
 	mIndexFP = nullptr;
@@ -642,6 +672,17 @@ LLVFS * LLVFS::createLLVFS(const std::string& index_filename,
 	return new_vfs;
 }
 
+// static
+LLVFS * LLVFS::createLogStructuredVFS(const std::string& store_dirname, const U32 max_size)
+{
+	LLVFS * new_vfs = new LLVFS(store_dirname, max_size);
+	if (!new_vfs->isValid())
+	{
+		delete new_vfs;
+		new_vfs = nullptr;
+	}
+	return new_vfs;
+}
 
 
 void LLVFS::presizeDataFile(const U32 size)
@@ -680,6 +721,11 @@ BOOL LLVFS::getExists(const LLUUID &file_id, const LLAssetType::EType file_type)
 		LL_ERRS() << "Attempting to use invalid VFS!" << LL_ENDL;
 	}
 
+	if (mLogStore)
+	{
+		return mLogStore->getExists(LLVFSFileSpecifier(file_id, file_type));
+	}
+
 	lockData();
 	
 	LLVFSFileSpecifier spec(file_id, file_type);
@@ -707,6 +753,11 @@ S32	 LLVFS::getSize(const LLUUID &file_id, const LLAssetType::EType file_type)
 
 	}
 
+	if (mLogStore)
+	{
+		return mLogStore->getSize(LLVFSFileSpecifier(file_id, file_type));
+	}
+
 	lockData();
 	
 	LLVFSFileSpecifier spec(file_id, file_type);
@@ -733,6 +784,11 @@ S32  LLVFS::getMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type
 		LL_ERRS() << "Attempting to use invalid VFS!" << LL_ENDL;
 	}
 
+	if (mLogStore)
+	{
+		return mLogStore->getMaxSize(LLVFSFileSpecifier(file_id, file_type));
+	}
+
 	lockData();
 	
 	LLVFSFileSpecifier spec(file_id, file_type);
@@ -752,6 +808,11 @@ S32  LLVFS::getMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type
 
 BOOL LLVFS::checkAvailable(S32 max_size)
 {
+	if (mLogStore)
+	{
+		return mLogStore->checkAvailable(max_size);
+	}
+
 	lockData();
 	
 	blocks_length_map_t::iterator iter = mFreeBlocksByLength.lower_bound(max_size); // first entry >= size
@@ -778,16 +839,6 @@ BOOL LLVFS::setMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type
 		return FALSE;
 	}
 
-	lockData();
-	
-	LLVFSFileSpecifier spec(file_id, file_type);
-	LLVFSFileBlock *block = nullptr;
-	fileblock_map::iterator it = mFileBlocks.find(spec);
-	if (it != mFileBlocks.end())
-	{
-		block = (*it).second;
-	}
-    
 	// round all sizes upward to KB increments
 	// SJB: Need to not round for the new texture-pipeline code so we know the correct
 	//      max file size. Need to investigate the potential problems with this...
@@ -799,6 +850,21 @@ BOOL LLVFS::setMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type
 			max_size &= ~FILE_BLOCK_MASK;
 		}
     }
+
+	LLVFSFileSpecifier spec(file_id, file_type);
+	if (mLogStore)
+	{
+		return mLogStore->setMaxSize(spec, max_size);
+	}
+
+	lockData();
+	
+	LLVFSFileBlock *block = nullptr;
+	fileblock_map::iterator it = mFileBlocks.find(spec);
+	if (it != mFileBlocks.end())
+	{
+		block = (*it).second;
+	}
 	
 	if (block && block->mLength > 0)
 	{    
@@ -971,11 +1037,17 @@ void LLVFS::renameFile(const LLUUID &file_id, const LLAssetType::EType file_type
 		LL_ERRS() << "Attempt to write to read-only VFS" << LL_ENDL;
 	}
 
-	lockData();
-	
 	LLVFSFileSpecifier new_spec(new_id, new_type);
 	LLVFSFileSpecifier old_spec(file_id, file_type);
+	if (mLogStore)
+	{
+		mLogStore->renameFile(old_spec, new_spec);
+		return;
+	}
+
+	lockData();
 	
+
 	fileblock_map::iterator it = mFileBlocks.find(old_spec);
 	if (it != mFileBlocks.end())
 	{
@@ -1059,9 +1131,15 @@ void LLVFS::removeFile(const LLUUID &file_id, const LLAssetType::EType file_type
 		LL_ERRS() << "Attempt to write to read-only VFS" << LL_ENDL;
 	}
 
+	LLVFSFileSpecifier spec(file_id, file_type);
+	if (mLogStore)
+	{
+		mLogStore->removeFile(spec);
+		return;
+	}
+
     lockData();
 	
-	LLVFSFileSpecifier spec(file_id, file_type);
 	fileblock_map::iterator it = mFileBlocks.find(spec);
 	if (it != mFileBlocks.end())
 	{
@@ -1088,11 +1166,16 @@ S32 LLVFS::getData(const LLUUID &file_id, const LLAssetType::EType file_type, U8
 	llassert(location >= 0);
 	llassert(length >= 0);
 
+	LLVFSFileSpecifier spec(file_id, file_type);
+	if (mLogStore)
+	{
+		return mLogStore->getData(spec, buffer, location, length);
+	}
+
 	BOOL do_read = FALSE;
 	
     lockData();
 	
-	LLVFSFileSpecifier spec(file_id, file_type);
 	fileblock_map::iterator it = mFileBlocks.find(spec);
 	if (it != mFileBlocks.end())
 	{
@@ -1139,9 +1222,14 @@ S32 LLVFS::storeData(const LLUUID &file_id, const LLAssetType::EType file_type,
     
 	llassert(length > 0);
 
+	LLVFSFileSpecifier spec(file_id, file_type);
+	if (mLogStore)
+	{
+		return mLogStore->storeData(spec, buffer, location, length);
+	}
+
     lockData();
     
-	LLVFSFileSpecifier spec(file_id, file_type);
 	fileblock_map::iterator it = mFileBlocks.find(spec);
 	if (it != mFileBlocks.end())
 	{
@@ -1214,9 +1302,15 @@ S32 LLVFS::storeData(const LLUUID &file_id, const LLAssetType::EType file_type,
  
 void LLVFS::incLock(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock)
 {
+	LLVFSFileSpecifier spec(file_id, file_type);
+	if (mLogStore)
+	{
+		mLogStore->incLock(spec, lock);
+		return;
+	}
+
 	lockData();
 
-	LLVFSFileSpecifier spec(file_id, file_type);
 	LLVFSFileBlock *block;
 	
  	fileblock_map::iterator it = mFileBlocks.find(spec);
@@ -1240,9 +1334,15 @@ void LLVFS::incLock(const LLUUID &file_id, const LLAssetType::EType file_type, E
 
 void LLVFS::decLock(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock)
 {
+	LLVFSFileSpecifier spec(file_id, file_type);
+	if (mLogStore)
+	{
+		mLogStore->decLock(spec, lock);
+		return;
+	}
+
 	lockData();
 
-	LLVFSFileSpecifier spec(file_id, file_type);
  	fileblock_map::iterator it = mFileBlocks.find(spec);
 	if (it != mFileBlocks.end())
 	{
@@ -1264,11 +1364,16 @@ void LLVFS::decLock(const LLUUID &file_id, const LLAssetType::EType file_type, E
 
 BOOL LLVFS::isLocked(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock)
 {
+	LLVFSFileSpecifier spec(file_id, file_type);
+	if (mLogStore)
+	{
+		return mLogStore->isLocked(spec, lock);
+	}
+
 	lockData();
 	
 	BOOL res = FALSE;
 	
-	LLVFSFileSpecifier spec(file_id, file_type);
  	fileblock_map::iterator it = mFileBlocks.find(spec);
 	if (it != mFileBlocks.end())
 	{
@@ -1660,6 +1765,11 @@ void LLVFS::pokeFiles()
 	{
 		LL_ERRS() << "Attempting to use invalid VFS!" << LL_ENDL;
 	}
+	if (mLogStore)
+	{
+		// Segments are read on demand, there is no single file to preload.
+		return;
+	}
 	U32 word;
 	
 	// only write data if we actually read 4 bytes
@@ -1690,6 +1800,12 @@ void LLVFS::pokeFiles()
     
 void LLVFS::dumpMap()
 {
+	if (mLogStore)
+	{
+		mLogStore->dumpStatistics();
+		return;
+	}
+
 	LL_INFOS() << "Files:" << LL_ENDL;
 	for (fileblock_map::iterator it = mFileBlocks.begin(); it != mFileBlocks.end(); ++it)
 	{
@@ -1711,6 +1827,12 @@ void LLVFS::dumpMap()
 // Very slow, do not call routinely. JC
 void LLVFS::audit()
 {
+	if (mLogStore)
+	{
+		mLogStore->audit();
+		return;
+	}
+
 	// Lock the mutex through this whole function.
 	LLMutexLock lock_data(mDataMutex);
 	
@@ -1854,6 +1976,11 @@ void LLVFS::audit()
 // Slow, do not call in release.
 void LLVFS::checkMem()
 {
+	if (mLogStore)
+	{
+		return;
+	}
+
 	lockData();
 	
 	for (fileblock_map::iterator it = mFileBlocks.begin(); it != mFileBlocks.end(); ++it)
@@ -1881,6 +2008,12 @@ void LLVFS::checkMem()
 
 void LLVFS::dumpLockCounts()
 {
+	if (mLogStore)
+	{
+		mLogStore->dumpLockCounts();
+		return;
+	}
+
 	S32 i;
 	for (i = 0; i < VFSLOCK_COUNT; i++)
 	{
@@ -1890,6 +2023,12 @@ void LLVFS::dumpLockCounts()
 
 void LLVFS::dumpStatistics()
 {
+	if (mLogStore)
+	{
+		mLogStore->dumpStatistics();
+		return;
+	}
+
 	lockData();
 	
 	// Investigate file blocks.
@@ -2062,6 +2201,20 @@ std::string get_extension(LLAssetType::EType type)
 
 void LLVFS::listFiles()
 {
+	if (mLogStore)
+	{
+		std::vector<std::pair<LLVFSFileSpecifier, S32> > files;
+		mLogStore->getFileList(files);
+		for (const std::pair<LLVFSFileSpecifier, S32>& file : files)
+		{
+			LL_INFOS() << " File: " << file.first.mFileID
+					<< " Type: " << LLAssetType::getDesc(file.first.mFileType)
+					<< " Size: " << file.second
+					<< LL_ENDL;
+		}
+		return;
+	}
+
 	lockData();
 	
 	for (fileblock_map::iterator it = mFileBlocks.begin(); it != mFileBlocks.end(); ++it)
@@ -2085,6 +2238,32 @@ void LLVFS::listFiles()
 
 std::map<LLVFSFileSpecifier, LLVFSFileBlock*> LLVFS::getFileList()
 {
+	// The segment store has no file blocks of its own: hand out a snapshot of
+	// its index instead, kept in the otherwise unused mFileBlocks so that the
+	// blocks stay valid until the next call.
+	if (mLogStore)
+	{
+		std::vector<std::pair<LLVFSFileSpecifier, S32> > files;
+		mLogStore->getFileList(files);
+
+		lockData();
+		for (fileblock_map::iterator it = mFileBlocks.begin(); it != mFileBlocks.end(); ++it)
+		{
+			delete it->second;
+		}
+		mFileBlocks.clear();
+		for (const std::pair<LLVFSFileSpecifier, S32>& file : files)
+		{
+			LLVFSFileBlock* block = new LLVFSFileBlock(file.first.mFileID, file.first.mFileType, 0, file.second);
+			block->mSize = file.second;
+			mFileBlocks[file.first] = block;
+		}
+		fileblock_map file_list = mFileBlocks;
+		unlockData();
+
+		return file_list;
+	}
+
 	//have to do this so as not to mess with the gods of threading
 	lockData();
 	fileblock_map mFileList = mFileBlocks;
@@ -2095,6 +2274,27 @@ std::map<LLVFSFileSpecifier, LLVFSFileBlock*> LLVFS::getFileList()
 
 void LLVFS::dumpFiles()
 {
+	if (mLogStore)
+	{
+		std::vector<std::pair<LLVFSFileSpecifier, S32> > files;
+		mLogStore->getFileList(files);
+		for (const std::pair<LLVFSFileSpecifier, S32>& file : files)
+		{
+			std::vector<U8> buffer(file.second);
+			S32 size = mLogStore->getData(file.first, &buffer[0], 0, file.second);
+
+			std::string filename = file.first.mFileID.asString() + get_extension(file.first.mFileType);
+			LL_INFOS() << " Writing " << filename << LL_ENDL;
+
+			LLAPRFile outfile;
+			outfile.open(filename, LL_APR_WB);
+			outfile.write(&buffer[0], size);
+			outfile.close();
+		}
+		LL_INFOS() << "Extracted " << files.size() << " files" << LL_ENDL;
+		return;
+	}
+
 	lockData();
 	
 	S32 files_extracted = 0;
@@ -2134,6 +2334,11 @@ void LLVFS::dumpFiles()
 
 time_t LLVFS::creationTime()
 {
+	if (mLogStore)
+	{
+		return mLogStore->creationTime();
+	}
+
     llstat data_file_stat;
     int errors = LLFile::stat(mDataFilename, &data_file_stat);
     if (0 == errors)
@@ -120,6 +120,8 @@ public:
 };
 //<edit>
 
+class LLVFSLogStore;
+
 class LLVFS
 {
 private:
@@ -130,6 +132,8 @@ private:
 			const BOOL read_only, 
 			const U32 presize, 
 			const BOOL remove_after_crash);
+	// Use createLogStructuredVFS() to open a segment store
+	LLVFS(const std::string& store_dirname, const U32 max_size);
 public:
 	~LLVFS();
 
@@ -141,6 +145,11 @@ public:
 			const U32 presize, 
 			const BOOL remove_after_crash);
 
+	// Opens (or creates) an append-only segment store in store_dirname
+	// holding at most max_size bytes.  Always writable, and safe to read
+	// from several threads while another one writes.
+	static LLVFS * createLogStructuredVFS(const std::string& store_dirname, const U32 max_size);
+
 	BOOL isValid() const			{ return (VFSVALID_OK == mValid); }
 	EVFSValid getValidState() const	{ return mValid; }
 
@@ -205,6 +214,10 @@ protected:
 	
 protected:
 	LLMutex* mDataMutex;
+
+	// When set, every file operation is handed to the segment store and
+	// none of the data file members below are used.
+	LLVFSLogStore* mLogStore;
 	
 //<edit>
 public:
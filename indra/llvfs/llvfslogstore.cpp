@@ -0,0 +1,1782 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/**
+ * @file llvfslogstore.cpp
+ * @brief Log-structured segment store backing LLVFS
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#if LL_WINDOWS
+#include "llwin32headerslean.h"
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "linden_common.h"
+
+#include "llvfslogstore.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#include "llcrc.h"
+#include "lldir.h"
+#include "lldiriterator.h"
+#include "llfile.h"
+#include "llstring.h"
+#include "lltimer.h"
+
+// Segment and checkpoint files are only ever read back by the machine that
+// wrote them, so the structures below are stored in native byte order.
+
+static const U32 SEGMENT_MAGIC = 0x534c4656;		// "VFLS"
+static const U32 RECORD_MAGIC = 0x52464c56;			// "VLFR"
+static const U32 CHECKPOINT_MAGIC = 0x58464c56;		// "VLFX"
+static const U32 STORE_VERSION = 1;
+
+static const U32 MAX_SEGMENT_SIZE = 32 * 1024 * 1024;
+static const U32 MIN_SEGMENT_SIZE = 1024 * 1024;
+// Renames racing with the compactor can leave a few files behind per pass
+static const U32 MAX_COMPACTION_PASSES = 4;
+
+static const char SEGMENT_MASK[] = "vfs_*.seg";
+static const char CHECKPOINT_NAME[] = "index.vfx";
+
+enum ERecordKind
+{
+	RECORD_DATA = 1,		// payload: file bytes at mOffset, mAux: max size
+	RECORD_MAXSIZE = 2,		// mAux: new max size, creates the file if needed
+	RECORD_REMOVE = 3,
+	RECORD_RENAME = 4		// payload: new file id, mAux: new file type
+};
+
+struct LLVFSSegmentHeader
+{
+	U32 mMagic;
+	U32 mVersion;
+	U32 mID;
+	U32 mReserved;
+};
+
+struct LLVFSRecordHeader
+{
+	U32 mMagic;
+	U8 mKind;
+	U8 mPad[3];
+	U8 mFileID[UUID_BYTES];
+	S32 mFileType;
+	S32 mOffset;
+	S32 mLength;
+	S32 mAux;
+	U32 mPayloadCRC;
+	U32 mHeaderCRC;		// covers everything above
+};
+
+static const U32 SEGMENT_HEADER_SIZE = sizeof(LLVFSSegmentHeader);
+static const U32 RECORD_HEADER_SIZE = sizeof(LLVFSRecordHeader);
+static_assert(sizeof(LLVFSRecordHeader) == 48, "LLVFSRecordHeader must stay packed");
+
+static U32 compute_crc(const void* data, size_t length)
+{
+	LLCRC crc;
+	crc.update((const U8*)data, length);
+	return crc.getCRC();
+}
+
+static U32 header_crc(const LLVFSRecordHeader& header)
+{
+	return compute_crc(&header, offsetof(LLVFSRecordHeader, mHeaderCRC));
+}
+
+//============================================================================
+// LLVFSSegment
+
+// One append-only segment file.  Reads and writes are positional, so any
+// number of threads may read a segment while the writer appends to it.
+class LLVFSSegment
+{
+public:
+	LLVFSSegment(U32 id, const std::string& filename);
+	~LLVFSSegment();
+
+	bool create();
+	bool openExisting();
+	void close();
+
+	S32 read(U32 offset, void* buffer, S32 length) const;
+	S32 write(U32 offset, const void* buffer, S32 length);
+	bool truncate(U32 size);
+	U32 getFileSize() const;
+
+public:
+	const U32 mID;
+	const std::string mFilename;
+	U32 mSize;			// bytes of valid records, including the header
+	S64 mLiveBytes;		// payload bytes still referenced by the index
+	U32 mSealTime;		// when the store stopped appending to this segment
+
+private:
+#if LL_WINDOWS
+	HANDLE mHandle;
+#else
+	int mFD;
+#endif
+};
+
+LLVFSSegment::LLVFSSegment(U32 id, const std::string& filename)
+:	mID(id),
+	mFilename(filename),
+	mSize(0),
+	mLiveBytes(0),
+	mSealTime(0),
+#if LL_WINDOWS
+	mHandle(INVALID_HANDLE_VALUE)
+#else
+	mFD(-1)
+#endif
+{
+}
+
+LLVFSSegment::~LLVFSSegment()
+{
+	close();
+}
+
+bool LLVFSSegment::create()
+{
+#if LL_WINDOWS
+	llutf16string utf16filename = utf8str_to_utf16str(mFilename);
+	mHandle = CreateFileW((LPCWSTR)utf16filename.c_str(), GENERIC_READ | GENERIC_WRITE,
+						  FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+						  nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (mHandle == INVALID_HANDLE_VALUE)
+#else
+	mFD = ::open(mFilename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (mFD < 0)
+#endif
+	{
+		LL_WARNS("VFS") << "Unable to create VFS segment " << mFilename << LL_ENDL;
+		return false;
+	}
+
+	LLVFSSegmentHeader header;
+	header.mMagic = SEGMENT_MAGIC;
+	header.mVersion = STORE_VERSION;
+	header.mID = mID;
+	header.mReserved = 0;
+	if (write(0, &header, SEGMENT_HEADER_SIZE) != (S32)SEGMENT_HEADER_SIZE)
+	{
+		LL_WARNS("VFS") << "Unable to write VFS segment header " << mFilename << LL_ENDL;
+		close();
+		return false;
+	}
+	mSize = SEGMENT_HEADER_SIZE;
+	return true;
+}
+
+bool LLVFSSegment::openExisting()
+{
+#if LL_WINDOWS
+	llutf16string utf16filename = utf8str_to_utf16str(mFilename);
+	mHandle = CreateFileW((LPCWSTR)utf16filename.c_str(), GENERIC_READ | GENERIC_WRITE,
+						  FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+						  nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (mHandle == INVALID_HANDLE_VALUE)
+#else
+	mFD = ::open(mFilename.c_str(), O_RDWR);
+	if (mFD < 0)
+#endif
+	{
+		LL_WARNS("VFS") << "Unable to open VFS segment " << mFilename << LL_ENDL;
+		return false;
+	}
+
+	LLVFSSegmentHeader header;
+	if (read(0, &header, SEGMENT_HEADER_SIZE) != (S32)SEGMENT_HEADER_SIZE ||
+		header.mMagic != SEGMENT_MAGIC ||
+		header.mVersion != STORE_VERSION ||
+		header.mID != mID)
+	{
+		LL_WARNS("VFS") << "Bad VFS segment header in " << mFilename << LL_ENDL;
+		close();
+		return false;
+	}
+	mSize = getFileSize();
+	return true;
+}
+
+void LLVFSSegment::close()
+{
+#if LL_WINDOWS
+	if (mHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(mHandle);
+		mHandle = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (mFD >= 0)
+	{
+		::close(mFD);
+		mFD = -1;
+	}
+#endif
+}
+
+S32 LLVFSSegment::read(U32 offset, void* buffer, S32 length) const
+{
+	S32 total = 0;
+	while (total < length)
+	{
+#if LL_WINDOWS
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = offset + total;
+		DWORD bytes_read = 0;
+		if (!ReadFile(mHandle, (U8*)buffer + total, length - total, &bytes_read, &overlapped) || !bytes_read)
+		{
+			break;
+		}
+#else
+		ssize_t bytes_read = ::pread(mFD, (U8*)buffer + total, length - total, (off_t)offset + total);
+		if (bytes_read <= 0)
+		{
+			break;
+		}
+#endif
+		total += (S32)bytes_read;
+	}
+	return total;
+}
+
+S32 LLVFSSegment::write(U32 offset, const void* buffer, S32 length)
+{
+	S32 total = 0;
+	while (total < length)
+	{
+#if LL_WINDOWS
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = offset + total;
+		DWORD bytes_written = 0;
+		if (!WriteFile(mHandle, (const U8*)buffer + total, length - total, &bytes_written, &overlapped) || !bytes_written)
+		{
+			break;
+		}
+#else
+		ssize_t bytes_written = ::pwrite(mFD, (const U8*)buffer + total, length - total, (off_t)offset + total);
+		if (bytes_written <= 0)
+		{
+			break;
+		}
+#endif
+		total += (S32)bytes_written;
+	}
+	return total;
+}
+
+bool LLVFSSegment::truncate(U32 size)
+{
+#if LL_WINDOWS
+	FILE_END_OF_FILE_INFO info;
+	info.EndOfFile.QuadPart = size;
+	bool ok = SetFileInformationByHandle(mHandle, FileEndOfFileInfo, &info, sizeof(info)) != 0;
+#else
+	bool ok = ::ftruncate(mFD, (off_t)size) == 0;
+#endif
+	if (ok)
+	{
+		mSize = size;
+	}
+	return ok;
+}
+
+U32 LLVFSSegment::getFileSize() const
+{
+#if LL_WINDOWS
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(mHandle, &size))
+	{
+		return 0;
+	}
+	return (U32)size.QuadPart;
+#else
+	struct stat st;
+	if (::fstat(mFD, &st) != 0)
+	{
+		return 0;
+	}
+	return (U32)st.st_size;
+#endif
+}
+
+//============================================================================
+// LLVFSLogStore::Compactor
+
+LLVFSLogStore::Compactor::Compactor(LLVFSLogStore* store)
+:	LLThread("VFS compactor"),
+	mStore(store)
+{
+}
+
+// virtual
+bool LLVFSLogStore::Compactor::runCondition()
+{
+	// mDataLock must be locked here.  Only looks at the atomic flag: writers
+	// wake us while holding mWriteMutex.
+	return mStore->mCompactionPending != 0;
+}
+
+// virtual
+void LLVFSLogStore::Compactor::run()
+{
+	while (true)
+	{
+		checkPause();
+
+		if (isQuitting())
+		{
+			break;
+		}
+
+		mStore->mCompactionPending = 0;
+		while (!isQuitting() && mStore->needsCompaction())
+		{
+			if (!mStore->compactOldestSegment())
+			{
+				break;
+			}
+		}
+	}
+	LL_INFOS("VFS") << "VFS compactor EXITING." << LL_ENDL;
+}
+
+//============================================================================
+// LLVFSLogStore
+
+LLVFSLogStore::LLVFSLogStore(const std::string& dirname, U64 max_size)
+:	mDirname(dirname),
+	mMaxSize(max_size),
+	mCreationTime(0),
+	mOpen(false),
+	mNextSegmentID(1),
+	mDiskBytes(0),
+	mLiveBytes(0),
+	mCompactionPending(0),
+	mRelocatedFiles(0),
+	mEvictedFiles(0),
+	mRetiredSegments(0)
+{
+	// Keep at least eight segments in the budget so retiring one never
+	// throws away a large fraction of the cache.
+	mSegmentSize = (U32)llclamp(max_size / 8, (U64)MIN_SEGMENT_SIZE, (U64)MAX_SEGMENT_SIZE);
+	memset(mLockCounts, 0, sizeof(mLockCounts));
+}
+
+LLVFSLogStore::~LLVFSLogStore()
+{
+	close();
+}
+
+bool LLVFSLogStore::open()
+{
+	LLFile::mkdir(mDirname);
+	mCreationTime = time(nullptr);
+
+	LLTimer timer;
+	bool loaded = loadCheckpoint();
+	// The checkpoint only describes the segments as they were at shutdown,
+	// a crash from here on has to replay the log instead.
+	LLFile::remove(getCheckpointFilename(), ENOENT);
+	if (!loaded && !replaySegments())
+	{
+		return false;
+	}
+
+	{
+		LLMutexLock lock(&mWriteMutex);
+		if (!rollSegment())
+		{
+			return false;
+		}
+	}
+
+	U32 file_count = 0;
+	for (U32 i = 0; i < SHARD_COUNT; ++i)
+	{
+		file_count += (U32)mShards[i].mFiles.size();
+	}
+	LL_INFOS("VFS") << "Opened VFS log store " << mDirname << (loaded ? " from checkpoint" : " by replay")
+					<< " in " << timer.getElapsedTimeF32() << "s: " << file_count << " files, "
+					<< mSegments.size() << " segments, " << (mLiveBytes >> 20) << "/" << (mDiskBytes >> 20)
+					<< " MB live, budget " << (mMaxSize >> 20) << " MB" << LL_ENDL;
+
+	mCompactor.reset(new Compactor(this));
+	mCompactor->start();
+	mOpen = true;
+
+	LLMutexLock lock(&mWriteMutex);
+	requestCompaction();
+	return true;
+}
+
+void LLVFSLogStore::close()
+{
+	if (mCompactor)
+	{
+		mCompactor->shutdown();
+		mCompactor.reset();
+	}
+	if (!mOpen)
+	{
+		return;
+	}
+	mOpen = false;
+
+	LLMutexLock lock(&mWriteMutex);
+	writeCheckpoint();
+
+	for (U32 i = 0; i < SHARD_COUNT; ++i)
+	{
+		LLMutexLock shard_lock(&mShards[i].mMutex);
+		mShards[i].mFiles.clear();
+	}
+	mSegments.clear();
+	mDiskBytes = 0;
+	mLiveBytes = 0;
+}
+
+//----------------------------------------------------------------------------
+// Index access
+
+LLVFSLogStore::entry_ptr_t LLVFSLogStore::findEntry(const LLVFSFileSpecifier& spec, bool touch, U32* access_time)
+{
+	Shard& shard = getShard(spec);
+	LLMutexLock lock(&shard.mMutex);
+	slot_map_t::iterator it = shard.mFiles.find(spec);
+	if (it == shard.mFiles.end())
+	{
+		return entry_ptr_t();
+	}
+	if (touch)
+	{
+		it->second.mAccessTime = (U32)time(nullptr);
+	}
+	if (access_time)
+	{
+		*access_time = it->second.mAccessTime;
+	}
+	return it->second.mEntry;
+}
+
+void LLVFSLogStore::publishEntry(const LLVFSFileSpecifier& spec, const entry_ptr_t& entry, bool touch)
+{
+	Shard& shard = getShard(spec);
+	LLMutexLock lock(&shard.mMutex);
+	if (!entry)
+	{
+		shard.mFiles.erase(spec);
+		return;
+	}
+	slot_map_t::iterator it = shard.mFiles.find(spec);
+	if (it == shard.mFiles.end())
+	{
+		Slot slot;
+		slot.mEntry = entry;
+		slot.mAccessTime = (U32)time(nullptr);
+		shard.mFiles.insert(slot_map_t::value_type(spec, slot));
+	}
+	else
+	{
+		it->second.mEntry = entry;
+		if (touch)
+		{
+			it->second.mAccessTime = (U32)time(nullptr);
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+// Public API
+
+BOOL LLVFSLogStore::getExists(const LLVFSFileSpecifier& spec)
+{
+	entry_ptr_t entry = findEntry(spec, true);
+	return (entry && entry->mMaxSize > 0) ? TRUE : FALSE;
+}
+
+S32 LLVFSLogStore::getSize(const LLVFSFileSpecifier& spec)
+{
+	entry_ptr_t entry = findEntry(spec, true);
+	return entry ? entry->mSize : 0;
+}
+
+S32 LLVFSLogStore::getMaxSize(const LLVFSFileSpecifier& spec)
+{
+	entry_ptr_t entry = findEntry(spec, true);
+	return entry ? entry->mMaxSize : 0;
+}
+
+BOOL LLVFSLogStore::checkAvailable(S32 max_size) const
+{
+	return (max_size >= 0 && (U64)max_size <= mMaxSize) ? TRUE : FALSE;
+}
+
+BOOL LLVFSLogStore::setMaxSize(const LLVFSFileSpecifier& spec, S32 max_size)
+{
+	if (!checkAvailable(max_size))
+	{
+		LL_WARNS("VFS") << "VFS: No space (" << max_size << ") for virtual file " << spec.mFileID << LL_ENDL;
+		return FALSE;
+	}
+
+	LLMutexLock lock(&mWriteMutex);
+
+	entry_ptr_t entry = findEntry(spec, true);
+	if (entry && entry->mMaxSize == max_size)
+	{
+		return TRUE;
+	}
+
+	segment_ptr_t segment;
+	U32 payload_offset;
+	if (!appendRecord(RECORD_MAXSIZE, spec, 0, max_size, nullptr, 0, segment, payload_offset))
+	{
+		return FALSE;
+	}
+
+	std::shared_ptr<FileEntry> new_entry = entry ? std::make_shared<FileEntry>(*entry) : std::make_shared<FileEntry>();
+	if (new_entry->mSize > max_size)
+	{
+		LL_WARNS("VFS") << "Truncating virtual file " << spec.mFileID << " to " << max_size << " bytes" << LL_ENDL;
+		truncateEntry(*new_entry, max_size);
+	}
+	new_entry->mMaxSize = max_size;
+	new_entry->mAnchor = segment->mID;
+	publishEntry(spec, new_entry, true);
+	return TRUE;
+}
+
+// Unlike the data file VFS, the locks live outside the index, so they
+// follow the file to its new name without any special casing here.
+void LLVFSLogStore::renameFile(const LLVFSFileSpecifier& old_spec, const LLVFSFileSpecifier& new_spec)
+{
+	{
+		LLMutexLock lock(&mWriteMutex);
+
+		entry_ptr_t entry = findEntry(old_spec, false);
+		if (!entry)
+		{
+			LL_WARNS("VFS") << "VFS: Attempt to rename nonexistent vfile " << old_spec.mFileID << ":" << old_spec.mFileType << LL_ENDL;
+			return;
+		}
+
+		segment_ptr_t segment;
+		U32 payload_offset;
+		if (!appendRecord(RECORD_RENAME, old_spec, 0, new_spec.mFileType,
+						  new_spec.mFileID.mData, UUID_BYTES, segment, payload_offset))
+		{
+			return;
+		}
+
+		entry_ptr_t dest = findEntry(new_spec, false);
+		if (dest)
+		{
+			releaseEntry(*dest);
+		}
+
+		std::shared_ptr<FileEntry> new_entry = std::make_shared<FileEntry>(*entry);
+		new_entry->mAnchor = segment->mID;
+		publishEntry(old_spec, entry_ptr_t(), false);
+		publishEntry(new_spec, new_entry, true);
+	}
+
+	LLMutexLock lock(&mLockMutex);
+	std::map<LLVFSFileSpecifier, LockCounts>::iterator dest_it = mLocks.find(new_spec);
+	if (dest_it != mLocks.end())
+	{
+		for (S32 i = 0; i < (S32)VFSLOCK_COUNT; i++)
+		{
+			if (dest_it->second.mCount[i])
+			{
+				LL_ERRS("VFS") << "Renaming VFS block to a locked file." << LL_ENDL;
+			}
+		}
+		mLocks.erase(dest_it);
+	}
+	std::map<LLVFSFileSpecifier, LockCounts>::iterator src_it = mLocks.find(old_spec);
+	if (src_it != mLocks.end())
+	{
+		mLocks[new_spec] = src_it->second;
+		mLocks.erase(old_spec);
+	}
+}
+
+void LLVFSLogStore::removeFile(const LLVFSFileSpecifier& spec)
+{
+	LLMutexLock lock(&mWriteMutex);
+
+	entry_ptr_t entry = findEntry(spec, false);
+	if (!entry)
+	{
+		LL_WARNS("VFS") << "VFS: attempting to remove nonexistent file " << spec.mFileID << " type " << spec.mFileType << LL_ENDL;
+		return;
+	}
+
+	segment_ptr_t segment;
+	U32 payload_offset;
+	if (appendRecord(RECORD_REMOVE, spec, 0, 0, nullptr, 0, segment, payload_offset))
+	{
+		releaseEntry(*entry);
+		publishEntry(spec, entry_ptr_t(), false);
+	}
+}
+
+S32 LLVFSLogStore::getData(const LLVFSFileSpecifier& spec, U8* buffer, S32 location, S32 length)
+{
+	// The entry keeps every segment it points into open, so the read itself
+	// needs no lock even if the compactor retires those segments meanwhile.
+	entry_ptr_t entry = findEntry(spec, true);
+	if (!entry)
+	{
+		return 0;
+	}
+	if (location > entry->mSize)
+	{
+		LL_WARNS("VFS") << "VFS: Attempt to read location " << location << " in file " << spec.mFileID << " of length " << entry->mSize << LL_ENDL;
+		return 0;
+	}
+	if (length > entry->mSize - location)
+	{
+		length = entry->mSize - location;
+	}
+	return readEntry(*entry, buffer, location, length);
+}
+
+S32 LLVFSLogStore::storeData(const LLVFSFileSpecifier& spec, const U8* buffer, S32 location, S32 length)
+{
+	LLMutexLock lock(&mWriteMutex);
+
+	entry_ptr_t entry = findEntry(spec, true);
+	if (!entry)
+	{
+		return 0;
+	}
+
+	S32 in_loc = location;
+	if (location == -1)
+	{
+		location = entry->mSize;
+	}
+	llassert(location >= 0);
+
+	if (location > entry->mMaxSize)
+	{
+		LL_WARNS("VFS") << "VFS: Attempt to write to location " << in_loc
+						<< " in file " << spec.mFileID
+						<< " type " << S32(spec.mFileType)
+						<< " of size " << entry->mSize
+						<< " block length " << entry->mMaxSize
+						<< LL_ENDL;
+		return length;
+	}
+	if (length > entry->mMaxSize - location)
+	{
+		LL_WARNS("VFS") << "VFS: Truncating write to virtual file " << spec.mFileID << " type " << S32(spec.mFileType) << LL_ENDL;
+		length = entry->mMaxSize - location;
+	}
+	if (length <= 0)
+	{
+		return 0;
+	}
+
+	segment_ptr_t segment;
+	U32 payload_offset;
+	if (!appendRecord(RECORD_DATA, spec, location, entry->mMaxSize, buffer, length, segment, payload_offset))
+	{
+		return 0;
+	}
+
+	std::shared_ptr<FileEntry> new_entry = std::make_shared<FileEntry>(*entry);
+	addExtent(*new_entry, location, length, segment, payload_offset);
+	new_entry->mAnchor = segment->mID;
+	publishEntry(spec, new_entry, true);
+	return length;
+}
+
+void LLVFSLogStore::incLock(const LLVFSFileSpecifier& spec, EVFSLock lock)
+{
+	LLMutexLock lock_data(&mLockMutex);
+	mLocks[spec].mCount[lock]++;
+	mLockCounts[lock]++;
+}
+
+void LLVFSLogStore::decLock(const LLVFSFileSpecifier& spec, EVFSLock lock)
+{
+	LLMutexLock lock_data(&mLockMutex);
+	std::map<LLVFSFileSpecifier, LockCounts>::iterator it = mLocks.find(spec);
+	if (it == mLocks.end())
+	{
+		return;
+	}
+
+	LockCounts& counts = it->second;
+	if (counts.mCount[lock] > 0)
+	{
+		counts.mCount[lock]--;
+	}
+	else
+	{
+		LL_WARNS("VFS") << "VFS: Decrementing zero-value lock " << lock << LL_ENDL;
+	}
+	mLockCounts[lock]--;
+
+	for (S32 i = 0; i < (S32)VFSLOCK_COUNT; i++)
+	{
+		if (counts.mCount[i])
+		{
+			return;
+		}
+	}
+	mLocks.erase(it);
+}
+
+BOOL LLVFSLogStore::isLocked(const LLVFSFileSpecifier& spec, EVFSLock lock)
+{
+	LLMutexLock lock_data(&mLockMutex);
+	std::map<LLVFSFileSpecifier, LockCounts>::const_iterator it = mLocks.find(spec);
+	return (it != mLocks.end() && it->second.mCount[lock] > 0) ? TRUE : FALSE;
+}
+
+void LLVFSLogStore::dumpLockCounts()
+{
+	LLMutexLock lock_data(&mLockMutex);
+	for (S32 i = 0; i < (S32)VFSLOCK_COUNT; i++)
+	{
+		LL_INFOS("VFS") << "LockType: " << i << ": " << mLockCounts[i] << LL_ENDL;
+	}
+}
+
+void LLVFSLogStore::audit()
+{
+	LLMutexLock lock(&mWriteMutex);
+
+	std::map<LLVFSSegment*, S64> live;
+	for (const segment_ptr_t& segment : mSegments)
+	{
+		live[segment.get()] = 0;
+	}
+
+	U32 file_count = 0;
+	U32 bad_count = 0;
+	for (U32 i = 0; i < SHARD_COUNT; ++i)
+	{
+		LLMutexLock shard_lock(&mShards[i].mMutex);
+		for (const slot_map_t::value_type& pair : mShards[i].mFiles)
+		{
+			const FileEntry& entry = *pair.second.mEntry;
+			++file_count;
+
+			bool ok = entry.mSize >= 0 && entry.mSize <= entry.mMaxSize;
+			S32 last_end = 0;
+			for (const Extent& extent : entry.mExtents)
+			{
+				std::map<LLVFSSegment*, S64>::iterator seg_it = live.find(extent.mSegment.get());
+				if (extent.mFileOffset < last_end ||
+					extent.mLength <= 0 ||
+					extent.mFileOffset + extent.mLength > entry.mSize ||
+					seg_it == live.end() ||
+					extent.mSegmentOffset + extent.mLength > extent.mSegment->mSize)
+				{
+					ok = false;
+					break;
+				}
+				seg_it->second += extent.mLength;
+				last_end = extent.mFileOffset + extent.mLength;
+			}
+
+			if (!ok)
+			{
+				++bad_count;
+				LL_WARNS("VFS") << "VFile " << pair.first.mFileID << ":" << pair.first.mFileType
+								<< " has an inconsistent extent list, size " << entry.mSize
+								<< " max " << entry.mMaxSize << LL_ENDL;
+			}
+		}
+	}
+
+	for (const segment_ptr_t& segment : mSegments)
+	{
+		if (live[segment.get()] != segment->mLiveBytes)
+		{
+			++bad_count;
+			LL_WARNS("VFS") << "VFS segment " << segment->mID << " live bytes " << segment->mLiveBytes
+							<< " but index references " << live[segment.get()] << LL_ENDL;
+		}
+	}
+
+	LL_INFOS("VFS") << "VFS audit of " << file_count << " files in " << mSegments.size() << " segments: "
+					<< (bad_count ? llformat("%u errors", bad_count) : std::string("OK")) << LL_ENDL;
+}
+
+void LLVFSLogStore::dumpStatistics()
+{
+	LLMutexLock lock(&mWriteMutex);
+
+	U32 file_count = 0;
+	U32 extent_count = 0;
+	for (U32 i = 0; i < SHARD_COUNT; ++i)
+	{
+		LLMutexLock shard_lock(&mShards[i].mMutex);
+		for (const slot_map_t::value_type& pair : mShards[i].mFiles)
+		{
+			++file_count;
+			extent_count += (U32)pair.second.mEntry->mExtents.size();
+		}
+	}
+
+	for (const segment_ptr_t& segment : mSegments)
+	{
+		LL_INFOS("VFS") << "Segment " << segment->mID << ": " << segment->mSize << " bytes, "
+						<< segment->mLiveBytes << " live" << LL_ENDL;
+	}
+	LL_INFOS("VFS") << "Files: " << file_count << " Extents: " << extent_count
+					<< " Live: " << (mLiveBytes >> 10) << "KB Disk: " << (mDiskBytes >> 10)
+					<< "KB Budget: " << (mMaxSize >> 10) << "KB" << LL_ENDL;
+	LL_INFOS("VFS") << "Compaction: " << mRetiredSegments << " segments retired, "
+					<< mRelocatedFiles << " files relocated, " << mEvictedFiles << " files evicted" << LL_ENDL;
+}
+
+void LLVFSLogStore::getFileList(std::vector<std::pair<LLVFSFileSpecifier, S32> >& files)
+{
+	for (U32 i = 0; i < SHARD_COUNT; ++i)
+	{
+		LLMutexLock shard_lock(&mShards[i].mMutex);
+		for (const slot_map_t::value_type& pair : mShards[i].mFiles)
+		{
+			if (pair.second.mEntry->mSize > 0)
+			{
+				files.push_back(std::make_pair(pair.first, pair.second.mEntry->mSize));
+			}
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+// Records and extents
+
+bool LLVFSLogStore::appendRecord(U8 kind, const LLVFSFileSpecifier& spec, S32 offset, S32 aux,
+								 const U8* payload, S32 length, segment_ptr_t& segment, U32& payload_offset)
+{
+	segment_ptr_t active = mSegments.back();
+	U32 record_size = RECORD_HEADER_SIZE + length;
+	if (active->mSize > SEGMENT_HEADER_SIZE && active->mSize + record_size > mSegmentSize)
+	{
+		if (!rollSegment())
+		{
+			return false;
+		}
+		active = mSegments.back();
+	}
+
+	LLVFSRecordHeader header;
+	memset(&header, 0, RECORD_HEADER_SIZE);
+	header.mMagic = RECORD_MAGIC;
+	header.mKind = kind;
+	memcpy(header.mFileID, spec.mFileID.mData, UUID_BYTES);
+	header.mFileType = spec.mFileType;
+	header.mOffset = offset;
+	header.mLength = length;
+	header.mAux = aux;
+	header.mPayloadCRC = length ? compute_crc(payload, length) : 0;
+	header.mHeaderCRC = header_crc(header);
+
+	U32 record_offset = active->mSize;
+	if (active->write(record_offset, &header, RECORD_HEADER_SIZE) != (S32)RECORD_HEADER_SIZE ||
+		(length && active->write(record_offset + RECORD_HEADER_SIZE, payload, length) != length))
+	{
+		LL_WARNS("VFS") << "VFS write error in segment " << active->mFilename << LL_ENDL;
+		active->truncate(record_offset);
+		return false;
+	}
+
+	active->mSize += record_size;
+	mDiskBytes += record_size;
+	segment = active;
+	payload_offset = record_offset + RECORD_HEADER_SIZE;
+
+	if (mDiskBytes + mSegmentSize > mMaxSize)
+	{
+		requestCompaction();
+	}
+	return true;
+}
+
+bool LLVFSLogStore::rollSegment()
+{
+	U32 id = mNextSegmentID;
+	segment_ptr_t segment = std::make_shared<LLVFSSegment>(id, mDirname + gDirUtilp->getDirDelimiter() + llformat("vfs_%08u.seg", id));
+	if (!segment->create())
+	{
+		return false;
+	}
+
+	if (!mSegments.empty())
+	{
+		mSegments.back()->mSealTime = (U32)time(nullptr);
+	}
+	++mNextSegmentID;
+	mSegments.push_back(segment);
+	mDiskBytes += segment->mSize;
+
+	// A freshly sealed segment may leave the oldest one mostly dead
+	requestCompaction();
+	return true;
+}
+
+void LLVFSLogStore::retireSegment(const segment_ptr_t& segment)
+{
+	// Unlinking is fine even while readers still have extents in flight:
+	// their reference keeps the descriptor (and so the data) alive.
+	mSegments.erase(std::find(mSegments.begin(), mSegments.end(), segment));
+	mDiskBytes -= segment->mSize;
+	LLFile::remove(segment->mFilename);
+	++mRetiredSegments;
+}
+
+void LLVFSLogStore::addExtent(FileEntry& entry, S32 offset, S32 length, const segment_ptr_t& segment, U32 segment_offset)
+{
+	S32 end = offset + length;
+
+	std::vector<Extent> extents;
+	extents.reserve(entry.mExtents.size() + 2);
+	for (const Extent& extent : entry.mExtents)
+	{
+		S32 extent_end = extent.mFileOffset + extent.mLength;
+		if (extent_end <= offset || extent.mFileOffset >= end)
+		{
+			extents.push_back(extent);
+			continue;
+		}
+
+		// Keep whatever the new write does not cover
+		if (extent.mFileOffset < offset)
+		{
+			Extent head = extent;
+			head.mLength = offset - extent.mFileOffset;
+			extents.push_back(head);
+		}
+		if (extent_end > end)
+		{
+			Extent tail = extent;
+			tail.mFileOffset = end;
+			tail.mSegmentOffset += end - extent.mFileOffset;
+			tail.mLength = extent_end - end;
+			extents.push_back(tail);
+		}
+
+		S32 covered = llmin(extent_end, end) - llmax(extent.mFileOffset, offset);
+		extent.mSegment->mLiveBytes -= covered;
+		mLiveBytes -= covered;
+	}
+
+	Extent extent;
+	extent.mFileOffset = offset;
+	extent.mLength = length;
+	extent.mSegment = segment;
+	extent.mSegmentOffset = segment_offset;
+	std::vector<Extent>::iterator pos = std::upper_bound(extents.begin(), extents.end(), extent,
+		[](const Extent& lhs, const Extent& rhs) { return lhs.mFileOffset < rhs.mFileOffset; });
+	extents.insert(pos, extent);
+	entry.mExtents.swap(extents);
+
+	segment->mLiveBytes += length;
+	mLiveBytes += length;
+	entry.mSize = llmax(entry.mSize, end);
+}
+
+void LLVFSLogStore::truncateEntry(FileEntry& entry, S32 size)
+{
+	while (!entry.mExtents.empty())
+	{
+		Extent& extent = entry.mExtents.back();
+		if (extent.mFileOffset + extent.mLength <= size)
+		{
+			break;
+		}
+
+		S32 cut = llmin(extent.mLength, extent.mFileOffset + extent.mLength - size);
+		extent.mSegment->mLiveBytes -= cut;
+		mLiveBytes -= cut;
+		extent.mLength -= cut;
+		if (extent.mLength <= 0)
+		{
+			entry.mExtents.pop_back();
+		}
+	}
+	entry.mSize = llmin(entry.mSize, size);
+}
+
+void LLVFSLogStore::releaseEntry(const FileEntry& entry)
+{
+	for (const Extent& extent : entry.mExtents)
+	{
+		extent.mSegment->mLiveBytes -= extent.mLength;
+		mLiveBytes -= extent.mLength;
+	}
+}
+
+S32 LLVFSLogStore::readEntry(const FileEntry& entry, U8* buffer, S32 location, S32 length) const
+{
+	S32 end = location + length;
+	S32 filled = location;	// everything before this has been copied or zeroed
+	for (const Extent& extent : entry.mExtents)
+	{
+		S32 extent_end = extent.mFileOffset + extent.mLength;
+		if (extent_end <= location)
+		{
+			continue;
+		}
+		if (extent.mFileOffset >= end)
+		{
+			break;
+		}
+
+		// Never written ranges read back as zeroes, like the old presized data file
+		S32 start = llmax(extent.mFileOffset, location);
+		if (start > filled)
+		{
+			memset(buffer + (filled - location), 0, start - filled);
+		}
+
+		S32 count = llmin(extent_end, end) - start;
+		S32 read = extent.mSegment->read(extent.mSegmentOffset + (start - extent.mFileOffset), buffer + (start - location), count);
+		if (read != count)
+		{
+			LL_WARNS("VFS") << "VFS read error in segment " << extent.mSegment->mFilename << LL_ENDL;
+			return start - location + llmax(read, 0);
+		}
+		filled = start + count;
+	}
+	if (end > filled)
+	{
+		memset(buffer + (filled - location), 0, end - filled);
+	}
+	return length;
+}
+
+//----------------------------------------------------------------------------
+// Startup
+
+std::string LLVFSLogStore::getCheckpointFilename() const
+{
+	return mDirname + gDirUtilp->getDirDelimiter() + CHECKPOINT_NAME;
+}
+
+bool LLVFSLogStore::replaySegments()
+{
+	std::vector<U32> ids;
+	std::string filename;
+	LLDirIterator iter(mDirname, SEGMENT_MASK);
+	while (iter.next(filename))
+	{
+		U32 id = 0;
+		if (sscanf(filename.c_str(), "vfs_%u.seg", &id) == 1 && id > 0)
+		{
+			ids.push_back(id);
+		}
+	}
+	std::sort(ids.begin(), ids.end());
+
+	replay_map_t files;
+	std::set<LLVFSFileSpecifier> damaged;
+	for (size_t i = 0; i < ids.size(); ++i)
+	{
+		U32 id = ids[i];
+		mNextSegmentID = llmax(mNextSegmentID, id + 1);
+
+		segment_ptr_t segment = std::make_shared<LLVFSSegment>(id, mDirname + gDirUtilp->getDirDelimiter() + llformat("vfs_%08u.seg", id));
+		if (!segment->openExisting())
+		{
+			LLFile::remove(segment->mFilename);
+			continue;
+		}
+
+		llstat st;
+		segment->mSealTime = LLFile::stat(segment->mFilename, &st) ? (U32)time(nullptr) : (U32)st.st_mtime;
+		if (mSegments.empty())
+		{
+			mCreationTime = segment->mSealTime;
+		}
+		mSegments.push_back(segment);
+		const bool last = i + 1 == ids.size();
+		bool intact = replaySegment(segment, last, files, damaged);
+		mDiskBytes += segment->mSize;
+		if (!intact && !last)
+		{
+			// The records after the damage may have removed, renamed or
+			// rewritten any file, so nothing replayed so far can be trusted
+			LL_WARNS("VFS") << "Damaged record header in " << segment->mFilename << ", discarding the VFS log" << LL_ENDL;
+			for (replay_map_t::iterator it = files.begin(); it != files.end(); ++it)
+			{
+				releaseEntry(it->second);
+			}
+			files.clear();
+			damaged.clear();
+			for (const segment_ptr_t& replayed : mSegments)
+			{
+				LLFile::remove(replayed->mFilename);
+			}
+			mSegments.clear();
+			mDiskBytes = 0;
+			for (++i; i < ids.size(); ++i)
+			{
+				mNextSegmentID = llmax(mNextSegmentID, ids[i] + 1);
+				LLFile::remove(mDirname + gDirUtilp->getDirDelimiter() + llformat("vfs_%08u.seg", ids[i]));
+			}
+			break;
+		}
+	}
+
+	// A file with a bad payload in the middle of the log would read back
+	// with part of an older version in it, drop it instead.
+	for (const LLVFSFileSpecifier& spec : damaged)
+	{
+		replay_map_t::iterator it = files.find(spec);
+		if (it != files.end())
+		{
+			LL_WARNS("VFS") << "Dropping damaged virtual file " << spec.mFileID << ":" << spec.mFileType << LL_ENDL;
+			releaseEntry(it->second);
+			files.erase(it);
+		}
+	}
+
+	publishReplayed(files);
+	return true;
+}
+
+bool LLVFSLogStore::replaySegment(const segment_ptr_t& segment, bool last, replay_map_t& files,
+								  std::set<LLVFSFileSpecifier>& damaged)
+{
+	U32 file_size = segment->mSize;
+	U32 offset = SEGMENT_HEADER_SIZE;
+	std::vector<U8> payload;
+	while (offset + RECORD_HEADER_SIZE <= file_size)
+	{
+		LLVFSRecordHeader header;
+		if (segment->read(offset, &header, RECORD_HEADER_SIZE) != (S32)RECORD_HEADER_SIZE ||
+			header.mMagic != RECORD_MAGIC ||
+			header.mHeaderCRC != header_crc(header) ||
+			header.mLength < 0 ||
+			header.mOffset < 0 ||
+			header.mFileType < LLAssetType::AT_NONE ||
+			header.mFileType >= LLAssetType::AT_COUNT ||
+			(U64)offset + RECORD_HEADER_SIZE + header.mLength > file_size)
+		{
+			break;
+		}
+
+		U32 payload_offset = offset + RECORD_HEADER_SIZE;
+		U32 next = payload_offset + header.mLength;
+
+		LLUUID id;
+		memcpy(id.mData, header.mFileID, UUID_BYTES);
+		LLVFSFileSpecifier spec(id, (LLAssetType::EType)header.mFileType);
+
+		if (header.mLength > 0)
+		{
+			payload.resize(header.mLength);
+			if (segment->read(payload_offset, &payload[0], header.mLength) != header.mLength ||
+				compute_crc(&payload[0], header.mLength) != header.mPayloadCRC)
+			{
+				// Only the very last record can have been cut short by a crash,
+				// anything else is damage to a single record.
+				if (last && next + RECORD_HEADER_SIZE > file_size)
+				{
+					break;
+				}
+				LL_WARNS("VFS") << "Bad payload CRC for " << spec.mFileID << " at " << offset << " in " << segment->mFilename << LL_ENDL;
+				damaged.insert(spec);
+				offset = next;
+				continue;
+			}
+		}
+
+		switch (header.mKind)
+		{
+		case RECORD_DATA:
+		{
+			FileEntry& entry = files[spec];
+			entry.mMaxSize = header.mAux;
+			entry.mAnchor = segment->mID;
+			if (header.mLength > 0)
+			{
+				addExtent(entry, header.mOffset, header.mLength, segment, payload_offset);
+			}
+			break;
+		}
+		case RECORD_MAXSIZE:
+		{
+			FileEntry& entry = files[spec];
+			truncateEntry(entry, header.mAux);
+			entry.mMaxSize = header.mAux;
+			entry.mAnchor = segment->mID;
+			break;
+		}
+		case RECORD_REMOVE:
+		{
+			replay_map_t::iterator it = files.find(spec);
+			if (it != files.end())
+			{
+				releaseEntry(it->second);
+				files.erase(it);
+			}
+			damaged.erase(spec);
+			break;
+		}
+		case RECORD_RENAME:
+		{
+			if (header.mLength != UUID_BYTES)
+			{
+				break;
+			}
+			LLUUID new_id;
+			memcpy(new_id.mData, &payload[0], UUID_BYTES);
+			LLVFSFileSpecifier new_spec(new_id, (LLAssetType::EType)header.mAux);
+			replay_map_t::iterator it = files.find(spec);
+			if (it != files.end() && !(new_spec == spec))
+			{
+				replay_map_t::iterator dest = files.find(new_spec);
+				if (dest != files.end())
+				{
+					releaseEntry(dest->second);
+				}
+				FileEntry& entry = files[new_spec];
+				entry = it->second;
+				entry.mAnchor = segment->mID;
+				files.erase(it);
+
+				damaged.erase(new_spec);
+				if (damaged.erase(spec))
+				{
+					damaged.insert(new_spec);
+				}
+			}
+			break;
+		}
+		default:
+			LL_WARNS("VFS") << "Unknown VFS record kind " << (S32)header.mKind << " in " << segment->mFilename << LL_ENDL;
+			break;
+		}
+
+		offset = next;
+	}
+
+	if (offset < file_size)
+	{
+		// Only the segment being appended to at the crash can end in a torn
+		// record, damage anywhere else is left for the caller to deal with
+		if (last)
+		{
+			LL_WARNS("VFS") << "Discarding " << (file_size - offset) << " bytes of damaged records at the end of " << segment->mFilename << LL_ENDL;
+			segment->truncate(offset);
+		}
+		return false;
+	}
+	return true;
+}
+
+void LLVFSLogStore::publishReplayed(replay_map_t& files)
+{
+	std::map<U32, U32> seal_times;
+	for (const segment_ptr_t& segment : mSegments)
+	{
+		seal_times[segment->mID] = segment->mSealTime;
+	}
+
+	for (replay_map_t::value_type& pair : files)
+	{
+		std::shared_ptr<FileEntry> entry = std::make_shared<FileEntry>();
+		entry->mSize = pair.second.mSize;
+		entry->mMaxSize = pair.second.mMaxSize;
+		entry->mAnchor = pair.second.mAnchor;
+		entry->mExtents.swap(pair.second.mExtents);
+
+		Slot slot;
+		slot.mEntry = entry;
+		slot.mAccessTime = seal_times[entry->mAnchor];
+		getShard(pair.first).mFiles[pair.first] = slot;
+	}
+	files.clear();
+}
+
+// Checkpoint layout: header, one record per segment, one record per file
+// followed by its extents, and a CRC over everything before it.
+namespace
+{
+	struct CheckpointHeader
+	{
+		U32 mMagic;
+		U32 mVersion;
+		U32 mSegmentCount;
+		U32 mFileCount;
+		U64 mCreationTime;
+	};
+
+	struct CheckpointSegment
+	{
+		U32 mID;
+		U32 mSize;
+		U32 mSealTime;
+	};
+
+	struct CheckpointFile
+	{
+		U8 mFileID[UUID_BYTES];
+		S32 mFileType;
+		S32 mSize;
+		S32 mMaxSize;
+		U32 mAccessTime;
+		U32 mAnchor;
+		U32 mExtentCount;
+	};
+
+	struct CheckpointExtent
+	{
+		S32 mFileOffset;
+		S32 mLength;
+		U32 mSegmentID;
+		U32 mSegmentOffset;
+	};
+
+	template <typename T>
+	void append_pod(std::vector<U8>& buffer, const T& value)
+	{
+		const U8* bytes = (const U8*)&value;
+		buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+	}
+
+	template <typename T>
+	bool read_pod(const std::vector<U8>& buffer, size_t& pos, size_t end, T& value)
+	{
+		if (pos + sizeof(T) > end)
+		{
+			return false;
+		}
+		memcpy(&value, &buffer[pos], sizeof(T));
+		pos += sizeof(T);
+		return true;
+	}
+}
+
+void LLVFSLogStore::writeCheckpoint()
+{
+	std::vector<U8> buffer;
+	buffer.reserve(1024 * 1024);
+
+	U32 file_count = 0;
+	for (U32 i = 0; i < SHARD_COUNT; ++i)
+	{
+		file_count += (U32)mShards[i].mFiles.size();
+	}
+
+	CheckpointHeader header;
+	header.mMagic = CHECKPOINT_MAGIC;
+	header.mVersion = STORE_VERSION;
+	header.mSegmentCount = (U32)mSegments.size();
+	header.mFileCount = file_count;
+	header.mCreationTime = (U64)mCreationTime;
+	append_pod(buffer, header);
+
+	for (const segment_ptr_t& segment : mSegments)
+	{
+		CheckpointSegment record;
+		record.mID = segment->mID;
+		record.mSize = segment->mSize;
+		record.mSealTime = segment->mSealTime ? segment->mSealTime : (U32)time(nullptr);
+		append_pod(buffer, record);
+	}
+
+	for (U32 i = 0; i < SHARD_COUNT; ++i)
+	{
+		LLMutexLock shard_lock(&mShards[i].mMutex);
+		for (const slot_map_t::value_type& pair : mShards[i].mFiles)
+		{
+			const FileEntry& entry = *pair.second.mEntry;
+			CheckpointFile record;
+			memcpy(record.mFileID, pair.first.mFileID.mData, UUID_BYTES);
+			record.mFileType = pair.first.mFileType;
+			record.mSize = entry.mSize;
+			record.mMaxSize = entry.mMaxSize;
+			record.mAccessTime = pair.second.mAccessTime;
+			record.mAnchor = entry.mAnchor;
+			record.mExtentCount = (U32)entry.mExtents.size();
+			append_pod(buffer, record);
+
+			for (const Extent& extent : entry.mExtents)
+			{
+				CheckpointExtent extent_record;
+				extent_record.mFileOffset = extent.mFileOffset;
+				extent_record.mLength = extent.mLength;
+				extent_record.mSegmentID = extent.mSegment->mID;
+				extent_record.mSegmentOffset = extent.mSegmentOffset;
+				append_pod(buffer, extent_record);
+			}
+		}
+	}
+	append_pod(buffer, compute_crc(&buffer[0], buffer.size()));
+
+	std::string filename = getCheckpointFilename();
+	std::string tmp_filename = filename + ".tmp";
+	LLFILE* fp = LLFile::fopen(tmp_filename, "wb");
+	if (!fp)
+	{
+		LL_WARNS("VFS") << "Unable to write VFS checkpoint " << tmp_filename << LL_ENDL;
+		return;
+	}
+	bool ok = fwrite(&buffer[0], 1, buffer.size(), fp) == buffer.size();
+	ok = (fclose(fp) == 0) && ok;
+	if (!ok || LLFile::rename(tmp_filename, filename) != 0)
+	{
+		LL_WARNS("VFS") << "Unable to write VFS checkpoint " << filename << LL_ENDL;
+		LLFile::remove(tmp_filename);
+		return;
+	}
+	LL_INFOS("VFS") << "Wrote VFS checkpoint: " << file_count << " files in " << mSegments.size() << " segments" << LL_ENDL;
+}
+
+bool LLVFSLogStore::loadCheckpoint()
+{
+	std::string filename = getCheckpointFilename();
+	llstat st;
+	if (LLFile::stat(filename, &st) || st.st_size < (S64)(sizeof(CheckpointHeader) + sizeof(U32)))
+	{
+		return false;
+	}
+
+	std::vector<U8> buffer((size_t)st.st_size);
+	LLFILE* fp = LLFile::fopen(filename, "rb");
+	if (!fp)
+	{
+		return false;
+	}
+	bool ok = fread(&buffer[0], 1, buffer.size(), fp) == buffer.size();
+	fclose(fp);
+
+	size_t end = buffer.size() - sizeof(U32);
+	U32 crc;
+	memcpy(&crc, &buffer[end], sizeof(U32));
+	if (!ok || crc != compute_crc(&buffer[0], end))
+	{
+		LL_WARNS("VFS") << "Ignoring damaged VFS checkpoint " << filename << LL_ENDL;
+		return false;
+	}
+
+	size_t pos = 0;
+	CheckpointHeader header;
+	if (!read_pod(buffer, pos, end, header) ||
+		header.mMagic != CHECKPOINT_MAGIC ||
+		header.mVersion != STORE_VERSION)
+	{
+		return false;
+	}
+
+	std::map<U32, segment_ptr_t> segments;
+	std::deque<segment_ptr_t> ordered;
+	for (U32 i = 0; i < header.mSegmentCount; ++i)
+	{
+		CheckpointSegment record;
+		if (!read_pod(buffer, pos, end, record))
+		{
+			return false;
+		}
+		segment_ptr_t segment = std::make_shared<LLVFSSegment>(record.mID, mDirname + gDirUtilp->getDirDelimiter() + llformat("vfs_%08u.seg", record.mID));
+		// A segment that is shorter than recorded was damaged behind our back
+		if (!segment->openExisting() || segment->mSize < record.mSize)
+		{
+			return false;
+		}
+		if (segment->mSize > record.mSize)
+		{
+			segment->truncate(record.mSize);
+		}
+		segment->mSealTime = record.mSealTime;
+		segments[record.mID] = segment;
+		ordered.push_back(segment);
+	}
+
+	replay_map_t files;
+	std::map<LLVFSFileSpecifier, U32> access_times;
+	U64 live_bytes = 0;
+	for (U32 i = 0; i < header.mFileCount; ++i)
+	{
+		CheckpointFile record;
+		if (!read_pod(buffer, pos, end, record))
+		{
+			return false;
+		}
+		LLUUID id;
+		memcpy(id.mData, record.mFileID, UUID_BYTES);
+		LLVFSFileSpecifier spec(id, (LLAssetType::EType)record.mFileType);
+
+		FileEntry& entry = files[spec];
+		entry.mSize = record.mSize;
+		entry.mMaxSize = record.mMaxSize;
+		entry.mAnchor = record.mAnchor;
+		entry.mExtents.reserve(record.mExtentCount);
+		access_times[spec] = record.mAccessTime;
+
+		for (U32 j = 0; j < record.mExtentCount; ++j)
+		{
+			CheckpointExtent extent_record;
+			if (!read_pod(buffer, pos, end, extent_record))
+			{
+				return false;
+			}
+			std::map<U32, segment_ptr_t>::iterator seg_it = segments.find(extent_record.mSegmentID);
+			if (seg_it == segments.end())
+			{
+				return false;
+			}
+			Extent extent;
+			extent.mFileOffset = extent_record.mFileOffset;
+			extent.mLength = extent_record.mLength;
+			extent.mSegment = seg_it->second;
+			extent.mSegmentOffset = extent_record.mSegmentOffset;
+			extent.mSegment->mLiveBytes += extent.mLength;
+			live_bytes += extent.mLength;
+			entry.mExtents.push_back(extent);
+		}
+	}
+
+	// Anything not listed was retired after the checkpoint's segments were
+	// chosen and must not come back.
+	std::string found;
+	LLDirIterator iter(mDirname, SEGMENT_MASK);
+	while (iter.next(found))
+	{
+		U32 id = 0;
+		if (sscanf(found.c_str(), "vfs_%u.seg", &id) == 1 && segments.find(id) == segments.end())
+		{
+			LLFile::remove(mDirname + gDirUtilp->getDirDelimiter() + found);
+		}
+	}
+
+	mSegments.swap(ordered);
+	for (const segment_ptr_t& segment : mSegments)
+	{
+		mDiskBytes += segment->mSize;
+		mNextSegmentID = llmax(mNextSegmentID, segment->mID + 1);
+	}
+	mLiveBytes = live_bytes;
+	mCreationTime = (time_t)header.mCreationTime;
+
+	publishReplayed(files);
+	for (const std::map<LLVFSFileSpecifier, U32>::value_type& pair : access_times)
+	{
+		getShard(pair.first).mFiles[pair.first].mAccessTime = pair.second;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// Compaction
+
+bool LLVFSLogStore::needsCompaction()
+{
+	LLMutexLock lock(&mWriteMutex);
+	if (mSegments.size() < 2)
+	{
+		return false;
+	}
+	if (mDiskBytes + mSegmentSize > mMaxSize)
+	{
+		return true;
+	}
+	// Reclaim mostly dead segments early, moving their remains is cheap
+	const segment_ptr_t& oldest = mSegments.front();
+	return oldest->mLiveBytes * 4 < (S64)(oldest->mSize - SEGMENT_HEADER_SIZE);
+}
+
+// mWriteMutex must be locked.
+void LLVFSLogStore::requestCompaction()
+{
+	if (mCompactor)
+	{
+		mCompactionPending = 1;
+		mCompactor->wake();
+	}
+}
+
+// mWriteMutex must be locked.
+void LLVFSLogStore::recountLiveBytes()
+{
+	for (const segment_ptr_t& segment : mSegments)
+	{
+		segment->mLiveBytes = 0;
+	}
+	mLiveBytes = 0;
+	for (U32 i = 0; i < SHARD_COUNT; ++i)
+	{
+		LLMutexLock shard_lock(&mShards[i].mMutex);
+		for (const slot_map_t::value_type& pair : mShards[i].mFiles)
+		{
+			for (const Extent& extent : pair.second.mEntry->mExtents)
+			{
+				extent.mSegment->mLiveBytes += extent.mLength;
+				mLiveBytes += extent.mLength;
+			}
+		}
+	}
+}
+
+bool LLVFSLogStore::compactOldestSegment()
+{
+	segment_ptr_t oldest;
+	{
+		LLMutexLock lock(&mWriteMutex);
+		if (mSegments.size() < 2)
+		{
+			return false;
+		}
+		oldest = mSegments.front();
+	}
+
+	// New records only ever go to the newest segment, so the set of files
+	// depending on the oldest one can only shrink, except that a rename moves
+	// extents to a name the previous pass did not see.  Walk the index until
+	// nothing refers to the segment rather than trusting its live byte count.
+	std::vector<U8> buffer;
+	for (U32 pass = 0; ; ++pass)
+	{
+		std::vector<LLVFSFileSpecifier> candidates;
+		for (U32 i = 0; i < SHARD_COUNT; ++i)
+		{
+			LLMutexLock shard_lock(&mShards[i].mMutex);
+			for (const slot_map_t::value_type& pair : mShards[i].mFiles)
+			{
+				const FileEntry& entry = *pair.second.mEntry;
+				bool depends = entry.mAnchor == oldest->mID;
+				for (size_t j = 0; !depends && j < entry.mExtents.size(); ++j)
+				{
+					depends = entry.mExtents[j].mSegment == oldest;
+				}
+				if (depends)
+				{
+					candidates.push_back(pair.first);
+				}
+			}
+		}
+		if (candidates.empty())
+		{
+			break;
+		}
+		if (pass >= MAX_COMPACTION_PASSES)
+		{
+			LL_WARNS("VFS") << "VFS segment " << oldest->mID << " is still referenced by " << candidates.size() << " files after compaction" << LL_ENDL;
+			return false;
+		}
+
+		for (const LLVFSFileSpecifier& spec : candidates)
+		{
+			LLMutexLock lock(&mWriteMutex);
+			// Held until the file is relocated or evicted, so it can't be
+			// opened in between
+			LLMutexLock lock_data(&mLockMutex);
+			bool locked = isLocked(spec, VFSLOCK_OPEN) || isLocked(spec, VFSLOCK_READ) || isLocked(spec, VFSLOCK_APPEND);
+
+			U32 access_time = 0;
+			entry_ptr_t entry = findEntry(spec, false, &access_time);
+			if (!entry)
+			{
+				continue;
+			}
+
+			// Keep files that were used after this segment stopped growing, as
+			// long as there is room for them.  Open files are always kept.
+			bool hot = access_time >= oldest->mSealTime && mLiveBytes <= mMaxSize * 3 / 4;
+			bool relocated = false;
+			if (locked || hot)
+			{
+				std::shared_ptr<FileEntry> new_entry = std::make_shared<FileEntry>(*entry);
+				segment_ptr_t segment;
+				U32 payload_offset;
+				relocated = true;
+				for (const Extent& extent : entry->mExtents)
+				{
+					if (extent.mSegment != oldest)
+					{
+						continue;
+					}
+					buffer.resize(extent.mLength);
+					if (oldest->read(extent.mSegmentOffset, &buffer[0], extent.mLength) != extent.mLength ||
+						!appendRecord(RECORD_DATA, spec, extent.mFileOffset, entry->mMaxSize, &buffer[0], extent.mLength, segment, payload_offset))
+					{
+						relocated = false;
+						break;
+					}
+					addExtent(*new_entry, extent.mFileOffset, extent.mLength, segment, payload_offset);
+				}
+				if (relocated && !segment)
+				{
+					// Nothing but the name lives here, re-establish it
+					relocated = appendRecord(RECORD_MAXSIZE, spec, 0, entry->mMaxSize, nullptr, 0, segment, payload_offset);
+				}
+				if (relocated)
+				{
+					new_entry->mAnchor = segment->mID;
+					publishEntry(spec, new_entry, false);
+					++mRelocatedFiles;
+					continue;
+				}
+				// Undo the live byte accounting of the partial copy
+				releaseEntry(*new_entry);
+				for (const Extent& extent : entry->mExtents)
+				{
+					extent.mSegment->mLiveBytes += extent.mLength;
+					mLiveBytes += extent.mLength;
+				}
+			}
+
+			segment_ptr_t segment;
+			U32 payload_offset;
+			if (!appendRecord(RECORD_REMOVE, spec, 0, 0, nullptr, 0, segment, payload_offset))
+			{
+				return false;
+			}
+			releaseEntry(*entry);
+			publishEntry(spec, entry_ptr_t(), false);
+			++mEvictedFiles;
+		}
+	}
+
+	LLMutexLock lock(&mWriteMutex);
+	if (oldest->mLiveBytes != 0)
+	{
+		// Nothing refers to the segment any more, the counters are off
+		LL_WARNS("VFS") << "VFS segment " << oldest->mID << " has " << oldest->mLiveBytes << " live bytes but no references, recounting" << LL_ENDL;
+		recountLiveBytes();
+	}
+	retireSegment(oldest);
+	LL_DEBUGS("VFS") << "Retired VFS segment " << oldest->mID << ", " << (mDiskBytes >> 20) << " MB on disk" << LL_ENDL;
+	return true;
+}
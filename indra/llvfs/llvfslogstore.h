@@ -0,0 +1,218 @@
+/**
+ * @file llvfslogstore.h
+ * @brief Log-structured segment store backing LLVFS
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLVFSLOGSTORE_H
+#define LL_LLVFSLOGSTORE_H
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "llatomic.h"
+#include "llvfs.h"
+
+class LLVFSSegment;
+
+// Append-only replacement for the single LLVFS data file.
+//
+// Every mutation (data write, resize, rename, remove) is appended as a
+// record to the newest segment file in the store directory.  The in-memory
+// index maps each file to an immutable list of extents pointing into the
+// segments, so readers copy a reference to that list under a short shard
+// lock and then read the segment files without holding any lock at all.
+// Writers are serialized on a single mutex and publish a new extent list
+// when they are done.
+//
+// Space is reclaimed by retiring the oldest segment: a background thread
+// moves any recently used files out of it, evicts the rest and unlinks the
+// segment; readers still holding one of its extents keep the open file
+// until they let go of it.  Segments always retire
+// oldest first, so a removal can never be undone by replaying a stale
+// write on the next startup.
+//
+// On a clean shutdown the index is written next to the segments and loaded
+// back on the next start instead of replaying every record header.
+class LLVFSLogStore
+{
+public:
+	LLVFSLogStore(const std::string& dirname, U64 max_size);
+	~LLVFSLogStore();
+
+	// Loads the index (or replays the segments) and starts the compactor.
+	bool open();
+	// Stops the compactor and writes the index checkpoint.
+	void close();
+
+	BOOL getExists(const LLVFSFileSpecifier& spec);
+	S32 getSize(const LLVFSFileSpecifier& spec);
+	S32 getMaxSize(const LLVFSFileSpecifier& spec);
+	BOOL checkAvailable(S32 max_size) const;
+	BOOL setMaxSize(const LLVFSFileSpecifier& spec, S32 max_size);
+
+	void renameFile(const LLVFSFileSpecifier& old_spec, const LLVFSFileSpecifier& new_spec);
+	void removeFile(const LLVFSFileSpecifier& spec);
+
+	S32 getData(const LLVFSFileSpecifier& spec, U8* buffer, S32 location, S32 length);
+	S32 storeData(const LLVFSFileSpecifier& spec, const U8* buffer, S32 location, S32 length);
+
+	void incLock(const LLVFSFileSpecifier& spec, EVFSLock lock);
+	void decLock(const LLVFSFileSpecifier& spec, EVFSLock lock);
+	BOOL isLocked(const LLVFSFileSpecifier& spec, EVFSLock lock);
+	void dumpLockCounts();
+
+	// Cheap consistency check of the in-memory index against the segments.
+	void audit();
+	void dumpStatistics();
+	// Lists every file with data in it, along with its size.
+	void getFileList(std::vector<std::pair<LLVFSFileSpecifier, S32> >& files);
+	time_t creationTime() const { return mCreationTime; }
+
+private:
+	typedef std::shared_ptr<LLVFSSegment> segment_ptr_t;
+
+	struct Extent
+	{
+		S32 mFileOffset;
+		S32 mLength;
+		segment_ptr_t mSegment;
+		U32 mSegmentOffset;
+	};
+
+	struct FileEntry
+	{
+		FileEntry() : mSize(0), mMaxSize(0), mAnchor(0) {}
+
+		S32 mSize;
+		S32 mMaxSize;
+		// Id of the segment holding the newest record that establishes this
+		// file under its current name and max size.
+		U32 mAnchor;
+		std::vector<Extent> mExtents;	// sorted by mFileOffset, never overlapping
+	};
+	typedef std::shared_ptr<const FileEntry> entry_ptr_t;
+
+	struct Slot
+	{
+		entry_ptr_t mEntry;
+		U32 mAccessTime;
+	};
+	typedef std::map<LLVFSFileSpecifier, Slot> slot_map_t;
+
+	struct Shard
+	{
+		LLMutex mMutex;
+		slot_map_t mFiles;
+	};
+	static const U32 SHARD_COUNT = 16;
+
+	struct LockCounts
+	{
+		LockCounts() { memset(mCount, 0, sizeof(mCount)); }
+		S32 mCount[VFSLOCK_COUNT];
+	};
+
+	class Compactor : public LLThread
+	{
+	public:
+		Compactor(LLVFSLogStore* store);
+
+	protected:
+		bool runCondition() override;
+		void run() override;
+
+	private:
+		LLVFSLogStore* mStore;
+	};
+
+	Shard& getShard(const LLVFSFileSpecifier& spec) { return mShards[spec.mFileID.mData[0] & (SHARD_COUNT - 1)]; }
+
+	// Index access.  The returned entry is immutable and stays valid (with
+	// its segments open) for as long as the caller holds on to it.
+	entry_ptr_t findEntry(const LLVFSFileSpecifier& spec, bool touch, U32* access_time = nullptr);
+	// Replaces (or, with a null entry, erases) the published entry for spec.
+	void publishEntry(const LLVFSFileSpecifier& spec, const entry_ptr_t& entry, bool touch);
+
+	// Record helpers, mWriteMutex must be locked.
+	bool appendRecord(U8 kind, const LLVFSFileSpecifier& spec, S32 offset, S32 aux,
+					  const U8* payload, S32 length, segment_ptr_t& segment, U32& payload_offset);
+	bool rollSegment();
+	void retireSegment(const segment_ptr_t& segment);
+	void addExtent(FileEntry& entry, S32 offset, S32 length, const segment_ptr_t& segment, U32 segment_offset);
+	void truncateEntry(FileEntry& entry, S32 size);
+	void releaseEntry(const FileEntry& entry);
+	S32 readEntry(const FileEntry& entry, U8* buffer, S32 location, S32 length) const;
+
+	// Startup.
+	bool loadCheckpoint();
+	bool replaySegments();
+	typedef std::map<LLVFSFileSpecifier, FileEntry> replay_map_t;
+	// Files with a damaged payload anywhere in the log are collected in damaged.
+	// Returns false on a bad record header, the last segment is cut back to it.
+	bool replaySegment(const segment_ptr_t& segment, bool last, replay_map_t& files,
+					   std::set<LLVFSFileSpecifier>& damaged);
+	void publishReplayed(replay_map_t& files);
+	void writeCheckpoint();
+	std::string getCheckpointFilename() const;
+
+	// Compaction, run from mCompactor.
+	bool needsCompaction();
+	void requestCompaction();
+	// Returns false if the oldest segment could not be retired.
+	bool compactOldestSegment();
+	// Rebuilds the live byte counters from the index, mWriteMutex must be locked.
+	void recountLiveBytes();
+
+private:
+	std::string mDirname;
+	U64 mMaxSize;
+	U32 mSegmentSize;
+	time_t mCreationTime;
+	bool mOpen;
+
+	Shard mShards[SHARD_COUNT];
+
+	// Guards the segment list, the active segment and the byte counters.
+	LLMutex mWriteMutex;
+	std::deque<segment_ptr_t> mSegments;	// oldest first, back() is appended to
+	U32 mNextSegmentID;
+	U64 mDiskBytes;
+	U64 mLiveBytes;
+
+	// Taken after mWriteMutex when both are needed.
+	LLMutex mLockMutex;
+	std::map<LLVFSFileSpecifier, LockCounts> mLocks;
+	S32 mLockCounts[VFSLOCK_COUNT];
+
+	std::unique_ptr<Compactor> mCompactor;
+	LLAtomicU32 mCompactionPending;
+	U32 mRelocatedFiles;
+	U32 mEvictedFiles;
+	U32 mRetiredSegments;
+};
+
+#endif // LL_LLVFSLOGSTORE_H
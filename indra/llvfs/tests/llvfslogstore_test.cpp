@@ -0,0 +1,334 @@
+/**
+ * @file llvfslogstore_test.cpp
+ * @brief Replay, crash recovery, compaction and checkpoint tests for the VFS segment store
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "../llcommon/linden_common.h"
+#include <vector>
+// Class to test
+#include "../llvfslogstore.h"
+// For directory listing and cleanup
+#include "../lldiriterator.h"
+#include "../llcommon/llfile.h"
+#include "../llcommon/lltimer.h"
+// Tut header
+#include "../test/lltut.h"
+
+// These tests poke at the segment files directly and so know a little about
+// their layout: a 16 byte segment header followed by records, each with a
+// 48 byte header in front of its payload.
+static const U32 SEGMENT_HEADER_BYTES = 16;
+static const U32 RECORD_HEADER_BYTES = 48;
+
+namespace tut
+{
+	struct vfslogstore_test
+	{
+		std::string mDir;
+
+		vfslogstore_test()
+		:	mDir("llvfslogstore_test.dir")
+		{
+			cleanup();
+		}
+		~vfslogstore_test()
+		{
+			cleanup();
+		}
+
+		void cleanup()
+		{
+			std::string name;
+			LLDirIterator iter(mDir, "*");
+			while (iter.next(name))
+			{
+				LLFile::remove(path(name));
+			}
+			LLFile::rmdir_nowarn(mDir);
+		}
+
+		std::string path(const std::string& name) const
+		{
+			return mDir + "/" + name;
+		}
+
+		std::vector<U8> readFile(const std::string& name) const
+		{
+			std::vector<U8> data;
+			LLFILE* fp = LLFile::fopen(path(name), "rb");
+			if (fp)
+			{
+				U8 buffer[4096];
+				size_t count;
+				while ((count = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+				{
+					data.insert(data.end(), buffer, buffer + count);
+				}
+				fclose(fp);
+			}
+			return data;
+		}
+
+		void writeFile(const std::string& name, const std::vector<U8>& data) const
+		{
+			LLFILE* fp = LLFile::fopen(path(name), "wb");
+			ensure("rewrote " + name, fp && fwrite(&data[0], 1, data.size(), fp) == data.size());
+			fclose(fp);
+		}
+
+		U64 segmentBytes() const
+		{
+			U64 total = 0;
+			std::string name;
+			LLDirIterator iter(mDir, "vfs_*.seg");
+			while (iter.next(name))
+			{
+				llstat st;
+				if (!LLFile::stat(path(name), &st))
+				{
+					total += st.st_size;
+				}
+			}
+			return total;
+		}
+
+		static std::vector<U8> pattern(S32 size, U8 seed)
+		{
+			std::vector<U8> data(size);
+			for (S32 i = 0; i < size; ++i)
+			{
+				data[i] = (U8)(seed + i * 7);
+			}
+			return data;
+		}
+
+		static void storeFile(LLVFSLogStore& store, const LLVFSFileSpecifier& spec, const std::vector<U8>& data)
+		{
+			ensure("set max size", store.setMaxSize(spec, (S32)data.size()));
+			ensure_equals("stored", store.storeData(spec, &data[0], 0, (S32)data.size()), (S32)data.size());
+		}
+
+		static void ensureFile(const std::string& msg, LLVFSLogStore& store, const LLVFSFileSpecifier& spec, const std::vector<U8>& data)
+		{
+			ensure_equals(msg + " size", store.getSize(spec), (S32)data.size());
+			std::vector<U8> buffer(data.size());
+			ensure_equals(msg + " read", store.getData(spec, &buffer[0], 0, (S32)buffer.size()), (S32)buffer.size());
+			ensure(msg + " contents", buffer == data);
+		}
+	};
+
+	typedef test_group<vfslogstore_test> vfslogstore_t;
+	typedef vfslogstore_t::object vfslogstore_object_t;
+	tut::vfslogstore_t tut_vfslogstore("LLVFSLogStore");
+
+	// Writes, overwrites, renames and removals come back the same way from
+	// the checkpoint and from replaying the segments
+	template<> template<>
+	void vfslogstore_object_t::test<1>()
+	{
+		LLVFSFileSpecifier a(LLUUID::generateNewID(), LLAssetType::AT_TEXTURE);
+		LLVFSFileSpecifier b(LLUUID::generateNewID(), LLAssetType::AT_SOUND);
+		LLVFSFileSpecifier c(LLUUID::generateNewID(), LLAssetType::AT_MESH);
+		LLVFSFileSpecifier d(LLUUID::generateNewID(), LLAssetType::AT_MESH);
+
+		std::vector<U8> data_a = pattern(10000, 1);
+		std::vector<U8> data_b = pattern(3000, 2);
+		std::vector<U8> patch = pattern(500, 3);
+		{
+			LLVFSLogStore store(mDir, 64 * 1024 * 1024);
+			ensure("open", store.open());
+			storeFile(store, a, data_a);
+			storeFile(store, b, data_b);
+			storeFile(store, c, pattern(100, 4));
+			ensure_equals("patch", store.storeData(a, &patch[0], 2000, (S32)patch.size()), (S32)patch.size());
+			store.renameFile(b, d);
+			store.removeFile(c);
+		}
+		std::copy(patch.begin(), patch.end(), data_a.begin() + 2000);
+
+		// Once from the checkpoint written by close(), then by replay
+		for (S32 pass = 0; pass < 2; ++pass)
+		{
+			std::string msg = pass ? "replay" : "checkpoint";
+			LLVFSLogStore store(mDir, 64 * 1024 * 1024);
+			ensure(msg + " open", store.open());
+			ensureFile(msg + " a", store, a, data_a);
+			ensureFile(msg + " d", store, d, data_b);
+			ensure(msg + " b renamed away", !store.getExists(b));
+			ensure(msg + " c removed", !store.getExists(c));
+
+			std::vector<std::pair<LLVFSFileSpecifier, S32> > files;
+			store.getFileList(files);
+			ensure_equals(msg + " file list", files.size(), (size_t)2);
+			if (!pass)
+			{
+				store.close();
+				LLFile::remove(path("index.vfx"));
+			}
+		}
+	}
+
+	// A write cut short by a crash is dropped, everything before it survives
+	template<> template<>
+	void vfslogstore_object_t::test<2>()
+	{
+		LLVFSFileSpecifier a(LLUUID::generateNewID(), LLAssetType::AT_TEXTURE);
+		LLVFSFileSpecifier b(LLUUID::generateNewID(), LLAssetType::AT_TEXTURE);
+		std::vector<U8> data_a = pattern(4000, 5);
+		{
+			LLVFSLogStore store(mDir, 64 * 1024 * 1024);
+			ensure("open", store.open());
+			storeFile(store, a, data_a);
+			storeFile(store, b, pattern(4000, 6));
+		}
+		LLFile::remove(path("index.vfx"));
+
+		std::vector<U8> segment = readFile("vfs_00000001.seg");
+		ensure("segment written", segment.size() > 8000);
+		segment.resize(segment.size() - 100);
+		writeFile("vfs_00000001.seg", segment);
+
+		LLVFSLogStore store(mDir, 64 * 1024 * 1024);
+		ensure("open", store.open());
+		ensureFile("a", store, a, data_a);
+		ensure_equals("torn write dropped", store.getSize(b), 0);
+	}
+
+	// A damaged payload in the middle of the log drops its file instead of
+	// reading back as data
+	template<> template<>
+	void vfslogstore_object_t::test<3>()
+	{
+		LLVFSFileSpecifier a(LLUUID::generateNewID(), LLAssetType::AT_TEXTURE);
+		LLVFSFileSpecifier b(LLUUID::generateNewID(), LLAssetType::AT_TEXTURE);
+		std::vector<U8> data_b = pattern(4000, 8);
+		{
+			LLVFSLogStore store(mDir, 64 * 1024 * 1024);
+			ensure("open", store.open());
+			storeFile(store, a, pattern(4000, 7));
+			storeFile(store, b, data_b);
+		}
+		LLFile::remove(path("index.vfx"));
+
+		// The payload of a's data record follows its max size and data record headers
+		std::vector<U8> segment = readFile("vfs_00000001.seg");
+		segment[SEGMENT_HEADER_BYTES + 2 * RECORD_HEADER_BYTES + 10] ^= 0xff;
+		writeFile("vfs_00000001.seg", segment);
+
+		LLVFSLogStore store(mDir, 64 * 1024 * 1024);
+		ensure("open", store.open());
+		ensure("damaged file dropped", !store.getExists(a));
+		ensureFile("b", store, b, data_b);
+	}
+
+	// The compactor keeps the segments within budget and never loses the
+	// newest files
+	template<> template<>
+	void vfslogstore_object_t::test<4>()
+	{
+		const U64 budget = 8 * 1024 * 1024;
+		const S32 file_size = 64 * 1024;
+		const S32 file_count = 160;
+
+		LLVFSLogStore store(mDir, budget);
+		ensure("open", store.open());
+		std::vector<LLVFSFileSpecifier> specs;
+		for (S32 i = 0; i < file_count; ++i)
+		{
+			specs.push_back(LLVFSFileSpecifier(LLUUID::generateNewID(), LLAssetType::AT_TEXTURE));
+			storeFile(store, specs.back(), pattern(file_size, (U8)i));
+		}
+
+		for (S32 i = 0; i < 200 && segmentBytes() > budget; ++i)
+		{
+			ms_sleep(50);
+		}
+		ensure("segments within budget", segmentBytes() <= budget);
+
+		std::vector<std::pair<LLVFSFileSpecifier, S32> > files;
+		store.getFileList(files);
+		ensure("files evicted", files.size() < (size_t)file_count);
+		ensureFile("newest", store, specs.back(), pattern(file_size, (U8)(file_count - 1)));
+	}
+
+	// A damaged checkpoint is ignored in favour of replaying the segments
+	template<> template<>
+	void vfslogstore_object_t::test<5>()
+	{
+		LLVFSFileSpecifier a(LLUUID::generateNewID(), LLAssetType::AT_OBJECT);
+		std::vector<U8> data_a = pattern(6000, 9);
+		{
+			LLVFSLogStore store(mDir, 64 * 1024 * 1024);
+			ensure("open", store.open());
+			storeFile(store, a, data_a);
+		}
+
+		std::vector<U8> checkpoint = readFile("index.vfx");
+		ensure("checkpoint written", checkpoint.size() > RECORD_HEADER_BYTES);
+		checkpoint[checkpoint.size() / 2] ^= 0xff;
+		writeFile("index.vfx", checkpoint);
+
+		LLVFSLogStore store(mDir, 64 * 1024 * 1024);
+		ensure("open", store.open());
+		ensureFile("a", store, a, data_a);
+	}
+
+	// A bad record header in an older segment hides records that may have
+	// removed or rewritten anything, so the log is discarded rather than
+	// bringing removed files back
+	template<> template<>
+	void vfslogstore_object_t::test<6>()
+	{
+		LLVFSFileSpecifier a(LLUUID::generateNewID(), LLAssetType::AT_TEXTURE);
+		LLVFSFileSpecifier b(LLUUID::generateNewID(), LLAssetType::AT_TEXTURE);
+		LLVFSFileSpecifier c(LLUUID::generateNewID(), LLAssetType::AT_TEXTURE);
+		const S32 size_a = 4000;
+		{
+			// 1 MB segments, c doesn't fit in the first one
+			LLVFSLogStore store(mDir, 8 * 1024 * 1024);
+			ensure("open", store.open());
+			storeFile(store, a, pattern(size_a, 10));
+			storeFile(store, b, pattern(4000, 11));
+			store.removeFile(a);
+			storeFile(store, c, pattern(1200 * 1024, 12));
+		}
+		LLFile::remove(path("index.vfx"));
+		ensure("second segment written", !readFile("vfs_00000002.seg").empty());
+
+		// b's max size record follows a's max size and data records
+		std::vector<U8> segment = readFile("vfs_00000001.seg");
+		segment[SEGMENT_HEADER_BYTES + 2 * RECORD_HEADER_BYTES + size_a + 4] ^= 0xff;
+		writeFile("vfs_00000001.seg", segment);
+
+		LLVFSLogStore store(mDir, 8 * 1024 * 1024);
+		ensure("open", store.open());
+		ensure("removed file stays removed", !store.getExists(a));
+		ensure("log discarded", !store.getExists(c));
+
+		LLVFSFileSpecifier d(LLUUID::generateNewID(), LLAssetType::AT_TEXTURE);
+		std::vector<U8> data_d = pattern(3000, 13);
+		storeFile(store, d, data_d);
+		ensureFile("d", store, d, data_d);
+	}
+}
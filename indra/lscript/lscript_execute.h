@@ -533,6 +533,17 @@ public:
 	// Returns new set of handled events.
 	virtual U64 nextState(); 
 
+	// Runs handler code from the decoded ops below rather than one
+	// mExecuteFuncs call per instruction, same yields and faults.
+	virtual F32 runQuanta(BOOL b_print, const LLUUID &id,
+						  const char **errorstr, 
+						  F32 quanta,
+						  U32& events_processed, LLTimer& timer);
+
+	// Off runs every instruction through mExecuteFuncs, for comparisons.
+	static void		setThreadedCode( bool value )			{ sThreadedCode = value;		}
+	static bool		getThreadedCode()						{ return sThreadedCode;			}
+
 	void init();
 
 	BOOL (*mExecuteFuncs[0x100])(U8 *buffer, S32 &offset, BOOL b_print, const LLUUID &id);
@@ -544,6 +555,27 @@ public:
 	U32						mBytecodeSize;
 
 private:
+	// An instruction decoded in place, found by its offset from GFR.  Ops
+	// the runner doesn't handle itself go to mExecuteFuncs as before.
+	struct ThreadedOp
+	{
+		const void*	mLabel;		// handler in runThreaded(), where supported
+		S32			mArg;		// operand, or code index of a jump target
+		U8			mKind;
+		U8			mLength;
+	};
+
+	// Runs at most budget instructions, stopping early on a fault or after
+	// one that went through mExecuteFuncs, clearing in_handler then.
+	// Returns the number run.
+	S32 runThreaded(const LLUUID &id, S32 budget, bool &in_handler);
+	void decodeThreadedOp(S32 index, S32 gfr, S32 hr);
+
+	std::vector<ThreadedOp>	mThreadedCode;
+	S32						mThreadedCodeBase;	// GFR the code was decoded at
+
+	static bool sThreadedCode;
+
 	S32 getMajorVersion() const;
 	void		recordBoundaryError( const LLUUID &id );
 	void		setStateEventOpcoodeStartSafely( S32 state, LSCRIPTStateEventType event, const LLUUID &id );
@@ -0,0 +1,439 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/**
+ * @file lscript_bench.cpp
+ * @brief Times running LSL2 bytecode with the legacy and the threaded dispatch
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "llcommon.h"
+#include "llfile.h"
+#include "lltimer.h"
+#include "lluuid.h"
+#include "lscript_execute.h"
+
+// Each program is run from its first instruction until it is done, with
+// every instruction going through mExecuteFuncs ("legacy") and then
+// through the threaded code.  Both runs must leave the same memory image
+// or the run fails.
+//
+// The compiler doesn't build with the rest of the tree, so the corpus is
+// bytecode: the built-in programs are assembled here from the scripts in
+// examples/scripts, and .lso files compiled elsewhere can be given on the
+// command line.  Library calls are the stubs from lscript_library, so
+// .lso files should be scripts that do their own work.
+
+namespace
+{
+	// Quanta a pass may take before the program is taken to never finish
+	const S32 MAX_QUANTA = 1000000;
+
+	// Where the built-in programs keep their globals and code
+	const S32 BENCH_GVR = 0x80;
+	const S32 BENCH_GFR = 0x100;
+
+	struct Program
+	{
+		std::string mName;
+		std::vector<U8> mBytecode;
+		// Built-in programs run as the current handler from GFR and stop on
+		// an integer division by zero, instead of a handler and an event queue
+		bool mEndsOnMathFault;
+	};
+
+	// Just enough of an assembler for the built-in programs
+	class Assembler
+	{
+	public:
+		void op(LSCRIPTOpCodesEnum opcode)	{ mCode.push_back(LSCRIPTOpCodes[opcode]); }
+		void byte(U8 value)					{ mCode.push_back(value); }
+
+		void integer(S32 value)
+		{
+			byte((U8)(value >> 24));
+			byte((U8)(value >> 16));
+			byte((U8)(value >> 8));
+			byte((U8)value);
+		}
+
+		void real(F32 value)
+		{
+			S32 bits;
+			memcpy(&bits, &value, sizeof(bits));
+			integer(bits);
+		}
+
+		// Type byte of an op on two operands of the same type
+		void types(LSCRIPTType type)		{ byte((U8)((LSCRIPTTypeByte[type] << 4) | LSCRIPTTypeByte[type])); }
+
+		S32 here() const					{ return (S32)mCode.size(); }
+
+		// Jumps are relative to the end of the instruction
+		void jump(S32 target)
+		{
+			op(LOPC_JUMP);
+			integer(target - (here() + 4));
+		}
+
+		// Returns where the offset goes, for land()
+		S32 jumpIfNot()
+		{
+			op(LOPC_JUMPNIF);
+			byte(LSCRIPTTypeByte[LST_INTEGER]);
+			S32 at = here();
+			integer(0);
+			return at;
+		}
+
+		void land(S32 at)
+		{
+			S32 offset = at;
+			integer2bytestream(&mCode[0], offset, here() - (at + 4));
+		}
+
+		// Divides by zero, which ends the program on a math fault
+		void end()
+		{
+			op(LOPC_PUSHARGI); integer(0);
+			op(LOPC_PUSHARGI); integer(0);
+			op(LOPC_DIV); types(LST_INTEGER);
+		}
+
+		std::vector<U8> image() const
+		{
+			std::vector<U8> image(BENCH_GFR + mCode.size() + 16, 0);
+			memcpy(&image[BENCH_GFR], &mCode[0], mCode.size());
+
+			const S32 hr = BENCH_GFR + (S32)mCode.size() + 16;
+			setRegister(image, LREG_TM, TOP_OF_MEMORY);
+			setRegister(image, LREG_IP, BENCH_GFR);
+			setRegister(image, LREG_VN, LSL2_VERSION_NUMBER);
+			setRegister(image, LREG_BP, TOP_OF_MEMORY - 1);
+			setRegister(image, LREG_SP, TOP_OF_MEMORY - 1);
+			setRegister(image, LREG_HR, hr);
+			setRegister(image, LREG_HP, hr + 4);
+			setRegister(image, LREG_GVR, BENCH_GVR);
+			setRegister(image, LREG_GFR, BENCH_GFR);
+			setRegister(image, LREG_SR, BENCH_GFR);
+			return image;
+		}
+
+	private:
+		static void setRegister(std::vector<U8>& image, LSCRIPTRegisters reg, S32 value)
+		{
+			S32 offset = gLSCRIPTRegisterAddresses[reg];
+			integer2bytestream(&image[0], offset, value);
+		}
+
+		std::vector<U8> mCode;
+	};
+
+	// examples/scripts/arithmetic.lsl with fib() and damp() inlined.  Binary
+	// ops take their left operand from the top of the stack.
+	std::vector<U8> assemble_arithmetic()
+	{
+		enum { I = 0, SUM = 4, F = 8, N = 12, A = 16, B = 20, J = 24, T = 28, LOCALS = 8 };
+
+		Assembler code;
+		for (S32 i = 0; i < LOCALS; ++i)
+		{
+			code.op(LOPC_PUSHE);
+		}
+
+		// for (i = 0; i < 20000; ++i)
+		const S32 outer = code.here();
+		code.op(LOPC_PUSHARGI); code.integer(20000);
+		code.op(LOPC_PUSH); code.integer(I);
+		code.op(LOPC_LESS); code.types(LST_INTEGER);
+		const S32 outer_done = code.jumpIfNot();
+
+		// fib(i & 31)
+		code.op(LOPC_PUSHARGI); code.integer(31);
+		code.op(LOPC_PUSH); code.integer(I);
+		code.op(LOPC_BITAND);
+		code.op(LOPC_LOADP); code.integer(N);
+		code.op(LOPC_PUSHARGI); code.integer(0);
+		code.op(LOPC_LOADP); code.integer(A);
+		code.op(LOPC_PUSHARGI); code.integer(1);
+		code.op(LOPC_LOADP); code.integer(B);
+		code.op(LOPC_PUSHARGI); code.integer(0);
+		code.op(LOPC_LOADP); code.integer(J);
+
+		const S32 fib = code.here();
+		code.op(LOPC_PUSH); code.integer(N);
+		code.op(LOPC_PUSH); code.integer(J);
+		code.op(LOPC_LESS); code.types(LST_INTEGER);
+		const S32 fib_done = code.jumpIfNot();
+		code.op(LOPC_PUSH); code.integer(B);
+		code.op(LOPC_PUSH); code.integer(A);
+		code.op(LOPC_ADD); code.types(LST_INTEGER);
+		code.op(LOPC_LOADP); code.integer(T);
+		code.op(LOPC_PUSH); code.integer(B);
+		code.op(LOPC_LOADP); code.integer(A);
+		code.op(LOPC_PUSH); code.integer(T);
+		code.op(LOPC_LOADP); code.integer(B);
+		code.op(LOPC_PUSH); code.integer(J);
+		code.op(LOPC_PUSHARGI); code.integer(1);
+		code.op(LOPC_ADD); code.types(LST_INTEGER);
+		code.op(LOPC_LOADP); code.integer(J);
+		code.jump(fib);
+		code.land(fib_done);
+
+		// sum = sum ^ fib(i & 31)
+		code.op(LOPC_PUSH); code.integer(A);
+		code.op(LOPC_PUSH); code.integer(SUM);
+		code.op(LOPC_BITXOR);
+		code.op(LOPC_LOADP); code.integer(SUM);
+
+		// f = damp(f, 100.0)
+		code.op(LOPC_PUSH); code.integer(F);
+		code.op(LOPC_PUSHARGF); code.real(100.f);
+		code.op(LOPC_SUB); code.types(LST_FLOATINGPOINT);
+		code.op(LOPC_PUSHARGF); code.real(0.25f);
+		code.op(LOPC_MUL); code.types(LST_FLOATINGPOINT);
+		code.op(LOPC_PUSH); code.integer(F);
+		code.op(LOPC_ADD); code.types(LST_FLOATINGPOINT);
+		code.op(LOPC_LOADP); code.integer(F);
+
+		// if (f > 99.0 && sum != 0) f = 0.0;
+		code.op(LOPC_PUSHARGF); code.real(99.f);
+		code.op(LOPC_PUSH); code.integer(F);
+		code.op(LOPC_GREATER); code.types(LST_FLOATINGPOINT);
+		code.op(LOPC_PUSHARGI); code.integer(0);
+		code.op(LOPC_PUSH); code.integer(SUM);
+		code.op(LOPC_NEQ); code.types(LST_INTEGER);
+		code.op(LOPC_BOOLAND);
+		const S32 no_reset = code.jumpIfNot();
+		code.op(LOPC_PUSHARGF); code.real(0.f);
+		code.op(LOPC_LOADP); code.integer(F);
+		code.land(no_reset);
+
+		code.op(LOPC_PUSH); code.integer(I);
+		code.op(LOPC_PUSHARGI); code.integer(1);
+		code.op(LOPC_ADD); code.types(LST_INTEGER);
+		code.op(LOPC_LOADP); code.integer(I);
+		code.jump(outer);
+		code.land(outer_done);
+
+		code.end();
+		return code.image();
+	}
+
+	bool load_bytecode(const std::string& filename, std::vector<U8>& bytecode)
+	{
+		LLFILE* file = LLFile::fopen(filename, "rb");
+		if (!file)
+		{
+			std::cerr << "Unable to open " << filename << std::endl;
+			return false;
+		}
+		bytecode.resize(TOP_OF_MEMORY);
+		size_t size = fread(&bytecode[0], 1, bytecode.size(), file);
+		fclose(file);
+		S32 offset = 0;
+		if (size != (size_t)TOP_OF_MEMORY || bytestream2integer(&bytecode[0], offset) != TOP_OF_MEMORY)
+		{
+			std::cerr << filename << " isn't LSL2 bytecode" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	// Runs from a reset until there's nothing left to do, returns the
+	// fault if there was one
+	const char* run_program(LLScriptExecuteLSL2& script, const Program& program, F32 quanta)
+	{
+		const LLUUID id;
+		const char* error = NULL;
+		U32 events_processed = 0;
+		script.reset();
+		for (S32 i = 0; i < MAX_QUANTA; ++i)
+		{
+			LLTimer timer;
+			script.runQuanta(FALSE, id, &error, quanta, events_processed, timer);
+			if (error)
+			{
+				if (program.mEndsOnMathFault && get_register(script.mBuffer, LREG_FR) == LSRF_MATH)
+				{
+					return NULL;
+				}
+				return error;
+			}
+			// Nothing wakes sleeping scripts up here
+			if (script.getSleep() > 0.f)
+			{
+				script.setSleep(0.f);
+			}
+			if (script.isFinished() && !script.isStateChangePending()
+				&& !(script.getCurrentEvents() & script.getEventHandlers()))
+			{
+				return NULL;
+			}
+		}
+		return "Never finished";
+	}
+
+	void usage(std::ostream& out)
+	{
+		out << "\n"
+			"usage:\tlscript_bench [-i iterations] [-q quanta] [script.lso ...]\n"
+			"\n"
+			"Runs each program with the legacy dispatch and with threaded code,\n"
+			"checking that both end the same, and reports instructions per\n"
+			"second.  Without any .lso files (LSL2 bytecode from a compiler) it\n"
+			"runs the built-in programs assembled from examples/scripts.\n"
+			"\n"
+			"Options:\n"
+			"\n"
+			" -i <count>    Runs of each program (default 20)\n"
+			" -q <seconds>  Time slice per runQuanta() call (default 0.01)\n"
+			<< std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	S32 iterations = 20;
+	F32 quanta = 0.01f;
+	std::vector<std::string> files;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg(argv[i]);
+		if (arg == "-i" && i + 1 < argc)
+		{
+			iterations = atoi(argv[++i]);
+			if (iterations <= 0)
+			{
+				usage(std::cerr);
+				return 1;
+			}
+		}
+		else if (arg == "-q" && i + 1 < argc)
+		{
+			quanta = (F32)atof(argv[++i]);
+			if (quanta <= 0.f)
+			{
+				usage(std::cerr);
+				return 1;
+			}
+		}
+		else if (arg[0] != '-')
+		{
+			files.push_back(arg);
+		}
+		else
+		{
+			usage(std::cerr);
+			return 1;
+		}
+	}
+
+	LLCommon::initClass();
+
+	bool matched = true;
+	std::vector<Program> programs;
+	if (files.empty())
+	{
+		programs.push_back({ "arithmetic", assemble_arithmetic(), true });
+	}
+	for (const std::string& filename : files)
+	{
+		Program program;
+		program.mEndsOnMathFault = false;
+		if (!load_bytecode(filename, program.mBytecode))
+		{
+			matched = false;
+			continue;
+		}
+		program.mName = filename;
+		size_t slash = program.mName.find_last_of("/\\");
+		if (slash != std::string::npos)
+		{
+			program.mName = program.mName.substr(slash + 1);
+		}
+		programs.push_back(program);
+	}
+
+	printf("%-24s %-8s %12s %12s %10s %8s\n", "program", "dispatch", "inst/run", "ms/run", "Minst/s", "speedup");
+	for (const Program& program : programs)
+	{
+		std::vector<U8> reference;
+		F64 reference_ms = 0.0;
+		for (S32 threaded = 0; threaded < 2; ++threaded)
+		{
+			LLScriptExecuteLSL2::setThreadedCode(threaded != 0);
+			LLScriptExecuteLSL2 script(&program.mBytecode[0], (U32)program.mBytecode.size());
+
+			// warm up, and the decode for the threaded code
+			const char* error = run_program(script, program, quanta);
+			U32 start_count = script.mInstructionCount;
+			S32 runs = 0;
+			LLTimer timer;
+			while (runs < iterations && !error)
+			{
+				error = run_program(script, program, quanta);
+				++runs;
+			}
+			F64 ms = timer.getElapsedTimeF64() * 1000.0 / llmax(runs, 1);
+			U32 instructions = (script.mInstructionCount - start_count) / llmax(runs, 1);
+
+			if (!threaded)
+			{
+				reference.assign(script.mBuffer, script.mBuffer + TOP_OF_MEMORY);
+				reference_ms = ms;
+			}
+			else if (memcmp(&reference[0], script.mBuffer, TOP_OF_MEMORY))
+			{
+				std::cerr << program.mName << " ended differently with threaded code" << std::endl;
+				matched = false;
+			}
+			if (error)
+			{
+				matched = false;
+			}
+			printf("%-24s %-8s %12u %12.3f %10.1f %7.2fx%s%s\n",
+				   program.mName.c_str(), threaded ? "threaded" : "legacy", instructions, ms,
+				   ms > 0.0 ? instructions / (ms * 1000.0) : 0.0,
+				   ms > 0.0 ? reference_ms / ms : 0.0,
+				   error ? " " : "", error ? error : "");
+		}
+	}
+
+	LLScriptExecuteLSL2::setThreadedCode(true);
+	LLCommon::cleanupClass();
+
+	if (!matched)
+	{
+		return 1;
+	}
+	return 0;
+}
@@ -47,6 +47,7 @@
 // Static
 const	S32	DEFAULT_SCRIPT_TIMER_CHECK_SKIP = 4;
 S32		LLScriptExecute::sTimerCheckSkip = DEFAULT_SCRIPT_TIMER_CHECK_SKIP;
+bool	LLScriptExecuteLSL2::sThreadedCode = true;
 
 void (*binary_operations[LST_EOF][LST_EOF])(U8 *buffer, LSCRIPTOpCodesEnum opcode);
 void (*unary_operations[LST_EOF])(U8 *buffer, LSCRIPTOpCodesEnum opcode);
@@ -124,6 +125,7 @@ void LLScriptExecuteLSL2::init()
 	S32 i, j;
 
 	mInstructionCount = 0;
+	mThreadedCodeBase = 0;
 
 	for (i = 0; i < 256; i++)
 	{
@@ -424,10 +426,11 @@ void LLScriptExecuteLSL2::callEventHandler(LSCRIPTStateEventType event, const LL
 void LLScriptExecuteLSL2::callQueuedEventHandler(LSCRIPTStateEventType event, const LLUUID &id, F32 time_slice)
 {
 	S32 major_version = getMajorVersion();
-	LLScriptDataCollection* eventdata;
+	std::list<LLScriptDataCollection*>& events = mEventData.mEventDataList;
 
-	for (eventdata = mEventData.mEventDataList.getFirstData(); eventdata; eventdata = mEventData.mEventDataList.getNextData())
+	for (std::list<LLScriptDataCollection*>::iterator it = events.begin(); it != events.end(); ++it)
 	{
+		LLScriptDataCollection* eventdata = *it;
 		if (eventdata->mType == event)
 		{
 			// push a zero to be popped
@@ -465,7 +468,8 @@ void LLScriptExecuteLSL2::callQueuedEventHandler(LSCRIPTStateEventType event, co
 			S32			opcode_start = get_state_event_opcoode_start(mBuffer, current_state, event);
 			set_ip(mBuffer, opcode_start);
 
-			mEventData.mEventDataList.deleteCurrentData();
+			delete eventdata;
+			events.erase(it);
 			break;
 		}
 	}
@@ -666,6 +670,8 @@ S32 LLScriptExecuteLSL2::writeBytecode(U8 **dest)
 
 S32 LLScriptExecuteLSL2::readState(U8 *src)
 {
+	mThreadedCode.clear();
+
 	// first, blitz heap and stack
 	S32 hr = get_register(mBuffer, LREG_HR);
 	S32 tm = get_register(mBuffer, LREG_TM);
@@ -726,6 +732,7 @@ S32 LLScriptExecuteLSL2::readState(U8 *src)
 void LLScriptExecuteLSL2::reset()
 {
 	LLScriptExecute::reset();
+	mThreadedCode.clear();
 
 	const U8 *src = getBytecode();
 	S32 size = getBytecodeSize();
@@ -975,6 +982,559 @@ F32 LLScriptExecute::runNested(BOOL b_print, const LLUUID &id, const char **erro
 	return LLScriptExecute::runQuanta(b_print, id, errorstr, quanta, events_processed, timer);
 }
 
+//
+// Threaded code for LSL2
+//
+// Handler code doesn't change while a script runs, so each instruction is
+// decoded once into mThreadedCode and the common stack, arithmetic and
+// jump ops run straight from there.  They use the same checked stack and
+// variable helpers as their run_ functions, so faults land exactly where
+// they did; everything else still goes through mExecuteFuncs.
+//
+
+#if defined(__GNUC__)
+// Each decoded op holds the address of its handler (labels as values)
+#define LSCRIPT_DIRECT_THREADED
+#endif
+
+typedef BOOL (*execute_func_t)(U8 *buffer, S32 &offset, BOOL b_print, const LLUUID &id);
+
+enum
+{
+	LTOP_DECODE,
+	LTOP_SLOW,
+	LTOP_NOOP,
+	LTOP_POP,
+	LTOP_DUP,
+	LTOP_PUSHE,
+	LTOP_STORE,
+	LTOP_STOREG,
+	LTOP_LOADP,
+	LTOP_LOADGP,
+	LTOP_PUSH,
+	LTOP_PUSHG,
+	LTOP_PUSHARGB,
+	LTOP_PUSHARG,
+	LTOP_ADD_I,
+	LTOP_SUB_I,
+	LTOP_MUL_I,
+	LTOP_EQ_I,
+	LTOP_NEQ_I,
+	LTOP_LEQ_I,
+	LTOP_GEQ_I,
+	LTOP_LESS_I,
+	LTOP_GREATER_I,
+	LTOP_BITAND,
+	LTOP_BITOR,
+	LTOP_BITXOR,
+	LTOP_BOOLAND,
+	LTOP_BOOLOR,
+	LTOP_SHL,
+	LTOP_SHR,
+	LTOP_ADD_F,
+	LTOP_SUB_F,
+	LTOP_MUL_F,
+	LTOP_EQ_F,
+	LTOP_NEQ_F,
+	LTOP_LEQ_F,
+	LTOP_GEQ_F,
+	LTOP_LESS_F,
+	LTOP_GREATER_F,
+	LTOP_NEG_I,
+	LTOP_NEG_F,
+	LTOP_BITNOT,
+	LTOP_BOOLNOT,
+	LTOP_JUMP,
+	LTOP_JUMPIF_I,
+	LTOP_JUMPIF_F,
+	LTOP_JUMPNIF_I,
+	LTOP_JUMPNIF_F,
+	LTOP_EOF
+};
+
+struct LLThreadedOpDesc
+{
+	execute_func_t	mFunc;
+	U8				mLength;
+	U8				mKind;		// untyped ops
+	U8				mIntKind;	// typed ops, on integers
+	U8				mFloatKind;	// typed ops, on floats
+};
+
+static const LLThreadedOpDesc sThreadedOpDescs[] =
+{
+	{ run_noop,		1, LTOP_NOOP,		LTOP_SLOW,		LTOP_SLOW },
+	{ run_pop,		1, LTOP_POP,		LTOP_SLOW,		LTOP_SLOW },
+	{ run_dup,		1, LTOP_DUP,		LTOP_SLOW,		LTOP_SLOW },
+	{ run_pushe,	1, LTOP_PUSHE,		LTOP_SLOW,		LTOP_SLOW },
+	{ run_store,	5, LTOP_STORE,		LTOP_SLOW,		LTOP_SLOW },
+	{ run_storeg,	5, LTOP_STOREG,		LTOP_SLOW,		LTOP_SLOW },
+	{ run_loadp,	5, LTOP_LOADP,		LTOP_SLOW,		LTOP_SLOW },
+	{ run_loadgp,	5, LTOP_LOADGP,		LTOP_SLOW,		LTOP_SLOW },
+	{ run_push,		5, LTOP_PUSH,		LTOP_SLOW,		LTOP_SLOW },
+	{ run_pushg,	5, LTOP_PUSHG,		LTOP_SLOW,		LTOP_SLOW },
+	{ run_pushargb,	2, LTOP_PUSHARGB,	LTOP_SLOW,		LTOP_SLOW },
+	{ run_pushargi,	5, LTOP_PUSHARG,	LTOP_SLOW,		LTOP_SLOW },
+	{ run_pushargf,	5, LTOP_PUSHARG,	LTOP_SLOW,		LTOP_SLOW },
+	{ run_bitand,	1, LTOP_BITAND,		LTOP_SLOW,		LTOP_SLOW },
+	{ run_bitor,	1, LTOP_BITOR,		LTOP_SLOW,		LTOP_SLOW },
+	{ run_bitxor,	1, LTOP_BITXOR,		LTOP_SLOW,		LTOP_SLOW },
+	{ run_booland,	1, LTOP_BOOLAND,	LTOP_SLOW,		LTOP_SLOW },
+	{ run_boolor,	1, LTOP_BOOLOR,		LTOP_SLOW,		LTOP_SLOW },
+	{ run_shl,		1, LTOP_SHL,		LTOP_SLOW,		LTOP_SLOW },
+	{ run_shr,		1, LTOP_SHR,		LTOP_SLOW,		LTOP_SLOW },
+	{ run_bitnot,	1, LTOP_BITNOT,		LTOP_SLOW,		LTOP_SLOW },
+	{ run_boolnot,	1, LTOP_BOOLNOT,	LTOP_SLOW,		LTOP_SLOW },
+	{ run_jump,		5, LTOP_JUMP,		LTOP_SLOW,		LTOP_SLOW },
+	// type byte, both sides for binary ops
+	{ run_add,		2, LTOP_SLOW,		LTOP_ADD_I,		LTOP_ADD_F },
+	{ run_sub,		2, LTOP_SLOW,		LTOP_SUB_I,		LTOP_SUB_F },
+	{ run_mul,		2, LTOP_SLOW,		LTOP_MUL_I,		LTOP_MUL_F },
+	{ run_eq,		2, LTOP_SLOW,		LTOP_EQ_I,		LTOP_EQ_F },
+	{ run_neq,		2, LTOP_SLOW,		LTOP_NEQ_I,		LTOP_NEQ_F },
+	{ run_leq,		2, LTOP_SLOW,		LTOP_LEQ_I,		LTOP_LEQ_F },
+	{ run_geq,		2, LTOP_SLOW,		LTOP_GEQ_I,		LTOP_GEQ_F },
+	{ run_less,		2, LTOP_SLOW,		LTOP_LESS_I,	LTOP_LESS_F },
+	{ run_greater,	2, LTOP_SLOW,		LTOP_GREATER_I,	LTOP_GREATER_F },
+	{ run_neg,		2, LTOP_SLOW,		LTOP_NEG_I,		LTOP_NEG_F },
+	// type byte and jump offset
+	{ run_jumpif,	6, LTOP_SLOW,		LTOP_JUMPIF_I,	LTOP_JUMPIF_F },
+	{ run_jumpnif,	6, LTOP_SLOW,		LTOP_JUMPNIF_I,	LTOP_JUMPNIF_F },
+};
+
+static inline bool is_runtime_fault(S32 value)
+{
+	return value > LSRF_INVALID && value < LSRF_EOF;
+}
+
+void LLScriptExecuteLSL2::decodeThreadedOp(S32 index, S32 gfr, S32 hr)
+{
+	ThreadedOp &op = mThreadedCode[index];
+	op.mKind = LTOP_SLOW;
+	op.mLength = 1;
+	op.mArg = 0;
+
+	const S32 ip = gfr + index;
+	const execute_func_t func = mExecuteFuncs[mBuffer[ip]];
+	const LLThreadedOpDesc *desc = NULL;
+	for (U32 i = 0; i < sizeof(sThreadedOpDescs) / sizeof(sThreadedOpDescs[0]); ++i)
+	{
+		if (sThreadedOpDescs[i].mFunc == func)
+		{
+			desc = &sThreadedOpDescs[i];
+			break;
+		}
+	}
+	// The following instruction has to be code as well, or set_ip() faults
+	if (!desc || ip + desc->mLength >= hr)
+	{
+		return;
+	}
+
+	U8 kind = desc->mKind;
+	S32 arg = 0;
+	S32 offset = ip + 1;
+	if (desc->mLength == 2)
+	{
+		U8 type = mBuffer[offset];
+		arg = type;
+		if (func == run_neg)
+		{
+			if (type == LST_INTEGER && unary_operations[LST_INTEGER] == integer_operation)
+			{
+				kind = desc->mIntKind;
+			}
+			else if (type == LST_FLOATINGPOINT && unary_operations[LST_FLOATINGPOINT] == float_operation)
+			{
+				kind = desc->mFloatKind;
+			}
+		}
+		else if (func != run_pushargb)
+		{
+			if (type == ((LST_INTEGER << 4) | LST_INTEGER)
+				&& binary_operations[LST_INTEGER][LST_INTEGER] == integer_integer_operation)
+			{
+				kind = desc->mIntKind;
+			}
+			else if (type == ((LST_FLOATINGPOINT << 4) | LST_FLOATINGPOINT)
+					 && binary_operations[LST_FLOATINGPOINT][LST_FLOATINGPOINT] == float_float_operation)
+			{
+				kind = desc->mFloatKind;
+			}
+		}
+	}
+	else if (desc->mLength == 5)
+	{
+		arg = bytestream2integer(mBuffer, offset);
+		if (func == run_pushargf && !std::isfinite(*(F32 *)&arg))
+		{
+			// Leave the fault to run_pushargf()
+			return;
+		}
+	}
+	else if (desc->mLength == 6)
+	{
+		U8 type = mBuffer[offset++];
+		arg = bytestream2integer(mBuffer, offset);
+		if (type == LST_INTEGER)
+		{
+			kind = desc->mIntKind;
+		}
+		else if (type == LST_FLOATINGPOINT)
+		{
+			kind = desc->mFloatKind;
+		}
+	}
+	else if (kind == LTOP_BITNOT || kind == LTOP_BOOLNOT)
+	{
+		if (unary_operations[LST_INTEGER] != integer_operation)
+		{
+			kind = LTOP_SLOW;
+		}
+	}
+	else if (kind >= LTOP_BITAND && kind <= LTOP_SHR)
+	{
+		if (binary_operations[LST_INTEGER][LST_INTEGER] != integer_integer_operation)
+		{
+			kind = LTOP_SLOW;
+		}
+	}
+
+	if (kind == LTOP_JUMP || (kind >= LTOP_JUMPIF_I && kind <= LTOP_JUMPNIF_F))
+	{
+		// Jumps keep the index they land on, which must be code too
+		S32 target = ip + desc->mLength + arg;
+		if (target < gfr || target >= hr)
+		{
+			return;
+		}
+		arg = target - gfr;
+	}
+
+	op.mKind = kind;
+	op.mLength = desc->mLength;
+	op.mArg = arg;
+}
+
+S32 LLScriptExecuteLSL2::runThreaded(const LLUUID &id, S32 budget, bool &in_handler)
+{
+	U8 *buffer = mBuffer;
+	const S32 gfr = get_register(buffer, LREG_GFR);
+	const S32 hr = get_register(buffer, LREG_HR);
+	const S32 ip = get_register(buffer, LREG_IP);
+	// Each instruction costs energy, kept here until the run ends
+	S32 esr = gLSCRIPTRegisterAddresses[LREG_ESR];
+	S32 energy_bits = bytestream2integer(buffer, esr);
+	F32 energy = *(F32 *)&energy_bits;
+	if (ip < gfr || ip >= hr || !std::isfinite(energy))
+	{
+		// Leave the fault to the usual path
+		resumeEventHandler(FALSE, id, 0.f);
+		in_handler = false;
+		return 1;
+	}
+
+#ifdef LSCRIPT_DIRECT_THREADED
+	static const void* const labels[LTOP_EOF] =
+	{
+		&&op_LTOP_DECODE, &&op_LTOP_SLOW, &&op_LTOP_NOOP, &&op_LTOP_POP, &&op_LTOP_DUP,
+		&&op_LTOP_PUSHE, &&op_LTOP_STORE, &&op_LTOP_STOREG, &&op_LTOP_LOADP, &&op_LTOP_LOADGP,
+		&&op_LTOP_PUSH, &&op_LTOP_PUSHG, &&op_LTOP_PUSHARGB, &&op_LTOP_PUSHARG,
+		&&op_LTOP_ADD_I, &&op_LTOP_SUB_I, &&op_LTOP_MUL_I, &&op_LTOP_EQ_I, &&op_LTOP_NEQ_I,
+		&&op_LTOP_LEQ_I, &&op_LTOP_GEQ_I, &&op_LTOP_LESS_I, &&op_LTOP_GREATER_I,
+		&&op_LTOP_BITAND, &&op_LTOP_BITOR, &&op_LTOP_BITXOR, &&op_LTOP_BOOLAND, &&op_LTOP_BOOLOR,
+		&&op_LTOP_SHL, &&op_LTOP_SHR,
+		&&op_LTOP_ADD_F, &&op_LTOP_SUB_F, &&op_LTOP_MUL_F, &&op_LTOP_EQ_F, &&op_LTOP_NEQ_F,
+		&&op_LTOP_LEQ_F, &&op_LTOP_GEQ_F, &&op_LTOP_LESS_F, &&op_LTOP_GREATER_F,
+		&&op_LTOP_NEG_I, &&op_LTOP_NEG_F, &&op_LTOP_BITNOT, &&op_LTOP_BOOLNOT,
+		&&op_LTOP_JUMP, &&op_LTOP_JUMPIF_I, &&op_LTOP_JUMPIF_F, &&op_LTOP_JUMPNIF_I, &&op_LTOP_JUMPNIF_F
+	};
+#endif
+
+	if (mThreadedCodeBase != gfr || (S32)mThreadedCode.size() != hr - gfr)
+	{
+		ThreadedOp undecoded = { NULL, 0, LTOP_DECODE, 0 };
+#ifdef LSCRIPT_DIRECT_THREADED
+		undecoded.mLabel = labels[LTOP_DECODE];
+#endif
+		mThreadedCode.assign(hr - gfr, undecoded);
+		mThreadedCodeBase = gfr;
+	}
+
+	ThreadedOp *code = &mThreadedCode[0];
+	const ThreadedOp *op = NULL;
+	S32 index = ip - gfr;
+	S32 count = 0;
+	budget = llmax(budget, 1);
+
+#ifdef LSCRIPT_DIRECT_THREADED
+#define LSCRIPT_OP(kind)	op_##kind
+#define LSCRIPT_DISPATCH()	op = code + index; goto *op->mLabel
+#else
+#define LSCRIPT_OP(kind)	case kind
+#define LSCRIPT_DISPATCH()	continue
+#endif
+
+	// Stops after an op that faults, as runInstructions() would
+#define LSCRIPT_NEXT(next_index)										\
+	index = (next_index);												\
+	energy -= 0.1f;														\
+	if (++count >= budget || is_runtime_fault(get_register(buffer, LREG_FR)))	\
+	{																	\
+		goto done;														\
+	}																	\
+	LSCRIPT_DISPATCH()
+
+#define LSCRIPT_INTEGER_OP(kind, expr)									\
+	LSCRIPT_OP(kind):													\
+	{																	\
+		S32 lside = lscript_pop_int(buffer);							\
+		S32 rside = lscript_pop_int(buffer);							\
+		lscript_push(buffer, (S32)(expr));								\
+	}																	\
+	LSCRIPT_NEXT(index + op->mLength);
+
+#define LSCRIPT_FLOAT_OP(kind, result_type, expr)						\
+	LSCRIPT_OP(kind):													\
+	{																	\
+		F32 lside = lscript_pop_float(buffer);							\
+		F32 rside = lscript_pop_float(buffer);							\
+		lscript_push(buffer, (result_type)(expr));						\
+	}																	\
+	LSCRIPT_NEXT(index + op->mLength);
+
+#ifdef LSCRIPT_DIRECT_THREADED
+	LSCRIPT_DISPATCH();
+#else
+	while (true)
+	{
+	op = code + index;
+	switch (op->mKind)
+	{
+#endif
+
+	LSCRIPT_OP(LTOP_DECODE):
+		decodeThreadedOp(index, gfr, hr);
+#ifdef LSCRIPT_DIRECT_THREADED
+		code[index].mLabel = labels[code[index].mKind];
+#endif
+		LSCRIPT_DISPATCH();
+
+	LSCRIPT_OP(LTOP_SLOW):
+		set_register(buffer, LREG_IP, gfr + index);
+		set_register_fp(buffer, LREG_ESR, energy);
+		mInstructionCount += count;
+		resumeEventHandler(FALSE, id, 0.f);
+		in_handler = false;
+		return count + 1;
+
+	LSCRIPT_OP(LTOP_NOOP):
+		LSCRIPT_NEXT(index + op->mLength);
+
+	LSCRIPT_OP(LTOP_POP):
+		lscript_poparg(buffer, LSCRIPTDataSize[LST_INTEGER]);
+		LSCRIPT_NEXT(index + op->mLength);
+
+	LSCRIPT_OP(LTOP_DUP):
+	{
+		S32 sp = get_register(buffer, LREG_SP);
+		S32 value = bytestream2integer(buffer, sp);
+		lscript_push(buffer, value);
+	}
+		LSCRIPT_NEXT(index + op->mLength);
+
+	LSCRIPT_OP(LTOP_PUSHE):
+		lscript_pusharge(buffer, LSCRIPTDataSize[LST_INTEGER]);
+		LSCRIPT_NEXT(index + op->mLength);
+
+	LSCRIPT_OP(LTOP_STORE):
+	{
+		S32 sp = get_register(buffer, LREG_SP);
+		S32 value = bytestream2integer(buffer, sp);
+		lscript_local_store(buffer, op->mArg, value);
+	}
+		LSCRIPT_NEXT(index + op->mLength);
+
+	LSCRIPT_OP(LTOP_STOREG):
+	{
+		S32 sp = get_register(buffer, LREG_SP);
+		S32 value = bytestream2integer(buffer, sp);
+		lscript_global_store(buffer, op->mArg, value);
+	}
+		LSCRIPT_NEXT(index + op->mLength);
+
+	LSCRIPT_OP(LTOP_LOADP):
+	{
+		S32 value = lscript_pop_int(buffer);
+		lscript_local_store(buffer, op->mArg, value);
+	}
+		LSCRIPT_NEXT(index + op->mLength);
+
+	LSCRIPT_OP(LTOP_LOADGP):
+	{
+		S32 value = lscript_pop_int(buffer);
+		lscript_global_store(buffer, op->mArg, value);
+	}
+		LSCRIPT_NEXT(index + op->mLength);
+
+	LSCRIPT_OP(LTOP_PUSH):
+		lscript_push(buffer, lscript_local_get(buffer, op->mArg));
+		LSCRIPT_NEXT(index + op->mLength);
+
+	LSCRIPT_OP(LTOP_PUSHG):
+		lscript_push(buffer, lscript_global_get(buffer, op->mArg));
+		LSCRIPT_NEXT(index + op->mLength);
+
+	LSCRIPT_OP(LTOP_PUSHARGB):
+		lscript_push(buffer, (U8)op->mArg);
+		LSCRIPT_NEXT(index + op->mLength);
+
+	LSCRIPT_OP(LTOP_PUSHARG):
+		// floats too, their bits were checked when decoded
+		lscript_push(buffer, op->mArg);
+		LSCRIPT_NEXT(index + op->mLength);
+
+	LSCRIPT_INTEGER_OP(LTOP_ADD_I, lside + rside)
+	LSCRIPT_INTEGER_OP(LTOP_SUB_I, lside - rside)
+	LSCRIPT_INTEGER_OP(LTOP_MUL_I, lside * rside)
+	LSCRIPT_INTEGER_OP(LTOP_EQ_I, lside == rside)
+	LSCRIPT_INTEGER_OP(LTOP_NEQ_I, lside != rside)
+	LSCRIPT_INTEGER_OP(LTOP_LEQ_I, lside <= rside)
+	LSCRIPT_INTEGER_OP(LTOP_GEQ_I, lside >= rside)
+	LSCRIPT_INTEGER_OP(LTOP_LESS_I, lside < rside)
+	LSCRIPT_INTEGER_OP(LTOP_GREATER_I, lside > rside)
+	LSCRIPT_INTEGER_OP(LTOP_BITAND, lside & rside)
+	LSCRIPT_INTEGER_OP(LTOP_BITOR, lside | rside)
+	LSCRIPT_INTEGER_OP(LTOP_BITXOR, lside ^ rside)
+	LSCRIPT_INTEGER_OP(LTOP_BOOLAND, lside && rside)
+	LSCRIPT_INTEGER_OP(LTOP_BOOLOR, lside || rside)
+	LSCRIPT_INTEGER_OP(LTOP_SHL, lside << rside)
+	LSCRIPT_INTEGER_OP(LTOP_SHR, lside >> rside)
+
+	LSCRIPT_FLOAT_OP(LTOP_ADD_F, F32, lside + rside)
+	LSCRIPT_FLOAT_OP(LTOP_SUB_F, F32, lside - rside)
+	LSCRIPT_FLOAT_OP(LTOP_MUL_F, F32, lside * rside)
+	LSCRIPT_FLOAT_OP(LTOP_EQ_F, S32, lside == rside)
+	LSCRIPT_FLOAT_OP(LTOP_NEQ_F, S32, lside != rside)
+	LSCRIPT_FLOAT_OP(LTOP_LEQ_F, S32, lside <= rside)
+	LSCRIPT_FLOAT_OP(LTOP_GEQ_F, S32, lside >= rside)
+	LSCRIPT_FLOAT_OP(LTOP_LESS_F, S32, lside < rside)
+	LSCRIPT_FLOAT_OP(LTOP_GREATER_F, S32, lside > rside)
+
+	LSCRIPT_OP(LTOP_NEG_I):
+		lscript_push(buffer, -lscript_pop_int(buffer));
+		LSCRIPT_NEXT(index + op->mLength);
+
+	LSCRIPT_OP(LTOP_NEG_F):
+		lscript_push(buffer, -lscript_pop_float(buffer));
+		LSCRIPT_NEXT(index + op->mLength);
+
+	LSCRIPT_OP(LTOP_BITNOT):
+		lscript_push(buffer, ~lscript_pop_int(buffer));
+		LSCRIPT_NEXT(index + op->mLength);
+
+	LSCRIPT_OP(LTOP_BOOLNOT):
+		lscript_push(buffer, (S32)!lscript_pop_int(buffer));
+		LSCRIPT_NEXT(index + op->mLength);
+
+	LSCRIPT_OP(LTOP_JUMP):
+		LSCRIPT_NEXT(op->mArg);
+
+	LSCRIPT_OP(LTOP_JUMPIF_I):
+		LSCRIPT_NEXT(lscript_pop_int(buffer) ? op->mArg : index + op->mLength);
+
+	LSCRIPT_OP(LTOP_JUMPIF_F):
+		LSCRIPT_NEXT(lscript_pop_float(buffer) ? op->mArg : index + op->mLength);
+
+	LSCRIPT_OP(LTOP_JUMPNIF_I):
+		LSCRIPT_NEXT(!lscript_pop_int(buffer) ? op->mArg : index + op->mLength);
+
+	LSCRIPT_OP(LTOP_JUMPNIF_F):
+		LSCRIPT_NEXT(!lscript_pop_float(buffer) ? op->mArg : index + op->mLength);
+
+#ifndef LSCRIPT_DIRECT_THREADED
+	default:
+		llassert(false);
+		goto done;
+	}
+	}
+#endif
+
+#undef LSCRIPT_FLOAT_OP
+#undef LSCRIPT_INTEGER_OP
+#undef LSCRIPT_NEXT
+#undef LSCRIPT_DISPATCH
+#undef LSCRIPT_OP
+
+done:
+	set_register(buffer, LREG_IP, gfr + index);
+	set_register_fp(buffer, LREG_ESR, energy);
+	mInstructionCount += count;
+	if (is_runtime_fault(get_register(buffer, LREG_FR)))
+	{
+		in_handler = false;
+	}
+	return count;
+}
+
+// Same loop as LLScriptExecute::runQuanta(), with the instructions of a
+// running handler taken from runThreaded().  The version, fault and yield
+// tests only need repeating after it ran an op that may change them.
+F32 LLScriptExecuteLSL2::runQuanta(BOOL b_print, const LLUUID &id, const char **errorstr, F32 quanta, U32& events_processed, LLTimer& timer)
+{
+	if (b_print || !sThreadedCode)
+	{
+		return LLScriptExecute::runQuanta(b_print, id, errorstr, quanta, events_processed, timer);
+	}
+
+	const S32 timer_check_skip = LLScriptExecute::getTimerCheckSkip();
+	S32 timer_checks = 0;
+	F32 inloop = 0;
+	bool in_handler = false;
+
+	while(true)
+	{
+		S32 count = 1;
+		if (!in_handler)
+		{
+			in_handler = !isFinished()
+						 && getMajorVersion() != 0
+						 && !is_runtime_fault(getFaults());
+		}
+		if (in_handler)
+		{
+			*errorstr = NULL;
+			// Stop where the plain loop would check the timer
+			count = runThreaded(id, timer_check_skip + 1 - timer_checks, in_handler);
+		}
+		else
+		{
+			runInstructions(b_print, id, errorstr,
+							events_processed, quanta);
+		}
+
+		if(!in_handler && isYieldDue())
+		{
+			break;
+		}
+		timer_checks += count;
+		if(timer_checks > timer_check_skip)
+		{
+			inloop = timer.getElapsedTimeF32();
+			if(inloop > quanta)
+			{
+				break;
+			}
+			timer_checks = 0;
+		}
+	}
+	if (inloop == 0.0f)
+	{
+		inloop = timer.getElapsedTimeF32();
+	}
+	return inloop;
+}
+
 BOOL run_noop(U8 *buffer, S32 &offset, BOOL b_print, const LLUUID &id)
 {
 	if (b_print)
@@ -0,0 +1,277 @@
+/**
+ * @file lscript_execute_test.cpp
+ * @brief Runs the same LSL2 bytecode through the threaded and the plain interpreter loops
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "../llcommon/linden_common.h"
+#include <vector>
+// Class to test
+#include "../lscript_execute.h"
+#include "../llcommon/lltimer.h"
+// Tut header
+#include "../test/lltut.h"
+
+// The scripts below are assembled by hand so the test doesn't need the
+// compiler: globals at GVR, the code at GFR and SR, an empty heap after it
+// and the stack at the top of memory.  The code runs as if it were the
+// current handler, from GFR.
+static const S32 TEST_GVR = 0x80;
+static const S32 TEST_GFR = 0x100;
+
+// Locals, pushed by the first two instructions
+static const S32 LOCAL_I = 0;
+static const S32 LOCAL_SUM = 4;
+
+namespace tut
+{
+	struct lscript_execute_test
+	{
+		std::vector<U8> mCode;
+
+		lscript_execute_test()
+		{
+		}
+		~lscript_execute_test()
+		{
+			LLScriptExecuteLSL2::setThreadedCode(true);
+		}
+
+		void op(LSCRIPTOpCodesEnum opcode)
+		{
+			mCode.push_back(LSCRIPTOpCodes[opcode]);
+		}
+
+		void byte(U8 value)
+		{
+			mCode.push_back(value);
+		}
+
+		void integer(S32 value)
+		{
+			byte((U8)(value >> 24));
+			byte((U8)(value >> 16));
+			byte((U8)(value >> 8));
+			byte((U8)value);
+		}
+
+		void real(F32 value)
+		{
+			S32 bits;
+			memcpy(&bits, &value, sizeof(bits));
+			integer(bits);
+		}
+
+		// Type byte of a binary op on two operands of the same type
+		static U8 types(LSCRIPTType type)
+		{
+			return (U8)((LSCRIPTTypeByte[type] << 4) | LSCRIPTTypeByte[type]);
+		}
+
+		// for (i = 0; i < count; ++i) { sum += i; <body> }, then an integer
+		// division by zero so both runs stop on the same instruction
+		void assemble(S32 count, bool slow_ops, bool float_ops)
+		{
+			const U8 int_types = types(LST_INTEGER);
+			const U8 float_types = types(LST_FLOATINGPOINT);
+
+			op(LOPC_PUSHE);
+			op(LOPC_PUSHE);
+			const S32 loop = (S32)mCode.size();
+			op(LOPC_PUSHARGI); integer(count);
+			op(LOPC_PUSH); integer(LOCAL_I);
+			op(LOPC_LESS); byte(int_types);
+			const S32 exit_jump = (S32)mCode.size();
+			op(LOPC_JUMPNIF); byte(LSCRIPTTypeByte[LST_INTEGER]); integer(0);
+
+			op(LOPC_PUSH); integer(LOCAL_SUM);
+			op(LOPC_PUSH); integer(LOCAL_I);
+			op(LOPC_ADD); byte(int_types);
+			op(LOPC_LOADP); integer(LOCAL_SUM);
+
+			if (slow_ops)
+			{
+				// Run through mExecuteFuncs in the threaded loop
+				op(LOPC_PUSHARGI); integer(7);
+				op(LOPC_PUSH); integer(LOCAL_SUM);
+				op(LOPC_MOD); byte(int_types);
+				op(LOPC_POP);
+				op(LOPC_PUSHARGI); integer(3);
+				op(LOPC_PUSH); integer(LOCAL_I);
+				op(LOPC_DIV); byte(int_types);
+				op(LOPC_LOADP); integer(LOCAL_SUM);
+			}
+			if (float_ops)
+			{
+				op(LOPC_PUSHG); integer(0);
+				op(LOPC_PUSHARGF); real(1.5f);
+				op(LOPC_MUL); byte(float_types);
+				op(LOPC_PUSHARGF); real(0.25f);
+				op(LOPC_ADD); byte(float_types);
+				op(LOPC_STOREG); integer(0);
+				op(LOPC_POP);
+				op(LOPC_PUSHG); integer(0);
+				op(LOPC_NEG); byte(LSCRIPTTypeByte[LST_FLOATINGPOINT]);
+				op(LOPC_PUSHARGF); real(1.f);
+				op(LOPC_GREATER); byte(float_types);
+				op(LOPC_JUMPIF); byte(LSCRIPTTypeByte[LST_INTEGER]); integer(0);
+			}
+
+			op(LOPC_PUSH); integer(LOCAL_I);
+			op(LOPC_PUSHARGI); integer(1);
+			op(LOPC_ADD); byte(int_types);
+			op(LOPC_LOADP); integer(LOCAL_I);
+
+			op(LOPC_PUSH); integer(LOCAL_I);
+			op(LOPC_DUP);
+			op(LOPC_BITNOT);
+			op(LOPC_BOOLNOT);
+			op(LOPC_BITAND);
+			op(LOPC_POP);
+
+			const S32 back_jump = (S32)mCode.size();
+			op(LOPC_JUMP); integer(loop - (back_jump + 5));
+
+			// Jumps are relative to the end of the instruction
+			S32 offset = exit_jump + 2;
+			integer2bytestream(&mCode[0], offset, (S32)mCode.size() - (exit_jump + 6));
+
+			op(LOPC_PUSHARGI); integer(0);
+			op(LOPC_PUSHARGI); integer(0);
+			op(LOPC_DIV); byte(int_types);
+		}
+
+		std::vector<U8> image() const
+		{
+			std::vector<U8> image(TEST_GFR + mCode.size() + 16, 0);
+			memcpy(&image[TEST_GFR], &mCode[0], mCode.size());
+			S32 offset = TEST_GVR;
+			float2bytestream(&image[0], offset, 1.f);
+
+			const S32 hr = TEST_GFR + (S32)mCode.size() + 16;
+			setRegister(image, LREG_TM, TOP_OF_MEMORY);
+			setRegister(image, LREG_IP, TEST_GFR);
+			setRegister(image, LREG_VN, LSL2_VERSION_NUMBER);
+			setRegister(image, LREG_BP, TOP_OF_MEMORY - 1);
+			setRegister(image, LREG_SP, TOP_OF_MEMORY - 1);
+			setRegister(image, LREG_HR, hr);
+			setRegister(image, LREG_HP, hr + 4);
+			setRegister(image, LREG_GVR, TEST_GVR);
+			setRegister(image, LREG_GFR, TEST_GFR);
+			setRegister(image, LREG_SR, TEST_GFR);
+			return image;
+		}
+
+		static void setRegister(std::vector<U8>& image, LSCRIPTRegisters reg, S32 value)
+		{
+			S32 offset = gLSCRIPTRegisterAddresses[reg];
+			integer2bytestream(&image[0], offset, value);
+		}
+
+		// Runs short quanta until the script faults, so how the time is
+		// sliced doesn't matter to the result
+		static const char* run(LLScriptExecuteLSL2& script, bool threaded)
+		{
+			LLScriptExecuteLSL2::setThreadedCode(threaded);
+			LLUUID id;
+			const char* error = NULL;
+			for (S32 i = 0; i < 10000 && !error; ++i)
+			{
+				LLTimer timer;
+				U32 events_processed = 0;
+				script.runQuanta(FALSE, id, &error, 0.01f, events_processed, timer);
+			}
+			return error;
+		}
+
+		void ensureSameRun(const std::string& msg)
+		{
+			std::vector<U8> bytecode = image();
+			LLScriptExecuteLSL2 plain(&bytecode[0], (U32)bytecode.size());
+			LLScriptExecuteLSL2 threaded(&bytecode[0], (U32)bytecode.size());
+
+			const char* plain_error = run(plain, false);
+			const char* threaded_error = run(threaded, true);
+
+			ensure_equals(msg + " fault", get_register(plain.mBuffer, LREG_FR), (S32)LSRF_MATH);
+			ensure_equals(msg + " error", std::string(threaded_error ? threaded_error : ""),
+						  std::string(plain_error ? plain_error : ""));
+			ensure_equals(msg + " instructions", threaded.mInstructionCount, plain.mInstructionCount);
+			for (S32 i = 0; i < TOP_OF_MEMORY; ++i)
+			{
+				if (threaded.mBuffer[i] != plain.mBuffer[i])
+				{
+					ensure_equals(msg + llformat(" memory at %d", i), (S32)threaded.mBuffer[i], (S32)plain.mBuffer[i]);
+				}
+			}
+		}
+
+		static S32 getLocal(const LLScriptExecuteLSL2& script, S32 local)
+		{
+			S32 offset = TOP_OF_MEMORY - 1 - 4 - local;
+			return bytestream2integer(script.mBuffer, offset);
+		}
+	};
+
+	typedef test_group<lscript_execute_test> lscript_execute_t;
+	typedef lscript_execute_t::object lscript_execute_object_t;
+	tut::lscript_execute_t tut_lscript_execute("LLScriptExecuteLSL2");
+
+	// Integer ops the threaded loop runs itself
+	template<> template<>
+	void lscript_execute_object_t::test<1>()
+	{
+		assemble(1000, false, false);
+		ensureSameRun("integer");
+
+		std::vector<U8> bytecode = image();
+		LLScriptExecuteLSL2 script(&bytecode[0], (U32)bytecode.size());
+		run(script, true);
+		ensure_equals("loop count", getLocal(script, LOCAL_I), 1000);
+		ensure_equals("sum", getLocal(script, LOCAL_SUM), 1000 * 999 / 2);
+	}
+
+	// Ops that go back through mExecuteFuncs in between
+	template<> template<>
+	void lscript_execute_object_t::test<2>()
+	{
+		assemble(1000, true, false);
+		ensureSameRun("slow ops");
+	}
+
+	// Float globals and compares mixed in with the slow ops
+	template<> template<>
+	void lscript_execute_object_t::test<3>()
+	{
+		assemble(1000, true, true);
+		ensureSameRun("float ops");
+	}
+
+	// Float ops alone, over a shorter loop
+	template<> template<>
+	void lscript_execute_object_t::test<4>()
+	{
+		assemble(100, false, true);
+		ensureSameRun("float ops");
+	}
+}
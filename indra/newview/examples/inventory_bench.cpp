@@ -0,0 +1,438 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/**
+ * @file inventory_bench.cpp
+ * @brief Times the inventory model's indices on a synthetic inventory
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "llcommon.h"
+#include "llinventory.h"
+#include "llstl.h"
+#include "lltimer.h"
+#include "lluuidhashmap.h"
+
+// LLInventoryModel finds objects by id, children by parent id and links
+// by target id.  This builds those indices twice over the same synthetic
+// inventory, once with the std::map and std::multimap the model used to
+// have and once with the LLUUIDHashMap it has now, and times what the
+// viewer does with them: id lookups as getObject() does them, a
+// collectDescendentsIf() from the root, getLinksTo() on every item and a
+// pass over every item as a filter makes.  Both layouts must give the
+// same answers or the run fails.
+
+namespace
+{
+	typedef std::vector<LLPointer<LLInventoryCategory> > cat_array_t;
+	typedef std::vector<LLPointer<LLInventoryItem> > item_array_t;
+
+	template <typename T> using StdMap = std::map<LLUUID, T>;
+	template <typename T> using HashMap = LLUUIDHashMap<T>;
+
+	struct Inventory
+	{
+		LLUUID mRootID;
+		cat_array_t mCategories;
+		item_array_t mItems;
+		uuid_vec_t mLookups;		// every id, shuffled
+	};
+
+	LLUUID random_id(std::mt19937& rng)
+	{
+		LLUUID id;
+		for (S32 i = 0; i < UUID_BYTES; i += 4)
+		{
+			U32 bits = rng();
+			memcpy(id.mData + i, &bits, 4);
+		}
+		return id;
+	}
+
+	// Folders hang off a random earlier folder, so the tree is a few
+	// levels deep and bushy at the top as real inventories are; a few
+	// percent of the items are links to other items.
+	void make_inventory(S32 item_count, S32 items_per_folder, Inventory& inv)
+	{
+		std::mt19937 rng(20200101);
+		const S32 folder_count = llmax(1, item_count / items_per_folder);
+
+		inv.mRootID = random_id(rng);
+		inv.mCategories.push_back(new LLInventoryCategory(inv.mRootID, LLUUID::null,
+														  LLFolderType::FT_ROOT_INVENTORY, "My Inventory"));
+		for (S32 i = 1; i < folder_count; ++i)
+		{
+			const LLUUID& parent_id = inv.mCategories[rng() % inv.mCategories.size()]->getUUID();
+			inv.mCategories.push_back(new LLInventoryCategory(random_id(rng), parent_id,
+															  LLFolderType::FT_NONE, llformat("Folder %d", i)));
+		}
+
+		const LLAssetType::EType types[] = { LLAssetType::AT_OBJECT, LLAssetType::AT_TEXTURE,
+											 LLAssetType::AT_NOTECARD, LLAssetType::AT_CLOTHING };
+		const LLInventoryType::EType inv_types[] = { LLInventoryType::IT_OBJECT, LLInventoryType::IT_TEXTURE,
+													 LLInventoryType::IT_NOTECARD, LLInventoryType::IT_WEARABLE };
+		LLPermissions perm;
+		perm.init(LLUUID::null, inv.mRootID, LLUUID::null, LLUUID::null);
+		for (S32 i = 0; i < item_count; ++i)
+		{
+			const LLUUID& parent_id = inv.mCategories[rng() % inv.mCategories.size()]->getUUID();
+			LLAssetType::EType type;
+			LLInventoryType::EType inv_type;
+			LLUUID asset_id;
+			if (i > 0 && rng() % 100 < 5)
+			{
+				const LLInventoryItem* target = inv.mItems[rng() % inv.mItems.size()];
+				type = LLAssetType::AT_LINK;
+				inv_type = target->getInventoryType();
+				asset_id = target->getUUID();
+			}
+			else
+			{
+				U32 kind = rng() % LL_ARRAY_SIZE(types);
+				type = types[kind];
+				inv_type = inv_types[kind];
+				asset_id = random_id(rng);
+			}
+			inv.mItems.push_back(new LLInventoryItem(random_id(rng), parent_id, perm, asset_id, type, inv_type,
+													 llformat("Item %d", i), "", LLSaleInfo::DEFAULT,
+													 rng() % 4, 1500000000 + i));
+		}
+
+		for (const LLPointer<LLInventoryCategory>& cat : inv.mCategories)
+		{
+			inv.mLookups.push_back(cat->getUUID());
+		}
+		for (const LLPointer<LLInventoryItem>& item : inv.mItems)
+		{
+			inv.mLookups.push_back(item->getUUID());
+		}
+		std::shuffle(inv.mLookups.begin(), inv.mLookups.end(), rng);
+	}
+
+	struct MultimapBacklinks
+	{
+		void add(const LLUUID& target_id, const LLUUID& link_id)
+		{
+			mLinks.insert(std::make_pair(target_id, link_id));
+		}
+
+		U32 count(const LLUUID& target_id) const
+		{
+			auto range = mLinks.equal_range(target_id);
+			return (U32)std::distance(range.first, range.second);
+		}
+
+		std::multimap<LLUUID, LLUUID> mLinks;
+	};
+
+	struct HashBacklinks
+	{
+		void add(const LLUUID& target_id, const LLUUID& link_id)
+		{
+			mLinks[target_id].push_back(link_id);
+		}
+
+		U32 count(const LLUUID& target_id) const
+		{
+			auto it = mLinks.find(target_id);
+			return it == mLinks.end() ? 0 : (U32)it->second.size();
+		}
+
+		LLUUIDHashMap<uuid_vec_t> mLinks;
+	};
+
+	// LLInventoryModel's indices, filled in as buildParentChildMap() and
+	// addItem() fill them.  Every query returns a sum that doesn't depend
+	// on iteration order, for comparing the layouts.
+	template <template <typename> class Map, class Backlinks>
+	class Model
+	{
+	public:
+		explicit Model(const Inventory& inv)
+		{
+			for (const LLPointer<LLInventoryCategory>& cat : inv.mCategories)
+			{
+				mCategoryMap[cat->getUUID()] = cat;
+				mChildCategories[cat->getUUID()] = new cat_array_t;
+				mChildItems[cat->getUUID()] = new item_array_t;
+			}
+			for (const LLPointer<LLInventoryCategory>& cat : inv.mCategories)
+			{
+				cat_array_t* cats = get_ptr_in_map(mChildCategories, cat->getParentUUID());
+				if (cats)
+				{
+					cats->push_back(cat);
+				}
+			}
+			for (const LLPointer<LLInventoryItem>& item : inv.mItems)
+			{
+				mItemMap[item->getUUID()] = item;
+				item_array_t* items = get_ptr_in_map(mChildItems, item->getParentUUID());
+				if (items)
+				{
+					items->push_back(item);
+				}
+				if (item->getIsLinkType())
+				{
+					mBacklinks.add(item->getLinkedUUID(), item->getUUID());
+				}
+			}
+		}
+
+		~Model()
+		{
+			std::for_each(mChildCategories.begin(), mChildCategories.end(), DeletePairedPointer());
+			std::for_each(mChildItems.begin(), mChildItems.end(), DeletePairedPointer());
+		}
+
+		// getObject() on every id
+		U32 lookup(const uuid_vec_t& ids) const
+		{
+			U32 sum = 0;
+			for (const LLUUID& id : ids)
+			{
+				auto item = mItemMap.find(id);
+				if (item != mItemMap.end())
+				{
+					sum += item->second->getFlags() + 1;
+					continue;
+				}
+				auto cat = mCategoryMap.find(id);
+				if (cat != mCategoryMap.end())
+				{
+					sum += cat->second->getPreferredType() + 2;
+				}
+			}
+			return sum;
+		}
+
+		// collectDescendentsIf() from the root, picking out objects
+		U32 collect(const LLUUID& root_id) const
+		{
+			U32 sum = 0;
+			uuid_vec_t pending(1, root_id);
+			while (!pending.empty())
+			{
+				LLUUID id = pending.back();
+				pending.pop_back();
+				const cat_array_t* cats = get_ptr_in_map(mChildCategories, id);
+				if (cats)
+				{
+					for (const LLPointer<LLInventoryCategory>& cat : *cats)
+					{
+						pending.push_back(cat->getUUID());
+					}
+				}
+				const item_array_t* items = get_ptr_in_map(mChildItems, id);
+				if (items)
+				{
+					for (const LLPointer<LLInventoryItem>& item : *items)
+					{
+						if (item->getType() == LLAssetType::AT_OBJECT)
+						{
+							sum += item->getCreationDate() & 0xff;
+						}
+					}
+				}
+			}
+			return sum;
+		}
+
+		// getLinksTo() on every item
+		U32 links(const uuid_vec_t& ids) const
+		{
+			U32 sum = 0;
+			for (const LLUUID& id : ids)
+			{
+				sum += mBacklinks.count(id);
+			}
+			return sum;
+		}
+
+		// A filter pass over every item
+		U32 scan() const
+		{
+			U32 sum = 0;
+			for (auto it = mItemMap.begin(); it != mItemMap.end(); ++it)
+			{
+				const LLInventoryItem* item = it->second;
+				if (item->getInventoryType() == LLInventoryType::IT_TEXTURE)
+				{
+					sum += item->getFlags() + 1;
+				}
+			}
+			return sum;
+		}
+
+	private:
+		Map<LLPointer<LLInventoryCategory> > mCategoryMap;
+		Map<LLPointer<LLInventoryItem> > mItemMap;
+		Map<cat_array_t*> mChildCategories;
+		Map<item_array_t*> mChildItems;
+		Backlinks mBacklinks;
+	};
+
+	enum
+	{
+		OP_BUILD,
+		OP_LOOKUP,
+		OP_COLLECT,
+		OP_LINKS,
+		OP_SCAN,
+		OP_COUNT
+	};
+
+	const char* OP_NAMES[OP_COUNT] = { "build", "lookup", "collect", "links", "scan" };
+
+	struct Result
+	{
+		F64 mMS[OP_COUNT];
+		U32 mSum[OP_COUNT];
+	};
+
+	template <class MODEL>
+	void run(const Inventory& inv, S32 iterations, Result& result)
+	{
+		LLTimer timer;
+		for (S32 i = 0; i < iterations; ++i)
+		{
+			MODEL model(inv);
+		}
+		result.mMS[OP_BUILD] = timer.getElapsedTimeF64() * 1000.0 / iterations;
+		result.mSum[OP_BUILD] = 0;
+
+		MODEL model(inv);
+		for (S32 op = OP_LOOKUP; op < OP_COUNT; ++op)
+		{
+			U32 sum = 0;
+			timer.reset();
+			for (S32 i = 0; i < iterations; ++i)
+			{
+				switch (op)
+				{
+				case OP_LOOKUP:		sum = model.lookup(inv.mLookups); break;
+				case OP_COLLECT:	sum = model.collect(inv.mRootID); break;
+				case OP_LINKS:		sum = model.links(inv.mLookups); break;
+				default:			sum = model.scan(); break;
+				}
+			}
+			result.mMS[op] = timer.getElapsedTimeF64() * 1000.0 / iterations;
+			result.mSum[op] = sum;
+		}
+	}
+
+	void usage(std::ostream& out)
+	{
+		out << "\n"
+			"usage:\tinventory_bench [-i iterations] [-n items] [-f items per folder]\n"
+			"\n"
+			"Builds the inventory model's id, parent and link indices over a\n"
+			"synthetic inventory with std::map and with LLUUIDHashMap, and times\n"
+			"lookups and traversals on each.\n"
+			"\n"
+			"Options:\n"
+			"\n"
+			" -i <count>    Passes per operation (default 10)\n"
+			" -n <count>    Items (default 200000)\n"
+			" -f <count>    Items per folder on average (default 20)\n"
+			<< std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	S32 iterations = 10;
+	S32 item_count = 200000;
+	S32 items_per_folder = 20;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg(argv[i]);
+		if ((arg == "-i" || arg == "-n" || arg == "-f") && i + 1 < argc)
+		{
+			S32 value = atoi(argv[++i]);
+			if (value <= 0)
+			{
+				usage(std::cerr);
+				return 1;
+			}
+			if (arg == "-i")
+			{
+				iterations = value;
+			}
+			else if (arg == "-n")
+			{
+				item_count = value;
+			}
+			else
+			{
+				items_per_folder = value;
+			}
+		}
+		else
+		{
+			usage(std::cerr);
+			return 1;
+		}
+	}
+
+	LLCommon::initClass();
+
+	Inventory inv;
+	make_inventory(item_count, items_per_folder, inv);
+	printf("%d folders, %d items\n", (S32)inv.mCategories.size(), (S32)inv.mItems.size());
+
+	Result map_result;
+	Result hash_result;
+	run<Model<StdMap, MultimapBacklinks> >(inv, iterations, map_result);
+	run<Model<HashMap, HashBacklinks> >(inv, iterations, hash_result);
+
+	printf("%-8s %12s %12s %8s\n", "op", "std::map ms", "hash ms", "speedup");
+	bool matched = true;
+	for (S32 op = 0; op < OP_COUNT; ++op)
+	{
+		matched = matched && map_result.mSum[op] == hash_result.mSum[op];
+		printf("%-8s %12.3f %12.3f %7.2fx\n", OP_NAMES[op],
+			   map_result.mMS[op], hash_result.mMS[op], map_result.mMS[op] / hash_result.mMS[op]);
+	}
+
+	inv.mItems.clear();
+	inv.mCategories.clear();
+	LLCommon::cleanupClass();
+
+	if (!matched)
+	{
+		std::cerr << "Layouts disagree" << std::endl;
+		return 1;
+	}
+	return 0;
+}
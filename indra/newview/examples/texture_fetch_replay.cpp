@@ -0,0 +1,582 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/**
+ * @file texture_fetch_replay.cpp
+ * @brief Plays a texture fetch trace back against the texture cache and decoder
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "llappviewer.h"
+#include "llcommon.h"
+#include "lldir.h"
+#include "llimage.h"
+#include "llimagej2c.h"
+#include "llimageworker.h"
+#include "lltexturecache.h"
+#include "lltexturefetchtrace.h"
+#include "lltimer.h"
+
+// A trace holds what the fetcher did and when, not the texture bytes, so
+// every texture is replaced by a synthetic codestream of the recorded size
+// and the network by an in-process stand-in that hands out slices of it
+// after the recorded latency.  The cache and decoder are the real ones, so
+// the numbers printed at the end are what a change to either of them buys
+// on that workload.
+
+// The texture cache is built into the viewer and reaches for a couple of
+// its globals; these are the only ones it touches.
+LLControlGroup gSavedSettings("Global");
+LLAppViewer* LLAppViewer::sInstance = NULL;
+void LLAppViewer::pauseMainloopTimeout() {}
+void LLAppViewer::resumeMainloopTimeout(const std::string& state, F32 secs) {}
+
+namespace
+{
+	const S32 DEFAULT_SIZE = 256;
+	const S32 DEFAULT_COMPONENTS = 3;
+	const S64 CACHE_SIZE = 1024LL * 1024 * 1024;
+
+	enum EStage
+	{
+		STAGE_CACHE_READ = 0,
+		STAGE_HTTP,
+		STAGE_DECODE,
+		STAGE_CACHE_WRITE,
+		STAGE_COUNT
+	};
+
+	const char* STAGE_NAMES[STAGE_COUNT] = { "cache read", "http", "decode", "cache write" };
+
+	// One fetch of one texture as recorded, and its progress through the replay
+	struct Job
+	{
+		enum EState
+		{
+			WAITING = 0,
+			CACHE_READ,
+			HTTP,
+			DECODE,
+			CACHE_WRITE,
+			DONE
+		};
+
+		Job()
+			: mStart(0), mWidth(0), mHeight(0), mComponents(0),
+			  mCacheBytes(0), mHttp(false), mHttpBegin(0), mHttpLatency(0), mHttpBytes(0),
+			  mDecode(false), mDiscard(0), mWrite(false),
+			  mState(WAITING), mStageStart(0), mReady(0),
+			  mHandle(LLTextureCache::nullHandle()), mLoaded(false), mDecodeDone(0)
+		{
+		}
+
+		// From the trace
+		LLUUID mID;
+		U64 mStart;
+		S32 mWidth;
+		S32 mHeight;
+		S32 mComponents;
+		S32 mCacheBytes;		// bytes found in the cache, 0 on a miss
+		bool mHttp;
+		U64 mHttpBegin;
+		U64 mHttpLatency;
+		S32 mHttpBytes;			// total bytes held once the transfer is done
+		bool mDecode;
+		S32 mDiscard;
+		bool mWrite;
+
+		// Replay
+		EState mState;
+		U64 mStageStart;
+		U64 mReady;
+		LLTextureCache::handle_t mHandle;
+		bool mLoaded;
+		LLPointer<LLImageJ2C> mSource;
+		LLPointer<LLImageFormatted> mImage;
+		LLPointer<LLImageRaw> mRaw;
+		LLAtomicU32 mDecodeDone;	// set by the decode thread
+	};
+	typedef std::vector<std::unique_ptr<Job> > job_list_t;
+
+	class ReplayReadResponder : public LLTextureCache::ReadResponder
+	{
+	public:
+		ReplayReadResponder(Job* job) : mJob(job) {}
+		void completed(bool success) override
+		{
+			mJob->mImage = mFormattedImage;
+			mJob->mLoaded = true;
+		}
+	private:
+		Job* mJob;
+	};
+
+	class ReplayWriteResponder : public LLTextureCache::WriteResponder
+	{
+	public:
+		ReplayWriteResponder(Job* job) : mJob(job) {}
+		void completed(bool success) override
+		{
+			mJob->mLoaded = true;
+		}
+	private:
+		Job* mJob;
+	};
+
+	class ReplayDecodeResponder : public LLImageDecodeThread::Responder
+	{
+	public:
+		ReplayDecodeResponder(Job* job) : mJob(job) {}
+		void completed(bool success, LLImageRaw* raw, LLImageRaw* aux) override
+		{
+			if (success)
+			{
+				mJob->mRaw = raw;
+			}
+			mJob->mDecodeDone = success ? 1 : 2;
+		}
+	private:
+		Job* mJob;
+	};
+
+	// Builds the jobs from a trace: the first request of each texture and
+	// the stages it went through up to its DONE or REMOVE.
+	void build_jobs(const LLTextureFetchTrace::record_list_t& records, job_list_t& jobs)
+	{
+		std::map<LLUUID, Job*> open;
+		for (const LLTextureFetchTrace::Record& record : records)
+		{
+			std::map<LLUUID, Job*>::iterator iter = open.find(record.mID);
+			if (record.mEvent == LLTextureFetchTrace::REQUEST)
+			{
+				if (iter == open.end())
+				{
+					jobs.emplace_back(new Job);
+					Job* job = jobs.back().get();
+					job->mID = record.mID;
+					job->mStart = record.mTime;
+					job->mWidth = record.mWidth;
+					job->mHeight = record.mHeight;
+					job->mComponents = record.mComponents;
+					open[record.mID] = job;
+				}
+				continue;
+			}
+			if (iter == open.end())
+			{
+				continue;
+			}
+
+			Job* job = iter->second;
+			switch (record.mEvent)
+			{
+			case LLTextureFetchTrace::CACHE_READ_END:
+				job->mCacheBytes = record.mStatus ? record.mSize : 0;
+				break;
+			case LLTextureFetchTrace::HTTP_BEGIN:
+				job->mHttpBegin = record.mTime;
+				break;
+			case LLTextureFetchTrace::HTTP_END:
+				job->mHttp = true;
+				job->mHttpLatency += record.mTime - llmin(record.mTime, job->mHttpBegin);
+				job->mHttpBytes = llmax(job->mHttpBytes, record.mOffset + record.mSize);
+				break;
+			case LLTextureFetchTrace::DECODE_BEGIN:
+				job->mDecode = true;
+				job->mDiscard = llmax(record.mDiscard, 0);
+				break;
+			case LLTextureFetchTrace::DECODE_END:
+				// Full size from the decoded size when the request didn't know it
+				if (job->mWidth <= 0 && record.mDiscard >= 0 && record.mWidth > 0)
+				{
+					job->mWidth = record.mWidth << record.mDiscard;
+					job->mHeight = record.mHeight << record.mDiscard;
+					job->mComponents = record.mComponents;
+				}
+				break;
+			case LLTextureFetchTrace::CACHE_WRITE_BEGIN:
+				job->mWrite = true;
+				break;
+			case LLTextureFetchTrace::DONE:
+			case LLTextureFetchTrace::REMOVE:
+				open.erase(iter);
+				break;
+			default:
+				break;
+			}
+		}
+
+		// Requests that never got anywhere have nothing to replay
+		jobs.erase(std::remove_if(jobs.begin(), jobs.end(),
+								  [](const std::unique_ptr<Job>& job)
+								  {
+									  return !job->mCacheBytes && !job->mHttp;
+								  }),
+				   jobs.end());
+	}
+
+	// One synthetic codestream per distinct image size, encoded up front
+	LLPointer<LLImageJ2C> get_source(S32 width, S32 height, S32 components)
+	{
+		static std::map<U64, LLPointer<LLImageJ2C> > sources;
+
+		width = llclamp(width > 0 ? width : DEFAULT_SIZE, 4, (S32)MAX_IMAGE_SIZE);
+		height = llclamp(height > 0 ? height : DEFAULT_SIZE, 4, (S32)MAX_IMAGE_SIZE);
+		components = llclamp(components > 0 ? components : DEFAULT_COMPONENTS, 1, 4);
+
+		U64 key = ((U64)width << 32) | ((U64)height << 8) | (U64)components;
+		LLPointer<LLImageJ2C>& source = sources[key];
+		if (source.isNull())
+		{
+			// A gradient with some noise on top, so the codestream isn't
+			// unrealistically small
+			LLPointer<LLImageRaw> raw = new LLImageRaw(width, height, components);
+			U8* data = raw->getData();
+			U32 seed = 0x12345678;
+			for (S32 y = 0; y < height; ++y)
+			{
+				for (S32 x = 0; x < width; ++x)
+				{
+					for (S32 c = 0; c < components; ++c)
+					{
+						seed = seed * 1664525 + 1013904223;
+						*data++ = (U8)(((x + y) * 255 / (width + height)) ^ (seed >> 29));
+					}
+				}
+			}
+			source = new LLImageJ2C;
+			if (!source->encode(raw, 0.f))
+			{
+				LL_ERRS("TextureFetch") << "Unable to encode a " << width << "x" << height << " test image" << LL_ENDL;
+			}
+		}
+		return source;
+	}
+
+	// A new codestream holding the first bytes of the source
+	LLPointer<LLImageFormatted> make_prefix(LLImageJ2C* source, S32 bytes)
+	{
+		bytes = llclamp(bytes, 1, source->getDataSize());
+		U8* data = (U8*)ll_aligned_malloc_16(bytes);
+		memcpy(data, source->getData(), bytes);
+		LLPointer<LLImageFormatted> image = new LLImageJ2C;
+		image->setData(data, bytes);
+		return image;
+	}
+
+	F64 percentile(std::vector<F64>& values, F64 fraction)
+	{
+		if (values.empty())
+		{
+			return 0.0;
+		}
+		std::sort(values.begin(), values.end());
+		size_t index = llmin((size_t)(fraction * values.size()), values.size() - 1);
+		return values[index];
+	}
+
+	void usage(std::ostream& out)
+	{
+		out << "\n"
+			"usage:\ttexture_fetch_replay [options] trace_file\n"
+			"\n"
+			"Replays a trace recorded with the TextureFetchTraceFile setting\n"
+			"against the texture cache and image decoder, serving the network\n"
+			"part from memory after the recorded latency.\n"
+			"\n"
+			"Options:\n"
+			"\n"
+			" -c <dir>      Cache directory, emptied first (default: ./texture_fetch_replay)\n"
+			" -s <scale>    Time scale, 1 replays in recorded time and 0 starts\n"
+			"               everything at once (default 0)\n"
+			" -t <count>    Decode threads (default 1)\n"
+			" -l <ms>       Use this HTTP latency instead of the recorded one\n"
+			<< std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string cache_dir = "texture_fetch_replay";
+	F64 scale = 0.0;
+	U32 threads = 1;
+	S64 latency_override = -1;
+	std::string trace_file;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg(argv[i]);
+		if (arg == "-c" && i + 1 < argc)
+		{
+			cache_dir = argv[++i];
+		}
+		else if (arg == "-s" && i + 1 < argc)
+		{
+			scale = atof(argv[++i]);
+		}
+		else if (arg == "-t" && i + 1 < argc)
+		{
+			threads = (U32)llmax(1, atoi(argv[++i]));
+		}
+		else if (arg == "-l" && i + 1 < argc)
+		{
+			latency_override = (S64)llmax(0, atoi(argv[++i])) * 1000;
+		}
+		else if (arg[0] != '-' && trace_file.empty())
+		{
+			trace_file = arg;
+		}
+		else
+		{
+			usage(std::cerr);
+			return 1;
+		}
+	}
+	if (trace_file.empty() || scale < 0.0)
+	{
+		usage(std::cerr);
+		return 1;
+	}
+
+	LLCommon::initClass();
+	LLImage::initClass();
+
+	LLTextureFetchTrace::record_list_t records;
+	if (!LLTextureFetchTrace::load(trace_file, records))
+	{
+		return 1;
+	}
+	job_list_t jobs;
+	build_jobs(records, jobs);
+	std::cout << "Trace holds " << records.size() << " events, " << jobs.size() << " fetches to replay" << std::endl;
+
+	gSavedSettings.declareU32("CacheValidateCounter", 0, "", LLControlVariable::PERSIST_NO);
+	if (!gDirUtilp->setCacheDir(cache_dir))
+	{
+		std::cerr << "Unable to use " << cache_dir << " as the cache directory" << std::endl;
+		return 1;
+	}
+	LLTextureCache* cache = new LLTextureCache(true);
+	cache->setReadOnly(FALSE);
+	cache->initCache(LL_PATH_CACHE, CACHE_SIZE, TRUE);
+	LLImageDecodeThread* decoder = new LLImageDecodeThread(true, threads);
+
+	// Encode the stand-in images and put the recorded cache hits in the
+	// cache before anything is timed
+	for (std::unique_ptr<Job>& job : jobs)
+	{
+		job->mSource = get_source(job->mWidth, job->mHeight, job->mComponents);
+		if (job->mCacheBytes > 0)
+		{
+			LLPointer<LLImageFormatted> prefix = make_prefix(job->mSource, job->mCacheBytes);
+			LLPointer<LLImageRaw> raw = new LLImageRaw;
+			if (!prefix->updateData() || !prefix->decode(raw, 0.f))
+			{
+				job->mCacheBytes = 0;
+				continue;
+			}
+			job->mLoaded = false;
+			job->mHandle = cache->writeToCache(job->mID, LLWorkerThread::PRIORITY_NORMAL,
+											   prefix->getData(), prefix->getDataSize(), job->mSource->getDataSize(),
+											   raw, prefix->getDiscardLevel(), new ReplayWriteResponder(job.get()));
+			while (!job->mLoaded)
+			{
+				cache->update(1);
+				ms_sleep(1);
+			}
+			cache->writeComplete(job->mHandle);
+			job->mHandle = LLTextureCache::nullHandle();
+			job->mLoaded = false;
+		}
+	}
+
+	std::vector<F64> stage_ms[STAGE_COUNT];
+	S64 bytes_decoded = 0;
+	S32 failures = 0;
+	size_t next = 0;
+	size_t done = 0;
+	std::vector<Job*> active;
+	LLTimer clock;
+
+	while (done < jobs.size())
+	{
+		U64 now = (U64)(clock.getElapsedTimeF64() * 1000000.0);
+		bool progress = false;
+
+		while (next < jobs.size() && (U64)(jobs[next]->mStart * scale) <= now)
+		{
+			Job* job = jobs[next++].get();
+			job->mState = job->mCacheBytes > 0 ? Job::CACHE_READ : Job::HTTP;
+			job->mStageStart = now;
+			if (job->mState == Job::CACHE_READ)
+			{
+				job->mHandle = cache->readFromCache(job->mID, LLWorkerThread::PRIORITY_NORMAL, 0, job->mCacheBytes,
+													new ReplayReadResponder(job));
+			}
+			else
+			{
+				job->mReady = now + (latency_override >= 0 ? (U64)latency_override : (U64)(job->mHttpLatency * scale));
+			}
+			active.push_back(job);
+			progress = true;
+		}
+
+		for (std::vector<Job*>::iterator iter = active.begin(); iter != active.end(); )
+		{
+			Job* job = *iter;
+			Job::EState state = job->mState;
+			switch (state)
+			{
+			case Job::CACHE_READ:
+				if (job->mLoaded && cache->readComplete(job->mHandle, false))
+				{
+					job->mHandle = LLTextureCache::nullHandle();
+					job->mLoaded = false;
+					stage_ms[STAGE_CACHE_READ].push_back((now - job->mStageStart) / 1000.0);
+					if (job->mImage.isNull() || job->mImage->getDataSize() < job->mCacheBytes)
+					{
+						// Missing from the cache after all, fetch all of it
+						job->mImage = NULL;
+						job->mHttp = true;
+						job->mHttpBytes = llmax(job->mHttpBytes, job->mCacheBytes);
+					}
+					if (job->mHttp)
+					{
+						job->mState = Job::HTTP;
+						job->mReady = now + (latency_override >= 0 ? (U64)latency_override : (U64)(job->mHttpLatency * scale));
+					}
+					else
+					{
+						job->mState = job->mDecode ? Job::DECODE : Job::DONE;
+					}
+					job->mStageStart = now;
+				}
+				break;
+			case Job::HTTP:
+				if (now >= job->mReady)
+				{
+					stage_ms[STAGE_HTTP].push_back((now - job->mStageStart) / 1000.0);
+					job->mImage = make_prefix(job->mSource, llmax(job->mHttpBytes, job->mCacheBytes));
+					job->mState = job->mDecode ? Job::DECODE : Job::DONE;
+					job->mStageStart = now;
+				}
+				break;
+			case Job::DECODE:
+				if (job->mHandle == LLTextureCache::nullHandle())
+				{
+					// Never finer than the bytes at hand allow
+					job->mImage->updateData();
+					S32 discard = llmax(job->mDiscard, (S32)job->mImage->getDiscardLevel());
+					job->mHandle = decoder->decodeImage(job->mImage, LLWorkerThread::PRIORITY_NORMAL, discard, FALSE,
+														new ReplayDecodeResponder(job));
+				}
+				else if (job->mDecodeDone != 0)
+				{
+					stage_ms[STAGE_DECODE].push_back((now - job->mStageStart) / 1000.0);
+					job->mHandle = LLTextureCache::nullHandle();
+					if (job->mDecodeDone != 1 || job->mRaw.isNull())
+					{
+						++failures;
+						job->mState = Job::DONE;
+						break;
+					}
+					bytes_decoded += job->mImage->getDataSize();
+					if (job->mWrite && job->mHttp)
+					{
+						job->mStageStart = now;
+						job->mState = Job::CACHE_WRITE;
+						job->mHandle = cache->writeToCache(job->mID, LLWorkerThread::PRIORITY_NORMAL,
+														   job->mImage->getData(), job->mImage->getDataSize(),
+														   job->mSource->getDataSize(), job->mRaw,
+														   job->mImage->getDiscardLevel(), new ReplayWriteResponder(job));
+					}
+					else
+					{
+						job->mState = Job::DONE;
+					}
+				}
+				break;
+			case Job::CACHE_WRITE:
+				if (job->mLoaded && cache->writeComplete(job->mHandle))
+				{
+					stage_ms[STAGE_CACHE_WRITE].push_back((now - job->mStageStart) / 1000.0);
+					job->mHandle = LLTextureCache::nullHandle();
+					job->mState = Job::DONE;
+				}
+				break;
+			default:
+				break;
+			}
+
+			progress |= job->mState != state;
+			if (job->mState == Job::DONE)
+			{
+				// Drop the buffers now, a long trace would hold every texture otherwise
+				job->mImage = NULL;
+				job->mRaw = NULL;
+				++done;
+				iter = active.erase(iter);
+			}
+			else
+			{
+				++iter;
+			}
+		}
+
+		cache->update(1);
+		decoder->update(1);
+		if (!progress)
+		{
+			ms_sleep(1);
+		}
+	}
+
+	F64 wall = clock.getElapsedTimeF64();
+	printf("%zu textures in %.3f s, %.1f textures/s, %.2f MB/s decoded, %d failed\n",
+		   jobs.size(), wall, jobs.size() / llmax(wall, 0.001),
+		   bytes_decoded / (1024.0 * 1024.0) / llmax(wall, 0.001), failures);
+	printf("%-12s %8s %10s %10s %10s\n", "stage", "count", "p50 ms", "p95 ms", "max ms");
+	for (S32 stage = 0; stage < STAGE_COUNT; ++stage)
+	{
+		std::vector<F64>& values = stage_ms[stage];
+		printf("%-12s %8zu %10.3f %10.3f %10.3f\n", STAGE_NAMES[stage], values.size(),
+			   percentile(values, 0.5), percentile(values, 0.95), percentile(values, 1.0));
+	}
+
+	decoder->shutdown();
+	delete decoder;
+	cache->shutdown();
+	delete cache;
+	LLImage::cleanupClass();
+	LLCommon::cleanupClass();
+	return 0;
+}
@@ -94,6 +94,7 @@
 #include "llweb.h"
 #include "llavatarrenderinfoaccountant.h"
 #include "llskinningutil.h"
+#include "lljobpool.h"
 
 // Linden library includes
 #include "llavatarnamecache.h"
@@ -402,6 +403,8 @@ void init_default_trans_args()
 // File scope definitons
 const char *VFS_DATA_FILE_BASE = "data.db2.x.";
 const char *VFS_INDEX_FILE_BASE = "index.db2.x.";
+const char *VFS_LOG_STORE_DIR = "vfs";
+const char *MESH_CACHE_DIR = "meshcache";
 
 static std::string gSecondLife;
 std::string gWindowTitle;
@@ -1287,6 +1290,21 @@ bool LLAppViewer::frame()
 		//clear call stack records
 		LL_CLEAR_CALLSTACKS();
 
+		// Start, gather or write out the fast timer trace of all threads
+		static LLCachedControl<bool> fast_timer_trace(gSavedSettings, "FastTimerTrace", false);
+		if (fast_timer_trace != LLFastTimer::isTracing())
+		{
+			if (fast_timer_trace)
+			{
+				LLFastTimer::startTrace();
+			}
+			else
+			{
+				LLFastTimer::stopTrace(gDirUtilp->getExpandedFilename(LL_PATH_LOGS, "fast_timer_trace.json"));
+			}
+		}
+		LLFastTimer::collectTrace();
+
 		//check memory availability information
 		checkMemory() ;
 		
@@ -1918,6 +1936,7 @@ bool LLAppViewer::cleanup()
 	mAppCoreHttp.requestStop();
 	sTextureFetch->shutdown();
 	sTextureCache->shutdown();
+	sImageDecodeThread->logStats();
 	sImageDecodeThread->shutdown();
 	
 	sTextureFetch->shutDownTextureCacheThread();
@@ -1941,6 +1960,11 @@ bool LLAppViewer::cleanup()
 	delete mFastTimerLogThread;
 	mFastTimerLogThread = nullptr;
 
+	if (LLFastTimer::isTracing())
+	{
+		LLFastTimer::stopTrace(gDirUtilp->getExpandedFilename(LL_PATH_LOGS, "fast_timer_trace.json"));
+	}
+
 
 	if (LLFastTimerView::sAnalyzePerformance)
 	{
@@ -1970,6 +1994,7 @@ bool LLAppViewer::cleanup()
 	
 	// This should eventually be done in LLAppViewer
 	SUBSYSTEM_CLEANUP(LLImage);
+	SUBSYSTEM_CLEANUP(LLJobPool);
 	SUBSYSTEM_CLEANUP(LLVFSThread);
 	SUBSYSTEM_CLEANUP(LLLFSThread);
 
@@ -2098,12 +2123,18 @@ bool LLAppViewer::initThreads()
 	}
 
 	LLImage::initClass(gSavedSettings.getBOOL("TextureNewByteRange"),gSavedSettings.getS32("TextureReverseByteRange"));
+	LLJobPool::initClass(enable_threads ? gSavedSettings.getU32("FrameJobThreads") : 1);
 	
 	LLVFSThread::initClass(enable_threads && false);
 	LLLFSThread::initClass(enable_threads && false);
 
 	// Image decoding
-	LLAppViewer::sImageDecodeThread = new LLImageDecodeThread(enable_threads && true);
+	U32 decode_threads = gSavedSettings.getU32("ImageDecodeThreads");
+	if (!decode_threads)
+	{
+		decode_threads = llclamp((S32)boost::thread::hardware_concurrency() - 1, 1, 8);
+	}
+	LLAppViewer::sImageDecodeThread = new LLImageDecodeThread(enable_threads && true, decode_threads);
 	LLAppViewer::sTextureCache = new LLTextureCache(enable_threads && true);
 	LLAppViewer::sTextureFetch = new LLTextureFetch(LLAppViewer::getTextureCache(),
 													sImageDecodeThread,
@@ -3594,7 +3625,7 @@ U32 LLAppViewer::getObjectCacheVersion()
 {
 	// Viewer object cache version, change if object update
 	// format changes. JC
-	const U32 INDRA_OBJECT_CACHE_VERSION = 14;
+	const U32 INDRA_OBJECT_CACHE_VERSION = 15;
 
 	return INDRA_OBJECT_CACHE_VERSION;
 }
@@ -3690,6 +3721,13 @@ bool LLAppViewer::initCache()
 
 	LLVOCache::getInstance()->initCache(LL_PATH_CACHE, gSavedSettings.getU32("CacheNumberOfRegionsForObjects"), getObjectCacheVersion()) ;
 
+	if (!read_only)
+	{
+		// Meshes live in their own store rather than the VFS
+		gMeshRepo.initCache(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, MESH_CACHE_DIR),
+							(U64)gSavedSettings.getU32("MeshCacheSize") * MB);
+	}
+
 	LLSplashScreen::update(LLTrans::getString("StartupInitializingVFS"));
 	
 	// Init the VFS
@@ -3811,13 +3849,49 @@ bool LLAppViewer::initCache()
 	// Startup the VFS...
 	gSavedSettings.setU32("VFSSalt", new_salt);
 
-	// Don't remove VFS after viewer crashes.  If user has corrupt data, they can reinstall. JC
-	gVFS = LLVFS::createLLVFS(new_vfs_index_file, new_vfs_data_file, false, vfs_size_u32, false);
+	std::string log_store_dir = gDirUtilp->getExpandedFilename(LL_PATH_CACHE, VFS_LOG_STORE_DIR);
+	if (gSavedSettings.getBOOL("VFSLogStructured") && !read_only)
+	{
+		// The segment store replaces the data file, don't leave a stale one behind
+		LLFile::remove(new_vfs_data_file, ENOENT);
+		LLFile::remove(new_vfs_index_file, ENOENT);
+		gVFS = LLVFS::createLogStructuredVFS(log_store_dir, vfs_size_u32);
+	}
+	else
+	{
+		if (!read_only && LLFile::isdir(log_store_dir))
+		{
+			gDirUtilp->deleteDirAndContents(log_store_dir);
+		}
+		// Don't remove VFS after viewer crashes.  If user has corrupt data, they can reinstall. JC
+		gVFS = LLVFS::createLLVFS(new_vfs_index_file, new_vfs_data_file, false, vfs_size_u32, false);
+	}
 	if (!gVFS)
 	{
 		return false;
 	}
 
+	if (!read_only && !gSavedSettings.getBOOL("MeshCacheMigrated"))
+	{
+		// Meshes used to be cached in the VFS. Nothing reads them from there
+		// any more, so drop them once instead of waiting for eviction.
+		std::vector<LLVFSFileSpecifier> meshes;
+		std::map<LLVFSFileSpecifier, LLVFSFileBlock*> files = gVFS->getFileList();
+		for (std::map<LLVFSFileSpecifier, LLVFSFileBlock*>::const_iterator iter = files.begin(); iter != files.end(); ++iter)
+		{
+			if (iter->first.mFileType == LLAssetType::AT_MESH)
+			{
+				meshes.push_back(iter->first);
+			}
+		}
+		for (const LLVFSFileSpecifier& spec : meshes)
+		{
+			gVFS->removeFile(spec.mFileID, spec.mFileType);
+		}
+		LL_INFOS("AppCache") << "Removed " << meshes.size() << " meshes from the VFS" << LL_ENDL;
+		gSavedSettings.setBOOL("MeshCacheMigrated", TRUE);
+	}
+
 	gStaticVFS = LLVFS::createLLVFS(static_vfs_index_file, static_vfs_data_file, true, 0, false);
 	if (!gStaticVFS)
 	{
@@ -3860,6 +3934,16 @@ void LLAppViewer::purgeCache()
 		// cef does not support clear_cache and clear_cookies, so clear what we can manually.
 		gDirUtilp->deleteDirAndContents(browser_cache);
 	}
+	std::string log_store_dir = gDirUtilp->getExpandedFilename(LL_PATH_CACHE, VFS_LOG_STORE_DIR);
+	if (LLFile::isdir(log_store_dir))
+	{
+		gDirUtilp->deleteDirAndContents(log_store_dir);
+	}
+	std::string mesh_cache_dir = gDirUtilp->getExpandedFilename(LL_PATH_CACHE, MESH_CACHE_DIR);
+	if (LLFile::isdir(mesh_cache_dir))
+	{
+		gDirUtilp->deleteDirAndContents(mesh_cache_dir);
+	}
 	gDirUtilp->deleteFilesInDir(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, ""), "*");
 }
 
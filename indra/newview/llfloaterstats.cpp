@@ -175,6 +175,15 @@ void LLFloaterStats::buildStats()
 	stat_barp->mLabelSpacing = 20.f;
 	stat_barp->mPerSec = FALSE;	
 
+	stat_barp = render_statviewp->addStat("Animation Mem", &(LLViewerStats::getInstance()->mAnimationMemStat), "DebugStatModeAnimationMem");
+	stat_barp->setUnitLabel(" KB");
+	stat_barp->mMinBar = 0.f;
+	stat_barp->mMaxBar = 16384.f;
+	stat_barp->mTickSpacing = 2048.f;
+	stat_barp->mLabelSpacing = 8192.f;
+	stat_barp->mPerSec = FALSE;
+	stat_barp->mDisplayMean = FALSE;
+
 	// Texture statistics
 	params.name("texture stat view");
 	params.show_label(true);
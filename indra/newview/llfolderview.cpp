@@ -550,7 +550,10 @@ static LLTrace::BlockTimerStatHandle FTM_FILTER("Filter Folder View");
 void LLFolderView::filter( LLInventoryFilter& filter )
 {
 	LL_RECORD_BLOCK_TIME(FTM_FILTER);
-	filter.setFilterCount(llclamp(gSavedSettings.getS32("FilterItemsPerFrame"), 1, 5000));
+	static LLCachedControl<S32> filter_items_per_frame(gSavedSettings, "FilterItemsPerFrame");
+	static LLCachedControl<F32> filter_max_time_per_frame(gSavedSettings, "FilterMaxTimePerFrame");
+	filter.setFilterCount(llclamp((S32)filter_items_per_frame, 1, 5000));
+	filter.setFilterTimeLimit(llmax((F32)filter_max_time_per_frame, 0.f) / 1000.f);
 
 	if (getCompletedFilterGeneration() < filter.getCurrentGeneration())
 	{
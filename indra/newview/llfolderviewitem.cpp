@@ -52,6 +52,7 @@ const F32 LLFolderViewItem::FOLDER_OPEN_TIME_CONSTANT = 0.03f;
 
 LLUIImagePtr LLFolderViewItem::sArrowImage;
 LLUIImagePtr LLFolderViewItem::sBoxImage;
+std::set<std::string> LLFolderViewItem::sLabelSuffixes;
 
 
 //static
@@ -84,6 +85,30 @@ void LLFolderViewItem::cleanupClass()
 	sFonts.clear();
 	sArrowImage = NULL;
 	sBoxImage = NULL;
+	sLabelSuffixes.clear();
+}
+
+//static
+bool LLFolderViewItem::labelSuffixCouldMatch(const std::string& sub_string)
+{
+	for (std::set<std::string>::const_iterator it = sLabelSuffixes.begin(); it != sLabelSuffixes.end(); ++it)
+	{
+		const std::string& suffix = *it;
+		if (suffix.find(sub_string) != std::string::npos)
+		{
+			return true;
+		}
+		// Straddling the end of the name and the start of the suffix
+		const size_t longest = llmin(sub_string.size() - 1, suffix.size());
+		for (size_t len = 1; len <= longest; ++len)
+		{
+			if (!sub_string.compare(sub_string.size() - len, len, suffix, 0, len))
+			{
+				return true;
+			}
+		}
+	}
+	return false;
 }
 // Default constructor
 // NOTE: Optimize this, we call it a *lot* when opening a large inventory
@@ -251,6 +276,12 @@ void LLFolderViewItem::refreshFromListener()
 		{
 			mLabelStyle = mListener->getLabelStyle();
 			mLabelSuffix = mListener->getLabelSuffix();
+			if (!mLabelSuffix.empty())
+			{
+				std::string suffix(mLabelSuffix);
+				LLStringUtil::toUpper(suffix);
+				sLabelSuffixes.insert(suffix);
+			}
 		}
 		
 		updateExtraSearchCriteria();
@@ -1415,6 +1446,14 @@ void LLFolderViewFolder::filter( LLInventoryFilter& filter)
 		LLInventoryModelBackgroundFetch::instance().start(mListener->getUUID());
 	}
 
+	// nothing under here has a name holding the search string, so
+	// nothing under here can pass: done without looking
+	if (filter.canSkipDescendants(this))
+	{
+		setCompletedFilterGeneration(filter_generation, FALSE/*dont recurse up to root*/);
+		return;
+	}
+
 	// now query children
 	for (folders_t::iterator iter = mFolders.begin();
 		 iter != mFolders.end();
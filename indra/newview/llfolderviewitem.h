@@ -90,6 +90,10 @@ public:
 	static void cleanupClass();
 	friend class LLFolderViewEventListener;
 
+	// Whether sub_string (upper cased) could match a searchable label
+	// partly or wholly in one of the label suffixes seen so far
+	static bool labelSuffixCouldMatch(const std::string& sub_string);
+
 	static const S32 LEFT_PAD = 5;
 	static const S32 LEFT_INDENTATION = 6;
 	static const S32 ICON_PAD = 2;
@@ -109,6 +113,7 @@ private:
 protected:
 	static LLUIImagePtr			sArrowImage;
 	static LLUIImagePtr			sBoxImage;
+	static std::set<std::string> sLabelSuffixes;		// upper cased
 
 	std::string					mLabel;
 	std::string					mSearchableLabel;
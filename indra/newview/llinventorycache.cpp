@@ -0,0 +1,494 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/**
+ * @file llinventorycache.cpp
+ * @brief Binary on-disk cache of the agent's inventory
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llinventorycache.h"
+
+#include <boost/thread/thread.hpp>
+
+#include "llfile.h"
+#include "llmappedfile.h"
+#include "llthread.h"
+#include "lltimer.h"
+#include "llxorcipher.h"
+
+namespace
+{
+	const char CACHE_MAGIC[4] = { 'L', 'L', 'I', 'C' };
+
+	// Restricted assets are kept XORed with this, as the text cache did
+	// with LLInventoryItem's own key, so their ids don't sit in the file
+	// in the clear
+	const LLUUID SHADOW_KEY("3c115e51-04f4-523c-9fa6-98aff1034730");
+
+	// Below this many records a second thread costs more than it saves
+	const U32 MIN_RECORDS_PER_THREAD = 4096;
+
+	struct Header
+	{
+		char	mMagic[4];
+		U32		mFormatVersion;
+		S32		mCacheVersion;
+		U32		mCategoryCount;
+		U32		mItemCount;
+		U32		mStringPoolSize;
+	};
+
+	struct CategoryRecord
+	{
+		LLUUID	mID;
+		LLUUID	mParentID;
+		LLUUID	mOwnerID;
+		S32		mVersion;
+		U32		mName;				// offset in the string pool
+		U16		mNameLength;
+		S8		mType;				// LLAssetType::EType
+		S8		mPreferredType;		// LLFolderType::EType
+	};
+
+	enum
+	{
+		ITEM_GROUP_OWNED = 1 << 0,
+		ITEM_SHADOW_ASSET = 1 << 1
+	};
+
+	struct ItemRecord
+	{
+		LLUUID	mID;
+		LLUUID	mParentID;
+		LLUUID	mCreatorID;
+		LLUUID	mOwnerID;
+		LLUUID	mLastOwnerID;
+		LLUUID	mGroupID;
+		LLUUID	mAssetID;			// XORed with SHADOW_KEY under ITEM_SHADOW_ASSET
+		U32		mBaseMask;
+		U32		mOwnerMask;
+		U32		mGroupMask;
+		U32		mEveryoneMask;
+		U32		mNextOwnerMask;
+		U32		mFlags;
+		S32		mSalePrice;
+		S32		mCreationDate;
+		U32		mName;
+		U32		mDescription;
+		U16		mNameLength;
+		U16		mDescriptionLength;
+		S8		mType;				// LLAssetType::EType
+		S8		mInventoryType;		// LLInventoryType::EType
+		S8		mSaleType;			// LLSaleInfo::EForSale
+		U8		mItemFlags;			// ITEM_GROUP_OWNED etc.
+	};
+
+	// Records are copied straight out of the mapping, keep them free of
+	// padding and aligned one after the other
+	static_assert(sizeof(Header) == 24, "inventory cache header changed size");
+	static_assert(sizeof(CategoryRecord) == 60, "inventory cache category record changed size");
+	static_assert(sizeof(ItemRecord) == 160, "inventory cache item record changed size");
+
+	class CacheReader
+	{
+	public:
+		CacheReader(const U8* data, const Header& header,
+					LLInventoryModel::cat_array_t& categories,
+					LLInventoryModel::item_array_t& items)
+		:	mCategories((const CategoryRecord*)(data + sizeof(Header))),
+			mItems((const ItemRecord*)(data + sizeof(Header) + header.mCategoryCount * sizeof(CategoryRecord))),
+			mStrings((const char*)(data + sizeof(Header) + header.mCategoryCount * sizeof(CategoryRecord)
+								   + header.mItemCount * sizeof(ItemRecord))),
+			mStringPoolSize(header.mStringPoolSize),
+			mCategoryCount(header.mCategoryCount),
+			mCategoryOut(categories),
+			mItemOut(items)
+		{
+		}
+
+		// Records [begin, end) of categories followed by items.  Each
+		// call fills in its own slots of the output arrays, so calls on
+		// separate ranges may run at once.  Bad records are left null.
+		void read(U32 begin, U32 end)
+		{
+			for (U32 i = begin; i < end; ++i)
+			{
+				if (i < mCategoryCount)
+				{
+					mCategoryOut[i] = readCategory(mCategories[i]);
+				}
+				else
+				{
+					mItemOut[i - mCategoryCount] = readItem(mItems[i - mCategoryCount]);
+				}
+			}
+		}
+
+	private:
+		bool readString(U32 offset, U16 length, std::string& out) const
+		{
+			if ((U64)offset + length > mStringPoolSize)
+			{
+				return false;
+			}
+			out.assign(mStrings + offset, length);
+			return true;
+		}
+
+		LLViewerInventoryCategory* readCategory(const CategoryRecord& record) const
+		{
+			std::string name;
+			if (!readString(record.mName, record.mNameLength, name))
+			{
+				return nullptr;
+			}
+			LLViewerInventoryCategory* cat = new LLViewerInventoryCategory(record.mID, record.mParentID,
+																		   (LLFolderType::EType)record.mPreferredType,
+																		   name, record.mOwnerID);
+			cat->setType((LLAssetType::EType)record.mType);
+			cat->setVersion(record.mVersion);
+			return cat;
+		}
+
+		LLViewerInventoryItem* readItem(const ItemRecord& record) const
+		{
+			std::string name;
+			std::string desc;
+			if (!readString(record.mName, record.mNameLength, name)
+				|| !readString(record.mDescription, record.mDescriptionLength, desc))
+			{
+				return nullptr;
+			}
+
+			LLPermissions perm;
+			perm.init(record.mCreatorID, record.mOwnerID, record.mLastOwnerID, record.mGroupID);
+			perm.setMaskBase(record.mBaseMask);
+			perm.setMaskOwner(record.mOwnerMask);
+			perm.setMaskGroup(record.mGroupMask);
+			perm.setMaskEveryone(record.mEveryoneMask);
+			perm.setMaskNext(record.mNextOwnerMask);
+			perm.yesReallySetOwner(record.mOwnerID, (record.mItemFlags & ITEM_GROUP_OWNED) != 0);
+
+			LLUUID asset_id(record.mAssetID);
+			if (record.mItemFlags & ITEM_SHADOW_ASSET)
+			{
+				LLXORCipher cipher(SHADOW_KEY.mData, UUID_BYTES);
+				cipher.decrypt(asset_id.mData, UUID_BYTES);
+			}
+
+			LLViewerInventoryItem* item = new LLViewerInventoryItem(record.mID, record.mParentID, perm, asset_id,
+																	(LLAssetType::EType)record.mType,
+																	(LLInventoryType::EType)record.mInventoryType,
+																	name, desc,
+																	LLSaleInfo((LLSaleInfo::EForSale)record.mSaleType, record.mSalePrice),
+																	record.mFlags, record.mCreationDate);
+			// Same as an item read from the text cache
+			item->setComplete(FALSE);
+			return item;
+		}
+
+	private:
+		const CategoryRecord*	mCategories;
+		const ItemRecord*		mItems;
+		const char*				mStrings;
+		const U32				mStringPoolSize;
+		const U32				mCategoryCount;
+		LLInventoryModel::cat_array_t&	mCategoryOut;
+		LLInventoryModel::item_array_t&	mItemOut;
+	};
+
+	class ReadThread : public LLThread
+	{
+	public:
+		ReadThread(U32 index, CacheReader& reader, U32 begin, U32 end)
+		:	LLThread(llformat("inventory cache %u", index)),
+			mReader(reader),
+			mBegin(begin),
+			mEnd(end)
+		{
+		}
+
+	protected:
+		void run() override
+		{
+			mReader.read(mBegin, mEnd);
+		}
+
+	private:
+		CacheReader& mReader;
+		const U32 mBegin;
+		const U32 mEnd;
+	};
+
+	U32 add_string(std::string& pool, const std::string& str, U16& length)
+	{
+		U32 offset = (U32)pool.size();
+		length = (U16)llmin(str.size(), (size_t)U16_MAX);
+		pool.append(str, 0, length);
+		return offset;
+	}
+
+	bool parent_less(const LLViewerInventoryItem* a, const LLViewerInventoryItem* b)
+	{
+		return a->getParentUUID() < b->getParentUUID();
+	}
+}
+
+// static
+bool LLInventoryCache::load(const std::string& filename, S32 cache_version,
+							LLInventoryModel::cat_array_t& categories,
+							LLInventoryModel::item_array_t& items,
+							bool& is_cache_obsolete)
+{
+	is_cache_obsolete = true;	// Obsolete until proven current
+
+	LLMappedFile file;
+	if (!file.open(filename, false))
+	{
+		LL_INFOS("Inventory") << "unable to load inventory from: " << filename << LL_ENDL;
+		return false;
+	}
+
+	LLTimer timer;
+	const U8* data = file.getData();
+	Header header;
+	if (file.getSize() < (S64)sizeof(Header))
+	{
+		LL_WARNS("Inventory") << "Inventory cache " << filename << " is truncated" << LL_ENDL;
+		return false;
+	}
+	memcpy(&header, data, sizeof(Header));
+	if (memcmp(header.mMagic, CACHE_MAGIC, sizeof(CACHE_MAGIC))
+		|| header.mFormatVersion != FORMAT_VERSION
+		|| header.mCacheVersion != cache_version)
+	{
+		LL_INFOS("Inventory") << "Inventory cache " << filename << " is out of date" << LL_ENDL;
+		return false;
+	}
+	is_cache_obsolete = false;
+
+	const S64 expected_size = (S64)sizeof(Header)
+		+ (S64)header.mCategoryCount * sizeof(CategoryRecord)
+		+ (S64)header.mItemCount * sizeof(ItemRecord)
+		+ header.mStringPoolSize;
+	if (file.getSize() != expected_size)
+	{
+		LL_WARNS("Inventory") << "Inventory cache " << filename << " is " << file.getSize()
+							  << " bytes, expected " << expected_size << LL_ENDL;
+		// Can't trust it, have it thrown away
+		is_cache_obsolete = true;
+		return false;
+	}
+
+	const size_t first_category = categories.size();
+	const size_t first_item = items.size();
+	LLInventoryModel::cat_array_t new_categories(header.mCategoryCount);
+	LLInventoryModel::item_array_t new_items(header.mItemCount);
+	CacheReader reader(data, header, new_categories, new_items);
+
+	// Split the records evenly, this thread taking the last share
+	const U32 total = header.mCategoryCount + header.mItemCount;
+	U32 threads = llclamp((U32)boost::thread::hardware_concurrency() / 2, 1U, 4U);
+	threads = llclamp(total / MIN_RECORDS_PER_THREAD, 1U, threads);
+	std::vector<ReadThread*> workers;
+	U32 begin = 0;
+	for (U32 i = 0; i + 1 < threads; ++i)
+	{
+		U32 end = begin + total / threads;
+		ReadThread* worker = new ReadThread(i, reader, begin, end);
+		worker->start();
+		workers.push_back(worker);
+		begin = end;
+	}
+	reader.read(begin, total);
+	for (ReadThread* worker : workers)
+	{
+		// Joins it
+		worker->shutdown();
+		delete worker;
+	}
+
+	S32 bad_categories = 0;
+	categories.reserve(first_category + new_categories.size());
+	for (LLPointer<LLViewerInventoryCategory>& cat : new_categories)
+	{
+		if (cat.notNull())
+		{
+			categories.push_back(cat);
+		}
+		else
+		{
+			++bad_categories;
+		}
+	}
+
+	S32 bad_items = 0;
+	items.reserve(first_item + new_items.size());
+	for (LLPointer<LLViewerInventoryItem>& item : new_items)
+	{
+		if (item.isNull())
+		{
+			++bad_items;
+		}
+		else if (item->getUUID().isNull())
+		{
+			LL_WARNS("Inventory") << "Ignoring inventory with null item id: " << item->getName() << LL_ENDL;
+		}
+		else
+		{
+			items.push_back(item);
+		}
+	}
+
+	if (bad_categories || bad_items)
+	{
+		LL_WARNS("Inventory") << "Ignored " << bad_categories << " invalid categories and "
+							  << bad_items << " invalid items in " << filename << LL_ENDL;
+	}
+	LL_INFOS("Inventory") << "Loaded " << categories.size() - first_category << " categories and "
+						  << items.size() - first_item << " items from " << filename
+						  << " on " << threads << " thread(s) in " << timer.getElapsedTimeF32() * 1000.f << " ms" << LL_ENDL;
+	return true;
+}
+
+// static
+bool LLInventoryCache::save(const std::string& filename, S32 cache_version,
+							const LLInventoryModel::cat_array_t& categories,
+							const LLInventoryModel::item_array_t& items)
+{
+	std::string pool;
+	std::vector<CategoryRecord> category_records;
+	category_records.reserve(categories.size());
+	for (const LLPointer<LLViewerInventoryCategory>& cat : categories)
+	{
+		if (cat->getVersion() == LLViewerInventoryCategory::VERSION_UNKNOWN)
+		{
+			continue;
+		}
+		CategoryRecord record;
+		memset(&record, 0, sizeof(record));
+		record.mID = cat->getUUID();
+		record.mParentID = cat->getParentUUID();
+		record.mOwnerID = cat->getOwnerID();
+		record.mVersion = cat->getVersion();
+		record.mName = add_string(pool, cat->getName(), record.mNameLength);
+		record.mType = (S8)cat->getType();
+		record.mPreferredType = (S8)cat->getPreferredType();
+		category_records.push_back(record);
+	}
+
+	// Siblings next to each other, so building the parent-child map after
+	// loading is a lookup per folder rather than per item
+	std::vector<const LLViewerInventoryItem*> sorted;
+	sorted.reserve(items.size());
+	for (const LLPointer<LLViewerInventoryItem>& item : items)
+	{
+		sorted.push_back(item.get());
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), parent_less);
+
+	std::vector<ItemRecord> item_records;
+	item_records.reserve(sorted.size());
+	for (const LLViewerInventoryItem* item : sorted)
+	{
+		const LLPermissions& perm = item->getPermissions();
+		ItemRecord record;
+		memset(&record, 0, sizeof(record));
+		record.mID = item->getUUID();
+		record.mParentID = item->getParentUUID();
+		record.mCreatorID = perm.getCreator();
+		record.mOwnerID = perm.getOwner();
+		record.mLastOwnerID = perm.getLastOwner();
+		record.mGroupID = perm.getGroup();
+		record.mAssetID = item->getAssetUUID();
+		record.mBaseMask = perm.getMaskBase();
+		record.mOwnerMask = perm.getMaskOwner();
+		record.mGroupMask = perm.getMaskGroup();
+		record.mEveryoneMask = perm.getMaskEveryone();
+		record.mNextOwnerMask = perm.getMaskNextOwner();
+		record.mFlags = item->getFlags();
+		record.mSalePrice = item->getSaleInfo().getSalePrice();
+		record.mCreationDate = (S32)item->getCreationDate();
+		record.mName = add_string(pool, item->getName(), record.mNameLength);
+		record.mDescription = add_string(pool, item->getDescription(), record.mDescriptionLength);
+		record.mType = (S8)item->getType();
+		record.mInventoryType = (S8)item->getInventoryType();
+		record.mSaleType = (S8)item->getSaleInfo().getSaleType();
+		if (perm.isGroupOwned())
+		{
+			record.mItemFlags |= ITEM_GROUP_OWNED;
+		}
+		if ((perm.getMaskBase() & PERM_ITEM_UNRESTRICTED) != PERM_ITEM_UNRESTRICTED
+			&& record.mAssetID.notNull())
+		{
+			LLXORCipher cipher(SHADOW_KEY.mData, UUID_BYTES);
+			cipher.encrypt(record.mAssetID.mData, UUID_BYTES);
+			record.mItemFlags |= ITEM_SHADOW_ASSET;
+		}
+		item_records.push_back(record);
+	}
+
+	Header header;
+	memcpy(header.mMagic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.mFormatVersion = FORMAT_VERSION;
+	header.mCacheVersion = cache_version;
+	header.mCategoryCount = (U32)category_records.size();
+	header.mItemCount = (U32)item_records.size();
+	header.mStringPoolSize = (U32)pool.size();
+
+	// Written beside it and renamed over, so a crash part way through
+	// leaves the previous cache rather than half of this one
+	std::string temp_filename = filename + ".tmp";
+	LLFILE* fp = LLFile::fopen(temp_filename, "wb");
+	if (!fp)
+	{
+		LL_WARNS("Inventory") << "unable to save inventory to: " << temp_filename << LL_ENDL;
+		return false;
+	}
+	bool written = fwrite(&header, sizeof(header), 1, fp) == 1
+		&& (category_records.empty()
+			|| fwrite(category_records.data(), sizeof(CategoryRecord), category_records.size(), fp) == category_records.size())
+		&& (item_records.empty()
+			|| fwrite(item_records.data(), sizeof(ItemRecord), item_records.size(), fp) == item_records.size())
+		&& (pool.empty() || fwrite(pool.data(), pool.size(), 1, fp) == 1);
+	written = (fclose(fp) == 0) && written;
+	if (!written)
+	{
+		LL_WARNS("Inventory") << "unable to write inventory to: " << temp_filename << LL_ENDL;
+		LLFile::remove(temp_filename);
+		return false;
+	}
+
+	LLFile::remove(filename, ENOENT);
+	if (LLFile::rename(temp_filename, filename) != 0)
+	{
+		LL_WARNS("Inventory") << "unable to replace " << filename << LL_ENDL;
+		LLFile::remove(temp_filename);
+		return false;
+	}
+	LL_INFOS("Inventory") << "Saved " << header.mCategoryCount << " categories and "
+						  << header.mItemCount << " items to " << filename << LL_ENDL;
+	return true;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file llinventorycache.h
+ * @brief Binary on-disk cache of the agent's inventory
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLINVENTORYCACHE_H
+#define LL_LLINVENTORYCACHE_H
+
+#include "llinventorymodel.h"
+
+// Replaces the gzipped text .inv cache.  Every category and item is a
+// fixed size record and names and descriptions live in a string pool at
+// the end, so the file is mapped rather than read and the records are
+// turned into inventory objects on several threads at once.
+//
+// Layout, native byte order (the version check turns away anything
+// else):
+//   Header
+//   CategoryRecord[mCategoryCount]
+//   ItemRecord[mItemCount]			grouped by parent, see load()
+//   char[mStringPoolSize]			not terminated
+class LLInventoryCache
+{
+public:
+	// Bump when the record layout changes
+	static const U32 FORMAT_VERSION = 1;
+
+	// cache_version is LLInventoryModel's, a mismatch sets
+	// is_cache_obsolete and fails the load the way the text cache did.
+	// Items come back with all the children of a category next to each
+	// other.  Null item ids and records that don't hold together are
+	// dropped with a warning.
+	static bool load(const std::string& filename, S32 cache_version,
+					 LLInventoryModel::cat_array_t& categories,
+					 LLInventoryModel::item_array_t& items,
+					 bool& is_cache_obsolete);
+
+	// Categories without a known version are left out, as before.
+	static bool save(const std::string& filename, S32 cache_version,
+					 const LLInventoryModel::cat_array_t& categories,
+					 const LLInventoryModel::item_array_t& items);
+};
+
+#endif // LL_LLINVENTORYCACHE_H
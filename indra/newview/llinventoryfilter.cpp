@@ -40,6 +40,7 @@
 #include "llagentwearables.h"
 #include "llvoavatarself.h"
 #include "llinventoryclipboard.h"
+#include "llinventorynameindex.h"
 
 // linden library includes
 #include "lltrans.h"
@@ -76,6 +77,7 @@ LLInventoryFilter::LLInventoryFilter(const std::string& name)
 
 	mSubStringMatchOffset = std::string::npos;
 	mFilterCount = 0;
+	mFilterTimeLimit = 0.f;
 
 	// copy mFilterOps into mDefaultFilterOps
 	markDefault();
@@ -168,6 +170,34 @@ bool LLInventoryFilter::checkFolder(const LLUUID& folder_id) const
 	return passed_clipboard;
 }
 
+bool LLInventoryFilter::canSkipDescendants(LLFolderViewFolder* folder) const
+{
+	// Only names are indexed, so not when searching descriptions or
+	// creators too
+	if (mFilterSubString.empty() || (folder->getRoot()->getSearchType() & ~1U))
+	{
+		return false;
+	}
+
+	// Object contents and such aren't in the model
+	const LLFolderViewEventListener* listener = folder->getListener();
+	if (!listener || !gInventory.getCategory(listener->getUUID()))
+	{
+		return false;
+	}
+
+	// The searchable label is the name and then the suffix, which the
+	// index knows nothing about
+	if (LLFolderViewItem::labelSuffixCouldMatch(mFilterSubString))
+	{
+		return false;
+	}
+
+	const LLInventoryNameIndex::folder_set_t* folders =
+		LLInventoryNameIndex::instance().getFoldersWithMatches(mFilterSubString);
+	return folders && !folders->count(listener->getUUID());
+}
+
 bool LLInventoryFilter::checkAgainstFilterType(const LLFolderViewItem* item) const
 {
 	const LLFolderViewEventListener* listener = item->getListener();
@@ -1041,6 +1071,19 @@ S32 LLInventoryFilter::getFilterCount() const
 void LLInventoryFilter::decrementFilterCount() 
 { 
 	mFilterCount--; 
+	// Looking at the clock every few items is plenty
+	if (mFilterTimeLimit > 0.f
+		&& (mFilterCount & 15) == 0
+		&& mFilterTimer.getElapsedTimeF32() > mFilterTimeLimit)
+	{
+		mFilterCount = -1;
+	}
+}
+
+void LLInventoryFilter::setFilterTimeLimit(F32 seconds)
+{
+	mFilterTimeLimit = seconds;
+	mFilterTimer.reset();
 }
 
 S32 LLInventoryFilter::getCurrentGeneration() const 
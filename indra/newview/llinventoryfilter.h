@@ -29,6 +29,7 @@
 
 #include "llinventorytype.h"
 #include "llpermissionsflags.h"
+#include "lltimer.h"
 
 class LLFolderViewItem;
 class LLFolderViewFolder;
@@ -141,6 +142,9 @@ struct FilterOps
 	bool 				check(LLFolderViewItem* item);
 	bool				checkFolder(const LLFolderViewFolder* folder) const;
 	bool				checkFolder(const LLUUID& folder_id) const;
+	// True when the search string rules out everything under folder, so
+	// it needn't be walked
+	bool				canSkipDescendants(LLFolderViewFolder* folder) const;
 
 	bool				showAllResults() const;
 
@@ -174,6 +178,8 @@ struct FilterOps
 	void 				setFilterCount(S32 count);
 	S32 				getFilterCount() const;
 	void 				decrementFilterCount();
+	// Also runs the count out once this long has passed, 0 for no limit
+	void				setFilterTimeLimit(F32 seconds);
 
 	// +-------------------------------------------------------------------+
 	// + Default
@@ -220,6 +226,8 @@ private:
 	S32						mFirstSuccessGeneration;
 
 	S32						mFilterCount;
+	F32						mFilterTimeLimit;
+	LLTimer					mFilterTimer;
 	EFilterModified 		mFilterModified;
 
 	std::string 			mFilterText;
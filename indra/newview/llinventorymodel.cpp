@@ -37,6 +37,7 @@
 #include "llinventoryclipboard.h"
 #include "llinventorypanel.h"
 #include "llinventorybridge.h"
+#include "llinventorycache.h"
 #include "llinventoryfunctions.h"
 #include "llinventoryobserver.h"
 #include "llinventorypanel.h"
@@ -78,6 +79,7 @@ BOOL LLInventoryModel::sFirstTimeInViewer2 = TRUE;
 
 //BOOL decompress_file(const char* src_filename, const char* dst_filename);
 static const char CACHE_FORMAT_STRING[] = "%s.inv"; 
+static const char BINARY_CACHE_FORMAT_STRING[] = "%s.invc";
 static const char * const LOG_INV("Inventory");
 
 struct InventoryIDPtrLess
@@ -137,7 +139,7 @@ LLInventoryModel gInventory;
 // Default constructor
 LLInventoryModel::LLInventoryModel()
 :	// These are now ordered, keep them that way.
-	mBacklinkMMap(),
+	mBacklinkMap(),
 	mIsAgentInvUsable(false),
 	mRootFolderID(),
 	mLibraryRootFolderID(),
@@ -146,6 +148,8 @@ LLInventoryModel::LLInventoryModel()
 	mItemMap(),
 	mParentChildCategoryTree(),
 	mParentChildItemTree(),
+	mCachedItems(),
+	mLoadingCache(false),
 	mLastItem(NULL),
 	mIsNotifyObservers(FALSE),
 	mModifyMask(LLInventoryObserver::ALL),
@@ -919,13 +923,16 @@ LLInventoryModel::item_array_t LLInventoryModel::collectLinksTo(const LLUUID& id
 	if (!obj || obj->getIsLinkType())
 		return items;
 	
-	std::pair<backlink_mmap_t::iterator, backlink_mmap_t::iterator> range = mBacklinkMMap.equal_range(id);
-	for (backlink_mmap_t::iterator it = range.first; it != range.second; ++it)
+	backlink_map_t::const_iterator links = mBacklinkMap.find(id);
+	if (links == mBacklinkMap.end())
+		return items;
+
+	for (uuid_vec_t::const_iterator it = links->second.begin(); it != links->second.end(); ++it)
 	{
-		LLViewerInventoryItem *item = getItem(it->second);
+		LLViewerInventoryItem *item = getItem(*it);
 		if (item)
 		{
-			if(start_folder_id.isNull() || isObjectDescendentOf(it->second, start_folder_id))
+			if(start_folder_id.isNull() || isObjectDescendentOf(*it, start_folder_id))
 			items.push_back(item);
 		}
 	}
@@ -1511,6 +1518,7 @@ void LLInventoryModel::deleteObject(const LLUUID& id, bool fix_broken_links, boo
 	LLUUID parent_id = obj->getParentUUID();
 	mCategoryMap.erase(id);
 	mItemMap.erase(id);
+	mCachedItems.clear();
 	//mInventory.erase(id);
 	item_array_t* item_list = getUnlockedItemArray(parent_id);
 	if(item_list)
@@ -1744,18 +1752,14 @@ void LLInventoryModel::cache(
 	std::string inventory_filename;
 	agent_id.toString(agent_id_str);
 	std::string path(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, agent_id_str));
-	inventory_filename = llformat(CACHE_FORMAT_STRING, path.c_str());
-	saveToFile(inventory_filename, categories, items);
-	std::string gzip_filename(inventory_filename);
-	gzip_filename.append(".gz");
-	if(gzip_file(inventory_filename, gzip_filename))
-	{
-		LL_DEBUGS(LOG_INV) << "Successfully compressed " << inventory_filename << LL_ENDL;
-		LLFile::remove(inventory_filename);
-	}
-	else
+	inventory_filename = llformat(BINARY_CACHE_FORMAT_STRING, path.c_str());
+	if(LLInventoryCache::save(inventory_filename, sCurrentInvCacheVersion, categories, items))
 	{
-		LL_WARNS(LOG_INV) << "Unable to compress " << inventory_filename << LL_ENDL;
+		// The text cache from before is stale now, don't let it be
+		// picked up should this one go missing
+		std::string gzip_filename(llformat(CACHE_FORMAT_STRING, path.c_str()));
+		gzip_filename.append(".gz");
+		LLFile::remove(gzip_filename, ENOENT);
 	}
 }
 
@@ -1782,42 +1786,31 @@ void LLInventoryModel::addCategory(LLViewerInventoryCategory* category)
 
 bool LLInventoryModel::hasBacklinkInfo(const LLUUID& link_id, const LLUUID& target_id) const
 {
-	std::pair <backlink_mmap_t::const_iterator, backlink_mmap_t::const_iterator> range;
-	range = mBacklinkMMap.equal_range(target_id);
-	for (backlink_mmap_t::const_iterator it = range.first; it != range.second; ++it)
-	{
-		if (it->second == link_id)
-		{
-			return true;
-		}
-	}
-	return false;
+	backlink_map_t::const_iterator links = mBacklinkMap.find(target_id);
+	return links != mBacklinkMap.end()
+		&& std::find(links->second.begin(), links->second.end(), link_id) != links->second.end();
 }
 
 void LLInventoryModel::addBacklinkInfo(const LLUUID& link_id, const LLUUID& target_id)
 {
-	if (!hasBacklinkInfo(link_id, target_id))
+	uuid_vec_t& links = mBacklinkMap[target_id];
+	if (std::find(links.begin(), links.end(), link_id) == links.end())
 	{
-		mBacklinkMMap.insert(std::make_pair(target_id, link_id));
+		links.push_back(link_id);
 	}
 }
 
 void LLInventoryModel::removeBacklinkInfo(const LLUUID& link_id, const LLUUID& target_id)
 {
-	std::pair <backlink_mmap_t::iterator, backlink_mmap_t::iterator> range;
-	range = mBacklinkMMap.equal_range(target_id);
-	for (backlink_mmap_t::iterator it = range.first; it != range.second; )
+	backlink_map_t::iterator links = mBacklinkMap.find(target_id);
+	if (links == mBacklinkMap.end())
 	{
-		if (it->second == link_id)
-		{
-			backlink_mmap_t::iterator delete_it = it; // iterator will be invalidated by erase.
-			++it;
-			mBacklinkMMap.erase(delete_it);
-		}
-		else
-		{
-			++it;
-		}
+		return;
+	}
+	links->second.erase(std::remove(links->second.begin(), links->second.end(), link_id), links->second.end());
+	if (links->second.empty())
+	{
+		mBacklinkMap.erase(links);
 	}
 }
 
@@ -1854,6 +1847,14 @@ void LLInventoryModel::addItem(LLViewerInventoryItem* item)
 			addBacklinkInfo(link_id, target_id);
 		}
 		mItemMap[item->getUUID()] = item;
+		if (mLoadingCache)
+		{
+			mCachedItems.push_back(item);
+		}
+		else
+		{
+			mCachedItems.clear();
+		}
 	}
 }
 
@@ -1871,9 +1872,10 @@ void LLInventoryModel::empty()
 		mParentChildItemTree.end(),
 		DeletePairedPointer());
 	mParentChildItemTree.clear();
-	mBacklinkMMap.clear(); // forget all backlink information.
+	mBacklinkMap.clear(); // forget all backlink information.
 	mCategoryMap.clear(); // remove all references (should delete entries)
 	mItemMap.clear(); // remove all references (should delete entries)
+	mCachedItems.clear();
 	mLastItem = NULL;
 	//mInventory.clear();
 }
@@ -2056,12 +2058,16 @@ bool LLInventoryModel::loadSkeleton(
 		const S32 NO_VERSION = LLViewerInventoryCategory::VERSION_UNKNOWN;
 		std::string gzip_filename(inventory_filename);
 		gzip_filename.append(".gz");
-		LLFILE* fp = LLFile::fopen(gzip_filename, "rb");
+		std::string binary_filename(llformat(BINARY_CACHE_FORMAT_STRING, path.c_str()));
+		bool is_binary_obsolete = false;
+		bool is_cache_obsolete = false;
 		bool remove_inventory_file = false;
-		if(fp)
+		bool loaded = LLInventoryCache::load(binary_filename, sCurrentInvCacheVersion,
+											 categories, items, is_binary_obsolete);
+		if(!loaded && LLFile::isfile(gzip_filename))
 		{
-			fclose(fp);
-			fp = NULL;
+			// Left by a viewer from before the binary cache, read it
+			// this once; cache() replaces it on the way out.
 			if(gunzip_file(gzip_filename, inventory_filename))
 			{
 				// we only want to remove the inventory file if it was
@@ -2073,9 +2079,9 @@ bool LLInventoryModel::loadSkeleton(
 			{
 				LL_INFOS(LOG_INV) << "Unable to gunzip " << gzip_filename << LL_ENDL;
 			}
+			loaded = loadFromFile(inventory_filename, categories, items, is_cache_obsolete);
 		}
-		bool is_cache_obsolete = false;
-		if(loadFromFile(inventory_filename, categories, items, is_cache_obsolete))
+		if(loaded)
 		{
 			// We were able to find a cache of files. So, use what we
 			// found to generate a set of categories we should add. We
@@ -2136,6 +2142,9 @@ bool LLInventoryModel::loadSkeleton(
 			S32 good_link_count = 0;
 			S32 recovered_link_count = 0;
 			cat_map_t::iterator unparented = mCategoryMap.end();
+			// The cache keeps siblings together, remember that order
+			// for buildParentChildMap()
+			mLoadingCache = true;
 			for(item_array_t::const_iterator item_iter = items.begin();
 				item_iter != items.end();
 				++item_iter)
@@ -2200,6 +2209,7 @@ bool LLInventoryModel::loadSkeleton(
 								  << recovered_link_count << " links added in recovery. "
 								  << "The corresponding categories were invalidated." << LL_ENDL;
 			}
+			mLoadingCache = false;
 
 		}
 		else
@@ -2259,6 +2269,11 @@ bool LLInventoryModel::loadSkeleton(
 			LL_WARNS(LOG_INV) << "Inv cache out of date, removing" << LL_ENDL;
 			LLFile::remove(gzip_filename);
 		}
+		if(is_binary_obsolete)
+		{
+			LL_WARNS(LOG_INV) << "Binary inv cache out of date, removing" << LL_ENDL;
+			LLFile::remove(binary_filename, ENOENT);
+		}
 		categories.clear(); // will unref and delete entries
 	}
 
@@ -2399,7 +2414,13 @@ void LLInventoryModel::buildParentChildMap()
 	// have to do is iterate over the items and put them in the right
 	// place.
 	item_array_t items;
-	if(!mItemMap.empty())
+	if(!mCachedItems.empty() && mCachedItems.size() == mItemMap.size())
+	{
+		// Everything came from the cache, which keeps siblings together:
+		// look up each folder once rather than once per item.
+		items.swap(mCachedItems);
+	}
+	else if(!mItemMap.empty())
 	{
 		LLPointer<LLViewerInventoryItem> item;
 		for(item_map_t::iterator iit = mItemMap.begin(); iit != mItemMap.end(); ++iit)
@@ -2408,14 +2429,22 @@ void LLInventoryModel::buildParentChildMap()
 			items.push_back(item);
 		}
 	}
+	mCachedItems.clear();
 	count = items.size();
 	lost = 0;
 	uuid_vec_t lost_item_ids;
+	LLUUID last_parent_id;
+	item_array_t* last_itemsp = NULL;
 	for(i = 0; i < count; ++i)
 	{
 		LLPointer<LLViewerInventoryItem> item;
 		item = items.at(i);
-		itemsp = getUnlockedItemArray(item->getParentUUID());
+		if(!last_itemsp || item->getParentUUID() != last_parent_id)
+		{
+			last_parent_id = item->getParentUUID();
+			last_itemsp = getUnlockedItemArray(last_parent_id);
+		}
+		itemsp = last_itemsp;
 		if(itemsp)
 		{
 			itemsp->push_back(item);
@@ -4008,8 +4037,7 @@ bool LLInventoryModel::validate() const
 			}
 
 			// Links should not have backlinks.
-			std::pair<backlink_mmap_t::const_iterator, backlink_mmap_t::const_iterator> range = mBacklinkMMap.equal_range(link_id);
-			if (range.first != range.second)
+			if (mBacklinkMap.count(link_id))
 			{
 				LL_WARNS() << "Link item " << item->getName() << " has backlinks!" << LL_ENDL;
 			}
@@ -4018,10 +4046,12 @@ bool LLInventoryModel::validate() const
 		{
 			// Check the backlinks of a non-link item.
 			const LLUUID& target_id = item->getUUID();
-			std::pair<backlink_mmap_t::const_iterator, backlink_mmap_t::const_iterator> range = mBacklinkMMap.equal_range(target_id);
-			for (backlink_mmap_t::const_iterator it = range.first; it != range.second; ++it)
+			backlink_map_t::const_iterator links = mBacklinkMap.find(target_id);
+			const uuid_vec_t no_links;
+			const uuid_vec_t& link_ids = links != mBacklinkMap.end() ? links->second : no_links;
+			for (uuid_vec_t::const_iterator it = link_ids.begin(); it != link_ids.end(); ++it)
 			{
-				const LLUUID& link_id = it->second;
+				const LLUUID& link_id = *it;
 				LLViewerInventoryItem *link_item = getItem(link_id);
 				if (!link_item || !link_item->getIsLinkType())
 				{
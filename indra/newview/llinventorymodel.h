@@ -36,6 +36,7 @@
 #include "llfoldertype.h"
 #include "llframetimer.h"
 #include "lluuid.h"
+#include "lluuidhashmap.h"
 #include "llpermissionsflags.h"
 #include "llviewerinventory.h"
 #include "llstring.h"
@@ -174,21 +175,28 @@ private:
 	// information in a lot of different ways so we can access
 	// the inventory using several different identifiers.
 	// mInventory member data is the 'master' list of inventory, and
-	// mCategoryMap and mItemMap store uuid->object mappings. 
-	typedef std::map<LLUUID, LLPointer<LLViewerInventoryCategory> > cat_map_t;
-	typedef std::map<LLUUID, LLPointer<LLViewerInventoryItem> > item_map_t;
+	// mCategoryMap and mItemMap store uuid->object mappings. These are
+	// hash maps, so iterating them is in no particular order and erasing
+	// invalidates iterators (see lluuidhashmap.h).
+	typedef LLUUIDHashMap<LLPointer<LLViewerInventoryCategory> > cat_map_t;
+	typedef LLUUIDHashMap<LLPointer<LLViewerInventoryItem> > item_map_t;
 	cat_map_t mCategoryMap;
 	item_map_t mItemMap;
 	// This last set of indices is used to map parents to children.
-	typedef std::map<LLUUID, cat_array_t*> parent_cat_map_t;
-	typedef std::map<LLUUID, item_array_t*> parent_item_map_t;
+	typedef LLUUIDHashMap<cat_array_t*> parent_cat_map_t;
+	typedef LLUUIDHashMap<item_array_t*> parent_item_map_t;
 	parent_cat_map_t mParentChildCategoryTree;
 	parent_item_map_t mParentChildItemTree;
+	// Items loadSkeleton() took from the cache, siblings next to each
+	// other, for buildParentChildMap() to file a folder at a time.
+	// Dropped as soon as anything else touches mItemMap.
+	item_array_t mCachedItems;
+	bool mLoadingCache;
 
 	// Track links to items and categories. We do not store item or
 	// category pointers here, because broken links are also supported.
-	typedef std::multimap<LLUUID, LLUUID> backlink_mmap_t;
-	backlink_mmap_t mBacklinkMMap; // key = target_id: ID of item, values = link_ids: IDs of item or folder links referencing it.
+	typedef LLUUIDHashMap<uuid_vec_t> backlink_map_t;
+	backlink_map_t mBacklinkMap; // key = target_id: ID of item, values = link_ids: IDs of item or folder links referencing it.
 	// For internal use only
 	bool hasBacklinkInfo(const LLUUID& link_id, const LLUUID& target_id) const;
 	void addBacklinkInfo(const LLUUID& link_id, const LLUUID& target_id);
@@ -657,8 +665,8 @@ protected:
 	cat_array_t* getUnlockedCatArray(const LLUUID& id);
 	item_array_t* getUnlockedItemArray(const LLUUID& id);
 private:
-	std::map<LLUUID, bool> mCategoryLock;
-	std::map<LLUUID, bool> mItemLock;
+	LLUUIDHashMap<bool> mCategoryLock;
+	LLUUIDHashMap<bool> mItemLock;
 	
 	//--------------------------------------------------------------------
 	// Debugging
@@ -0,0 +1,314 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/**
+ * @file llinventorynameindex.cpp
+ * @brief Trigram index over the names in the agent's inventory
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llinventorynameindex.h"
+
+#include "llinventorymodel.h"
+#include "llviewerinventory.h"
+
+// Changes that can alter which folders hold a match
+static const U32 INDEXED_CHANGES = LLInventoryObserver::LABEL | LLInventoryObserver::ADD
+	| LLInventoryObserver::REMOVE | LLInventoryObserver::STRUCTURE | LLInventoryObserver::REBUILD;
+
+// Rebuild once this many slots are empty and they're over half of them
+static const U32 MIN_DEAD_SLOTS_TO_REBUILD = 1024;
+
+static inline U32 trigram_at(const std::string& str, size_t pos)
+{
+	return ((U32)(U8)str[pos] << 16) | ((U32)(U8)str[pos + 1] << 8) | (U32)(U8)str[pos + 2];
+}
+
+LLInventoryNameIndex::LLInventoryNameIndex()
+:	mDeadSlots(0),
+	mNeedsRebuild(true),
+	mRevision(1),
+	mLastRevision(0)
+{
+	gInventory.addObserver(this);
+}
+
+LLInventoryNameIndex::~LLInventoryNameIndex()
+{
+	if (gInventory.containsObserver(this))
+	{
+		gInventory.removeObserver(this);
+	}
+}
+
+void LLInventoryNameIndex::changed(U32 mask)
+{
+	if (!(mask & INDEXED_CHANGES))
+	{
+		return;
+	}
+	++mRevision;
+	// Moves only need the revision bump, parents are looked up live
+	if (mNeedsRebuild || !(mask & ~LLInventoryObserver::STRUCTURE & INDEXED_CHANGES))
+	{
+		return;
+	}
+
+	const LLInventoryModel::changed_items_t& ids = gInventory.getChangedIDs();
+	if (ids.empty())
+	{
+		// Something wholesale, such as the initial build
+		mNeedsRebuild = true;
+		return;
+	}
+	for (LLInventoryModel::changed_items_t::const_iterator it = ids.begin(); it != ids.end(); ++it)
+	{
+		remove(*it);
+		const LLInventoryObject* obj = gInventory.getObject(*it);
+		if (obj)
+		{
+			add(obj);
+		}
+	}
+}
+
+const LLInventoryNameIndex::folder_set_t* LLInventoryNameIndex::getFoldersWithMatches(const std::string& sub_string)
+{
+	if (mNeedsRebuild
+		|| (mDeadSlots > MIN_DEAD_SLOTS_TO_REBUILD && mDeadSlots * 2 > mIDs.size()))
+	{
+		rebuild();
+		if (mNeedsRebuild)
+		{
+			return NULL;
+		}
+	}
+
+	if (mLastRevision == mRevision && sub_string == mLastSubString)
+	{
+		return &mFolders;
+	}
+
+	uuid_vec_t link_matches;
+	findMatches(sub_string, link_matches);
+
+	mFolders.clear();
+	for (slot_vec_t::const_iterator it = mLastMatches.begin(); it != mLastMatches.end(); ++it)
+	{
+		addAncestors(mIDs[*it]);
+	}
+	for (uuid_vec_t::const_iterator it = link_matches.begin(); it != link_matches.end(); ++it)
+	{
+		addAncestors(*it);
+	}
+
+	mLastSubString = sub_string;
+	mLastRevision = mRevision;
+	return &mFolders;
+}
+
+void LLInventoryNameIndex::rebuild()
+{
+	mNames.clear();
+	mIDs.clear();
+	mSlots.clear();
+	mDeadSlots = 0;
+	mTrigrams.clear();
+	mLinks.clear();
+	mLastSubString.clear();
+	mLastMatches.clear();
+	++mRevision;
+
+	if (!gInventory.isInventoryUsable())
+	{
+		mNeedsRebuild = true;
+		return;
+	}
+
+	const LLUUID roots[] = { gInventory.getRootFolderID(), gInventory.getLibraryRootFolderID() };
+	for (const LLUUID& root_id : roots)
+	{
+		const LLViewerInventoryCategory* root = gInventory.getCategory(root_id);
+		if (!root)
+		{
+			continue;
+		}
+		add(root);
+
+		LLInventoryModel::cat_array_t cats;
+		LLInventoryModel::item_array_t items;
+		gInventory.collectDescendents(root_id, cats, items, LLInventoryModel::INCLUDE_TRASH);
+		mSlots.reserve(mSlots.size() + cats.size() + items.size());
+		for (LLInventoryModel::cat_array_t::const_iterator it = cats.begin(); it != cats.end(); ++it)
+		{
+			add(*it);
+		}
+		for (LLInventoryModel::item_array_t::const_iterator it = items.begin(); it != items.end(); ++it)
+		{
+			add(*it);
+		}
+	}
+	mNeedsRebuild = false;
+
+	LL_DEBUGS("Inventory") << "Indexed " << mIDs.size() << " names, " << mLinks.size()
+						   << " links, " << mTrigrams.size() << " trigrams" << LL_ENDL;
+}
+
+void LLInventoryNameIndex::add(const LLInventoryObject* obj)
+{
+	const LLUUID& id = obj->getUUID();
+	if (obj->getIsLinkType())
+	{
+		mLinks[id] = true;
+		return;
+	}
+
+	std::string name = obj->getName();
+	LLStringUtil::toUpper(name);
+
+	const U32 slot = (U32)mIDs.size();
+	mIDs.push_back(id);
+	mSlots[id] = slot;
+
+	if (name.size() >= 3)
+	{
+		std::vector<U32> trigrams;
+		trigrams.reserve(name.size() - 2);
+		for (size_t i = 0; i + 2 < name.size(); ++i)
+		{
+			trigrams.push_back(trigram_at(name, i));
+		}
+		std::sort(trigrams.begin(), trigrams.end());
+		trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+		for (std::vector<U32>::const_iterator it = trigrams.begin(); it != trigrams.end(); ++it)
+		{
+			mTrigrams[*it].push_back(slot);
+		}
+	}
+	mNames.push_back(name);
+}
+
+void LLInventoryNameIndex::remove(const LLUUID& id)
+{
+	mLinks.erase(id);
+
+	LLUUIDHashMap<U32>::iterator it = mSlots.find(id);
+	if (it == mSlots.end())
+	{
+		return;
+	}
+	const U32 slot = it->second;
+	mSlots.erase(it);
+	mIDs[slot].setNull();
+	std::string().swap(mNames[slot]);
+	++mDeadSlots;
+}
+
+void LLInventoryNameIndex::findMatches(const std::string& sub_string, uuid_vec_t& link_matches)
+{
+	slot_vec_t candidates;
+	if (mLastRevision == mRevision
+		&& !mLastSubString.empty()
+		&& sub_string.find(mLastSubString) != std::string::npos)
+	{
+		// Anything matching now matched last time
+		candidates.swap(mLastMatches);
+	}
+	else if (sub_string.size() >= 3)
+	{
+		// Every match is in the list of each of the search's trigrams, the
+		// shortest one is the least to check
+		const slot_vec_t* shortest = NULL;
+		for (size_t i = 0; i + 2 < sub_string.size(); ++i)
+		{
+			boost::unordered_map<U32, slot_vec_t>::const_iterator found = mTrigrams.find(trigram_at(sub_string, i));
+			if (found == mTrigrams.end())
+			{
+				shortest = NULL;
+				break;
+			}
+			if (!shortest || found->second.size() < shortest->size())
+			{
+				shortest = &found->second;
+			}
+		}
+		if (shortest)
+		{
+			candidates = *shortest;
+		}
+	}
+	else
+	{
+		// Too short for trigrams, check every name
+		candidates.resize(mIDs.size());
+		for (U32 slot = 0; slot < (U32)candidates.size(); ++slot)
+		{
+			candidates[slot] = slot;
+		}
+	}
+
+	mLastMatches.clear();
+	for (slot_vec_t::const_iterator it = candidates.begin(); it != candidates.end(); ++it)
+	{
+		if (mIDs[*it].notNull() && mNames[*it].find(sub_string) != std::string::npos)
+		{
+			mLastMatches.push_back(*it);
+		}
+	}
+
+	std::string name;
+	for (LLUUIDHashMap<bool>::const_iterator it = mLinks.begin(); it != mLinks.end(); ++it)
+	{
+		const LLInventoryObject* obj = gInventory.getObject(it->first);
+		if (obj)
+		{
+			name = obj->getName();
+			LLStringUtil::toUpper(name);
+			if (name.find(sub_string) != std::string::npos)
+			{
+				link_matches.push_back(it->first);
+			}
+		}
+	}
+}
+
+void LLInventoryNameIndex::addAncestors(const LLUUID& id)
+{
+	const LLInventoryObject* obj = gInventory.getObject(id);
+	LLUUID parent_id = obj ? obj->getParentUUID() : LLUUID::null;
+	while (parent_id.notNull())
+	{
+		// Stop at the first folder already in, its own ancestors are too
+		if (!mFolders.insert(std::make_pair(parent_id, true)).second)
+		{
+			break;
+		}
+		const LLViewerInventoryCategory* cat = gInventory.getCategory(parent_id);
+		if (!cat)
+		{
+			break;
+		}
+		parent_id = cat->getParentUUID();
+	}
+}
@@ -0,0 +1,97 @@
+/**
+ * @file llinventorynameindex.h
+ * @brief Trigram index over the names in the agent's inventory
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLINVENTORYNAMEINDEX_H
+#define LL_LLINVENTORYNAMEINDEX_H
+
+#include <boost/unordered_map.hpp>
+
+#include "llinventoryobserver.h"
+#include "llsingleton.h"
+#include "lluuidhashmap.h"
+
+class LLInventoryObject;
+
+/**
+ * Answers "which folders have something under them whose name contains
+ * this string" without walking the inventory, so the inventory filter can
+ * skip whole folders while the search box is being typed into.
+ *
+ * Every category and item name is kept upper cased, as the folder view
+ * searches, with the trigrams of each name pointing back at it.  A search
+ * takes the candidates of its rarest trigram and checks them; a search
+ * that extends the previous one only rechecks the previous matches.  The
+ * index follows gInventory through its observer.
+ *
+ * Links aren't indexed, their names follow their targets and aren't
+ * reported when those change, so they are checked as they are at search
+ * time.
+ */
+class LLInventoryNameIndex : public LLInventoryObserver, public LLSingleton<LLInventoryNameIndex>
+{
+	LLSINGLETON(LLInventoryNameIndex);
+	virtual ~LLInventoryNameIndex();
+
+public:
+	typedef LLUUIDHashMap<bool> folder_set_t;
+
+	void changed(U32 mask) override;
+
+	// Folders holding, at any depth, an object whose name contains
+	// sub_string, which must be upper cased.  NULL while the inventory
+	// isn't usable.  Valid until the next call or inventory change.
+	const folder_set_t* getFoldersWithMatches(const std::string& sub_string);
+
+private:
+	void rebuild();
+	void add(const LLInventoryObject* obj);
+	void remove(const LLUUID& id);
+	void findMatches(const std::string& sub_string, uuid_vec_t& link_matches);
+	void addAncestors(const LLUUID& id);
+
+	typedef std::vector<U32> slot_vec_t;
+
+	// Names by slot; a removed object's slot is left empty until the next
+	// rebuild so the trigram lists never need fixing up
+	std::vector<std::string>	mNames;
+	uuid_vec_t					mIDs;
+	LLUUIDHashMap<U32>			mSlots;
+	U32							mDeadSlots;
+	boost::unordered_map<U32, slot_vec_t> mTrigrams;
+	LLUUIDHashMap<bool>			mLinks;
+	bool						mNeedsRebuild;
+
+	// Bumped on anything that can change an answer
+	U32							mRevision;
+
+	// Last search, for searches that extend it
+	std::string					mLastSubString;
+	U32							mLastRevision;
+	slot_vec_t					mLastMatches;
+	folder_set_t				mFolders;
+};
+
+#endif // LL_LLINVENTORYNAMEINDEX_H
@@ -0,0 +1,520 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/**
+ * @file llmeshcache.cpp
+ * @brief On-disk cache of mesh asset parts.
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llmeshcache.h"
+
+#include <algorithm>
+
+#include "llcrc.h"
+#include "lldir.h"
+#include "llfile.h"
+
+static const U32 MESH_DATA_MAGIC = 0x4448534d;		// "MSHD"
+static const U32 MESH_INDEX_MAGIC = 0x4948534d;		// "MSHI"
+static const U32 MESH_CACHE_VERSION = 1;
+
+// Grow the data file in steps of this much
+static const U32 MESH_DATA_GROWTH = 16 * 1024 * 1024;
+// Appends stop once the data file (garbage included) is this much over the limit
+static const U32 MESH_DATA_SLACK_PERCENT = 25;
+// Compact on open once this much of the data file is garbage
+static const U32 MESH_GARBAGE_PERCENT = 25;
+
+struct LLMeshDataHeader
+{
+	U32 mMagic;
+	U32 mVersion;
+	U32 mGeneration;
+	U32 mReserved;
+};
+
+struct LLMeshIndexHeader
+{
+	U32 mMagic;
+	U32 mVersion;
+	U32 mGeneration;
+	U32 mCount;
+	U32 mDataEnd;
+	U32 mCRC;		// of the records
+};
+
+struct LLMeshIndexRecord
+{
+	U8 mMeshID[UUID_BYTES];
+	U32 mAccessTime;
+	U32 mParts[LLMeshCache::PART_COUNT][2];	// offset, size
+};
+static_assert(sizeof(LLMeshIndexRecord) == 20 + 8 * LLMeshCache::PART_COUNT, "LLMeshIndexRecord must stay packed");
+
+static const U32 DATA_HEADER_SIZE = sizeof(LLMeshDataHeader);
+
+LLMeshCache::LLMeshCache(const std::string& dirname, U64 max_size)
+	: mDirname(dirname),
+	  mMaxSize(llmin(max_size, (U64)U32_MAX / 2)),
+	  mOpen(false),
+	  mGeneration(0),
+	  mDataEnd(DATA_HEADER_SIZE),
+	  mLiveBytes(0),
+	  mIndexDirty(false),
+	  mAccessTimesDirty(false)
+{
+}
+
+LLMeshCache::~LLMeshCache()
+{
+	close();
+}
+
+std::string LLMeshCache::getDataFilename() const
+{
+	return gDirUtilp->add(mDirname, "mesh.data");
+}
+
+std::string LLMeshCache::getIndexFilename() const
+{
+	return gDirUtilp->add(mDirname, "mesh.index");
+}
+
+bool LLMeshCache::open()
+{
+	LLMutexLock lock(&mMutex);
+	if (mOpen)
+	{
+		return true;
+	}
+
+	LLFile::mkdir(mDirname);
+	if (!mData.open(getDataFilename(), true, DATA_HEADER_SIZE))
+	{
+		LL_WARNS("MeshCache") << "Unable to map " << getDataFilename() << ", meshes will not be cached" << LL_ENDL;
+		return false;
+	}
+
+	const LLMeshDataHeader* header = (const LLMeshDataHeader*)mData.getData();
+	if (header->mMagic != MESH_DATA_MAGIC || header->mVersion != MESH_CACHE_VERSION || !loadIndex())
+	{
+		mGeneration = header->mMagic == MESH_DATA_MAGIC ? header->mGeneration : 0;
+		clear();
+	}
+
+	U64 garbage = mDataEnd - DATA_HEADER_SIZE - mLiveBytes;
+	if (mLiveBytes > mMaxSize || garbage * 100 > (U64)mDataEnd * MESH_GARBAGE_PERCENT)
+	{
+		if (!compact())
+		{
+			clear();
+		}
+	}
+
+	mOpen = mData.isOpen();
+	LL_INFOS("MeshCache") << "Opened mesh cache with " << mEntries.size() << " meshes, "
+						  << mLiveBytes << " bytes in use of " << mDataEnd << LL_ENDL;
+	return mOpen;
+}
+
+void LLMeshCache::close()
+{
+	LLMutexLock lock(&mMutex);
+	if (mOpen && (mIndexDirty || mAccessTimesDirty))
+	{
+		// Whatever the index points at must be on disk before the index is,
+		// which it already is when only access times changed
+		if (mIndexDirty)
+		{
+			mData.flush(false);
+		}
+		writeIndex(getIndexFilename(), mEntries, mGeneration, mDataEnd);
+		mIndexDirty = false;
+		mAccessTimesDirty = false;
+	}
+	mData.close();
+	mEntries.clear();
+	mOpen = false;
+}
+
+// mMutex must be locked
+bool LLMeshCache::loadIndex()
+{
+	llifstream infile(getIndexFilename(), std::ios::in | std::ios::binary);
+	if (!infile.is_open())
+	{
+		return false;
+	}
+
+	const LLMeshDataHeader* data_header = (const LLMeshDataHeader*)mData.getData();
+	LLMeshIndexHeader header;
+	infile.read((char*)&header, sizeof(header));
+	if (infile.gcount() != sizeof(header)
+		|| header.mMagic != MESH_INDEX_MAGIC
+		|| header.mVersion != MESH_CACHE_VERSION
+		|| header.mGeneration != data_header->mGeneration
+		|| header.mDataEnd < DATA_HEADER_SIZE
+		|| header.mDataEnd > mData.getSize())
+	{
+		return false;
+	}
+
+	std::vector<LLMeshIndexRecord> records(header.mCount);
+	if (header.mCount)
+	{
+		S64 bytes = (S64)header.mCount * sizeof(LLMeshIndexRecord);
+		infile.read((char*)&records[0], bytes);
+		if (infile.gcount() != bytes)
+		{
+			return false;
+		}
+		LLCRC crc;
+		crc.update((const U8*)&records[0], bytes);
+		if (crc.getCRC() != header.mCRC)
+		{
+			return false;
+		}
+	}
+
+	mEntries.clear();
+	mLiveBytes = 0;
+	for (const LLMeshIndexRecord& record : records)
+	{
+		Entry entry;
+		entry.mAccessTime = record.mAccessTime;
+		for (U32 i = 0; i < PART_COUNT; ++i)
+		{
+			Extent& extent = entry.mParts[i];
+			extent.mOffset = record.mParts[i][0];
+			extent.mSize = record.mParts[i][1];
+			if (extent.mSize && (extent.mOffset < DATA_HEADER_SIZE || (U64)extent.mOffset + extent.mSize > header.mDataEnd))
+			{
+				mEntries.clear();
+				mLiveBytes = 0;
+				return false;
+			}
+			mLiveBytes += extent.mSize;
+		}
+		LLUUID mesh_id;
+		memcpy(mesh_id.mData, record.mMeshID, UUID_BYTES);
+		mEntries[mesh_id] = entry;
+	}
+	mGeneration = header.mGeneration;
+	mDataEnd = header.mDataEnd;
+	mIndexDirty = false;
+	mAccessTimesDirty = false;
+	return true;
+}
+
+// mMutex must be locked
+void LLMeshCache::clear()
+{
+	LLFile::remove(getIndexFilename(), ENOENT);
+	mEntries.clear();
+	mLiveBytes = 0;
+	mDataEnd = DATA_HEADER_SIZE;
+	mIndexDirty = true;
+	++mGeneration;
+
+	if (mData.isOpen())
+	{
+		LLMeshDataHeader* header = (LLMeshDataHeader*)mData.getData();
+		header->mMagic = MESH_DATA_MAGIC;
+		header->mVersion = MESH_CACHE_VERSION;
+		header->mGeneration = mGeneration;
+		header->mReserved = 0;
+	}
+}
+
+// mMutex must be locked
+bool LLMeshCache::compact()
+{
+	// Most recently used first
+	std::vector<std::pair<U32, const LLUUID*> > order;
+	order.reserve(mEntries.size());
+	for (entry_map_t::const_iterator iter = mEntries.begin(); iter != mEntries.end(); ++iter)
+	{
+		order.push_back(std::make_pair(iter->second.mAccessTime, &iter->first));
+	}
+	std::sort(order.begin(), order.end(),
+			  [](const std::pair<U32, const LLUUID*>& lhs, const std::pair<U32, const LLUUID*>& rhs)
+			  { return lhs.first > rhs.first; });
+
+	// Leave some room to grow when trimming
+	U64 budget = mLiveBytes > mMaxSize ? mMaxSize * 3 / 4 : mLiveBytes;
+	U64 kept_bytes = 0;
+	entry_map_t kept;
+	for (const auto& item : order)
+	{
+		const Entry& entry = mEntries[*item.second];
+		U64 size = 0;
+		for (U32 i = 0; i < PART_COUNT; ++i)
+		{
+			size += entry.mParts[i].mSize;
+		}
+		if (kept_bytes + size > budget)
+		{
+			continue;
+		}
+		kept_bytes += size;
+		kept[*item.second] = entry;
+	}
+
+	std::string temp_data = getDataFilename() + ".tmp";
+	U32 generation = mGeneration + 1;
+	U32 data_end = DATA_HEADER_SIZE;
+	{
+		LLMappedFile temp;
+		LLFile::remove(temp_data, ENOENT);
+		if (!temp.open(temp_data, true, DATA_HEADER_SIZE + kept_bytes))
+		{
+			return false;
+		}
+
+		LLMeshDataHeader* header = (LLMeshDataHeader*)temp.getData();
+		header->mMagic = MESH_DATA_MAGIC;
+		header->mVersion = MESH_CACHE_VERSION;
+		header->mGeneration = generation;
+		header->mReserved = 0;
+
+		for (entry_map_t::iterator iter = kept.begin(); iter != kept.end(); ++iter)
+		{
+			for (U32 i = 0; i < PART_COUNT; ++i)
+			{
+				Extent& extent = iter->second.mParts[i];
+				if (extent.mSize)
+				{
+					memcpy(temp.getData() + data_end, mData.getData() + extent.mOffset, extent.mSize);
+					extent.mOffset = data_end;
+					data_end += extent.mSize;
+				}
+			}
+		}
+		temp.flush(false);
+	}
+
+	LL_INFOS("MeshCache") << "Compacted mesh cache from " << mDataEnd << " to " << data_end << " bytes, kept "
+						  << kept.size() << " of " << mEntries.size() << " meshes" << LL_ENDL;
+
+	// The index goes first: should we stop in between, its generation no
+	// longer matches the old data file and the cache simply starts over.
+	std::string data_filename = getDataFilename();
+	mData.close();
+	if (!writeIndex(getIndexFilename(), kept, generation, data_end))
+	{
+		LLFile::remove(temp_data, ENOENT);
+		mData.open(data_filename, true, DATA_HEADER_SIZE);
+		return false;
+	}
+	LLFile::remove(data_filename, ENOENT);
+	if (LLFile::rename(temp_data, data_filename) != 0 || !mData.open(data_filename, true, DATA_HEADER_SIZE))
+	{
+		mData.open(data_filename, true, DATA_HEADER_SIZE);
+		return false;
+	}
+
+	mEntries.swap(kept);
+	mGeneration = generation;
+	mDataEnd = data_end;
+	mLiveBytes = kept_bytes;
+	mIndexDirty = false;
+	mAccessTimesDirty = false;
+	return true;
+}
+
+bool LLMeshCache::writeIndex(const std::string& filename, const entry_map_t& entries, U32 generation, U32 data_end)
+{
+	std::vector<LLMeshIndexRecord> records;
+	records.reserve(entries.size());
+	for (entry_map_t::const_iterator iter = entries.begin(); iter != entries.end(); ++iter)
+	{
+		LLMeshIndexRecord record;
+		memcpy(record.mMeshID, iter->first.mData, UUID_BYTES);
+		record.mAccessTime = iter->second.mAccessTime;
+		for (U32 i = 0; i < PART_COUNT; ++i)
+		{
+			record.mParts[i][0] = iter->second.mParts[i].mOffset;
+			record.mParts[i][1] = iter->second.mParts[i].mSize;
+		}
+		records.push_back(record);
+	}
+
+	LLMeshIndexHeader header;
+	header.mMagic = MESH_INDEX_MAGIC;
+	header.mVersion = MESH_CACHE_VERSION;
+	header.mGeneration = generation;
+	header.mCount = records.size();
+	header.mDataEnd = data_end;
+	LLCRC crc;
+	if (!records.empty())
+	{
+		crc.update((const U8*)&records[0], records.size() * sizeof(LLMeshIndexRecord));
+	}
+	header.mCRC = crc.getCRC();
+
+	std::string temp_filename = filename + ".tmp";
+	bool success;
+	{
+		llofstream outfile(temp_filename, std::ios::out | std::ios::binary | std::ios::trunc);
+		outfile.write((const char*)&header, sizeof(header));
+		if (!records.empty())
+		{
+			outfile.write((const char*)&records[0], records.size() * sizeof(LLMeshIndexRecord));
+		}
+		success = outfile.good();
+	}
+
+	LLFile::remove(filename, ENOENT);
+	if (!success || LLFile::rename(temp_filename, filename) != 0)
+	{
+		LL_WARNS("MeshCache") << "Unable to write mesh cache index " << filename << LL_ENDL;
+		LLFile::remove(temp_filename, ENOENT);
+		return false;
+	}
+	return true;
+}
+
+void LLMeshCache::saveIndex()
+{
+	LLMutexLock lock(&mMutex);
+	if (!mOpen || !mIndexDirty)
+	{
+		return;
+	}
+
+	// Whatever the index points at must be on disk before the index is
+	mData.flush(false);
+	if (writeIndex(getIndexFilename(), mEntries, mGeneration, mDataEnd))
+	{
+		mIndexDirty = false;
+		mAccessTimesDirty = false;
+	}
+}
+
+S32 LLMeshCache::getSize(const LLUUID& mesh_id, EPart part)
+{
+	LLMutexLock lock(&mMutex);
+	entry_map_t::const_iterator iter = mEntries.find(mesh_id);
+	if (iter == mEntries.end() || !iter->second.mParts[part].mSize)
+	{
+		return -1;
+	}
+	return iter->second.mParts[part].mSize;
+}
+
+bool LLMeshCache::read(const LLUUID& mesh_id, EPart part, std::vector<U8>& data)
+{
+	LLMutexLock lock(&mMutex);
+	entry_map_t::iterator iter = mEntries.find(mesh_id);
+	if (!mOpen || iter == mEntries.end() || !iter->second.mParts[part].mSize)
+	{
+		return false;
+	}
+
+	const Extent& extent = iter->second.mParts[part];
+	data.assign(mData.getData() + extent.mOffset, mData.getData() + extent.mOffset + extent.mSize);
+	iter->second.mAccessTime = (U32)time(nullptr);
+	mAccessTimesDirty = true;
+	return true;
+}
+
+bool LLMeshCache::write(const LLUUID& mesh_id, EPart part, const U8* data, S32 size)
+{
+	if (!data || size <= 0)
+	{
+		return false;
+	}
+
+	LLMutexLock lock(&mMutex);
+	if (!mOpen)
+	{
+		return false;
+	}
+
+	U64 limit = mMaxSize + mMaxSize * MESH_DATA_SLACK_PERCENT / 100;
+	U64 end = (U64)mDataEnd + size;
+	if (end > limit)
+	{
+		// Squeeze out garbage and the least recently used meshes right away.
+		// This stalls other users of the cache for one copy of the live data,
+		// but the slack means it only happens every MESH_DATA_SLACK_PERCENT
+		// of the limit worth of writes.
+		if (!compact())
+		{
+			clear();
+		}
+		if (!mData.isOpen())
+		{
+			LL_WARNS("MeshCache") << "Lost " << getDataFilename() << " while compacting, meshes will not be cached" << LL_ENDL;
+			mOpen = false;
+			return false;
+		}
+		end = (U64)mDataEnd + size;
+		if (end > limit)
+		{
+			return false;
+		}
+	}
+	if (end > (U64)mData.getSize())
+	{
+		U64 new_size = llmin(llmax(end, (U64)mData.getSize() + MESH_DATA_GROWTH), limit);
+		if (!mData.resize(new_size))
+		{
+			LL_WARNS("MeshCache") << "Unable to grow " << getDataFilename() << ", meshes will not be cached" << LL_ENDL;
+			mOpen = false;
+			return false;
+		}
+	}
+
+	memcpy(mData.getData() + mDataEnd, data, size);
+
+	Entry& entry = mEntries[mesh_id];	// zero filled when new
+	Extent& extent = entry.mParts[part];
+	mLiveBytes -= extent.mSize;
+	extent.mOffset = mDataEnd;
+	extent.mSize = size;
+	mLiveBytes += size;
+	entry.mAccessTime = (U32)time(nullptr);
+
+	mDataEnd += size;
+	mIndexDirty = true;
+	return true;
+}
+
+void LLMeshCache::removePart(const LLUUID& mesh_id, EPart part)
+{
+	LLMutexLock lock(&mMutex);
+	entry_map_t::iterator iter = mEntries.find(mesh_id);
+	if (iter == mEntries.end())
+	{
+		return;
+	}
+
+	Extent& extent = iter->second.mParts[part];
+	mLiveBytes -= extent.mSize;
+	extent.mSize = 0;
+	extent.mOffset = 0;
+	mIndexDirty = true;
+}
@@ -0,0 +1,124 @@
+/**
+ * @file llmeshcache.h
+ * @brief On-disk cache of mesh asset parts.
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMESHCACHE_H
+#define LL_LLMESHCACHE_H
+
+#include <map>
+#include <vector>
+
+#include "llmappedfile.h"
+#include "llmutex.h"
+#include "lluuid.h"
+
+// Stores the parts of mesh assets (header, each LOD, skin, physics) as
+// separate extents of one mapped data file, so a LOD is read back with a
+// single copy instead of a VFS lookup, seek and read of the whole blob.
+//
+// Extents are only ever appended to the data file; replacing or removing
+// a part just leaves garbage behind.  The index of extents is kept in
+// memory and saved to its own file, and garbage as well as the least
+// recently used meshes beyond the size limit are squeezed out when the
+// cache is opened, or when an append would take the data file too far
+// past the limit.
+//
+// Every method is safe to call from any thread.
+class LLMeshCache
+{
+public:
+	enum EPart
+	{
+		PART_HEADER = 0,
+		PART_LOD_LOWEST,
+		PART_LOD_LOW,
+		PART_LOD_MEDIUM,
+		PART_LOD_HIGH,
+		PART_SKIN,
+		PART_PHYSICS_CONVEX,
+		PART_PHYSICS_MESH,
+		PART_COUNT
+	};
+
+	// LOD 0-3 to its part
+	static EPart lodPart(S32 lod)		{ return (EPart)(PART_LOD_LOWEST + lod); }
+
+	LLMeshCache(const std::string& dirname, U64 max_size);
+	~LLMeshCache();
+
+	bool open();
+	void close();
+	bool isOpen() const					{ return mOpen; }
+
+	// Size of a cached part, -1 if it isn't cached
+	S32 getSize(const LLUUID& mesh_id, EPart part);
+	// Copies a whole part into data, false if it isn't cached
+	bool read(const LLUUID& mesh_id, EPart part, std::vector<U8>& data);
+	bool write(const LLUUID& mesh_id, EPart part, const U8* data, S32 size);
+	void removePart(const LLUUID& mesh_id, EPart part);
+
+	// Writes the index out if parts were added or removed since it was last
+	// saved.  Access times from reads alone wait for the next save or close().
+	void saveIndex();
+
+private:
+	struct Extent
+	{
+		U32 mOffset;
+		U32 mSize;		// 0 when the part isn't cached
+	};
+
+	struct Entry
+	{
+		U32 mAccessTime;
+		Extent mParts[PART_COUNT];
+	};
+	typedef std::map<LLUUID, Entry> entry_map_t;
+
+	std::string getDataFilename() const;
+	std::string getIndexFilename() const;
+
+	bool loadIndex();
+	// Drops least recently used meshes and rewrites the data file without garbage
+	bool compact();
+	bool writeIndex(const std::string& filename, const entry_map_t& entries, U32 generation, U32 data_end);
+	void clear();
+
+private:
+	std::string		mDirname;
+	U64				mMaxSize;
+	bool			mOpen;
+
+	LLMutex			mMutex;
+	LLMappedFile	mData;
+	U32				mGeneration;	// ties the index to the data file it describes
+	U32				mDataEnd;		// next append offset
+	U64				mLiveBytes;
+	entry_map_t		mEntries;
+	bool			mIndexDirty;		// parts added, removed or moved
+	bool			mAccessTimesDirty;	// only access times changed
+};
+
+#endif // LL_LLMESHCACHE_H
@@ -47,7 +47,6 @@
 #include "llsdutil_math.h"
 #include "llsdserialize.h"
 #include "llthread.h"
-#include "llvfile.h"
 #include "llviewercontrol.h"
 #include "llviewerinventory.h"
 #include "llviewermenufile.h"
@@ -108,6 +107,7 @@
 //   main     Main rendering thread, very sensitive to locking and other stalls
 //   repo     Overseeing worker thread associated with the LLMeshRepoThread class
 //   decom    Worker thread for mesh decomposition requests
+//   decodeN  1-N threads inflating and unpacking LOD and skin info payloads
 //   core     HTTP worker thread:  does the work but doesn't intrude here
 //   uploadN  0-N temporary mesh upload threads (0-1 in practice)
 //
@@ -147,9 +147,13 @@
 //                             ...
 //                             onCompleted() invoked for GET
 //                               data copied
-//                               lodReceived() invoked
-//                                 unpack data into LLVolume
-//                                 append LoadedMesh to mLoadedQ
+//                               queueDecode() invoked
+//                             ...
+//                                                 decode thread
+//                                                   lodReceived() invoked
+//                                                     unpack data into LLVolume
+//                                                     append LoadedMesh to mLoadedQ
+//                                                   data written to VFS
 //                             ...
 //         notifyLoadedMeshes() invoked again
 //           scan mLoadedQ
@@ -167,6 +171,7 @@
 //   LLPhysicsDecomp::mSignal (LLCondition)
 //   LLPhysicsDecomp::mMutex
 //   LLMeshUploadThread::mMutex
+//   LLMeshCache::mMutex (leaf, never held while taking another)
 //
 // Mutex Order Rules
 //
@@ -219,7 +224,7 @@
 //     sHTTPErrorCount                 "
 //     sLODPending                     mMeshMutex [4]  rw.main.mMeshMutex
 //     sLODProcessing                  Repo::mMutex    rw.any.Repo::mMutex
-//     sCacheBytesRead                 none            rw.repo.none, ro.main.none [1]
+//     sCacheBytesRead                 none            rw.any.none, ro.main.none (atomic)
 //     sCacheBytesWritten              "
 //     sCacheReads                     "
 //     sCacheWrites                    "
@@ -238,6 +243,7 @@
 //     mInventoryQ                     mMeshMutex [4]  rw.main.mMeshMutex, ro.main.none [5]
 //     mUploadErrorQ                   mMeshMutex      rw.main.mMeshMutex, rw.any.mMeshMutex
 //     mGetMeshVersion                 none            rw.main.none
+//     mCache                          none            wo.main.none, ro.any.none [4] (set before meshes load, cleared after threads exit)
 //
 //   LLMeshRepoThread:
 //
@@ -256,6 +262,10 @@
 //     mUnavailableQ            mMutex        rw.repo.none [0], ro.main.none [5], rw.main.mMutex
 //     mLoadedQ                 mMutex        rw.repo.mMutex, ro.main.none [5], rw.main.mMutex
 //     mPendingLOD              mMutex        rw.repo.mMutex, rw.any.mMutex
+//     mLODRefetchQ             mMutex        rw.repo.mMutex, rw.decode.mMutex, ro.repo.none [3]
+//     mSkinRefetchRequests     mMutex        rw.repo.mMutex, rw.decode.mMutex, ro.repo.none [3]
+//     mDecodeQ                 mDecodeMutex  rw.repo.mDecodeMutex, rw.decode.mDecodeMutex
+//     mDecodeStats             none          rw.decode.none, ro.main.none [1]
 //     mGetMeshCapability       mMutex        rw.main.mMutex, ro.repo.mMutex (was:  [0])
 //     mGetMesh2Capability      mMutex        rw.main.mMutex, ro.repo.mMutex (was:  [0])
 //     mGetMeshVersion          mMutex        rw.main.mMutex, ro.repo.mMutex
@@ -355,6 +365,7 @@ const S32 REQUEST2_LOW_WATER_MAX = 50;
 const U32 LARGE_MESH_FETCH_THRESHOLD = 1U << 21;		// Size at which requests goes to narrow/slow queue
 const long SMALL_MESH_XFER_TIMEOUT = 120L;				// Seconds to complete xfer, small mesh downloads
 const long LARGE_MESH_XFER_TIMEOUT = 600L;				// Seconds to complete xfer, large downloads
+const F32 MESH_CACHE_SAVE_INTERVAL = 300.f;				// Seconds between mesh cache index checkpoints
 
 // Would normally like to retry on uploads as some
 // retryable failures would be recoverable.  Unfortunately,
@@ -383,10 +394,10 @@ U32 LLMeshRepository::sHTTPErrorCount = 0;
 U32 LLMeshRepository::sLODProcessing = 0;
 U32 LLMeshRepository::sLODPending = 0;
 
-U32 LLMeshRepository::sCacheBytesRead = 0;
-U32 LLMeshRepository::sCacheBytesWritten = 0;
-U32 LLMeshRepository::sCacheReads = 0;
-U32 LLMeshRepository::sCacheWrites = 0;
+LLAtomicU32 LLMeshRepository::sCacheBytesRead(0);
+LLAtomicU32 LLMeshRepository::sCacheBytesWritten(0);
+LLAtomicU32 LLMeshRepository::sCacheReads(0);
+LLAtomicU32 LLMeshRepository::sCacheWrites(0);
 U32 LLMeshRepository::sMaxLockHoldoffs = 0;
 
 LLDeadmanTimer LLMeshRepository::sQuiescentTimer(15.0, false);	// true -> gather cpu metrics
@@ -809,7 +820,8 @@ LLMeshRepoThread::LLMeshRepoThread()
   mHttpLegacyPolicyClass(LLCore::HttpRequest::DEFAULT_POLICY_ID),
   mHttpLargePolicyClass(LLCore::HttpRequest::DEFAULT_POLICY_ID),
   mHttpPriority(0),
-  mLegacyGetMeshVersion(0)
+  mLegacyGetMeshVersion(0),
+  mDecodePending(0)
 { 
 	LLAppCoreHttp & app_core_http(LLAppViewer::instance()->getAppCoreHttp());
 
@@ -828,6 +840,17 @@ LLMeshRepoThread::LLMeshRepoThread()
 	mHttpPolicyClass = app_core_http.getPolicy(LLAppCoreHttp::AP_MESH2);
 	mHttpLegacyPolicyClass = app_core_http.getPolicy(LLAppCoreHttp::AP_MESH1);
 	mHttpLargePolicyClass = app_core_http.getPolicy(LLAppCoreHttp::AP_LARGE_MESH);
+
+	U32 decode_threads = gSavedSettings.getU32("MeshDecodeThreads");
+	if (!decode_threads)
+	{
+		decode_threads = llclamp((S32)boost::thread::hardware_concurrency() / 2, 1, 4);
+	}
+	for (U32 i = 0; i < decode_threads; ++i)
+	{
+		mDecodeThreads.emplace_back(new DecodeThread(this, i));
+		mDecodeThreads.back()->start();
+	}
 }
 
 
@@ -837,6 +860,18 @@ LLMeshRepoThread::~LLMeshRepoThread()
 					   << ", Large GETs issued:  " << LLMeshRepository::sHTTPLargeRequestCount
 					   << ", Max Lock Holdoffs:  " << LLMeshRepository::sMaxLockHoldoffs
 					   << LL_ENDL;
+	LL_INFOS(LOG_MESH) << "Decode stats:  " << getDecodeStatsLLSD() << LL_ENDL;
+
+	for (auto& thread : mDecodeThreads)
+	{
+		thread->shutdown();
+	}
+	mDecodeThreads.clear();
+	for (DecodeRequest* request : mDecodeQ)
+	{
+		delete request;
+	}
+	mDecodeQ.clear();
 
 	mHttpRequestSet.clear();
     mHttpHeaders.reset();
@@ -892,8 +927,31 @@ void LLMeshRepoThread::run()
 			}
 		sRequestWaterLevel = mHttpRequestSet.size();			// Stats data update
 
+		// Checkpoint the mesh cache index so a crash loses little
+		if (gMeshRepo.mCache && mCacheSaveTimer.getElapsedTimeF32() > MESH_CACHE_SAVE_INTERVAL)
+		{
+			gMeshRepo.mCache->saveIndex();
+			mCacheSaveTimer.reset();
+		}
+
 		// NOTE: order of queue processing intentionally favors LOD requests over header requests
 
+		while (!mLODRefetchQ.empty() && mHttpRequestSet.size() < sRequestHighWater)
+		{
+			mMutex->lock();
+			LODRequest req = mLODRefetchQ.front();
+			mLODRefetchQ.pop_front();
+			mMutex->unlock();
+
+			if (!fetchMeshLOD(req.mMeshParams, req.mLOD, false))	// failed, try again next time around
+			{
+				mMutex->lock();
+				mLODRefetchQ.push_back(req);
+				mMutex->unlock();
+				break;
+			}
+		}
+
 		while (!mLODReqQ.empty() && mHttpRequestSet.size() < sRequestHighWater)
 		{
 			if (! mMutex)
@@ -942,6 +1000,7 @@ void LLMeshRepoThread::run()
 
 		if (mHttpRequestSet.size() < sRequestHighWater
 			&& (! mSkinRequests.empty()
+				|| ! mSkinRefetchRequests.empty()
 				|| ! mDecompositionRequests.empty()
 				|| ! mPhysicsShapeRequests.empty()))
 		{
@@ -975,6 +1034,32 @@ void LLMeshRepoThread::run()
 				}
 			}
 
+			// holding lock, skin info that didn't decode from the cache
+			if (! mSkinRefetchRequests.empty() && mHttpRequestSet.size() < sRequestHighWater)
+			{
+				std::set<LLUUID> incomplete;
+				std::set<LLUUID>::iterator iter(mSkinRefetchRequests.begin());
+				while (iter != mSkinRefetchRequests.end() && mHttpRequestSet.size() < sRequestHighWater)
+				{
+					LLUUID mesh_id = *iter;
+					mSkinRefetchRequests.erase(iter);
+					mMutex->unlock();
+
+					if (!fetchMeshSkinInfo(mesh_id, false))
+					{
+						incomplete.insert(mesh_id);
+					}
+
+					mMutex->lock();
+					iter = mSkinRefetchRequests.begin();
+				}
+
+				if (! incomplete.empty())
+				{
+					mSkinRefetchRequests.insert(incomplete.begin(), incomplete.end());
+				}
+			}
+
 			// holding lock, try next list
 			// *TODO:  For UI/debug-oriented lists, we might drop the fine-
 			// grained locking as there's a lowered expectation of smoothness
@@ -1049,6 +1134,227 @@ void LLMeshRepoThread::run()
 	}
 }
 
+LLMeshRepoThread::DecodeRequest::DecodeRequest(EType type, const LLVolumeParams& mesh_params, S32 lod,
+											   const U8* data, S32 data_size, bool from_cache)
+	: mType(type),
+	  mMeshParams(mesh_params),
+	  mMeshID(mesh_params.getSculptID()),
+	  mLOD(lod),
+	  mFromCache(from_cache),
+	  mQueuedTime(LLTimer::getTotalTime())
+{
+	if (data && data_size > 0)
+	{
+		mData.assign(data, data + data_size);
+	}
+}
+
+LLMeshRepoThread::DecodeStats::DecodeStats()
+	: mCount(0),
+	  mFailures(0),
+	  mQueueTime(0),
+	  mDecodeTime(0),
+	  mMaxDecodeTime(0)
+{
+}
+
+LLMeshRepoThread::DecodeThread::DecodeThread(LLMeshRepoThread* repo, U32 index)
+	: LLThread(llformat("mesh decode %u", index)),
+	  mRepo(repo)
+{
+}
+
+// virtual
+bool LLMeshRepoThread::DecodeThread::runCondition()
+{
+	// mDataLock must be locked here
+	return mRepo->mDecodePending > 0;
+}
+
+// virtual
+void LLMeshRepoThread::DecodeThread::run()
+{
+	while (true)
+	{
+		checkPause();
+
+		if (isQuitting())
+		{
+			break;
+		}
+
+		mRepo->processDecodes();
+	}
+}
+
+// Threads:  repo
+void LLMeshRepoThread::queueDecode(DecodeRequest* request)
+{
+	if (mDecodeThreads.empty())
+	{
+		decode(*request);
+		delete request;
+		return;
+	}
+
+	{
+		LLMutexLock lock(&mDecodeMutex);
+		mDecodeQ.push_back(request);
+		++mDecodePending;
+	}
+
+	for (auto& thread : mDecodeThreads)
+	{
+		thread->wake();
+	}
+}
+
+// Threads:  decode
+void LLMeshRepoThread::processDecodes()
+{
+	while (true)
+	{
+		DecodeRequest* request = nullptr;
+		{
+			LLMutexLock lock(&mDecodeMutex);
+			if (mDecodeQ.empty())
+			{
+				break;
+			}
+			request = mDecodeQ.front();
+			mDecodeQ.pop_front();
+			--mDecodePending;
+		}
+
+		decode(*request);
+		delete request;
+	}
+}
+
+// Threads:  any
+bool LLMeshRepoThread::readCachedPart(const LLUUID& mesh_id, LLMeshCache::EPart part, S32 size, std::vector<U8>& data)
+{
+	LLMeshCache* cache = gMeshRepo.mCache;
+	if (!cache || !cache->read(mesh_id, part, data))
+	{
+		return false;
+	}
+	if ((S32)data.size() != size)
+	{
+		// Stale part for a header that changed its mind, let the sim win
+		cache->removePart(mesh_id, part);
+		return false;
+	}
+	LLMeshRepository::sCacheBytesRead += size;
+	++LLMeshRepository::sCacheReads;
+	return true;
+}
+
+// Threads:  any
+void LLMeshRepoThread::writeCachedPart(const LLUUID& mesh_id, LLMeshCache::EPart part, const U8* data, S32 size)
+{
+	LLMeshCache* cache = gMeshRepo.mCache;
+	if (cache && cache->write(mesh_id, part, data, size))
+	{
+		LLMeshRepository::sCacheBytesWritten += size;
+		++LLMeshRepository::sCacheWrites;
+	}
+}
+
+// Threads:  decode, or repo without decode threads
+void LLMeshRepoThread::decode(DecodeRequest& request)
+{
+	U64 start = LLTimer::getTotalTime();
+	const U8* data = request.mData.empty() ? nullptr : &request.mData[0];
+	S32 data_size = request.mData.size();
+
+	bool success;
+	if (request.mType == DecodeRequest::LOD)
+	{
+		success = lodReceived(request.mMeshParams, request.mLOD, (U8*)data, data_size);
+	}
+	else
+	{
+		success = skinInfoReceived(request.mMeshID, (U8*)data, data_size);
+	}
+
+	U64 end = LLTimer::getTotalTime();
+	DecodeStats& stats = mDecodeStats[request.mType == DecodeRequest::LOD ? llclamp(request.mLOD, 0, (S32)DECODE_STATS_SKIN - 1) : DECODE_STATS_SKIN];
+	++stats.mCount;
+	stats.mQueueTime += start - request.mQueuedTime;
+	stats.mDecodeTime += end - start;
+	U64 max_time = stats.mMaxDecodeTime;
+	while (end - start > max_time && !stats.mMaxDecodeTime.compare_exchange_weak(max_time, end - start))
+	{
+		// max_time now holds what another decode thread stored, retry against it
+	}
+
+	LLMeshCache::EPart part = request.mType == DecodeRequest::LOD ? LLMeshCache::lodPart(request.mLOD) : LLMeshCache::PART_SKIN;
+	if (success)
+	{
+		if (!request.mFromCache)
+		{
+			//good fetch from sim, cache it
+			writeCachedPart(request.mMeshID, part, data, data_size);
+		}
+		return;
+	}
+
+	++stats.mFailures;
+	if (request.mFromCache)
+	{
+		// Bad cache data, fetch from sim
+		if (gMeshRepo.mCache)
+		{
+			gMeshRepo.mCache->removePart(request.mMeshID, part);
+		}
+		LLMutexLock lock(mMutex);
+		if (request.mType == DecodeRequest::LOD)
+		{
+			mLODRefetchQ.push_back(LODRequest(request.mMeshParams, request.mLOD));
+		}
+		else
+		{
+			mSkinRefetchRequests.insert(request.mMeshID);
+		}
+	}
+	else if (request.mType == DecodeRequest::LOD)
+	{
+		LL_WARNS(LOG_MESH) << "Error during mesh LOD processing.  ID:  " << request.mMeshID
+						   << ", Unknown reason.  Not retrying."
+						   << LL_ENDL;
+		LLMutexLock lock(mMutex);
+		mUnavailableQ.push(LODRequest(request.mMeshParams, request.mLOD));
+	}
+	else
+	{
+		LL_WARNS(LOG_MESH) << "Error during mesh skin info processing.  ID:  " << request.mMeshID
+						   << ", Unknown reason.  Not retrying."
+						   << LL_ENDL;
+		// *TODO:  Mark mesh unavailable on error
+	}
+}
+
+// Threads:  any
+LLSD LLMeshRepoThread::getDecodeStatsLLSD() const
+{
+	LLSD stats;
+	for (U32 i = 0; i < DECODE_STATS_COUNT; ++i)
+	{
+		const DecodeStats& slot = mDecodeStats[i];
+		U32 count = slot.mCount;
+		LLSD entry;
+		entry["count"] = LLSD::Integer(count);
+		entry["failures"] = LLSD::Integer(slot.mFailures);
+		entry["avg_queue_ms"] = count ? (F64)slot.mQueueTime / count / 1000.0 : 0.0;
+		entry["avg_decode_ms"] = count ? (F64)slot.mDecodeTime / count / 1000.0 : 0.0;
+		entry["max_decode_ms"] = (F64)slot.mMaxDecodeTime / 1000.0;
+		stats[i == DECODE_STATS_SKIN ? std::string("skin") : header_lod[i]] = entry;
+	}
+	stats["threads"] = LLSD::Integer(mDecodeThreads.size());
+	return stats;
+}
+
 // Mutex:  LLMeshRepoThread::mMutex must be held on entry
 void LLMeshRepoThread::loadMeshSkinInfo(const LLUUID& mesh_id)
 {
@@ -1220,7 +1526,7 @@ LLCore::HttpHandle LLMeshRepoThread::getByteRange(const std::string & url, int l
 }
 
 
-bool LLMeshRepoThread::fetchMeshSkinInfo(const LLUUID& mesh_id)
+bool LLMeshRepoThread::fetchMeshSkinInfo(const LLUUID& mesh_id, bool can_use_cache)
 {
 
 	if (!mHeaderMutex)
@@ -1252,36 +1558,18 @@ bool LLMeshRepoThread::fetchMeshSkinInfo(const LLUUID& mesh_id)
 
 		if (version <= MAX_MESH_VERSION && offset >= 0 && size > 0)
 		{
-			//check VFS for mesh skin info
-			LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH);
-			if (file.getSize() >= offset+size)
-			{
-				LLMeshRepository::sCacheBytesRead += size;
-				++LLMeshRepository::sCacheReads;
-				file.seek(offset);
-				U8* buffer = new U8[size];
-				file.read(buffer, size);
-
-				//make sure buffer isn't all 0's by checking the first 1KB (reserved block but not written)
-				bool zero = true;
-				for (S32 i = 0; i < llmin(size, 1024) && zero; ++i)
-				{
-					zero = buffer[i] > 0 ? false : true;
-				}
-
-				if (!zero)
-				{	//attempt to parse
-					if (skinInfoReceived(mesh_id, buffer, size))
-					{
-						delete[] buffer;
-						return true;
-					}
-				}
-
-				delete[] buffer;
+			//check cache for mesh skin info
+			LLVolumeParams mesh_params;
+			mesh_params.setSculptID(mesh_id, LL_SCULPT_TYPE_MESH);
+			DecodeRequest* request = new DecodeRequest(DecodeRequest::SKIN, mesh_params, 0, nullptr, 0, true);
+			if (can_use_cache && readCachedPart(mesh_id, LLMeshCache::PART_SKIN, size, request->mData))
+			{	//attempt to parse, falls back to the sim if that fails
+				queueDecode(request);
+				return true;
 			}
+			delete request;
 
-			//reading from VFS failed for whatever reason, fetch from sim
+			//reading from cache failed for whatever reason, fetch from sim
 			std::string http_url;
 			int legacy_cap_version(0);
 			constructUrl(mesh_id, &http_url, &legacy_cap_version);
@@ -1346,37 +1634,18 @@ bool LLMeshRepoThread::fetchMeshDecomposition(const LLUUID& mesh_id)
 
 		if (version <= MAX_MESH_VERSION && offset >= 0 && size > 0)
 		{
-			//check VFS for mesh skin info
-			LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH);
-			if (file.getSize() >= offset+size)
-			{
-				LLMeshRepository::sCacheBytesRead += size;
-				++LLMeshRepository::sCacheReads;
-
-				file.seek(offset);
-				U8* buffer = new U8[size];
-				file.read(buffer, size);
-
-				//make sure buffer isn't all 0's by checking the first 1KB (reserved block but not written)
-				bool zero = true;
-				for (S32 i = 0; i < llmin(size, 1024) && zero; ++i)
+			//check cache for mesh decomposition
+			std::vector<U8> buffer;
+			if (readCachedPart(mesh_id, LLMeshCache::PART_PHYSICS_CONVEX, size, buffer))
+			{ //attempt to parse
+				if (decompositionReceived(mesh_id, &buffer[0], size))
 				{
-					zero = buffer[i] > 0 ? false : true;
+					return true;
 				}
-
-				if (!zero)
-				{ //attempt to parse
-					if (decompositionReceived(mesh_id, buffer, size))
-					{
-						delete[] buffer;
-						return true;
-					}
-				}
-
-				delete[] buffer;
+				gMeshRepo.mCache->removePart(mesh_id, LLMeshCache::PART_PHYSICS_CONVEX);
 			}
 
-			//reading from VFS failed for whatever reason, fetch from sim
+			//reading from cache failed for whatever reason, fetch from sim
 			std::string http_url;
 			int legacy_cap_version(0);
 			constructUrl(mesh_id, &http_url, &legacy_cap_version);
@@ -1441,36 +1710,18 @@ bool LLMeshRepoThread::fetchMeshPhysicsShape(const LLUUID& mesh_id)
 
 		if (version <= MAX_MESH_VERSION && offset >= 0 && size > 0)
 		{
-			//check VFS for mesh physics shape info
-			LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH);
-			if (file.getSize() >= offset+size)
-			{
-				LLMeshRepository::sCacheBytesRead += size;
-				++LLMeshRepository::sCacheReads;
-				file.seek(offset);
-				U8* buffer = new U8[size];
-				file.read(buffer, size);
-
-				//make sure buffer isn't all 0's by checking the first 1KB (reserved block but not written)
-				bool zero = true;
-				for (S32 i = 0; i < llmin(size, 1024) && zero; ++i)
+			//check cache for mesh physics shape info
+			std::vector<U8> buffer;
+			if (readCachedPart(mesh_id, LLMeshCache::PART_PHYSICS_MESH, size, buffer))
+			{ //attempt to parse
+				if (physicsShapeReceived(mesh_id, &buffer[0], size))
 				{
-					zero = buffer[i] > 0 ? false : true;
-				}
-
-				if (!zero)
-				{ //attempt to parse
-					if (physicsShapeReceived(mesh_id, buffer, size))
-					{
-						delete[] buffer;
-						return true;
-					}
+					return true;
 				}
-
-				delete[] buffer;
+				gMeshRepo.mCache->removePart(mesh_id, LLMeshCache::PART_PHYSICS_MESH);
 			}
 
-			//reading from VFS failed for whatever reason, fetch from sim
+			//reading from cache failed for whatever reason, fetch from sim
 			std::string http_url;
 			int legacy_cap_version(0);
 			constructUrl(mesh_id, &http_url, &legacy_cap_version);
@@ -1542,24 +1793,20 @@ bool LLMeshRepoThread::fetchMeshHeader(const LLVolumeParams& mesh_params)
 	++LLMeshRepository::sMeshRequestCount;
 
 	{
-		//look for mesh in asset in vfs
-		LLVFile file(gVFS, mesh_params.getSculptID(), LLAssetType::AT_MESH);
-			
-		S32 size = file.getSize();
-
-		if (size > 0)
+		//look for mesh header in cache
+		const LLUUID& mesh_id = mesh_params.getSculptID();
+		LLMeshCache* cache = gMeshRepo.mCache;
+		std::vector<U8> buffer;
+		if (cache && cache->read(mesh_id, LLMeshCache::PART_HEADER, buffer))
 		{
-			// *NOTE:  if the header size is ever more than 4KB, this will break
-			U8 buffer[MESH_HEADER_SIZE];
-			S32 bytes = llmin(size, MESH_HEADER_SIZE);
-			LLMeshRepository::sCacheBytesRead += bytes;	
+			LLMeshRepository::sCacheBytesRead += buffer.size();
 			++LLMeshRepository::sCacheReads;
-			file.read(buffer, bytes);
-			if (headerReceived(mesh_params, buffer, bytes))
+			if (headerReceived(mesh_params, &buffer[0], buffer.size()))
 			{
-				// Found mesh in VFS cache
+				// Found mesh in cache
 				return true;
 			}
+			cache->removePart(mesh_id, LLMeshCache::PART_HEADER);
 		}
 	}
 
@@ -1596,7 +1843,7 @@ bool LLMeshRepoThread::fetchMeshHeader(const LLVolumeParams& mesh_params)
 }
 
 //return false if failed to get mesh lod.
-bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
+bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod, bool can_use_cache)
 { 
 	if (!mHeaderMutex)
 	{
@@ -1624,41 +1871,31 @@ bool LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
 		if (version <= MAX_MESH_VERSION && offset >= 0 && size > 0)
 		{
 
-			//check VFS for mesh asset
-			LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH);
-			if (file.getSize() >= offset+size)
+			//check cache for mesh LOD
+			if (can_use_cache)
 			{
-				LLMeshRepository::sCacheBytesRead += size;
-				++LLMeshRepository::sCacheReads;
-				file.seek(offset);
-				U8* buffer = new(std::nothrow) U8[size];
-				if (!buffer)
+				DecodeRequest* request = new DecodeRequest(DecodeRequest::LOD, mesh_params, lod, nullptr, 0, true);
+				bool cached;
+				try
 				{
-					LL_WARNS(LOG_MESH) << "Can't allocate memory for mesh LOD" << LL_ENDL;
-					return false;
+					cached = readCachedPart(mesh_id, LLMeshCache::lodPart(lod), size, request->mData);
 				}
-				file.read(buffer, size);
-
-				//make sure buffer isn't all 0's by checking the first 1KB (reserved block but not written)
-				bool zero = true;
-				for (S32 i = 0; i < llmin(size, 1024) && zero; ++i)
+				catch (const std::bad_alloc&)
 				{
-					zero = buffer[i] > 0 ? false : true;
+					delete request;
+					LL_WARNS(LOG_MESH) << "Can't allocate memory for mesh LOD" << LL_ENDL;
+					return false;
 				}
 
-				if (!zero)
-				{ //attempt to parse
-					if (lodReceived(mesh_params, lod, buffer, size))
-					{
-						delete[] buffer;
-						return true;
-					}
+				if (cached)
+				{ //attempt to parse, falls back to the sim if that fails
+					queueDecode(request);
+					return true;
 				}
-
-				delete[] buffer;
+				delete request;
 			}
 
-			//reading from VFS failed for whatever reason, fetch from sim
+			//reading from cache failed for whatever reason, fetch from sim
 			std::string http_url;
 			int legacy_cap_version(0);
 			constructUrl(mesh_id, &http_url, &legacy_cap_version);
@@ -2890,6 +3127,7 @@ void LLMeshHandlerBase::onCompleted(LLCore::HttpHandle handle, LLCore::HttpRespo
 		LLCore::BufferArray * body(response->getBody());
 		S32 body_offset(0);
 		U8 * data(nullptr);
+		bool data_copied(false);
 		S32 data_size(body ? body->size() : 0);
 
 		if (data_size > 0)
@@ -2942,19 +3180,26 @@ void LLMeshHandlerBase::onCompleted(LLCore::HttpHandle handle, LLCore::HttpRespo
 				goto common_exit;
 			}
 
-			// *TODO: Try to get rid of data copying and add interfaces
-			// that support BufferArray directly.  Introduce a two-phase
-			// handler, optional first that takes a body, fallback second
-			// that requires a temporary allocation and data copy.
+			// Bodies with a known length arrive in a single extent
+			// and are processed in place.  Only scattered ones need
+			// a temporary allocation and data copy.
 			body_offset = mOffset - offset;
-			data = new U8[data_size - body_offset];
-			body->read(body_offset, (char *) data, data_size - body_offset);
+			data = (U8 *) body->getContiguous(body_offset, data_size - body_offset);
+			if (! data)
+			{
+				data = new U8[data_size - body_offset];
+				body->read(body_offset, (char *) data, data_size - body_offset);
+				data_copied = true;
+			}
 			LLMeshRepository::sBytesReceived += data_size;
 		}
 
 		processData(body, body_offset, data, data_size - body_offset);
 
-		delete [] data;
+		if (data_copied)
+		{
+			delete [] data;
+		}
 	}
 
 	// Release handler
@@ -3016,7 +3261,7 @@ void LLMeshHeaderHandler::processData(LLCore::BufferArray * /* body */, S32 /* b
 	}
 	else if (data && data_size > 0)
 	{
-		// header was successfully retrieved from sim and parsed, cache in vfs
+		// header was successfully retrieved from sim and parsed, cache it
 		S32 header_bytes = 0;
 		LLSD header;
 
@@ -3034,47 +3279,27 @@ void LLMeshHeaderHandler::processData(LLCore::BufferArray * /* body */, S32 /* b
 			//&& header.has("version") // OPENSIM RUDENESS BAD FORMAT AHHHH
 			&& header["version"].asInteger() <= MAX_MESH_VERSION)
 		{
-			S32 lod_bytes = 0;
+			gMeshRepo.mThread->writeCachedPart(mesh_id, LLMeshCache::PART_HEADER, data, llmin(data_size, header_bytes));
 
-			for (U32 i = 0; i < LLModel::LOD_PHYSICS; ++i)
+			// Small meshes come along with the header, cache whatever parts we got in full
+			static const struct { const char* mName; LLMeshCache::EPart mPart; } parts[] =
 			{
-				// figure out how many bytes we'll need to reserve in the file
-				const std::string & lod_name = header_lod[i];
-				lod_bytes = llmax(lod_bytes, header[lod_name]["offset"].asInteger()+header[lod_name]["size"].asInteger());
-	}
-
-			// just in case skin info or decomposition is at the end of the file (which it shouldn't be)
-			lod_bytes = llmax(lod_bytes, header["skin"]["offset"].asInteger() + header["skin"]["size"].asInteger());
-			lod_bytes = llmax(lod_bytes, header["physics_convex"]["offset"].asInteger() + header["physics_convex"]["size"].asInteger());
-
-			S32 header_bytes = (S32) gMeshRepo.mThread->mMeshHeaderSize[mesh_id];
-			S32 bytes = lod_bytes + header_bytes; 
-
-
-			// It's possible for the remote asset to have more data than is needed for the local cache
-			// only allocate as much space in the VFS as is needed for the local cache
-			data_size = llmin(data_size, bytes);
-
-			LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH, LLVFile::WRITE);
-			if (file.getMaxSize() >= bytes || file.setMaxSize(bytes))
+				{ "lowest_lod", LLMeshCache::PART_LOD_LOWEST },
+				{ "low_lod", LLMeshCache::PART_LOD_LOW },
+				{ "medium_lod", LLMeshCache::PART_LOD_MEDIUM },
+				{ "high_lod", LLMeshCache::PART_LOD_HIGH },
+				{ "skin", LLMeshCache::PART_SKIN },
+				{ "physics_convex", LLMeshCache::PART_PHYSICS_CONVEX },
+				{ "physics_mesh", LLMeshCache::PART_PHYSICS_MESH },
+			};
+			for (const auto& part : parts)
 			{
-				LLMeshRepository::sCacheBytesWritten += data_size;
-				++LLMeshRepository::sCacheWrites;
-
-				file.write(data, data_size);
-
-				// zero out the rest of the file 
-				U8 block[MESH_HEADER_SIZE] = {0};
-
-				while (bytes-file.tell() > sizeof(block))
-				{
-					file.write(block, sizeof(block));
-				}
-
-				S32 remaining = bytes-file.tell();
-				if (remaining > 0)
+				const LLSD& block = header[part.mName];
+				S32 offset = header_bytes + block["offset"].asInteger();
+				S32 size = block["size"].asInteger();
+				if (size > 0 && offset >= header_bytes && offset + size <= data_size)
 				{
-					file.write(block, remaining);
+					gMeshRepo.mThread->writeCachedPart(mesh_id, part.mPart, data + offset, size);
 				}
 			}
 		}
@@ -3119,21 +3344,11 @@ void LLMeshLODHandler::processFailure(LLCore::HttpStatus status)
 void LLMeshLODHandler::processData(LLCore::BufferArray * /* body */, S32 /* body_offset */,
 								   U8 * data, S32 data_size)
 {
-	if ((! MESH_LOD_PROCESS_FAILED) && gMeshRepo.mThread->lodReceived(mMeshParams, mLOD, data, data_size))
+	if ((! MESH_LOD_PROCESS_FAILED) && data && data_size > 0)
 	{
-		//good fetch from sim, write to VFS for caching
-		LLVFile file(gVFS, mMeshParams.getSculptID(), LLAssetType::AT_MESH, LLVFile::WRITE);
-
-		S32 offset = mOffset;
-		S32 size = mRequestedBytes;
-
-		if (file.getSize() >= offset+size)
-		{
-			file.seek(offset);
-			file.write(data, size);
-			LLMeshRepository::sCacheBytesWritten += size;
-			++LLMeshRepository::sCacheWrites;
-		}
+		// Unpacked and, if good, written to the mesh cache by a decode thread
+		gMeshRepo.mThread->queueDecode(new LLMeshRepoThread::DecodeRequest(LLMeshRepoThread::DecodeRequest::LOD, mMeshParams, mLOD,
+																		   data, llmin(data_size, (S32)mRequestedBytes), false));
 	}
 	else
 	{
@@ -3167,21 +3382,13 @@ void LLMeshSkinInfoHandler::processFailure(LLCore::HttpStatus status)
 void LLMeshSkinInfoHandler::processData(LLCore::BufferArray * /* body */, S32 /* body_offset */,
 										U8 * data, S32 data_size)
 {
-	if ((! MESH_SKIN_INFO_PROCESS_FAILED) && gMeshRepo.mThread->skinInfoReceived(mMeshID, data, data_size))
+	if (! MESH_SKIN_INFO_PROCESS_FAILED)
 	{
-		//good fetch from sim, write to VFS for caching
-		LLVFile file(gVFS, mMeshID, LLAssetType::AT_MESH, LLVFile::WRITE);
-
-		S32 offset = mOffset;
-		S32 size = mRequestedBytes;
-
-		if (file.getSize() >= offset+size)
-		{
-			LLMeshRepository::sCacheBytesWritten += size;
-			++LLMeshRepository::sCacheWrites;
-			file.seek(offset);
-			file.write(data, size);
-		}
+		// Parsed and, if good, written to the mesh cache by a decode thread
+		LLVolumeParams mesh_params;
+		mesh_params.setSculptID(mMeshID, LL_SCULPT_TYPE_MESH);
+		gMeshRepo.mThread->queueDecode(new LLMeshRepoThread::DecodeRequest(LLMeshRepoThread::DecodeRequest::SKIN, mesh_params, 0,
+																		   data, llmin(data_size, (S32)mRequestedBytes), false));
 	}
 	else
 	{
@@ -3215,19 +3422,8 @@ void LLMeshDecompositionHandler::processData(LLCore::BufferArray * /* body */, S
 {
 	if ((! MESH_DECOMP_PROCESS_FAILED) && gMeshRepo.mThread->decompositionReceived(mMeshID, data, data_size))
 	{
-		// good fetch from sim, write to VFS for caching
-		LLVFile file(gVFS, mMeshID, LLAssetType::AT_MESH, LLVFile::WRITE);
-
-		S32 offset = mOffset;
-		S32 size = mRequestedBytes;
-
-		if (file.getSize() >= offset+size)
-		{
-			LLMeshRepository::sCacheBytesWritten += size;
-			++LLMeshRepository::sCacheWrites;
-			file.seek(offset);
-			file.write(data, size);
-		}
+		// good fetch from sim, write to the mesh cache
+		gMeshRepo.mThread->writeCachedPart(mMeshID, LLMeshCache::PART_PHYSICS_CONVEX, data, llmin(data_size, (S32)mRequestedBytes));
 	}
 	else
 	{
@@ -3260,19 +3456,8 @@ void LLMeshPhysicsShapeHandler::processData(LLCore::BufferArray * /* body */, S3
 {
 	if ((! MESH_PHYS_SHAPE_PROCESS_FAILED) && gMeshRepo.mThread->physicsShapeReceived(mMeshID, data, data_size))
 	{
-		// good fetch from sim, write to VFS for caching
-		LLVFile file(gVFS, mMeshID, LLAssetType::AT_MESH, LLVFile::WRITE);
-
-		S32 offset = mOffset;
-		S32 size = mRequestedBytes;
-
-		if (file.getSize() >= offset+size)
-		{
-			LLMeshRepository::sCacheBytesWritten += size;
-			++LLMeshRepository::sCacheWrites;
-			file.seek(offset);
-			file.write(data, size);
-		}
+		// good fetch from sim, write to the mesh cache
+		gMeshRepo.mThread->writeCachedPart(mMeshID, LLMeshCache::PART_PHYSICS_MESH, data, llmin(data_size, (S32)mRequestedBytes));
 	}
 	else
 	{
@@ -3288,6 +3473,7 @@ LLMeshRepository::LLMeshRepository()
   mMeshThreadCount(0),
   mThread(nullptr),
   mDecompThread(nullptr),
+  mCache(nullptr),
   mLegacyGetMeshVersion(0)
 {
 
@@ -3314,6 +3500,19 @@ void LLMeshRepository::init()
 	mThread->start();
 }
 
+void LLMeshRepository::initCache(const std::string& dirname, U64 max_size)
+{
+	llassert(!mCache);
+
+	LLMeshCache* cache = new LLMeshCache(dirname, max_size);
+	if (!cache->open())
+	{
+		delete cache;
+		return;
+	}
+	mCache = cache;
+}
+
 void LLMeshRepository::shutdown()
 {
 	LL_INFOS(LOG_MESH) << "Shutting down mesh repository." << LL_ENDL;
@@ -3335,6 +3534,9 @@ void LLMeshRepository::shutdown()
 	delete mThread;
 	mThread = nullptr;
 
+	delete mCache;		// saves the index
+	mCache = nullptr;
+
 	for (U32 i = 0; i < mUploads.size(); ++i)
 	{
 		LL_INFOS(LOG_MESH) << "Waiting for pending mesh upload " << (i + 1) << "/" << mUploads.size() << LL_ENDL;
@@ -4882,6 +5084,10 @@ void LLMeshRepository::metricsUpdate()
 		metrics["teleports"] = LLSD::Integer(metrics_teleport_start_count);
 		metrics["user_cpu"] = double(user_cpu) / 1.0e6;
 		metrics["sys_cpu"] = double(sys_cpu) / 1.0e6;
+		if (gMeshRepo.mThread)
+		{
+			metrics["decode"] = gMeshRepo.mThread->getDecodeStatsLLSD();
+		}
 		LL_INFOS(LOG_MESH) << "EventMarker " << metrics << LL_ENDL;
 	}
 }
@@ -39,7 +39,10 @@
 #include "httpheaders.h"
 #include "httphandler.h"
 #include "llthread.h"
+#include "llatomic.h"
+#include "llmeshcache.h"
 
+#include <memory>
 #include <boost/unordered_map.hpp> // <alchemy/>
 
 #define LLCONVEXDECOMPINTER_STATIC 1
@@ -274,6 +277,42 @@ public:
 	typedef std::map<LLVolumeParams, std::vector<S32> > pending_lod_map;
 	pending_lod_map mPendingLOD;
 
+	//LODs and skin info that failed to decode from the cache and must come from the sim
+	std::deque<LODRequest> mLODRefetchQ;
+	std::set<LLUUID> mSkinRefetchRequests;
+
+	// LOD or skin info payload waiting for a decode thread
+	class DecodeRequest
+	{
+	public:
+		enum EType { LOD, SKIN };
+
+		DecodeRequest(EType type, const LLVolumeParams& mesh_params, S32 lod, const U8* data, S32 data_size, bool from_cache);
+
+		EType mType;
+		LLVolumeParams mMeshParams;
+		LLUUID mMeshID;
+		S32 mLOD;
+		std::vector<U8> mData;
+		bool mFromCache;	// read from the mesh cache, nothing to write back
+		U64 mQueuedTime;
+	};
+
+	// Decode latency, one slot per LOD and one for skin info
+	struct DecodeStats
+	{
+		DecodeStats();
+
+		LLAtomicU32 mCount;
+		LLAtomicU32 mFailures;
+		LLAtomic32<U64> mQueueTime;		// microseconds spent waiting for a decode thread
+		LLAtomic32<U64> mDecodeTime;	// microseconds spent inflating and unpacking
+		LLAtomic32<U64> mMaxDecodeTime;
+	};
+	static const U32 DECODE_STATS_SKIN = LLModel::LOD_PHYSICS;
+	static const U32 DECODE_STATS_COUNT = DECODE_STATS_SKIN + 1;
+	DecodeStats mDecodeStats[DECODE_STATS_COUNT];
+
 	// llcorehttp library interface objects.
 	LLCore::HttpStatus					mHttpStatus;
 	LLCore::HttpRequest *				mHttpRequest;
@@ -288,6 +327,8 @@ public:
 	typedef std::set<LLCore::HttpHandler::ptr_t> http_request_set;
 	http_request_set					mHttpRequestSet;			// Outstanding HTTP requests
 
+	LLTimer mCacheSaveTimer;
+
 	std::string mLegacyGetMeshCapability;
 	std::string mLegacyGetMesh2Capability;
 	int mLegacyGetMeshVersion;
@@ -298,11 +339,21 @@ public:
 
 	void run() override;
 
+	// Hands a payload over to the decode threads, which push the result
+	// to mLoadedQ or mSkinInfoQ.  Decodes inline when there is no pool.
+	void queueDecode(DecodeRequest* request);
+	LLSD getDecodeStatsLLSD() const;
+
+	// Mesh cache access with size checks and cache statistics.  Reads fail
+	// and writes do nothing when the cache is unavailable.
+	bool readCachedPart(const LLUUID& mesh_id, LLMeshCache::EPart part, S32 size, std::vector<U8>& data);
+	void writeCachedPart(const LLUUID& mesh_id, LLMeshCache::EPart part, const U8* data, S32 size);
+
 	void lockAndLoadMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
 	void loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
 
 	bool fetchMeshHeader(const LLVolumeParams& mesh_params);
-	bool fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
+	bool fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod, bool can_use_cache = true);
 	bool headerReceived(const LLVolumeParams& mesh_params, U8* data, S32 data_size);
 	bool lodReceived(const LLVolumeParams& mesh_params, S32 lod, U8* data, S32 data_size);
 	bool skinInfoReceived(const LLUUID& mesh_id, U8* data, S32 data_size);
@@ -319,7 +370,7 @@ public:
 
 	//send request for skin info, returns true if header info exists 
 	//  (should hold onto mesh_id and try again later if header info does not exist)
-	bool fetchMeshSkinInfo(const LLUUID& mesh_id);
+	bool fetchMeshSkinInfo(const LLUUID& mesh_id, bool can_use_cache = true);
 
 	//send request for decomposition, returns true if header info exists 
 	//  (should hold onto mesh_id and try again later if header info does not exist)
@@ -344,6 +395,28 @@ public:
 	void constructUrl(LLUUID mesh_id, std::string * url, int * legacy_version);
 
 private:
+	class DecodeThread : public LLThread
+	{
+	public:
+		DecodeThread(LLMeshRepoThread* repo, U32 index);
+
+	protected:
+		bool runCondition() override;
+		void run() override;
+
+	private:
+		LLMeshRepoThread* mRepo;
+	};
+
+	// Threads:  decode (or repo, without a pool)
+	void processDecodes();
+	void decode(DecodeRequest& request);
+
+	std::vector<std::unique_ptr<DecodeThread> > mDecodeThreads;
+	LLMutex mDecodeMutex;
+	std::deque<DecodeRequest*> mDecodeQ;	// guarded by mDecodeMutex
+	LLAtomicU32 mDecodePending;				// entries in mDecodeQ
+
 	// Issue a GET request to a URL with 'Range' header using
 	// the correct policy class and other attributes.  If an invalid
 	// handle is returned, the request failed and caller must retry
@@ -470,10 +543,10 @@ public:
 	static U32 sHTTPErrorCount;					// Requests ending in error
 	static U32 sLODPending;
 	static U32 sLODProcessing;
-	static U32 sCacheBytesRead;
-	static U32 sCacheBytesWritten;
-	static U32 sCacheReads;						
-	static U32 sCacheWrites;
+	static LLAtomicU32 sCacheBytesRead;			// Updated from the decode threads
+	static LLAtomicU32 sCacheBytesWritten;
+	static LLAtomicU32 sCacheReads;
+	static LLAtomicU32 sCacheWrites;
 	static U32 sMaxLockHoldoffs;				// Maximum sequential locking failures
 	
 	static LLDeadmanTimer sQuiescentTimer;		// Time-to-complete-mesh-downloads after significant events
@@ -484,6 +557,8 @@ public:
 	LLMeshRepository();
 
 	void init();
+	// Opens the on-disk mesh cache, meshes simply aren't cached if it fails
+	void initCache(const std::string& dirname, U64 max_size);
 	void shutdown();
 	S32 update();
 
@@ -569,6 +644,8 @@ public:
 	std::vector<LLMeshUploadThread*> mUploadWaitList;
 
 	LLPhysicsDecomp* mDecompThread;
+
+	LLMeshCache* mCache;
 	
 	class inventory_data
 	{
@@ -231,3 +231,86 @@ void LLSkinningUtil::getPerVertexSkinMatrix(
 	llassert(valid_weights);
 }
 
+// static
+void LLSkinningUtil::fuseBindShapeMatrix(LLMatrix4a* mat, U32 count, const LLMeshSkinInfo* skin)
+{
+	LLMatrix4a bind_shape_matrix;
+	bind_shape_matrix.loadu(skin->mBindShapeMatrix);
+
+	for (U32 j = 0; j < count; ++j)
+	{
+		// The bind shape matrix applies first
+		const LLMatrix4a joint_mat = mat[j];
+		mat[j].setMul(joint_mat, bind_shape_matrix);
+	}
+}
+
+// static
+void LLSkinningUtil::skinPositions(const LLMatrix4a* mat, U32 count, const LLVector4a* weights,
+								   const LLVector4a* src, LLVector4a* dst, U32 num_vertices, LLVector4a* extents)
+{
+	if (!num_vertices || !count)
+	{
+		return;
+	}
+
+	// Blending the four joints' transforms of a vertex is the same as
+	// transforming it by the blended matrix, without building the matrix
+	static const LLVector4a ones(1.f, 1.f, 1.f, 1.f);
+	const S32 max_index = (S32)count - 1;
+	LLVector4a min;
+	LLVector4a max;
+	for (U32 j = 0; j < num_vertices; ++j)
+	{
+		// Joint numbers are the whole parts of the weights, the weights
+		// their fractions
+		const LLQuad w = weights[j];
+		const __m128i whole = _mm_cvttps_epi32(w);
+		LLVector4a frac;
+		frac = _mm_sub_ps(w, _mm_cvtepi32_ps(whole));
+		LLVector4a scale;
+		scale.setAllDot4(frac, ones);
+		frac.div(scale);
+
+		LL_ALIGN_16(S32 index[4]);
+		_mm_store_si128((__m128i*)index, whole);
+
+		LLVector4a x, y, z;
+		x.splat<0>(src[j]);
+		y.splat<1>(src[j]);
+		z.splat<2>(src[j]);
+
+		LLVector4a res;
+		res.clear();
+		for (U32 k = 0; k < 4; ++k)
+		{
+			const LLMatrix4a& m = mat[llclamp(index[k], 0, max_index)];
+			LLVector4a t, u;
+			t.setMul(x, m.getRow<0>());
+			u.setMul(y, m.getRow<1>());
+			t.add(u);
+			u.setMul(z, m.getRow<2>());
+			t.add(u);
+			t.add(m.getRow<3>());
+
+			LLVector4a wk;
+			wk.splat(frac, k);
+			t.mul(wk);
+			res.add(t);
+		}
+		dst[j] = res;
+
+		if (j)
+		{
+			min.setMin(min, res);
+			max.setMax(max, res);
+		}
+		else
+		{
+			min = res;
+			max = res;
+		}
+	}
+	extents[0] = min;
+	extents[1] = max;
+}
@@ -30,6 +30,7 @@
 class LLVOAvatar;
 class LLMeshSkinInfo;
 class LLMatrix4a;
+class LLVector4a;
 
 class LLSkinningUtil
 {
@@ -42,6 +43,13 @@ public:
     static void checkSkinWeights(const LLVector4a* weights, U32 num_vertices, const LLMeshSkinInfo* skin);
     static void scrubSkinWeights(LLVector4a* weights, U32 num_vertices, const LLMeshSkinInfo* skin);
     static void getPerVertexSkinMatrix(const F32* weights, LLMatrix4a* mat, bool handle_bad_scale, LLMatrix4a& final_mat, U32 max_joints);
+    // Folds the skin's bind shape matrix into each matrix of the palette,
+    // so that skinPositions() needs no separate bind shape transform
+    static void fuseBindShapeMatrix(LLMatrix4a* mat, U32 count, const LLMeshSkinInfo* skin);
+    // Skins num_vertices positions by a fused palette of count matrices,
+    // storing their bounding box in extents[0] and extents[1] on the way
+    static void skinPositions(const LLMatrix4a* mat, U32 count, const LLVector4a* weights,
+                              const LLVector4a* src, LLVector4a* dst, U32 num_vertices, LLVector4a* extents);
 };
 
 #endif
@@ -683,6 +683,12 @@ bool idle_startup()
 				msg->mPacketRing.setUseOutThrottle(TRUE);
 				msg->mPacketRing.setOutBandwidth(outBandwidth);
 			}
+
+			// After the packet ring is set up, the thread owns its receive side
+			if (gSavedSettings.getBOOL("MessageDecodeThread"))
+			{
+				msg->startDecodeThread();
+			}
 		}
 
 		LL_INFOS("AppInit") << "Message System Initialized." << LL_ENDL;
@@ -452,8 +452,7 @@ bool LLTextureCacheRemoteWorker::doRead()
 		size = llmin(size, mDataSize);
 		// Allocate the read buffer
 		mReadData = (U8*) ll_aligned_malloc_16(size);
-		S32 bytes_read = LLFile::readEx(mCache->mHeaderDataFileName,
-											 mReadData, offset, size);
+		S32 bytes_read = mCache->readHeaderData(offset, mReadData, size);
 		if (bytes_read != size)
 		{
 			LL_WARNS() << "LLTextureCacheWorker: "  << mID
@@ -667,13 +666,13 @@ bool LLTextureCacheRemoteWorker::doWrite()
 				U8* padBuffer = (U8*) ll_aligned_malloc_16(TEXTURE_CACHE_ENTRY_SIZE);
 				memset(padBuffer, 0, TEXTURE_CACHE_ENTRY_SIZE);		// Init with zeros
 				memcpy(padBuffer, mWriteData, mDataSize);			// Copy the write buffer
-				bytes_written = LLFile::writeEx(mCache->mHeaderDataFileName, padBuffer, offset, size);
+				bytes_written = mCache->writeHeaderData(offset, padBuffer, size);
 				ll_aligned_free_16(padBuffer);
 			}
 			else
 			{
 				// Write the header record (== first TEXTURE_CACHE_ENTRY_SIZE bytes of the raw file) in the header file
-				bytes_written = LLFile::writeEx(mCache->mHeaderDataFileName, mWriteData, offset, size);
+				bytes_written = mCache->writeHeaderData(offset, mWriteData, size);
 			}
 
 			if (bytes_written <= 0)
@@ -820,6 +819,7 @@ LLTextureCache::LLTextureCache(bool threaded)
 	  mListMutex(),
 	  mFastCacheMutex(),
 	  mHeaderFilep(nullptr),
+	  mNextLRUShard(0),
 	  mReadOnly(TRUE), //do not allow to change the texture cache until setReadOnly() is called.
 	  mTexturesSizeTotal(0),
 	  mDoPurge(false),
@@ -911,10 +911,7 @@ std::string LLTextureCache::getTextureFileName(const LLUUID& id)
 //debug
 BOOL LLTextureCache::isInCache(const LLUUID& id) 
 {
-	LLMutexLock lock(&mHeaderMutex);
-	id_map_t::const_iterator iter = mHeaderIDMap.find(id);
-	
-	return (iter != mHeaderIDMap.end()) ;
+	return getEntryIndex(id) >= 0;
 }
 
 //debug
@@ -1055,6 +1052,8 @@ S64 LLTextureCache::initCache(ELLPath location, S64 max_size, BOOL texture_cache
 			std::string dirname = mTexturesDirName + gDirUtilp->getDirDelimiter() + subdirs[i];
 			LLFile::mkdir(dirname);
 		}
+
+		openHeaderMaps();
 	}
 	readHeaderCache();
 	purgeTextures(true); // calc mTexturesSize and make some room in the texture cache if we need it
@@ -1065,6 +1064,202 @@ S64 LLTextureCache::initCache(ELLPath location, S64 max_size, BOOL texture_cache
 	return max_size; // unused cache space
 }
 
+//----------------------------------------------------------------------------
+
+// called in the main thread from initCache(), before any worker touches the headers.
+void LLTextureCache::openHeaderMaps()
+{
+	closeHeaderMaps();
+
+	S64 entries_size = (S64)sizeof(EntriesInfo) + (S64)sCacheMaxEntries * (S64)sizeof(Entry);
+	if (!mHeaderEntriesMap.open(mHeaderEntriesFileName, true, entries_size))
+	{
+		LL_WARNS("TextureCache") << "Unable to map " << mHeaderEntriesFileName << ", using file I/O for headers" << LL_ENDL;
+		return;
+	}
+
+	// A full header data file does not fit comfortably in a 32 bit address space
+	if (sizeof(void*) >= 8)
+	{
+		S64 data_size = (S64)sCacheMaxEntries * TEXTURE_CACHE_ENTRY_SIZE;
+		if (!mHeaderDataMap.open(mHeaderDataFileName, true, data_size))
+		{
+			LL_WARNS("TextureCache") << "Unable to map " << mHeaderDataFileName << ", using file I/O for header data" << LL_ENDL;
+		}
+	}
+}
+
+// Workers use the maps without mHeaderMutex: mapped records with the shard mutex
+// of their UUID held, header data with mHeaderMapMutex held, so both are taken
+// here before unmapping.
+void LLTextureCache::closeHeaderMaps()
+{
+	lockAllShards();
+	mHeaderMapMutex.lock();
+
+	mHeaderEntriesMap.close();
+	mHeaderDataMap.close();
+
+	mHeaderMapMutex.unlock();
+	unlockAllShards();
+}
+
+void LLTextureCache::lockAllShards()
+{
+	for (U32 i = 0; i < HEADER_SHARD_COUNT; ++i)
+	{
+		mHeaderShards[i].mMutex.lock();
+	}
+}
+
+void LLTextureCache::unlockAllShards()
+{
+	for (U32 i = 0; i < HEADER_SHARD_COUNT; ++i)
+	{
+		mHeaderShards[i].mMutex.unlock();
+	}
+}
+
+// Returns the mapped record of entry idx, or NULL when the entries file isn't mapped.
+LLTextureCache::Entry* LLTextureCache::getMappedEntry(S32 idx)
+{
+	if (idx < 0 || !mHeaderEntriesMap.isOpen())
+	{
+		return nullptr;
+	}
+	S64 offset = (S64)sizeof(EntriesInfo) + (S64)idx * (S64)sizeof(Entry);
+	if (offset + (S64)sizeof(Entry) > mHeaderEntriesMap.getSize())
+	{
+		return nullptr;
+	}
+	return (Entry*)(mHeaderEntriesMap.getData() + offset);
+}
+
+// Called from work thread
+S32 LLTextureCache::readHeaderData(S32 offset, U8* data, S32 size)
+{
+	{
+		LLMutexLock lock(&mHeaderMapMutex);
+		if (mHeaderDataMap.isOpen() && (S64)offset + size <= mHeaderDataMap.getSize())
+		{
+			memcpy(data, mHeaderDataMap.getData() + offset, size);
+			return size;
+		}
+	}
+	return LLFile::readEx(mHeaderDataFileName, data, offset, size);
+}
+
+// Called from work thread
+S32 LLTextureCache::writeHeaderData(S32 offset, const U8* data, S32 size)
+{
+	{
+		LLMutexLock lock(&mHeaderMapMutex);
+		if (mHeaderDataMap.isOpen() && (S64)offset + size <= mHeaderDataMap.getSize())
+		{
+			memcpy(mHeaderDataMap.getData() + offset, data, size);
+			return size;
+		}
+	}
+	return LLFile::writeEx(mHeaderDataFileName, (void*)data, offset, size);
+}
+
+S32 LLTextureCache::getEntryIndex(const LLUUID& id)
+{
+	HeaderShard& shard = getShard(id);
+	{
+		LLMutexLock lock(&shard.mMutex);
+		id_map_t::const_iterator iter = shard.mIDMap.find(id);
+		if (iter != shard.mIDMap.end())
+		{
+			return iter->second;
+		}
+	}
+
+	// readHeaderCache() empties the shards before filling them again, so
+	// only a miss seen with mHeaderMutex held is a real one
+	LLMutexLock header_lock(&mHeaderMutex);
+	LLMutexLock lock(&shard.mMutex);
+	id_map_t::const_iterator iter = shard.mIDMap.find(id);
+	return iter != shard.mIDMap.end() ? iter->second : -1;
+}
+
+void LLTextureCache::setEntryIndex(const LLUUID& id, S32 idx)
+{
+	HeaderShard& shard = getShard(id);
+	LLMutexLock lock(&shard.mMutex);
+	shard.mIDMap[id] = idx;
+}
+
+void LLTextureCache::eraseEntryIndex(const LLUUID& id)
+{
+	HeaderShard& shard = getShard(id);
+	LLMutexLock lock(&shard.mMutex);
+	shard.mIDMap.erase(id);
+}
+
+void LLTextureCache::clearEntryIndices()
+{
+	for (U32 i = 0; i < HEADER_SHARD_COUNT; ++i)
+	{
+		LLMutexLock lock(&mHeaderShards[i].mMutex);
+		mHeaderShards[i].mIDMap.clear();
+	}
+}
+
+void LLTextureCache::addToLRU(const LLUUID& id)
+{
+	HeaderShard& shard = getShard(id);
+	LLMutexLock lock(&shard.mMutex);
+	shard.mLRU.insert(id);
+}
+
+void LLTextureCache::removeFromLRU(const LLUUID& id)
+{
+	HeaderShard& shard = getShard(id);
+	LLMutexLock lock(&shard.mMutex);
+	shard.mLRU.erase(id);
+}
+
+// Takes one UUID out of the LRU, walking the shards round robin
+bool LLTextureCache::popLRU(LLUUID& id)
+{
+	for (U32 i = 0; i < HEADER_SHARD_COUNT; ++i)
+	{
+		HeaderShard& shard = mHeaderShards[(mNextLRUShard + i) & (HEADER_SHARD_COUNT - 1)];
+		LLMutexLock lock(&shard.mMutex);
+		if (!shard.mLRU.empty())
+		{
+			id = *shard.mLRU.begin();
+			shard.mLRU.erase(shard.mLRU.begin());
+			mNextLRUShard = (mNextLRUShard + i + 1) & (HEADER_SHARD_COUNT - 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool LLTextureCache::isLRUEmpty()
+{
+	for (U32 i = 0; i < HEADER_SHARD_COUNT; ++i)
+	{
+		LLMutexLock lock(&mHeaderShards[i].mMutex);
+		if (!mHeaderShards[i].mLRU.empty())
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void LLTextureCache::clearLRU()
+{
+	for (U32 i = 0; i < HEADER_SHARD_COUNT; ++i)
+	{
+		LLMutexLock lock(&mHeaderShards[i].mMutex);
+		mHeaderShards[i].mLRU.clear();
+	}
+}
+
 //----------------------------------------------------------------------------
 // mHeaderMutex must be locked for the following functions!
 
@@ -1103,7 +1298,11 @@ void LLTextureCache::readEntriesHeader()
 {
 	// mHeaderEntriesInfo initializes to default values so safe not to read it
 	llassert_always(mHeaderFilep == nullptr || !mHeaderFilep->is_open());
-	if (LLFile::isfile(mHeaderEntriesFileName))
+	if (mHeaderEntriesMap.isOpen())
+	{
+		memcpy(&mHeaderEntriesInfo, mHeaderEntriesMap.getData(), sizeof(EntriesInfo));
+	}
+	else if (LLFile::isfile(mHeaderEntriesFileName))
 	{
 		LLFile::readEx(mHeaderEntriesFileName, (U8*)&mHeaderEntriesInfo, 0, sizeof(EntriesInfo));
 	}
@@ -1118,7 +1317,11 @@ void LLTextureCache::readEntriesHeader()
 void LLTextureCache::writeEntriesHeader()
 {
 	llassert_always(mHeaderFilep == nullptr || !mHeaderFilep->is_open());
-	if (!mReadOnly)
+	if (mHeaderEntriesMap.isOpen())
+	{
+		memcpy(mHeaderEntriesMap.getData(), &mHeaderEntriesInfo, sizeof(EntriesInfo));
+	}
+	else if (!mReadOnly)
 	{
 		LLFile::writeEx(mHeaderEntriesFileName, (U8*)&mHeaderEntriesInfo, 0, sizeof(EntriesInfo));
 	}
@@ -1127,13 +1330,7 @@ void LLTextureCache::writeEntriesHeader()
 //mHeaderMutex is locked before calling this.
 S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create)
 {
-	S32 idx = -1;
-	
-	id_map_t::iterator iter1 = mHeaderIDMap.find(id);
-	if (iter1 != mHeaderIDMap.end())
-	{
-		idx = iter1->second;
-	}
+	S32 idx = getEntryIndex(id);
 
 	if (idx < 0)
 	{
@@ -1153,17 +1350,14 @@ S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create
 			else
 			{
 				// Look for a still valid entry in the LRU
-				for (std::set<LLUUID>::iterator iter2 = mLRU.begin(); iter2 != mLRU.end();)
+				LLUUID oldid;
+				while (popLRU(oldid)) // Erase entry from LRU regardless
 				{
-					std::set<LLUUID>::iterator curiter2 = iter2++;
-					LLUUID oldid = *curiter2;
-					// Erase entry from LRU regardless
-					mLRU.erase(curiter2);
 					// Look up entry and use it if it is valid
-					id_map_t::iterator iter3 = mHeaderIDMap.find(oldid);
-					if (iter3 != mHeaderIDMap.end() && iter3->second >= 0)
+					S32 old_idx = getEntryIndex(oldid);
+					if (old_idx >= 0)
 					{
-						idx = iter3->second;
+						idx = old_idx;
 						removeCachedTexture(oldid);//remove the existing cached texture to release the entry index.
 						break;
 					}
@@ -1183,7 +1377,7 @@ S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create
 	else
 	{
 		// Remove this entry from the LRU if it exists
-		mLRU.erase(id);
+		removeFromLRU(id);
 		// Read the entry
 		idx_entry_map_t::iterator iter = mUpdatedEntryMap.find(idx);
 		if(iter != mUpdatedEntryMap.end())
@@ -1192,6 +1386,7 @@ S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create
 		}
 		else
 		{
+			LLMutexLock lock(&getShard(id).mMutex);
 			readEntryFromHeaderImmediately(idx, entry);
 		}
 		if(entry.mImageSize <= entry.mBodySize)//it happens on 64-bit systems, do not know why
@@ -1211,6 +1406,27 @@ S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create
 //mHeaderMutex is locked before calling this.
 void LLTextureCache::writeEntryToHeaderImmediately(S32& idx, Entry& entry, bool write_header)
 {	
+	if (mHeaderEntriesMap.isOpen())
+	{
+		Entry* mapped = getMappedEntry(idx);
+		if (!mapped)
+		{
+			clearCorruptedCache(); //clear the cache.
+			idx = -1; //mark the idx invalid.
+			return;
+		}
+		if (write_header)
+		{
+			memcpy(mHeaderEntriesMap.getData(), &mHeaderEntriesInfo, sizeof(EntriesInfo));
+		}
+		{
+			LLMutexLock lock(&getShard(entry.mID).mMutex);
+			*mapped = entry;
+		}
+		mUpdatedEntryMap.erase(idx);
+		return;
+	}
+
 	S32 bytes_written;
 	S32 offset = sizeof(EntriesInfo) + idx * sizeof(Entry);
 	if(write_header)
@@ -1250,7 +1466,23 @@ void LLTextureCache::writeEntryToHeaderImmediately(S32& idx, Entry& entry, bool
 //mHeaderMutex is locked before calling this.
 void LLTextureCache::readEntryFromHeaderImmediately(S32& idx, Entry& entry)
 {
-		S32 offset = sizeof(EntriesInfo) + idx * sizeof(Entry);
+	if (mHeaderEntriesMap.isOpen())
+	{
+		// caller holds the shard mutex of the UUID being read
+		Entry* mapped = getMappedEntry(idx);
+		if (mapped)
+		{
+			entry = *mapped;
+		}
+		else
+		{
+			clearCorruptedCache(); //clear the cache.
+			idx = -1;//mark the idx invalid.
+		}
+		return;
+	}
+
+	S32 offset = sizeof(EntriesInfo) + idx * sizeof(Entry);
 	openHeaderEntriesFile(true, offset, true);
 	mHeaderFilep->read((char*)&entry, (S32)sizeof(Entry));
 	S32 bytes_read = mHeaderFilep->gcount();
@@ -1263,7 +1495,7 @@ void LLTextureCache::readEntryFromHeaderImmediately(S32& idx, Entry& entry)
 	closeHeaderEntriesFile();
 }
 
-//mHeaderMutex is locked before calling this.
+//mHeaderMutex or the shard mutex of entry.mID is locked before calling this.
 //update an existing entry time stamp, delay writing.
 void LLTextureCache::updateEntryTimeStamp(S32 idx, Entry& entry)
 {
@@ -1279,7 +1511,20 @@ void LLTextureCache::updateEntryTimeStamp(S32 idx, Entry& entry)
 		if (!mReadOnly)
 		{
 			entry.mTime = time(NULL);
-			mUpdatedEntryMap[idx] = entry;
+			if (mHeaderEntriesMap.isOpen())
+			{
+				// the page gets written back by the OS, no need to queue it
+				LLMutexLock lock(&getShard(entry.mID).mMutex);
+				Entry* mapped = getMappedEntry(idx);
+				if (mapped)
+				{
+					mapped->mTime = entry.mTime;
+				}
+			}
+			else
+			{
+				mUpdatedEntryMap[idx] = entry;
+			}
 		}
 	}
 }
@@ -1302,7 +1547,7 @@ bool LLTextureCache::updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32
 		bool update_header = false;
 		if(entry.mImageSize < 0) //is a brand-new entry
 			{
-			mHeaderIDMap[entry.mID] = idx;
+			setEntryIndex(entry.mID, idx);
 			mTexturesSizeMap[entry.mID] = new_body_size;
 			mTexturesSizeTotal += new_body_size;
 			
@@ -1311,7 +1556,7 @@ bool LLTextureCache::updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32
 			}
 		else if (entry.mBodySize != new_body_size)
 		{
-			//already in mHeaderIDMap.
+			//already in the entry index.
 			mTexturesSizeMap[entry.mID] = new_body_size;
 			mTexturesSizeTotal -= entry.mBodySize;
 			mTexturesSizeTotal += new_body_size;
@@ -1342,51 +1587,75 @@ U32 LLTextureCache::openAndReadEntries(std::vector<Entry>& entries)
 {
 	U32 num_entries = mHeaderEntriesInfo.mEntries;
 
-	mHeaderIDMap.clear();
+	clearEntryIndices();
 	mTexturesSizeMap.clear();
 	mFreeList.clear();
 	mTexturesSizeTotal = 0;
 
-	if(mUpdatedEntryMap.empty())
+	if (mHeaderEntriesMap.isOpen())
 	{
-		openHeaderEntriesFile(true, (S32)sizeof(EntriesInfo), true);
-	}
-	else //update the header file first.
-	{
-		openHeaderEntriesFile(false, 0);
-		updatedHeaderEntriesFile();
-		if(!mHeaderFilep)
+		// The records are already in memory: no stream reads, a single copy.
+		const Entry* first = getMappedEntry(0);
+		if (num_entries && (!first || !getMappedEntry(num_entries - 1)))
 		{
+			LL_WARNS() << "Corrupted header entries, " << num_entries << " entries do not fit in "
+					   << mHeaderEntriesMap.getSize() << " bytes" << LL_ENDL;
+			purgeAllTextures(false);
 			return 0;
 		}
-		mHeaderFilep->seekg(sizeof(EntriesInfo));
+		mUpdatedEntryMap.clear(); // not used while mapped
+		lockAllShards();
+		entries.assign(first, first + num_entries);
+		unlockAllShards();
 	}
-	for (U32 idx=0; idx<num_entries; idx++)
+	else
 	{
-		Entry entry;
-		mHeaderFilep->read((char*) (&entry), sizeof(Entry));
-		S32 bytes_read = mHeaderFilep->gcount();
-		if (!mHeaderFilep->good() || bytes_read < sizeof(Entry))
+		if(mUpdatedEntryMap.empty())
 		{
-			LL_WARNS() << "Corrupted header entries, failed at " << idx << " / " << num_entries << LL_ENDL;
-			closeHeaderEntriesFile();
-			purgeAllTextures(false);
-			return 0;
+			openHeaderEntriesFile(true, (S32)sizeof(EntriesInfo), true);
+		}
+		else //update the header file first.
+		{
+			openHeaderEntriesFile(false, 0);
+			updatedHeaderEntriesFile();
+			if(!mHeaderFilep)
+			{
+				return 0;
+			}
+			mHeaderFilep->seekg(sizeof(EntriesInfo));
+		}
+		for (U32 idx=0; idx<num_entries; idx++)
+		{
+			Entry entry;
+			mHeaderFilep->read((char*) (&entry), sizeof(Entry));
+			S32 bytes_read = mHeaderFilep->gcount();
+			if (!mHeaderFilep->good() || bytes_read < sizeof(Entry))
+			{
+				LL_WARNS() << "Corrupted header entries, failed at " << idx << " / " << num_entries << LL_ENDL;
+				closeHeaderEntriesFile();
+				purgeAllTextures(false);
+				return 0;
+			}
+			entries.push_back(entry);
 		}
-		entries.push_back(entry);
+		closeHeaderEntriesFile();
+	}
+
+	for (U32 idx=0; idx<num_entries; idx++)
+	{
+		const Entry& entry = entries[idx];
 // 		LL_INFOS() << "ENTRY: " << entry.mTime << " TEX: " << entry.mID << " IDX: " << idx << " Size: " << entry.mImageSize << LL_ENDL;
 		if(entry.mImageSize > entry.mBodySize)
 		{
-			mHeaderIDMap[entry.mID] = idx;
-				mTexturesSizeMap[entry.mID] = entry.mBodySize;
-				mTexturesSizeTotal += entry.mBodySize;
-			}
+			setEntryIndex(entry.mID, idx);
+			mTexturesSizeMap[entry.mID] = entry.mBodySize;
+			mTexturesSizeTotal += entry.mBodySize;
+		}
 		else
 		{
 			mFreeList.insert(idx);
 		}
 	}
-	closeHeaderEntriesFile();
 	return num_entries;
 }
 
@@ -1395,7 +1664,23 @@ void LLTextureCache::writeEntriesAndClose(const std::vector<Entry>& entries)
 	S32 num_entries = entries.size();
 	llassert_always(num_entries == mHeaderEntriesInfo.mEntries);
 	
-	if (!mReadOnly)
+	if (mHeaderEntriesMap.isOpen())
+	{
+		Entry* first = getMappedEntry(0);
+		if (num_entries && (!first || !getMappedEntry(num_entries - 1)))
+		{
+			clearCorruptedCache(); //clear the cache.
+			return;
+		}
+		if (num_entries)
+		{
+			// Workers read and stamp single records with only their shard held
+			lockAllShards();
+			memcpy(first, &entries[0], num_entries * sizeof(Entry));
+			unlockAllShards();
+		}
+	}
+	else if (!mReadOnly)
 	{
 		openHeaderEntriesFile(false, (S32)sizeof(EntriesInfo));
 		for (S32 idx=0; idx<num_entries; idx++)
@@ -1416,7 +1701,13 @@ void LLTextureCache::writeEntriesAndClose(const std::vector<Entry>& entries)
 void LLTextureCache::writeUpdatedEntries()
 {
 	lockHeaders();
-	if (!mReadOnly && !mUpdatedEntryMap.empty())
+	if (mHeaderEntriesMap.isOpen())
+	{
+		// everything is already in the mappings, just push it to disk
+		mHeaderEntriesMap.flush();
+		mHeaderDataMap.flush();
+	}
+	else if (!mReadOnly && !mUpdatedEntryMap.empty())
 	{
 		openHeaderEntriesFile(false, 0);
 		updatedHeaderEntriesFile();
@@ -1473,7 +1764,7 @@ void LLTextureCache::readHeaderCache()
 {
 	mHeaderMutex.lock();
 
-	mLRU.clear(); // always clear the LRU
+	clearLRU(); // always clear the LRU
 
 	readEntriesHeader();
 	
@@ -1537,7 +1828,7 @@ void LLTextureCache::readHeaderCache()
 				S32 lru_entries = (S32)((F32)sCacheMaxEntries * TEXTURE_CACHE_LRU_SIZE);
 				for (std::set<lru_data_t>::iterator iter = lru.begin(); iter != lru.end(); ++iter)
 				{
-					mLRU.insert(entries[iter->second].mID);
+					addToLRU(entries[iter->second].mID);
 // 					LL_INFOS() << "LRU: " << iter->first << " : " << iter->second << LL_ENDL;
 					if (--lru_entries <= 0)
 						break;
@@ -1626,11 +1917,13 @@ void LLTextureCache::purgeAllTextures(bool purge_directories)
 		}
 		if (purge_directories)
 		{
+			// the header files are about to be deleted, stop mapping them
+			closeHeaderMaps();
 			gDirUtilp->deleteFilesInDir(mTexturesDirName, mask);
 			LLFile::rmdir(mTexturesDirName);
 		}
 	}
-	mHeaderIDMap.clear();
+	clearEntryIndices();
 	mTexturesSizeMap.clear();
 	mTexturesSizeTotal = 0;
 	mFreeList.clear();
@@ -1696,16 +1989,15 @@ void LLTextureCache::purgeTextures(bool validate)
 	{
 		if (iter1->second > 0)
 		{
-			id_map_t::iterator iter2 = mHeaderIDMap.find(iter1->first);
-			if (iter2 != mHeaderIDMap.end())
+			S32 idx = getEntryIndex(iter1->first);
+			if (idx >= 0)
 			{
-				S32 idx = iter2->second;
 				time_idx_set.push_back(std::make_pair(entries[idx].mTime, idx));
 // 				LL_INFOS() << "TIME: " << entries[idx].mTime << " TEX: " << entries[idx].mID << " IDX: " << idx << " Size: " << entries[idx].mImageSize << LL_ENDL;
 			}
 			else
 			{
-				LL_ERRS() << "mTexturesSizeMap / mHeaderIDMap corrupted." << LL_ENDL ;
+				LL_ERRS() << "mTexturesSizeMap / entry index corrupted." << LL_ENDL ;
 			}
 		}
 	}
@@ -1817,6 +2109,28 @@ LLTextureCacheWorker* LLTextureCache::getWriter(handle_t handle)
 // Reads imagesize from the header, updates timestamp
 S32 LLTextureCache::getHeaderCacheEntry(const LLUUID& id, Entry& entry)
 {
+	if (mHeaderEntriesMap.isOpen())
+	{
+		// Fast path: a valid mapped record only needs the shard of its UUID.
+		HeaderShard& shard = getShard(id);
+		LLMutexLock lock(&shard.mMutex);
+		id_map_t::const_iterator iter = shard.mIDMap.find(id);
+		if (iter != shard.mIDMap.end())
+		{
+			S32 idx = iter->second;
+			Entry* mapped = getMappedEntry(idx);
+			if (mapped && mapped->mImageSize > mapped->mBodySize)
+			{
+				entry = *mapped;
+				shard.mLRU.erase(id);
+				updateEntryTimeStamp(idx, entry); // updates time
+				return idx;
+			}
+		}
+		// Misses, which may come from readHeaderCache() refilling the index,
+		// and corrupted entries are dealt with below, with mHeaderMutex held
+	}
+
 	LLMutexLock lock(&mHeaderMutex);
 	S32 idx = openAndReadEntry(id, entry, false);
 	if (idx >= 0)
@@ -1843,7 +2157,7 @@ S32 LLTextureCache::setHeaderCacheEntry(const LLUUID& id, Entry& entry, S32 imag
 		readHeaderCache(); // We couldn't write an entry, so refresh the LRU
 	
 		mHeaderMutex.lock();
-		llassert_always(!mLRU.empty() || mHeaderEntriesInfo.mEntries < sCacheMaxEntries);
+		llassert_always(!isLRUEmpty() || mHeaderEntriesInfo.mEntries < sCacheMaxEntries);
 		mHeaderMutex.unlock();
 
 		idx = setHeaderCacheEntry(id, entry, imagesize, datasize); // assert above ensures no inf. recursion
@@ -1946,14 +2260,13 @@ LLPointer<LLImageRaw> LLTextureCache::readFromFastCache(const LLUUID& id, S32& d
 {
 	U32 offset;
 	{
-		LLMutexLock lock(&mHeaderMutex);
-		id_map_t::const_iterator iter = mHeaderIDMap.find(id);
-		if(iter == mHeaderIDMap.end())
+		S32 idx = getEntryIndex(id);
+		if(idx < 0)
 		{
 			return NULL; //not in the cache
 		}
 
-		offset = iter->second;
+		offset = idx;
 	}
 	offset *= TEXTURE_FAST_CACHE_ENTRY_SIZE;
 
@@ -2166,7 +2479,7 @@ void LLTextureCache::removeCachedTexture(const LLUUID& id)
 		mTexturesSizeTotal -= mTexturesSizeMap[id];
 		mTexturesSizeMap.erase(id);
 	}
-	mHeaderIDMap.erase(id);
+	eraseEntryIndex(id);
 	LLFile::remove(getTextureFileName(id));		
 }
 
@@ -2192,7 +2505,7 @@ void LLTextureCache::removeEntry(S32 idx, Entry& entry, std::string& filename)
 
 		entry.mImageSize = -1;
 		entry.mBodySize = 0;
-		mHeaderIDMap.erase(entry.mID);
+		eraseEntryIndex(entry.mID);
 		mTexturesSizeMap.erase(entry.mID);		
 		mFreeList.insert(idx);	
 	}
@@ -31,6 +31,7 @@
 #include "llstl.h"
 #include "llstring.h"
 #include "lluuid.h"
+#include "llmappedfile.h"
 
 #include "llworkerthread.h"
 
@@ -170,6 +171,27 @@ private:
 	void updatedHeaderEntriesFile() ;
 	void lockHeaders() { mHeaderMutex.lock(); }
 	void unlockHeaders() { mHeaderMutex.unlock(); }
+
+	void openHeaderMaps();
+	void closeHeaderMaps();
+	void lockAllShards();
+	void unlockAllShards();
+	Entry* getMappedEntry(S32 idx);
+	S32 readHeaderData(S32 offset, U8* data, S32 size);
+	S32 writeHeaderData(S32 offset, const U8* data, S32 size);
+
+	// UUID -> entry index lookups, each locks the shard of the UUID. A miss
+	// is checked again under mHeaderMutex, which is held while the index is
+	// being rebuilt.
+	S32 getEntryIndex(const LLUUID& id);
+	void setEntryIndex(const LLUUID& id, S32 idx);
+	void eraseEntryIndex(const LLUUID& id);
+	void clearEntryIndices();
+	void addToLRU(const LLUUID& id);
+	void removeFromLRU(const LLUUID& id);
+	bool popLRU(LLUUID& id);
+	bool isLRUEmpty();
+	void clearLRU();
 	
 	void openFastCache(bool first_time = false);
 	void closeFastCache(bool forced = false);
@@ -201,9 +223,29 @@ private:
 	std::string mFastCacheFileName;
 	EntriesInfo mHeaderEntriesInfo;
 	std::set<S32> mFreeList; // deleted entries
-	std::set<LLUUID> mLRU;
 	typedef std::map<LLUUID,S32> id_map_t;
-	id_map_t mHeaderIDMap;
+
+	// The UUID lookup tables are split by UUID so that workers reading different
+	// textures do not serialize on mHeaderMutex. Lock order is mHeaderMutex first,
+	// then a shard mutex, then mHeaderMapMutex. A mapped Entry record is only
+	// accessed with the shard mutex of its UUID held, or all of them held when
+	// the records are rewritten as a whole.
+	struct HeaderShard
+	{
+		LLMutex mMutex;
+		id_map_t mIDMap;
+		std::set<LLUUID> mLRU;
+	};
+	enum { HEADER_SHARD_COUNT = 16 }; // must be power of 2
+	HeaderShard& getShard(const LLUUID& id) { return mHeaderShards[id.mData[0] & (HEADER_SHARD_COUNT - 1)]; }
+	HeaderShard mHeaderShards[HEADER_SHARD_COUNT];
+	U32 mNextLRUShard;
+
+	// texture.entries and texture.cache, mapped for the lifetime of the cache when writable.
+	// When mapping fails we fall back to the llfstream / LLFile code paths.
+	LLMappedFile mHeaderEntriesMap;
+	LLMappedFile mHeaderDataMap;
+	LLMutex mHeaderMapMutex; // held while using mHeaderDataMap, after any shard mutex
 
 	llfstream*	 mFastCacheFilep;
 	LLFrameTimer mFastCacheTimer;
@@ -44,6 +44,7 @@
 
 #include "llagent.h"
 #include "lltexturecache.h"
+#include "lltexturefetchtrace.h"
 #include "llviewercontrol.h"
 #include "llviewertexturelist.h"
 #include "llviewertexture.h"
@@ -1237,6 +1238,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 				mCacheReadHandle = mFetcher->mTextureCache->readFromCache(filename, mID, cache_priority,
 																		  offset, size, responder);
 				mCacheReadTimer.reset();
+				LLTextureFetchTrace::record(LLTextureFetchTrace::CACHE_READ_BEGIN, mID, mDesiredDiscard, offset, size);
 			}
 			else if ((mUrl.empty() || mFTType==FTT_SERVER_BAKE) && mFetcher->canLoadFromCache())
 			{
@@ -1247,6 +1249,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 				mCacheReadHandle = mFetcher->mTextureCache->readFromCache(mID, cache_priority,
 																		  offset, size, responder);
 				mCacheReadTimer.reset();
+				LLTextureFetchTrace::record(LLTextureFetchTrace::CACHE_READ_BEGIN, mID, mDesiredDiscard, offset, size);
 			}
 			else if(!mUrl.empty() && mCanUseHTTP)
 			{
@@ -1266,6 +1269,11 @@ bool LLTextureFetchWorker::doWork(S32 param)
 			if (mFetcher->mTextureCache->readComplete(mCacheReadHandle, false))
 			{
 				mCacheReadHandle = LLTextureCache::nullHandle();
+				if (LLTextureFetchTrace::isRecording())
+				{
+					S32 cached_size = mFormattedImage.notNull() ? mFormattedImage->getDataSize() : 0;
+					LLTextureFetchTrace::record(LLTextureFetchTrace::CACHE_READ_END, mID, -1, 0, cached_size, cached_size > 0);
+				}
 				setState(CACHE_POST);
 				// fall through
 			}
@@ -1619,6 +1627,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 		mHttpActive = true;
 		mFetcher->addToHTTPQueue(mID);
 		recordTextureStart(true);
+		LLTextureFetchTrace::record(LLTextureFetchTrace::HTTP_BEGIN, mID, mDesiredDiscard, mRequestedOffset, mRequestedSize);
 		setPriority(LLWorkerThread::PRIORITY_LOW | mWorkPriority);
 		setState(WAIT_HTTP_REQ);	
 		
@@ -1777,12 +1786,22 @@ bool LLTextureFetchWorker::doWork(S32 param)
 				mFileSize = total_size + 1 ; //flag the file is not fully loaded.
 			}
 			
-			U8 * buffer = (U8*) ll_aligned_malloc_16(total_size);
-			if (cur_size > 0)
+			U8 * buffer(NULL);
+			if (! cur_size && ! src_offset)
+			{
+				// Nothing to splice onto, so when the response came in
+				// as a single extent the image can simply take it over.
+				buffer = (U8 *) mHttpBufferArray->detachContiguous();
+			}
+			if (! buffer)
 			{
-				memcpy(buffer, mFormattedImage->getData(), cur_size);
+				buffer = (U8*) ll_aligned_malloc_16(total_size);
+				if (cur_size > 0)
+				{
+					memcpy(buffer, mFormattedImage->getData(), cur_size);
+				}
+				mHttpBufferArray->read(src_offset, (char *) buffer + cur_size, append_size);
 			}
-			mHttpBufferArray->read(src_offset, (char *) buffer + cur_size, append_size);
 
 			// NOTE: setData releases current data and owns new data (buffer)
 			mFormattedImage->setData(buffer, total_size);
@@ -1872,6 +1891,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 				<< " All Data: " << mHaveAllData << LL_ENDL;
 		mDecodeHandle = mFetcher->mImageDecodeThread->decodeImage(mFormattedImage, image_priority, discard, mNeedsAux,
 																  new DecodeResponder(mFetcher, mID, this));
+		LLTextureFetchTrace::record(LLTextureFetchTrace::DECODE_BEGIN, mID, discard, 0, mFormattedImage->getDataSize());
 		// fall though
 	}
 	
@@ -1951,6 +1971,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 		mCacheWriteHandle = mFetcher->mTextureCache->writeToCache(mID, cache_priority,
 																  mFormattedImage->getData(), datasize,
 																  mFileSize, mRawImage, mDecodedDiscard, responder);
+		LLTextureFetchTrace::record(LLTextureFetchTrace::CACHE_WRITE_BEGIN, mID, mDecodedDiscard, mFileSize, datasize);
 		// fall through
 	}
 	
@@ -1988,6 +2009,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 		}
 		else
 		{
+			LLTextureFetchTrace::record(LLTextureFetchTrace::DONE, mID, mDecodedDiscard);
 			setPriority(LLWorkerThread::PRIORITY_LOW | mWorkPriority);
 			return true;
 		}
@@ -2083,6 +2105,7 @@ void LLTextureFetchWorker::onCompleted(LLCore::HttpHandle handle, LLCore::HttpRe
 	}
 	
 	S32BytesImplicit data_size = callbackHttpGet(response, partial, success);
+	LLTextureFetchTrace::record(LLTextureFetchTrace::HTTP_END, mID, -1, mRequestedOffset, data_size, (S32)status.getType());
 
 	if (log_texture_traffic && data_size > 0)
 	{
@@ -2413,6 +2436,7 @@ void LLTextureFetchWorker::callbackCacheWrite(bool success)
 		return;
 	}
 	mWritten = TRUE;
+	LLTextureFetchTrace::record(LLTextureFetchTrace::CACHE_WRITE_END, mID, -1, 0, 0, success);
 	setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
 }																		// -Mw
 
@@ -2451,6 +2475,13 @@ void LLTextureFetchWorker::callbackDecoded(bool success, LLImageRaw* raw, LLImag
 		mDecodedDiscard = -1; // Redundant, here for clarity and paranoia
 	}
 	mDecoded = TRUE;
+	if (LLTextureFetchTrace::isRecording())
+	{
+		LLTextureFetchTrace::recordDecoded(mID, mDecodedDiscard,
+										   mRawImage.notNull() ? mRawImage->getWidth() : 0,
+										   mRawImage.notNull() ? mRawImage->getHeight() : 0,
+										   mRawImage.notNull() ? mRawImage->getComponents() : 0);
+	}
 // 	LL_INFOS(LOG_TXT) << mID << " : DECODE COMPLETE " << LL_ENDL;
 	setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
 	mCacheReadTime = mCacheReadTimer.getElapsedTimeF32();
@@ -2576,6 +2607,12 @@ LLTextureFetch::LLTextureFetch(LLTextureCache* cache, LLImageDecodeThread* image
 		}
 		mOriginFetchSource = mFetchSource;
 	}
+
+	const std::string trace_file = gSavedSettings.getString("TextureFetchTraceFile");
+	if (!trace_file.empty())
+	{
+		LLTextureFetchTrace::start(trace_file);
+	}
 }
 
 LLTextureFetch::~LLTextureFetch()
@@ -2596,6 +2633,8 @@ LLTextureFetch::~LLTextureFetch()
 
 	delete mFetchDebugger;
 	mFetchDebugger = NULL;
+
+	LLTextureFetchTrace::stop();
 	
 	// ~LLQueuedThread() called here
 }
@@ -2715,6 +2754,7 @@ bool LLTextureFetch::createRequest(FTType f_type, const std::string& url, const
 	
  	LL_DEBUGS(LOG_TXT) << "REQUESTED: " << id << " f_type " << fttype_to_string(f_type)
 					   << " Discard: " << desired_discard << " size " << desired_size << LL_ENDL;
+	LLTextureFetchTrace::recordRequest(id, priority, desired_discard, desired_size, w, h, c, can_use_http);
 	return true;
 }
 
@@ -2790,6 +2830,7 @@ void LLTextureFetch::deleteRequest(const LLUUID& id, bool cancel)
 		llassert_always(!(worker->getFlags(LLWorkerClass::WCF_DELETE_REQUESTED))) ;
 
 		worker->scheduleDelete();	
+		LLTextureFetchTrace::record(LLTextureFetchTrace::REMOVE, id, -1, 0, 0, cancel);
 	}
 	else
 	{
@@ -2962,6 +3003,7 @@ bool LLTextureFetch::updateRequestPriority(const LLUUID& id, F32 priority)
 		worker->lockWorkMutex();										// +Mw
 		worker->setImagePriority(priority);
 		worker->unlockWorkMutex();										// -Mw
+		LLTextureFetchTrace::recordPriority(id, priority);
 		res = true;
 	}
 	return res;
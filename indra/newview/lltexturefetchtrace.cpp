@@ -0,0 +1,293 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/**
+ * @file lltexturefetchtrace.cpp
+ * @brief Records what the texture fetcher does to a file for later replay
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "lltexturefetchtrace.h"
+
+#include "lldir.h"
+#include "llfile.h"
+#include "llmutex.h"
+#include "lltimer.h"
+
+// Text format, one event per line:
+//   time_us event id discard offset size width height components priority status
+static const char* TRACE_HEADER = "# texture fetch trace 1";
+// Records are written out in batches of this many
+static const size_t TRACE_FLUSH_RECORDS = 1024;
+
+static const char* EVENT_NAMES[LLTextureFetchTrace::EVENT_COUNT] =
+{
+	"request",
+	"priority",
+	"cache_read_begin",
+	"cache_read_end",
+	"http_begin",
+	"http_end",
+	"decode_begin",
+	"decode_end",
+	"cache_write_begin",
+	"cache_write_end",
+	"done",
+	"remove"
+};
+
+LLAtomic32<bool> LLTextureFetchTrace::sRecording(false);
+
+namespace
+{
+	LLMutex sTraceMutex;
+	LLFILE* sTraceFile = nullptr;
+	U64 sTraceStart = 0;
+	LLTextureFetchTrace::record_list_t sPending;
+	U32 sTraceCount = 0;
+}
+
+LLTextureFetchTrace::Record::Record()
+	: mTime(0),
+	  mEvent(REQUEST),
+	  mDiscard(-1),
+	  mOffset(0),
+	  mSize(0),
+	  mWidth(0),
+	  mHeight(0),
+	  mComponents(0),
+	  mPriority(0.f),
+	  mStatus(0)
+{
+}
+
+// static
+bool LLTextureFetchTrace::start(const std::string& filename)
+{
+	LLMutexLock lock(&sTraceMutex);
+	if (sTraceFile)
+	{
+		return true;
+	}
+
+	std::string path = filename;
+	if (filename.find_first_of("/\\") == std::string::npos)
+	{
+		path = gDirUtilp->getExpandedFilename(LL_PATH_LOGS, filename);
+	}
+	sTraceFile = LLFile::fopen(path, "w");
+	if (!sTraceFile)
+	{
+		LL_WARNS("TextureFetch") << "Unable to open texture fetch trace " << path << LL_ENDL;
+		return false;
+	}
+	fprintf(sTraceFile, "%s\n# time_us event id discard offset size width height components priority status\n", TRACE_HEADER);
+
+	sTraceStart = LLTimer::getTotalTime();
+	sTraceCount = 0;
+	sPending.reserve(TRACE_FLUSH_RECORDS);
+	sRecording = true;
+	LL_INFOS("TextureFetch") << "Recording texture fetch trace to " << path << LL_ENDL;
+	return true;
+}
+
+// static
+void LLTextureFetchTrace::stop()
+{
+	LLMutexLock lock(&sTraceMutex);
+	if (!sTraceFile)
+	{
+		return;
+	}
+	sRecording = false;
+	flush();
+	fclose(sTraceFile);
+	sTraceFile = nullptr;
+	LL_INFOS("TextureFetch") << "Texture fetch trace stopped after " << sTraceCount << " events" << LL_ENDL;
+}
+
+// static
+void LLTextureFetchTrace::record(EEvent event, const LLUUID& id, S32 discard, S32 offset, S32 size, S32 status)
+{
+	if (!sRecording)
+	{
+		return;
+	}
+	Record record;
+	record.mEvent = event;
+	record.mID = id;
+	record.mDiscard = discard;
+	record.mOffset = offset;
+	record.mSize = size;
+	record.mStatus = status;
+	append(record);
+}
+
+// static
+void LLTextureFetchTrace::recordRequest(const LLUUID& id, F32 priority, S32 discard, S32 size,
+										S32 width, S32 height, S32 components, bool can_use_http)
+{
+	if (!sRecording)
+	{
+		return;
+	}
+	Record record;
+	record.mEvent = REQUEST;
+	record.mID = id;
+	record.mDiscard = discard;
+	record.mSize = size;
+	record.mWidth = width;
+	record.mHeight = height;
+	record.mComponents = components;
+	record.mPriority = priority;
+	record.mStatus = can_use_http ? 1 : 0;
+	append(record);
+}
+
+// static
+void LLTextureFetchTrace::recordPriority(const LLUUID& id, F32 priority)
+{
+	if (!sRecording)
+	{
+		return;
+	}
+	Record record;
+	record.mEvent = PRIORITY;
+	record.mID = id;
+	record.mPriority = priority;
+	append(record);
+}
+
+// static
+void LLTextureFetchTrace::recordDecoded(const LLUUID& id, S32 discard, S32 width, S32 height, S32 components)
+{
+	if (!sRecording)
+	{
+		return;
+	}
+	Record record;
+	record.mEvent = DECODE_END;
+	record.mID = id;
+	record.mDiscard = discard;
+	record.mWidth = width;
+	record.mHeight = height;
+	record.mComponents = components;
+	append(record);
+}
+
+// static
+void LLTextureFetchTrace::append(Record& record)
+{
+	LLMutexLock lock(&sTraceMutex);
+	if (!sTraceFile)
+	{
+		return;
+	}
+	// Stamped under the lock so the file is in time order
+	record.mTime = LLTimer::getTotalTime() - sTraceStart;
+	sPending.push_back(record);
+	if (sPending.size() >= TRACE_FLUSH_RECORDS)
+	{
+		flush();
+	}
+}
+
+// static
+void LLTextureFetchTrace::flush()
+{
+	for (const Record& record : sPending)
+	{
+		fprintf(sTraceFile, "%llu %s %s %d %d %d %d %d %d %.1f %d\n",
+				(unsigned long long)record.mTime, EVENT_NAMES[record.mEvent], record.mID.asString().c_str(),
+				record.mDiscard, record.mOffset, record.mSize,
+				record.mWidth, record.mHeight, record.mComponents,
+				record.mPriority, record.mStatus);
+	}
+	sTraceCount += sPending.size();
+	sPending.clear();
+	fflush(sTraceFile);
+}
+
+// static
+bool LLTextureFetchTrace::load(const std::string& filename, record_list_t& records)
+{
+	llifstream file(filename.c_str());
+	if (!file.is_open())
+	{
+		LL_WARNS("TextureFetch") << "Unable to open texture fetch trace " << filename << LL_ENDL;
+		return false;
+	}
+
+	std::string line;
+	if (!std::getline(file, line) || line != TRACE_HEADER)
+	{
+		LL_WARNS("TextureFetch") << filename << " is not a texture fetch trace" << LL_ENDL;
+		return false;
+	}
+
+	S32 line_number = 1;
+	while (std::getline(file, line))
+	{
+		++line_number;
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+
+		unsigned long long time = 0;
+		char event[32];
+		char id[40];
+		Record record;
+		if (sscanf(line.c_str(), "%llu %31s %39s %d %d %d %d %d %d %f %d",
+				   &time, event, id, &record.mDiscard, &record.mOffset, &record.mSize,
+				   &record.mWidth, &record.mHeight, &record.mComponents,
+				   &record.mPriority, &record.mStatus) != 11
+			|| !record.mID.set(id, FALSE))
+		{
+			LL_WARNS("TextureFetch") << filename << ":" << line_number << ": bad record" << LL_ENDL;
+			return false;
+		}
+		record.mTime = time;
+
+		S32 index = 0;
+		while (index < EVENT_COUNT && strcmp(event, EVENT_NAMES[index]))
+		{
+			++index;
+		}
+		if (index == EVENT_COUNT)
+		{
+			LL_WARNS("TextureFetch") << filename << ":" << line_number << ": unknown event " << event << LL_ENDL;
+			return false;
+		}
+		record.mEvent = (EEvent)index;
+		records.push_back(record);
+	}
+	return true;
+}
+
+// static
+const char* LLTextureFetchTrace::getEventName(EEvent event)
+{
+	return event < EVENT_COUNT ? EVENT_NAMES[event] : "unknown";
+}
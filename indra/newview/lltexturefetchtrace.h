@@ -0,0 +1,106 @@
+/**
+ * @file lltexturefetchtrace.h
+ * @brief Records what the texture fetcher does to a file for later replay
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTEXTUREFETCHTRACE_H
+#define LL_LLTEXTUREFETCHTRACE_H
+
+#include <vector>
+
+#include "llatomic.h"
+#include "lluuid.h"
+
+// Headless counterpart of LLTextureFetchDebugger: while recording, every
+// request, priority change and cache, HTTP and decode step of the texture
+// fetcher is appended to a text file, one event per line.  The
+// texture_fetch_replay program plays such a file back against the texture
+// cache and decoder without a grid.
+//
+// Recording is switched on with the TextureFetchTraceFile setting.  The
+// record functions may be called from any thread and cost one branch when
+// not recording.
+class LLTextureFetchTrace
+{
+public:
+	enum EEvent
+	{
+		REQUEST = 0,		// discard, size, width, height, components, priority, status = can use http
+		PRIORITY,			// priority
+		CACHE_READ_BEGIN,	// offset, size
+		CACHE_READ_END,		// size = bytes held after the read, status = 1 if found
+		HTTP_BEGIN,			// discard, offset, size
+		HTTP_END,			// offset, size = bytes received, status = HTTP status
+		DECODE_BEGIN,		// discard, size = bytes decoded
+		DECODE_END,			// discard (-1 when it failed), width, height, components
+		CACHE_WRITE_BEGIN,	// discard, size, offset = full image size
+		CACHE_WRITE_END,	// status = 1 if written
+		DONE,				// discard
+		REMOVE,				// status = 1 if cancelled
+		EVENT_COUNT
+	};
+
+	struct Record
+	{
+		Record();
+
+		U64		mTime;			// microseconds since recording started
+		EEvent	mEvent;
+		LLUUID	mID;
+		S32		mDiscard;
+		S32		mOffset;
+		S32		mSize;
+		S32		mWidth;
+		S32		mHeight;
+		S32		mComponents;
+		F32		mPriority;
+		S32		mStatus;
+	};
+	typedef std::vector<Record> record_list_t;
+
+	// A relative filename goes in the logs directory
+	static bool start(const std::string& filename);
+	static void stop();
+	static bool isRecording()			{ return sRecording; }
+
+	static void record(EEvent event, const LLUUID& id, S32 discard = -1, S32 offset = 0, S32 size = 0, S32 status = 0);
+	static void recordRequest(const LLUUID& id, F32 priority, S32 discard, S32 size, S32 width, S32 height, S32 components, bool can_use_http);
+	static void recordPriority(const LLUUID& id, F32 priority);
+	static void recordDecoded(const LLUUID& id, S32 discard, S32 width, S32 height, S32 components);
+
+	// Reads back a whole trace, false if the file can't be read or parsed
+	static bool load(const std::string& filename, record_list_t& records);
+
+	static const char* getEventName(EEvent event);
+
+private:
+	static void append(Record& record);
+	static void flush();
+
+	// Set on the main thread, read by the fetch and decode workers before
+	// they take the trace mutex
+	static LLAtomic32<bool> sRecording;
+};
+
+#endif // LL_LLTEXTUREFETCHTRACE_H
@@ -812,6 +812,7 @@ void LLViewerObjectList::update(LLAgent &agent, LLWorld &world)
 	std::vector<LLViewerObject*>::iterator idle_end = idle_list.begin()+idle_count;
 
 	static const LLCachedControl<bool> freeze_time("FreezeTime",0);
+	LLVOAvatar::beginDeferredMotions();
 	if (freeze_time)
 	{
 		for (std::vector<LLViewerObject*>::iterator iter = idle_list.begin();
@@ -827,6 +828,7 @@ void LLViewerObjectList::update(LLAgent &agent, LLWorld &world)
 				objectp->idleUpdate(agent, world, frame_time);
 			}
 		}
+		LLVOAvatar::updateDeferredMotions();
 	}
 	else
 	{
@@ -838,6 +840,7 @@ void LLViewerObjectList::update(LLAgent &agent, LLWorld &world)
 			objectp->idleUpdate(agent, world, frame_time);
 
 		}
+		LLVOAvatar::updateDeferredMotions();
 
 		//update flexible objects
 		LLVolumeImplFlexible::updateClass();
@@ -37,6 +37,7 @@
 #include "llviewercontrol.h"
 
 #include "llagent.h"
+#include "lljobpool.h"
 #include "llviewercamera.h"
 #include "llviewerobjectlist.h"
 #include "llviewerpartsource.h"
@@ -71,13 +72,22 @@ const F32 LLViewerPartSim::PART_ADAPT_RATE_MULT_RECIP = 1.0f/PART_ADAPT_RATE_MUL
 
 U32 LLViewerPart::sNextPartID = 1;
 
-F32 calc_desired_size(LLViewerCamera* camera, LLVector3 pos, LLVector2 scale)
+static inline F32 calc_desired_size(const LLVector3& camera_origin, const LLVector3& pos, const LLVector2& scale)
 {
-	F32 desired_size = (pos - camera->getOrigin()).magVec();
+	F32 desired_size = (pos - camera_origin).magVec();
 	desired_size /= 4;
 	return llclamp(desired_size, scale.magVec()*0.5f, PART_SIM_BOX_SIDE*2);
 }
 
+F32 calc_desired_size(LLViewerCamera* camera, LLVector3 pos, LLVector2 scale)
+{
+	return calc_desired_size(camera->getOrigin(), pos, scale);
+}
+
+// Flags that need the particle's source during an update
+static const U32 SOURCE_FLAGS = LLPartData::LL_PART_FOLLOW_SRC_MASK | LLPartData::LL_PART_TARGET_POS_MASK
+	| LLPartData::LL_PART_TARGET_LINEAR_MASK | LLPartData::LL_PART_BOUNCE_MASK;
+
 LLViewerPart::LLViewerPart() :
 	mPartID(0),
 	mLastUpdateTime(0.f),
@@ -226,7 +236,7 @@ void LLViewerPartGroup::cleanup()
 	}
 }
 
-BOOL LLViewerPartGroup::posInGroup(const LLVector3 &pos, const F32 desired_size)
+BOOL LLViewerPartGroup::posInGroup(const LLVector3 &pos, const F32 desired_size) const
 {
 	if ((pos.mV[VX] < mMinObjPos.mV[VX])
 		|| (pos.mV[VY] < mMinObjPos.mV[VY])
@@ -272,160 +282,310 @@ BOOL LLViewerPartGroup::addPart(LLViewerPart* part, F32 desired_size)
 
 	gPipeline.markRebuild(mVOPartGroupp->mDrawable, LLDrawable::REBUILD_ALL, TRUE);
 	
+	const S32 i = (S32)mParticles.size();
 	mParticles.push_back(part);
+	for (S32 c = 0; c < NUM_CHANNELS; ++c)
+	{
+		mChannels[c].push_back(0.f);
+	}
+	mFlags.push_back(0);
+	mCallbacks.push_back(NULL);
 	part->mSkipOffset=mSkippedTime;
+	loadPart(i, part);
 	LLViewerPartSim::incPartCount(1);
 	return TRUE;
 }
 
+void LLViewerPartGroup::loadPart(S32 i, const LLViewerPart* part)
+{
+	mChannels[POS_X][i] = part->mPosAgent.mV[VX];
+	mChannels[POS_Y][i] = part->mPosAgent.mV[VY];
+	mChannels[POS_Z][i] = part->mPosAgent.mV[VZ];
+	mChannels[VEL_X][i] = part->mVelocity.mV[VX];
+	mChannels[VEL_Y][i] = part->mVelocity.mV[VY];
+	mChannels[VEL_Z][i] = part->mVelocity.mV[VZ];
+	mChannels[ACCEL_X][i] = part->mAccel.mV[VX];
+	mChannels[ACCEL_Y][i] = part->mAccel.mV[VY];
+	mChannels[ACCEL_Z][i] = part->mAccel.mV[VZ];
+	mChannels[SKIP_OFFSET][i] = part->mSkipOffset;
+	mChannels[AGE][i] = part->mLastUpdateTime;
+	mChannels[MAX_AGE][i] = part->mMaxAge;
+	for (S32 k = 0; k < 4; ++k)
+	{
+		mChannels[COLOR_R + k][i] = part->mColor.mV[k];
+		mChannels[START_COLOR_R + k][i] = part->mStartColor.mV[k];
+		mChannels[END_COLOR_R + k][i] = part->mEndColor.mV[k];
+	}
+	for (S32 k = 0; k < 2; ++k)
+	{
+		mChannels[SCALE_X + k][i] = part->mScale.mV[k];
+		mChannels[START_SCALE_X + k][i] = part->mStartScale.mV[k];
+		mChannels[END_SCALE_X + k][i] = part->mEndScale.mV[k];
+	}
+	mChannels[START_GLOW][i] = part->mStartGlow;
+	mChannels[END_GLOW][i] = part->mEndGlow;
+	mFlags[i] = part->mFlags;
+	mCallbacks[i] = part->mVPCallback;
+}
 
-void LLViewerPartGroup::updateParticles(const F32 lastdt)
+void LLViewerPartGroup::storePart(S32 i, LLViewerPart* part) const
 {
-	F32 dt;
-	
-	LLVector3 gravity(0.f, 0.f, GRAVITY);
+	part->mPosAgent.set(mChannels[POS_X][i], mChannels[POS_Y][i], mChannels[POS_Z][i]);
+	part->mVelocity.set(mChannels[VEL_X][i], mChannels[VEL_Y][i], mChannels[VEL_Z][i]);
+	part->mColor.set(mChannels[COLOR_R][i], mChannels[COLOR_G][i], mChannels[COLOR_B][i], mChannels[COLOR_A][i]);
+	part->mScale.set(mChannels[SCALE_X][i], mChannels[SCALE_Y][i]);
+	part->mLastUpdateTime = mChannels[AGE][i];
+	part->mSkipOffset = 0.f;
+
+	const F32 frac = mChannels[AGE][i] / mChannels[MAX_AGE][i];
+	part->mGlow.mV[3] = (U8) ll_round(lerp(mChannels[START_GLOW][i], mChannels[END_GLOW][i], frac)*255.f);
+
+	// Reset the offset from the source position
+	if (mFlags[i] & LLPartData::LL_PART_FOLLOW_SRC_MASK)
+	{
+		part->mPosOffset.set(mChannels[POS_X][i] - mChannels[SOURCE_X][i],
+							 mChannels[POS_Y][i] - mChannels[SOURCE_Y][i],
+							 mChannels[POS_Z][i] - mChannels[SOURCE_Z][i]);
+	}
+}
+
 
+void LLViewerPartGroup::prepareUpdate(const F32 lastdt)
+{
 	LLViewerPartSim::checkParticleCount(mParticles.size());
 
-	LLViewerCamera* camera = LLViewerCamera::getInstance();
 	LLViewerRegion *regionp = getRegion();
-	S32 end = (S32) mParticles.size();
-	for (S32 i = 0 ; i < (S32)mParticles.size();)
+	const S32 count = getCount();
+	F32* dt = mChannels[DT].data();
+	const F32* skip_offset = mChannels[SKIP_OFFSET].data();
+	for (S32 i = 0; i < count; ++i)
 	{
-		LLVector3 a(0.f, 0.f, 0.f);
-		LLViewerPart* part = mParticles[i] ;
+		dt[i] = lastdt + mSkippedTime - skip_offset[i];
+	}
+
+	// Only the particles that follow their source, have a callback or feel
+	// the wind need looking at here
+	for (S32 i = 0; i < count; ++i)
+	{
+		const U32 flags = mFlags[i];
+		if (!(flags & (SOURCE_FLAGS | LLPartData::LL_PART_WIND_MASK)) && !mCallbacks[i])
+		{
+			continue;
+		}
+		LLViewerPart* part = mParticles[i];
+		LLViewerPartSource* sourcep = part->mPartSourcep;
 
-		dt = lastdt + mSkippedTime - part->mSkipOffset;
-		part->mSkipOffset = 0.f;
+		if (flags & SOURCE_FLAGS)
+		{
+			mChannels[SOURCE_X][i] = sourcep->mPosAgent.mV[VX];
+			mChannels[SOURCE_Y][i] = sourcep->mPosAgent.mV[VY];
+			mChannels[SOURCE_Z][i] = sourcep->mPosAgent.mV[VZ];
+			mChannels[TARGET_X][i] = sourcep->mTargetPosAgent.mV[VX];
+			mChannels[TARGET_Y][i] = sourcep->mTargetPosAgent.mV[VY];
+			mChannels[TARGET_Z][i] = sourcep->mTargetPosAgent.mV[VZ];
+		}
 
-		// Update current time
-		const F32 cur_time = part->mLastUpdateTime + dt;
-		const F32 frac = cur_time / part->mMaxAge;
+		if (!(flags & (LLPartData::LL_PART_FOLLOW_SRC_MASK | LLPartData::LL_PART_WIND_MASK)) && !mCallbacks[i])
+		{
+			continue;
+		}
 
 		// "Drift" the object based on the source object
-		if (part->mFlags & LLPartData::LL_PART_FOLLOW_SRC_MASK)
+		if (flags & LLPartData::LL_PART_FOLLOW_SRC_MASK)
 		{
-			part->mPosAgent = part->mPartSourcep->mPosAgent;
+			part->mPosAgent = sourcep->mPosAgent;
 			part->mPosAgent += part->mPosOffset;
 		}
 
 		// Do a custom callback if we have one...
-		if (part->mVPCallback)
+		if (mCallbacks[i])
 		{
-			(*part->mVPCallback)(*part, dt);
+			(*mCallbacks[i])(*part, dt[i]);
 		}
 
-		if (part->mFlags & LLPartData::LL_PART_WIND_MASK)
+		if (flags & LLPartData::LL_PART_WIND_MASK)
 		{
-			LLVector3 tempVel(part->mVelocity);
-			part->mVelocity *= 1.f - 0.1f*dt;
-			part->mVelocity += 0.1f*dt*regionp->mWind.getVelocity(regionp->getPosRegionFromAgent(part->mPosAgent));
+			part->mVelocity *= 1.f - 0.1f*dt[i];
+			part->mVelocity += 0.1f*dt[i]*regionp->mWind.getVelocity(regionp->getPosRegionFromAgent(part->mPosAgent));
 		}
 
-		// Now do interpolation towards a target
-		if (part->mFlags & LLPartData::LL_PART_TARGET_POS_MASK)
-		{
-			F32 remaining = part->mMaxAge - part->mLastUpdateTime;
-			F32 step = dt / remaining;
-
-			step = llclamp(step, 0.f, 0.1f);
-			step *= 5.f;
-			// we want a velocity that will result in reaching the target in the 
-			// Interpolate towards the target.
-			LLVector3 delta_pos = part->mPartSourcep->mTargetPosAgent - part->mPosAgent;
+		// The callback may have changed anything
+		loadPart(i, part);
+	}
+	std::fill(mChannels[SKIP_OFFSET].begin(), mChannels[SKIP_OFFSET].end(), 0.f);
+}
 
-			delta_pos /= remaining;
+void LLViewerPartGroup::updateParticles(const LLVector3& camera_origin)
+{
+	const S32 count = getCount();
+
+	F32* pos_x = mChannels[POS_X].data();
+	F32* pos_y = mChannels[POS_Y].data();
+	F32* pos_z = mChannels[POS_Z].data();
+	F32* vel_x = mChannels[VEL_X].data();
+	F32* vel_y = mChannels[VEL_Y].data();
+	F32* vel_z = mChannels[VEL_Z].data();
+	const F32* accel_x = mChannels[ACCEL_X].data();
+	const F32* accel_y = mChannels[ACCEL_Y].data();
+	const F32* accel_z = mChannels[ACCEL_Z].data();
+	const F32* dt = mChannels[DT].data();
+	F32* age = mChannels[AGE].data();
+	const F32* max_age = mChannels[MAX_AGE].data();
+	const U32* flags = mFlags.data();
+
+	U32 any_flags = 0;
+	for (S32 i = 0; i < count; ++i)
+	{
+		any_flags |= flags[i];
+	}
 
-			part->mVelocity *= (1.f - step);
-			part->mVelocity += step*delta_pos;
+	// Now do interpolation towards a target
+	if (any_flags & LLPartData::LL_PART_TARGET_POS_MASK)
+	{
+		for (S32 i = 0; i < count; ++i)
+		{
+			if (flags[i] & LLPartData::LL_PART_TARGET_POS_MASK)
+			{
+				const F32 remaining = max_age[i] - age[i];
+				const F32 step = llclamp(dt[i] / remaining, 0.f, 0.1f) * 5.f;
+				const F32 rate = step / remaining;
+				vel_x[i] = vel_x[i] * (1.f - step) + rate * (mChannels[TARGET_X][i] - pos_x[i]);
+				vel_y[i] = vel_y[i] * (1.f - step) + rate * (mChannels[TARGET_Y][i] - pos_y[i]);
+				vel_z[i] = vel_z[i] * (1.f - step) + rate * (mChannels[TARGET_Z][i] - pos_z[i]);
+			}
 		}
+	}
 
+	// Do velocity interpolation, and update current time
+	for (S32 i = 0; i < count; ++i)
+	{
+		const F32 half_dt_sq = 0.5f * dt[i] * dt[i];
+		pos_x[i] += dt[i] * vel_x[i] + half_dt_sq * accel_x[i];
+		pos_y[i] += dt[i] * vel_y[i] + half_dt_sq * accel_y[i];
+		pos_z[i] += dt[i] * vel_z[i] + half_dt_sq * accel_z[i];
+		vel_x[i] += accel_x[i] * dt[i];
+		vel_y[i] += accel_y[i] * dt[i];
+		vel_z[i] += accel_z[i] * dt[i];
+		age[i] += dt[i];
+	}
 
-		if (part->mFlags & LLPartData::LL_PART_TARGET_LINEAR_MASK)
+	if (any_flags & (LLPartData::LL_PART_TARGET_LINEAR_MASK | LLPartData::LL_PART_BOUNCE_MASK))
+	{
+		const F32* source_x = mChannels[SOURCE_X].data();
+		const F32* source_y = mChannels[SOURCE_Y].data();
+		const F32* source_z = mChannels[SOURCE_Z].data();
+		for (S32 i = 0; i < count; ++i)
 		{
-			LLVector3 delta_pos = part->mPartSourcep->mTargetPosAgent - part->mPartSourcep->mPosAgent;			
-			part->mPosAgent = part->mPartSourcep->mPosAgent;
-			part->mPosAgent += frac*delta_pos;
-			part->mVelocity = delta_pos;
+			// Linear targets ignore their velocity altogether
+			if (flags[i] & LLPartData::LL_PART_TARGET_LINEAR_MASK)
+			{
+				const F32 frac = age[i] / max_age[i];
+				vel_x[i] = mChannels[TARGET_X][i] - source_x[i];
+				vel_y[i] = mChannels[TARGET_Y][i] - source_y[i];
+				vel_z[i] = mChannels[TARGET_Z][i] - source_z[i];
+				pos_x[i] = source_x[i] + frac * vel_x[i];
+				pos_y[i] = source_y[i] + frac * vel_y[i];
+				pos_z[i] = source_z[i] + frac * vel_z[i];
+			}
+
+			// Do a bounce test
+			if (flags[i] & LLPartData::LL_PART_BOUNCE_MASK)
+			{
+				// Need to do point vs. plane check...
+				// For now, just check relative to object height...
+				const F32 dz = pos_z[i] - source_z[i];
+				if (dz < 0)
+				{
+					pos_z[i] += -2.f*dz;
+					vel_z[i] *= -0.75f;
+				}
+			}
 		}
-		else
+	}
+
+	// Do color and scale interpolation
+	if (any_flags & LLPartData::LL_PART_INTERP_COLOR_MASK)
+	{
+		for (S32 k = 0; k < 4; ++k)
 		{
-			// Do velocity interpolation
-			part->mPosAgent += dt*part->mVelocity;
-			part->mPosAgent += 0.5f*dt*dt*part->mAccel;
-			part->mVelocity += part->mAccel*dt;
+			F32* color = mChannels[COLOR_R + k].data();
+			const F32* start_color = mChannels[START_COLOR_R + k].data();
+			const F32* end_color = mChannels[END_COLOR_R + k].data();
+			for (S32 i = 0; i < count; ++i)
+			{
+				const F32 frac = age[i] / max_age[i];
+				const F32 value = start_color[i] + frac * (end_color[i] - start_color[i]);
+				color[i] = (flags[i] & LLPartData::LL_PART_INTERP_COLOR_MASK) ? value : color[i];
+			}
 		}
-
-		// Do a bounce test
-		if (part->mFlags & LLPartData::LL_PART_BOUNCE_MASK)
+	}
+	if (any_flags & LLPartData::LL_PART_INTERP_SCALE_MASK)
+	{
+		for (S32 k = 0; k < 2; ++k)
 		{
-			// Need to do point vs. plane check...
-			// For now, just check relative to object height...
-			F32 dz = part->mPosAgent.mV[VZ] - part->mPartSourcep->mPosAgent.mV[VZ];
-			if (dz < 0)
+			F32* scale = mChannels[SCALE_X + k].data();
+			const F32* start_scale = mChannels[START_SCALE_X + k].data();
+			const F32* end_scale = mChannels[END_SCALE_X + k].data();
+			for (S32 i = 0; i < count; ++i)
 			{
-				part->mPosAgent.mV[VZ] += -2.f*dz;
-				part->mVelocity.mV[VZ] *= -0.75f;
+				const F32 frac = age[i] / max_age[i];
+				const F32 value = start_scale[i] + frac * (end_scale[i] - start_scale[i]);
+				scale[i] = (flags[i] & LLPartData::LL_PART_INTERP_SCALE_MASK) ? value : scale[i];
 			}
 		}
+	}
 
+	// Hand the results to the particles, then close the gaps left by the
+	// dead and the ones leaving the group, keeping the survivors in order
+	S32 kept = 0;
+	for (S32 i = 0; i < count; ++i)
+	{
+		LLViewerPart* part = mParticles[i];
+		storePart(i, part);
 
-		// Reset the offset from the source position
-		if (part->mFlags & LLPartData::LL_PART_FOLLOW_SRC_MASK)
+		// Kill dead particles (either flagged dead, or too old)
+		if ((age[i] > max_age[i]) || (LLViewerPart::LL_PART_DEAD_MASK == flags[i]))
 		{
-			part->mPosOffset = part->mPosAgent;
-			part->mPosOffset -= part->mPartSourcep->mPosAgent;
+			mDeadParts.push_back(part);
+			continue;
 		}
 
-		// Do color interpolation
-		if (part->mFlags & LLPartData::LL_PART_INTERP_COLOR_MASK)
+		F32 desired_size = calc_desired_size(camera_origin, part->mPosAgent, part->mScale);
+		if (!posInGroup(part->mPosAgent, desired_size))
 		{
-			part->mColor.setVec(part->mStartColor);
-			// note: LLColor4's v%k means multiply-alpha-only,
-			//       LLColor4's v*k means multiply-rgb-only
-			part->mColor *= 1.f - frac; // rgb*k
-			part->mColor %= 1.f - frac; // alpha*k
-			part->mColor += frac%(frac*part->mEndColor); // rgb,alpha
+			// Transfer particles between groups
+			mLeavingParts.push_back(part);
+			continue;
 		}
 
-		// Do scale interpolation
-		if (part->mFlags & LLPartData::LL_PART_INTERP_SCALE_MASK)
+		if (kept != i)
 		{
-			part->mScale.setVec(part->mStartScale);
-			part->mScale *= 1.f - frac;
-			part->mScale += frac*part->mEndScale;
+			for (S32 c = 0; c < NUM_CHANNELS; ++c)
+			{
+				mChannels[c][kept] = mChannels[c][i];
+			}
+			mFlags[kept] = mFlags[i];
+			mCallbacks[kept] = mCallbacks[i];
+			mParticles[kept] = part;
 		}
+		++kept;
+	}
 
-		// Do glow interpolation
-		part->mGlow.mV[3] = (U8) ll_round(lerp(part->mStartGlow, part->mEndGlow, frac)*255.f);
-
-		// Set the last update time to now.
-		part->mLastUpdateTime = cur_time;
-
-
-		// Kill dead particles (either flagged dead, or too old)
-		if ((part->mLastUpdateTime > part->mMaxAge) || (LLViewerPart::LL_PART_DEAD_MASK == part->mFlags))
-		{
-			vector_replace_with_last(mParticles, mParticles.begin() + i);
-			delete part ;
-		}
-		else 
+	if (kept != count)
+	{
+		for (S32 c = 0; c < NUM_CHANNELS; ++c)
 		{
-			F32 desired_size = calc_desired_size(camera, part->mPosAgent, part->mScale);
-			if (!posInGroup(part->mPosAgent, desired_size))
-			{
-				// Transfer particles between groups
-				LLViewerPartSim::getInstance()->put(part) ;
-				vector_replace_with_last(mParticles, mParticles.begin() + i);
-			}
-			else
-			{
-				i++ ;
-			}
+			mChannels[c].resize(kept);
 		}
+		mFlags.resize(kept);
+		mCallbacks.resize(kept);
+		mParticles.resize(kept);
 	}
+}
 
-	S32 removed = end - (S32)mParticles.size();
+void LLViewerPartGroup::finishUpdate(part_list_t& leaving)
+{
+	S32 removed = (S32)(mDeadParts.size() + mLeavingParts.size());
 	if (removed > 0)
 	{
 		// we removed one or more particles, so flag this group for update
@@ -435,15 +595,15 @@ void LLViewerPartGroup::updateParticles(const F32 lastdt)
 		}
 		LLViewerPartSim::decPartCount(removed);
 	}
-	
-	// Kill the viewer object if this particle group is empty
-	if (mParticles.empty())
+
+	for (part_list_t::iterator it = mDeadParts.begin(); it != mDeadParts.end(); ++it)
 	{
-		gObjectList.killObject(mVOPartGroupp);
-		mVOPartGroupp = NULL;
+		delete *it;
 	}
+	mDeadParts.clear();
 
-	LLViewerPartSim::checkParticleCount() ;
+	leaving.insert(leaving.end(), mLeavingParts.begin(), mLeavingParts.end());
+	mLeavingParts.clear();
 }
 
 
@@ -456,6 +616,9 @@ void LLViewerPartGroup::shift(const LLVector3 &offset)
 	for (S32 i = 0 ; i < (S32)mParticles.size(); i++)
 	{
 		mParticles[i]->mPosAgent += offset;
+		mChannels[POS_X][i] += offset.mV[VX];
+		mChannels[POS_Y][i] += offset.mV[VY];
+		mChannels[POS_Z][i] += offset.mV[VZ];
 	}
 }
 
@@ -466,6 +629,7 @@ void LLViewerPartGroup::removeParticlesByID(const U32 source_id)
 		if(mParticles[i]->mPartSourcep->getID() == source_id)
 		{
 			mParticles[i]->mFlags = LLViewerPart::LL_PART_DEAD_MASK;
+			mFlags[i] = LLViewerPart::LL_PART_DEAD_MASK;
 		}		
 	}
 }
@@ -732,6 +896,7 @@ void LLViewerPartSim::updateSimulation()
 		num_updates++;
 	}
 
+	group_list_t updating;
 	count = (S32) mViewerPartGroups.size();
 	for (i = 0; i < count; i++)
 	{
@@ -753,23 +918,53 @@ void LLViewerPartSim::updateSimulation()
 			{
 				gPipeline.markRebuild(vobj->mDrawable, LLDrawable::REBUILD_ALL, TRUE);
 			}
-			mViewerPartGroups[i]->updateParticles(dt * visirate);
-			mViewerPartGroups[i]->mSkippedTime=0.0f;
-			if (!mViewerPartGroups[i]->getCount())
-			{
-				delete mViewerPartGroups[i];
-				vector_replace_with_last(mViewerPartGroups, mViewerPartGroups.begin() + i);
-				//mViewerPartGroups.erase(it);
-				i--;
-				count--;
-			}
+			mViewerPartGroups[i]->prepareUpdate(dt * visirate);
+			updating.push_back(mViewerPartGroups[i]);
 		}
 		else
 		{	
 			mViewerPartGroups[i]->mSkippedTime+=dt;
 		}
+	}
+
+	// Groups only touch their own particles here
+	const LLVector3 camera_origin = LLViewerCamera::getInstance()->getOrigin();
+	LLJobPool::parallelFor((S32)updating.size(), 1, [&](S32 first, S32 last)
+		{
+			for (S32 j = first; j < last; ++j)
+			{
+				updating[j]->updateParticles(camera_origin);
+			}
+		});
+
+	LLViewerPartGroup::part_list_t leaving;
+	for (group_list_t::iterator it = updating.begin(); it != updating.end(); ++it)
+	{
+		(*it)->finishUpdate(leaving);
+		(*it)->mSkippedTime = 0.0f;
+	}
 
+	// Moved once every group is done, so that no particle is updated twice
+	for (LLViewerPartGroup::part_list_t::iterator it = leaving.begin(); it != leaving.end(); ++it)
+	{
+		put(*it);
 	}
+
+	count = (S32) mViewerPartGroups.size();
+	for (i = 0; i < count; i++)
+	{
+		if (!mViewerPartGroups[i]->getCount())
+		{
+			delete mViewerPartGroups[i];
+			vector_replace_with_last(mViewerPartGroups, mViewerPartGroups.begin() + i);
+			//mViewerPartGroups.erase(it);
+			i--;
+			count--;
+		}
+	}
+
+	checkParticleCount();
+
 	if (LLDrawable::getCurrentFrame()%16==0)
 	{
 		if (sParticleCount > sMaxParticleCount * 0.875f
@@ -103,17 +103,25 @@ public:
 	void cleanup();
 
 	BOOL addPart(LLViewerPart* part, const F32 desired_size = -1.f);
-	
-	void updateParticles(const F32 lastdt);
 
-	BOOL posInGroup(const LLVector3 &pos, const F32 desired_size = -1.f);
+	typedef std::vector<LLViewerPart*>  part_list_t;
+
+	// A frame's update runs in three steps.  prepareUpdate() does what
+	// reaches outside the group (sources, callbacks, wind) on the main
+	// thread, updateParticles() only touches the group and its own
+	// particles so groups can be updated in parallel, and finishUpdate()
+	// deletes the dead and hands back the particles that left the group.
+	void prepareUpdate(const F32 lastdt);
+	void updateParticles(const LLVector3& camera_origin);
+	void finishUpdate(part_list_t& leaving);
+
+	BOOL posInGroup(const LLVector3 &pos, const F32 desired_size = -1.f) const;
 
 	void shift(const LLVector3 &offset);
 
 	F32 getBoxRadius() { return mBoxRadius; }
 	F32 getBoxSide() { return mBoxSide; }
 
-	typedef std::vector<LLViewerPart*>  part_list_t;
 	part_list_t mParticles;
 
 	const LLVector3 &getCenterAgent() const		{ return mCenterAgent; }
@@ -131,6 +139,44 @@ public:
 	bool mHud;
 
 protected:
+	// Simulation state of the particles, one array per value and index
+	// aligned with mParticles, so the update runs down flat arrays instead
+	// of chasing each particle.  The results are copied to the particles
+	// for rendering and ribbons at the end of updateParticles().
+	enum
+	{
+		POS_X, POS_Y, POS_Z,
+		VEL_X, VEL_Y, VEL_Z,
+		ACCEL_X, ACCEL_Y, ACCEL_Z,
+		SOURCE_X, SOURCE_Y, SOURCE_Z,		// source position this update
+		TARGET_X, TARGET_Y, TARGET_Z,		// source target this update
+		DT,									// time step this update
+		SKIP_OFFSET,						// group skipped time when added
+		AGE,
+		MAX_AGE,
+		COLOR_R, COLOR_G, COLOR_B, COLOR_A,
+		START_COLOR_R, START_COLOR_G, START_COLOR_B, START_COLOR_A,
+		END_COLOR_R, END_COLOR_G, END_COLOR_B, END_COLOR_A,
+		SCALE_X, SCALE_Y,
+		START_SCALE_X, START_SCALE_Y,
+		END_SCALE_X, END_SCALE_Y,
+		START_GLOW,
+		END_GLOW,
+		NUM_CHANNELS
+	};
+
+	// Copies particle i into or out of the arrays
+	void loadPart(S32 i, const LLViewerPart* part);
+	void storePart(S32 i, LLViewerPart* part) const;
+
+	std::vector<F32> mChannels[NUM_CHANNELS];
+	std::vector<U32> mFlags;
+	std::vector<LLVPCallback> mCallbacks;
+
+	// Left by updateParticles() for finishUpdate()
+	part_list_t mDeadParts;
+	part_list_t mLeavingParts;
+
 	LLVector3 mCenterAgent;
 	F32 mBoxRadius;
 	F32 mBoxSide;
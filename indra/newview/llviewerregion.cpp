@@ -604,6 +604,13 @@ LLViewerRegion::LLViewerRegion(const U64 &handle,
 	// Create the object lists
 	initStats();
 	initPartitions();
+
+	// Start reading the object cache now, it is needed once the region handshake arrives.
+	if(LLVOCache::hasInstance())
+	{
+		LLVOCache::getInstance()->prefetchFromCache(mHandle);
+	}
+
 	// If the newly entered region is using server bakes, and our
 	// current appearance is non-baked, request appearance update from
 	// server.
@@ -734,6 +741,10 @@ void LLViewerRegion::saveObjectCache()
 {
 	if (!mCacheLoaded)
 	{
+		if(LLVOCache::hasInstance())
+		{
+			LLVOCache::getInstance()->cancelPrefetch(mHandle);
+		}
 		return;
 	}
 
@@ -1651,15 +1662,17 @@ LLDataPacker *LLViewerRegion::getDP(U32 local_id, U32 crc, U8 &cache_miss_type)
 		{
 			// Record a hit
 			entry->recordHit();
-		cache_miss_type = CACHE_MISS_TYPE_NONE;
-			return entry->getDP(crc);
+			LLDataPacker* dp = entry->getDP(crc);
+			if (dp)
+			{
+				cache_miss_type = CACHE_MISS_TYPE_NONE;
+				return dp;
+			}
+			// The payload could not be read back from the cache file, ask for the object again
 		}
-		else
-		{
-			// LL_INFOS() << "CRC miss for " << local_id << LL_ENDL;
+		// LL_INFOS() << "CRC miss for " << local_id << LL_ENDL;
 		cache_miss_type = CACHE_MISS_TYPE_CRC;
-			mCacheMissCRC.push_back(local_id);
-		}
+		mCacheMissCRC.push_back(local_id);
 	}
 	else
 	{
@@ -65,6 +65,7 @@
 #include "llsdserialize.h"
 #include "llcorehttputil.h"
 #include "sgmemstat.h"
+#include "llkeyframemotion.h"
 #include "llviewertexlayer.h"
 
 
@@ -213,6 +214,7 @@ LLViewerStats::LLViewerStats() :
 	mAssetKBitStat("assetkbitstat"),
 	mUDPTextureKBitStat("udptexturekbitstat"),
 	mMallocStat("mallocstat"),
+	mAnimationMemStat("animationmemstat"),
 	mVFSPendingOperations("vfspendingoperations"),
 	mObjectsDrawnStat("objectsdrawnstat"),
 	mObjectsCulledStat("objectsculledstat"),
@@ -682,6 +684,7 @@ void update_statistics()
 		if (mem_stats_timer.getElapsedTimeF32() >= mem_stats_freq)
 		{
 			stats.mMallocStat.addValue(SGMemStat::getMalloc()/1024.f/1024.f);
+			stats.mAnimationMemStat.addValue(LLKeyframeDataCache::getMemoryUsage()/1024.f);
 			mem_stats_timer.reset();
 		}
 	}
@@ -107,7 +107,8 @@ public:
 			mActualInKBitStat,	// From the packet ring (when faking a bad connection)
 			mActualOutKBitStat,	// From the packet ring (when faking a bad connection)
 			mTrianglesDrawnStat,
-			mMallocStat;
+			mMallocStat,
+			mAnimationMemStat;
 
 	// Simulator stats
 	LLStat	mSimTimeDilation,
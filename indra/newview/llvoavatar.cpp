@@ -114,6 +114,7 @@
 #include "llsdutil.h"
 
 #include "llskinningutil.h"
+#include "lljobpool.h"
 
 #include "llfloaterexploreanimations.h"
 
@@ -947,6 +948,8 @@ void SHClientTagMgr::clearAvatarTag(const LLVOAvatar* pAvatar)
 //-----------------------------------------------------------------------------
 LLAvatarAppearanceDictionary *LLVOAvatar::sAvatarDictionary = nullptr;
 S32 LLVOAvatar::sFreezeCounter = 0;
+bool LLVOAvatar::sDeferMotions = false;
+std::vector<LLPointer<LLVOAvatar> > LLVOAvatar::sDeferredMotionAvatars;
 U32 LLVOAvatar::sMaxVisible = 50;
 F32 LLVOAvatar::sRenderDistance = 256.f;
 S32	LLVOAvatar::sNumVisibleAvatars = 0;
@@ -1030,6 +1033,8 @@ LLVOAvatar::LLVOAvatar(const LLUUID& id,
 	mBelowWater(FALSE),
 	mWindFreq(0.f),
 	mCulled( FALSE ),
+	mMotionsDeferred(false),
+	mWasSitGroundConstrained(false),
 	mFirstTEMessageReceived( FALSE ),
 	mFirstAppearanceMessageReceived( FALSE ),
 	mMeshValid(FALSE),
@@ -2753,6 +2758,16 @@ void LLVOAvatar::idleUpdate(LLAgent &agent, LLWorld &world, const F64 &time)
 		detailed_update = updateCharacter(agent);
 	}
 
+	if (mMotionsDeferred)
+	{
+		// updateDeferredMotions() finishes up
+		return;
+	}
+	idleUpdateFinish(detailed_update);
+}
+
+void LLVOAvatar::idleUpdateFinish(bool detailed_update)
+{
 	static LLUICachedControl<bool> visualizers_in_calls("ShowVoiceVisualizersInCalls", false);
 	bool voice_enabled = (visualizers_in_calls || LLVoiceClient::getInstance()->inProximalChannel()) &&
 						 LLVoiceClient::getInstance()->getVoiceEnabled(mID);
@@ -4552,11 +4567,26 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 	{
 		updateMotions(LLCharacter::FORCE_UPDATE);
 	}
+	else if (sDeferMotions && !isSelf() && !mIsDummy && mSpecialRenderMode == 0)
+	{
+		// Motions that can run off thread are left for updateDeferredMotions()
+		updateMotions(LLCharacter::NORMAL_UPDATE, true);
+		mMotionsDeferred = true;
+		mWasSitGroundConstrained = was_sit_ground_constrained;
+		sDeferredMotionAvatars.push_back(this);
+		return TRUE;
+	}
 	else
 	{
 		updateMotions(LLCharacter::NORMAL_UPDATE);
 	}
 
+	finishCharacterUpdate(was_sit_ground_constrained);
+	return TRUE;
+}
+
+void LLVOAvatar::finishCharacterUpdate(bool was_sit_ground_constrained)
+{
 	// Special handling for sitting on ground.
 	if (!getParent() && (mIsSitting || was_sit_ground_constrained))
 	{
@@ -4584,6 +4614,7 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 
 	LLVector3 ankle_left_ground_agent = ankle_left_pos_agent;
 	LLVector3 ankle_right_ground_agent = ankle_right_pos_agent;
+	LLVector3 normal;
 	resolveHeightAgent(ankle_left_pos_agent, ankle_left_ground_agent, normal);
 	resolveHeightAgent(ankle_right_pos_agent, ankle_right_ground_agent, normal);
 
@@ -4657,7 +4688,6 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 
 	//mesh vertices need to be reskinned
 	mNeedsSkin = TRUE;
-	return TRUE;
 }
 //-----------------------------------------------------------------------------
 // updateHeadOffset()
@@ -9611,6 +9641,59 @@ LLHost LLVOAvatar::getObjectHost() const
 	}
 }
 
+//static
+void LLVOAvatar::beginDeferredMotions()
+{
+	// Nothing to gain without helper threads
+	sDeferMotions = LLJobPool::getInstance() != NULL;
+}
+
+//static
+void LLVOAvatar::updateDeferredMotions()
+{
+	sDeferMotions = false;
+	if (sDeferredMotionAvatars.empty())
+	{
+		return;
+	}
+
+	std::vector<LLPointer<LLVOAvatar> > avatars;
+	avatars.swap(sDeferredMotionAvatars);
+
+	{
+		LL_RECORD_BLOCK_TIME(FTM_CHARACTER_UPDATE);
+		// Each avatar only touches its own motions and skeleton
+		LLJobPool::parallelFor((S32)avatars.size(), 1, [&avatars](S32 first, S32 last)
+		{
+			for (S32 i = first; i < last; ++i)
+			{
+				LLVOAvatar* avatarp = avatars[i];
+				if (!avatarp->isDead())
+				{
+					avatarp->mMotionController.evaluateMotions();
+					avatarp->mRoot->updateWorldMatrixChildren();
+				}
+			}
+		});
+	}
+
+	for (std::vector<LLPointer<LLVOAvatar> >::iterator it = avatars.begin(); it != avatars.end(); ++it)
+	{
+		LLVOAvatar* avatarp = *it;
+		avatarp->mMotionsDeferred = false;
+		if (avatarp->isDead())
+		{
+			continue;
+		}
+		{
+			LL_RECORD_BLOCK_TIME(FTM_CHARACTER_UPDATE);
+			avatarp->mMotionController.finishMotions();
+			avatarp->finishCharacterUpdate(avatarp->mWasSitGroundConstrained);
+		}
+		avatarp->idleUpdateFinish(true);
+	}
+}
+
 //static
 void LLVOAvatar::updateFreezeCounter(S32 counter)
 {
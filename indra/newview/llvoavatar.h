@@ -552,6 +552,24 @@ public:
 private:
 	static S32  sFreezeCounter;
 
+	//--------------------------------------------------------------------
+	// Deferred motions
+	//--------------------------------------------------------------------
+public:
+	// In between, updateCharacter() leaves the motions of other avatars for
+	// updateDeferredMotions() to evaluate together on the job pool
+	static void beginDeferredMotions();
+	static void updateDeferredMotions();
+private:
+	// The parts of updateCharacter() and idleUpdate() after the motions
+	void		finishCharacterUpdate(bool was_sit_ground_constrained);
+	void		idleUpdateFinish(bool detailed_update);
+
+	bool		mMotionsDeferred;
+	bool		mWasSitGroundConstrained;
+	static bool	sDeferMotions;
+	static std::vector<LLPointer<LLVOAvatar> > sDeferredMotionAvatars;
+
 	//--------------------------------------------------------------------
 	// Constants
 	//--------------------------------------------------------------------
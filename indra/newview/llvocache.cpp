@@ -35,6 +35,12 @@
 #include "llerror.h"
 #include "llregionhandle.h"
 #include "llviewercontrol.h"
+#include "llcrc.h"
+#ifdef LL_STANDALONE
+#include <zlib.h>
+#else
+#include "zlib/zlib.h"
+#endif
 
 BOOL check_read(llifstream& infile, void* src, S32 n_bytes) 
 {
@@ -59,7 +65,8 @@ LLVOCacheEntry::LLVOCacheEntry(U32 local_id, U32 crc, LLDataPackerBinaryBuffer &
 	mCRC(crc),
 	mHitCount(0),
 	mDupeCount(0),
-	mCRCChangeCount(0)
+	mCRCChangeCount(0),
+	mFileRecord(0)
 {
 	mBuffer = new U8[dp.getBufferSize()];
 	mDP.assignBuffer(mBuffer, dp.getBufferSize());
@@ -73,78 +80,12 @@ LLVOCacheEntry::LLVOCacheEntry()
 	mHitCount(0),
 	mDupeCount(0),
 	mCRCChangeCount(0),
-	mBuffer(NULL)
+	mBuffer(NULL),
+	mFileRecord(0)
 {
 	mDP.assignBuffer(mBuffer, 0);
 }
 
-LLVOCacheEntry::LLVOCacheEntry(llifstream& infile)
-
-	: mBuffer(NULL)
-{
-	S32 size = -1;
-	BOOL success;
-
-	mDP.assignBuffer(mBuffer, 0);
-	
-	success = check_read(infile, &mLocalID, sizeof(U32));
-	if(success)
-	{
-		success = check_read(infile, &mCRC, sizeof(U32));
-	}
-	if(success)
-	{
-		success = check_read(infile, &mHitCount, sizeof(S32));
-	}
-	if(success)
-	{
-		success = check_read(infile, &mDupeCount, sizeof(S32));
-	}
-	if(success)
-	{
-		success = check_read(infile, &mCRCChangeCount, sizeof(S32));
-	}
-	if(success)
-	{
-		success = check_read(infile, &size, sizeof(S32));
-
-	// Corruption in the cache entries
-	if ((size > 10000) || (size < 1))
-	{
-		// We've got a bogus size, skip reading it.
-		// We won't bother seeking, because the rest of this file
-		// is likely bogus, and will be tossed anyway.
-			LL_WARNS() << "Bogus cache entry, size " << size << ", aborting!" << LL_ENDL;
-			success = FALSE;
-		}
-	}
-	if(success && size > 0)
-	{
-		mBuffer = new U8[size];
-		success = check_read(infile, mBuffer, size);
-
-		if(success)
-		{
-			mDP.assignBuffer(mBuffer, size);
-		}
-		else
-		{
-			delete[] mBuffer ;
-			mBuffer = NULL ;
-		}
-	}
-
-	if(!success)
-	{
-		mLocalID = 0;
-		mCRC = 0;
-		mHitCount = 0;
-		mDupeCount = 0;
-		mCRCChangeCount = 0;
-		mBuffer = NULL;
-	}
-}
-
 LLVOCacheEntry::~LLVOCacheEntry()
 {
 	mDP.freeBuffer();
@@ -161,6 +102,7 @@ void LLVOCacheEntry::assignCRC(U32 crc, LLDataPackerBinaryBuffer &dp)
 		mHitCount = 0;
 		mCRCChangeCount++;
 
+		mFile.reset();
 		mDP.freeBuffer();
 		mBuffer = new U8[dp.getBufferSize()];
 		mDP.assignBuffer(mBuffer, dp.getBufferSize());
@@ -171,7 +113,7 @@ void LLVOCacheEntry::assignCRC(U32 crc, LLDataPackerBinaryBuffer &dp)
 LLDataPackerBinaryBuffer *LLVOCacheEntry::getDP(U32 crc)
 {
 	if (  (mCRC != crc)
-		||(mDP.getBufferSize() == 0))
+		||!loadData())
 	{
 		//LL_INFOS() << "Not getting cache entry, invalid!" << LL_ENDL;
 		return NULL;
@@ -181,6 +123,28 @@ LLDataPackerBinaryBuffer *LLVOCacheEntry::getDP(U32 crc)
 }
 
 
+BOOL LLVOCacheEntry::loadData()
+{
+	if (mFile)
+	{
+		const LLVOCacheFile::IndexRecord& record = mFile->getRecord(mFileRecord);
+		U8* buffer = new U8[record.mSize];
+		if (mFile->readPayload(record, buffer))
+		{
+			mDP.freeBuffer();
+			mBuffer = buffer;
+			mDP.assignBuffer(mBuffer, record.mSize);
+		}
+		else
+		{
+			delete[] buffer;
+		}
+		// Don't keep the file mapped for entries we gave up on either
+		mFile.reset();
+	}
+	return mDP.getBufferSize() != 0;
+}
+
 void LLVOCacheEntry::recordHit()
 {
 	mHitCount++;
@@ -197,38 +161,308 @@ void LLVOCacheEntry::dump() const
 		<< LL_ENDL;
 }
 
-BOOL LLVOCacheEntry::writeToFile(llofstream& outfile) const
+//-------------------------------------------------------------------
+// LLVOCacheFile
+//-------------------------------------------------------------------
+
+static const U32 VOCACHE_FILE_MAGIC = 0x43564c53; // "SLVC"
+static const U32 VOCACHE_FILE_VERSION = 2;
+// Inflated payload bytes per block, larger blocks compress better but
+// cost more to inflate for a single object.
+static const U32 VOCACHE_BLOCK_SIZE = 32 * 1024;
+static const U32 VOCACHE_MAX_INFLATED_BLOCKS = 4;
+// Same bound the old format applied to a single data packer
+static const U32 VOCACHE_MAX_ENTRY_SIZE = 10000;
+
+struct LLVOCacheFileHeader
+{
+	U32 mMagic;
+	U32 mVersion;
+	U8	mCacheID[UUID_BYTES];
+	U32 mNumEntries;
+	U32 mNumBlocks;
+	U32 mIndexCRC;	// of the block table and the index
+	U32 mHeaderCRC;	// of everything above
+};
+static_assert(sizeof(LLVOCacheFileHeader) == 40, "LLVOCacheFileHeader must stay packed");
+
+static U32 vocache_crc(const void* data, size_t length)
+{
+	LLCRC crc;
+	crc.update((const U8*)data, length);
+	return crc.getCRC();
+}
+
+LLVOCacheFile::LLVOCacheFile()
+	: mData(NULL),
+	  mSize(0),
+	  mNumEntries(0),
+	  mNumBlocks(0),
+	  mBlocks(NULL),
+	  mRecords(NULL)
+{
+}
+
+LLVOCacheFile::~LLVOCacheFile()
 {
-	BOOL success;
-	success = check_write(outfile, (void*)&mLocalID, sizeof(U32));
-	if(success)
+	mMappedFile.close();
+}
+
+bool LLVOCacheFile::open(const std::string& filename)
+{
+	if (mMappedFile.open(filename, false))
 	{
-		success = check_write(outfile, (void*)&mCRC, sizeof(U32));
+		mData = mMappedFile.getData();
+		mSize = mMappedFile.getSize();
 	}
-	if(success)
+	else
 	{
-		success = check_write(outfile, (void*)&mHitCount, sizeof(S32));
+		// Mapping can fail for reasons that don't stop a plain read
+		llifstream infile(filename, std::ios::in | std::ios::binary);
+		if (!infile.is_open())
+		{
+			return false;
+		}
+		infile.seekg(0, std::ios::end);
+		S64 size = infile.tellg();
+		infile.seekg(0, std::ios::beg);
+		if (size <= 0)
+		{
+			return false;
+		}
+		mFileData.resize(size);
+		if (!check_read(infile, &mFileData[0], size))
+		{
+			return false;
+		}
+		mData = &mFileData[0];
+		mSize = size;
 	}
-	if(success)
+
+	if (mSize < (S64)sizeof(LLVOCacheFileHeader))
 	{
-		success = check_write(outfile, (void*)&mDupeCount, sizeof(S32));
+		return false;
 	}
-	if(success)
+	const LLVOCacheFileHeader* header = (const LLVOCacheFileHeader*)mData;
+	if (header->mMagic != VOCACHE_FILE_MAGIC
+		|| header->mVersion != VOCACHE_FILE_VERSION
+		|| header->mHeaderCRC != vocache_crc(header, offsetof(LLVOCacheFileHeader, mHeaderCRC)))
 	{
-		success = check_write(outfile, (void*)&mCRCChangeCount, sizeof(S32));
+		return false;
 	}
-	if(success)
+
+	S64 index_size = (S64)header->mNumBlocks * sizeof(BlockInfo) + (S64)header->mNumEntries * sizeof(IndexRecord);
+	if ((S64)sizeof(LLVOCacheFileHeader) + index_size > mSize)
 	{
-		S32 size = mDP.getBufferSize();
-		success = check_write(outfile, (void*)&size, sizeof(S32));
-	
-		if(success)
+		return false;
+	}
+	const U8* index = mData + sizeof(LLVOCacheFileHeader);
+	if (header->mIndexCRC != vocache_crc(index, index_size))
+	{
+		return false;
+	}
+
+	memcpy(mCacheID.mData, header->mCacheID, UUID_BYTES);
+	mNumEntries = header->mNumEntries;
+	mNumBlocks = header->mNumBlocks;
+	mBlocks = (const BlockInfo*)index;
+	mRecords = (const IndexRecord*)(index + mNumBlocks * sizeof(BlockInfo));
+
+	for (U32 i = 0; i < mNumBlocks; ++i)
+	{
+		const BlockInfo& block = mBlocks[i];
+		if ((S64)block.mOffset + block.mCompressedSize > mSize || block.mSize > VOCACHE_BLOCK_SIZE + VOCACHE_MAX_ENTRY_SIZE)
+		{
+			return false;
+		}
+	}
+	for (U32 i = 0; i < mNumEntries; ++i)
+	{
+		const IndexRecord& record = mRecords[i];
+		if (record.mBlock >= mNumBlocks
+			|| record.mSize < 1 || record.mSize > VOCACHE_MAX_ENTRY_SIZE
+			|| record.mOffset + record.mSize > mBlocks[record.mBlock].mSize)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+const U8* LLVOCacheFile::inflateBlock(U32 index)
+{
+	for (std::deque<InflatedBlock>::iterator iter = mInflated.begin(); iter != mInflated.end(); ++iter)
+	{
+		if (iter->mBlock == index)
 		{
-			success = check_write(outfile, (void*)mBuffer, size);
+			std::rotate(mInflated.begin(), iter, iter + 1);
+			return &mInflated.front().mData[0];
 		}
 	}
 
-	return success ;
+	const BlockInfo& info = mBlocks[index];
+	const U8* compressed = mData + info.mOffset;
+	if (info.mCRC != vocache_crc(compressed, info.mCompressedSize))
+	{
+		LL_WARNS() << "Object cache block " << index << " is corrupt" << LL_ENDL;
+		return NULL;
+	}
+
+	std::vector<U8> data(info.mSize);
+	uLongf size = info.mSize;
+	if (uncompress(&data[0], &size, compressed, info.mCompressedSize) != Z_OK || size != info.mSize)
+	{
+		LL_WARNS() << "Failed to inflate object cache block " << index << LL_ENDL;
+		return NULL;
+	}
+
+	if (mInflated.size() >= VOCACHE_MAX_INFLATED_BLOCKS)
+	{
+		mInflated.pop_back();
+	}
+	mInflated.push_front(InflatedBlock());
+	mInflated.front().mBlock = index;
+	mInflated.front().mData.swap(data);
+	return &mInflated.front().mData[0];
+}
+
+bool LLVOCacheFile::readPayload(const IndexRecord& record, U8* buffer)
+{
+	const U8* block = inflateBlock(record.mBlock);
+	if (!block)
+	{
+		return false;
+	}
+	memcpy(buffer, block + record.mOffset, record.mSize);
+	return true;
+}
+
+//static
+void LLVOCacheFile::createEntries(const std::shared_ptr<LLVOCacheFile>& file, LLVOCacheEntry::vocache_entry_map_t& entries)
+{
+	for (U32 i = 0; i < file->mNumEntries; ++i)
+	{
+		const IndexRecord& record = file->mRecords[i];
+		LLVOCacheEntry* entry = new LLVOCacheEntry();
+		entry->mLocalID = record.mLocalID;
+		entry->mCRC = record.mCRC;
+		entry->mHitCount = record.mHitCount;
+		entry->mDupeCount = record.mDupeCount;
+		entry->mCRCChangeCount = record.mCRCChangeCount;
+		entry->mFile = file;
+		entry->mFileRecord = i;
+
+		LLVOCacheEntry*& slot = entries[record.mLocalID];
+		delete slot;
+		slot = entry;
+	}
+}
+
+//static
+bool LLVOCacheFile::write(const std::string& filename, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& entries)
+{
+	std::vector<IndexRecord> records;
+	records.reserve(entries.size());
+	std::vector<BlockInfo> blocks;
+	std::vector<U8> block_data;	// compressed blocks, back to back
+	std::vector<U8> raw;
+	raw.reserve(VOCACHE_BLOCK_SIZE + VOCACHE_MAX_ENTRY_SIZE);
+
+	LLVOCacheEntry::vocache_entry_map_t::iterator iter = entries.begin();
+	while (true)
+	{
+		bool done = iter == entries.end();
+		if (!done)
+		{
+			LLVOCacheEntry* entry = iter->second;
+			++iter;
+			// Entries that can't be read back from the old file are simply dropped
+			if (!entry->loadData() || (U32)entry->getBufferSize() > VOCACHE_MAX_ENTRY_SIZE)
+			{
+				continue;
+			}
+
+			IndexRecord record;
+			record.mLocalID = entry->getLocalID();
+			record.mCRC = entry->getCRC();
+			record.mHitCount = entry->mHitCount;
+			record.mDupeCount = entry->mDupeCount;
+			record.mCRCChangeCount = entry->mCRCChangeCount;
+			record.mBlock = blocks.size();
+			record.mOffset = raw.size();
+			record.mSize = entry->getBufferSize();
+			records.push_back(record);
+			raw.insert(raw.end(), entry->getBuffer(), entry->getBuffer() + record.mSize);
+		}
+
+		if (raw.size() >= VOCACHE_BLOCK_SIZE || (done && !raw.empty()))
+		{
+			uLongf compressed_size = compressBound(raw.size());
+			size_t offset = block_data.size();
+			block_data.resize(offset + compressed_size);
+			if (compress2(&block_data[offset], &compressed_size, &raw[0], raw.size(), Z_DEFAULT_COMPRESSION) != Z_OK)
+			{
+				LL_WARNS() << "Failed to compress object cache block for " << filename << LL_ENDL;
+				return false;
+			}
+			block_data.resize(offset + compressed_size);
+
+			BlockInfo block;
+			block.mOffset = offset;	// relative for now
+			block.mCompressedSize = compressed_size;
+			block.mSize = raw.size();
+			block.mCRC = vocache_crc(&block_data[offset], compressed_size);
+			blocks.push_back(block);
+			raw.clear();
+		}
+
+		if (done)
+		{
+			break;
+		}
+	}
+
+	U32 data_offset = sizeof(LLVOCacheFileHeader) + blocks.size() * sizeof(BlockInfo) + records.size() * sizeof(IndexRecord);
+	for (std::vector<BlockInfo>::iterator block = blocks.begin(); block != blocks.end(); ++block)
+	{
+		block->mOffset += data_offset;
+	}
+
+	LLCRC index_crc;
+	if (!blocks.empty())
+	{
+		index_crc.update((const U8*)&blocks[0], blocks.size() * sizeof(BlockInfo));
+	}
+	if (!records.empty())
+	{
+		index_crc.update((const U8*)&records[0], records.size() * sizeof(IndexRecord));
+	}
+
+	LLVOCacheFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.mMagic = VOCACHE_FILE_MAGIC;
+	header.mVersion = VOCACHE_FILE_VERSION;
+	memcpy(header.mCacheID, id.mData, UUID_BYTES);
+	header.mNumEntries = records.size();
+	header.mNumBlocks = blocks.size();
+	header.mIndexCRC = index_crc.getCRC();
+	header.mHeaderCRC = vocache_crc(&header, offsetof(LLVOCacheFileHeader, mHeaderCRC));
+
+	llofstream outfile(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+	bool success = check_write(outfile, &header, sizeof(header));
+	if (success && !blocks.empty())
+	{
+		success = check_write(outfile, &blocks[0], blocks.size() * sizeof(BlockInfo));
+	}
+	if (success && !records.empty())
+	{
+		success = check_write(outfile, &records[0], records.size() * sizeof(IndexRecord));
+	}
+	if (success && !block_data.empty())
+	{
+		success = check_write(outfile, &block_data[0], block_data.size());
+	}
+	return success;
 }
 
 //-------------------------------------------------------------------
@@ -275,13 +509,22 @@ LLVOCache::LLVOCache():
 	mInitialized(FALSE),
 	mReadOnly(TRUE),
 	mNumEntries(0),
-	mCacheSize(1)
+	mCacheSize(1),
+	mPendingJobs(0)
 {
 	mEnabled = gSavedSettings.getBOOL("ObjectCacheEnabled");
 }
 
 LLVOCache::~LLVOCache()
 {
+	// Let queued region writes reach the disk before the header does
+	waitForAllJobs();
+	if (mIOThread)
+	{
+		mIOThread->shutdown();
+		mIOThread.reset();
+	}
+
 	if(mEnabled)
 	{
 		writeCacheHeader();
@@ -310,6 +553,12 @@ void LLVOCache::initCache(ELLPath location, U32 size, U32 cache_version)
 	}
 	mInitialized = TRUE ;
 
+	if (!mIOThread)
+	{
+		mIOThread.reset(new IOThread(this));
+		mIOThread->start();
+	}
+
 	setDirNames(location);
 	if (!mReadOnly)
 	{
@@ -346,6 +595,7 @@ void LLVOCache::removeCache(ELLPath location)
 	std::string mask = "*";
 	std::string cache_dir = gDirUtilp->getExpandedFilename(location, object_cache_dirname);
 	LL_INFOS() << "Removing cache at " << cache_dir << LL_ENDL;
+	waitForAllJobs();
 	gDirUtilp->deleteFilesInDir(cache_dir, mask); //delete all files
 	LLFile::rmdir(cache_dir);
 
@@ -364,6 +614,7 @@ void LLVOCache::removeCache()
 
 	std::string mask = "*";
 	LL_INFOS() << "Removing object cache at " << mObjectCacheDirName << LL_ENDL;
+	waitForAllJobs();
 	gDirUtilp->deleteFilesInDir(mObjectCacheDirName, mask); 
 
 	clearCacheInMemory() ;
@@ -407,6 +658,7 @@ void LLVOCache::removeEntry(U64 handle)
 
 void LLVOCache::clearCacheInMemory()
 {
+	mPrefetches.clear();
 	if(!mHeaderEntryQueue.empty()) 
 	{
 		for(header_entry_queue_t::iterator iter = mHeaderEntryQueue.begin(); iter != mHeaderEntryQueue.end(); ++iter)
@@ -439,9 +691,8 @@ void LLVOCache::removeFromCache(HeaderEntryInfo* entry)
 		return ;
 	}
 
-	std::string filename;
-	getObjectCacheFilename(entry->mHandle, filename);
-	LLFile::remove(filename);
+	// Queued behind any pending write of the same file
+	queueJob(IOJob::REMOVE, entry->mHandle);
 	entry->mTime = INVALID_TIME ;
 	updateEntry(entry) ; //update the head file.
 }
@@ -595,6 +846,25 @@ BOOL LLVOCache::updateEntry(const HeaderEntryInfo* entry)
 	return check_write(outfile, (void*)entry, sizeof(HeaderEntryInfo)) ;
 }
 
+void LLVOCache::prefetchFromCache(U64 handle)
+{
+	if(!mEnabled || !mInitialized)
+	{
+		return ;
+	}
+	if(mHandleEntryMap.find(handle) == mHandleEntryMap.end() || mPrefetches.find(handle) != mPrefetches.end())
+	{
+		return ;
+	}
+	mPrefetches[handle] = queueJob(IOJob::READ, handle);
+}
+
+void LLVOCache::cancelPrefetch(U64 handle)
+{
+	// The job still runs, its result is simply dropped with the last reference
+	mPrefetches.erase(handle);
+}
+
 void LLVOCache::readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map) 
 {
 	if(!mEnabled)
@@ -604,6 +874,14 @@ void LLVOCache::readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::voca
 	}
 	llassert_always(mInitialized);
 
+	job_ptr_t job;
+	std::map<U64, job_ptr_t>::iterator prefetch = mPrefetches.find(handle);
+	if (prefetch != mPrefetches.end())
+	{
+		job = prefetch->second;
+		mPrefetches.erase(prefetch);
+	}
+
 	handle_entry_map_t::iterator iter = mHandleEntryMap.find(handle) ;
 	if(iter == mHandleEntryMap.end()) //no cache
 	{
@@ -611,45 +889,27 @@ void LLVOCache::readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::voca
 		return ;
 	}
 
-	bool success = true ;
+	if (!job)
 	{
-		std::string filename;
-		getObjectCacheFilename(handle, filename);
-		llifstream infile(filename, std::ios::in | std::ios::binary);
-	
-		LLUUID cache_id ;
-		success = check_read(infile, cache_id.mData, UUID_BYTES) ;
-	
-		if(success)
-		{		
-			if(cache_id != id)
-			{
-				LL_INFOS() << "Cache ID doesn't match for this region, discarding"<< LL_ENDL;
-				success = false ;
-			}
+		job = queueJob(IOJob::READ, handle);
+	}
+	// Normally long done by the time the region handshake asks for it
+	waitForJob(job);
 
-			if(success)
-			{
-				S32 num_entries;
-				success = check_read(infile, &num_entries, sizeof(S32)) ;
-	
-				if(success)
-				{
-					for (S32 i = 0; i < num_entries; i++)
-					{
-						LLVOCacheEntry* entry = new LLVOCacheEntry(infile);
-						if (!entry->getLocalID())
-						{
-							LL_WARNS() << "Aborting cache file load for " << filename << ", cache file corruption!" << LL_ENDL;
-							delete entry ;
-							success = false ;
-							break ;
-						}
-						cache_entry_map[entry->getLocalID()] = entry;
-					}
-				}
-			}
-		}		
+	bool success = job->mSuccess ;
+	if (job->mCacheID.notNull() && job->mCacheID != id)
+	{
+		LL_INFOS() << "Cache ID doesn't match for this region, discarding"<< LL_ENDL;
+		success = false ;
+	}
+	else
+	{
+		// Keep whatever was read before any corruption, like we always did
+		for (LLVOCacheEntry::vocache_entry_map_t::iterator it = job->mEntries.begin(); it != job->mEntries.end(); ++it)
+		{
+			cache_entry_map[it->first] = it->second;
+		}
+		job->mEntries.clear();
 	}
 	
 	if(!success)
@@ -677,7 +937,7 @@ void LLVOCache::purgeEntries(U32 size)
 	mNumEntries = mHandleEntryMap.size() ;
 }
 
-void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, BOOL dirty_cache, bool removal_enabled) 
+void LLVOCache::writeToCache(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, BOOL dirty_cache, bool removal_enabled) 
 {
 	if(!mEnabled)
 	{
@@ -733,38 +993,183 @@ void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry:
 		return ; //nothing changed, no need to update.
 	}
 
-	//write to cache file
-	bool success = true ;
+	//write to cache file, the IO thread owns the entries from here on
+	cancelPrefetch(handle);
+	queueJob(IOJob::WRITE, handle, id, &cache_entry_map);
+
+	return ;
+}
+
+//-------------------------------------------------------------------
+//Region cache file IO
+//-------------------------------------------------------------------
+
+LLVOCache::IOJob::~IOJob()
+{
+	for (LLVOCacheEntry::vocache_entry_map_t::iterator iter = mEntries.begin(); iter != mEntries.end(); ++iter)
 	{
-		std::string filename;
-		getObjectCacheFilename(handle, filename);
-		std::ios::openmode flags = std::ios::out | std::ios::binary;
-		if (LLFile::isfile(mHeaderFileName))
+		delete iter->second;
+	}
+}
+
+LLVOCache::IOThread::IOThread(LLVOCache* cache)
+	: LLThread("VOCache IO"),
+	  mCache(cache)
+{
+}
+
+// virtual
+bool LLVOCache::IOThread::runCondition()
+{
+	// mDataLock must be locked here
+	return mCache->mPendingJobs > 0;
+}
+
+// virtual
+void LLVOCache::IOThread::run()
+{
+	while (true)
+	{
+		checkPause();
+
+		if (isQuitting())
 		{
-			flags |= std::ios::in;
+			break;
 		}
-		llofstream outfile(filename, flags);
 
-		success = check_write(outfile, (void*)id.mData, UUID_BYTES) ;
+		mCache->processJobs();
+	}
+	LL_INFOS() << "VOCache IO thread EXITING." << LL_ENDL;
+}
 
-		if(success)
+// MAIN THREAD
+LLVOCache::job_ptr_t LLVOCache::queueJob(IOJob::EType type, U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t* entries)
+{
+	job_ptr_t job = std::make_shared<IOJob>(type, handle);
+	getObjectCacheFilename(handle, job->mFilename);
+	job->mCacheID = id;
+	if (entries)
+	{
+		job->mEntries.swap(*entries);
+	}
+
+	if (!mIOThread)
+	{
+		// Not initialized yet (or shutting down), do it right here
+		doJob(*job);
+		job->mDone = true;
+		return job;
+	}
+
+	mJobCondition.lock();
+	mJobQueue.push_back(job);
+	++mPendingJobs;
+	mJobCondition.unlock();
+
+	// Must not hold mJobCondition here, runCondition() is evaluated under the thread's own lock
+	mIOThread->wake();
+	return job;
+}
+
+// MAIN THREAD
+void LLVOCache::waitForJob(const job_ptr_t& job)
+{
+	mJobCondition.lock();
+	while (!job->mDone)
+	{
+		mJobCondition.wait();
+	}
+	mJobCondition.unlock();
+}
+
+// MAIN THREAD
+void LLVOCache::waitForAllJobs()
+{
+	mJobCondition.lock();
+	while (mPendingJobs > 0)
+	{
+		mJobCondition.wait();
+	}
+	mJobCondition.unlock();
+}
+
+// IO THREAD
+void LLVOCache::processJobs()
+{
+	while (true)
+	{
+		job_ptr_t job;
+		mJobCondition.lock();
+		if (!mJobQueue.empty())
 		{
-			S32 num_entries = cache_entry_map.size() ;
-			success = check_write(outfile, &num_entries, sizeof(S32));
-	
-			for (LLVOCacheEntry::vocache_entry_map_t::const_iterator iter = cache_entry_map.begin(); success && iter != cache_entry_map.end(); ++iter)
-			{
-				success = iter->second->writeToFile(outfile) ;
-			}
+			job = mJobQueue.front();
+			mJobQueue.pop_front();
+		}
+		mJobCondition.unlock();
+
+		if (!job)
+		{
+			break;
 		}
+
+		doJob(*job);
+
+		mJobCondition.lock();
+		job->mDone = true;
+		--mPendingJobs;
+		mJobCondition.broadcast();
+		mJobCondition.unlock();
 	}
+}
 
-	if(!success)
+// IO THREAD (or main thread before the IO thread exists)
+//static
+void LLVOCache::doJob(IOJob& job)
+{
+	if (job.mType == IOJob::REMOVE)
 	{
-		removeEntry(entry) ;
+		LLFile::remove(job.mFilename);
+		job.mSuccess = true;
+		return;
+	}
 
+	if (job.mType == IOJob::READ)
+	{
+		std::shared_ptr<LLVOCacheFile> file = std::make_shared<LLVOCacheFile>();
+		if (!file->open(job.mFilename))
+		{
+			LL_WARNS() << "Discarding unreadable object cache file " << job.mFilename << LL_ENDL;
+			job.mSuccess = false;
+			return;
+		}
+		// The region id is checked by readFromCache(), we may not know it yet
+		job.mCacheID = file->getCacheID();
+		LLVOCacheFile::createEntries(file, job.mEntries);
+		job.mSuccess = true;
+		return;
 	}
 
-	return ;
+	// Write next to the old file, which may still be mapped by the entries
+	// being written, and only replace it once they have let go of it.
+	std::string temp_filename = job.mFilename + ".tmp";
+	bool success = LLVOCacheFile::write(temp_filename, job.mCacheID, job.mEntries);
+	for (LLVOCacheEntry::vocache_entry_map_t::iterator iter = job.mEntries.begin(); iter != job.mEntries.end(); ++iter)
+	{
+		delete iter->second;
+	}
+	job.mEntries.clear();
+
+	LLFile::remove(job.mFilename, ENOENT);
+	if (success)
+	{
+		success = LLFile::rename(temp_filename, job.mFilename) == 0;
+	}
+	if(!success)
+	{
+		// The header still lists the region, the next read will fail and drop it.
+		LL_WARNS() << "Failed to write object cache file " << job.mFilename << LL_ENDL;
+		LLFile::remove(temp_filename, ENOENT);
+	}
+	job.mSuccess = success;
 }
 
@@ -33,20 +33,27 @@
 #ifndef LL_LLVOCACHE_H
 #define LL_LLVOCACHE_H
 
+#include <deque>
+#include <memory>
+#include <vector>
+
 #include "lluuid.h"
 #include "lldatapacker.h"
 #include "lldir.h"
+#include "llatomic.h"
+#include "llmappedfile.h"
+#include "llthread.h"
 
 
 //---------------------------------------------------------------------------
 // Cache entries
 class LLVOCacheEntry;
+class LLVOCacheFile;
 
 class LLVOCacheEntry
 {
 public:
 	LLVOCacheEntry(U32 local_id, U32 crc, LLDataPackerBinaryBuffer &dp);
-	LLVOCacheEntry(llifstream& infile);
 	LLVOCacheEntry();
 	~LLVOCacheEntry();
 
@@ -56,16 +63,23 @@ public:
 	S32 getCRCChangeCount() const	{ return mCRCChangeCount; }
 
 	void dump() const;
-	BOOL writeToFile(llofstream& outfile) const;
 	void assignCRC(U32 crc, LLDataPackerBinaryBuffer &dp);
 	LLDataPackerBinaryBuffer *getDP(U32 crc);
 	void recordHit();
 	void recordDupe() { mDupeCount++; }
 
+	// Pulls the data packer payload out of the cache file this entry was
+	// read from, if that did not happen yet.
+	BOOL loadData();
+	const U8* getBuffer() const		{ return mBuffer; }
+	S32 getBufferSize() const		{ return mDP.getBufferSize(); }
+
 public:
 	typedef std::map<U32, LLVOCacheEntry*>	vocache_entry_map_t;
 
 protected:
+	friend class LLVOCacheFile;
+
 	U32							mLocalID;
 	U32							mCRC;
 	S32							mHitCount;
@@ -73,10 +87,89 @@ protected:
 	S32							mCRCChangeCount;
 	LLDataPackerBinaryBuffer	mDP;
 	U8							*mBuffer;
+
+	// Where the payload lives until loadData() is called
+	std::shared_ptr<LLVOCacheFile> mFile;
+	U32							mFileRecord;
+};
+
+//---------------------------------------------------------------------------
+// Region cache file
+//
+// FileHeader, BlockInfo[num_blocks] and IndexRecord[num_entries] (sorted by
+// local id) followed by the zlib compressed blocks.  Every block holds the
+// payloads of a run of consecutive index records.  The file is mapped and
+// a block is only inflated once one of its entries is used, so a region
+// costs an index record per object until the sim actually asks for it.
+//
+// Only one thread at a time may use an instance.
+class LLVOCacheFile
+{
+public:
+	struct IndexRecord
+	{
+		U32 mLocalID;
+		U32 mCRC;
+		S32 mHitCount;
+		S32 mDupeCount;
+		S32 mCRCChangeCount;
+		U32 mBlock;
+		U32 mOffset;	// within the inflated block
+		U32 mSize;
+	};
+
+	LLVOCacheFile();
+	~LLVOCacheFile();
+
+	// Maps filename and validates its header and index.
+	bool open(const std::string& filename);
+
+	const LLUUID& getCacheID() const	{ return mCacheID; }
+	U32 getNumEntries() const			{ return mNumEntries; }
+	const IndexRecord& getRecord(U32 index) const { return mRecords[index]; }
+
+	// Copies record.mSize bytes of payload into buffer.
+	bool readPayload(const IndexRecord& record, U8* buffer);
+
+	// Builds lazy entries for the whole file.
+	static void createEntries(const std::shared_ptr<LLVOCacheFile>& file, LLVOCacheEntry::vocache_entry_map_t& entries);
+	static bool write(const std::string& filename, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& entries);
+
+private:
+	struct BlockInfo
+	{
+		U32 mOffset;
+		U32 mCompressedSize;
+		U32 mSize;
+		U32 mCRC;		// of the compressed data
+	};
+
+	struct InflatedBlock
+	{
+		U32 mBlock;
+		std::vector<U8> mData;
+	};
+
+	const U8* inflateBlock(U32 block);
+
+private:
+	LLMappedFile				mMappedFile;
+	std::vector<U8>				mFileData;	// when the file could not be mapped
+	const U8*					mData;
+	S64							mSize;
+
+	LLUUID						mCacheID;
+	U32							mNumEntries;
+	U32							mNumBlocks;
+	const BlockInfo*			mBlocks;
+	const IndexRecord*			mRecords;
+
+	std::deque<InflatedBlock>	mInflated;	// most recently used first
 };
 
 //
-//Note: LLVOCache is not thread-safe
+//Note: LLVOCache is not thread-safe, only use it from the main thread.
+//The region cache files themselves are read and written on its IO thread.
 //
 class LLVOCache
 {
@@ -110,6 +203,38 @@ private:
 	};
 	typedef std::set<HeaderEntryInfo*, header_entry_less> header_entry_queue_t;
 	typedef std::map<U64, HeaderEntryInfo*> handle_entry_map_t;
+
+	// One region cache file operation.  Jobs run strictly in the order
+	// they were queued, so a read always sees the preceding write.
+	struct IOJob
+	{
+		enum EType { READ, WRITE, REMOVE };
+
+		IOJob(EType type, U64 handle) : mType(type), mHandle(handle), mSuccess(false), mDone(false) {}
+		~IOJob();
+
+		EType mType;
+		U64 mHandle;
+		std::string mFilename;
+		LLUUID mCacheID;	// READ: id found in the file, WRITE: id to store
+		LLVOCacheEntry::vocache_entry_map_t mEntries;	// owned by the job
+		bool mSuccess;
+		bool mDone;			// guarded by mJobCondition
+	};
+	typedef std::shared_ptr<IOJob> job_ptr_t;
+
+	class IOThread : public LLThread
+	{
+	public:
+		IOThread(LLVOCache* cache);
+
+	protected:
+		bool runCondition() override;
+		void run() override;
+
+	private:
+		LLVOCache* mCache;
+	};
 private:
 	LLVOCache() ;
 
@@ -119,8 +244,14 @@ public:
 	void initCache(ELLPath location, U32 size, U32 cache_version) ;
 	void removeCache(ELLPath location) ;
 
+	// Starts reading and decoding a region cache file in the background,
+	// readFromCache() then only has to pick up the result.
+	void prefetchFromCache(U64 handle);
+	void cancelPrefetch(U64 handle);
 	void readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map) ;
-	void writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, BOOL dirty_cache, bool removal_enabled);
+	// Takes ownership of the entries when the cache needs writing and
+	// leaves cache_entry_map empty; anything left behind is the caller's.
+	void writeToCache(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, BOOL dirty_cache, bool removal_enabled);
 	void removeEntry(U64 handle) ;
 
 	void setReadOnly(bool read_only) {mReadOnly = read_only;} 
@@ -137,6 +268,12 @@ private:
 	void removeEntry(HeaderEntryInfo* entry) ;
 	void purgeEntries(U32 size);
 	BOOL updateEntry(const HeaderEntryInfo* entry);
+
+	job_ptr_t queueJob(IOJob::EType type, U64 handle, const LLUUID& id = LLUUID::null, LLVOCacheEntry::vocache_entry_map_t* entries = nullptr);
+	void waitForJob(const job_ptr_t& job);
+	void waitForAllJobs();
+	void processJobs();
+	static void doJob(IOJob& job);
 	
 private:
 	bool                 mEnabled;
@@ -150,6 +287,12 @@ private:
 	header_entry_queue_t mHeaderEntryQueue;
 	handle_entry_map_t   mHandleEntryMap;	
 
+	std::unique_ptr<IOThread> mIOThread;
+	LLCondition          mJobCondition;
+	std::deque<job_ptr_t> mJobQueue;		// guarded by mJobCondition
+	LLAtomicU32          mPendingJobs;	// queued or running
+	std::map<U64, job_ptr_t> mPrefetches;
+
 	static LLVOCache* sInstance ;
 public:
 	static LLVOCache* getInstance() ;
@@ -61,6 +61,7 @@
 #include "llhudmanager.h"
 #include "llflexibleobject.h"
 #include "llskinningutil.h"
+#include "lljobpool.h"
 #include "llsky.h"
 #include "lltexturefetch.h"
 #include "llvector4a.h"
@@ -4073,6 +4074,16 @@ void LLVOVolume::clearRiggedVolume()
 }
 
 void LLVOVolume::updateRiggedVolume(bool force_update)
+{
+	LLRiggedVolume* rigged_volume = prepareRiggedVolume(force_update);
+	if (rigged_volume)
+	{
+		rigged_volume->skinFaces();
+		rigged_volume->finishUpdate();
+	}
+}
+
+LLRiggedVolume* LLVOVolume::prepareRiggedVolume(bool force_update)
 {
 	//Update mRiggedVolume to match current animation frame of avatar. 
 	//Also update position/size in octree.  
@@ -4081,7 +4092,7 @@ void LLVOVolume::updateRiggedVolume(bool force_update)
 	{
 		clearRiggedVolume();
 		
-		return;
+		return NULL;
 	}
 
 	LLVolume* volume = getVolume();
@@ -4091,7 +4102,7 @@ void LLVOVolume::updateRiggedVolume(bool force_update)
 	if (!skin)
 	{
 		clearRiggedVolume();
-		return;
+		return NULL;
 	}
 
 	LLVOAvatar* avatar = getAvatar();
@@ -4099,7 +4110,7 @@ void LLVOVolume::updateRiggedVolume(bool force_update)
 	if (!avatar)
 	{
 		clearRiggedVolume();
-		return;
+		return NULL;
 	}
 
 	if (!mRiggedVolume)
@@ -4109,14 +4120,72 @@ void LLVOVolume::updateRiggedVolume(bool force_update)
 		updateRelativeXform();
 	}
 
-	mRiggedVolume->update(skin, avatar, volume);
+	mRiggedVolume->prepareUpdate(skin, avatar, volume);
+	return mRiggedVolume;
+}
+
+static LLTrace::BlockTimerStatHandle FTM_UPDATE_RIGGED_VOLUMES("Update Rigged Volumes");
 
+//static
+void LLVOVolume::updateRiggedVolumes(const LLDrawable::drawable_list_t& drawables)
+{
+	std::vector<LLVOVolume*> objects;
+	for (LLDrawable::drawable_list_t::const_iterator iter = drawables.begin(); iter != drawables.end(); ++iter)
+	{
+		LLDrawable* drawablep = *iter;
+		if (drawablep && !drawablep->isDead() && drawablep->isState(LLDrawable::REBUILD_RIGGED))
+		{
+			LLVOVolume* vobj = drawablep->getVOVolume();
+			if (vobj)
+			{
+				objects.push_back(vobj);
+			}
+		}
+	}
+	if (objects.size() < 2)
+	{
+		// Nothing to share out, updateGeometry() will see to it
+		return;
+	}
+
+	LL_RECORD_BLOCK_TIME(FTM_UPDATE_RIGGED_VOLUMES);
+
+	std::vector<LLRiggedVolume*> volumes;
+	volumes.reserve(objects.size());
+	for (std::vector<LLVOVolume*>::const_iterator iter = objects.begin(); iter != objects.end(); ++iter)
+	{
+		LLRiggedVolume* rigged_volume = (*iter)->prepareRiggedVolume(false);
+		if (rigged_volume)
+		{
+			volumes.push_back(rigged_volume);
+		}
+	}
+
+	LLRiggedVolume::skinAll(volumes);
+
+	for (std::vector<LLRiggedVolume*>::const_iterator iter = volumes.begin(); iter != volumes.end(); ++iter)
+	{
+		(*iter)->finishUpdate();
+	}
+	for (std::vector<LLVOVolume*>::const_iterator iter = objects.begin(); iter != objects.end(); ++iter)
+	{
+		LLVOVolume* vobj = *iter;
+		vobj->genBBoxes(FALSE);
+		vobj->mDrawable->clearState(LLDrawable::REBUILD_RIGGED);
+	}
 }
 
 static LLTrace::BlockTimerStatHandle FTM_SKIN_RIGGED("Skin");
 static LLTrace::BlockTimerStatHandle FTM_RIGGED_OCTREE("Octree");
 
 void LLRiggedVolume::update(const LLMeshSkinInfo* skin, LLVOAvatar* avatar, const LLVolume* volume)
+{
+	prepareUpdate(skin, avatar, volume);
+	skinFaces();
+	finishUpdate();
+}
+
+void LLRiggedVolume::prepareUpdate(const LLMeshSkinInfo* skin, LLVOAvatar* avatar, const LLVolume* volume)
 {
 	bool copy = false;
 	if (volume->getNumVolumeFaces() != getNumVolumeFaces())
@@ -4142,14 +4211,35 @@ void LLRiggedVolume::update(const LLMeshSkinInfo* skin, LLVOAvatar* avatar, cons
 	}
 
 	//build matrix palette
-	static const size_t kMaxJoints = LL_MAX_JOINTS_PER_MESH_OBJECT;
-
-	LLMatrix4a mat[kMaxJoints];
 	U32 maxJoints = LLSkinningUtil::getMeshJointCount(skin);
-	LLSkinningUtil::initSkinningMatrixPalette(mat, maxJoints, skin, avatar, true);
+	mPalette.resize(maxJoints);
+	if (maxJoints)
+	{
+		LLSkinningUtil::initSkinningMatrixPalette(&mPalette[0], maxJoints, skin, avatar, true);
+		LLSkinningUtil::fuseBindShapeMatrix(&mPalette[0], maxJoints, skin);
+	}
+
+	for (S32 i = 0; i < volume->getNumVolumeFaces(); ++i)
+	{
+		const LLVolumeFace& vol_face = volume->getVolumeFace(i);
+		if (vol_face.mWeights)
+		{
+			LLSkinningUtil::checkSkinWeights(vol_face.mWeights, mVolumeFaces[i].mNumVertices, skin);
+		}
+	}
+
+	mSourceVolume = volume;
+}
+
+void LLRiggedVolume::skinFaces()
+{
+	const LLVolume* volume = mSourceVolume;
+	if (!volume || mPalette.empty())
+	{
+		return;
+	}
 
-	LLVector4a av_pos;
-	av_pos.load3(avatar->getPosition().mV);
+	LL_RECORD_BLOCK_TIME(FTM_SKIN_RIGGED);
 
 	for (S32 i = 0; i < volume->getNumVolumeFaces(); ++i)
 	{
@@ -4159,64 +4249,57 @@ void LLRiggedVolume::update(const LLMeshSkinInfo* skin, LLVOAvatar* avatar, cons
 		
 		LLVector4a* weight = vol_face.mWeights;
 
-		if(!weight)
+		if (!weight || !dst_face.mPositions || !dst_face.mExtents || !dst_face.mNumVertices)
 		{
 			continue;
 		}
 
-            LLSkinningUtil::checkSkinWeights(weight, dst_face.mNumVertices, skin);
-			LLMatrix4a bind_shape_matrix;
-			bind_shape_matrix.loadu(skin->mBindShapeMatrix);
+		// Skins and bounds the face in one pass
+		LLSkinningUtil::skinPositions(&mPalette[0], mPalette.size(), weight,
+									  vol_face.mPositions, dst_face.mPositions, dst_face.mNumVertices,
+									  dst_face.mExtents);
 
-			LLVector4a* pos = dst_face.mPositions;
+		dst_face.mCenter->setAdd(dst_face.mExtents[0], dst_face.mExtents[1]);
+		dst_face.mCenter->mul(0.5f);
+	}
+}
 
-			if( pos && dst_face.mExtents )
-			{
-				LL_RECORD_BLOCK_TIME(FTM_SKIN_RIGGED);
+void LLRiggedVolume::finishUpdate()
+{
+	const LLVolume* volume = mSourceVolume;
+	mSourceVolume = NULL;
+	if (!volume || mPalette.empty())
+	{
+		return;
+	}
 
-                U32 max_joints = LLSkinningUtil::getMaxJointCount();
-				for (U32 j = 0; j < dst_face.mNumVertices; ++j)
-				{
-					LLMatrix4a final_mat;
-                    LLSkinningUtil::getPerVertexSkinMatrix(weight[j].getF32ptr(), mat, false, final_mat, max_joints);
-
-					LLVector4a& v = vol_face.mPositions[j];
-					LLVector4a t;
-					LLVector4a dst;
-					bind_shape_matrix.affineTransform(v, t);
-					final_mat.affineTransform(t, dst);
-					pos[j] = dst;
-				}
+	// Octree nodes come from a pool that isn't thread safe
+	LL_RECORD_BLOCK_TIME(FTM_RIGGED_OCTREE);
+	for (S32 i = 0; i < volume->getNumVolumeFaces(); ++i)
+	{
+		LLVolumeFace& dst_face = mVolumeFaces[i];
+		if (!volume->getVolumeFace(i).mWeights || !dst_face.mPositions || !dst_face.mExtents || !dst_face.mNumVertices)
+		{
+			continue;
+		}
 
-				//update bounding box
-				LLVector4a& min = dst_face.mExtents[0];
-				LLVector4a& max = dst_face.mExtents[1];
-	
-				min = pos[0];
-				max = pos[1];
-	
-				for (U32 j = 1; j < dst_face.mNumVertices; ++j)
-				{
-					min.setMin(min, pos[j]);
-					max.setMax(max, pos[j]);
-				}
+		delete dst_face.mOctree;
+		dst_face.mOctree = NULL;
 
-				dst_face.mCenter->setAdd(dst_face.mExtents[0], dst_face.mExtents[1]);
-				dst_face.mCenter->mul(0.5f);
+		dst_face.createOctree(1.f);
+	}
+}
 
-			{
-				LL_RECORD_BLOCK_TIME(FTM_RIGGED_OCTREE);
-				delete dst_face.mOctree;
-				dst_face.mOctree = NULL;
-	
-				LLVector4a size;
-				size.setSub(dst_face.mExtents[1], dst_face.mExtents[0]);
-				size.splat(size.getLength3().getF32()*0.5f);
-				
-				dst_face.createOctree(1.f);
-			}
+//static
+void LLRiggedVolume::skinAll(const std::vector<LLRiggedVolume*>& volumes)
+{
+	LLJobPool::parallelFor((S32)volumes.size(), 1, [&volumes](S32 first, S32 last)
+	{
+		for (S32 i = first; i < last; ++i)
+		{
+			volumes[i]->skinFaces();
 		}
-	}
+	});
 }
 
 U32 LLVOVolume::getPartitionType() const
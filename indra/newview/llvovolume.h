@@ -55,11 +55,28 @@ class LLRiggedVolume : public LLVolume
 {
 public:
 	LLRiggedVolume(const LLVolumeParams& params)
-		: LLVolume(params, 0.f)
+		: LLVolume(params, 0.f),
+		mSourceVolume(NULL)
 	{
 	}
 
 	void update(const LLMeshSkinInfo* skin, LLVOAvatar* avatar, const LLVolume* src_volume);
+
+	// update() in three steps so that many volumes can be skinned at once:
+	// prepareUpdate() reads the avatar's joints and finishUpdate() rebuilds
+	// the octrees, both on the main thread; skinFaces() only touches this
+	// volume and src_volume, which must stay alive until then, and is safe
+	// on any thread.
+	void prepareUpdate(const LLMeshSkinInfo* skin, LLVOAvatar* avatar, const LLVolume* src_volume);
+	void skinFaces();
+	void finishUpdate();
+
+	// skinFaces() on every volume, spread over the job pool
+	static void skinAll(const std::vector<LLRiggedVolume*>& volumes);
+
+private:
+	LLAlignedArray<LLMatrix4a, 64> mPalette;	// joint matrices with the bind shape folded in
+	const LLVolume* mSourceVolume;
 };
 
 // Base class for implementations of the volume - Primitive, Flexible Object, etc.
@@ -315,6 +332,9 @@ public:
 
 	//rigged volume update (for raycasting)
 	void updateRiggedVolume(bool force_update = false);
+	// Does the REBUILD_RIGGED part of updateGeometry() for all the drawables
+	// in the list needing it, skinning them together on the job pool
+	static void updateRiggedVolumes(const std::list<LLPointer<LLDrawable> >& drawables);
 	LLRiggedVolume* getRiggedVolume();
 
 	//returns true if volume should be treated as a rigged volume
@@ -328,6 +348,9 @@ public:
 	void clearRiggedVolume();
 
 protected:
+	// Main thread half of updateRiggedVolume(), returns the volume to skin
+	LLRiggedVolume* prepareRiggedVolume(bool force_update);
+
 	S32	computeLODDetail(F32	distance, F32 radius);
 	BOOL calcLOD();
 	LLFace* addFace(S32 face_index);
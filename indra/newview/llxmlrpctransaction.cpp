@@ -269,11 +269,17 @@ void LLXMLRPCTransaction::Handler::onCompleted(LLCore::HttpHandle handle,
             << mImpl->mURI << LL_ENDL;
         return;
     }
-	auto bodydata = std::make_unique<char[]>(body->size());
-
-	body->read(0, bodydata.get(), body->size());
+	// Parse in place when the body arrived in one piece
+	std::unique_ptr<char[]> bodycopy;
+	const char * bodydata = body->getContiguous(0, body->size());
+	if (!bodydata)
+	{
+		bodycopy = std::make_unique<char[]>(body->size());
+		body->read(0, bodycopy.get(), body->size());
+		bodydata = bodycopy.get();
+	}
 
-	mImpl->mResponse = XMLRPC_REQUEST_FromXML(bodydata.get(), body->size(), nullptr);
+	mImpl->mResponse = XMLRPC_REQUEST_FromXML(bodydata, body->size(), nullptr);
 
 	bool		hasError = false;
 	bool		hasFault = false;
@@ -2765,6 +2765,9 @@ void LLPipeline::updateGeom(F32 max_dtime, LLCamera& camera)
 	// for now, only LLVOVolume does this to throttle LOD changes
 	LLVOVolume::preUpdateGeom();
 
+	// Skin the rigged volumes waiting to be rebuilt all together first
+	LLVOVolume::updateRiggedVolumes(mBuildQ1);
+
 	// Iterate through all drawables on the priority build queue,
 	for (LLDrawable::drawable_list_t::iterator iter = mBuildQ1.begin();
 		 iter != mBuildQ1.end();)
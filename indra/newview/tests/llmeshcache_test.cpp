@@ -0,0 +1,311 @@
+/**
+ * @file llmeshcache_test.cpp
+ * @brief Checks the mesh cache's data and index files across opens
+ *
+ * $LicenseInfo:firstyear=2020&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Precompiled header: almost always required for newview cpp files
+#include "../llviewerprecompiledheaders.h"
+#include <vector>
+// Class to test
+#include "../llmeshcache.h"
+// For directory listing and cleanup
+#include "../llvfs/lldiriterator.h"
+#include "../llcommon/llfile.h"
+// Tut header
+#include "../test/lltut.h"
+
+// These tests poke at the files directly and so know a little about their
+// layout: both start with a magic and a version, then the generation, and
+// the data file header is 16 bytes.
+static const U32 GENERATION_OFFSET = 8;
+static const U32 DATA_HEADER_BYTES = 16;
+
+namespace tut
+{
+	struct meshcache_test
+	{
+		std::string mDir;
+
+		meshcache_test()
+		:	mDir("llmeshcache_test.dir")
+		{
+			cleanup();
+		}
+		~meshcache_test()
+		{
+			cleanup();
+		}
+
+		void cleanup()
+		{
+			std::string name;
+			LLDirIterator iter(mDir, "*");
+			while (iter.next(name))
+			{
+				LLFile::remove(path(name));
+			}
+			LLFile::rmdir_nowarn(mDir);
+		}
+
+		std::string path(const std::string& name) const
+		{
+			return mDir + "/" + name;
+		}
+
+		std::vector<U8> readFile(const std::string& name) const
+		{
+			std::vector<U8> data;
+			LLFILE* fp = LLFile::fopen(path(name), "rb");
+			if (fp)
+			{
+				U8 buffer[4096];
+				size_t count;
+				while ((count = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+				{
+					data.insert(data.end(), buffer, buffer + count);
+				}
+				fclose(fp);
+			}
+			return data;
+		}
+
+		void writeFile(const std::string& name, const std::vector<U8>& data) const
+		{
+			LLFILE* fp = LLFile::fopen(path(name), "wb");
+			ensure("rewrote " + name, fp && fwrite(&data[0], 1, data.size(), fp) == data.size());
+			fclose(fp);
+		}
+
+		U64 fileSize(const std::string& name) const
+		{
+			llstat st;
+			return LLFile::stat(path(name), &st) ? 0 : st.st_size;
+		}
+
+		static std::vector<U8> pattern(S32 size, U8 seed)
+		{
+			std::vector<U8> data(size);
+			for (S32 i = 0; i < size; ++i)
+			{
+				data[i] = (U8)(seed + i * 7);
+			}
+			return data;
+		}
+
+		static LLUUID meshID(U32 i)
+		{
+			LLUUID id;
+			id.generate(llformat("mesh %u", i));
+			return id;
+		}
+
+		static void writePart(LLMeshCache& cache, const LLUUID& id, LLMeshCache::EPart part, const std::vector<U8>& data)
+		{
+			ensure("wrote part", cache.write(id, part, &data[0], (S32)data.size()));
+		}
+
+		static void ensurePart(const std::string& msg, LLMeshCache& cache, const LLUUID& id, LLMeshCache::EPart part, const std::vector<U8>& data)
+		{
+			ensure_equals(msg + " size", cache.getSize(id, part), (S32)data.size());
+			std::vector<U8> buffer;
+			ensure(msg + " read", cache.read(id, part, buffer));
+			ensure(msg + " contents", buffer == data);
+		}
+
+		// Writes two meshes and closes the cache, leaving both files behind
+		void fillAndClose(const std::vector<U8>& header, const std::vector<U8>& lod)
+		{
+			LLMeshCache cache(mDir, 1024 * 1024);
+			ensure("opened", cache.open());
+			writePart(cache, meshID(0), LLMeshCache::PART_HEADER, header);
+			writePart(cache, meshID(0), LLMeshCache::lodPart(2), lod);
+			writePart(cache, meshID(1), LLMeshCache::PART_HEADER, header);
+			cache.close();
+		}
+	};
+
+	typedef test_group<meshcache_test> meshcache_t;
+	typedef meshcache_t::object meshcache_object_t;
+	tut::meshcache_t tut_meshcache("LLMeshCache");
+
+	// Parts come back after the cache is closed and opened again
+	template<> template<>
+	void meshcache_object_t::test<1>()
+	{
+		std::vector<U8> header = pattern(300, 1);
+		std::vector<U8> lod = pattern(5000, 2);
+		std::vector<U8> skin = pattern(700, 3);
+		{
+			LLMeshCache cache(mDir, 1024 * 1024);
+			ensure("opened", cache.open());
+			writePart(cache, meshID(0), LLMeshCache::PART_HEADER, header);
+			writePart(cache, meshID(0), LLMeshCache::lodPart(3), lod);
+			writePart(cache, meshID(1), LLMeshCache::PART_SKIN, skin);
+			// Replaced, then removed
+			writePart(cache, meshID(1), LLMeshCache::PART_HEADER, lod);
+			writePart(cache, meshID(1), LLMeshCache::PART_HEADER, header);
+			writePart(cache, meshID(0), LLMeshCache::lodPart(0), skin);
+			cache.removePart(meshID(0), LLMeshCache::lodPart(0));
+			cache.close();
+		}
+
+		LLMeshCache cache(mDir, 1024 * 1024);
+		ensure("reopened", cache.open());
+		ensurePart("header", cache, meshID(0), LLMeshCache::PART_HEADER, header);
+		ensurePart("lod", cache, meshID(0), LLMeshCache::lodPart(3), lod);
+		ensurePart("skin", cache, meshID(1), LLMeshCache::PART_SKIN, skin);
+		ensurePart("replaced header", cache, meshID(1), LLMeshCache::PART_HEADER, header);
+		ensure_equals("removed lod", cache.getSize(meshID(0), LLMeshCache::lodPart(0)), -1);
+		ensure_equals("never written", cache.getSize(meshID(1), LLMeshCache::lodPart(3)), -1);
+
+		// A read alone still leaves an index the next open takes
+		cache.close();
+		ensure("opened after a read", cache.open());
+		ensurePart("header after a read", cache, meshID(0), LLMeshCache::PART_HEADER, header);
+	}
+
+	// Rewriting the same part leaves garbage behind; once the data file
+	// would grow past 125% of the limit it is compacted instead
+	template<> template<>
+	void meshcache_object_t::test<2>()
+	{
+		const U64 max_size = 1024 * 1024;
+		const U64 limit = max_size + max_size / 4;
+		std::vector<U8> header = pattern(300, 1);
+		LLMeshCache cache(mDir, max_size);
+		ensure("opened", cache.open());
+		writePart(cache, meshID(0), LLMeshCache::PART_HEADER, header);
+
+		std::vector<U8> lod;
+		for (U32 i = 0; i < 40; ++i)
+		{
+			lod = pattern(100 * 1024, (U8)i);
+			writePart(cache, meshID(1), LLMeshCache::lodPart(3), lod);
+			ensure("data file within the limit", fileSize("mesh.data") <= limit);
+		}
+		ensurePart("header kept", cache, meshID(0), LLMeshCache::PART_HEADER, header);
+		ensurePart("last lod", cache, meshID(1), LLMeshCache::lodPart(3), lod);
+
+		// Compaction wrote a new index for the new data file
+		cache.close();
+		ensure("reopened", cache.open());
+		ensurePart("header after reopen", cache, meshID(0), LLMeshCache::PART_HEADER, header);
+		ensurePart("lod after reopen", cache, meshID(1), LLMeshCache::lodPart(3), lod);
+	}
+
+	// More live meshes than the limit holds: compaction drops meshes until
+	// the rest fit, and the one being written always makes it in
+	template<> template<>
+	void meshcache_object_t::test<3>()
+	{
+		const U64 max_size = 1024 * 1024;
+		const U64 limit = max_size + max_size / 4;
+		const S32 size = 100 * 1024;
+		LLMeshCache cache(mDir, max_size);
+		ensure("opened", cache.open());
+
+		for (U32 i = 0; i < 30; ++i)
+		{
+			writePart(cache, meshID(i), LLMeshCache::lodPart(3), pattern(size, (U8)i));
+			ensure("data file within the limit", fileSize("mesh.data") <= limit);
+			ensurePart(llformat("mesh %u", i), cache, meshID(i), LLMeshCache::lodPart(3), pattern(size, (U8)i));
+		}
+
+		U64 cached = 0;
+		for (U32 i = 0; i < 30; ++i)
+		{
+			S32 part_size = cache.getSize(meshID(i), LLMeshCache::lodPart(3));
+			if (part_size > 0)
+			{
+				cached += part_size;
+				ensurePart(llformat("kept mesh %u", i), cache, meshID(i), LLMeshCache::lodPart(3), pattern(size, (U8)i));
+			}
+		}
+		ensure("some meshes dropped", cached < 30 * (U64)size);
+		ensure("cached within the limit", cached <= limit);
+	}
+
+	// An index from another generation of the data file is not trusted
+	template<> template<>
+	void meshcache_object_t::test<4>()
+	{
+		std::vector<U8> header = pattern(300, 1);
+		std::vector<U8> lod = pattern(5000, 2);
+		fillAndClose(header, lod);
+
+		std::vector<U8> index = readFile("mesh.index");
+		ensure("index written", index.size() > GENERATION_OFFSET);
+		index[GENERATION_OFFSET] ^= 1;
+		writeFile("mesh.index", index);
+
+		LLMeshCache cache(mDir, 1024 * 1024);
+		ensure("opened", cache.open());
+		ensure_equals("header dropped", cache.getSize(meshID(0), LLMeshCache::PART_HEADER), -1);
+		ensure_equals("lod dropped", cache.getSize(meshID(0), LLMeshCache::lodPart(2)), -1);
+		ensure_equals("other mesh dropped", cache.getSize(meshID(1), LLMeshCache::PART_HEADER), -1);
+
+		// and the cache carries on from scratch
+		writePart(cache, meshID(2), LLMeshCache::PART_HEADER, header);
+		cache.close();
+		ensure("reopened", cache.open());
+		ensurePart("new mesh", cache, meshID(2), LLMeshCache::PART_HEADER, header);
+		ensure_equals("old mesh still gone", cache.getSize(meshID(0), LLMeshCache::PART_HEADER), -1);
+	}
+
+	// A data file cut short of what the index points at starts over
+	template<> template<>
+	void meshcache_object_t::test<5>()
+	{
+		std::vector<U8> header = pattern(300, 1);
+		std::vector<U8> lod = pattern(5000, 2);
+		fillAndClose(header, lod);
+
+		std::vector<U8> data = readFile("mesh.data");
+		ensure("data written", data.size() > DATA_HEADER_BYTES + header.size() + lod.size());
+		data.resize(DATA_HEADER_BYTES + header.size() + lod.size() / 2);
+		writeFile("mesh.data", data);
+
+		{
+			LLMeshCache cache(mDir, 1024 * 1024);
+			ensure("opened", cache.open());
+			ensure_equals("header dropped", cache.getSize(meshID(0), LLMeshCache::PART_HEADER), -1);
+			ensure_equals("lod dropped", cache.getSize(meshID(0), LLMeshCache::lodPart(2)), -1);
+			std::vector<U8> buffer;
+			ensure("nothing to read", !cache.read(meshID(1), LLMeshCache::PART_HEADER, buffer));
+
+			writePart(cache, meshID(2), LLMeshCache::lodPart(2), lod);
+			ensurePart("new mesh", cache, meshID(2), LLMeshCache::lodPart(2), lod);
+		}
+
+		// Down to less than its own header
+		data.resize(DATA_HEADER_BYTES / 2);
+		writeFile("mesh.data", data);
+
+		LLMeshCache cache(mDir, 1024 * 1024);
+		ensure("opened a stub", cache.open());
+		ensure_equals("mesh dropped", cache.getSize(meshID(2), LLMeshCache::lodPart(2)), -1);
+		writePart(cache, meshID(3), LLMeshCache::PART_HEADER, header);
+		ensurePart("written after the stub", cache, meshID(3), LLMeshCache::PART_HEADER, header);
+	}
+}